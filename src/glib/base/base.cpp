@@ -73,6 +73,7 @@ int _daylight = 0;
 #include "wch.cpp"
 #include "xfl.cpp"
 #include "xmath.cpp"
+#include "sortedset.cpp"
 
 #include "blobbs.cpp"
 #include "pgblob.cpp"
@@ -85,6 +86,7 @@ int _daylight = 0;
 #include "ss.cpp"
 #include "linalg.cpp"
 #include "json.cpp"
+#include "journal.cpp"
 
 #include "zipfl.cpp"
 
@@ -190,6 +190,7 @@ typedef long long index_t;
 
 #include "xmath.h"
 #include "xmlser.h"
+#include "sortedset.h"
 
 #include "unicode.h"
 #include "unicodestring.h"
@@ -214,6 +215,7 @@ typedef long long index_t;
 #include "linalg.h"
 #include "tensor.h"
 #include "json.h"
+#include "journal.h"
 #include "zipfl.h"
 #include "pgblob.h"
 #include "funrouter.h"
@@ -239,7 +239,7 @@ TStr TGBlobBs::GetNrBlobBsFNm(const TStr& BlobBsFNm){
 TGBlobBs::TGBlobBs(
  const TStr& BlobBsFNm, const TFAccess& _Access, const int& _MxSegLen):
   TBlobBs(), FBlobBs(), Access(_Access), MxSegLen(_MxSegLen),
-  BlockLenV(), FFreeBlobPtV(TB4Def::B4Bits), FirstBlobPt(){
+  BlockLenV(), FFreeBlobPtV(TB4Def::B4Bits), FirstBlobPt(), ClosedP(false){
   if (MxSegLen==-1){MxSegLen=MxBlobFLen;}
   TStr NrBlobBsFNm=GetNrBlobBsFNm(BlobBsFNm);
   switch (Access){
@@ -280,19 +280,30 @@ TGBlobBs::TGBlobBs(
 
 TGBlobBs::~TGBlobBs(){
   if (Access!=faRdOnly){
-    FBlobBs->SetFPos(0);
-    PutVersionStr(FBlobBs);
-    PutBlobBsStateStr(FBlobBs, bbsClosed);
-    PutMxSegLen(FBlobBs, MxSegLen);
-    PutBlockLenV(FBlobBs, BlockLenV);
-    PutFFreeBlobPtV(FBlobBs, FFreeBlobPtV);
-  }
+    PutHeader(bbsClosed);}
   FBlobBs->Flush();
   FBlobBs=NULL;
 }
 
+void TGBlobBs::PutHeader(const TBlobBsState& State){
+  FBlobBs->SetFPos(0);
+  PutVersionStr(FBlobBs);
+  PutBlobBsStateStr(FBlobBs, State);
+  PutMxSegLen(FBlobBs, MxSegLen);
+  PutBlockLenV(FBlobBs, BlockLenV);
+  PutFFreeBlobPtV(FBlobBs, FFreeBlobPtV);
+}
+
+void TGBlobBs::Flush(){
+  if (Access!=faRdOnly){
+    // header with current free lists, valid until the next change
+    PutHeader(bbsClosed); ClosedP=true;}
+  FBlobBs->Flush();
+}
+
 TBlobPt TGBlobBs::PutBlob(const PSIn& SIn){
   EAssert((Access==faCreate)||(Access==faUpdate)||(Access==faRestore));
+  MarkOpened();
   int BfL=SIn->Len();
   int MxBfL; int FFreeBlobPtN;
   GetAllocInfo(BfL, BlockLenV, MxBfL, FFreeBlobPtN);
@@ -404,6 +415,7 @@ PSIn TGBlobBs::GetBlob(const TBlobPt& BlobPt){
 /// Deletes specified BLOB
 int TGBlobBs::DelBlob(const TBlobPt& BlobPt){
   EAssert((Access==faCreate)||(Access==faUpdate)||(Access==faRestore));
+  MarkOpened();
   FBlobBs->SetFPos(BlobPt.GetAddr());                                  // find BLOB start
   AssertBlobTag(FBlobBs, btBegin);
   int MxBfL=FBlobBs->GetInt();                                         // read buffer length
@@ -574,6 +586,13 @@ TMBlobBs::~TMBlobBs(){
   }
 }
 
+void TMBlobBs::Flush(){
+  if (Access!=faRdOnly){
+    SaveMain();}
+  for (int SegN=0; SegN<SegV.Len(); SegN++){
+    SegV[SegN]->Flush();}
+}
+
 // save a new buffer in SIn to a blob
 TBlobPt TMBlobBs::PutBlob(const PSIn& SIn){
   EAssert((Access==faCreate)||(Access==faUpdate)||(Access==faRestore));
@@ -161,6 +161,9 @@ public:
   bool FNextBlobPt(TBlobPt& TrvBlobPt, PSIn& BlobSIn){
     TBlobPt BlobPt; return FNextBlobPt(TrvBlobPt, BlobPt, BlobSIn);}
 
+  /// write everything needed to reopen the blob base to the disk, it stays open
+  virtual void Flush()=0;
+
   virtual const TBlobBsStats& GetStats()=0;
   virtual void ResetStats() = 0;
 };
@@ -183,6 +186,12 @@ private:
   TBlobPt FirstBlobPt;
   static TStr GetNrBlobBsFNm(const TStr& BlobBsFNm);
   TBlobBsStats Stats;
+  /// header on the disk is marked as closed (after Flush)
+  bool ClosedP;
+  /// write header with the given state
+  void PutHeader(const TBlobBsState& State);
+  /// mark header as opened before the first change after Flush
+  void MarkOpened(){if (ClosedP){PutHeader(bbsOpened); ClosedP=false;}}
 public:
   TGBlobBs(const TStr& BlobBsFNm, const TFAccess& _Access=faRdOnly,
    const int& _MxSegLen=-1);
@@ -209,6 +218,8 @@ public:
 
   static bool Exists(const TStr& BlobBsFNm);
 
+  void Flush();
+
   const TBlobBsStats& GetStats() { return Stats; }
   void ResetStats() { Stats.Reset(); }
 };
@@ -257,6 +268,8 @@ public:
 
   static bool Exists(const TStr& BlobBsFNm);
 
+  void Flush();
+
   const TBlobBsStats& GetStats();
   void ResetStats();
 };
@@ -293,15 +293,14 @@ void TBlockCache<TVal>::StoreBlock(const int& BlockId) {
 
 template <class TVal>
 void TBlockCache<TVal>::GetBlock(const int& BlockId, PBlockDat& BlockDat) const {
-    // load from the cache
-    if (!BlockCache.Get(BlockId, BlockDat)) {
+    // load from the cache, this also brings it to the top of cache
+    if (!BlockCache.Lookup(BlockId, BlockDat)) {
         // if not in there, load from disk
         const TBlobPt& BlockBlobPt = BlockBlobPtV[(int)BlockId];
         PSIn SIn = BlockBlobBs->GetBlob(BlockBlobPt); 
         BlockDat = TBlockDat::Load(*SIn);
+        BlockCache.Put(BlockId, BlockDat);
     }
-    // bring to the top of cache
-    BlockCache.Put(BlockId, BlockDat);
 }
 
 template <class TVal>
@@ -478,31 +477,34 @@ private:
     ClassTP(TBlockDat, PBlockDat)//{
     private:
         TBool ChangedP;
+        // memory counted in dirty bytes of the cache, zero when not changed
+        TInt64 DirtyMem;
         TVec<TVal> ValV;
 
     public:
 
-        TBlockDat(): ChangedP(true) { }
+        TBlockDat(): ChangedP(true), DirtyMem(0) { }
         static PBlockDat New() { return new TBlockDat; }
         // serialization
-        TBlockDat(TSIn& SIn): ChangedP(false) { ValV.Load(SIn); }
+        TBlockDat(TSIn& SIn): ChangedP(false), DirtyMem(0) { ValV.Load(SIn); }
         static PBlockDat Load(TSIn& SIn) { return new TBlockDat(SIn); }
         void Save(TSOut& SOut) const { ValV.Save(SOut); }
 
         // number of values in the block
         int GetVals() const { return ValV.Len(); }
         bool IsFull(const int& BlockSize) const { return !(ValV.Len() < BlockSize); }
-        // add new value
-        int AddVal(const TVal& Val) { ChangedP = true; return ValV.Add(Val); }
-        // updated existing value
-        void SetVal(const int& ValId, const TVal& Val) { ChangedP = true; ValV[ValId] = Val; }
+        // add new value, caller marks the block changed
+        int AddVal(const TVal& Val) { return ValV.Add(Val); }
+        // updated existing value, caller marks the block changed
+        void SetVal(const int& ValId, const TVal& Val) { ValV[ValId] = Val; }
         // retrieve value
         bool IsValId(const int& ValId) const { return (ValId >= 0) && (ValId < ValV.Len()); }
         const TVal& GetVal(const int& ValId) const { return ValV[ValId]; }
         // dirty flag
         bool IsChanged() const { return ChangedP; }
-        void SetChanged() { ChangedP = true; }
-        void SetNotChanged() { ChangedP = false; }
+        int64 GetDirtyMem() const { return DirtyMem; }
+        void SetChanged(const int64& Mem) { ChangedP = true; DirtyMem += Mem; }
+        void SetNotChanged() { ChangedP = false; DirtyMem = 0; }
 
         // need to report size, for keeping up used-up space in cache
         int64 GetMemUsed() const {
@@ -514,7 +516,6 @@ private:
         bool OnDelFromCache(const TInt& BlockId, void* WndBlockCache) {
             if (ChangedP && !((TWndBlockCache*)WndBlockCache)->IsReadOnly()) {
                 ((TWndBlockCache*)WndBlockCache)->StoreBlock(BlockId);
-                SetNotChanged();
                 return true;
             }
             return false;
@@ -528,6 +529,8 @@ private:
     // max memory to be used by cache
     int64 CacheResetThreshold;
     int64 NewCacheSizeInc;
+    // memory of changed blocks, kept up to date so it can be checked often
+    int64 DirtyBytes;
     // number of items
     TInt Vals;
     // block-size
@@ -552,7 +555,10 @@ private:
 
     // for callbacks from cache, to store blocks before drop from cache
     void* GetVoidThis() const { return (void*)this; }
+    // store block and mark it as not changed
     void StoreBlock(const int& BlockId);
+    // mark block as changed after ValMem bytes of its values changed
+    void SetBlockChanged(const PBlockDat& BlockDat, const int64& ValMem);
 
     // add new block to the end
     int AddBlock();
@@ -573,6 +579,10 @@ private:
     }
     
 public:
+    /// Reference to a cache block. Holding it keeps the block (and values
+    /// returned by GetValRef) alive even after it is dropped from the cache.
+    typedef PBlockDat PBlockPin;
+
     TWndBlockCache(const TStr& _FNm, const PBlobBs& _BlockBlobBs,
         const int64& MxCacheMem, const int& _BlockSize);
     TWndBlockCache(const TStr& _FNm, const PBlobBs& _BlockBlobBs,
@@ -594,6 +604,9 @@ public:
     uint64 GetLastValId() const;
     bool IsValId(const uint64& ValId) const;
     void GetVal(const uint64& ValId, TVal& Val) const;  
+    /// Retrieve stored value without copying it. Returned reference is valid
+    /// while BlockPin is held and no value in the same block is updated.
+    const TVal& GetValRef(const uint64& ValId, PBlockPin& BlockPin) const;
     uint64 GetFirstVal(TVal& Val) const;    
     // delete first value
     bool DelVal();
@@ -603,23 +616,37 @@ public:
     int PartialFlush(int WndInMsec = 500) { 
         TTmStopWatch sw(true);
         int res = 0;
-        TLstNd<TInt>* current = BlockCache.Last();
-        while (current != NULL) {
+        // start with blocks to be dropped from cache first
+        TInt Key; PBlockDat Dat;
+        void* KeyDatP = BlockCache.FLastKeyDat();
+        while (BlockCache.FPrevKeyDat(KeyDatP, Key, Dat)) {
             if (sw.GetMSecInt() > WndInMsec) {
                 break; // time is up
             }
-            TInt Key = current->GetVal();
-            PBlockDat Dat;
-            BlockCache.Get(Key, Dat);
             if (Dat->IsChanged()) {
                 StoreBlock(Key);
-                Dat->SetNotChanged();
                 res++;
             }
-            current = current->Prev();
         }
         return res;
     }
+    /// Save all changed blocks and the block index to the disk. Blob base
+    /// with the blocks is not flushed, this is up to its owner.
+    void Flush();
+    /// Size of changed blocks, written by the next flush
+    uint64 GetDirtyBytes() const { return (uint64)DirtyBytes; }
+    /// Change replacement policy of the block cache
+    void SetCachePolicy(const TCachePolicy& Policy) { BlockCache.SetPolicy(Policy); }
+    /// Replacement policy of the block cache
+    TCachePolicy GetCachePolicy() const { return BlockCache.GetPolicy(); }
+    /// Blocks loaded until EndScan are dropped from the cache first
+    void StartScan() const { BlockCache.StartScan(); }
+    /// Close scan opened with StartScan
+    void EndScan() const { BlockCache.EndScan(); }
+    /// Number of block reads served from the cache
+    uint64 GetCacheHits() const { return BlockCache.GetHits(); }
+    /// Number of block reads loaded from disk
+    uint64 GetCacheMisses() const { return BlockCache.GetMisses(); }
     /// Get statistics about BLOB storage
     TBlobBsStats GetBlobBsStats() { return BlockBlobBs->GetStats(); }
 };
@@ -642,20 +669,30 @@ void TWndBlockCache<TVal>::StoreBlock(const int& BlockId) {
         int ReleasedSize;
         BlockBlobPtV[_BlockId] = BlockBlobBs->PutBlob(BlockBlobPt, MOut.GetSIn(), ReleasedSize);
     }
+    // block is clean now
+    DirtyBytes -= BlockDat->GetDirtyMem();
+    BlockDat->SetNotChanged();
+}
+
+template <class TVal>
+void TWndBlockCache<TVal>::SetBlockChanged(const PBlockDat& BlockDat, const int64& ValMem) {
+    // block becoming changed is counted whole, after that only the changed values
+    const int64 Mem = BlockDat->IsChanged() ? ValMem : BlockDat->GetMemUsed();
+    BlockDat->SetChanged(Mem);
+    DirtyBytes += Mem;
 }
 
 template <class TVal>
 void TWndBlockCache<TVal>::GetBlock(const int& BlockId, PBlockDat& BlockDat) const {
-    // load from the cache
-    if (!BlockCache.Get(BlockId, BlockDat)) {
+    // load from the cache, this also brings it to the top of cache
+    if (!BlockCache.Lookup(BlockId, BlockDat)) {
         // if not in there, load from disk
         int _BlockId = BlockId - FirstBlockOffset;
         const TBlobPt& BlockBlobPt = BlockBlobPtV[_BlockId];
         PSIn SIn = BlockBlobBs->GetBlob(BlockBlobPt); 
         BlockDat = TBlockDat::Load(*SIn);
+        BlockCache.Put(BlockId, BlockDat);
     }
-    // bring to the top of cache
-    BlockCache.Put(BlockId, BlockDat);
 }
 
 template <class TVal>
@@ -664,8 +701,9 @@ int TWndBlockCache<TVal>::AddBlock() {
     PBlockDat BlockDat = TBlockDat::New();
     // mark existance of the block with empty disk-blob pointer
     const int BlockId = BlockBlobPtV.Add(TBlobPt()) + FirstBlockOffset;
-    // add it to cache
+    // add it to cache, new block is changed
     BlockCache.Put(BlockId, BlockDat);
+    SetBlockChanged(BlockDat, BlockDat->GetMemUsed());
     // update cache size increase with the size of cache key and empty block
     NewCacheSizeInc += sizeof(TInt) + BlockDat->GetMemUsed(); 
     // return id of the new block
@@ -695,7 +733,12 @@ template <class TVal>
 void TWndBlockCache<TVal>::DelBlock() { 
     // get first block id
     const int FirstBlockId = FirstBlockOffset;
-    // delete from cache
+    // delete from cache, without storing it
+    PBlockDat BlockDat;
+    if (BlockCache.Get(FirstBlockId, BlockDat)) {
+        DirtyBytes -= BlockDat->GetDirtyMem();
+        BlockDat->SetNotChanged();
+    }
     BlockCache.Del(FirstBlockId, false);
     // delete from blob
     if (!BlockBlobPtV[0].Empty()) { 
@@ -715,6 +758,7 @@ TWndBlockCache<TVal>::TWndBlockCache(const TStr& _FNm, const PBlobBs& _BlockBlob
     // initialize cache parameters
     CacheResetThreshold = MAX(int64(0.1 * double(MxCacheMem)), int64(10*1024*1024));
     NewCacheSizeInc = 0;
+    DirtyBytes = 0;
     // initialize value disk store
     BlockBlobBs = _BlockBlobBs;
     // create first block
@@ -731,6 +775,7 @@ TWndBlockCache<TVal>::TWndBlockCache(const TStr& _FNm, const PBlobBs& _BlockBlob
     // initialize cache parameters
     CacheResetThreshold = MAX(int64(0.1 * double(MxCacheMem)), int64(10*1024*1024));
     NewCacheSizeInc = 0;
+    DirtyBytes = 0;
     // initialize value disk store
     BlockBlobBs = _BlockBlobBs;
     // make sure we are not trying to create
@@ -746,6 +791,11 @@ TWndBlockCache<TVal>::TWndBlockCache(const TStr& _FNm, const PBlobBs& _BlockBlob
 
 template <class TVal>
 TWndBlockCache<TVal>::~TWndBlockCache() {
+    Flush();
+}
+
+template <class TVal>
+void TWndBlockCache<TVal>::Flush() {
     if ((Access == faCreate) || (Access == faUpdate)) {
         // flush all the latest changes in cache to the disk        
         BlockCache.Flush();
@@ -766,8 +816,10 @@ uint64 TWndBlockCache<TVal>::AddVal(const TVal& Val) {
     const int BlockId = GetLastBlock(BlockDat);
     // add the value to the block
     const int BlockValId = BlockDat->AddVal(Val);
+    const int64 ValMem = BlockDat->GetVal(BlockValId).GetMemUsed();
+    SetBlockChanged(BlockDat, ValMem);
     // update cache increase count
-    NewCacheSizeInc += BlockDat->GetVal(BlockValId).GetMemUsed();
+    NewCacheSizeInc += ValMem;
     // check if we have to drop anything from the cache
     if (NewCacheSizeInc > CacheResetThreshold) {
         // report on the size increase
@@ -791,7 +843,9 @@ void TWndBlockCache<TVal>::SetVal(const uint64& ValId, const TVal& Val) {
     // get the block
     PBlockDat BlockDat;
     GetBlock(BlockId, BlockDat);
+    const int64 OldValMem = BlockDat->GetVal(BlockValId).GetMemUsed();
     BlockDat->SetVal(BlockValId, Val);
+    SetBlockChanged(BlockDat, int64(BlockDat->GetVal(BlockValId).GetMemUsed()) - OldValMem);
 }
 
 template <class TVal>
@@ -843,6 +897,17 @@ void TWndBlockCache<TVal>::GetVal(const uint64& ValId, TVal& Val) const {
     Val = BlockDat->GetVal(BlockValId);
 }
 
+template <class TVal>
+const TVal& TWndBlockCache<TVal>::GetValRef(const uint64& ValId, PBlockPin& BlockPin) const {
+    // transfor to block ids
+    int BlockId = -1, BlockValId = -1;
+    GetBlockId(ValId, BlockId, BlockValId);
+    // get the block and keep a reference to it
+    GetBlock(BlockId, BlockPin);
+    // return reference to the val inside the block
+    return BlockPin->GetVal(BlockValId);
+}
+
 template <class TVal>
 bool TWndBlockCache<TVal>::DelVal() {       
     // return if nothing to delete
@@ -1732,8 +1732,8 @@ public:
     int Index = (Next + ValN) % ValV.Len();
     return ValV[Index];}
 
-  /// Deletes the queue
-  void Clr(const bool& DoDel=true){ValV.Clr(DoDel); Last=Next=0;}
+  /// Deletes the queue, reserved space is kept when DoDel is false
+  void Clr(const bool& DoDel=true){if (DoDel){ValV.Clr();} Last=Next=0;}
   /// Initialize the queue. _MxLast is ignored, _MxLen determines the size with autoresize if set to -1.
   void Gen(const int& _MxLast=64, const int& _MxLen=-1){
     MxLast=_MxLast; MxLen=_MxLen; Last=0; Next=0; ValV.Clr();}
@@ -1758,7 +1758,7 @@ public:
 
   /// Most recently added element, last one to go out
   const TVal& Back() const {
-    Assert(!Empty()); return ValV[(Last - 1) % ValV.Len()];
+    Assert(!Empty()); return ValV[(Last + ValV.Len() - 1) % ValV.Len()];
   }
 
   /// The oldest element, first one to go out
@@ -1776,6 +1776,11 @@ public:
     Assert(!Empty());
     Next = (Next + 1) % ValV.Len();
   }
+  /// Remove the element at the back (most recently added), for use as a double-ended queue
+  void PopBack(){
+    Assert(!Empty());
+    Last = (Last + ValV.Len() - 1) % ValV.Len();
+  }
   /// Insert the element at the back (enqueue)
   void Push(const TVal& Val){
     int Vals = ValV.Len();
@@ -1794,8 +1799,8 @@ public:
         Vec[N - Next] = ValV[N % Vals];
       }
       Vec[OldLen] = Val;
-      // copy back
-      ValV = Vec;
+      // take over the new space
+      ValV.MoveFrom(Vec);
       Next = 0;
       Last = OldLen + 1;
     }
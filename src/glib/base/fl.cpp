@@ -462,6 +462,8 @@ TFOut::TFOut(const TStr& FNm, const bool& Append):
   if (FNm.GetUc()=="CON"){
     FileId=stdout;
   } else {
+    if (TFJournal::IsOn()){
+      if (Append){TFJournal::OnWrite(FNm, 0, 0);} else {TFJournal::OnTrunc(FNm);}}
     if (Append){FileId=fopen(FNm.CStr(), "a+b");}
     else {FileId=fopen(FNm.CStr(), "w+b");}
     EAssertR(FileId!=NULL, "Can not open file '"+FNm+"'.");
@@ -474,6 +476,8 @@ TFOut::TFOut(const TStr& FNm, const bool& Append, bool& OpenedP):
   if (FNm.GetUc()=="CON"){
     FileId=stdout;
   } else {
+    if (TFJournal::IsOn()){
+      if (Append){TFJournal::OnWrite(FNm, 0, 0);} else {TFJournal::OnTrunc(FNm);}}
     if (Append){FileId=fopen(FNm.CStr(), "a+b");}
     else {FileId=fopen(FNm.CStr(), "w+b");}
     OpenedP=(FileId!=NULL);
@@ -833,6 +837,7 @@ TFRnd::TFRnd(const TStr& _FNm, const TFAccess& FAccess,
   FileId(NULL), FNm(_FNm.CStr()),
   RecAct(false), HdLen(_HdLen), RecLen(_RecLen){
   RecAct=(HdLen>=0)&&(RecLen>0);
+  if ((FAccess==faCreate)&&TFJournal::IsOn()){TFJournal::OnTrunc(_FNm);}
   switch (FAccess){
     case faCreate: FileId=fopen(FNm.CStr(), "w+b"); break;
     case faUpdate: FileId=fopen(FNm.CStr(), "r+b"); break;
@@ -842,6 +847,7 @@ TFRnd::TFRnd(const TStr& _FNm, const TFAccess& FAccess,
     default: Fail;
   }
   if ((FileId==NULL)&&(CreateIfNo)){
+    if (TFJournal::IsOn()){TFJournal::OnTrunc(_FNm);}
     FileId=fopen(FNm.CStr(), "w+b");}
   EAssertR(FileId!=NULL, "Can not open file '"+_FNm+"'.");
 }
@@ -908,6 +914,7 @@ void TFRnd::GetBf(void* Bf, const TSize& BfL){
 
 void TFRnd::PutBf(const void* Bf, const TSize& BfL){
   RefreshFPos();
+  if (TFJournal::IsOn()){TFJournal::OnWrite(FNm.CStr(), GetFPos(), BfL);}
   EAssertR(
    fwrite(Bf, 1, BfL, FileId)==BfL,
    "Error writting to the file '"+TStr(FNm)+"'.");
@@ -1123,6 +1130,8 @@ bool TFile::Move(const TStr& SrcFNm, const TStr& DstFNm,
 #endif
 
 bool TFile::Del(const TStr& FNm, const bool& ThrowExceptP){
+  // journal keeps the original by moving it away
+  if (TFJournal::IsOn() && TFJournal::OnTrunc(FNm)){return true;}
   const int ResultCode = remove(FNm.CStr());
   if (ThrowExceptP){
     EAssertR(ResultCode==0, "Error removing file '"+FNm+"'.");
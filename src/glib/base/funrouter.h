@@ -25,6 +25,8 @@ public:
     /// Register new object
     void Register(const TStr& TypeNm, TFun Fun) { TypeNmToFunH.AddDat(TypeNm, Fun); }
     
+    /// Check if we have a function for given type
+    bool IsFun(const TStr& TypeNm) const { return TypeNmToFunH.IsKey(TypeNm); }
     /// Get the function for given type
     TFun Fun(const TStr& TypeNm) {
         if (TypeNmToFunH.IsKey(TypeNm)) { return TypeNmToFunH.GetDat(TypeNm); }
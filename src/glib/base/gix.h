@@ -82,6 +82,62 @@ public:
     friend class TPt<TGixKeyStr<TKey> >;
 };
 
+/////////////////////////////////////////////////
+/// Item Codec.
+/// Tells gix how to compress child vectors. Items of delta-encodable types are
+/// ordered by record id, so child vectors can be stored as variable-byte encoded
+/// differences between consecutive record ids, followed by item data (frequency).
+/// Other item types are stored as plain vectors.
+template <class TItem>
+class TGixItemCodec {
+public:
+    /// Can child vectors with this item type be delta-encoded
+    static bool IsDelta() { return false; }
+    /// Does item carry data next to record id
+    static bool IsDat() { return false; }
+    /// Get record id of the item
+    static uint64 GetId(const TItem& Item) { return 0; }
+    /// Get data of the item
+    static int64 GetDat(const TItem& Item) { return 0; }
+    /// Create item from record id and data
+    static TItem GetItem(const uint64& Id, const int64& Dat) { return TItem(); }
+};
+
+/// Full items: record id and frequency
+template <>
+class TGixItemCodec<TKeyDat<TUInt64, TInt> > {
+public:
+    static bool IsDelta() { return true; }
+    static bool IsDat() { return true; }
+    static uint64 GetId(const TKeyDat<TUInt64, TInt>& Item) { return Item.Key; }
+    static int64 GetDat(const TKeyDat<TUInt64, TInt>& Item) { return Item.Dat; }
+    static TKeyDat<TUInt64, TInt> GetItem(const uint64& Id, const int64& Dat) {
+        return TKeyDat<TUInt64, TInt>(Id, (int)Dat); }
+};
+
+/// Small items: 32-bit record id and 16-bit frequency
+template <>
+class TGixItemCodec<TKeyDat<TUInt, TSInt> > {
+public:
+    static bool IsDelta() { return true; }
+    static bool IsDat() { return true; }
+    static uint64 GetId(const TKeyDat<TUInt, TSInt>& Item) { return Item.Key; }
+    static int64 GetDat(const TKeyDat<TUInt, TSInt>& Item) { return Item.Dat; }
+    static TKeyDat<TUInt, TSInt> GetItem(const uint64& Id, const int64& Dat) {
+        return TKeyDat<TUInt, TSInt>((uint)Id, (int16)Dat); }
+};
+
+/// Tiny items: only 32-bit record id
+template <>
+class TGixItemCodec<TUInt> {
+public:
+    static bool IsDelta() { return true; }
+    static bool IsDat() { return false; }
+    static uint64 GetId(const TUInt& Item) { return Item; }
+    static int64 GetDat(const TUInt& Item) { return 0; }
+    static TUInt GetItem(const uint64& Id, const int64& Dat) { return TUInt((uint)Id); }
+};
+
 /////////////////////////////////////////////////
 /// Item Set.
 /// Holds set of items that correspond to one key. Itemset supports supports splitting of
@@ -144,23 +200,32 @@ private:
     mutable TVec<TChildInfo> ChildInfoV;
     /// optional list of child vector contents - will be populated only for frequent keys
     mutable TVec<TVec<TItem> > ChildV;
+    /// Encoded contents of clean child vectors. Loaded child vector is either kept here
+    /// and decoded on demand, or in ChildV when it needs to be changed.
+    mutable TVec<TMem> ChildMemV;
 
     /// For keeping the items unique and sorted
     TBool MergedP;
     /// Should this itemset be stored to disk?
     TBool DirtyP;
+    /// Memory of the itemset counted in dirty bytes of gix, zero when not dirty
+    uint64 DirtyMem;
 
     /// Pointer to gix used to access storage and merger.
     /// (serialization of self, loading children, notifying about changes...)
     const TGix<TKey, TItem>* Gix;
 
 private:
-    /// Load single child vector into memory if not present already
+    /// Load encoded child vector into memory if not present already
+    void LoadChildMem(const int& ChildN) const;
+    /// Load single child vector into memory if not present already and decode it
     void LoadChildVector(const int& ChildN) const;
     /// Load all child vectors into memory and get pointers to them
     void LoadChildVectors() const;
     /// Refresh total count
     void RecalcTotalCnt();
+    /// Update dirty bytes of gix after the itemset changed or was saved
+    void UpdateDirtyMem();
     /// Check if there are any dirty child vectors with size outside the tolerance
     int FirstDirtyChild();
     /// Get the index of the first child index from which onward the content needs to be merged
@@ -174,14 +239,20 @@ private:
     void PushMergedDataBackToChildren(const int& FirstChildToMerge, const TVec<TItem>& MergedItems);
     /// Process any pending "delete" commands
     void ProcessDeletes();
+    /// Position of the first item in sorted ItemV, starting at ItemN, which is not smaller
+    /// than Item according to the merger. Gallops with TSortedSet::Gallop.
+    int GallopItem(const TVec<TItem>& ItemV, const int& ItemN, const TItem& Item) const;
+    /// Append items from sorted ItemV which also appear in sorted FilterItemV
+    void IntrsItemV(const TVec<TItem>& ItemV, const TVec<TItem>& FilterItemV, TVec<TItem>& ResItemV) const;
 
     /// Ask child vectors about their memory usage
-    uint64 GetChildMemUsed() const { return TMemUtils::GetExtraMemberSize(ChildV); }
+    uint64 GetChildMemUsed() const {
+        return TMemUtils::GetExtraMemberSize(ChildV) + TMemUtils::GetExtraMemberSize(ChildMemV); }
 
 public:
     /// Create empty itemset
     TGixItemSet(const TKey& _ItemSetKey, const TGix<TKey, TItem>* _Gix) :
-        ItemSetKey(_ItemSetKey), TotalCnt(0), MergedP(true), DirtyP(true), Gix(_Gix) {}
+        ItemSetKey(_ItemSetKey), TotalCnt(0), MergedP(true), DirtyP(true), DirtyMem(0), Gix(_Gix) {}
     /// Create empty itemset
     static PGixItemSet New(const TKey& ItemSetKey, const TGix<TKey, TItem>* Gix) {
         return new TGixItemSet(ItemSetKey, Gix); }
@@ -206,8 +277,9 @@ public:
     /// Add new item to the item set. When NotifyCacheOnlyDelta is set to true,
     /// only item set memory footprint differences are sent to gix.
     void AddItem(const TItem& NewItem, const bool& NotifyCacheOnlyDelta = true);
-    /// Add a set of items at once
-    void AddItemV(const TVec<TItem>& NewItemV);
+    /// Add a set of items at once. Items are appended to the work buffer in chunks
+    /// of up to split length, so fullness is checked once per chunk and not per item.
+    void AddItemV(const TVec<TItem>& NewItemV, const bool& NotifyCacheOnlyDelta = true);
 
     /// Check if this itemset is empty
     bool Empty() const { return GetItems() == 0; }
@@ -217,8 +289,14 @@ public:
     const TItem& GetItem(const int& ItemN) const;
     /// Get items into vector
     void GetItemV(TVec<TItem>& _ItemV);
+    /// Get items which also appear in sorted FilterItemV into vector. Child vectors
+    /// which cannot overlap with the filter, based on their min and max item, are not loaded.
+    void GetItemV(const TVec<TItem>& FilterItemV, TVec<TItem>& _ItemV);
     /// Delete specified item from this itemset
     void DelItem(const TItem& Item);
+    /// Delete all items smaller than Item. Child vectors with all items below Item are
+    /// dropped without loading them, only the one spanning Item is loaded and cut.
+    void DelItemsBefore(const TItem& Item);
     /// Clear all items from this itemset
     void Clr();
 
@@ -231,6 +309,8 @@ public:
     bool IsMerged() const { return MergedP; }
     /// Flag if itemset is dirty
     bool IsDirty() const { return DirtyP; }
+    /// Itemset is dropped without saving it, stop counting it as dirty
+    void DropDirty() { DirtyP = false; UpdateDirtyMem(); }
     /// Tests if current itemset is full and subsequent item should be pushed to children
     bool IsFull() const { return (ItemV.Len() >= Gix->GetSplitLen()); }
 
@@ -263,8 +343,23 @@ public:
     TFlt AvgLen;
     /// memory usage for gix
     TUInt64 MemUsed;
+    /// Size of child vectors written to disk over the life of the index, when kept as plain vectors
+    TUInt64 ChildRawSize;
+    /// Size of child vectors written to disk over the life of the index, after encoding
+    TUInt64 ChildEncodedSize;
+    /// Number of itemset reads served from cache
+    TUInt64 CacheHits;
+    /// Number of itemset reads loaded from disk
+    TUInt64 CacheMisses;
 
 public:
+    /// Share of itemset reads served from cache
+    double GetCacheHitRate() const {
+        const uint64 Reads = CacheHits + CacheMisses;
+        return (Reads > 0) ? (double)CacheHits / (double)Reads : 0.0; }
+    /// Ratio between plain and encoded size of child vectors
+    double GetCompressionRatio() const {
+        return (ChildEncodedSize > 0) ? (double)ChildRawSize / (double)ChildEncodedSize : 1.0; }
 
     /// This method combines statistics from to Gix objects
     void Add(const TGixStats& Stats) {
@@ -280,6 +375,10 @@ public:
             NewStats.CacheDirtyLoadedPerc = (CacheDirty * CacheDirtyLoadedPerc + Stats.CacheDirty * Stats.CacheDirtyLoadedPerc) / NewStats.CacheDirty;
         }
         NewStats.MemUsed = MemUsed + Stats.MemUsed;
+        NewStats.ChildRawSize = ChildRawSize + Stats.ChildRawSize;
+        NewStats.ChildEncodedSize = ChildEncodedSize + Stats.ChildEncodedSize;
+        NewStats.CacheHits = CacheHits + Stats.CacheHits;
+        NewStats.CacheMisses = CacheMisses + Stats.CacheMisses;
         // replace this stats with summed up ones
         *this = NewStats;
     }
@@ -317,6 +416,8 @@ private:
     uint64 CacheResetThreshold;
     /// Cache size change since last reset
     mutable uint64 NewCacheSizeInc;
+    /// Memory of dirty item sets, kept up to date by the item sets
+    mutable uint64 DirtyBytes;
     /// flag indicating cache is full
     bool CacheFullP;
 
@@ -332,6 +433,11 @@ private:
 
     /// Internal member for holding statistics
     mutable TGixStats Stats;
+    /// Size of child vectors written over the life of the index, before encoding.
+    /// Saved with the key map, so the ratio survives reopening.
+    mutable uint64 ChildRawSize;
+    /// Size of child vectors written over the life of the index, after encoding
+    mutable uint64 ChildEncodedSize;
 
 private:
     /// Returns pointer to this object. Used in cache call-backs
@@ -347,10 +453,17 @@ private:
     /// Get handle to the merger
     const TGixMerger<TKey, TItem>* GetMerger() const { return Merger; }
 
-    /// Load child vector for given blob pointer from disk
-    void GetChildVector(const TBlobPt& Pt, TVec<TItem>& Dest) const;
-    /// Store child vectors to disk and get back pointer to where it was stored.
-    TBlobPt StoreChildVector(const TBlobPt& ExistingKeyId, const TVec<TItem>& Data) const;
+    /// Encode child vector, using delta encoding of record ids when item type supports it
+    void EncodeChildVector(const TVec<TItem>& Data, TMem& DataMem) const;
+    /// Check if encoded child vector uses delta encoding
+    static bool IsDeltaChildVector(const TMemBase& DataMem);
+    /// Decode child vector and append its items to Dest
+    static void DecodeChildVector(const TMemBase& DataMem, TVec<TItem>& Dest);
+
+    /// Load encoded child vector for given blob pointer from disk
+    void GetChildVector(const TBlobPt& Pt, TMem& DestMem) const;
+    /// Store encoded child vectors to disk and get back pointer to where it was stored.
+    TBlobPt StoreChildVector(const TBlobPt& ExistingKeyId, const TMem& DataMem) const;
     /// Delete child vectors from cache and disk
     void DeleteChildVector(const TBlobPt& KeyId) const;
     /// For enlisting new child vectors into blob
@@ -406,16 +519,22 @@ public:
 
     /// adding new item to the inverted index
     void AddItem(const TKey& Key, const TItem& Item);
-    /// adding new items to the inverted index
+    /// adding new items to the inverted index, loading the item set only once
     void AddItemV(const TKey& Key, const TVec<TItem>& ItemV);
     // delete one item
     void DelItem(const TKey& Key, const TItem& Item);
+    /// delete all items smaller than Item
+    void DelItemsBefore(const TKey& Key, const TItem& Item);
     /// clears items
     void Clr(const TKey& Key);
     /// flush all data from cache to disk
     void Flush() { ItemSetCache.FlushAndClr(); }
     /// flush a portion of data from cache to disk
     int PartialFlush(int WndInMsec = 500);
+    /// save all changes and the key index to disk, index stays open and cached
+    void Save();
+    /// estimate of bytes written when flushing all dirty item sets
+    uint64 GetDirtyBytes() const { return DirtyBytes; }
 
     /// get first key id
     int FFirstKeyId() const { return KeyIdH.FFirstKeyId(); }
@@ -432,6 +551,10 @@ public:
     uint64 GetCacheSize() const { return ItemSetCache.GetMemUsed(); }
     /// Get maximal memory that can be used by the cache
     uint64 GetMxMemUsed() const { return ItemSetCache.GetMxMemUsed(); }
+    /// Change replacement policy of the item set cache
+    void SetCachePolicy(const TCachePolicy& Policy) { ItemSetCache.SetPolicy(Policy); }
+    /// Replacement policy of the item set cache
+    TCachePolicy GetCachePolicy() const { return ItemSetCache.GetPolicy(); }
     /// Is cache full?
     bool IsCacheFull() const { return CacheFullP; }
     /// Refresh current memory computations
@@ -440,6 +563,9 @@ public:
     void AddToNewCacheSizeInc(const uint64& Diff) const { NewCacheSizeInc += Diff; }
     /// Update cache increment (or decrement)
     void AddToNewCacheSizeInc(const uint64& OldSize, const uint64& NewSize) const;
+    /// Update dirty bytes when memory counted for a dirty item set changes
+    void AddToDirtyBytes(const uint64& OldSize, const uint64& NewSize) const {
+        DirtyBytes = DirtyBytes - OldSize + NewSize; }
 
     /// print statistics for index keys
     void SaveTxt(const TStr& FNm, const PGixKeyStr& KeyStr) const;
@@ -542,8 +668,11 @@ public:
     /// Clone expression item
     PGixExpItem Clone() const { return new TGixExpItem(*this); }
 
-    /// Evaluate expression item using given merger and return mathed items
-    bool Eval(const PGix& Gix, TVec<TItem>& ResItemV, const TGixMerger<TKey, TItem>* Merger);
+    /// Evaluate expression item using given merger and return mathed items. When sorted
+    /// FilterItemV is given, the result only needs to be correct for items from the filter,
+    /// which AND uses to skip parts of the posting lists that cannot intersect.
+    bool Eval(const PGix& Gix, TVec<TItem>& ResItemV, const TGixMerger<TKey, TItem>* Merger,
+        const TVec<TItem>* FilterItemV = NULL);
 
     friend class TPt<TGixExpItem>;
 };
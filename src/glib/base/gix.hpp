@@ -28,16 +28,27 @@ uint64 TGixItemSet<TKey, TItem>::TChildInfo::GetMemUsed() const {
 }
 
 template <class TKey, class TItem>
-void TGixItemSet<TKey, TItem>::LoadChildVector(const int& ChildN) const {
+void TGixItemSet<TKey, TItem>::LoadChildMem(const int& ChildN) const {
     if (!ChildInfoV[ChildN].LoadedP) {
-        // load child vector from disk
-        Gix->GetChildVector(ChildInfoV[ChildN].Pt, ChildV[ChildN]);
+        // load encoded child vector from disk
+        Gix->GetChildVector(ChildInfoV[ChildN].Pt, ChildMemV[ChildN]);
         // mark that it is freshly loaded
         ChildInfoV[ChildN].LoadedP = true;
         ChildInfoV[ChildN].DirtyP = false;
     }
 }
 
+template <class TKey, class TItem>
+void TGixItemSet<TKey, TItem>::LoadChildVector(const int& ChildN) const {
+    LoadChildMem(ChildN);
+    // decode if we only have encoded version
+    if (!ChildMemV[ChildN].Empty()) {
+        ChildV[ChildN].Clr();
+        Gix->DecodeChildVector(ChildMemV[ChildN], ChildV[ChildN]);
+        ChildMemV[ChildN].Clr();
+    }
+}
+
 template <class TKey, class TItem>
 void TGixItemSet<TKey, TItem>::LoadChildVectors() const {
     for (int ChildN = 0; ChildN < ChildInfoV.Len(); ChildN++) {
@@ -105,6 +116,7 @@ void TGixItemSet<TKey, TItem>::PushWorkBufferToChildren() {
         ChildInfoV.Add(child_info);
         // add an empty vector to ChildV - the data for this vector will be loaded from the blob when necessary
         ChildV.Add(TVec<TItem>());
+        ChildMemV.Add(TMem());
         ItemV.Del(0, split_len - 1);
         DirtyP = true;
     }
@@ -181,6 +193,7 @@ void TGixItemSet<TKey, TItem>::PushMergedDataBackToChildren(
     while (curr_index < MergedItems.Len()) {
         if (child_index < ChildInfoV.Len() && remaining > Gix->GetSplitLen()) {
             ChildV[child_index].Clr();
+            ChildMemV[child_index].Clr();
             MergedItems.GetSubValV(curr_index, curr_index + Gix->GetSplitLen() - 1, ChildV[child_index]);
             ChildInfoV[child_index].Len = ChildV[child_index].Len();
             ChildInfoV[child_index].MinItem = ChildV[child_index][0];
@@ -208,6 +221,7 @@ void TGixItemSet<TKey, TItem>::PushMergedDataBackToChildren(
     if (child_index < ChildInfoV.Len()) {
         ChildInfoV.Del(child_index, ChildInfoV.Len() - 1);
         ChildV.Del(child_index, ChildV.Len() - 1);
+        ChildMemV.Del(child_index, ChildMemV.Len() - 1);
     }
     DirtyP = true;
 }
@@ -260,10 +274,11 @@ void TGixItemSet<TKey, TItem>::ProcessDeletes() {
 
 template <class TKey, class TItem>
 TGixItemSet<TKey, TItem>::TGixItemSet(TSIn& SIn, const TGix<TKey, TItem>* _Gix):
-    ItemSetKey(SIn), ItemV(SIn), ChildInfoV(SIn), MergedP(true), DirtyP(false), Gix(_Gix) {
+    ItemSetKey(SIn), ItemV(SIn), ChildInfoV(SIn), MergedP(true), DirtyP(false), DirtyMem(0), Gix(_Gix) {
 
     for (int ChildN = 0; ChildN < ChildInfoV.Len(); ChildN++) {
         ChildV.Add(TVec<TItem>());
+        ChildMemV.Add(TMem());
     };
     RecalcTotalCnt();
 }
@@ -275,8 +290,12 @@ void TGixItemSet<TKey, TItem>::Save(TMOut& SOut) {
     // save child vectors separately
     for (int ChildN = 0; ChildN < ChildInfoV.Len(); ChildN++) {
         if (ChildInfoV[ChildN].DirtyP && ChildInfoV[ChildN].LoadedP) {
-            ChildInfoV[ChildN].Pt = Gix->StoreChildVector(ChildInfoV[ChildN].Pt, ChildV[ChildN]);
+            TMem ChildMem; Gix->EncodeChildVector(ChildV[ChildN], ChildMem);
+            ChildInfoV[ChildN].Pt = Gix->StoreChildVector(ChildInfoV[ChildN].Pt, ChildMem);
             ChildInfoV[ChildN].DirtyP = false;
+            // from now on keep only the encoded version, until the child changes again
+            ChildMemV[ChildN] = TMem(ChildMem.GetBf(), ChildMem.Len());
+            ChildV[ChildN].Clr();
         }
     }
 
@@ -286,6 +305,7 @@ void TGixItemSet<TKey, TItem>::Save(TMOut& SOut) {
     ItemV.Save(SOut);
     ChildInfoV.Save(SOut);
     DirtyP = false;
+    UpdateDirtyMem();
 }
 
 template <class TKey, class TItem>
@@ -298,6 +318,7 @@ uint64 TGixItemSet<TKey, TItem>::GetMemUsed() const {
         TMemUtils::GetExtraMemberSize(TotalCnt) +
         TMemUtils::GetExtraMemberSize(ChildInfoV) +
         TMemUtils::GetExtraMemberSize(ChildV) +
+        TMemUtils::GetExtraMemberSize(ChildMemV) +
         TMemUtils::GetExtraMemberSize(MergedP) +
         TMemUtils::GetExtraMemberSize(DirtyP);
 }
@@ -356,13 +377,53 @@ void TGixItemSet<TKey, TItem>::AddItem(const TItem& NewItem, const bool& NotifyC
 
     DirtyP = true;
     TotalCnt++;
+    UpdateDirtyMem();
 }
 
 template <class TKey, class TItem>
-void TGixItemSet<TKey, TItem>::AddItemV(const TVec<TItem>& NewItemV) {
-    for (int i = 0; i < NewItemV.Len(); i++) {
-        AddItem(NewItemV[i]);
+void TGixItemSet<TKey, TItem>::AddItemV(const TVec<TItem>& NewItemV, const bool& NotifyCacheOnlyDelta) {
+    // report the base size of a new itemset, same as AddItem
+    if (NotifyCacheOnlyDelta == false) {
+        Gix->AddToNewCacheSizeInc(GetMemUsed());
     }
+
+    int NewItemN = 0;
+    while (NewItemN < NewItemV.Len()) {
+        if (IsFull()) {
+            // same cleanup as in AddItem, done once per chunk
+            const uint64 OldSize = GetMemUsed();
+            Def();
+            if (IsFull()) {
+                PushWorkBufferToChildren();
+            }
+            RecalcTotalCnt();
+            Gix->AddToNewCacheSizeInc(OldSize, GetMemUsed());
+        }
+        // number of items that still fit into the work buffer
+        const int ChunkLen = TInt::GetMn(NewItemV.Len() - NewItemN, Gix->GetSplitLen() - ItemV.Len());
+        const int EndItemN = NewItemN + ChunkLen;
+        if (MergedP) {
+            // itemset remains merged if the chunk is sorted and starts after the last item
+            if (ItemV.Len() == 0 && ChildInfoV.Len() != 0) {
+                MergedP = Gix->GetMerger()->IsLt(ChildInfoV.Last().MaxItem, NewItemV[NewItemN]);
+            } else if (ItemV.Len() != 0) {
+                MergedP = Gix->GetMerger()->IsLt(ItemV.Last(), NewItemV[NewItemN]);
+            }
+            for (int ItemN = NewItemN + 1; MergedP && ItemN < EndItemN; ItemN++) {
+                MergedP = Gix->GetMerger()->IsLt(NewItemV[ItemN - 1], NewItemV[ItemN]);
+            }
+        }
+        const uint64 OldItemVSize = ItemV.GetMemUsed();
+        ItemV.Reserve(ItemV.Len() + ChunkLen);
+        for (int ItemN = NewItemN; ItemN < EndItemN; ItemN++) {
+            ItemV.Add(NewItemV[ItemN]);
+        }
+        Gix->AddToNewCacheSizeInc(OldItemVSize, ItemV.GetMemUsed());
+        TotalCnt += ChunkLen;
+        NewItemN = EndItemN;
+    }
+    DirtyP = true;
+    UpdateDirtyMem();
 }
 
 template <class TKey, class TItem>
@@ -383,17 +444,73 @@ const TItem& TGixItemSet<TKey, TItem>::GetItem(const int& ItemN) const {
 template <class TKey, class TItem>
 void TGixItemSet<TKey, TItem>::GetItemV(TVec<TItem>& _ItemV) {
     if (ChildInfoV.Len() > 0) {
-        // collect data from child itemsets
-        LoadChildVectors();
+        // collect data from child itemsets, encoded ones are decoded
+        // directly into result without keeping decoded copy around
         for (int i = 0; i < ChildInfoV.Len(); i++) {
-            //_ItemV.AddVMemCpy(ChildV[i]);
-            _ItemV.AddV(ChildV[i]);
+            LoadChildMem(i);
+            if (!ChildMemV[i].Empty()) {
+                Gix->DecodeChildVector(ChildMemV[i], _ItemV);
+            } else {
+                //_ItemV.AddVMemCpy(ChildV[i]);
+                _ItemV.AddV(ChildV[i]);
+            }
         }
     }
     //_ItemV.AddVMemCpy(ItemV);
     _ItemV.AddV(ItemV);
 }
 
+template <class TKey, class TItem>
+void TGixItemSet<TKey, TItem>::GetItemV(const TVec<TItem>& FilterItemV, TVec<TItem>& _ItemV) {
+    // merge so children and work buffer are sorted and do not overlap
+    Def();
+    const TGixMerger<TKey, TItem>* Merger = Gix->GetMerger();
+    TVec<TItem> DecodedItemV; int FilterN = 0;
+    for (int ChildN = 0; ChildN < ChildInfoV.Len(); ChildN++) {
+        // skip filter items smaller than anything in this child
+        FilterN = GallopItem(FilterItemV, FilterN, ChildInfoV[ChildN].MinItem);
+        if (FilterN == FilterItemV.Len()) { break; }
+        // skip child without loading when next filter item is past its range
+        if (Merger->IsLt(ChildInfoV[ChildN].MaxItem, FilterItemV[FilterN])) { continue; }
+        LoadChildMem(ChildN);
+        if (!ChildMemV[ChildN].Empty()) {
+            DecodedItemV.Clr(false);
+            Gix->DecodeChildVector(ChildMemV[ChildN], DecodedItemV);
+            IntrsItemV(DecodedItemV, FilterItemV, _ItemV);
+        } else {
+            IntrsItemV(ChildV[ChildN], FilterItemV, _ItemV);
+        }
+    }
+    IntrsItemV(ItemV, FilterItemV, _ItemV);
+}
+
+template <class TKey, class TItem>
+int TGixItemSet<TKey, TItem>::GallopItem(const TVec<TItem>& _ItemV, const int& ItemN, const TItem& Item) const {
+    // items are ordered by the merger, which need not match operator<
+    const TGixMerger<TKey, TItem>* Merger = Gix->GetMerger();
+    return TSortedSet::Gallop(_ItemV.BegI(), _ItemV.Len(), ItemN,
+        [Merger, &Item](const TItem& ValItem) { return Merger->IsLt(ValItem, Item); });
+}
+
+template <class TKey, class TItem>
+void TGixItemSet<TKey, TItem>::IntrsItemV(const TVec<TItem>& _ItemV,
+        const TVec<TItem>& FilterItemV, TVec<TItem>& ResItemV) const {
+
+    const TGixMerger<TKey, TItem>* Merger = Gix->GetMerger();
+    int ItemN = 0, FilterN = 0;
+    while (ItemN < _ItemV.Len() && FilterN < FilterItemV.Len()) {
+        const TItem& Item = _ItemV[ItemN];
+        const TItem& FilterItem = FilterItemV[FilterN];
+        if (Merger->IsLt(Item, FilterItem)) {
+            ItemN = GallopItem(_ItemV, ItemN + 1, FilterItem);
+        } else if (Merger->IsLt(FilterItem, Item)) {
+            FilterN = GallopItem(FilterItemV, FilterN + 1, Item);
+        } else {
+            ResItemV.Add(Item); ItemN++; FilterN++;
+        }
+    }
+}
+
 template <class TKey, class TItem>
 void TGixItemSet<TKey, TItem>::DelItem(const TItem& Item) {
     if (IsFull()) {
@@ -414,6 +531,51 @@ void TGixItemSet<TKey, TItem>::DelItem(const TItem& Item) {
     MergedP = false;
     DirtyP = true;
     TotalCnt++;
+    UpdateDirtyMem();
+}
+
+template <class TKey, class TItem>
+void TGixItemSet<TKey, TItem>::DelItemsBefore(const TItem& Item) {
+    const uint64 OldSize = GetMemUsed();
+    // pending deletes and unmerged items must be settled first
+    Def();
+    const TGixMerger<TKey, TItem>* Merger = Gix->GetMerger();
+    // drop leading child vectors which end before the item
+    int DelChildren = 0;
+    while (DelChildren < ChildInfoV.Len() && Merger->IsLt(ChildInfoV[DelChildren].MaxItem, Item)) {
+        Gix->DeleteChildVector(ChildInfoV[DelChildren].Pt);
+        DelChildren++;
+    }
+    if (DelChildren > 0) {
+        ChildInfoV.Del(0, DelChildren - 1);
+        ChildV.Del(0, DelChildren - 1);
+        ChildMemV.Del(0, DelChildren - 1);
+    }
+    // cut the child vector spanning the item, first child is allowed to be short
+    if (!ChildInfoV.Empty() && Merger->IsLt(ChildInfoV[0].MinItem, Item)) {
+        LoadChildVector(0);
+        TVec<TItem>& FirstChildV = ChildV[0];
+        // min and max are not updated by deletes, so the cut can also be empty or complete
+        const int DelItems = GallopItem(FirstChildV, 0, Item);
+        if (DelItems > 0) { FirstChildV.Del(0, DelItems - 1); }
+        if (FirstChildV.Empty()) {
+            Gix->DeleteChildVector(ChildInfoV[0].Pt);
+            ChildInfoV.Del(0);
+            ChildV.Del(0);
+            ChildMemV.Del(0);
+        } else {
+            ChildInfoV[0].MinItem = FirstChildV[0];
+            ChildInfoV[0].Len = FirstChildV.Len();
+            ChildInfoV[0].DirtyP = true;
+        }
+    }
+    // work buffer is merged, so also sorted
+    const int DelItems = GallopItem(ItemV, 0, Item);
+    if (DelItems > 0) { ItemV.Del(0, DelItems - 1); }
+    RecalcTotalCnt();
+    DirtyP = true;
+    Gix->AddToNewCacheSizeInc(OldSize, GetMemUsed());
+    UpdateDirtyMem();
 }
 
 template <class TKey, class TItem>
@@ -424,6 +586,7 @@ void TGixItemSet<TKey, TItem>::Clr() {
             Gix->DeleteChildVector(ChildInfoV[i].Pt);
         }
         ChildV.Clr();
+        ChildMemV.Clr();
         ChildInfoV.Clr();
     }
     ItemV.Clr();
@@ -432,6 +595,7 @@ void TGixItemSet<TKey, TItem>::Clr() {
     DirtyP = true;
     TotalCnt = 0;
     Gix->AddToNewCacheSizeInc(OldSize, GetMemUsed());
+    UpdateDirtyMem();
 }
 
 template <class TKey, class TItem>
@@ -469,10 +633,12 @@ void TGixItemSet<TKey, TItem>::Def() {
             // remove it from memory
             ChildInfoV.Del(0);
             ChildV.Del(0);
+            ChildMemV.Del(0);
         }
 
         RecalcTotalCnt();
         MergedP = true;
+        UpdateDirtyMem();
     }
 }
 
@@ -494,10 +660,19 @@ void TGixItemSet<TKey, TItem>::DefLocal() {
             // update the total count - since we have only been modifying the ItemV we can simply
             // update the total count by comparing previous and current number of items in ItemV
             TotalCnt = TotalCnt - OldItemVLen + ItemV.Len();
+            UpdateDirtyMem();
         }
     }
 }
 
+template <class TKey, class TItem>
+void TGixItemSet<TKey, TItem>::UpdateDirtyMem() {
+    // count the whole itemset while dirty, so gix can report dirty bytes without a scan
+    const uint64 NewDirtyMem = DirtyP ? GetMemUsed() : 0;
+    Gix->AddToDirtyBytes(DirtyMem, NewDirtyMem);
+    DirtyMem = NewDirtyMem;
+}
+
 template <class TKey, class TItem>
 double TGixItemSet<TKey, TItem>::GetLoadedPerc() const {
     int LoadedCount = 0;
@@ -559,22 +734,100 @@ TBlobPt TGix<TKey, TItem>::GetKeyId(const TKey& Key) const {
 }
 
 template <class TKey, class TItem>
-void TGix<TKey, TItem>::GetChildVector(const TBlobPt& KeyId, TVec<TItem>& Dest) const {
-    if (KeyId.Empty()) { return; }
+void TGix<TKey, TItem>::EncodeChildVector(const TVec<TItem>& Data, TMem& DataMem) const {
+    typedef TGixItemCodec<TItem> TCodec;
+    // delta encoding only works on vectors sorted by record id
+    bool DeltaP = TCodec::IsDelta();
+    for (int ItemN = 1; DeltaP && ItemN < Data.Len(); ItemN++) {
+        DeltaP = TCodec::GetId(Data[ItemN - 1]) <= TCodec::GetId(Data[ItemN]);
+    }
+    if (DeltaP) {
+        // header: negative marker, which cannot appear at the start of plain
+        // vector serialization, followed by number of items
+        const int Marker = -1, Len = Data.Len();
+        DataMem.Reserve(2 * sizeof(int) + Data.Len() * (TCodec::IsDat() ? 3 : 2));
+        DataMem.AddBf(&Marker, sizeof(int));
+        DataMem.AddBf(&Len, sizeof(int));
+        // record id deltas and data as variable-byte integers, 7 bits per byte
+        uchar Bf[20]; uint64 PrevId = 0;
+        for (int ItemN = 0; ItemN < Data.Len(); ItemN++) {
+            const TItem& Item = Data[ItemN];
+            const uint64 Id = TCodec::GetId(Item);
+            uint64 Val = Id - PrevId; int BfL = 0;
+            while (Val >= 0x80) { Bf[BfL++] = (uchar)(Val | 0x80); Val >>= 7; }
+            Bf[BfL++] = (uchar)Val;
+            if (TCodec::IsDat()) {
+                // zig-zag so small negative values also take few bytes
+                const int64 Dat = TCodec::GetDat(Item);
+                Val = ((uint64)Dat << 1) ^ (uint64)(Dat >> 63);
+                while (Val >= 0x80) { Bf[BfL++] = (uchar)(Val | 0x80); Val >>= 7; }
+                Bf[BfL++] = (uchar)Val;
+            }
+            DataMem.AddBf(Bf, BfL);
+            PrevId = Id;
+        }
+    } else {
+        TMOut MOut;
+        Data.Save(MOut);
+        DataMem = TMem(MOut.GetBfAddr(), MOut.Len());
+    }
+    // remember sizes for statistics
+    ChildRawSize += 2 * sizeof(int) + Data.Len() * sizeof(TItem);
+    ChildEncodedSize += DataMem.Len();
+}
+
+template <class TKey, class TItem>
+bool TGix<TKey, TItem>::IsDeltaChildVector(const TMemBase& DataMem) {
+    if (DataMem.Len() < (int)sizeof(int)) { return false; }
+    int Marker; memcpy(&Marker, DataMem.GetBf(), sizeof(int));
+    return Marker == -1;
+}
+
+template <class TKey, class TItem>
+void TGix<TKey, TItem>::DecodeChildVector(const TMemBase& DataMem, TVec<TItem>& Dest) {
+    typedef TGixItemCodec<TItem> TCodec;
+    if (IsDeltaChildVector(DataMem)) {
+        const uchar* Bf = (const uchar*)DataMem.GetBf() + sizeof(int);
+        int Len; memcpy(&Len, Bf, sizeof(int)); Bf += sizeof(int);
+        // grow geometrically, children are usually decoded one after another into same vector
+        if (Dest.Reserved() < Dest.Len() + Len) { Dest.Reserve(MAX(Dest.Len() + Len, 2 * Dest.Reserved())); }
+        uint64 Id = 0;
+        for (int ItemN = 0; ItemN < Len; ItemN++) {
+            uint64 Val = 0; int Shift = 0;
+            while (*Bf & 0x80) { Val |= (uint64)(*Bf++ & 0x7F) << Shift; Shift += 7; }
+            Val |= (uint64)(*Bf++) << Shift;
+            Id += Val;
+            int64 Dat = 0;
+            if (TCodec::IsDat()) {
+                Val = 0; Shift = 0;
+                while (*Bf & 0x80) { Val |= (uint64)(*Bf++ & 0x7F) << Shift; Shift += 7; }
+                Val |= (uint64)(*Bf++) << Shift;
+                Dat = (int64)(Val >> 1) ^ -(int64)(Val & 1);
+            }
+            Dest.Add(TCodec::GetItem(Id, Dat));
+        }
+    } else if (!DataMem.Empty()) {
+        // plain vector, also used by indexes written before delta encoding
+        TMIn MIn(DataMem.GetBf(), DataMem.Len(), false);
+        TVec<TItem> ItemV; ItemV.Load(MIn);
+        Dest.AddV(ItemV);
+    }
+}
+
+template <class TKey, class TItem>
+void TGix<TKey, TItem>::GetChildVector(const TBlobPt& KeyId, TMem& DestMem) const {
+    if (KeyId.Empty()) { DestMem.Clr(); return; }
     PSIn ItemSetSIn = ItemSetBlobBs->GetBlob(KeyId);
-    Dest.Load(*ItemSetSIn);
+    TMem::LoadMem(ItemSetSIn, DestMem);
 }
 
 template <class TKey, class TItem>
-TBlobPt TGix<TKey, TItem>::StoreChildVector(const TBlobPt& ExistingKeyId, const TVec<TItem>& Data) const {
+TBlobPt TGix<TKey, TItem>::StoreChildVector(const TBlobPt& ExistingKeyId, const TMem& DataMem) const {
     // check if we are allowed to write
     AssertReadOnly();
     // store the current version to the blob
-    TMOut MOut;
-    //Data.SaveMemCpy(MOut);
-    Data.Save(MOut);
     int ReleasedSize;
-    return ItemSetBlobBs->PutBlob(ExistingKeyId, MOut.GetSIn(), ReleasedSize);
+    return ItemSetBlobBs->PutBlob(ExistingKeyId, DataMem.GetSIn(), ReleasedSize);
 }
 
 template <class TKey, class TItem>
@@ -586,9 +839,8 @@ void TGix<TKey, TItem>::DeleteChildVector(const TBlobPt& KeyId) const {
 template <class TKey, class TItem>
 TBlobPt TGix<TKey, TItem>::EnlistChildVector(const TVec<TItem>& Data) const {
     AssertReadOnly(); // check if we are allowed to write
-    TMOut MOut;
-    Data.Save(MOut);
-    TBlobPt res = ItemSetBlobBs->PutBlob(MOut.GetSIn());
+    TMem DataMem; EncodeChildVector(Data, DataMem);
+    TBlobPt res = ItemSetBlobBs->PutBlob(DataMem.GetSIn());
     return res;
 }
 
@@ -601,6 +853,10 @@ void TGix<TKey, TItem>::RefreshStats() const {
     Stats.AvgLen = 0;
 
     Stats.MemUsed = this->GetMemUsed();
+    Stats.ChildRawSize = ChildRawSize;
+    Stats.ChildEncodedSize = ChildEncodedSize;
+    Stats.CacheHits = ItemSetCache.GetHits();
+    Stats.CacheMisses = ItemSetCache.GetMisses();
     TBlobPt BlobPt; PGixItemSet ItemSet;
     void* KeyDatP = ItemSetCache.FFirstKeyDat();
     while (ItemSetCache.FNextKeyDat(KeyDatP, BlobPt, ItemSet)) {
@@ -628,7 +884,7 @@ TGix<TKey, TItem>::TGix(const TStr& Nm, const TStr& FPath, const TFAccess& _Acce
     const bool _FirstChildBeUnfilledP, const int _SplitLenMin, const int _SplitLenMax) :
         Access(_Access), Merger(_Merger), ItemSetCache(CacheSize, 1000000, GetVoidThis()),
         SplitLen(_SplitLen), SplitLenMin(_SplitLenMin), SplitLenMax(_SplitLenMax),
-        FirstChildBeUnfilledP(_FirstChildBeUnfilledP) {
+        FirstChildBeUnfilledP(_FirstChildBeUnfilledP), ChildRawSize(0), ChildEncodedSize(0) {
 
     // prepare filenames of the GIX datastore
     GixFNm = TStr::GetNrFPath(FPath) + Nm.GetFBase() + ".Gix";
@@ -642,12 +898,15 @@ TGix<TKey, TItem>::TGix(const TStr& Nm, const TStr& FPath, const TFAccess& _Acce
         EAssert((Access == faUpdate) || (Access == faRdOnly) || (Access == faRestore));
         // load Gix from GixFNm
         TFIn FIn(GixFNm); KeyIdH.Load(FIn);
+        // child vector sizes, missing in indexes saved before they were kept
+        if (!FIn.Eof()) { ChildRawSize = TUInt64(FIn); ChildEncodedSize = TUInt64(FIn); }
         // load ItemSets from GixBlobFNm
         ItemSetBlobBs = TMBlobBs::New(GixBlobFNm, Access);
     }
     // we do recounting after 10% change of the cache size
     CacheResetThreshold = int64(0.1 * double(CacheSize));
     NewCacheSizeInc = 0;
+    DirtyBytes = 0;
     CacheFullP = false;
 }
 
@@ -658,6 +917,7 @@ TGix<TKey, TItem>::~TGix() {
         ItemSetCache.Flush();
         // save the rest to GixFNm
         TFOut FOut(GixFNm); KeyIdH.Save(FOut);
+        TUInt64(ChildRawSize).Save(FOut); TUInt64(ChildEncodedSize).Save(FOut);
     }
 }
 
@@ -674,13 +934,13 @@ TPt<TGixItemSet<TKey, TItem> > TGix<TKey, TItem>::GetItemSet(const TBlobPt& KeyI
         return TGixItemSet<TKey, TItem>::New(TKey(), this);
     }
     PGixItemSet ItemSet;
-    if (!ItemSetCache.Get(KeyId, ItemSet)) {
+    // lookup also brings the itemset to the top of the cache
+    if (!ItemSetCache.Lookup(KeyId, ItemSet)) {
         // have to load it from the hard drive...
         PSIn ItemSetSIn = ItemSetBlobBs->GetBlob(KeyId);
         ItemSet = TGixItemSet<TKey, TItem>::Load(*ItemSetSIn, this);
+        ItemSetCache.Put(KeyId, ItemSet);
     }
-    // bring the itemset to the top of the cache
-    ItemSetCache.Put(KeyId, ItemSet);
     return ItemSet;
 }
 
@@ -698,6 +958,7 @@ TBlobPt TGix<TKey, TItem>::StoreItemSet(const TBlobPt& KeyId) {
     ItemSet->Def();
     if (ItemSet->Empty()) {
         // itemset is empty after all deletes were processed => remove it
+        ItemSet->DropDirty();
         ItemSetBlobBs->DelBlob(KeyId);
         KeyIdH.DelKey(ItemSet->GetKey());
         return TBlobPt(); // return NULL pointer
@@ -719,6 +980,8 @@ void TGix<TKey, TItem>::DeleteItemSet(const TKey& Key) {
     AssertReadOnly(); // check if we are allowed to write
     if (IsKey(Key)) {
         TBlobPt Pt = KeyIdH.GetDat(Key);
+        PGixItemSet ItemSet;
+        if (ItemSetCache.Get(Pt, ItemSet)) { ItemSet->DropDirty(); }
         ItemSetCache.Del(Pt, false);
         ItemSetBlobBs->DelBlob(Pt);
         KeyIdH.DelKey(Key);
@@ -767,9 +1030,10 @@ void TGix<TKey, TItem>::AddItemV(const TKey& Key, const TVec<TItem>& ItemV) {
     } else {
         // we don't have this key, create a new itemset and add new item immidiatelly
         PGixItemSet ItemSet = TGixItemSet<TKey, TItem>::New(Key, this);
-        ItemSet->AddItemV(ItemV);
+        ItemSet->AddItemV(ItemV, false);
         TBlobPt KeyId = EnlistItemSet(ItemSet); // now store this itemset to disk
         KeyIdH.AddDat(Key, KeyId); // remember the new key and its Id
+        ItemSetCache.Put(KeyId, ItemSet); // add it to cache
     }
     // check if we have to drop anything from the cache
     RefreshMemUsed();
@@ -789,6 +1053,20 @@ void TGix<TKey, TItem>::DelItem(const TKey& Key, const TItem& Item) {
     }
 }
 
+template <class TKey, class TItem>
+void TGix<TKey, TItem>::DelItemsBefore(const TKey& Key, const TItem& Item) {
+    AssertReadOnly(); // check if we are allowed to write
+    if (IsKey(Key)) { // check if this key exists
+        // load the current item set
+        PGixItemSet ItemSet = GetItemSet(Key);
+        // cut the items from the ItemSet
+        ItemSet->DelItemsBefore(Item);
+        if (ItemSet->Empty()) {
+            DeleteItemSet(Key);
+        }
+    }
+}
+
 template <class TKey, class TItem>
 void TGix<TKey, TItem>::Clr(const TKey& Key) {
     AssertReadOnly(); // check if we are allowed to write
@@ -827,6 +1105,17 @@ int TGix<TKey, TItem>::PartialFlush(int WndInMsec) {
     return Changes;
 }
 
+template <class TKey, class TItem>
+void TGix<TKey, TItem>::Save() {
+    if ((Access == faCreate) || (Access == faUpdate)) {
+        // store all dirty item sets, keeping the cache keys in sync with blob pointers
+        PartialFlush(TInt::Mx);
+        ItemSetBlobBs->Flush();
+        TFOut FOut(GixFNm); KeyIdH.Save(FOut);
+        TUInt64(ChildRawSize).Save(FOut); TUInt64(ChildEncodedSize).Save(FOut);
+    }
+}
+
 template <class TKey, class TItem>
 int64 TGix<TKey, TItem>::GetMemUsed() const {
     int64 res = sizeof(TCRef);
@@ -1027,15 +1316,16 @@ TPt<TGixExpItem<TKey, TItem> > TGixExpItem<TKey, TItem>::NewOrV(const TVec<TKey>
 
 template <class TKey, class TItem>
 bool TGixExpItem<TKey, TItem>::Eval(const TPt<TGix<TKey, TItem> >& Gix,
-    TVec<TItem>& ResItemV, const TGixMerger<TKey, TItem>* Merger) {
+        TVec<TItem>& ResItemV, const TGixMerger<TKey, TItem>* Merger,
+        const TVec<TItem>* FilterItemV) {
 
     // prepare place for result
     ResItemV.Clr();
     if (ExpType == getOr) {
         EAssert(!LeftExpItem.Empty() && !RightExpItem.Empty());
         TVec<TItem> RightItemV;
-        const bool NotLeft = LeftExpItem->Eval(Gix, ResItemV, Merger);
-        const bool NotRight = RightExpItem->Eval(Gix, RightItemV, Merger);
+        const bool NotLeft = LeftExpItem->Eval(Gix, ResItemV, Merger, FilterItemV);
+        const bool NotRight = RightExpItem->Eval(Gix, RightItemV, Merger, FilterItemV);
         if (NotLeft && NotRight) {
             Merger->Intrs(ResItemV, RightItemV);
         } else if (!NotLeft && !NotRight) {
@@ -1052,9 +1342,27 @@ bool TGixExpItem<TKey, TItem>::Eval(const TPt<TGix<TKey, TItem> >& Gix,
         return (NotLeft || NotRight);
     } else if (ExpType == getAnd) {
         EAssert(!LeftExpItem.Empty() && !RightExpItem.Empty());
-        TVec<TItem> RightItemV;
-        const bool NotLeft = LeftExpItem->Eval(Gix, ResItemV, Merger);
-        const bool NotRight = RightExpItem->Eval(Gix, RightItemV, Merger);
+        // evaluate one side first and, unless negated, use its result to restrict the
+        // other side; of two keys we start with the shorter one, and a single key goes
+        // second so it can skip its child vectors
+        bool LeftFirstP = true;
+        if (LeftExpItem->ExpType == getKey && RightExpItem->ExpType == getKey) {
+            LeftFirstP = Gix->GetItemSet(LeftExpItem->Key)->GetItems() <=
+                Gix->GetItemSet(RightExpItem->Key)->GetItems();
+        } else if (LeftExpItem->ExpType == getKey) {
+            LeftFirstP = false;
+        }
+        const PGixExpItem& FirstExpItem = LeftFirstP ? LeftExpItem : RightExpItem;
+        const PGixExpItem& SecondExpItem = LeftFirstP ? RightExpItem : LeftExpItem;
+        TVec<TItem> FirstItemV, SecondItemV;
+        const bool NotFirst = FirstExpItem->Eval(Gix, FirstItemV, Merger, FilterItemV);
+        const bool NotSecond = SecondExpItem->Eval(Gix, SecondItemV, Merger,
+            NotFirst ? FilterItemV : &FirstItemV);
+        // keep left and right in their places for the merger
+        TVec<TItem>& RightItemV = LeftFirstP ? SecondItemV : FirstItemV;
+        if (LeftFirstP) { ResItemV.Swap(FirstItemV); } else { ResItemV.Swap(SecondItemV); }
+        const bool NotLeft = LeftFirstP ? NotFirst : NotSecond;
+        const bool NotRight = LeftFirstP ? NotSecond : NotFirst;
         if (NotLeft && NotRight) {
             Merger->Union(ResItemV, RightItemV);
         } else if (!NotLeft && !NotRight) {
@@ -1066,15 +1374,21 @@ bool TGixExpItem<TKey, TItem>::Eval(const TPt<TGix<TKey, TItem> >& Gix,
         }
         return (NotLeft && NotRight);
     } else if (ExpType == getKey) {
+        // nothing can match an empty filter
+        if (FilterItemV != NULL && FilterItemV->Empty()) { return false; }
         PGixItemSet ItemSet = Gix->GetItemSet(Key);
         if (!ItemSet.Empty()) {
             ItemSet->Def();
-            ItemSet->GetItemV(ResItemV);
+            if (FilterItemV == NULL) {
+                ItemSet->GetItemV(ResItemV);
+            } else {
+                ItemSet->GetItemV(*FilterItemV, ResItemV);
+            }
             Merger->Def(ItemSet->GetKey(), ResItemV);
         }
         return false;
     } else if (ExpType == getNot) {
-        return !RightExpItem->Eval(Gix, ResItemV, Merger);
+        return !RightExpItem->Eval(Gix, ResItemV, Merger, FilterItemV);
     } else if (ExpType == getEmpty) {
         return false; // return nothing
     }
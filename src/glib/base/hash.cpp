@@ -110,3 +110,19 @@ int TStrHashF_Md5::GetSecHashCd(const TStr& s) {
   TMd5Sig sig(s);
   return sig.GetSecHashCd();
 }
+
+/////////////////////////////////////////////////
+// Cache-Policy
+TStr TCachePolicyStr::GetStr(const TCachePolicy& Policy) {
+  switch (Policy) {
+    case cpLru: return "lru";
+    case cp2Q: return "2q";
+    default: FailR("Unknown cache policy."); return TStr();
+  }
+}
+
+TCachePolicy TCachePolicyStr::GetPolicy(const TStr& PolicyStr) {
+  if (PolicyStr == "lru") { return cpLru; }
+  if (PolicyStr == "2q") { return cp2Q; }
+  throw TExcept::New("Unknown cache policy: " + PolicyStr);
+}
@@ -1028,59 +1028,203 @@ typedef TStrHash<TInt> TStrSH;
 typedef TStrHash<TInt> TStrIntSH;
 typedef TStrHash<TIntV> TStrToIntVSH;
 
+/////////////////////////////////////////////////
+// Cache-Policy
+/// Replacement policy of caches
+typedef enum {
+    cpLru = 0, ///< least recently used entry is dropped first
+    cp2Q = 1   ///< 2Q, new entries wait in a FIFO queue and enter the main LRU
+               ///< list only when they are requested again after being dropped
+} TCachePolicy;
+
+/// Names of the cache policies
+class TCachePolicyStr {
+public:
+    /// Name of the policy
+    static TStr GetStr(const TCachePolicy& Policy);
+    /// Parse policy from its name
+    static TCachePolicy GetPolicy(const TStr& PolicyStr);
+};
+
+/////////////////////////////////////////////////
+// Cache-Ghost-Queue
+/// Keys recently dropped from a cache, without their data. Kept in FIFO
+/// order, used by 2Q to recognize keys that are requested again.
+template <class TKey, class THashFunc = TDefaultHashFunc<TKey> >
+class TCacheGhostQ {
+private:
+    typedef TLstNd<TKey>* TKeyLN;
+    TLst<TKey> KeyL;
+    THash<TKey, TKeyLN, THashFunc> KeyH;
+public:
+    /// Remember dropped key, forget the oldest ones above MxKeys
+    void Add(const TKey& Key, const int& MxKeys) {
+        if (KeyH.IsKey(Key)) { return; }
+        KeyH.AddDat(Key, KeyL.AddFront(Key));
+        while (KeyL.Len() > MxKeys) { KeyH.DelKey(KeyL.LastVal()); KeyL.DelLast(); }
+    }
+    /// Forget the key, returns true when it was remembered
+    bool Del(const TKey& Key) {
+        const int KeyId = KeyH.GetKeyId(Key);
+        if (KeyId == -1) { return false; }
+        KeyL.Del(KeyH[KeyId]); KeyH.DelKeyId(KeyId);
+        return true;
+    }
+    bool IsKey(const TKey& Key) const { return KeyH.IsKey(Key); }
+    int Len() const { return KeyL.Len(); }
+    void Clr() { KeyL.Clr(); KeyH.Clr(); }
+    uint64 GetMemUsed() const {
+        // list nodes are owned by the list, hash only points to them
+        return sizeof(TCacheGhostQ) +
+               TMemUtils::GetExtraMemberSize(KeyL) +
+               (uint64)KeyH.GetPorts() * sizeof(TInt) +
+               (uint64)KeyH.GetReservedKeyIds() * sizeof(THashKeyDat<TKey, TKeyLN>);
+    }
+};
+
 /////////////////////////////////////////////////
 // Cache
+/// Memory-bounded cache. Entries are dropped according to the policy, with
+/// OnDelFromCache called on the data. While a scan is open (StartScan), new
+/// entries are added as the first to be dropped and hits do not refresh
+/// entries, so bulk reads do not push out the working set.
 template <class TKey, class TDat, class THashFunc = TDefaultHashFunc<TKey> >
 class TCache {
 public:
     typedef TLstNd<TKey>* TKeyLN;
 private:
     typedef TLst<TKey> TKeyL;
-    typedef TPair<TKeyLN, TDat> TKeyLNDatPr;
+    /// lists holding the entries
+    enum { klMain = 0, klIn = 1, klInScan = 2 };
+    /// Cache entry
+    class TKeyLNDat {
+    public:
+        /// node in the list holding the entry
+        TKeyLN KeyLN;
+        TDat Dat;
+        /// list holding the entry
+        TInt KeyLId;
+        /// memory counted for the entry when added, data can grow after that
+        TInt64 MemUsed;
+
+        TKeyLNDat(): KeyLN(NULL) {}
+        TKeyLNDat(const TKeyLN& _KeyLN, const TDat& _Dat, const int& _KeyLId, const int64& _MemUsed):
+            KeyLN(_KeyLN), Dat(_Dat), KeyLId(_KeyLId), MemUsed(_MemUsed) {}
+        uint64 GetMemUsed() const {
+            return sizeof(TKeyLNDat) +
+                   TMemUtils::GetExtraMemberSize(KeyLN) +
+                   TMemUtils::GetExtraMemberSize(Dat);
+        }
+    };
+
+    TCachePolicy Policy;
     int64 MxMemUsed;
     int64 CurMemUsed;
-    THash<TKey, TKeyLNDatPr, THashFunc> KeyDatH;
+    /// memory used by entries in the FIFO queue
+    int64 InMemUsed;
+    THash<TKey, TKeyLNDat, THashFunc> KeyDatH;
+    /// main list, most recently used first
     TKeyL TimeKeyL;
+    /// FIFO queue of entries requested once (2Q), newest first
+    TKeyL InKeyL;
+    /// keys recently dropped from the FIFO queue (2Q)
+    TCacheGhostQ<TKey, THashFunc> GhostQ;
+    /// number of open scans
+    int ScanN;
+    /// number of lookups found in the cache
+    uint64 Hits;
+    /// number of lookups not found in the cache
+    uint64 Misses;
     void* RefToBs;
+
+    /// key of the entry to be dropped next
+    const TKey& GetVictimKey() const;
+    /// refresh entry after a hit
+    void Touch(TKeyLNDat& KeyLNDat);
     void Purge(const int64& MemToPurge);
 public:
-    TCache() {}
+    TCache(): Policy(cpLru), InMemUsed(0), ScanN(0), Hits(0), Misses(0) {}
     TCache(const TCache&);
-    TCache(const int64& _MxMemUsed, const int& Ports, void* _RefToBs) :
-        MxMemUsed(_MxMemUsed), CurMemUsed(0),
-        KeyDatH(/*Ports*/), TimeKeyL(), RefToBs(_RefToBs) {}
+    TCache(const int64& _MxMemUsed, const int& Ports, void* _RefToBs,
+        const TCachePolicy& _Policy = cpLru) :
+        Policy(_Policy), MxMemUsed(_MxMemUsed), CurMemUsed(0), InMemUsed(0),
+        KeyDatH(/*Ports*/), TimeKeyL(), ScanN(0), Hits(0), Misses(0), RefToBs(_RefToBs) {}
 
     TCache& operator=(const TCache&);
     int64 GetMemUsed() const;
     int64 GetMxMemUsed() const { return MxMemUsed; }
+    int64 GetCurMemUsed() const { return CurMemUsed; }
     bool RefreshMemUsed();
 
+    /// Replacement policy
+    TCachePolicy GetPolicy() const { return Policy; }
+    /// Change replacement policy, entries are kept
+    void SetPolicy(const TCachePolicy& _Policy);
+    /// Entries added until EndScan are dropped first. Scans can be nested.
+    void StartScan() { ScanN++; }
+    /// Close scan opened with StartScan
+    void EndScan() { Assert(ScanN > 0); ScanN--; }
+    /// Is a scan open
+    bool IsScan() const { return ScanN > 0; }
+
+    /// Add new entry, or replace data and refresh existing entry
     void Put(const TKey& Key, const TDat& Dat);
+    /// Get data without refreshing the entry or counting the access
     bool Get(const TKey& Key, TDat& Dat);
+    /// Get data on behalf of a reader, refreshes the entry and counts hits and misses
+    bool Lookup(const TKey& Key, TDat& Dat);
     void Del(const TKey& Key, const bool& DoEventCall = true);
     void ChangeKey(const TKey& OldKey, const TKey& NewKey);
     bool IsKey(const TKey& Key) { return KeyDatH.IsKey(Key); }
     int Len() const { return KeyDatH.Len(); }
     void Flush();
     void FlushAndClr();
+    /// Iterate entries starting with the one to be dropped last
     void* FFirstKeyDat();
     bool FNextKeyDat(void*& KeyDatP, TKey& Key, TDat& Dat);
+    /// Iterate entries starting with the one to be dropped first
     void* FLastKeyDat();
     bool FPrevKeyDat(void*& KeyDatP, TKey& Key, TDat& Dat);
 
-    TKeyLN First() const { return TimeKeyL.First(); }
-    TKeyLN Last() const { return TimeKeyL.Last(); }
+    /// Number of lookups found in the cache
+    uint64 GetHits() const { return Hits; }
+    /// Number of lookups not found in the cache
+    uint64 GetMisses() const { return Misses; }
+    /// Reset hit and miss counters
+    void ResetStats() { Hits = Misses = 0; }
 
     void PutRefToBs(void* _RefToBs) { RefToBs = _RefToBs; }
     void* GetRefToBs() { return RefToBs; }
 };
 
+template <class TKey, class TDat, class THashFunc>
+const TKey& TCache<TKey, TDat, THashFunc>::GetVictimKey() const {
+  // FIFO queue is emptied first while it holds more than a quarter of the memory
+  if (!InKeyL.Empty() && (TimeKeyL.Empty() || InMemUsed > MxMemUsed / 4)) {
+    return InKeyL.LastVal(); }
+  return TimeKeyL.LastVal();
+}
+
+template <class TKey, class TDat, class THashFunc>
+void TCache<TKey, TDat, THashFunc>::Touch(TKeyLNDat& KeyLNDat){
+  if (ScanN > 0){return;}
+  if (KeyLNDat.KeyLId == klMain){
+    TimeKeyL.PutFront(KeyLNDat.KeyLN);
+  } else if (KeyLNDat.KeyLId == klInScan){
+    // read outside of a scan, treat as regular entry from now on
+    KeyLNDat.KeyLId = klIn;
+  }
+  // entries in FIFO queue stay where they are
+}
+
 template <class TKey, class TDat, class THashFunc>
 void TCache<TKey, TDat, THashFunc>::Purge(const int64& MemToPurge){
   const int64 StartMemUsed = CurMemUsed;
-  while (!TimeKeyL.Empty()&&(StartMemUsed-CurMemUsed<MemToPurge)){
-    TKey Key=TimeKeyL.Last()->GetVal();
+  while (!KeyDatH.Empty()&&(StartMemUsed-CurMemUsed<MemToPurge)){
+    TKey Key=GetVictimKey();
+    const bool GhostP=(KeyDatH.GetDat(Key).KeyLId==klIn);
     Del(Key);
+    if (GhostP){GhostQ.Add(Key, KeyDatH.Len()/2+1);}
   }
 }
 
@@ -1090,7 +1234,9 @@ int64 TCache<TKey, TDat, THashFunc>::GetMemUsed() const {
            TMemUtils::GetExtraMemberSize(MxMemUsed) +
            TMemUtils::GetExtraMemberSize(CurMemUsed) +
            TMemUtils::GetExtraMemberSize(KeyDatH) +
-           TMemUtils::GetExtraMemberSize(TimeKeyL);
+           TMemUtils::GetExtraMemberSize(TimeKeyL) +
+           TMemUtils::GetExtraMemberSize(InKeyL) +
+           TMemUtils::GetExtraMemberSize(GhostQ);
     /* int64 MemUsed = 2 * sizeof(int64); */
 
     /* MemUsed += KeyDatH.GetMemUsed(false); */
@@ -1111,6 +1257,14 @@ int64 TCache<TKey, TDat, THashFunc>::GetMemUsed() const {
 template <class TKey, class TDat, class THashFunc>
 bool TCache<TKey, TDat, THashFunc>::RefreshMemUsed(){
   CurMemUsed=GetMemUsed();
+  // entries could have grown since they were counted
+  InMemUsed=0;
+  int KeyId=KeyDatH.FFirstKeyId();
+  while (KeyDatH.FNextKeyId(KeyId)){
+    TKeyLNDat& KeyLNDat=KeyDatH[KeyId];
+    KeyLNDat.MemUsed=int64(KeyDatH.GetKey(KeyId).GetMemUsed()+KeyLNDat.Dat->GetMemUsed());
+    if (KeyLNDat.KeyLId!=klMain){InMemUsed+=KeyLNDat.MemUsed;}
+  }
   if (CurMemUsed>MxMemUsed){
     Purge(CurMemUsed-MxMemUsed);
     return true;
@@ -1118,21 +1272,51 @@ bool TCache<TKey, TDat, THashFunc>::RefreshMemUsed(){
   return false;
 }
 
+template <class TKey, class TDat, class THashFunc>
+void TCache<TKey, TDat, THashFunc>::SetPolicy(const TCachePolicy& _Policy){
+  if (Policy==_Policy){return;}
+  if (_Policy==cpLru){
+    // queued entries are older than the main ones
+    while (!InKeyL.Empty()){
+      const TKey Key=InKeyL.FirstVal(); InKeyL.DelFirst();
+      TKeyLNDat& KeyLNDat=KeyDatH.GetDat(Key);
+      KeyLNDat.KeyLN=TimeKeyL.AddBack(Key); KeyLNDat.KeyLId=klMain;
+    }
+    InMemUsed=0; GhostQ.Clr();
+  }
+  Policy=_Policy;
+}
+
 template <class TKey, class TDat, class THashFunc>
 void TCache<TKey, TDat, THashFunc>::Put(const TKey& Key, const TDat& Dat){
   int KeyId=KeyDatH.GetKeyId(Key);
   if (KeyId==-1){
     int64 KeyDatMem=int64(Key.GetMemUsed()+Dat->GetMemUsed());
+    // check before purging, which can push the key out of the ghost queue
+    const bool HotP=(Policy==cp2Q && ScanN==0 && GhostQ.Del(Key));
     if (CurMemUsed+KeyDatMem>MxMemUsed){Purge(KeyDatMem);}
     CurMemUsed+=KeyDatMem;
-    TKeyLN KeyLN=TimeKeyL.AddFront(Key);
-    TKeyLNDatPr KeyLNDatPr(KeyLN, Dat);
-    KeyDatH.AddDat(Key, KeyLNDatPr);
+    TKeyLN KeyLN; int KeyLId=klMain;
+    if (HotP){
+      // requested again after being dropped from the queue, it is hot
+      KeyLN=TimeKeyL.AddFront(Key);
+    } else if (Policy==cp2Q){
+      KeyLN=(ScanN>0) ? InKeyL.AddBack(Key) : InKeyL.AddFront(Key);
+      KeyLId=(ScanN>0) ? klInScan : klIn;
+      InMemUsed+=KeyDatMem;
+    } else {
+      KeyLN=(ScanN>0) ? TimeKeyL.AddBack(Key) : TimeKeyL.AddFront(Key);
+    }
+    KeyDatH.AddDat(Key, TKeyLNDat(KeyLN, Dat, KeyLId, KeyDatMem));
   } else {
-    TKeyLNDatPr& KeyLNDatPr=KeyDatH[KeyId];
-    TKeyLN KeyLN=KeyLNDatPr.Val1;
-    KeyLNDatPr.Val2=Dat;
-    TimeKeyL.PutFront(KeyLN);
+    TKeyLNDat& KeyLNDat=KeyDatH[KeyId];
+    KeyLNDat.Dat=Dat;
+    // count the new data in place of the old one
+    const int64 KeyDatMem=int64(Key.GetMemUsed()+Dat->GetMemUsed());
+    CurMemUsed+=KeyDatMem-KeyLNDat.MemUsed;
+    if (KeyLNDat.KeyLId!=klMain){InMemUsed+=KeyDatMem-KeyLNDat.MemUsed;}
+    KeyLNDat.MemUsed=KeyDatMem;
+    Touch(KeyLNDat);
   }
 }
 
@@ -1143,9 +1327,9 @@ void TCache<TKey, TDat, THashFunc>::ChangeKey(const TKey& OldKey, const TKey& Ne
     int OldKeyId = KeyDatH.GetKeyId(OldKey);
     EAssertR(OldKeyId != -1, "OldKeyId should be a valid key");
 
-    TKeyLNDatPr KeyLNDatPr = KeyDatH[OldKeyId];
-    KeyLNDatPr.Val1->GetVal() = NewKey; // update data inside linked-list node
-    KeyDatH.AddDat(NewKey, KeyLNDatPr); // store the same data pair under new key
+    TKeyLNDat KeyLNDat = KeyDatH[OldKeyId];
+    KeyLNDat.KeyLN->GetVal() = NewKey; // update data inside linked-list node
+    KeyDatH.AddDat(NewKey, KeyLNDat); // store the same data under new key
     KeyDatH.DelKeyId(OldKeyId);
 }
 
@@ -1155,7 +1339,22 @@ bool TCache<TKey, TDat, THashFunc>::Get(const TKey& Key, TDat& Dat){
   if (KeyId==-1){
     return false;
   } else {
-    Dat=KeyDatH[KeyId].Val2;
+    Dat=KeyDatH[KeyId].Dat;
+    return true;
+  }
+}
+
+template <class TKey, class TDat, class THashFunc>
+bool TCache<TKey, TDat, THashFunc>::Lookup(const TKey& Key, TDat& Dat){
+  int KeyId=KeyDatH.GetKeyId(Key);
+  if (KeyId==-1){
+    Misses++;
+    return false;
+  } else {
+    Hits++;
+    TKeyLNDat& KeyLNDat=KeyDatH[KeyId];
+    Dat=KeyLNDat.Dat;
+    Touch(KeyLNDat);
     return true;
   }
 }
@@ -1164,14 +1363,19 @@ template <class TKey, class TDat, class THashFunc>
 void TCache<TKey, TDat, THashFunc>::Del(const TKey& Key, const bool& DoEventCall){
   int KeyId=KeyDatH.GetKeyId(Key);
   if (KeyId!=-1){
-    TKeyLNDatPr& KeyLNDatPr=KeyDatH[KeyId];
-    TKeyLN KeyLN=KeyLNDatPr.Val1;
-    TDat& Dat=KeyLNDatPr.Val2;
+    TKeyLNDat& KeyLNDat=KeyDatH[KeyId];
+    TKeyLN KeyLN=KeyLNDat.KeyLN;
+    TDat& Dat=KeyLNDat.Dat;
     if (DoEventCall){
       Dat->OnDelFromCache(Key, RefToBs);}
-    CurMemUsed-=int64(Key.GetMemUsed()+Dat->GetMemUsed());
+    // subtract what was counted, the data could have grown since
+    CurMemUsed-=KeyLNDat.MemUsed;
     Dat=NULL;
-    TimeKeyL.Del(KeyLN);
+    if (KeyLNDat.KeyLId==klMain){
+      TimeKeyL.Del(KeyLN);
+    } else {
+      InMemUsed-=KeyLNDat.MemUsed; InKeyL.Del(KeyLN);
+    }
     KeyDatH.DelKeyId(KeyId);
   }
 }
@@ -1188,8 +1392,8 @@ void TCache<TKey, TDat, THashFunc>::Flush(){
         }
     }
     const TKey& Key=KeyDatH.GetKey(KeyId);
-    TKeyLNDatPr& KeyLNDatPr=KeyDatH[KeyId];
-    TDat Dat=KeyLNDatPr.Val2;
+    TKeyLNDat& KeyLNDat=KeyDatH[KeyId];
+    TDat Dat=KeyLNDat.Dat;
     Dat->OnDelFromCache(Key, RefToBs);
     Done++;
   }
@@ -1199,18 +1403,20 @@ void TCache<TKey, TDat, THashFunc>::Flush(){
 template <class TKey, class TDat, class THashFunc>
 void TCache<TKey, TDat, THashFunc>::FlushAndClr(){
   Flush();
-  CurMemUsed=0;
+  CurMemUsed=0; InMemUsed=0;
   KeyDatH.Clr();
   TimeKeyL.Clr();
+  InKeyL.Clr();
+  GhostQ.Clr();
 }
 
 template <class TKey, class TDat, class THashFunc>
 void* TCache<TKey, TDat, THashFunc>::FFirstKeyDat(){
-  return TimeKeyL.First();
+  return TimeKeyL.Empty() ? InKeyL.First() : TimeKeyL.First();
 }
 template <class TKey, class TDat, class THashFunc>
 void* TCache<TKey, TDat, THashFunc>::FLastKeyDat() {
-    return TimeKeyL.Last();
+    return InKeyL.Empty() ? TimeKeyL.Last() : InKeyL.Last();
 }
 
 template <class TKey, class TDat, class THashFunc>
@@ -1218,8 +1424,12 @@ bool TCache<TKey, TDat, THashFunc>::FNextKeyDat(void*& KeyDatP, TKey& Key, TDat&
   if (KeyDatP==NULL){
     return false;
   } else {
-    Key=TKeyLN(KeyDatP)->GetVal(); Dat=KeyDatH.GetDat(Key).Val2;
-    KeyDatP=TKeyLN(KeyDatP)->Next(); return true;
+    Key=TKeyLN(KeyDatP)->GetVal();
+    const TKeyLNDat& KeyLNDat=KeyDatH.GetDat(Key); Dat=KeyLNDat.Dat;
+    KeyDatP=TKeyLN(KeyDatP)->Next();
+    // continue from main list to FIFO queue
+    if (KeyDatP==NULL && KeyLNDat.KeyLId==klMain){KeyDatP=InKeyL.First();}
+    return true;
   }
 }
 
@@ -1228,8 +1438,12 @@ bool TCache<TKey, TDat, THashFunc>::FPrevKeyDat(void*& KeyDatP, TKey& Key, TDat&
     if (KeyDatP == NULL) {
         return false;
     } else {
-        Key = TKeyLN(KeyDatP)->GetVal(); Dat = KeyDatH.GetDat(Key).Val2;
-        KeyDatP = TKeyLN(KeyDatP)->Prev(); return true;
+        Key = TKeyLN(KeyDatP)->GetVal();
+        const TKeyLNDat& KeyLNDat = KeyDatH.GetDat(Key); Dat = KeyLNDat.Dat;
+        KeyDatP = TKeyLN(KeyDatP)->Prev();
+        // continue from FIFO queue to main list
+        if (KeyDatP == NULL && KeyLNDat.KeyLId != klMain) { KeyDatP = TimeKeyL.Last(); }
+        return true;
     }
 }
 
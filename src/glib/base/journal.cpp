@@ -0,0 +1,355 @@
+/**
+* Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+* All rights reserved.
+*
+* This source code is licensed under the FreeBSD license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+#ifdef GLib_WIN
+#include <io.h>
+#endif
+#include <atomic>
+#include <mutex>
+
+///////////////////////////////////////////////////////////////////////////
+// File rollback journal
+namespace {
+/// Guards registered journals and their state. Recursive, since the journal
+/// itself deletes files, which goes through TFile::Del and back to the journal.
+std::recursive_mutex JournalLock;
+/// Number of registered journals, checked without the lock
+std::atomic<int> Journals(0);
+}
+
+const int TFJournal::PgLen = 8 * 1024;
+TVec<TFJournal*> TFJournal::JournalV;
+
+TFJournal::TFJournal(const TStr& _DirNm, const TStr& _JournalDirNm): DirNm(_DirNm),
+    JournalDirNm(_JournalDirNm), Tag(0), FileId(NULL), MoveFNmN(0), SavedPages(0), SavedBytes(0) {
+
+    if (!TDir::Exists(JournalDirNm)) { TDir::GenDirs(JournalDirNm); }
+}
+
+TFJournal::~TFJournal() {
+    std::lock_guard<std::recursive_mutex> Lock(JournalLock);
+    for (int JournalN = 0; JournalN < JournalV.Len(); JournalN++) {
+        if (JournalV[JournalN] == this) { JournalV.Del(JournalN); Journals--; break; }
+    }
+    if (FileId != NULL) { fclose(FileId); }
+}
+
+void TFJournal::Start(const uint64& NewTag) {
+    if (FileId != NULL) { fclose(FileId); FileId = NULL; }
+    // write new journal next to the old one
+    const TStr JournalFNm = GetJournalFNm();
+    const TStr NewJournalFNm = JournalFNm + ".new";
+    FileId = fopen(NewJournalFNm.CStr(), "wb");
+    EAssertR(FileId != NULL, "Can not open file '" + NewJournalFNm + "'.");
+    TMOut SOut; TInt(fjeStart).Save(SOut); TUInt64(NewTag).Save(SOut);
+    AddEntry(SOut); SyncFile(FileId);
+    fclose(FileId); FileId = NULL;
+    // replacing the old journal is the point where the new checkpoint takes effect
+#ifdef GLib_WIN
+    if (TFile::Exists(JournalFNm)) { TFile::Del(JournalFNm); }
+#endif
+    TFile::Rename(NewJournalFNm, JournalFNm);
+    SyncDir(JournalDirNm);
+    // originals moved aside before the new checkpoint are not needed anymore
+    TFile::DelWc(JournalDirNm + "Moved*.dat");
+    // continue appending
+    FileId = fopen(JournalFNm.CStr(), "ab");
+    EAssertR(FileId != NULL, "Can not open file '" + JournalFNm + "'.");
+    Tag = NewTag; FStateH.Clr(); MoveFNmN = 0;
+    SavedPages = 0; SavedBytes = 0;
+}
+
+void TFJournal::AddEntry(const TMOut& EntrySOut) {
+    const int EntryLen = EntrySOut.Len();
+    const int Cs = TCs::GetCsFromBf(EntrySOut.GetBfAddr(), EntryLen).Get();
+    EAssertR(fwrite(&EntryLen, sizeof(int), 1, FileId) == 1 &&
+        (int)fwrite(EntrySOut.GetBfAddr(), 1, EntryLen, FileId) == EntryLen &&
+        fwrite(&Cs, sizeof(int), 1, FileId) == 1,
+        "Error writing file '" + GetJournalFNm() + "'.");
+}
+
+bool TFJournal::LoadEntry(TSIn& SIn, TMem& Entry) {
+    // broken entry at the end is from a write which did not finish, the
+    // change it protects was not made yet
+    if (SIn.Len() < (int)sizeof(int)) { return false; }
+    int EntryLen = 0; SIn.GetBf(&EntryLen, sizeof(int));
+    if (EntryLen < 0 || SIn.Len() < EntryLen + (int)sizeof(int)) { return false; }
+    Entry.Gen(EntryLen);
+    SIn.GetBf(Entry.GetBf(), EntryLen);
+    int Cs = 0; SIn.GetBf(&Cs, sizeof(int));
+    return TCs::GetCsFromBf(Entry.GetBf(), EntryLen).Get() == Cs;
+}
+
+TFJournal::TFState& TFJournal::GetFState(const TStr& FNm, bool& AddedP) {
+    const int KeyId = FStateH.GetKeyId(FNm);
+    if (KeyId != -1) { return FStateH[KeyId]; }
+    // first change since the checkpoint, remember how long the file was
+    const int64 OrigLen = TFile::Exists(FNm) ? (int64)TFile::GetSize(FNm) : (int64)-1;
+    TMOut SOut; TInt(fjeFile).Save(SOut);
+    GetRelFNm(FNm).Save(SOut); TInt64(OrigLen).Save(SOut);
+    AddEntry(SOut); AddedP = true;
+    return FStateH.AddDat(FNm, TFState(OrigLen));
+}
+
+void TFJournal::SaveRegion(const TStr& FNm, const int64& FPos, const int64& Len) {
+    bool AddedP = false;
+    TFState& FState = GetFState(FNm, AddedP);
+    if (!FState.IsReplaced() && Len > 0) {
+        FILE* OrigFileId = NULL;
+        TMem PgMem(PgLen);
+        const int64 FirstPg = FPos / PgLen, LastPg = (FPos + Len - 1) / PgLen;
+        for (int64 Pg = FirstPg; Pg <= LastPg; Pg++) {
+            // nothing to save past the original end of the file
+            const int64 PgFPos = Pg * PgLen;
+            if (PgFPos >= FState.OrigLen) { break; }
+            if (FState.PgSet.IsKey(Pg)) { continue; }
+            // page was not changed since the checkpoint, so it is the original on the disk
+            if (OrigFileId == NULL) {
+                OrigFileId = fopen(FNm.CStr(), "rb");
+                EAssertR(OrigFileId != NULL, "Can not open file '" + FNm + "'.");
+            }
+            const int PgBfL = (int)TMath::Mn<int64>(PgLen, FState.OrigLen - PgFPos);
+            EAssertR(fseek(OrigFileId, (long)PgFPos, SEEK_SET) == 0 &&
+                (int)fread(PgMem.GetBf(), 1, PgBfL, OrigFileId) == PgBfL,
+                "Error reading file '" + FNm + "'.");
+            TMOut SOut; TInt(fjePage).Save(SOut);
+            GetRelFNm(FNm).Save(SOut); TInt64(PgFPos).Save(SOut);
+            TInt(PgBfL).Save(SOut); SOut.PutBf(PgMem.GetBf(), PgBfL);
+            AddEntry(SOut); AddedP = true;
+            FState.PgSet.AddKey(Pg);
+            SavedPages++; SavedBytes += PgBfL;
+        }
+        if (OrigFileId != NULL) { fclose(OrigFileId); }
+    }
+    // journal must be on the disk before the file is changed
+    if (AddedP) { SyncFile(FileId); }
+}
+
+bool TFJournal::SaveFile(const TStr& FNm) {
+    bool AddedP = false;
+    TFState& FState = GetFState(FNm, AddedP);
+    if (FState.IsReplaced()) {
+        if (AddedP) { SyncFile(FileId); }
+        return false;
+    }
+    // record the move first; if the move does not happen, the original is still in place
+    const TStr MoveFNm = TStr::Fmt("Moved%d.dat", MoveFNmN++);
+    TMOut SOut; TInt(fjeMove).Save(SOut);
+    GetRelFNm(FNm).Save(SOut); MoveFNm.Save(SOut);
+    AddEntry(SOut); SyncFile(FileId);
+    TFile::Rename(FNm, JournalDirNm + MoveFNm);
+    FState.MoveFNm = MoveFNm;
+    SavedBytes += FState.OrigLen;
+    return true;
+}
+
+TFJournal* TFJournal::GetJournal(const TStr& FNm) {
+    // innermost directory wins, so a base inside the directory of another keeps its own journal
+    TFJournal* BestJournal = NULL;
+    for (int JournalN = 0; JournalN < JournalV.Len(); JournalN++) {
+        TFJournal* Journal = JournalV[JournalN];
+        if (FNm.StartsWith(Journal->DirNm) && !FNm.StartsWith(Journal->JournalDirNm)) {
+            if (BestJournal == NULL || Journal->DirNm.Len() > BestJournal->DirNm.Len()) {
+                BestJournal = Journal;
+            }
+        }
+    }
+    return BestJournal;
+}
+
+void TFJournal::Truncate(const TStr& FNm, const int64& Len) {
+#ifdef GLib_WIN
+    HANDLE FileH = CreateFile(FNm.CStr(), GENERIC_WRITE, 0, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    EAssertR(FileH != INVALID_HANDLE_VALUE, "Can not open file '" + FNm + "'.");
+    LARGE_INTEGER FPos; FPos.QuadPart = Len;
+    const bool OkP = SetFilePointerEx(FileH, FPos, NULL, FILE_BEGIN) && SetEndOfFile(FileH);
+    CloseHandle(FileH);
+    EAssertR(OkP, "Can not truncate file '" + FNm + "'.");
+#else
+    EAssertR(truncate(FNm.CStr(), (off_t)Len) == 0, "Can not truncate file '" + FNm + "'.");
+#endif
+}
+
+PFJournal TFJournal::New(const TStr& DirNm, const TStr& JournalDirNm, const uint64& Tag) {
+    // files as they are now are the checkpoint, so they must be on the disk first
+    TStrV FNmV; TFFile::GetFNmV(DirNm, TStrV(), false, FNmV);
+    for (int FNmN = 0; FNmN < FNmV.Len(); FNmN++) { SyncFNm(FNmV[FNmN]); }
+    SyncDir(DirNm);
+    PFJournal Journal = new TFJournal(DirNm, JournalDirNm);
+    std::lock_guard<std::recursive_mutex> Lock(JournalLock);
+    Journal->Start(Tag);
+    JournalV.Add(Journal()); Journals++;
+    return Journal;
+}
+
+PFJournal TFJournal::Rollback(const TStr& DirNm, const TStr& JournalDirNm) {
+    PFJournal Journal = new TFJournal(DirNm, JournalDirNm);
+    const TStr JournalFNm = Journal->GetJournalFNm();
+    // collect original lengths and moved originals
+    THash<TStr, TFState> FStateH;
+    uint64 Tag = 0; bool TagP = false;
+    TMem Entry;
+    {
+        TFIn FIn(JournalFNm);
+        while (LoadEntry(FIn, Entry)) {
+            PSIn SIn = Entry.GetSIn();
+            const int Type = TInt(*SIn);
+            if (Type == fjeStart) {
+                Tag = TUInt64(*SIn); TagP = true;
+            } else if (Type == fjeFile) {
+                TStr RelFNm(*SIn); TInt64 OrigLen(*SIn);
+                FStateH.AddDat(RelFNm, TFState(OrigLen));
+            } else if (Type == fjeMove) {
+                TStr RelFNm(*SIn); TStr MoveFNm(*SIn);
+                FStateH.GetDat(RelFNm).MoveFNm = MoveFNm;
+            }
+        }
+    }
+    EAssertR(TagP, "Corrupted journal '" + JournalFNm + "'.");
+    // bring back moved originals and remove files created after the checkpoint
+    TStrSet DirNmSet; DirNmSet.AddKey(DirNm);
+    int KeyId = FStateH.FFirstKeyId();
+    while (FStateH.FNextKeyId(KeyId)) {
+        const TStr FNm = DirNm + FStateH.GetKey(KeyId);
+        const TFState& FState = FStateH[KeyId];
+        DirNmSet.AddKey(FNm.GetFPath());
+        if (FState.OrigLen == -1) {
+            if (TFile::Exists(FNm)) { TFile::Del(FNm); }
+        } else if (!FState.MoveFNm.Empty() && TFile::Exists(JournalDirNm + FState.MoveFNm)) {
+            if (TFile::Exists(FNm)) { TFile::Del(FNm); }
+            TFile::Rename(JournalDirNm + FState.MoveFNm, FNm);
+        }
+    }
+    // write back original pages
+    {
+        TFIn FIn(JournalFNm);
+        while (LoadEntry(FIn, Entry)) {
+            PSIn SIn = Entry.GetSIn();
+            const int Type = TInt(*SIn);
+            if (Type != fjePage) { continue; }
+            TStr RelFNm(*SIn); TInt64 PgFPos(*SIn); TInt PgBfL(*SIn);
+            const TStr FNm = DirNm + RelFNm;
+            FILE* PgFileId = fopen(FNm.CStr(), "r+b");
+            EAssertR(PgFileId != NULL, "Can not open file '" + FNm + "'.");
+            const bool OkP = fseek(PgFileId, (long)PgFPos.Val, SEEK_SET) == 0 &&
+                (int)fwrite(Entry.GetBf() + (Entry.Len() - PgBfL), 1, PgBfL, PgFileId) == PgBfL;
+            fclose(PgFileId);
+            EAssertR(OkP, "Error writing file '" + FNm + "'.");
+        }
+    }
+    // cut what was appended after the checkpoint and make it all durable
+    KeyId = FStateH.FFirstKeyId();
+    while (FStateH.FNextKeyId(KeyId)) {
+        const TStr FNm = DirNm + FStateH.GetKey(KeyId);
+        const int64 OrigLen = FStateH[KeyId].OrigLen;
+        if (OrigLen == -1 || !TFile::Exists(FNm)) { continue; }
+        if ((int64)TFile::GetSize(FNm) > OrigLen) { Truncate(FNm, OrigLen); }
+        SyncFNm(FNm);
+    }
+    KeyId = DirNmSet.FFirstKeyId();
+    while (DirNmSet.FNextKeyId(KeyId)) { SyncDir(DirNmSet.GetKey(KeyId)); }
+    // continue from the same checkpoint
+    std::lock_guard<std::recursive_mutex> Lock(JournalLock);
+    Journal->Start(Tag);
+    JournalV.Add(Journal()); Journals++;
+    return Journal;
+}
+
+bool TFJournal::Exists(const TStr& JournalDirNm) {
+    return TFile::Exists(JournalDirNm + "Journal.dat");
+}
+
+void TFJournal::Del(const TStr& JournalDirNm) {
+    TFile::DelWc(JournalDirNm + "Moved*.dat");
+    TFile::Del(JournalDirNm + "Journal.dat", false);
+    SyncDir(JournalDirNm);
+}
+
+int TFJournal::GetFiles() const {
+    std::lock_guard<std::recursive_mutex> Lock(JournalLock);
+    return FStateH.Len();
+}
+
+void TFJournal::Checkpoint(const uint64& NewTag) {
+    std::lock_guard<std::recursive_mutex> Lock(JournalLock);
+    // files changed since the last checkpoint must be on the disk before
+    // the journal which can restore them is dropped
+    TStrSet DirNmSet; DirNmSet.AddKey(DirNm);
+    int KeyId = FStateH.FFirstKeyId();
+    while (FStateH.FNextKeyId(KeyId)) {
+        const TStr& FNm = FStateH.GetKey(KeyId);
+        DirNmSet.AddKey(FNm.GetFPath());
+        if (TFile::Exists(FNm)) { SyncFNm(FNm); }
+    }
+    KeyId = DirNmSet.FFirstKeyId();
+    while (DirNmSet.FNextKeyId(KeyId)) { SyncDir(DirNmSet.GetKey(KeyId)); }
+    Start(NewTag);
+}
+
+PJsonVal TFJournal::GetStats() const {
+    std::lock_guard<std::recursive_mutex> Lock(JournalLock);
+    PJsonVal StatsVal = TJsonVal::NewObj();
+    StatsVal->AddToObj("checkpoint", Tag);
+    StatsVal->AddToObj("files", FStateH.Len());
+    StatsVal->AddToObj("saved_pages", SavedPages);
+    StatsVal->AddToObj("saved_bytes", SavedBytes);
+    return StatsVal;
+}
+
+bool TFJournal::IsOn() {
+    return Journals > 0;
+}
+
+void TFJournal::OnWrite(const TStr& FNm, const int64& FPos, const int64& Len) {
+    std::lock_guard<std::recursive_mutex> Lock(JournalLock);
+    TFJournal* Journal = GetJournal(FNm);
+    if (Journal != NULL) { Journal->SaveRegion(FNm, FPos, Len); }
+}
+
+bool TFJournal::OnTrunc(const TStr& FNm) {
+    std::lock_guard<std::recursive_mutex> Lock(JournalLock);
+    TFJournal* Journal = GetJournal(FNm);
+    return (Journal != NULL) && Journal->SaveFile(FNm);
+}
+
+void TFJournal::SyncFile(FILE* FileId) {
+    EAssertR(fflush(FileId) == 0, "Can not flush file.");
+#ifdef GLib_WIN
+    EAssertR(FlushFileBuffers((HANDLE)_get_osfhandle(_fileno(FileId))) != 0, "Can not flush file.");
+#else
+    EAssertR(fsync(fileno(FileId)) == 0, "Can not flush file.");
+#endif
+}
+
+void TFJournal::SyncFNm(const TStr& FNm) {
+#ifdef GLib_WIN
+    HANDLE FileH = CreateFile(FNm.CStr(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    EAssertR(FileH != INVALID_HANDLE_VALUE, "Can not open file '" + FNm + "'.");
+    const bool OkP = FlushFileBuffers(FileH) != 0;
+    CloseHandle(FileH);
+    EAssertR(OkP, "Can not flush file '" + FNm + "'.");
+#else
+    const int FileDesc = open(FNm.CStr(), O_RDONLY);
+    EAssertR(FileDesc != -1, "Can not open file '" + FNm + "'.");
+    const bool OkP = fsync(FileDesc) == 0;
+    close(FileDesc);
+    EAssertR(OkP, "Can not flush file '" + FNm + "'.");
+#endif
+}
+
+void TFJournal::SyncDir(const TStr& DirNm) {
+#ifndef GLib_WIN
+    // directory entries are written with the file system metadata on windows
+    const int DirDesc = open(DirNm.Empty() ? "." : DirNm.CStr(), O_RDONLY);
+    if (DirDesc == -1) { return; }
+    fsync(DirDesc);
+    close(DirDesc);
+#endif
+}
@@ -0,0 +1,139 @@
+/**
+* Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+* All rights reserved.
+*
+* This source code is licensed under the FreeBSD license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+///////////////////////////////////////////////////////////////////////////
+// File rollback journal
+class TFJournal;
+typedef TPt<TFJournal> PFJournal;
+
+/// Rollback journal for the files in a directory. Before a file in the
+/// directory is changed for the first time since the last checkpoint, the
+/// journal saves what is needed to undo the change: original content of the
+/// pages changed in place, original length of the file, and the original file
+/// itself when it is truncated or deleted (it is moved into the journal
+/// directory). After a crash, Rollback returns all files to their state at
+/// the last checkpoint, on top of which a logical redo log can be replayed.
+/// Files report changes through TFOut, TFRnd, TPgBlobFile and TFile::Del.
+/// Only files inside the directory are journaled, other files, including
+/// those of other bases, are written and deleted as usual. When directories
+/// of several journals are nested, the innermost one covers the file.
+/// Changes through memory mapped files are not seen by the journal.
+/// Registered journals and their state are guarded by one lock, so files
+/// can be changed from several threads, e.g. background flusher and callers.
+class TFJournal {
+private:
+    /// Journal entry types
+    typedef enum { fjeStart = 0, fjeFile = 1, fjePage = 2, fjeMove = 3 } TFJournalEntry;
+
+    /// What the journal knows about a file changed since the last checkpoint
+    class TFState {
+    public:
+        /// File length at the checkpoint, -1 when the file did not exist
+        TInt64 OrigLen;
+        /// Name of the original file moved into the journal, empty when not moved
+        TStr MoveFNm;
+        /// Pages with saved original content
+        TUInt64Set PgSet;
+
+    public:
+        TFState(): OrigLen(-1) { }
+        TFState(const int64& _OrigLen): OrigLen(_OrigLen) { }
+
+        /// Original is either saved as a whole or did not exist, nothing more to save
+        bool IsReplaced() const { return (OrigLen == -1) || !MoveFNm.Empty(); }
+    };
+
+    /// Granularity of saved file content
+    static const int PgLen;
+    /// Registered journals, guarded by the journal lock
+    static TVec<TFJournal*> JournalV;
+
+    /// Reference count for smart pointers
+    TCRef CRef;
+    /// Directory of the files covered by the journal
+    TStr DirNm;
+    /// Directory with the journal, excluded from journaling
+    TStr JournalDirNm;
+    /// Checkpoint the files are rolled back to
+    uint64 Tag;
+    /// Journal file, open for appending
+    FILE* FileId;
+    /// Files changed since the last checkpoint
+    THash<TStr, TFState> FStateH;
+    /// Counter for names of moved files
+    int MoveFNmN;
+    /// Statistics since the last checkpoint
+    uint64 SavedPages, SavedBytes;
+
+    TFJournal(const TStr& _DirNm, const TStr& _JournalDirNm);
+    TFJournal(const TFJournal&);
+    TFJournal& operator=(const TFJournal&);
+
+    TStr GetJournalFNm() const { return JournalDirNm + "Journal.dat"; }
+    /// File name relative to the directory covered by the journal
+    TStr GetRelFNm(const TStr& FNm) const { return FNm.GetSubStr(DirNm.Len()); }
+    /// Start an empty journal for the given checkpoint, replacing the old one
+    void Start(const uint64& NewTag);
+    /// Append entry to the journal file
+    void AddEntry(const TMOut& EntrySOut);
+    /// Get state of the file, creates it on the first change after the checkpoint
+    TFState& GetFState(const TStr& FNm, bool& AddedP);
+    /// Save original content of the file region about to be changed
+    void SaveRegion(const TStr& FNm, const int64& FPos, const int64& Len);
+    /// Move original file into the journal before it is truncated or deleted
+    bool SaveFile(const TStr& FNm);
+    /// Find journal covering the file, NULL when none. Called with the journal lock held.
+    static TFJournal* GetJournal(const TStr& FNm);
+    /// Read next entry from the journal file, false at the end or at a broken entry
+    static bool LoadEntry(TSIn& SIn, TMem& Entry);
+    /// Cut file to the given length
+    static void Truncate(const TStr& FNm, const int64& Len);
+
+    friend class TPt<TFJournal>;
+public:
+    /// Start journaling, the current state of the files is the checkpoint
+    static PFJournal New(const TStr& DirNm, const TStr& JournalDirNm, const uint64& Tag);
+    /// Roll the files back to the checkpoint in the existing journal and start journaling from it
+    static PFJournal Rollback(const TStr& DirNm, const TStr& JournalDirNm);
+    /// Stops journaling, journal stays on the disk
+    ~TFJournal();
+
+    /// Is there a journal in the given directory
+    static bool Exists(const TStr& JournalDirNm);
+    /// Remove journal files from the directory
+    static void Del(const TStr& JournalDirNm);
+
+    /// Checkpoint the files are rolled back to
+    uint64 GetTag() const { return Tag; }
+    /// Number of files changed since the last checkpoint
+    int GetFiles() const;
+    /// Make all reported changes durable and set new checkpoint. Owners of open
+    /// files must flush their buffers before calling this.
+    void Checkpoint(const uint64& NewTag);
+    /// Statistics since the last checkpoint
+    PJsonVal GetStats() const;
+
+    /// Is any journal active (fast check for the file classes)
+    static bool IsOn();
+    /// Called before a region of the file is written
+    static void OnWrite(const TStr& FNm, const int64& FPos, const int64& Len);
+    /// Called before the file is truncated, recreated or deleted. Returns true
+    /// when the file was moved into the journal and no longer exists.
+    static bool OnTrunc(const TStr& FNm);
+
+    /// Write buffered content of an open file to the disk
+    static void SyncFile(FILE* FileId);
+    /// Write cached content of a file to the disk
+    static void SyncFNm(const TStr& FNm);
+    /// Write directory entries to the disk
+    static void SyncDir(const TStr& DirNm);
+};
+
+#endif
@@ -166,6 +166,97 @@ void TSparseRowMatrix::Init() {
     }
 }
 
+///////////////////////////////////////////////////////////////////////
+// Compressed-Sparse-Column-Matrix
+TCscMatrix::TCscMatrix(const TVec<TIntFltKdV>& ColSpVV, const int& _RowN): TMatrix() {
+    ColN = ColSpVV.Len(); RowN = TInt::GetMx(_RowN, 0);
+    ColPtrV.Gen(ColN + 1); ColPtrV[0] = 0;
+    for (int ColId = 0; ColId < ColN; ColId++) {
+        ColPtrV[ColId + 1] = ColPtrV[ColId] + ColSpVV[ColId].Len();
+    }
+    RowIdxV.Gen(GetNnz()); ValV.Gen(GetNnz());
+    for (int ColId = 0; ColId < ColN; ColId++) {
+        const TIntFltKdV& ColV = ColSpVV[ColId];
+        const int64 Start = ColPtrV[ColId];
+        for (int ElN = 0; ElN < ColV.Len(); ElN++) {
+            RowIdxV[Start + ElN] = ColV[ElN].Key;
+            ValV[Start + ElN] = ColV[ElN].Dat;
+            // without explicit number of rows we take the largest index
+            if (_RowN < 0 && ColV[ElN].Key >= RowN) { RowN = ColV[ElN].Key + 1; }
+        }
+    }
+}
+
+void TCscMatrix::Gen(const int& _RowN, const TIntV& ColNnzV) {
+    RowN = _RowN; ColN = ColNnzV.Len();
+    ColPtrV.Gen(ColN + 1); ColPtrV[0] = 0;
+    for (int ColId = 0; ColId < ColN; ColId++) {
+        EAssert(ColNnzV[ColId] >= 0);
+        ColPtrV[ColId + 1] = ColPtrV[ColId] + ColNnzV[ColId];
+    }
+    RowIdxV.Gen(GetNnz()); ValV.Gen(GetNnz());
+}
+
+void TCscMatrix::AddCol(const TIntFltKdV& SpV) {
+    for (int ElN = 0; ElN < SpV.Len(); ElN++) {
+        RowIdxV.Add(SpV[ElN].Key); ValV.Add(SpV[ElN].Dat);
+    }
+    ColPtrV.Add(RowIdxV.Len()); ColN++;
+}
+
+void TCscMatrix::GetColSpV(const int& ColId, TIntFltKdV& SpV) const {
+    EAssert(0 <= ColId && ColId < ColN);
+    const int64 Start = ColPtrV[ColId], End = ColPtrV[ColId + 1];
+    SpV.Gen((int)(End - Start), 0);
+    for (int64 ElN = Start; ElN < End; ElN++) {
+        SpV.Add(TIntFltKd(RowIdxV[ElN], ValV[ElN]));
+    }
+}
+
+void TCscMatrix::PMultiply(const TFltVV& B, int ColId, TFltV& Result) const {
+    EAssert(B.GetRows() >= ColN && Result.Len() >= RowN);
+    int i, j; int64 k; TFlt *ResV = Result.BegI();
+    for (i = 0; i < RowN; i++) ResV[i] = 0.0;
+    for (j = 0; j < ColN; j++) {
+        const double Val = B(j, ColId);
+        for (k = ColPtrV[j]; k < ColPtrV[j + 1]; k++) {
+            ResV[RowIdxV[k]] += ValV[k] * Val;
+        }
+    }
+}
+
+void TCscMatrix::PMultiply(const TFltV& Vec, TFltV& Result) const {
+    EAssert(Vec.Len() >= ColN && Result.Len() >= RowN);
+    int i, j; int64 k; TFlt *ResV = Result.BegI();
+    for (i = 0; i < RowN; i++) ResV[i] = 0.0;
+    for (j = 0; j < ColN; j++) {
+        const double Val = Vec[j];
+        for (k = ColPtrV[j]; k < ColPtrV[j + 1]; k++) {
+            ResV[RowIdxV[k]] += ValV[k] * Val;
+        }
+    }
+}
+
+void TCscMatrix::PMultiplyT(const TFltVV& B, int ColId, TFltV& Result) const {
+    EAssert(B.GetRows() >= RowN && Result.Len() >= ColN);
+    int j; int64 k; TFlt *ResV = Result.BegI();
+    for (j = 0; j < ColN; j++) {
+        double Sum = 0.0;
+        for (k = ColPtrV[j]; k < ColPtrV[j + 1]; k++) {
+            Sum += ValV[k] * B(RowIdxV[k], ColId);
+        }
+        ResV[j] = Sum;
+    }
+}
+
+void TCscMatrix::PMultiplyT(const TFltV& Vec, TFltV& Result) const {
+    EAssert(Vec.Len() >= RowN && Result.Len() >= ColN);
+    TFlt *ResV = Result.BegI();
+    for (int j = 0; j < ColN; j++) {
+        ResV[j] = TLinAlg::DotProduct(*this, j, Vec);
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////
 // Full-Col-Matrix
 TFullColMatrix::TFullColMatrix(const TStr& MatlabMatrixFNm): TMatrix() {
@@ -828,6 +919,32 @@ void TLinAlg::AddVec(const double& k, const TVec<TIntFltKdV>& X, int ColId, cons
 	AddVec(k, X[ColId], y, z);
 }
 
+void TLinAlg::AddVec(const double& k, const TCscMatrix& X, int ColId, const TFltV& y, TFltV& z) {
+	EAssert(0 <= ColId && ColId < X.ColN);
+	EAssert(y.Len() == z.Len());
+	if (&y != &z) { z = y; }
+	const int yLen = y.Len();
+	for (int64 i = X.ColPtrV[ColId]; i < X.ColPtrV[ColId + 1]; i++) {
+		const int ii = X.RowIdxV[i];
+		if (ii < yLen) {
+			z[ii] += k * X.ValV[i];
+		}
+	}
+}
+
+double TLinAlg::DotProduct(const TCscMatrix& X, int ColId, const TFltV& y) {
+	EAssert(0 <= ColId && ColId < X.ColN);
+	const int yLen = y.Len();
+	double Res = 0.0;
+	for (int64 i = X.ColPtrV[ColId]; i < X.ColPtrV[ColId + 1]; i++) {
+		const int ii = X.RowIdxV[i];
+		if (ii < yLen) {
+			Res += X.ValV[i] * y[ii];
+		}
+	}
+	return Res;
+}
+
 void TLinAlg::AddVec(const double& k, const TIntFltKdV& x, TFltV& y) {
 	const int xLen = x.Len(), yLen = y.Len();
 	for (int i = 0; i < xLen; i++) {
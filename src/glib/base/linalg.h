@@ -272,6 +272,64 @@ public:
 	}
 };
 
+///////////////////////////////////////////////////////////////////////
+// Compressed-Sparse-Column-Matrix
+//  matrix is given with columns stored consecutively in three flat vectors:
+//  column j has non-zero elements RowIdxV[k], ValV[k] for ColPtrV[j] <= k < ColPtrV[j+1]
+class TCscMatrix : public TMatrix {
+public:
+	// number of rows and columns of matrix
+	TInt RowN, ColN;
+	// start of each column in RowIdxV and ValV, with ColN+1 elements;
+	//  64-bit so that the matrix can hold more than 2^31 non-zero elements
+	TVec<TInt64> ColPtrV;
+	// row indices and values of non-zero elements
+	TVec<TInt, int64> RowIdxV;
+	TVec<TFlt, int64> ValV;
+protected:
+	// Result = A * B(:,ColId)
+	virtual void PMultiply(const TFltVV& B, int ColId, TFltV& Result) const;
+	// Result = A * Vec
+	virtual void PMultiply(const TFltV& Vec, TFltV& Result) const;
+	// Result = A' * B(:,ColId)
+	virtual void PMultiplyT(const TFltVV& B, int ColId, TFltV& Result) const;
+	// Result = A' * Vec
+	virtual void PMultiplyT(const TFltV& Vec, TFltV& Result) const;
+
+	int PGetRows() const { return RowN; }
+	int PGetCols() const { return ColN; }
+
+public:
+	TCscMatrix(): TMatrix(), RowN(0), ColN(0), ColPtrV(1) { ColPtrV[0] = 0; }
+	// converts a vector of sparse columns
+	TCscMatrix(const TVec<TIntFltKdV>& ColSpVV, const int& _RowN = -1);
+
+	// allocates space for the given number of non-zero elements in each column;
+	//  elements of column j are then filled in at positions ColPtrV[j] and on
+	void Gen(const int& _RowN, const TIntV& ColNnzV);
+	// appends a column
+	void AddCol(const TIntFltKdV& SpV);
+	// exchanges contents with another matrix without copying
+	void Swap(TCscMatrix& Mat) {
+		::Swap(RowN, Mat.RowN); ::Swap(ColN, Mat.ColN);
+		ColPtrV.Swap(Mat.ColPtrV); RowIdxV.Swap(Mat.RowIdxV); ValV.Swap(Mat.ValV);
+	}
+
+	// number of non-zero elements
+	int64 GetNnz() const { return ColPtrV.Last(); }
+	// number of non-zero elements in column
+	int GetColNnz(const int& ColId) const { return (int)(ColPtrV[ColId + 1] - ColPtrV[ColId]); }
+	// copies column into a sparse vector
+	void GetColSpV(const int& ColId, TIntFltKdV& SpV) const;
+
+	void Save(TSOut& SOut) const {
+		RowN.Save(SOut); ColN.Save(SOut); ColPtrV.Save(SOut); RowIdxV.Save(SOut); ValV.Save(SOut);
+	}
+	void Load(TSIn& SIn) {
+		RowN.Load(SIn); ColN.Load(SIn); ColPtrV.Load(SIn); RowIdxV.Load(SIn); ValV.Load(SIn);
+	}
+};
+
 ///////////////////////////////////////////////////////////////////////
 // Full-Col-Matrix
 //  matrix is given with columns of full vectors
@@ -592,6 +650,8 @@ public:
 	TEMP_LA static TType DotProduct(const TVec<TDenseV>& X, TSizeTy ColId, const TDenseV& y);
     /// Result = <X[ColId], y>
 	TEMP_LA static TType DotProduct(const TSparseVV& X, TSizeTy ColId, const TDenseV& y);
+    /// Result = <X(:,ColId), y>
+	static double DotProduct(const TCscMatrix& X, int ColId, const TFltV& y);
 
 	/// Result = <X(:,ColId), Y(:,ColId)>
 	TEMP_LA	static TType DotProduct(const TDenseVV& X, TSizeTy ColIdX, const TDenseVV& Y, TSizeTy ColIdY);
@@ -662,6 +722,8 @@ public:
 	TEMP_LA static void AddVec(const TType& k, const TSparseV& x, const TDenseV& y, TDenseV& z);
 	/// z := k * X[ColId] + y
 	static void AddVec(const double& k, const TVec<TIntFltKdV>& X, int ColId, const TFltV& y, TFltV& z);
+	/// z := k * X(:,ColId) + y
+	static void AddVec(const double& k, const TCscMatrix& X, int ColId, const TFltV& y, TFltV& z);
 	/// y := k * x + y
 	static void AddVec(const double& k, const TIntFltKdV& x, TFltV& y);
 	/// Y(:,Col) += k * X(:,Col)
@@ -6,6 +6,10 @@
 * LICENSE file in the root directory of this source tree.
 */
 
+#ifdef GLib_UNIX
+#include <sys/mman.h>
+#endif
+
 ///////////////////////////////////////////////////////////////////////////
 
 /// Assignment operator
@@ -99,8 +103,8 @@ int TPgBlobPt::GetSecHashCd() const {
 char* TPgBlobFile::EmptyPage = NULL;
 
 /// Private constructor
-TPgBlobFile::TPgBlobFile(
-    const TStr& _FNm, const TFAccess& _Access, const uint32& _MxSegLen) {
+TPgBlobFile::TPgBlobFile(const TStr& _FNm, const TFAccess& _Access,
+    const uint32& _MxSegLen, const bool& MmapP, const TPgBlobAccess& AccessHint) {
 
     // initialize the array used as the empty page - it is stored to disk when new page is allocated
     if (EmptyPage == NULL) {
@@ -115,6 +119,7 @@ TPgBlobFile::TPgBlobFile(
 
     switch (Access) {
     case faCreate:
+        if (TFJournal::IsOn()) { TFJournal::OnTrunc(FNm); }
         FileId = fopen(FNm.CStr(), "w+b");
         break;
     case faRdOnly:
@@ -133,10 +138,32 @@ TPgBlobFile::TPgBlobFile(
         break;
     }
     PgCnt = TFile::GetSize(FNm) / PG_PAGE_SIZE;
+
+    MapBf = NULL; MapLen = 0;
+#ifdef GLib_UNIX
+    if (MmapP) {
+        EAssertR(FileId != NULL, "Can not open file '" + FNm + "'.");
+        // reserve address space for the largest file, including the last page
+        // which can stretch over the limit; only the part backed by the file
+        // is ever accessed
+        const uint64 MxLen = (MxFileLen > 0) ? (uint64)MxFileLen : (uint64)PgCnt * PG_PAGE_SIZE;
+        MapLen = (MxLen / PG_PAGE_SIZE + 1) * PG_PAGE_SIZE;
+        const int Prot = (Access == faRdOnly) ? PROT_READ : (PROT_READ | PROT_WRITE);
+        void* Bf = mmap(NULL, MapLen, Prot, MAP_SHARED, fileno(FileId), 0);
+        EAssertR(Bf != MAP_FAILED, "Can not memory-map file '" + FNm + "' - " + TStr::Fmt("%d", errno));
+        MapBf = (char*)Bf;
+        SetAccessHint(AccessHint);
+    }
+#endif
 }
 
 /// Destructor
 TPgBlobFile::~TPgBlobFile() {
+#ifdef GLib_UNIX
+    if (MapBf != NULL) {
+        munmap(MapBf, MapLen);
+    }
+#endif
     EAssertR(
         fclose(FileId) == 0,
         "Can not close file '" + TStr(FNm.CStr()) + "'.");
@@ -144,6 +171,10 @@ TPgBlobFile::~TPgBlobFile() {
 
 /// Load page with given index from the file into buffer
 int TPgBlobFile::LoadPage(const uint32& Page, void* Bf) {
+    if (MapBf != NULL) {
+        memcpy(Bf, GetPageBf(Page), PG_PAGE_SIZE);
+        return 0;
+    }
     SetFPos(Page * PG_PAGE_SIZE);
     EAssertR(
         fread(Bf, 1, PG_PAGE_SIZE, FileId) == PG_PAGE_SIZE,
@@ -153,8 +184,15 @@ int TPgBlobFile::LoadPage(const uint32& Page, void* Bf) {
 
 /// Save buffer to page within the file
 int TPgBlobFile::SavePage(const uint32& Page, const void* Bf, int Len) {
-    SetFPos(Page * PG_PAGE_SIZE);
     Len = (Len <= 0 ? PG_PAGE_SIZE : Len);
+    if (MapBf != NULL) {
+        EAssertR(Access != TFAccess::faRdOnly, "Error writing file '" + TStr(FNm) + "'.");
+        char* PgBf = GetPageBf(Page);
+        if (PgBf != Bf) { memcpy(PgBf, Bf, Len); }
+        return 0;
+    }
+    if (TFJournal::IsOn()) { TFJournal::OnWrite(FNm, (int64)Page * PG_PAGE_SIZE, Len); }
+    SetFPos(Page * PG_PAGE_SIZE);
     EAssertR(
         (Access != TFAccess::faRdOnly) && (int)fwrite(Bf, 1, Len, FileId) == Len,
         "Error writing file '" + TStr(FNm) + "'.");
@@ -184,12 +222,56 @@ long TPgBlobFile::CreateNewPage() {
     if (MxFileLen > 0 && len >= MxFileLen) {
         return -1;
     }
+    if (TFJournal::IsOn()) { TFJournal::OnWrite(FNm, len, PG_PAGE_SIZE); }
     size_t written = fwrite(EmptyPage, PG_PAGE_SIZE, 1, FileId);
     EAssertR(written == 1, "Error writing file '" + TStr(FNm) + "'.");
+    if (MapBf != NULL) {
+        // page must be in the file before it is accessed through the mapping
+        EAssertR(fflush(FileId) == 0, "Error writing file '" + TStr(FNm) + "'.");
+    }
     PgCnt++;
     return len / PG_PAGE_SIZE;
 }
 
+/// Pass expected access pattern of the mapping to the OS
+void TPgBlobFile::SetAccessHint(const TPgBlobAccess& AccessHint) {
+#ifdef GLib_UNIX
+    if (MapBf == NULL) { return; }
+    int Advice = MADV_NORMAL;
+    if (AccessHint == pbaSequential) {
+        Advice = MADV_SEQUENTIAL;
+    } else if (AccessHint == pbaRandom) {
+        Advice = MADV_RANDOM;
+    }
+    // only a hint, failure is not an error
+    madvise(MapBf, MapLen, Advice);
+#endif
+}
+
+/// Ask the OS to read all pages of the mapping ahead
+void TPgBlobFile::WillNeed() {
+#ifdef GLib_UNIX
+    if (MapBf == NULL || PgCnt == 0) { return; }
+    madvise(MapBf, (uint64)PgCnt * PG_PAGE_SIZE, MADV_WILLNEED);
+#endif
+}
+
+/// Write modified pages of the mapping to disk
+void TPgBlobFile::Flush(const bool& SyncP) {
+    if (Access == TFAccess::faRdOnly) { return; }
+    if (MapBf == NULL) {
+        // pages written with stdio can still be buffered
+        EAssertR(fflush(FileId) == 0, "Error flushing file '" + TStr(FNm) + "'.");
+        if (SyncP) { TFJournal::SyncFile(FileId); }
+        return;
+    }
+#ifdef GLib_UNIX
+    if (PgCnt == 0) { return; }
+    EAssertR(msync(MapBf, (uint64)PgCnt * PG_PAGE_SIZE, SyncP ? MS_SYNC : MS_ASYNC) == 0,
+        "Error flushing file '" + TStr(FNm) + "' - " + TStr::Fmt("%d", errno));
+#endif
+}
+
 ///////////////////////////////////////////////////////////////////////////
 
 const int TPgBlob::MxBlobFLen = 2000000000;
@@ -294,11 +376,18 @@ TPgBlob::TPgBlobPageItem* TPgBlob::GetItemRec(
 
 /// Private constructor
 TPgBlob::TPgBlob(const TStr& _FNm, const TFAccess& _Access,
-    const uint64& CacheSize) {
+    const uint64& CacheSize, const TPgBlobBackend& _Backend,
+    const TPgBlobAccess& _AccessHint) {
     EAssertR(CacheSize >= PG_PAGE_SIZE, "Invalid cache size for TPgBlob.");
 
     FNm = _FNm;
     Access = _Access;
+#ifdef GLib_UNIX
+    Backend = _Backend;
+#else
+    Backend = pbbCache;
+#endif
+    AccessHint = _AccessHint;
 
     switch (Access) {
     case faCreate:
@@ -317,6 +406,12 @@ TPgBlob::TPgBlob(const TStr& _FNm, const TFAccess& _Access,
     LastExtentCnt = PG_EXTENT_PCOUNT; // this means the "last" extent is full, so use new one
     MxLoadedPages = CacheSize / PG_PAGE_SIZE;
     LruFirst = LruLast = -1;
+    InFirst = InLast = -1;
+    InPages = 0;
+    DirtyPages = 0;
+    Policy = cpLru;
+    ScanN = 0;
+    Hits = Misses = 0;
 }
 
 /// Destructor
@@ -350,18 +445,20 @@ void TPgBlob::LoadMain() {
     Files.Clr();
     for (int i = 0; i < children_cnt; i++) {
         TStr FNmChild = FNm + ".bin" + TStr::GetNrNumFExt(i);
-        Files.Add(TPgBlobFile::New(FNmChild, Access, MxBlobFLen));
+        Files.Add(TPgBlobFile::New(FNmChild, Access, MxBlobFLen, IsMmap(), AccessHint));
     }
 }
 
 /// remove given page from LRU list
 void TPgBlob::UnlistFromLru(int Pg) {
     LoadedPage& a = LoadedPages[Pg];
-    if (LruFirst == Pg) {
-        LruFirst = a.LruNext;
+    int& First = GetListFirst(Pg);
+    int& Last = GetListLast(Pg);
+    if (First == Pg) {
+        First = a.LruNext;
     }
-    if (LruLast == Pg) {
-        LruLast = a.LruPrev;
+    if (Last == Pg) {
+        Last = a.LruPrev;
     }
     if (a.LruNext >= 0) {
         LoadedPages[a.LruNext].LruPrev = a.LruPrev;
@@ -369,45 +466,46 @@ void TPgBlob::UnlistFromLru(int Pg) {
     if (a.LruPrev >= 0) {
         LoadedPages[a.LruPrev].LruNext = a.LruNext;
     }
+    if (a.InP) { InPages--; }
 }
 
 /// insert given (new) page to the start of LRU list
 void TPgBlob::EnlistToStartLru(int Pg) {
     LoadedPage& a = LoadedPages[Pg];
+    int& First = GetListFirst(Pg);
+    int& Last = GetListLast(Pg);
     a.LruPrev = -1;
-    a.LruNext = LruFirst;
-    if (LruFirst >= 0) {
-        LoadedPages[LruFirst].LruPrev = Pg;
+    a.LruNext = First;
+    if (First >= 0) {
+        LoadedPages[First].LruPrev = Pg;
     }
-    LruFirst = Pg;
-    if (LruLast < 0) {
-        LruLast = Pg;
+    First = Pg;
+    if (Last < 0) {
+        Last = Pg;
     }
+    if (a.InP) { InPages++; }
 }
 
 /// insert given (new) page to the end of LRU list
 void TPgBlob::EnlistToEndLru(int Pg) {
     LoadedPage& a = LoadedPages[Pg];
-    a.LruPrev = LruLast;
+    int& First = GetListFirst(Pg);
+    int& Last = GetListLast(Pg);
+    a.LruPrev = Last;
     a.LruNext = -1;
-    if (LruLast >= 0) {
-        LoadedPages[LruLast].LruNext = Pg;
+    if (Last >= 0) {
+        LoadedPages[Last].LruNext = Pg;
     }
-    LruLast = Pg;
-    if (LruFirst < 0) {
-        LruFirst = Pg;
+    Last = Pg;
+    if (First < 0) {
+        First = Pg;
     }
+    if (a.InP) { InPages++; }
 }
 
 /// move given page to the start of LRU list
 void TPgBlob::MoveToStartLru(int Pg) {
-    LoadedPage& a = LoadedPages[Pg];
-    if (LruFirst < 0) { // empty LRU list
-        a.LruNext = a.LruPrev = -1;
-        LruFirst = LruLast = Pg;
-    } else if (LruFirst == Pg) {
-        // it's ok, already at start LRU
-    } else {
+    if (GetListFirst(Pg) != Pg) {
         UnlistFromLru(Pg);
         EnlistToStartLru(Pg);
     }
@@ -415,34 +513,47 @@ void TPgBlob::MoveToStartLru(int Pg) {
 
 /// move given page to the end of LRU list - so that it is evicted first
 void TPgBlob::MoveToEndLru(int Pg) {
-    LoadedPage& a = LoadedPages[Pg];
-    if (LruLast < 0) { // empty LRU list
-        a.LruNext = a.LruPrev = -1;
-        LruFirst = LruLast = Pg;
-    } else if (LruLast == Pg) {
-        // it's ok, already at end LRU
-    } else {
+    if (GetListLast(Pg) != Pg) {
         UnlistFromLru(Pg);
         EnlistToEndLru(Pg);
     }
 }
 
-/// Evicts last possible page from cache.
-int TPgBlob::Evict() {
-    int Pg = LruLast;
-    while (Pg != LruFirst) {
-        if (CanEvictPage(Pg)) {
-            break;
-        }
+/// Enlist new page according to policy and scan mode
+void TPgBlob::EnlistNew(const int& Pg, const bool& HotP) {
+    LoadedPage& a = LoadedPages[Pg];
+    a.ScanP = (ScanN > 0);
+    // pages seen recently go to LRU list, others wait in probation list
+    a.InP = (Policy == cp2Q) && !HotP;
+    if (a.ScanP) { EnlistToEndLru(Pg); } else { EnlistToStartLru(Pg); }
+}
+
+/// Find evictable page in the list, starting at its end, -1 if none
+int TPgBlob::FindVictim(const int& Last) {
+    int Pg = Last;
+    while (Pg >= 0 && !CanEvictPage(Pg)) {
         Pg = LoadedPages[Pg].LruPrev;
     }
+    return Pg;
+}
+
+/// Evicts last possible page from cache.
+int TPgBlob::Evict() {
+    // probation list is kept at a quarter of the cache, LRU list gets the rest
+    const bool InFirstP = InLast >= 0 && (LruLast < 0 ||
+        Policy != cp2Q || (uint64)InPages > MxLoadedPages / 4);
+    int Pg = InFirstP ? FindVictim(InLast) : FindVictim(LruLast);
+    if (Pg < 0) { Pg = InFirstP ? FindVictim(LruLast) : FindVictim(InLast); }
+    if (Pg < 0) { Pg = InFirstP ? InFirst : LruFirst; }
     LoadedPage& a = LoadedPages[Pg];
+    if (a.InP && !a.ScanP) { GhostQ.Add(a.Pt, (int)(MxLoadedPages / 2 + 1)); }
     UnlistFromLru(Pg);
     LoadedPagesH.DelKey(a.Pt);
     char* PgPt = GetPageBf(Pg);
     if (ShouldSavePageP(PgPt)) {
         int Len = (((TPgHeader*)PgPt)->ItemCount > 0 ? -1 : sizeof(TPgHeader));
         Files[a.Pt.GetFIx()]->SavePage(a.Pt.GetPg(), PgPt, Len);
+        DirtyPages--;
     } else {
     }
     return Pg;
@@ -450,11 +561,29 @@ int TPgBlob::Evict() {
 
 /// Load given page into memory
 char* TPgBlob::LoadPage(const TPgBlobPgPt& Pt, const bool& LoadData) {
+    if (IsMmap()) {
+        // page is served directly from the mapping, OS does the caching
+        return Files[Pt.GetFIx()]->GetPageBf(Pt.GetPg());
+    }
     int Pg;
     if (LoadedPagesH.IsKeyGetDat(Pt, Pg)) { // is page in cache
-        MoveToStartLru(Pg);
+        if (LoadData) { Hits++; }
+        LoadedPage& a = LoadedPages[Pg];
+        if (ScanN > 0) {
+            // scans do not refresh pages
+        } else if (a.ScanP) {
+            // page loaded by a scan is used again, keep it as regular new page
+            UnlistFromLru(Pg);
+            a.ScanP = false;
+            EnlistToStartLru(Pg);
+        } else if (!a.InP) {
+            MoveToStartLru(Pg);
+        }
         return GetPageBf(Pg);
     }
+    if (LoadData) { Misses++; }
+    // check before evicting, which can push the page out of the ghost queue
+    const bool HotP = (Policy == cp2Q) && (ScanN == 0) && GhostQ.Del(Pt);
     if ((uint64)LoadedPages.Len() == MxLoadedPages) {
         // evict last page + load new page
         Pg = Evict();
@@ -463,7 +592,7 @@ char* TPgBlob::LoadPage(const TPgBlobPgPt& Pt, const bool& LoadData) {
             Files[Pt.GetFIx()]->LoadPage(Pt.GetPg(), GetPageBf(Pg));
         }
         a.Pt = Pt;
-        EnlistToStartLru(Pg);
+        EnlistNew(Pg, HotP);
         LoadedPagesH.AddDat(Pt, Pg);
     } else {
         // simply load the page
@@ -479,7 +608,7 @@ char* TPgBlob::LoadPage(const TPgBlobPgPt& Pt, const bool& LoadData) {
             Files[Pt.GetFIx()]->LoadPage(Pt.GetPg(), GetPageBf(Pg));
         }
         a.Pt = Pt;
-        EnlistToStartLru(Pg);
+        EnlistNew(Pg, HotP);
         LoadedPagesH.AddDat(Pt, Pg);
     }
     char* PgPt = GetPageBf(Pg);
@@ -496,27 +625,75 @@ void TPgBlob::CreateNewPage(TPgBlobPgPt& Pt, char** Bf) {
         if (Pg >= 0) {
             Pt.Set(Files.Len() - 1, (uint32)Pg);
             *Bf = LoadPage(Pt, false);
+            OnPageChange(*Bf);
             InitPageP(*Bf);
             return;
         }
     }
     TStr NewFNm = FNm + ".bin" + TStr::GetNrNumFExt(Files.Len());
-    Files.Add(TPgBlobFile::New(NewFNm, TFAccess::faCreate, MxBlobFLen));
+    Files.Add(TPgBlobFile::New(NewFNm, TFAccess::faCreate, MxBlobFLen, IsMmap(), AccessHint));
     long Pg = Files.Last()->CreateNewPage();
     EAssert(Pg >= 0);
     Pt.Set(Files.Len() - 1, (uint32)Pg);
     *Bf = LoadPage(Pt, false);
+    OnPageChange(*Bf);
     InitPageP(*Bf);
 }
 
 /// Factory method for creating new BLOB storage
-PPgBlob TPgBlob::Create(const TStr& FNm, const uint64& CacheSize) {
-    return PPgBlob(new TPgBlob(FNm, TFAccess::faCreate, CacheSize));
+PPgBlob TPgBlob::Create(const TStr& FNm, const uint64& CacheSize,
+    const TPgBlobBackend& Backend, const TPgBlobAccess& AccessHint) {
+    return PPgBlob(new TPgBlob(FNm, TFAccess::faCreate, CacheSize, Backend, AccessHint));
 }
 
 /// Factory method for opening existing BLOB storage
-PPgBlob TPgBlob::Open(const TStr& FNm, const uint64& CacheSize) {
-    return PPgBlob(new TPgBlob(FNm, TFAccess::faUpdate, CacheSize));
+PPgBlob TPgBlob::Open(const TStr& FNm, const uint64& CacheSize,
+    const TPgBlobBackend& Backend, const TPgBlobAccess& AccessHint) {
+    return PPgBlob(new TPgBlob(FNm, TFAccess::faUpdate, CacheSize, Backend, AccessHint));
+}
+
+/// Change expected access pattern, e.g. before a full scan
+void TPgBlob::SetAccessHint(const TPgBlobAccess& _AccessHint) {
+    AccessHint = _AccessHint;
+    for (int FileN = 0; FileN < Files.Len(); FileN++) {
+        Files[FileN]->SetAccessHint(AccessHint);
+    }
+}
+
+/// Change page replacement policy, loaded pages are kept
+void TPgBlob::SetCachePolicy(const TCachePolicy& _Policy) {
+    // pages left in probation list are evicted first under LRU policy
+    Policy = _Policy;
+    if (Policy != cp2Q) { GhostQ.Clr(); }
+}
+
+/// Open scan, pages loaded until EndScan are evicted first
+void TPgBlob::StartScan() {
+    ScanN++;
+    if (IsMmap()) { SetAccessHint(pbaSequential); }
+}
+
+/// Close scan opened by StartScan
+void TPgBlob::EndScan() {
+    IAssert(ScanN > 0);
+    ScanN--;
+    if (IsMmap() && ScanN == 0) { SetAccessHint(pbaNormal); }
+}
+
+/// Name of the backend
+TStr TPgBlob::GetBackendStr(const TPgBlobBackend& Backend) {
+    switch (Backend) {
+    case pbbCache: return "cache";
+    case pbbMmap: return "mmap";
+    default: FailR("Unknown TPgBlob backend."); return TStr();
+    }
+}
+
+/// Parse backend from its name
+TPgBlobBackend TPgBlob::GetBackend(const TStr& BackendStr) {
+    if (BackendStr == "cache") { return pbbCache; }
+    if (BackendStr == "mmap") { return pbbMmap; }
+    throw TExcept::New("Unknown TPgBlob backend: " + BackendStr);
 }
 
 /// Initialize new page
@@ -542,17 +719,21 @@ TPgBlobPt TPgBlob::Put(const char* Bf, const int& BfL) {
 
     // scan last 5 used pages if there is some space
     // the logic is that during batch inserts we should reuse
-    // recently-used pages so that data is packed together
-    int LoadedPage = LruFirst;
-    for (int i = 0; i < 5 && LoadedPage != -1; i++) {
-        char* PgBfTmp = GetPageBf(LoadedPage);
-        PgH = (TPgHeader*)PgBfTmp;
-        if (PgH->CanStoreBf(BfL)) {
-            PgBf = PgBfTmp;
-            PgPt = LoadedPages[LoadedPage].Pt;
-            break;
+    // recently-used pages so that data is packed together;
+    // with 2Q policy new pages are in the probation list
+    const int FirstV[] = { InFirst, LruFirst };
+    for (int ListN = 0; ListN < 2 && PgBf == NULL; ListN++) {
+        int LoadedPage = FirstV[ListN];
+        for (int i = 0; i < 5 && LoadedPage != -1; i++) {
+            char* PgBfTmp = GetPageBf(LoadedPage);
+            PgH = (TPgHeader*)PgBfTmp;
+            if (PgH->CanStoreBf(BfL)) {
+                PgBf = PgBfTmp;
+                PgPt = LoadedPages[LoadedPage].Pt;
+                break;
+            }
+            LoadedPage = LoadedPages[LoadedPage].LruNext;
         }
-        LoadedPage = LoadedPages[LoadedPage].LruNext;
     }
 
     // if no page found in memory, use FSM
@@ -566,6 +747,7 @@ TPgBlobPt TPgBlob::Put(const char* Bf, const int& BfL) {
     }
 
     // add data
+    OnPageChange(PgBf);
     uint16 ii = AddItem(PgBf, Bf, BfL);
     TPgBlobPt Pt(PgPt.GetFIx(), PgPt.GetPg(), ii);
     PgH = (TPgHeader*)PgBf;
@@ -595,6 +777,7 @@ TPgBlobPt TPgBlob::Put(
     ItemRec = GetItemRec(PgBf, Pt.GetIIx());
 
     int existing_size = ItemRec->Len;
+    OnPageChange(PgBf);
     if (existing_size == BfL) {
         // we're so lucky, just overwrite buffer
         memcpy(PgBf + ItemRec->Offset, Bf, BfL);
@@ -615,6 +798,7 @@ TPgBlobPt TPgBlob::Put(
         Fsm.FsmUpdatePage(PgPt, PgH->GetFreeMem());
 
         CreateNewPage(PgPt, &PgBf);
+        OnPageChange(PgBf);
         uint16 ii = AddItem(PgBf, Bf, BfL);
 
         TPgBlobPt Pt2(PgPt.GetFIx(), PgPt.GetPg(), ii);
@@ -643,10 +827,12 @@ void TPgBlob::Del(const TPgBlobPt& Pt) {
     char* PgBf = LoadPage(PgPt);
     TPgHeader* PgH = (TPgHeader*)PgBf;
 
+    OnPageChange(PgBf);
     DeleteItem(PgBf, Pt.GetIIx());
-    if (PgH->ItemCount == 0) {
+    int Pg;
+    if (!IsMmap() && PgH->ItemCount == 0 && LoadedPagesH.IsKeyGetDat(PgPt, Pg)) {
         // optimization - empty pages are to be flushed as fast as possible
-        MoveToEndLru(Pt.GetPg());
+        MoveToEndLru(Pg);
     }
     Fsm.FsmUpdatePage(PgPt, PgH->GetFreeMem());
 }
@@ -658,6 +844,12 @@ TMemBase TPgBlob::GetMemBase(const TPgBlobPt& Pt) {
 
 /// Loads all pages into cache - cache must be big enough
 void TPgBlob::LoadAll() {
+    if (IsMmap()) {
+        for (int FileN = 0; FileN < Files.Len(); FileN++) {
+            Files[FileN]->WillNeed();
+        }
+        return;
+    }
     for (int i = 0; i < Fsm.Len(); i++) {
         LoadPage(Fsm.GetVal(i));
     }
@@ -673,28 +865,67 @@ void TPgBlob::Clr() {
     TFile::DelWc(FNm + ".bin*"); // delete all child files
     LastExtentCnt = PG_EXTENT_PCOUNT;
     LruFirst = LruLast = -1;
+    InFirst = InLast = -1;
+    InPages = 0;
+    DirtyPages = 0;
+    GhostQ.Clr();
     SaveMain();
 }
 
 /// Save part of the data, given time-window
-void TPgBlob::PartialFlush(int WndInMsec) {
+int TPgBlob::PartialFlush(int WndInMsec) {
     if (Access == TFAccess::faRdOnly)
-        return;
+        return 0;
+    if (IsMmap()) {
+        // kernel writes pages in the background, we only need to start it
+        for (int FileN = 0; FileN < Files.Len(); FileN++) {
+            Files[FileN]->Flush(false);
+        }
+        return 0;
+    }
     TTmStopWatch sw(true);
+    int res = 0;
     for (int i = 0; i < LoadedPages.Len(); i++) {
         if (ShouldSavePage(i)) {
             LoadedPage& a = LoadedPages[i];
-            Files[a.Pt.GetFIx()]->SavePage(a.Pt.GetPg(), GetPageBf(i));
+            char* Pg = GetPageBf(i);
+            // page is saved with the flag set, loading clears it
+            Files[a.Pt.GetFIx()]->SavePage(a.Pt.GetPg(), Pg);
+            // page matches the disk now, no need to save it again when evicted
+            ((TPgHeader*)Pg)->SetDirty(false);
+            DirtyPages--;
+            res++;
             if (sw.GetMSec() > WndInMsec)
                 break;
         }
     }
+    return res;
+}
+
+/// Save all dirty pages and the main file
+void TPgBlob::Flush() {
+    if (Access == TFAccess::faRdOnly)
+        return;
+    PartialFlush(TInt::Mx);
+    for (int FileN = 0; FileN < Files.Len(); FileN++) {
+        Files[FileN]->Flush(true);
+    }
+    SaveMain();
+}
+
+/// Number of bytes in dirty pages
+uint64 TPgBlob::GetDirtyBytes() {
+    if (Access == TFAccess::faRdOnly || IsMmap()) { return 0; }
+    return DirtyPages * PG_PAGE_SIZE;
 }
 
 /// Marks page as dirty - data inside was written directly
 void TPgBlob::SetDirty(const TPgBlobPt& Pt) {
     IAssert(Access != TFAccess::faRdOnly);
+    // writes to mapped pages reach the file without our help
+    if (IsMmap()) { return; }
     char* Pg = LoadPage(Pt);
+    OnPageChange(Pg);
     ((TPgHeader*)Pg)->SetDirty(true);
 }
 
@@ -708,9 +939,21 @@ PJsonVal TPgBlob::GetStats() {
     }
 
     PJsonVal res = TJsonVal::NewObj();
+    res->AddToObj("backend", GetBackendStr(Backend));
+    if (IsMmap()) {
+        uint64 MappedPages = 0;
+        for (int FileN = 0; FileN < Files.Len(); FileN++) {
+            MappedPages += Files[FileN]->GetPgCnt();
+        }
+        res->AddToObj("mapped_pages", MappedPages);
+    }
     res->AddToObj("page_size", PG_PAGE_SIZE);
     res->AddToObj("loaded_pages", LoadedPages.Len());
     res->AddToObj("dirty_pages", dirty);
+    res->AddToObj("policy", TCachePolicyStr::GetStr(Policy));
+    res->AddToObj("hits", Hits);
+    res->AddToObj("misses", Misses);
+    res->AddToObj("hit_rate", (Hits + Misses > 0) ? (double)Hits / (double)(Hits + Misses) : 0.0);
     res->AddToObj("loaded_extents", Extents.Len());
     res->AddToObj("cache_size", PG_EXTENT_SIZE * Extents.Len());
     return res;
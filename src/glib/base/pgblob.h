@@ -28,6 +28,18 @@ typedef TPt<TPgBlob> PPgBlob;
 #define PgHeaderSLockFlag (0x02)
 #define PgHeaderXLockFlag (0x04)
 
+/// Page backend of paged-BLOB storage
+typedef enum {
+    pbbCache = 0, ///< pages are read into own LRU cache of extents
+    pbbMmap = 1   ///< segment files are memory-mapped, OS page cache is the only cache (UNIX only)
+} TPgBlobBackend;
+
+/// Expected access pattern for memory-mapped pages, passed to the OS as a hint
+typedef enum {
+    pbaNormal = 0,     ///< no special treatment
+    pbaSequential = 1, ///< pages are read in order, read ahead aggressively
+    pbaRandom = 2      ///< pages are read in random order, do not read ahead
+} TPgBlobAccess;
 
 ////////////////////////////////////////////////////////////
 /// Pointer to Paged-Blob page
@@ -230,11 +242,18 @@ private:
     TFAccess Access;
     /// Random-access file - BLOB storage
     FILE* FileId;
+    /// Start of memory-mapped file, NULL when file is not mapped.
+    /// Address space for the maximal file length is reserved up front,
+    /// so pointers into the mapping stay valid when the file grows.
+    char* MapBf;
+    /// Length of reserved address space
+    uint64 MapLen;
     static char* EmptyPage;
 
     /// Private constructor
     TPgBlobFile(const TStr& _FNm, const TFAccess& _Access = faRdOnly,
-        const uint32& _MxSegLen = -1);
+        const uint32& _MxSegLen = -1, const bool& MmapP = false,
+        const TPgBlobAccess& AccessHint = pbaNormal);
 
     /// Refresh the position - internal check
     void RefreshFPos();
@@ -250,8 +269,9 @@ public:
 
     /// Factory method
     static PPgBlobFile New(const TStr& FNm, const TFAccess& Access = faRdOnly,
-        const uint32& MxSegLen = -1) {
-        return PPgBlobFile(new TPgBlobFile(FNm, Access, MxSegLen));
+        const uint32& MxSegLen = -1, const bool& MmapP = false,
+        const TPgBlobAccess& AccessHint = pbaNormal) {
+        return PPgBlobFile(new TPgBlobFile(FNm, Access, MxSegLen, MmapP, AccessHint));
     }
 
     /// Load page with given index from the file into buffer
@@ -264,6 +284,19 @@ public:
     const TStr& GetFNm() const { return FNm; }
     /// Returns the number of pages stored in this file
     long GetPgCnt() const { return PgCnt; }
+
+    /// Is file memory-mapped
+    bool IsMmap() const { return MapBf != NULL; }
+    /// Pointer to the page within the mapping, file must be memory-mapped
+    char* GetPageBf(const uint32& Page) const {
+        return MapBf + (uint64)Page * PG_PAGE_SIZE;
+    }
+    /// Pass expected access pattern of the mapping to the OS
+    void SetAccessHint(const TPgBlobAccess& AccessHint);
+    /// Ask the OS to read all pages of the mapping ahead
+    void WillNeed();
+    /// Write modified pages to disk (buffered or mapped), blocks when SyncP is set
+    void Flush(const bool& SyncP);
 };
 
 ////////////////////////////////////////////////////////////
@@ -283,6 +316,10 @@ protected:
         int LruNext;
         /// Previous item in LRU list
         int LruPrev;
+        /// Page is in the probation list of 2Q policy
+        bool InP;
+        /// Page was loaded by a scan and is evicted first
+        bool ScanP;
     };
 
     /// Single record in item index section
@@ -320,15 +357,15 @@ protected:
 
         /// Set dirty flag for this page
         void SetDirty(bool val) {
-            if (val) { Flags |= PgHeaderDirtyFlag; } else { Flags ^= PgHeaderDirtyFlag; }
+            if (val) { Flags |= PgHeaderDirtyFlag; } else { Flags &= ~PgHeaderDirtyFlag; }
         }
         /// Set S-lock flag for this page
         void SetSLock(bool val) {
-            if (val) { Flags |= PgHeaderSLockFlag; } else { Flags ^= PgHeaderSLockFlag; }
+            if (val) { Flags |= PgHeaderSLockFlag; } else { Flags &= ~PgHeaderSLockFlag; }
         }
         /// Set X-lock flag for this page
         void SetXLock(bool val) {
-            if (val) { Flags |= PgHeaderXLockFlag; } else { Flags ^= PgHeaderXLockFlag; }
+            if (val) { Flags |= PgHeaderXLockFlag; } else { Flags &= ~PgHeaderXLockFlag; }
         }
         /// Get amount of free space in this page
         int GetFreeMem() { return OffsetFreeEnd - OffsetFreeStart; }
@@ -353,6 +390,25 @@ protected:
     int LruFirst;
     /// Previous item in LRU list - the next candidate for eviction
     int LruLast;
+    /// First page in the probation list of 2Q policy - loaded last
+    int InFirst;
+    /// Last page in the probation list of 2Q policy
+    int InLast;
+    /// Number of pages in the probation list
+    int InPages;
+    /// Number of loaded pages with changes not saved yet
+    uint64 DirtyPages;
+    /// Pages recently evicted from probation list, they go to LRU list when loaded again
+    TCacheGhostQ<TPgBlobPgPt> GhostQ;
+
+    /// Page replacement policy
+    TCachePolicy Policy;
+    /// Number of open scans
+    int ScanN;
+    /// Number of page loads served from cache
+    uint64 Hits;
+    /// Number of page loads read from disk
+    uint64 Misses;
 
     /// Vector of allocated extents
     TVec<TMemBase> Extents;
@@ -363,6 +419,11 @@ protected:
     /// Maximal number of loaded pages
     uint64 MxLoadedPages;
 
+    /// Page backend, pages are not cached by us when memory-mapped
+    TPgBlobBackend Backend;
+    /// Expected access pattern, used for memory-mapped files
+    TPgBlobAccess AccessHint;
+
     /// Returns starting address of page in Bf
     char* GetPageBf(int Pg) {
         return
@@ -372,6 +433,15 @@ protected:
 
     // Method for handling LRU list ///////////////////////////////////
 
+    /// First page of the list holding given page
+    int& GetListFirst(const int& Pg) { return LoadedPages[Pg].InP ? InFirst : LruFirst; }
+    /// Last page of the list holding given page
+    int& GetListLast(const int& Pg) { return LoadedPages[Pg].InP ? InLast : LruLast; }
+    /// Enlist new page according to policy and scan mode, HotP when it was in ghost queue
+    void EnlistNew(const int& Pg, const bool& HotP);
+    /// Find evictable page in the list, starting at its end, -1 if none
+    int FindVictim(const int& Last);
+
     /// remove given page from LRU list
     void UnlistFromLru(int Pg);
     /// move given page to the start of LRU list
@@ -397,6 +467,8 @@ protected:
 
     /// This method tells if given page should be stored to disk.
     bool ShouldSavePage(int Pg) { return ShouldSavePageP(GetPageBf(Pg)); }
+    /// Count loaded page as dirty, to be called before it is changed
+    void OnPageChange(char* Pg) { if (!IsMmap() && !ShouldSavePageP(Pg)) { DirtyPages++; } }
     /// This method tells if given page can be evicted from cache.
     bool CanEvictPage(int Pg) { return CanEvictPageP(GetPageBf(Pg)); }
     /// This method should be overridden in derived class to tell
@@ -431,15 +503,41 @@ public:
     /// Reference count for smart pointers
     TCRef CRef;
 
-    /// Constructor
-    TPgBlob(const TStr& _FNm, const TFAccess& _Access, const uint64& CacheSize);
+    /// Constructor. Memory-mapped backend falls back to cache where not supported.
+    TPgBlob(const TStr& _FNm, const TFAccess& _Access, const uint64& CacheSize,
+        const TPgBlobBackend& _Backend = pbbCache, const TPgBlobAccess& _AccessHint = pbaNormal);
     /// Destructor
     ~TPgBlob();
 
     /// Factory method for creating new BLOB storage
-    static PPgBlob Create(const TStr& FNm, const uint64& CacheSize = 10 * TNum<int>::Mega);
+    static PPgBlob Create(const TStr& FNm, const uint64& CacheSize = 10 * TNum<int>::Mega,
+        const TPgBlobBackend& Backend = pbbCache, const TPgBlobAccess& AccessHint = pbaNormal);
     /// Factory method for opening existing BLOB storage
-    static PPgBlob Open(const TStr& FNm, const uint64& CacheSize = 10 * TNum<int>::Mega);
+    static PPgBlob Open(const TStr& FNm, const uint64& CacheSize = 10 * TNum<int>::Mega,
+        const TPgBlobBackend& Backend = pbbCache, const TPgBlobAccess& AccessHint = pbaNormal);
+
+    /// Page backend in use
+    TPgBlobBackend GetBackend() const { return Backend; }
+    /// Are segment files memory-mapped
+    bool IsMmap() const { return Backend == pbbMmap; }
+    /// Change expected access pattern, e.g. before a full scan
+    void SetAccessHint(const TPgBlobAccess& _AccessHint);
+    /// Page replacement policy
+    TCachePolicy GetCachePolicy() const { return Policy; }
+    /// Change page replacement policy, loaded pages are kept
+    void SetCachePolicy(const TCachePolicy& _Policy);
+    /// Open scan, pages loaded until EndScan are evicted first. Scans can nest.
+    void StartScan();
+    /// Close scan opened by StartScan
+    void EndScan();
+    /// Number of page loads served from cache
+    uint64 GetCacheHits() const { return Hits; }
+    /// Number of page loads read from disk
+    uint64 GetCacheMisses() const { return Misses; }
+    /// Name of the backend
+    static TStr GetBackendStr(const TPgBlobBackend& Backend);
+    /// Parse backend from its name
+    static TPgBlobBackend GetBackend(const TStr& BackendStr);
 
     /// Store new BLOB to storage
     TPgBlobPt Put(const char* Bf, const int& BfL);
@@ -458,8 +556,12 @@ public:
     /// Clear all contents
     void Clr();
 
-    /// Save part of the data, given time-window
-    void PartialFlush(int WndInMsec = 500);
+    /// Save part of the data, given time-window. Returns number of saved pages.
+    int PartialFlush(int WndInMsec = 500);
+    /// Save all dirty pages and the main file to disk and wait for the disk
+    void Flush();
+    /// Number of bytes in dirty pages, pages of mapped files are written by the kernel
+    uint64 GetDirtyBytes();
     /// Retrieve statistics for this object
     PJsonVal GetStats();
 
@@ -0,0 +1,440 @@
+/**
+ * Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+ * All rights reserved.
+ *
+ * This source code is licensed under the FreeBSD license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+// SIMD kernels are compiled only for x86, other platforms use scalar merge
+#if defined(GLib_MSC) && (defined(_M_X64) || defined(_M_IX86))
+    #define SORTEDSET_SIMD
+    #include <intrin.h>
+    #include <immintrin.h>
+#elif defined(GLib_GCC) && !defined(__clang__) && (defined(__x86_64__) || defined(__i386__))
+    #define SORTEDSET_SIMD
+    #include <immintrin.h>
+#endif
+
+/////////////////////////////////////////////////
+// Sorted-Set-Item
+namespace {
+
+/// Access to the id and weight of items stored in sorted vectors
+template <class TItem> class TSortedSetItem { };
+
+template <> class TSortedSetItem<TUInt64IntKd> {
+public:
+    typedef uint64 TId;
+    static uint64 GetId(const TUInt64IntKd& Item) { return Item.Key.Val; }
+    static void AddDat(TUInt64IntKd& Item, const TUInt64IntKd& JoinItem) { Item.Dat.Val += JoinItem.Dat.Val; }
+};
+
+template <> class TSortedSetItem<TUInt64> {
+public:
+    typedef uint64 TId;
+    static uint64 GetId(const TUInt64& Item) { return Item.Val; }
+    static void AddDat(TUInt64& Item, const TUInt64& JoinItem) { }
+};
+
+template <> class TSortedSetItem<TUInt> {
+public:
+    typedef uint TId;
+    static uint GetId(const TUInt& Item) { return Item.Val; }
+    static void AddDat(TUInt& Item, const TUInt& JoinItem) { }
+};
+
+/// Index of the lowest set bit
+inline int GetLowBitN(const int& Mask) {
+#ifdef GLib_MSC
+    unsigned long BitN; _BitScanForward(&BitN, (unsigned long)Mask); return (int)BitN;
+#else
+    return __builtin_ctz((unsigned int)Mask);
+#endif
+}
+
+/// Scalar merge for finding matching items, continues from given positions.
+/// Stops after MxMatches matches, the capacity of the position buffers.
+template <class TItem>
+int ScalarMatch(const TItem* ItemV1, const int& Len1, const TItem* ItemV2, const int& Len2,
+        int ItemN1, int ItemN2, TInt* PosV1, TInt* PosV2, int Matches, const int& MxMatches) {
+
+    typedef TSortedSetItem<TItem> TSsItem;
+    while (ItemN1 < Len1 && ItemN2 < Len2 && Matches < MxMatches) {
+        const typename TSsItem::TId Id1 = TSsItem::GetId(ItemV1[ItemN1]);
+        const typename TSsItem::TId Id2 = TSsItem::GetId(ItemV2[ItemN2]);
+        if (Id1 < Id2) { ItemN1++; }
+        else if (Id2 < Id1) { ItemN2++; }
+        else { PosV1[Matches] = ItemN1++; PosV2[Matches] = ItemN2++; Matches++; }
+    }
+    return Matches;
+}
+
+/// Find matches of short vector in a long one by galloping over the long one
+template <class TItem>
+int GallopMatch(const TItem* ShortItemV, const int& ShortLen, const TItem* LongItemV,
+        const int& LongLen, TInt* ShortPosV, TInt* LongPosV) {
+
+    typedef TSortedSetItem<TItem> TSsItem;
+    int Matches = 0, LongN = 0;
+    for (int ShortN = 0; ShortN < ShortLen && LongN < LongLen; ShortN++) {
+        const typename TSsItem::TId Id = TSsItem::GetId(ShortItemV[ShortN]);
+        LongN = TSortedSet::Gallop(LongItemV, LongLen, LongN,
+            [&Id](const TItem& Item) { return TSsItem::GetId(Item) < Id; });
+        if (LongN < LongLen && TSsItem::GetId(LongItemV[LongN]) == Id) {
+            ShortPosV[Matches] = ShortN; LongPosV[Matches] = LongN++; Matches++;
+        }
+    }
+    return Matches;
+}
+
+#ifdef SORTEDSET_SIMD
+
+// plain id vectors are loaded into registers directly
+static_assert(sizeof(TUInt64) == sizeof(uint64) && sizeof(TUInt) == sizeof(uint), "Unexpected id layout");
+
+/////////////////////////////////////////////////
+// SSE4.2 kernels
+#ifdef GLib_GCC
+#pragma GCC push_options
+#pragma GCC target("sse4.2")
+#endif
+
+/// Lanes of A equal to any lane of B
+inline int SseEqMask64(const __m128i& A, const __m128i& B) {
+    const __m128i EqV = _mm_or_si128(_mm_cmpeq_epi64(A, B), _mm_cmpeq_epi64(A, _mm_shuffle_epi32(B, 0x4E)));
+    return _mm_movemask_pd(_mm_castsi128_pd(EqV));
+}
+
+/// Loading of ids into registers for different item types
+template <class TItem> class TSseBlock { };
+
+template <> class TSseBlock<TUInt64IntKd> {
+public:
+    enum { Lanes = 2 };
+    static __m128i Load(const TUInt64IntKd* ItemV) {
+        // keys are interleaved with weights, load them one by one
+        return _mm_set_epi64x((int64)ItemV[1].Key.Val, (int64)ItemV[0].Key.Val); }
+    static int GetEqMask(const __m128i& A, const __m128i& B) { return SseEqMask64(A, B); }
+};
+
+template <> class TSseBlock<TUInt64> {
+public:
+    enum { Lanes = 2 };
+    static __m128i Load(const TUInt64* ItemV) { return _mm_loadu_si128((const __m128i*)ItemV); }
+    static int GetEqMask(const __m128i& A, const __m128i& B) { return SseEqMask64(A, B); }
+};
+
+template <> class TSseBlock<TUInt> {
+public:
+    enum { Lanes = 4 };
+    static __m128i Load(const TUInt* ItemV) { return _mm_loadu_si128((const __m128i*)ItemV); }
+    static int GetEqMask(const __m128i& A, const __m128i& B) {
+        __m128i EqV = _mm_cmpeq_epi32(A, B);
+        EqV = _mm_or_si128(EqV, _mm_cmpeq_epi32(A, _mm_shuffle_epi32(B, 0x39)));
+        EqV = _mm_or_si128(EqV, _mm_cmpeq_epi32(A, _mm_shuffle_epi32(B, 0x4E)));
+        EqV = _mm_or_si128(EqV, _mm_cmpeq_epi32(A, _mm_shuffle_epi32(B, 0x93)));
+        return _mm_movemask_ps(_mm_castsi128_ps(EqV));
+    }
+};
+
+/// Find matching items by comparing blocks of ids from both vectors
+template <class TItem>
+int SseMatch(const TItem* ItemV1, const int& Len1, const TItem* ItemV2,
+        const int& Len2, TInt* PosV1, TInt* PosV2, const int& MxMatches) {
+
+    typedef TSortedSetItem<TItem> TSsItem;
+    typedef TSseBlock<TItem> TBlock;
+    const int Lanes = TBlock::Lanes;
+    int Matches = 0, ItemN1 = 0, ItemN2 = 0;
+    while (ItemN1 + Lanes <= Len1 && ItemN2 + Lanes <= Len2) {
+        int Mask = TBlock::GetEqMask(TBlock::Load(ItemV1 + ItemN1), TBlock::Load(ItemV2 + ItemN2));
+        while (Mask != 0) {
+            // locate matching item in the second block
+            const int MatchN1 = ItemN1 + GetLowBitN(Mask); Mask &= Mask - 1;
+            const typename TSsItem::TId Id = TSsItem::GetId(ItemV1[MatchN1]);
+            int MatchN2 = ItemN2; while (TSsItem::GetId(ItemV2[MatchN2]) != Id) { MatchN2++; }
+            // repeated ids can match more than once, never write past the buffers
+            if (Matches == MxMatches) { return Matches; }
+            PosV1[Matches] = MatchN1; PosV2[Matches] = MatchN2; Matches++;
+        }
+        // move the block with smaller last id, or both when equal
+        const typename TSsItem::TId LastId1 = TSsItem::GetId(ItemV1[ItemN1 + Lanes - 1]);
+        const typename TSsItem::TId LastId2 = TSsItem::GetId(ItemV2[ItemN2 + Lanes - 1]);
+        if (LastId1 <= LastId2) { ItemN1 += Lanes; }
+        if (LastId2 <= LastId1) { ItemN2 += Lanes; }
+    }
+    return ScalarMatch(ItemV1, Len1, ItemV2, Len2, ItemN1, ItemN2, PosV1, PosV2, Matches, MxMatches);
+}
+
+#ifdef GLib_GCC
+#pragma GCC pop_options
+#endif
+
+/////////////////////////////////////////////////
+// AVX2 kernels
+#ifdef GLib_GCC
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+/// Lanes of A equal to any lane of B
+inline int Avx2EqMask64(const __m256i& A, const __m256i& B) {
+    __m256i EqV = _mm256_cmpeq_epi64(A, B);
+    EqV = _mm256_or_si256(EqV, _mm256_cmpeq_epi64(A, _mm256_permute4x64_epi64(B, 0x39)));
+    EqV = _mm256_or_si256(EqV, _mm256_cmpeq_epi64(A, _mm256_permute4x64_epi64(B, 0x4E)));
+    EqV = _mm256_or_si256(EqV, _mm256_cmpeq_epi64(A, _mm256_permute4x64_epi64(B, 0x93)));
+    return _mm256_movemask_pd(_mm256_castsi256_pd(EqV));
+}
+
+/// Loading of ids into registers for different item types
+template <class TItem> class TAvx2Block { };
+
+template <> class TAvx2Block<TUInt64IntKd> {
+public:
+    enum { Lanes = 4 };
+    static __m256i Load(const TUInt64IntKd* ItemV) {
+        // keys are interleaved with weights, load them one by one
+        return _mm256_set_epi64x((int64)ItemV[3].Key.Val, (int64)ItemV[2].Key.Val,
+            (int64)ItemV[1].Key.Val, (int64)ItemV[0].Key.Val);
+    }
+    static int GetEqMask(const __m256i& A, const __m256i& B) { return Avx2EqMask64(A, B); }
+};
+
+template <> class TAvx2Block<TUInt64> {
+public:
+    enum { Lanes = 4 };
+    static __m256i Load(const TUInt64* ItemV) { return _mm256_loadu_si256((const __m256i*)ItemV); }
+    static int GetEqMask(const __m256i& A, const __m256i& B) { return Avx2EqMask64(A, B); }
+};
+
+template <> class TAvx2Block<TUInt> {
+public:
+    enum { Lanes = 8 };
+    static __m256i Load(const TUInt* ItemV) { return _mm256_loadu_si256((const __m256i*)ItemV); }
+    static int GetEqMask(const __m256i& A, __m256i B) {
+        const __m256i RotV = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+        __m256i EqV = _mm256_cmpeq_epi32(A, B);
+        for (int RotN = 1; RotN < Lanes; RotN++) {
+            B = _mm256_permutevar8x32_epi32(B, RotV);
+            EqV = _mm256_or_si256(EqV, _mm256_cmpeq_epi32(A, B));
+        }
+        return _mm256_movemask_ps(_mm256_castsi256_ps(EqV));
+    }
+};
+
+/// Find matching items by comparing blocks of ids from both vectors
+template <class TItem>
+int Avx2Match(const TItem* ItemV1, const int& Len1, const TItem* ItemV2,
+        const int& Len2, TInt* PosV1, TInt* PosV2, const int& MxMatches) {
+
+    typedef TSortedSetItem<TItem> TSsItem;
+    typedef TAvx2Block<TItem> TBlock;
+    const int Lanes = TBlock::Lanes;
+    int Matches = 0, ItemN1 = 0, ItemN2 = 0;
+    while (ItemN1 + Lanes <= Len1 && ItemN2 + Lanes <= Len2) {
+        int Mask = TBlock::GetEqMask(TBlock::Load(ItemV1 + ItemN1), TBlock::Load(ItemV2 + ItemN2));
+        while (Mask != 0) {
+            // locate matching item in the second block
+            const int MatchN1 = ItemN1 + GetLowBitN(Mask); Mask &= Mask - 1;
+            const typename TSsItem::TId Id = TSsItem::GetId(ItemV1[MatchN1]);
+            int MatchN2 = ItemN2; while (TSsItem::GetId(ItemV2[MatchN2]) != Id) { MatchN2++; }
+            // repeated ids can match more than once, never write past the buffers
+            if (Matches == MxMatches) { return Matches; }
+            PosV1[Matches] = MatchN1; PosV2[Matches] = MatchN2; Matches++;
+        }
+        // move the block with smaller last id, or both when equal
+        const typename TSsItem::TId LastId1 = TSsItem::GetId(ItemV1[ItemN1 + Lanes - 1]);
+        const typename TSsItem::TId LastId2 = TSsItem::GetId(ItemV2[ItemN2 + Lanes - 1]);
+        if (LastId1 <= LastId2) { ItemN1 += Lanes; }
+        if (LastId2 <= LastId1) { ItemN2 += Lanes; }
+    }
+    return ScalarMatch(ItemV1, Len1, ItemV2, Len2, ItemN1, ItemN2, PosV1, PosV2, Matches, MxMatches);
+}
+
+#ifdef GLib_GCC
+#pragma GCC pop_options
+#endif
+
+#endif
+
+/// Find positions of matching items in both vectors using given implementation
+template <class TItem>
+int GetMatchPos(const TSortedSetKernel& Kernel, const TVec<TItem>& ItemV1,
+        const TVec<TItem>& ItemV2, TIntV& PosV1, TIntV& PosV2) {
+
+    const int Len1 = ItemV1.Len(), Len2 = ItemV2.Len();
+    const int MxMatches = TInt::GetMn(Len1, Len2);
+    PosV1.Gen(MxMatches); PosV2.Gen(MxMatches);
+    if (MxMatches == 0) { return 0; }
+    // skewed lengths are faster to gallop
+    if ((int64)Len1 * TSortedSet::GallopRatio < (int64)Len2) {
+        return GallopMatch(ItemV1.BegI(), Len1, ItemV2.BegI(), Len2, PosV1.BegI(), PosV2.BegI());
+    }
+    if ((int64)Len2 * TSortedSet::GallopRatio < (int64)Len1) {
+        return GallopMatch(ItemV2.BegI(), Len2, ItemV1.BegI(), Len1, PosV2.BegI(), PosV1.BegI());
+    }
+#ifdef SORTEDSET_SIMD
+    if (Kernel == sskAvx2) {
+        return Avx2Match(ItemV1.BegI(), Len1, ItemV2.BegI(), Len2, PosV1.BegI(), PosV2.BegI(), MxMatches);
+    } else if (Kernel == sskSse) {
+        return SseMatch(ItemV1.BegI(), Len1, ItemV2.BegI(), Len2, PosV1.BegI(), PosV2.BegI(), MxMatches);
+    }
+#endif
+    return ScalarMatch(ItemV1.BegI(), Len1, ItemV2.BegI(), Len2, 0, 0, PosV1.BegI(), PosV2.BegI(), 0, MxMatches);
+}
+
+template <class TItem>
+void DoIntrs(const TSortedSetKernel& Kernel, const TVec<TItem>& ItemV1,
+        const TVec<TItem>& ItemV2, TVec<TItem>& ResItemV, const bool& SumDatP) {
+
+    TIntV PosV1, PosV2;
+    const int Matches = GetMatchPos(Kernel, ItemV1, ItemV2, PosV1, PosV2);
+    ResItemV.Gen(Matches, 0);
+    for (int MatchN = 0; MatchN < Matches; MatchN++) {
+        TItem Item = ItemV1[PosV1[MatchN]];
+        if (SumDatP) { TSortedSetItem<TItem>::AddDat(Item, ItemV2[PosV2[MatchN]]); }
+        ResItemV.Add(Item);
+    }
+}
+
+/// Scalar merge, SIMD kernels showed no gain over it for difference
+template <class TItem>
+void DoDiff(const TVec<TItem>& ItemV1, const TVec<TItem>& ItemV2, TVec<TItem>& ResItemV) {
+    typedef TSortedSetItem<TItem> TSsItem;
+    const int Len1 = ItemV1.Len(), Len2 = ItemV2.Len();
+    ResItemV.Gen(Len1, 0);
+    int ItemN1 = 0, ItemN2 = 0;
+    while (ItemN1 < Len1 && ItemN2 < Len2) {
+        const typename TSsItem::TId Id1 = TSsItem::GetId(ItemV1[ItemN1]);
+        const typename TSsItem::TId Id2 = TSsItem::GetId(ItemV2[ItemN2]);
+        if (Id1 < Id2) { ResItemV.Add(ItemV1[ItemN1++]); }
+        else if (Id2 < Id1) { ItemN2++; }
+        else { ItemN1++; ItemN2++; }
+    }
+    for (; ItemN1 < Len1; ItemN1++) { ResItemV.Add(ItemV1[ItemN1]); }
+}
+
+/// Scalar merge, SIMD kernels showed no gain over it for union
+template <class TItem>
+void DoUnion(const TVec<TItem>& ItemV1, const TVec<TItem>& ItemV2,
+        TVec<TItem>& ResItemV, const bool& SumDatP) {
+
+    typedef TSortedSetItem<TItem> TSsItem;
+    const int Len1 = ItemV1.Len(), Len2 = ItemV2.Len();
+    ResItemV.Gen(Len1 + Len2, 0);
+    int ItemN1 = 0, ItemN2 = 0;
+    while (ItemN1 < Len1 && ItemN2 < Len2) {
+        const typename TSsItem::TId Id1 = TSsItem::GetId(ItemV1[ItemN1]);
+        const typename TSsItem::TId Id2 = TSsItem::GetId(ItemV2[ItemN2]);
+        if (Id1 < Id2) { ResItemV.Add(ItemV1[ItemN1++]); }
+        else if (Id2 < Id1) { ResItemV.Add(ItemV2[ItemN2++]); }
+        else {
+            TItem Item = ItemV1[ItemN1++];
+            if (SumDatP) { TSsItem::AddDat(Item, ItemV2[ItemN2]); }
+            ResItemV.Add(Item); ItemN2++;
+        }
+    }
+    for (; ItemN1 < Len1; ItemN1++) { ResItemV.Add(ItemV1[ItemN1]); }
+    for (; ItemN2 < Len2; ItemN2++) { ResItemV.Add(ItemV2[ItemN2]); }
+}
+
+/// Check that ids are strictly increasing, as sorted set operations assume
+template <class TItem>
+bool IsSortedSet(const TVec<TItem>& ItemV) {
+    typedef TSortedSetItem<TItem> TSsItem;
+    for (int ItemN = 1; ItemN < ItemV.Len(); ItemN++) {
+        if (!(TSsItem::GetId(ItemV[ItemN - 1]) < TSsItem::GetId(ItemV[ItemN]))) { return false; }
+    }
+    return true;
+}
+
+}
+
+/////////////////////////////////////////////////
+// Sorted-Set
+const int TSortedSet::GallopRatio = 32;
+TSortedSetKernel TSortedSet::Kernel = TSortedSet::GetBestKernel();
+
+TSortedSetKernel TSortedSet::GetBestKernel() {
+#if defined(SORTEDSET_SIMD) && defined(GLib_MSC)
+    int CpuInfo[4];
+    __cpuid(CpuInfo, 1);
+    const bool SseP = (CpuInfo[2] & (1 << 20)) != 0;
+    // AVX2 also needs OS support for saving YMM registers
+    const bool OsAvxP = (CpuInfo[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+    __cpuidex(CpuInfo, 7, 0);
+    const bool Avx2P = OsAvxP && (CpuInfo[1] & (1 << 5)) != 0;
+    return Avx2P ? sskAvx2 : (SseP ? sskSse : sskScalar);
+#elif defined(SORTEDSET_SIMD)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) { return sskAvx2; }
+    if (__builtin_cpu_supports("sse4.2")) { return sskSse; }
+    return sskScalar;
+#else
+    return sskScalar;
+#endif
+}
+
+void TSortedSet::SetKernel(const TSortedSetKernel& _Kernel) {
+    EAssertR(IsKernel(_Kernel), "Sorted set kernel " + GetKernelStr(_Kernel) + " not supported");
+    Kernel = _Kernel;
+}
+
+TStr TSortedSet::GetKernelStr(const TSortedSetKernel& _Kernel) {
+    switch (_Kernel) {
+        case sskScalar: return "scalar";
+        case sskSse: return "sse4.2";
+        case sskAvx2: return "avx2";
+    }
+    return "unknown";
+}
+
+void TSortedSet::Intrs(const TUInt64IntKdV& KdV1, const TUInt64IntKdV& KdV2,
+        TUInt64IntKdV& ResKdV, const bool& SumDatP) {
+
+    AssertR(IsSortedSet(KdV1) && IsSortedSet(KdV2), "Ids must be strictly increasing");
+    DoIntrs(Kernel, KdV1, KdV2, ResKdV, SumDatP);
+}
+
+void TSortedSet::Union(const TUInt64IntKdV& KdV1, const TUInt64IntKdV& KdV2,
+        TUInt64IntKdV& ResKdV, const bool& SumDatP) {
+
+    AssertR(IsSortedSet(KdV1) && IsSortedSet(KdV2), "Ids must be strictly increasing");
+    DoUnion(KdV1, KdV2, ResKdV, SumDatP);
+}
+
+void TSortedSet::Diff(const TUInt64IntKdV& KdV1, const TUInt64IntKdV& KdV2, TUInt64IntKdV& ResKdV) {
+    AssertR(IsSortedSet(KdV1) && IsSortedSet(KdV2), "Ids must be strictly increasing");
+    DoDiff(KdV1, KdV2, ResKdV);
+}
+
+void TSortedSet::Intrs(const TUInt64V& IdV1, const TUInt64V& IdV2, TUInt64V& ResIdV) {
+    AssertR(IsSortedSet(IdV1) && IsSortedSet(IdV2), "Ids must be strictly increasing");
+    DoIntrs(Kernel, IdV1, IdV2, ResIdV, false);
+}
+
+void TSortedSet::Union(const TUInt64V& IdV1, const TUInt64V& IdV2, TUInt64V& ResIdV) {
+    AssertR(IsSortedSet(IdV1) && IsSortedSet(IdV2), "Ids must be strictly increasing");
+    DoUnion(IdV1, IdV2, ResIdV, false);
+}
+
+void TSortedSet::Diff(const TUInt64V& IdV1, const TUInt64V& IdV2, TUInt64V& ResIdV) {
+    AssertR(IsSortedSet(IdV1) && IsSortedSet(IdV2), "Ids must be strictly increasing");
+    DoDiff(IdV1, IdV2, ResIdV);
+}
+
+void TSortedSet::Intrs(const TUIntV& IdV1, const TUIntV& IdV2, TUIntV& ResIdV) {
+    AssertR(IsSortedSet(IdV1) && IsSortedSet(IdV2), "Ids must be strictly increasing");
+    DoIntrs(Kernel, IdV1, IdV2, ResIdV, false);
+}
+
+void TSortedSet::Union(const TUIntV& IdV1, const TUIntV& IdV2, TUIntV& ResIdV) {
+    AssertR(IsSortedSet(IdV1) && IsSortedSet(IdV2), "Ids must be strictly increasing");
+    DoUnion(IdV1, IdV2, ResIdV, false);
+}
+
+void TSortedSet::Diff(const TUIntV& IdV1, const TUIntV& IdV2, TUIntV& ResIdV) {
+    AssertR(IsSortedSet(IdV1) && IsSortedSet(IdV2), "Ids must be strictly increasing");
+    DoDiff(IdV1, IdV2, ResIdV);
+}
@@ -0,0 +1,101 @@
+/**
+ * Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+ * All rights reserved.
+ *
+ * This source code is licensed under the FreeBSD license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef SORTEDSET_H
+#define SORTEDSET_H
+
+/////////////////////////////////////////////////
+/// Implementation used by sorted set operations
+typedef enum {
+    sskScalar = 0, ///< plain merge, always available
+    sskSse = 1,    ///< SSE4.2, compares blocks of two 64-bit or four 32-bit ids
+    sskAvx2 = 2    ///< AVX2, compares blocks of four 64-bit or eight 32-bit ids
+} TSortedSetKernel;
+
+/////////////////////////////////////////////////
+/// Sorted Set Operations.
+/// Intersection, union and difference of vectors sorted by strictly increasing
+/// ids, e.g. record ids with weights. Intersection finds matching ids by comparing
+/// whole blocks of ids with SIMD instructions, implementation is picked at startup
+/// based on the CPU, with scalar merge as fallback. When one vector is much
+/// longer than the other, the longer one is skipped over by galloping. Union and
+/// difference use scalar merge, SIMD kernels did not measure faster for them.
+class TSortedSet {
+private:
+    /// Implementation in use
+    static TSortedSetKernel Kernel;
+
+public:
+    /// Vectors longer than this many times the other one are galloped over
+    static const int GallopRatio;
+
+    /// Best implementation supported by CPU and compiler
+    static TSortedSetKernel GetBestKernel();
+    /// Implementation currently in use for intersection
+    static TSortedSetKernel GetKernel() { return Kernel; }
+    /// Force implementation, e.g. for benchmarking. Must be supported.
+    static void SetKernel(const TSortedSetKernel& _Kernel);
+    /// Check if implementation is supported by CPU and compiler
+    static bool IsKernel(const TSortedSetKernel& _Kernel) { return _Kernel <= GetBestKernel(); }
+    /// Name of the implementation
+    static TStr GetKernelStr(const TSortedSetKernel& _Kernel);
+
+    /// Position of the first of Len items, starting at ItemN, for which IsBefore is false.
+    /// Items must be ordered so that IsBefore holds for a prefix. The step doubles until
+    /// it passes the position, followed by binary search inside the last step, so long
+    /// runs of items are skipped in logarithmic time.
+    template <class TItem, class TIsBefore>
+    static int Gallop(const TItem* ItemV, const int& Len, const int& ItemN, const TIsBefore& IsBefore);
+    /// Position of the first item in ItemV, starting at ItemN, not smaller than Item
+    template <class TItem>
+    static int Gallop(const TVec<TItem>& ItemV, const int& ItemN, const TItem& Item) {
+        return Gallop(ItemV.BegI(), ItemV.Len(), ItemN, [&Item](const TItem& ValItem) { return ValItem < Item; }); }
+
+    /// Items with ids in both vectors, taken from the first one.
+    /// When SumDatP is set, weights of matching items are summed.
+    static void Intrs(const TUInt64IntKdV& KdV1, const TUInt64IntKdV& KdV2,
+        TUInt64IntKdV& ResKdV, const bool& SumDatP = false);
+    /// Items with ids in either vector, taken from the first one when in both.
+    /// When SumDatP is set, weights of matching items are summed.
+    static void Union(const TUInt64IntKdV& KdV1, const TUInt64IntKdV& KdV2,
+        TUInt64IntKdV& ResKdV, const bool& SumDatP = false);
+    /// Items from the first vector with ids not in the second vector
+    static void Diff(const TUInt64IntKdV& KdV1, const TUInt64IntKdV& KdV2, TUInt64IntKdV& ResKdV);
+
+    /// Ids in both vectors
+    static void Intrs(const TUInt64V& IdV1, const TUInt64V& IdV2, TUInt64V& ResIdV);
+    /// Ids in either vector
+    static void Union(const TUInt64V& IdV1, const TUInt64V& IdV2, TUInt64V& ResIdV);
+    /// Ids from the first vector not in the second vector
+    static void Diff(const TUInt64V& IdV1, const TUInt64V& IdV2, TUInt64V& ResIdV);
+
+    /// Ids in both vectors
+    static void Intrs(const TUIntV& IdV1, const TUIntV& IdV2, TUIntV& ResIdV);
+    /// Ids in either vector
+    static void Union(const TUIntV& IdV1, const TUIntV& IdV2, TUIntV& ResIdV);
+    /// Ids from the first vector not in the second vector
+    static void Diff(const TUIntV& IdV1, const TUIntV& IdV2, TUIntV& ResIdV);
+};
+
+template <class TItem, class TIsBefore>
+int TSortedSet::Gallop(const TItem* ItemV, const int& Len, const int& ItemN, const TIsBefore& IsBefore) {
+    // find range containing the position by doubling the step
+    int LoN = ItemN, HiN = ItemN, Step = 1;
+    while (HiN < Len && IsBefore(ItemV[HiN])) {
+        LoN = HiN + 1; HiN += Step; Step *= 2;
+    }
+    if (HiN > Len) { HiN = Len; }
+    // binary search inside the range
+    while (LoN < HiN) {
+        const int MidN = LoN + (HiN - LoN) / 2;
+        if (IsBefore(ItemV[MidN])) { LoN = MidN + 1; } else { HiN = MidN; }
+    }
+    return LoN;
+}
+
+#endif
@@ -1410,3 +1410,16 @@ void TTmProfiler::PrintReport(const PNotify& Notify, const TStr& ProfileNm) cons
 	}
 	Notify->OnStatusFmt("--");
 }
+
+/////////////////////////////////////////////////
+// Automatic measurement of scope duration
+clock_t TScopeStopWatch::GetClock() {
+#if defined(GLib_UNIX) && defined(_POSIX_THREAD_CPUTIME) && (_POSIX_THREAD_CPUTIME != -1)
+	struct timespec ts;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+		return (clock_t)ts.tv_sec * CLOCKS_PER_SEC +
+			(clock_t)((double)ts.tv_nsec * CLOCKS_PER_SEC / 1000000000.0);
+	}
+#endif
+	return clock();
+}
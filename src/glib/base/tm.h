@@ -549,7 +549,11 @@ private:
 
 public:
     /// In constructor we remember the reference to aggregate counter and current time
-    TScopeStopWatch(TAggrExeTm& _AggrExeTm): AggrExeTm(_AggrExeTm), ScopeStartTm(clock()) { }
+    TScopeStopWatch(TAggrExeTm& _AggrExeTm): AggrExeTm(_AggrExeTm), ScopeStartTm(GetClock()) { }
     /// In desctructor we check how long we existed and add to the aggregate counter
-    ~TScopeStopWatch() { AggrExeTm.AddTime(clock() - ScopeStartTm); }
+    ~TScopeStopWatch() { AggrExeTm.AddTime(GetClock() - ScopeStartTm); }
+
+    /// CPU time of the calling thread in clock() ticks, so scopes running on
+    /// different threads at the same time are not charged for each other
+    static clock_t GetClock();
 };
@@ -88,7 +88,9 @@ void TCriticalSection::Leave() {
 ////////////////////////////////////////////
 // Conditional variable lock
 TCondVarLock::TCondVarLock():
-	Mutex(TMutexType::mtRecursive) {}
+	Mutex(TMutexType::mtRecursive) {
+	pthread_cond_init(&CondVar, NULL);
+}
 
 TCondVarLock::~TCondVarLock() {
 	// pthread_cond_destroy should be called to free a condition variable that is no longer needed
@@ -115,10 +115,13 @@ public:
 // - void         Dump(FILE *f)    -- generated a text dump of the tree
 // - void         Validate()       -- IAsserts that the tree is structurally valid
 // - int          RangeQuery_(minKey, maxKey, includeMin, includeMax, TSink&)  -- calls sink(key, dat) for each key from the range minKey <= key <= maxKey [or < if includeMin/includeMax is false]; returns # of calls made
+// - int          RangeCount_(minKey, maxKey, includeMin, includeMax)  -- returns the number of keys in the range, visiting only the leaves at its ends
 // - int          RangeQuery(minKey, maxKey, TKeyV&) -- puts all keys in the range 'minKey <= key <= maxKey' into the destination vector
 // - int          RangeQuery(minKey, maxKey, TKeyDatV&) -- puts (key, dat) for all keys in the range 'minKey <= key <= maxKey' into the destination vector
 // - bool         IsKey(key)       -- returns true iff the given key is present in the tree
 // - bool         IsKeyGetDat(key, TDat&) -- like IsKey(), but also returns the corresponding dat if the key is found
+// - void         Build(keys, fillFactor) -- replaces the contents with the given sorted keys (or (key, dat) pairs), built bottom-up in linear time
+// - int          GetKeys()        -- returns the number of keys in the tree
 //
 // A few sink classes for use with RangeQuery_ are also included> TKeySink, TKeyDatSink, TNullSink, TCountSink.
 // Several of the above methods are actually just wrappers around RangeQuery_, using one of these sinks.
@@ -708,6 +711,68 @@ public:
 		return RangeQuery_Recursion(Q, root, 0);
 	}
 
+protected:
+
+	template<typename TSink>
+	bool IsInRange(const TRangeQueryData<TSink> &Q, const TKey& key) const
+	{
+		int c = cmp(key, Q.minKey);
+		if (c < 0 || (c == 0 && ! Q.includeMin)) return false;
+		c = cmp(key, Q.maxKey);
+		return (c < 0 || (c == 0 && Q.includeMax));
+	}
+
+	// Same traversal as RangeQuery_Recursion, but leaves which lie entirely within the
+	// query range are counted by their length, without visiting their keys.
+	template<typename TSink>
+	int RangeCount_Recursion(TRangeQueryData<TSink> &Q, TNodeId node, int level) const
+	{
+		int retVal = 0;
+		if (level < nLevels - 1)
+		{
+			PInternalNode pNode(internalStore, node);
+			const typename TInternalNode::TKdV &v = pNode->v; int n = v.Len();
+			for (int i = 0; i < n; i++)
+			{
+				int c = cmp(v[i].Key, Q.minKey);
+				if (c < 0 || (c == 0 && ! Q.includeMin))
+					continue; // This subtree lies entirely to the left of the query range.
+				retVal += RangeCount_Recursion(Q, v[i].Dat, level + 1);
+				if (Q.stop) break;
+			}
+		}
+		else
+		{
+			PLeafNode pNode(leafStore, node);
+			const typename TLeafNode::TKdV &v = pNode->v; int n = v.Len();
+			if (n > 0 && IsInRange(Q, v[0].Key) && IsInRange(Q, v[n - 1].Key))
+				return n;
+			for (int i = 0; i < n; i++)
+			{
+				int c = cmp(v[i].Key, Q.minKey);
+				if (c < 0 || (c == 0 && ! Q.includeMin))
+					continue; // This key is too small.
+				c = cmp(v[i].Key, Q.maxKey);
+				if (c > 0 || (c == 0 && ! Q.includeMax)) {
+					Q.stop = true; break; }
+				retVal++;
+			}
+		}
+		return retVal;
+	}
+
+public:
+
+	// Returns the number of keys from the range minKey <= key <= maxKey [or < if includeMin/includeMax is false],
+	// same as RangeQuery_ with a counting sink, but without visiting keys of leaves that lie entirely in the range.
+	int RangeCount_(const TKey& minKey, const TKey& maxKey, bool includeMin, bool includeMax) const
+	{
+		Assert(nLevels >= 1);
+		if (nLevels == 1) return 0; // we have just the root, therefore no leaves and therefore no keys either
+		TNullSink sink; TRangeQueryData<TNullSink> Q(minKey, maxKey, includeMin, includeMax, sink);
+		return RangeCount_Recursion(Q, root, 0);
+	}
+
 public:
 
 	struct TKeySink { 
@@ -744,6 +809,115 @@ public:
 	bool IsKeyGetDat(const TKey& key, TDat& dat) const { 
 		TFindSink sink(&dat); RangeQuery_(key, key, true, true, sink); return sink.found; }
 
+//----------------------------------------------------------------------------
+// Bulk loading
+//----------------------------------------------------------------------------
+
+protected:
+
+	struct TKeySrc {
+		const TKeyV &keyV;
+		TKeySrc(const TKeyV &keyV_) : keyV(keyV_) { }
+		const TKey& GetKey(int i) const { return keyV[i]; }
+		TDat GetDat(int i) const { return TDat(); } };
+
+	struct TKdSrc {
+		const TKdV &kdV;
+		TKdSrc(const TKdV &kdV_) : kdV(kdV_) { }
+		const TKey& GetKey(int i) const { return kdV[i].Key; }
+		const TDat& GetDat(int i) const { return kdV[i].Dat; } };
+
+	// Splits 'n' entries into nodes of 'capacity' to '2 * capacity - 1' entries, aiming for 'fillFactor'
+	// of the maximum, and returns the number of entries for each node.  Sizes differ by at most 1.
+	// If there are fewer than 'capacity' entries, they all go into one (underfull) node.
+	static void GetNodeLens(int n, int capacity, double fillFactor, TIntV &lenV)
+	{
+		lenV.Clr(); if (n <= 0) return;
+		const int maxLen = 2 * capacity - 1;
+		int targetLen = int(fillFactor * maxLen);
+		if (targetLen < capacity) targetLen = capacity; if (targetLen > maxLen) targetLen = maxLen;
+		int nNodes = (n + targetLen - 1) / targetLen;
+		if (nNodes > n / capacity) nNodes = n / capacity; // no node may end up underfull
+		if (nNodes < 1) nNodes = 1;
+		for (int i = 0; i < nNodes; i++) lenV.Add(n / nNodes + (i < n % nNodes ? 1 : 0));
+	}
+
+	template<typename TSrc>
+	void Build_(const TSrc &src, int n, double fillFactor)
+	{
+		Clr();
+		if (n <= 0) return;
+		// (nodeId, maxKey) pairs of the nodes on the level that was built last, starting with the leaves
+		TNodeKeyPrV curLevel, nextLevel; TNodeIdV firstUp, lastUp; TIntV lenV;
+		GetNodeLens(n, leafCapacity, fillFactor, lenV);
+		int keyN = 0; TNodeId prev = -1;
+		for (int i = 0; i < lenV.Len(); i++) {
+			TNodeId leaf = leafStore->AllocNode();
+			PLeafNode pLeaf(leafStore, leaf, true); pLeaf->Clr();
+			pLeaf->v.Gen(lenV[i], 0);
+			for (int j = 0; j < lenV[i]; j++, keyN++) {
+				Assert(keyN == 0 || cmp(src.GetKey(keyN - 1), src.GetKey(keyN)) <= 0); // keys must be sorted
+				pLeaf->v.Add(TKd(src.GetKey(keyN), src.GetDat(keyN))); }
+			pLeaf->prev = prev;
+			if (prev >= 0) { PLeafNode pPrev(leafStore, prev, true); pPrev->next = leaf; }
+			curLevel.Add(TNodeKeyPr(leaf, pLeaf->v.Last().Key)); prev = leaf; }
+		firstUp.Add(curLevel[0].Val1); lastUp.Add(curLevel.Last().Val1);
+		// Add levels of internal nodes until the nodes of the last level fit into the root.
+		while (curLevel.Len() > 2 * internalCapacity - 1) {
+			GetNodeLens(curLevel.Len(), internalCapacity, fillFactor, lenV);
+			nextLevel.Clr(); prev = -1; int childN = 0;
+			for (int i = 0; i < lenV.Len(); i++) {
+				TNodeId node = internalStore->AllocNode();
+				PInternalNode pNode(internalStore, node, true); pNode->Clr();
+				pNode->v.Gen(lenV[i], 0);
+				for (int j = 0; j < lenV[i]; j++, childN++)
+					pNode->v.Add(typename TInternalNode::TKd(curLevel[childN].Val2, curLevel[childN].Val1));
+				pNode->prev = prev;
+				if (prev >= 0) { PInternalNode pPrev(internalStore, prev, true); pPrev->next = node; }
+				nextLevel.Add(TNodeKeyPr(node, pNode->v.Last().Key)); prev = node; }
+			firstUp.Add(nextLevel[0].Val1); lastUp.Add(nextLevel.Last().Val1);
+			curLevel.Swap(nextLevel); }
+		{
+			PInternalNode pRoot(internalStore, root, true);
+			pRoot->v.Gen(curLevel.Len(), 0);
+			for (int i = 0; i < curLevel.Len(); i++)
+				pRoot->v.Add(typename TInternalNode::TKd(curLevel[i].Val2, curLevel[i].Val1));
+		}
+		nLevels = firstUp.Len() + 1;
+		for (int level = firstUp.Len() - 1; level >= 0; level--) {
+			first.Add(firstUp[level]); last.Add(lastUp[level]); }
+	}
+
+public:
+
+	// Replaces the contents of the tree with the given keys, which must be sorted in ascending order.
+	// The tree is built bottom-up: keys are packed into leaves from left to right, then each level
+	// of internal nodes is packed from the (maxKey, nodeId) pairs of the level below, until what is
+	// left fits into the root.  This takes linear time, compared to 'n' descents with 'Add'.
+	// Nodes are filled to 'fillFactor' of their maximum size, but never below their minimum size;
+	// a factor below 1 leaves room for later additions without immediate splits.
+	void Build(const TKeyV& keyV, double fillFactor = 1.0) { Build_(TKeySrc(keyV), keyV.Len(), fillFactor); }
+	void Build(const TKdV& kdV, double fillFactor = 1.0) { Build_(TKdSrc(kdV), kdV.Len(), fillFactor); }
+
+	// Returns true iff there are no keys in the tree.
+	bool Empty() const { return nLevels == 1; }
+
+	// Returns the number of keys in the tree, visiting each leaf once.
+	int GetKeys() const {
+		if (nLevels == 1) return 0;
+		int n = 0;
+		for (TNodeId node = first[nLevels - 1]; node >= 0; ) {
+			PLeafNode pLeaf(leafStore, node); n += pLeaf->v.Len(); node = pLeaf->next; }
+		return n; }
+
+	// Puts all keys in the tree into the destination vector, in ascending order.
+	void GetKeyV(TKeyV& dest) const {
+		dest.Clr(); if (nLevels == 1) return;
+		for (TNodeId node = first[nLevels - 1]; node >= 0; ) {
+			PLeafNode pLeaf(leafStore, node);
+			for (int i = 0; i < pLeaf->v.Len(); i++) dest.Add(pLeaf->v[i].Key);
+			node = pLeaf->next; } }
+
 //----------------------------------------------------------------------------
 // Debug funtions
 //----------------------------------------------------------------------------
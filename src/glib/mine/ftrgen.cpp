@@ -130,6 +130,27 @@ void TCategorical::AddFtr(const TStr& Val, TFltV& FullV, int& Offset) const {
     Offset += GetDim();
 }
 
+TCategorical TCategorical::GetEmptyCopy() const {
+    TCategorical Part;
+    Part.Type = Type;
+    Part.HashDim = HashDim;
+    // fixed range is not changed by updates
+    if (Type == ctFixed) { Part.ValSet = ValSet; }
+    return Part;
+}
+
+bool TCategorical::Merge(const TCategorical& Part) {
+    if (Type != ctOpen) { return false; }
+    // add values new to us in the order the part first saw them
+    bool NewP = false;
+    int KeyId = Part.ValSet.FFirstKeyId();
+    while (Part.ValSet.FNextKeyId(KeyId)) {
+        const TStr& Val = Part.ValSet.GetKey(KeyId);
+        if (!ValSet.IsKey(Val)) { ValSet.AddKey(Val); NewP = true; }
+    }
+    return NewP;
+}
+
 TStr TCategorical::GetVal(const int& ValN) const {
 	return (Type == ctHash) ? TInt::GetStr(ValN) : ValSet.GetKey(ValN);
 }
@@ -254,6 +275,13 @@ void TMultinomial::AddFtr(const TStrV& StrV, const TFltV& FltV, TFltV& FullV, in
     Offset += GetDim();
 }
 
+TMultinomial TMultinomial::GetEmptyCopy() const {
+    TMultinomial Part;
+    Part.Flags = Flags;
+    Part.FtrGen = FtrGen.GetEmptyCopy();
+    return Part;
+}
+
 ///////////////////////////////////////
 // Tokenizable-Feature-Generator
 TBagOfWords::TBagOfWords(const bool& TfP, const bool& IdfP, const bool& NormalizeP, 
@@ -416,41 +444,9 @@ bool TBagOfWords::Update(const TStr& Val) {
 }
 
 void TBagOfWords::AddFtr(const TStrV& TokenStrV, TIntFltKdV& SpV) const {
-    // aggregate token counts
-    TIntH TermFqH;
-	TStrV NgramStrV;
-    GenerateNgrams(TokenStrV, NgramStrV);	
-    for (int TokenStrN = 0; TokenStrN < NgramStrV.Len(); TokenStrN++) {
-        const TStr& TokenStr = NgramStrV[TokenStrN];
-        // get token ID
-        const int TokenId = IsHashing() ?
-            (TokenStr.GetHashTrick() % HashDim) : // hashing
-            TokenSet.GetKeyId(TokenStr); // vocabulary
-        // add if known token
-        if (TokenId != -1) {
-            TermFqH.AddDat(TokenId)++;
-        }
-    }
-    // make a sparse vector out of it
-    SpV.Gen(TermFqH.Len(), 0);
-    int KeyId = TermFqH.FFirstKeyId();
-    while (TermFqH.FNextKeyId(KeyId)) {
-        const int TermId = TermFqH.GetKey(KeyId);
-        double TermVal = 1.0;
-        if (IsTf()) { TermVal *= double(TermFqH[KeyId]); }
-        if (IsIdf()) {
-            if (ForgetP) {
-                const double DocFq = double(DocFqV[TermId]) + OldDocFqV[TermId];
-                if (DocFq > 0.1) { TermVal *= log((double(Docs) + OldDocs) / DocFq); }
-            } else {
-                TermVal *= log(double(Docs) / double(DocFqV[TermId]));
-            }
-        }
-        SpV.Add(TIntFltKd(TermId, TermVal));
-    }
-    SpV.Sort();
-    // step (4): normalize the vector if so required
-    if (IsNormalize()) { TLinAlg::Normalize(SpV); }
+    // map tokens to features and make a sparse vector out of them
+    TIntV TokenIdV; GetTokenIdV(TokenStrV, TokenIdV);
+    AddTokenIdFtr(TokenIdV, SpV);
 }
 
 void TBagOfWords::AddFtr(const TStr& Val, TIntFltKdV& SpV) const {
@@ -512,6 +508,110 @@ void TBagOfWords::AddFtr(const TStr& Val, TFltV& FullV, int& Offset) const {
     Offset += GetDim();    
 }
 
+bool TBagOfWords::GetTokenIdV(const TStrV& TokenStrV, TIntV& TokenIdV) const {
+    // generate ngrams if necessary, otherwise use tokens as they are
+    const bool NgramsP = (NStart != 1) || (NEnd != 1);
+    TStrV NgramStrV; if (NgramsP) { GenerateNgrams(TokenStrV, NgramStrV); }
+    const TStrV& FtrStrV = NgramsP ? NgramStrV : TokenStrV;
+    // get token IDs
+    bool AllKnownP = true;
+    TokenIdV.Gen(FtrStrV.Len(), 0);
+    for (int TokenStrN = 0; TokenStrN < FtrStrV.Len(); TokenStrN++) {
+        const TStr& TokenStr = FtrStrV[TokenStrN];
+        const int TokenId = IsHashing() ?
+            (TokenStr.GetHashTrick() % HashDim) : // hashing
+            TokenSet.GetKeyId(TokenStr); // vocabulary
+        // add if known token
+        if (TokenId != -1) { TokenIdV.Add(TokenId); } else { AllKnownP = false; }
+    }
+    return AllKnownP;
+}
+
+bool TBagOfWords::GetTokenIdV(const TStr& Val, TIntV& TokenIdV) const {
+    // tokenize
+    TStrV TokenStrV(Val.Len() / 5, 0); GetFtr(Val, TokenStrV);
+    // get token IDs
+    return GetTokenIdV(TokenStrV, TokenIdV);
+}
+
+bool TBagOfWords::Update(const TStr& Val, TIntV& TokenIdV) {
+    // tokenize
+    TStrV TokenStrV(Val.Len() / 5, 0); GetFtr(Val, TokenStrV);
+    // update and get token IDs, all known after the update
+    const bool UpdateP = Update(TokenStrV);
+    GetTokenIdV(TokenStrV, TokenIdV);
+    return UpdateP;
+}
+
+void TBagOfWords::UpdateTokenIdV(const TIntV& TokenIdV) {
+    // hashed words can only be remembered from the text
+    EAssertR(!IsStoreHashWords(), "Hash table update requires tokens");
+    // consolidate tokens
+    TIntSet TokenIdH;
+    for (int TokenIdN = 0; TokenIdN < TokenIdV.Len(); TokenIdN++) {
+        TokenIdH.AddKey(TokenIdV[TokenIdN]);
+    }
+    // update document counts
+    int KeyId = TokenIdH.FFirstKeyId();
+    while (TokenIdH.FNextKeyId(KeyId)) {
+        DocFqV[TokenIdH.GetKey(KeyId)]++;
+    }
+    // update document count
+    Docs++;
+}
+
+void TBagOfWords::AddTokenIdFtr(const TIntV& TokenIdV, TIntFltKdV& SpV) const {
+    // aggregate token counts
+    TIntH TermFqH;
+    for (int TokenIdN = 0; TokenIdN < TokenIdV.Len(); TokenIdN++) {
+        TermFqH.AddDat(TokenIdV[TokenIdN])++;
+    }
+    // make a sparse vector out of it
+    SpV.Gen(TermFqH.Len(), 0);
+    int KeyId = TermFqH.FFirstKeyId();
+    while (TermFqH.FNextKeyId(KeyId)) {
+        const int TermId = TermFqH.GetKey(KeyId);
+        double TermVal = 1.0;
+        if (IsTf()) { TermVal *= double(TermFqH[KeyId]); }
+        if (IsIdf()) {
+            if (ForgetP) {
+                const double DocFq = double(DocFqV[TermId]) + OldDocFqV[TermId];
+                if (DocFq > 0.1) { TermVal *= log((double(Docs) + OldDocs) / DocFq); }
+            } else {
+                TermVal *= log(double(Docs) / double(DocFqV[TermId]));
+            }
+        }
+        SpV.Add(TIntFltKd(TermId, TermVal));
+    }
+    SpV.Sort();
+    // step (4): normalize the vector if so required
+    if (IsNormalize()) { TLinAlg::Normalize(SpV); }
+}
+
+void TBagOfWords::AddTokenIdFtr(const TIntV& TokenIdV, TIntFltKdV& SpV, int& Offset) const {
+    // create sparse vector
+    TIntFltKdV ValSpV; AddTokenIdFtr(TokenIdV, ValSpV);
+    // add to the full feature vector and increase offset count
+    for (int ValSpN = 0; ValSpN < ValSpV.Len(); ValSpN++) {
+        const TIntFltKd& ValSp = ValSpV[ValSpN];
+        SpV.Add(TIntFltKd(Offset + ValSp.Key, ValSp.Dat));
+    }
+    // increase the offset by the dimension
+    Offset += GetDim();
+}
+
+void TBagOfWords::AddTokenIdFtr(const TIntV& TokenIdV, TFltV& FullV, int& Offset) const {
+    // create sparse vector
+    TIntFltKdV ValSpV; AddTokenIdFtr(TokenIdV, ValSpV);
+    // add to the full feature vector and increase offset count
+    for (int ValSpN = 0; ValSpN < ValSpV.Len(); ValSpN++) {
+        const TIntFltKd& ValSp = ValSpV[ValSpN];
+        FullV[Offset + ValSp.Key] = ValSp.Dat;
+    }
+    // increase the offset by the dimension
+    Offset += GetDim();
+}
+
 void TBagOfWords::Forget(const double& Factor) {
     // remember we started forgeting
     ForgetP = true;
@@ -529,6 +629,49 @@ void TBagOfWords::Forget(const double& Factor) {
     }
 }
 
+TBagOfWords TBagOfWords::GetEmptyCopy() const {
+    TBagOfWords Part;
+    Part.Type = Type; Part.Tokenizer = Tokenizer;
+    Part.SwSet = SwSet; Part.Stemmer = Stemmer;
+    Part.HashDim = HashDim; Part.NStart = NStart; Part.NEnd = NEnd;
+    Part.Clr();
+    if (IsStoreHashWords()) { Part.HashWordV.Gen(HashDim); }
+    return Part;
+}
+
+bool TBagOfWords::Merge(const TBagOfWords& Part) {
+    bool UpdateP = false;
+    if (IsHashing()) {
+        // dimensions are fixed, just add up the counts
+        for (int TokenId = 0; TokenId < HashDim; TokenId++) {
+            DocFqV[TokenId] += Part.DocFqV[TokenId];
+            if (IsStoreHashWords()) {
+                const TStrSet& PartWordSet = Part.HashWordV[TokenId];
+                int KeyId = PartWordSet.FFirstKeyId();
+                while (PartWordSet.FNextKeyId(KeyId)) {
+                    HashWordV[TokenId].AddKey(PartWordSet.GetKey(KeyId));
+                }
+            }
+        }
+    } else {
+        // add new tokens in the order the part first saw them, which keeps
+        // the same token ids as when updating with one document at a time
+        int KeyId = Part.TokenSet.FFirstKeyId();
+        while (Part.TokenSet.FNextKeyId(KeyId)) {
+            const TStr& TokenStr = Part.TokenSet.GetKey(KeyId);
+            int TokenId = TokenSet.GetKeyId(TokenStr);
+            if (TokenId == -1) {
+                UpdateP = true;
+                TokenId = TokenSet.AddKey(TokenStr);
+                DocFqV.Add(0); OldDocFqV.Add(0.0);
+            }
+            DocFqV[TokenId] += Part.DocFqV[KeyId];
+        }
+    }
+    Docs += Part.Docs;
+    return UpdateP;
+}
+
 ///////////////////////////////////////
 // Sparse-Numeric-Feature-Generator
 
@@ -74,6 +74,12 @@ public:
     void AddFtr(const TStr& Val, TIntFltKdV& SpV, int& Offset) const;
     void AddFtr(const TStr& Val, TFltV& FullV, int& Offset) const;
 
+    /// Empty generator with the same settings, collects one part of a parallel update
+    TCategorical GetEmptyCopy() const;
+    /// Merge a part of a parallel update, parts must be merged in the order of their values.
+    /// Returns true if we increased dimensionality.
+    bool Merge(const TCategorical& Part);
+
     int GetDim() const { return (Type == ctHash) ? HashDim.Val : ValSet.Len(); }
     TStr GetVal(const int& ValN) const;
 };
@@ -112,6 +118,11 @@ public:
     void AddFtr(const TStrV& StrV, const TFltV& FltV, TIntFltKdV& SpV, int& Offset) const;
     void AddFtr(const TStrV& StrV, const TFltV& FltV, TFltV& FullV, int& Offset) const;
 
+    /// Empty generator with the same settings, collects one part of a parallel update
+    TMultinomial GetEmptyCopy() const;
+    /// Merge a part of a parallel update, parts must be merged in the order of their values
+    bool Merge(const TMultinomial& Part) { return FtrGen.Merge(Part.FtrGen); }
+
     int GetDim() const { return FtrGen.GetDim(); }
     TStr GetVal(const int& ValN) const { return FtrGen.GetVal(ValN); }
 
@@ -197,10 +208,31 @@ public:
     void AddFtr(const TStr& Val, TIntFltKdV& SpV, int& Offset) const;
     void AddFtr(const TStrV& TokenStrV, TFltV& FullV, int& Offset) const;
     void AddFtr(const TStr& Val, TFltV& FullV, int& Offset) const;
+
+    /// Feature ids of tokens (n-grams when set), skipping tokens not in the vocabulary.
+    /// Ids can be kept and used instead of the text while the vocabulary is not cleared.
+    /// Returns false when some tokens were skipped.
+    bool GetTokenIdV(const TStrV& TokenStrV, TIntV& TokenIdV) const;
+    bool GetTokenIdV(const TStr& Val, TIntV& TokenIdV) const;
+    /// Update with a text and return feature ids of its tokens
+    bool Update(const TStr& Val, TIntV& TokenIdV);
+    /// Update document counts from feature ids of a document with no new tokens
+    void UpdateTokenIdV(const TIntV& TokenIdV);
+    /// Feature vector from feature ids of a document
+    void AddTokenIdFtr(const TIntV& TokenIdV, TIntFltKdV& SpV) const;
+    void AddTokenIdFtr(const TIntV& TokenIdV, TIntFltKdV& SpV, int& Offset) const;
+    void AddTokenIdFtr(const TIntV& TokenIdV, TFltV& FullV, int& Offset) const;
     
     /// Forgetting, assumes calling on equally spaced time interval.
     void Forget(const double& Factor);
 
+    /// Empty generator with the same settings, collects one part of a parallel update
+    TBagOfWords GetEmptyCopy() const;
+    /// Merge vocabulary and document counts from a part of a parallel update. Merging the
+    /// parts in the order of their documents gives the same result as sequential update.
+    /// Returns true if the dimensionality changed.
+    bool Merge(const TBagOfWords& Part);
+
     /// Hashing Related Functions
     int GetDim() const { return IsHashing() ? HashDim.Val : TokenSet.Len(); }
     TStr GetVal(const int& ValN) const { return IsHashing() ? TInt::GetStr(ValN) : TokenSet.GetKey(ValN); }
@@ -6,6 +6,15 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+// SIMD kernels are compiled only for x86 with SSE2, other platforms use scalar loops
+#if defined(GLib_MSC) && (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+    #define SIGNALPROC_SIMD
+    #include <emmintrin.h>
+#elif defined(__SSE2__)
+    #define SIGNALPROC_SIMD
+    #include <emmintrin.h>
+#endif
+
 namespace TSignalProc {
 
 /////////////////////////////////////////////////
@@ -199,17 +208,17 @@ PJsonVal TSumSpVec::GetJson() const {
 // Online Min
 void TMin::AddVal(const double& InVal, const uint64& InTmMSecs) {
     // First we remove all old min candidates that are bigger then the latest value
-    while (!AllValV.Empty() && AllValV.Last().Val1 >= InVal) {
-        AllValV.DelLast();
+    while (!AllValQ.Empty() && AllValQ.Back().Val1 >= InVal) {
+        AllValQ.PopBack();
     }
     // Then we remember the new minimum candidate
-    AllValV.Add(TFltUInt64Pr(InVal, InTmMSecs));
+    AllValQ.Push(TFltUInt64Pr(InVal, InTmMSecs));
 }
 
 void TMin::DelVal(const uint64& OutTmMSecs) {
     // forget all candidates older then the outgoing timestamp
-    while (AllValV[0].Val2 <= OutTmMSecs) {
-        AllValV.Del(0);
+    while (!AllValQ.Empty() && AllValQ.Front().Val2 <= OutTmMSecs) {
+        AllValQ.Pop();
     }
 }
 
@@ -220,6 +229,9 @@ void TMin::Load(TSIn& SIn) {
 void TMin::Save(TSOut& SOut) const {
     Min.Save(SOut);
     TmMSecs.Save(SOut);
+    // candidates are saved as a vector
+    TFltUInt64PrV AllValV(AllValQ.Len(), 0);
+    for (int ValN = 0; ValN < AllValQ.Len(); ValN++) { AllValV.Add(AllValQ[ValN]); }
     AllValV.Save(SOut);
 }
 
@@ -229,7 +241,7 @@ void TMin::Update(const double& InVal, const uint64& InTmMSecs, const TFltV& Out
     /// Forget old candidates
     if (!OutTmMSecsV.Empty()) { DelVal(OutTmMSecsV.Last()); }
     /// smallest candidate is the current min
-    Min = AllValV[0].Val1;
+    Min = AllValQ.Empty() ? TFlt::Mx : AllValQ.Front().Val1.Val;
     /// remember the current timestamp
     TmMSecs = InTmMSecs;
 }
@@ -242,7 +254,7 @@ void TMin::Update(const TFltV& InValV, const TUInt64V& InTmMSecsV, const TFltV&
     /// Forget old candidates
     if (!OutTmMSecsV.Empty()) { DelVal(OutTmMSecsV.Last()); }
     /// smallest candidate is the current min
-    Min = AllValV[0].Val1;
+    Min = AllValQ.Empty() ? TFlt::Mx : AllValQ.Front().Val1.Val;
     /// remember the current timestamp if we have any new ones
     if (!InTmMSecsV.Empty()) { TmMSecs = InTmMSecsV.Last(); }
 }
@@ -250,19 +262,18 @@ void TMin::Update(const TFltV& InValV, const TUInt64V& InTmMSecsV, const TFltV&
 /////////////////////////////////////////////////
 // Online Max
 void TMax::AddVal(const double& InVal, const uint64& InTmMSecs) {
-    // First we remove all old max candidates that are bigger then the latest value
-    while (!AllValV.Empty() && AllValV[AllValV.Len() - 1].Val1 <= InVal) {
-        AllValV.DelLast();
+    // First we remove all old max candidates that are smaller then the latest value
+    while (!AllValQ.Empty() && AllValQ.Back().Val1 <= InVal) {
+        AllValQ.PopBack();
     }
     // Then we remember the new maximum candidate
-    AllValV.Add(TFltUInt64Pr(InVal, InTmMSecs));
+    AllValQ.Push(TFltUInt64Pr(InVal, InTmMSecs));
 }
 
 void TMax::DelVal(const uint64& OutTmMSecs) {
     // forget all candidates older then the outgoing timestamp
-    while (AllValV[0].Val2 <= OutTmMSecs) {
-        // pop front
-        AllValV.Del(0);
+    while (!AllValQ.Empty() && AllValQ.Front().Val2 <= OutTmMSecs) {
+        AllValQ.Pop();
     }
 }
 
@@ -274,6 +285,9 @@ void TMax::Save(TSOut& SOut) const {
     // parameters
     Max.Save(SOut);
     TmMSecs.Save(SOut);
+    // candidates are saved as a vector
+    TFltUInt64PrV AllValV(AllValQ.Len(), 0);
+    for (int ValN = 0; ValN < AllValQ.Len(); ValN++) { AllValV.Add(AllValQ[ValN]); }
     AllValV.Save(SOut);
 }
 void TMax::Update(const double& InVal, const uint64& InTmMSecs, const TFltV& OutValV, const TUInt64V& OutTmMSecsV){
@@ -282,7 +296,7 @@ void TMax::Update(const double& InVal, const uint64& InTmMSecs, const TFltV& Out
     /// Forget old candidates
     if (!OutTmMSecsV.Empty()) { DelVal(OutTmMSecsV.Last()); }
     /// largest candidate is the current max
-    Max = AllValV[0].Val1;
+    Max = AllValQ.Empty() ? TFlt::Mn : AllValQ.Front().Val1.Val;
     /// remember the current timestamp
     TmMSecs = InTmMSecs;
 }
@@ -295,7 +309,7 @@ void TMax::Update(const TFltV& InValV, const TUInt64V& InTmMSecsV, const TFltV&
     /// Forget old candidates
     if (!OutTmMSecsV.Empty()) { DelVal(OutTmMSecsV.Last()); }
     /// largest candidate is the current max
-    Max = AllValV[0].Val1;
+    Max = AllValQ.Empty() ? TFlt::Mn : AllValQ.Front().Val1.Val;
     /// remember the current timestamp if we have any new ones
     if (!InTmMSecsV.Empty()) { TmMSecs = InTmMSecsV.Last(); }
 }
@@ -657,6 +671,209 @@ void TVar::Update(const TFltV& InValV, const TUInt64V& InTmMSecsV, const TFltV&
     if (!InTmMSecsV.Empty()) { TmMSecs = InTmMSecsV.Last(); }
 }
 
+/////////////////////////////////////////////////
+// Sliding window statistics of several signals
+namespace {
+
+static_assert(sizeof(TFlt) == sizeof(double), "Unexpected value layout");
+
+/// Adds a value of each channel to sum, mean and M2, same formulas as TSum and TVar
+void AddValKernel(double* SumV, double* MaV, double* M2V, const double* InValV,
+        const int& Channels, const double& Count) {
+
+    int ChN = 0;
+#ifdef SIGNALPROC_SIMD
+    const __m128d CountX = _mm_set1_pd(Count);
+    for (; ChN + 2 <= Channels; ChN += 2) {
+        const __m128d InX = _mm_loadu_pd(InValV + ChN);
+        const __m128d MaX = _mm_loadu_pd(MaV + ChN);
+        const __m128d DeltaX = _mm_sub_pd(InX, MaX);
+        const __m128d NewMaX = _mm_add_pd(MaX, _mm_div_pd(DeltaX, CountX));
+        const __m128d M2X = _mm_add_pd(_mm_loadu_pd(M2V + ChN),
+            _mm_mul_pd(DeltaX, _mm_sub_pd(InX, NewMaX)));
+        _mm_storeu_pd(SumV + ChN, _mm_add_pd(_mm_loadu_pd(SumV + ChN), InX));
+        _mm_storeu_pd(MaV + ChN, NewMaX);
+        _mm_storeu_pd(M2V + ChN, M2X);
+    }
+#endif
+    for (; ChN < Channels; ChN++) {
+        const double InVal = InValV[ChN];
+        SumV[ChN] += InVal;
+        const double Delta = InVal - MaV[ChN];
+        MaV[ChN] = MaV[ChN] + Delta / Count;
+        M2V[ChN] = M2V[ChN] + Delta * (InVal - MaV[ChN]);
+    }
+}
+
+/// Removes a value of each channel from sum, mean and M2, same formulas as TSum and TVar
+void DelValKernel(double* SumV, double* MaV, double* M2V, const double* OutValV,
+        const int& Channels, const double& Count) {
+
+    int ChN = 0;
+#ifdef SIGNALPROC_SIMD
+    const __m128d CountX = _mm_set1_pd(Count);
+    for (; ChN + 2 <= Channels; ChN += 2) {
+        const __m128d OutX = _mm_loadu_pd(OutValV + ChN);
+        const __m128d MaX = _mm_loadu_pd(MaV + ChN);
+        const __m128d DeltaX = _mm_sub_pd(OutX, MaX);
+        const __m128d NewMaX = _mm_sub_pd(MaX, _mm_div_pd(DeltaX, CountX));
+        const __m128d M2X = _mm_sub_pd(_mm_loadu_pd(M2V + ChN),
+            _mm_mul_pd(DeltaX, _mm_sub_pd(OutX, NewMaX)));
+        _mm_storeu_pd(SumV + ChN, _mm_sub_pd(_mm_loadu_pd(SumV + ChN), OutX));
+        _mm_storeu_pd(MaV + ChN, NewMaX);
+        _mm_storeu_pd(M2V + ChN, M2X);
+    }
+#endif
+    for (; ChN < Channels; ChN++) {
+        const double OutVal = OutValV[ChN];
+        SumV[ChN] -= OutVal;
+        const double Delta = OutVal - MaV[ChN];
+        MaV[ChN] = MaV[ChN] - Delta / Count;
+        M2V[ChN] = M2V[ChN] - Delta * (OutVal - MaV[ChN]);
+    }
+}
+
+/// Loads candidate queues saved as vectors
+void LoadValQV(TSIn& SIn, TVec<TQQueue<TFltUInt64Pr> >& ValQV) {
+    TVec<TFltUInt64PrV> ValVV(SIn);
+    ValQV.Gen(ValVV.Len());
+    for (int ChN = 0; ChN < ValVV.Len(); ChN++) { ValQV[ChN].PushV(ValVV[ChN]); }
+}
+
+/// Saves candidate queues as vectors
+void SaveValQV(TSOut& SOut, const TVec<TQQueue<TFltUInt64Pr> >& ValQV) {
+    TVec<TFltUInt64PrV> ValVV(ValQV.Len(), 0);
+    for (int ChN = 0; ChN < ValQV.Len(); ChN++) {
+        const TQQueue<TFltUInt64Pr>& ValQ = ValQV[ChN];
+        TFltUInt64PrV& ValV = ValVV[ValVV.Add()];
+        ValV.Gen(ValQ.Len(), 0);
+        for (int ValN = 0; ValN < ValQ.Len(); ValN++) { ValV.Add(ValQ[ValN]); }
+    }
+    ValVV.Save(SOut);
+}
+
+}
+
+TMultiWinStats::TMultiWinStats(TSIn& SIn): Count(SIn), SumV(SIn), MaV(SIn), M2V(SIn) {
+    LoadValQV(SIn, MinValQV);
+    LoadValQV(SIn, MaxValQV);
+    TmMSecs.Load(SIn);
+}
+
+void TMultiWinStats::InitChannels(const int& Channels) {
+    if (SumV.Empty()) {
+        // first value, prepare state for all channels
+        SumV.Gen(Channels); MaV.Gen(Channels); M2V.Gen(Channels);
+        MinValQV.Gen(Channels); MaxValQV.Gen(Channels);
+    }
+    EAssertR(Channels == SumV.Len(), TStr::Fmt("Expected %d channels, got %d", SumV.Len(), Channels));
+}
+
+void TMultiWinStats::AddVal(const TFltV& InValV, const uint64& InTmMSecs) {
+    InitChannels(InValV.Len());
+    const int Channels = InValV.Len();
+    // increase count
+    Count++;
+    // update sum, mean and M2 of all channels
+    AddValKernel((double*)SumV.BegI(), (double*)MaV.BegI(), (double*)M2V.BegI(),
+        (const double*)InValV.BegI(), Channels, (double)Count);
+    // update min and max candidates, see TMin::AddVal and TMax::AddVal
+    for (int ChN = 0; ChN < Channels; ChN++) {
+        const TFlt InVal = InValV[ChN];
+        TQQueue<TFltUInt64Pr>& MinValQ = MinValQV[ChN];
+        while (!MinValQ.Empty() && MinValQ.Back().Val1 >= InVal) { MinValQ.PopBack(); }
+        MinValQ.Push(TFltUInt64Pr(InVal, InTmMSecs));
+        TQQueue<TFltUInt64Pr>& MaxValQ = MaxValQV[ChN];
+        while (!MaxValQ.Empty() && MaxValQ.Back().Val1 <= InVal) { MaxValQ.PopBack(); }
+        MaxValQ.Push(TFltUInt64Pr(InVal, InTmMSecs));
+    }
+}
+
+void TMultiWinStats::DelVal(const TFltV& OutValV) {
+    EAssert(Count > 0);
+    EAssertR(OutValV.Len() == SumV.Len(), TStr::Fmt("Expected %d channels, got %d", SumV.Len(), OutValV.Len()));
+    // decrease count of elements we are computing statistics from
+    Count--;
+    // update sum, mean and M2 of all channels
+    DelValKernel((double*)SumV.BegI(), (double*)MaV.BegI(), (double*)M2V.BegI(),
+        (const double*)OutValV.BegI(), SumV.Len(), (double)Count);
+    if (Count == 0) {
+        // no more elements, reset mean and M2 (sum is kept, same as TSum)
+        MaV.PutAll(0.0); M2V.PutAll(0.0);
+    }
+}
+
+void TMultiWinStats::DelTm(const uint64& OutTmMSecs) {
+    // forget all candidates older then the outgoing timestamp
+    for (int ChN = 0; ChN < MinValQV.Len(); ChN++) {
+        TQQueue<TFltUInt64Pr>& MinValQ = MinValQV[ChN];
+        while (!MinValQ.Empty() && MinValQ.Front().Val2 <= OutTmMSecs) { MinValQ.Pop(); }
+        TQQueue<TFltUInt64Pr>& MaxValQ = MaxValQV[ChN];
+        while (!MaxValQ.Empty() && MaxValQ.Front().Val2 <= OutTmMSecs) { MaxValQ.Pop(); }
+    }
+}
+
+void TMultiWinStats::Load(TSIn& SIn) {
+    *this = TMultiWinStats(SIn);
+}
+
+void TMultiWinStats::Save(TSOut& SOut) const {
+    Count.Save(SOut);
+    SumV.Save(SOut);
+    MaV.Save(SOut);
+    M2V.Save(SOut);
+    SaveValQV(SOut, MinValQV);
+    SaveValQV(SOut, MaxValQV);
+    TmMSecs.Save(SOut);
+}
+
+void TMultiWinStats::Reset() {
+    Count = 0;
+    SumV.PutAll(0.0); MaV.PutAll(0.0); M2V.PutAll(0.0);
+    for (int ChN = 0; ChN < MinValQV.Len(); ChN++) {
+        MinValQV[ChN].Clr(false);
+        MaxValQV[ChN].Clr(false);
+    }
+    TmMSecs = 0;
+}
+
+void TMultiWinStats::Update(const TVec<TFltV>& InValV, const TUInt64V& InTmMSecsV,
+        const TVec<TFltV>& OutValV, const TUInt64V& OutTmMSecsV) {
+
+    // remove old values
+    for (int ValN = 0; ValN < OutValV.Len(); ValN++) { DelVal(OutValV[ValN]); }
+    // add new values
+    for (int ValN = 0; ValN < InValV.Len(); ValN++) { AddVal(InValV[ValN], InTmMSecsV[ValN]); }
+    // forget old min and max candidates
+    if (!OutTmMSecsV.Empty()) { DelTm(OutTmMSecsV.Last()); }
+    // update current timestamp
+    if (!InTmMSecsV.Empty()) { TmMSecs = InTmMSecsV.Last(); }
+}
+
+void TMultiWinStats::GetVarV(TFltV& VarV) const {
+    VarV.Gen(M2V.Len());
+    if (Count > 1) {
+        const double Norm = (double)Count - 1.0;
+        for (int ChN = 0; ChN < M2V.Len(); ChN++) { VarV[ChN] = M2V[ChN] / Norm; }
+    }
+}
+
+void TMultiWinStats::GetMinV(TFltV& MinV) const {
+    MinV.Gen(MinValQV.Len());
+    for (int ChN = 0; ChN < MinValQV.Len(); ChN++) {
+        const TQQueue<TFltUInt64Pr>& MinValQ = MinValQV[ChN];
+        MinV[ChN] = MinValQ.Empty() ? TFlt::Mx : MinValQ.Front().Val1.Val;
+    }
+}
+
+void TMultiWinStats::GetMaxV(TFltV& MaxV) const {
+    MaxV.Gen(MaxValQV.Len());
+    for (int ChN = 0; ChN < MaxValQV.Len(); ChN++) {
+        const TQQueue<TFltUInt64Pr>& MaxValQ = MaxValQV[ChN];
+        MaxV[ChN] = MaxValQ.Empty() ? TFlt::Mn : MaxValQ.Front().Val1.Val;
+    }
+}
+
 /////////////////////////////////////////////////
 // Online Moving Covariance
 void TCov::AddVal(const double& InValX, const double& InValY) {
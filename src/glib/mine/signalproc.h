@@ -188,9 +188,9 @@ private:
     TFlt Min;
     /// Timestamp of current min value
     TUInt64 TmMSecs;
-    /// Sorted vector of potential min candidates.
-    /// TODO: Replace TVec with TQQueue
-    TFltUInt64PrV AllValV;
+    /// Potential min candidates, sorted by value and by time. New values
+    /// come in at the back and old ones leave at the front.
+    TQQueue<TFltUInt64Pr> AllValQ;
 
     /// Add new value
     void AddVal(const double& InVal, const uint64& InTmMSecs);
@@ -199,7 +199,7 @@ private:
 
 public:
     TMin(): Min(TFlt::Mx) { }
-    TMin(TSIn& SIn): Min(SIn), TmMSecs(SIn), AllValV(SIn) { }
+    TMin(TSIn& SIn): Min(SIn), TmMSecs(SIn) { AllValQ.PushV(TFltUInt64PrV(SIn)); }
 
     /// Loading from binary stream
     void Load(TSIn& SIn);
@@ -209,7 +209,7 @@ public:
     /// Check if we saw at least one value
     bool IsInit() const { return (TmMSecs > 0); }
     /// Resets the model state
-    void Reset() { Min = TFlt::Mx; TmMSecs = 0; }
+    void Reset() { Min = TFlt::Mx; TmMSecs = 0; AllValQ.Clr(false); }
     /// Update with a value to add and values to delete
     void Update(const double& InVal, const uint64& InTmMSecs,
         const TFltV& OutValV, const TUInt64V& OutTmMSecs);
@@ -231,9 +231,9 @@ private:
     TFlt Max;
     /// timestamp of current MA
     TUInt64 TmMSecs;
-    /// Sorted vector of potential min candidates.
-    /// TODO: Replace TVec with TQQueue
-    TFltUInt64PrV AllValV;
+    /// Potential max candidates, sorted by value and by time. New values
+    /// come in at the back and old ones leave at the front.
+    TQQueue<TFltUInt64Pr> AllValQ;
 
     /// Add new value
     void AddVal(const double& InVal, const uint64& InTmMSecs);
@@ -242,7 +242,7 @@ private:
 
 public:
     TMax(): Max(TFlt::Mn) { };
-    TMax(TSIn& SIn): Max(SIn), TmMSecs(SIn), AllValV(SIn) { }
+    TMax(TSIn& SIn): Max(SIn), TmMSecs(SIn) { AllValQ.PushV(TFltUInt64PrV(SIn)); }
 
     /// Loading from binary stream
     void Load(TSIn& SIn);
@@ -252,7 +252,7 @@ public:
     /// Check if we saw at least one value
     bool IsInit() const { return (TmMSecs > 0); }
     /// Resets the model state
-    void Reset() { Max = TFlt::Mn; TmMSecs = 0; }
+    void Reset() { Max = TFlt::Mn; TmMSecs = 0; AllValQ.Clr(false); }
     /// Update with a value to add and values to delete
     void Update(const double& InVal, const uint64& InTmMSecs,
         const TFltV& OutValV, const TUInt64V& OutTmMSecs);
@@ -389,6 +389,72 @@ public:
     uint64 GetTmMSecs() const { return TmMSecs; }
 };
 
+/////////////////////////////////////////////////
+/// Sliding window sum, mean, variance, min and max of several signals.
+/// Statistics are kept as one vector per statistic with an element per channel,
+/// so one update walks over consecutive values of all channels (using SIMD
+/// where available). Results match TSum, TMa, TVar, TMin and TMax on each channel.
+class TMultiWinStats {
+private:
+    /// Count of values in the window, same for all channels
+    TUInt64 Count;
+    /// Current sum for each channel
+    TFltV SumV;
+    /// Current mean for each channel
+    TFltV MaV;
+    /// Current M2 for each channel
+    TFltV M2V;
+    /// Min candidates for each channel, see TMin
+    TVec<TQQueue<TFltUInt64Pr> > MinValQV;
+    /// Max candidates for each channel, see TMax
+    TVec<TQQueue<TFltUInt64Pr> > MaxValQV;
+    /// Timestamp of current values
+    TUInt64 TmMSecs;
+
+    /// Set the number of channels on the first value, check it on the following
+    void InitChannels(const int& Channels);
+    /// Add new values of all channels
+    void AddVal(const TFltV& InValV, const uint64& InTmMSecs);
+    /// Remove values of all channels
+    void DelVal(const TFltV& OutValV);
+    /// Forget min and max candidates up to and including the timestamp
+    void DelTm(const uint64& OutTmMSecs);
+
+public:
+    TMultiWinStats() { }
+    TMultiWinStats(TSIn& SIn);
+
+    /// Loading from binary stream
+    void Load(TSIn& SIn);
+    /// Saving to binary stream
+    void Save(TSOut& SOut) const;
+
+    /// Check if we saw at least one value
+    bool IsInit() const { return (TmMSecs > 0); }
+    /// Resets the model state, keeps the number of channels
+    void Reset();
+    /// Update with values to add and values to delete, each value is a vector of all channels
+    void Update(const TVec<TFltV>& InValV, const TUInt64V& InTmMSecsV,
+        const TVec<TFltV>& OutValV, const TUInt64V& OutTmMSecsV);
+
+    /// Number of channels, zero before the first value
+    int GetChannels() const { return SumV.Len(); }
+    /// Number of values in the window
+    uint64 GetCount() const { return Count; }
+    /// Current sums
+    const TFltV& GetSumV() const { return SumV; }
+    /// Current means
+    const TFltV& GetMaV() const { return MaV; }
+    /// Current variances
+    void GetVarV(TFltV& VarV) const;
+    /// Current minimums
+    void GetMinV(TFltV& MinV) const;
+    /// Current maximums
+    void GetMaxV(TFltV& MaxV) const;
+    /// Timestamp of the current values
+    uint64 GetTmMSecs() const { return TmMSecs; }
+};
+
 /////////////////////////////////////////////////
 /// Online Moving Covariance M2(X,Y).
 /// Assumes X and Y have the same time stamp
@@ -34,6 +34,9 @@ TStr TStemmer::GetStem(const TStr& WordStr, const bool& ToUcP){
 
   // get real word from stem
   if (bool(RealWordP)){
+    // shared between threads extracting features in parallel
+    #pragma omp critical
+    {
     TStr RealWordStr;
     if (StemStrToRealWordStrH.IsKeyGetDat(StemStr, RealWordStr)){
       StemStr=RealWordStr;
@@ -41,6 +44,7 @@ TStr TStemmer::GetStem(const TStr& WordStr, const bool& ToUcP){
       StemStrToRealWordStrH.AddDat(StemStr, UCWordStr);
       StemStr=UCWordStr;
     }
+    }
   }
 
   // return stem
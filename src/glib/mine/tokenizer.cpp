@@ -67,11 +67,13 @@ void TSimple::Save(TSOut& SOut) const {
     SwSet.Save(SOut); Stemmer.Save(SOut); ToUcP.Save(SOut); 
 }
 
+const char* TSimple::SplitChs = " .,!?\n\r()+=-{}[]%$#@\\/";
+
 void TSimple::GetTokens(const PSIn& SIn, TStrV& TokenV) const {
 	TStr LineStr; TStrV WordStrV;
 	while (SIn->GetNextLn(LineStr)) {
 		WordStrV.Clr(false);
-		LineStr.SplitOnAllAnyCh(" .,!?\n\r()+=-{}[]%$#@\\/", WordStrV, true);
+		LineStr.SplitOnAllAnyCh(SplitChs, WordStrV, true);
 		for (int WordStrN = 0; WordStrN < WordStrV.Len(); WordStrN++) {
 			const TStr& WordStr = WordStrV[WordStrN];
 			const TStr UcStr = WordStr.GetUc();
@@ -85,6 +87,28 @@ void TSimple::GetTokens(const PSIn& SIn, TStrV& TokenV) const {
 	}
 }
 
+void TSimple::GetTokens(const TStr& Text, TStrV& TokenV) const {
+	const char* Bf = Text.CStr(); int ChN = 0;
+	TChA WordChA, UcWordChA;
+	forever {
+		// skip separators
+		while (IsSplitCh(Bf[ChN])) { ChN++; }
+		if (Bf[ChN] == 0) { break; }
+		// read next word
+		WordChA.Clr(); UcWordChA.Clr();
+		while (Bf[ChN] != 0 && !IsSplitCh(Bf[ChN])) {
+			WordChA += Bf[ChN]; UcWordChA += (char)toupper(Bf[ChN]); ChN++;
+		}
+		TStr UcStr(UcWordChA);
+		if (SwSet.Empty() || (!SwSet->IsIn(UcStr))) {
+			TStr TokenStr = ToUcP ? std::move(UcStr) : TStr(WordChA);
+			if (!Stemmer.Empty()) {
+				TokenStr = Stemmer->GetStem(TokenStr, ToUcP); }
+			TokenV.Add(); TokenV.Last() = std::move(TokenStr);
+		}
+	}
+}
+
 ///////////////////////////////
 // Tokenizer-Html
 THtml::THtml(const PSwSet& _SwSet, const PStemmer& _Stemmer, const bool& _ToUcP): 
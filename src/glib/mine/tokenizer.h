@@ -40,7 +40,7 @@ public:
     static PTokenizer Load(TSIn& SIn);
 
 	virtual void GetTokens(const PSIn& SIn, TStrV& TokenV) const = 0;
-	void GetTokens(const TStr& Text, TStrV& TokenV) const;
+	virtual void GetTokens(const TStr& Text, TStrV& TokenV) const;
 	void GetTokens(const TStrV& TextV, TVec<TStrV>& TokenVV) const;
 };
 
@@ -55,6 +55,10 @@ protected:
 	PStemmer Stemmer;
 	TBool ToUcP;
 
+	/// Characters separating tokens
+	static const char* SplitChs;
+	static bool IsSplitCh(const char& Ch) { return (Ch != 0) && (strchr(SplitChs, Ch) != NULL); }
+
 	TSimple(const PSwSet& _SwSet, const PStemmer& _Stemmer, const bool& _ToUcP): 
         SwSet(_SwSet), Stemmer(_Stemmer), ToUcP(_ToUcP) {  }
 public:
@@ -67,6 +71,8 @@ public:
 	void Save(TSOut& SOut) const;
 
 	void GetTokens(const PSIn& SIn, TStrV& TokenV) const;
+	/// Scans the text in place, without copying it into a stream, lines and words
+	void GetTokens(const TStr& Text, TStrV& TokenV) const;
     
     static TStr GetType() { return "simple"; }
 };
@@ -301,6 +301,23 @@ void TNodeJsQm::flags(v8::Local<v8::String> Name, const v8::PropertyCallbackInfo
     Info.GetReturnValue().Set(JsObj);
 }
 
+///////////////////////////////
+// NodeJs QMiner Base Task
+void TNodeJsBaseTask::StartTask(const TWPt<TQm::TBase>& _Base, const PNodeJsBaseWatcher& _Watcher) {
+    Base = _Base; Watcher = _Watcher;
+    // main thread keeps using the base while we run
+    if (!Base->IsConcurrentReads()) { Base->SetConcurrentReads(true); }
+    Watcher->AsyncTasks++;
+}
+
+TNodeJsBaseTask::~TNodeJsBaseTask() {
+    if (!Watcher.Empty()) { Watcher->AsyncTasks--; }
+}
+
+v8::Handle<v8::Function> TNodeJsBaseTask::GetCallback(const v8::FunctionCallbackInfo<v8::Value>& Args) {
+    return TNodeJsUtil::GetArgFun(Args, Args.Length() - 1);
+}
+
 ///////////////////////////////
 // NodeJs QMiner Base
 v8::Persistent<v8::Function> TNodeJsBase::Constructor;
@@ -333,8 +350,10 @@ void TNodeJsBase::Init(v8::Handle<v8::Object> exports) {
     NODE_SET_PROTOTYPE_METHOD(tpl, "createJsStore", _createJsStore);
     NODE_SET_PROTOTYPE_METHOD(tpl, "addJsStoreCallback", _addJsStoreCallback);
     NODE_SET_PROTOTYPE_METHOD(tpl, "search", _search);
+    NODE_SET_PROTOTYPE_METHOD(tpl, "searchAsync", _searchAsync);
     NODE_SET_PROTOTYPE_METHOD(tpl, "garbageCollect", _garbageCollect);
     NODE_SET_PROTOTYPE_METHOD(tpl, "partialFlush", _partialFlush);
+    NODE_SET_PROTOTYPE_METHOD(tpl, "checkpoint", _checkpoint);
     NODE_SET_PROTOTYPE_METHOD(tpl, "getStats", _getStats);
     NODE_SET_PROTOTYPE_METHOD(tpl, "getStreamAggr", _getStreamAggr);
     NODE_SET_PROTOTYPE_METHOD(tpl, "getStreamAggrNames", _getStreamAggrNames);
@@ -477,12 +496,36 @@ TNodeJsBase* TNodeJsBase::NewFromArgs(const v8::FunctionCallbackInfo<v8::Value>&
     bool ReadOnly = (Mode == "openReadOnly");
     uint64 IndexCache = (uint64)Val->GetObjInt("indexCache", 1024) * (uint64)TInt::Mega;
     uint64 StoreCache = (uint64)Val->GetObjInt("storeCache", 1024) * (uint64)TInt::Mega;
+    uint64 QueryCache = (uint64)Val->GetObjInt("queryCache", 0) * (uint64)TInt::Mega;
+    const TCachePolicy CachePolicy = TCachePolicyStr::GetPolicy(Val->GetObjStr("cachePolicy", "lru"));
+    const int StreamAggrThreads = Val->GetObjInt("streamAggrThreads", 1);
 
     // Load Stopword Files
     TStr StopWordsPath = Val->GetObjStr("stopwords", TQm::TEnv::QMinerFPath + "resources/stopwords/");
     TSwSet::LoadSwDir(StopWordsPath);
 
-    return new TNodeJsBase(DbPath, SchemaFNm, Schema, Create, ForceCreate, ReadOnly, StrictNmP, IndexCache, StoreCache);
+    TNodeJsBase* JsBase = new TNodeJsBase(DbPath, SchemaFNm, Schema, Create, ForceCreate, ReadOnly, StrictNmP, IndexCache, StoreCache);
+    JsBase->Base->SetQueryCacheSize(QueryCache);
+    JsBase->Base->SetCachePolicy(CachePolicy);
+    JsBase->Base->SetStreamAggrThreads(StreamAggrThreads);
+    // background flusher, read-only base has nothing to write
+    if (Val->IsObjKey("backgroundFlush") && !ReadOnly) {
+        PJsonVal FlushVal = Val->GetObjKey("backgroundFlush");
+        if (FlushVal->IsObj()) {
+            JsBase->Base->StartFlusher(TQm::TBaseFlusherParam(FlushVal));
+        } else if (FlushVal->GetBool()) {
+            JsBase->Base->StartFlusher();
+        }
+    }
+    // write-ahead log, store list must be saved so the base can be opened after a crash
+    if (Val->IsObjKey("wal") && !ReadOnly) {
+        PJsonVal WalVal = Val->GetObjKey("wal");
+        if (WalVal->IsObj() || WalVal->GetBool()) {
+            TQm::TStorage::SaveBase(JsBase->Base);
+            JsBase->Base->StartWal(WalVal->IsObj() ? TQm::TWalParam(WalVal) : TQm::TWalParam());
+        }
+    }
+    return JsBase;
 }
 
 void TNodeJsBase::close(const v8::FunctionCallbackInfo<v8::Value>& Args) {
@@ -490,6 +533,7 @@ void TNodeJsBase::close(const v8::FunctionCallbackInfo<v8::Value>& Args) {
     v8::HandleScope HandleScope(Isolate);
     // unwrap
     TNodeJsBase* JsBase = TNodeJsUtil::UnwrapCheckWatcher<TNodeJsBase>(Args.Holder());
+    QmAssertR(JsBase->Watcher->AsyncTasks == 0, "Cannot close the base while asynchronous calls are running");
 
     JsBase->Watcher->Close();
 
@@ -682,6 +726,31 @@ void TNodeJsBase::search(const v8::FunctionCallbackInfo<v8::Value>& Args) {
     Args.GetReturnValue().Set(TNodeJsUtil::NewInstance<TNodeJsRecSet>(new TNodeJsRecSet(RecSet, JsBase->Watcher)));
 }
 
+TNodeJsBase::TSearchTask::TSearchTask(const v8::FunctionCallbackInfo<v8::Value>& Args):
+        TNodeJsBaseTask(Args) {
+    v8::Isolate* Isolate = v8::Isolate::GetCurrent();
+    v8::HandleScope HandleScope(Isolate);
+
+    TNodeJsBase* JsBase = TNodeJsUtil::UnwrapCheckWatcher<TNodeJsBase>(Args.Holder());
+    QueryVal = TNodeJsUtil::GetArgJson(Args, 0);
+    StartTask(JsBase->Base, JsBase->Watcher);
+}
+
+void TNodeJsBase::TSearchTask::Run() {
+    try {
+        // search records which exist when we start
+        TQm::PReadSnapshot Snapshot = Base->GetSnapshot();
+        RecSet = Base->Search(QueryVal, Snapshot);
+    } catch (const PExcept& _Except) {
+        SetExcept(_Except);
+    }
+}
+
+v8::Local<v8::Value> TNodeJsBase::TSearchTask::WrapResult() {
+    PNodeJsBaseWatcher Watcher = GetWatcher();
+    return TNodeJsUtil::NewInstance<TNodeJsRecSet>(new TNodeJsRecSet(RecSet, Watcher));
+}
+
 void TNodeJsBase::garbageCollect(const v8::FunctionCallbackInfo<v8::Value>& Args) {
     v8::Isolate* Isolate = v8::Isolate::GetCurrent();
     v8::HandleScope HandleScope(Isolate);
@@ -706,6 +775,19 @@ void TNodeJsBase::partialFlush(const v8::FunctionCallbackInfo<v8::Value>& Args)
     Args.GetReturnValue().Set(v8::Integer::New(Isolate, res));
 }
 
+void TNodeJsBase::checkpoint(const v8::FunctionCallbackInfo<v8::Value>& Args) {
+    v8::Isolate* Isolate = v8::Isolate::GetCurrent();
+    v8::HandleScope HandleScope(Isolate);
+    // unwrap
+    TNodeJsBase* JsBase = TNodeJsUtil::UnwrapCheckWatcher<TNodeJsBase>(Args.Holder());
+    TWPt<TQm::TBase> Base = JsBase->Base;
+
+    QmAssertR(Base->IsWal(), "base.checkpoint: write-ahead log is not enabled");
+    TQm::TStorage::SaveBase(Base);
+    Base->Checkpoint();
+    Args.GetReturnValue().Set(v8::Undefined(Isolate));
+}
+
 void TNodeJsBase::getStats(const v8::FunctionCallbackInfo<v8::Value>& Args) {
     v8::Isolate* Isolate = v8::Isolate::GetCurrent();
     v8::HandleScope HandleScope(Isolate);
@@ -773,6 +855,8 @@ void TNodeJsStore::Init(v8::Handle<v8::Object> exports) {
     NODE_SET_PROTOTYPE_METHOD(tpl, "each", _each);
     NODE_SET_PROTOTYPE_METHOD(tpl, "map", _map);
     NODE_SET_PROTOTYPE_METHOD(tpl, "push", _push);
+    NODE_SET_PROTOTYPE_METHOD(tpl, "pushBatch", _pushBatch);
+    NODE_SET_PROTOTYPE_METHOD(tpl, "pushAsync", _pushAsync);
     NODE_SET_PROTOTYPE_METHOD(tpl, "newRecord", _newRecord);
     NODE_SET_PROTOTYPE_METHOD(tpl, "newRecordSet", _newRecordSet);
     NODE_SET_PROTOTYPE_METHOD(tpl, "sample", _sample);
@@ -966,7 +1050,8 @@ void TNodeJsStore::each(const v8::FunctionCallbackInfo<v8::Value>& Args) {
     const TWPt<TQm::TStore> Store = JsStore->Store;
 
     if (!Store->Empty()) {
-        TQm::PStoreIter Iter = Store->ForwardIter();
+        // full pass over the store should not push hot records out of caches
+        TQm::PStoreIter Iter = TQm::TStoreIterScan::New(Store, Store->ForwardIter());
 
         QmAssert(Iter->Next());
         uint32_t Count = 0;
@@ -1009,7 +1094,8 @@ void TNodeJsStore::map(const v8::FunctionCallbackInfo<v8::Value>& Args) {
     if (!Store->Empty()) {
         v8::Local<v8::Object> GlobalContext = Isolate->GetCurrentContext()->Global();
 
-        TQm::PStoreIter Iter = Store->ForwardIter();
+        // full pass over the store should not push hot records out of caches
+        TQm::PStoreIter Iter = TQm::TStoreIterScan::New(Store, Store->ForwardIter());
 
         QmAssert(Iter->Next());
         uint32_t Count = 0;
@@ -1061,6 +1147,92 @@ void TNodeJsStore::push(const v8::FunctionCallbackInfo<v8::Value>& Args) {
     }
 }
 
+void TNodeJsStore::pushBatch(const v8::FunctionCallbackInfo<v8::Value>& Args) {
+    v8::Isolate* Isolate = v8::Isolate::GetCurrent();
+    v8::HandleScope HandleScope(Isolate);
+
+    try {
+        TNodeJsStore* JsStore = TNodeJsUtil::UnwrapCheckWatcher<TNodeJsStore>(Args.Holder());
+        TWPt<TQm::TStore> Store = JsStore->Store;
+        TWPt<TQm::TBase> Base = JsStore->Store->GetBase();
+
+        // check we can write
+        QmAssertR(!Base->IsRdOnly(), "Base opened as read-only");
+        QmAssertR(Args.Length() > 0 && Args[0]->IsArray(), "store.pushBatch: expects array of records");
+
+        const PJsonVal RecValV = TNodeJsUtil::GetArgJson(Args, 0);
+        const bool TriggerEvents = TNodeJsUtil::GetArgBool(Args, 1, true);
+
+        TUInt64V RecIdV;
+        Store->AddRecBatch(RecValV, RecIdV, TriggerEvents);
+
+        v8::Local<v8::Array> JsRecIdV = v8::Array::New(Isolate, RecIdV.Len());
+        for (int RecN = 0; RecN < RecIdV.Len(); RecN++) {
+            JsRecIdV->Set(v8::Number::New(Isolate, RecN), v8::Integer::NewFromUnsigned(Isolate, (uint32_t)RecIdV[RecN]));
+        }
+        Args.GetReturnValue().Set(JsRecIdV);
+    }
+    catch (const PExcept& Except) {
+        throw TQm::TQmExcept::New("[except] " + Except->GetMsgStr());
+    }
+}
+
+TNodeJsStore::TPushTask::TPushTask(const v8::FunctionCallbackInfo<v8::Value>& Args):
+        TNodeJsBaseTask(Args) {
+    v8::Isolate* Isolate = v8::Isolate::GetCurrent();
+    v8::HandleScope HandleScope(Isolate);
+
+    TNodeJsStore* JsStore = TNodeJsUtil::UnwrapCheckWatcher<TNodeJsStore>(Args.Holder());
+    Store = JsStore->Store;
+    // check we can write from another thread
+    QmAssertR(!Store->GetBase()->IsRdOnly(), "Base opened as read-only");
+    QmAssertR(!Store->GetBase()->IsWal(), "store.pushAsync: not supported with write-ahead log");
+    QmAssertR(Store->GetStoreType() != "TNodeJsFuncStore", "store.pushAsync: not supported by javascript stores");
+
+    RecVal = TNodeJsUtil::GetArgJson(Args, 0);
+    TriggerEvents = (Args.Length() > 2) ? TNodeJsUtil::GetArgBool(Args, 1, true) : true;
+    // updates of existing records and nested join records would call
+    // their triggers on the worker thread, only new records are supported
+    QmAssertR(!RecVal->IsObjKey("$id") && !RecVal->IsObjKey("$name"),
+        "store.pushAsync: references to existing records not supported");
+    for (int FieldId = 0; FieldId < Store->GetFields(); FieldId++) {
+        QmAssertR(!Store->GetFieldDesc(FieldId).IsPrimary(), "store.pushAsync: stores with primary field not supported");
+    }
+    for (int JoinN = 0; JoinN < Store->GetJoins(); JoinN++) {
+        const TStr& JoinNm = Store->GetJoinDesc(JoinN).GetJoinNm();
+        QmAssertR(!RecVal->IsObjKey(JoinNm), "store.pushAsync: nested join records not supported: " + JoinNm);
+    }
+    StartTask(Store->GetBase(), JsStore->Watcher);
+}
+
+void TNodeJsStore::TPushTask::Run() {
+    try {
+        // other readers and writers see the record only once it is completely added
+        TQm::TFlushGuard FlushGuard(Base->GetFlushLock());
+        RecId = Store->AddRec(RecVal, false);
+    } catch (const PExcept& _Except) {
+        SetExcept(_Except);
+    }
+}
+
+void TNodeJsStore::TPushTask::AfterRun() {
+    // triggers can call javascript, so they run on the main thread
+    if (!HasExcept() && TriggerEvents && RecId != TUInt64::Mx) {
+        try {
+            Store->OnAdd(RecId);
+        } catch (const PExcept& _Except) {
+            SetExcept(_Except);
+        }
+    }
+    TNodeJsBaseTask::AfterRun();
+}
+
+v8::Local<v8::Value> TNodeJsStore::TPushTask::WrapResult() {
+    v8::Isolate* Isolate = v8::Isolate::GetCurrent();
+    v8::EscapableHandleScope HandleScope(Isolate);
+    return HandleScope.Escape(v8::Integer::NewFromUnsigned(Isolate, (uint32_t)RecId));
+}
+
 void TNodeJsStore::newRecord(const v8::FunctionCallbackInfo<v8::Value>& Args) {
     v8::Isolate* Isolate = v8::Isolate::GetCurrent();
     v8::HandleScope HandleScope(Isolate);
@@ -1332,14 +1504,7 @@ void TNodeJsStore::getVector(const v8::FunctionCallbackInfo<v8::Value>& Args) {
         const TQm::TFieldDesc& Desc = Store->GetFieldDesc(FieldId);
 
         if (Desc.IsInt()) {
-            TIntV ColV(Recs);
-
-            TQm::PStoreIter Iter = Store->ForwardIter(); Iter->Next();
-            for (int RecN = 0; RecN < Recs; RecN++) {
-                ColV[RecN] = JsStore->Store->GetFieldInt(Iter->GetRecId(), FieldId);
-                Iter->Next();
-            }
-
+            TIntV ColV; Store->GetColumnInt(FieldId, ColV);
             Args.GetReturnValue().Set(TNodeJsVec<TInt, TAuxIntV>::New(ColV));
             return;
         }
@@ -1368,12 +1533,10 @@ void TNodeJsStore::getVector(const v8::FunctionCallbackInfo<v8::Value>& Args) {
             return;
         }
         else if (Desc.IsByte()) {
-            TIntV ColV(Recs);
-
-            TQm::PStoreIter Iter = Store->ForwardIter(); Iter->Next();
-            for (int RecN = 0; RecN < Recs; RecN++) {
-                ColV[RecN] = JsStore->Store->GetFieldByte(Iter->GetRecId(), FieldId);
-                Iter->Next();
+            TUChV ByteV; Store->GetColumnByte(FieldId, ByteV);
+            TIntV ColV(ByteV.Len());
+            for (int RecN = 0; RecN < ByteV.Len(); RecN++) {
+                ColV[RecN] = (int)ByteV[RecN];
             }
 
             Args.GetReturnValue().Set(TNodeJsVec<TInt, TAuxIntV>::New(ColV));
@@ -1422,22 +1585,16 @@ void TNodeJsStore::getVector(const v8::FunctionCallbackInfo<v8::Value>& Args) {
         }
 
         else if (Desc.IsBool()) {
-            TIntV ColV(Recs);
-            TQm::PStoreIter Iter = Store->ForwardIter(); Iter->Next();
-            for (int RecN = 0; RecN < Recs; RecN++) {
-                ColV[RecN] = (int)JsStore->Store->GetFieldBool(Iter->GetRecId(), FieldId);
-                Iter->Next();
+            TUChV ByteV; Store->GetColumnByte(FieldId, ByteV);
+            TIntV ColV(ByteV.Len());
+            for (int RecN = 0; RecN < ByteV.Len(); RecN++) {
+                ColV[RecN] = (ByteV[RecN] != 0) ? 1 : 0;
             }
             Args.GetReturnValue().Set(TNodeJsVec<TInt, TAuxIntV>::New(ColV));
             return;
         }
         else if (Desc.IsFlt()) {
-            TFltV ColV(Recs);
-            TQm::PStoreIter Iter = Store->ForwardIter(); Iter->Next();
-            for (int RecN = 0; RecN < Recs; RecN++) {
-                ColV[RecN] = JsStore->Store->GetFieldFlt(Iter->GetRecId(), FieldId);
-                Iter->Next();
-            }
+            TFltV ColV; Store->GetColumnFlt(FieldId, ColV);
             Args.GetReturnValue().Set(TNodeJsVec<TFlt, TAuxFltV>::New(ColV));
             return;
         }
@@ -1452,13 +1609,10 @@ void TNodeJsStore::getVector(const v8::FunctionCallbackInfo<v8::Value>& Args) {
             return;
         }
         else if (Desc.IsTm()) {
-            TFltV ColV(Recs);
-            TQm::PStoreIter Iter = Store->ForwardIter(); Iter->Next();
-            TTm Tm;
-            for (int RecN = 0; RecN < Recs; RecN++) {
-                Store->GetFieldTm(Iter->GetRecId(), FieldId, Tm);
-                ColV[RecN] = (double) TNodeJsUtil::GetJsTimestamp(TTm::GetMSecsFromTm(Tm));
-                Iter->Next();
+            TUInt64V MSecsV; Store->GetColumnTmMSecs(FieldId, MSecsV);
+            TFltV ColV(MSecsV.Len());
+            for (int RecN = 0; RecN < MSecsV.Len(); RecN++) {
+                ColV[RecN] = (double) TNodeJsUtil::GetJsTimestamp(MSecsV[RecN]);
             }
             Args.GetReturnValue().Set(TNodeJsVec<TFlt, TAuxFltV>::New(ColV));
             return;
@@ -2496,10 +2650,12 @@ void TNodeJsRecSet::Init(v8::Handle<v8::Object> exports) {
     NODE_SET_PROTOTYPE_METHOD(tpl, "sortById", _sortById);
     NODE_SET_PROTOTYPE_METHOD(tpl, "sortByFq", _sortByFq);
     NODE_SET_PROTOTYPE_METHOD(tpl, "sortByField", _sortByField);
+    NODE_SET_PROTOTYPE_METHOD(tpl, "sortByFieldAsync", _sortByFieldAsync);
     NODE_SET_PROTOTYPE_METHOD(tpl, "sort", _sort);
     NODE_SET_PROTOTYPE_METHOD(tpl, "filterById", _filterById);
     NODE_SET_PROTOTYPE_METHOD(tpl, "filterByFq", _filterByFq);
     NODE_SET_PROTOTYPE_METHOD(tpl, "filterByField", _filterByField);
+    NODE_SET_PROTOTYPE_METHOD(tpl, "filterByFieldAsync", _filterByFieldAsync);
     NODE_SET_PROTOTYPE_METHOD(tpl, "filter", _filter);
     NODE_SET_PROTOTYPE_METHOD(tpl, "split", _split);
     NODE_SET_PROTOTYPE_METHOD(tpl, "deleteRecords", _deleteRecords);
@@ -2709,6 +2865,42 @@ void TNodeJsRecSet::sortByField(const v8::FunctionCallbackInfo<v8::Value>& Args)
     Args.GetReturnValue().Set(Args.Holder());
 }
 
+TNodeJsRecSet::TSortByFieldTask::TSortByFieldTask(const v8::FunctionCallbackInfo<v8::Value>& Args):
+        TNodeJsBaseTask(Args) {
+    v8::Isolate* Isolate = v8::Isolate::GetCurrent();
+    v8::HandleScope HandleScope(Isolate);
+
+    TNodeJsRecSet* JsRecSet = TNodeJsUtil::UnwrapCheckWatcher<TNodeJsRecSet>(Args.Holder());
+    const TStr SortFieldNm = TNodeJsUtil::GetArgStr(Args, 0);
+    SortFieldId = JsRecSet->RecSet->GetStore()->GetFieldId(SortFieldNm);
+    Asc = false;
+    if (Args.Length() > 2) {
+        QmAssertR(TNodeJsUtil::IsArgBool(Args, 1) || TNodeJsUtil::IsArgFlt(Args, 1),
+            "TNodeJsRecSet::sortByFieldAsync: Argument 1 expected to be bool or int!");
+        Asc = TNodeJsUtil::IsArgBool(Args, 1) ?
+            TNodeJsUtil::GetArgBool(Args, 1) :
+            TNodeJsUtil::GetArgFlt(Args, 1) > 0;
+    }
+    // work on a copy, javascript can use the record set in the meantime
+    RecSet = JsRecSet->RecSet->Clone();
+    StartTask(RecSet->GetStore()->GetBase(), JsRecSet->Watcher);
+}
+
+void TNodeJsRecSet::TSortByFieldTask::Run() {
+    try {
+        // deletions wait until we are done with the records
+        TQm::PReadSnapshot Snapshot = Base->GetSnapshot();
+        RecSet->SortByField(Asc, SortFieldId);
+    } catch (const PExcept& _Except) {
+        SetExcept(_Except);
+    }
+}
+
+v8::Local<v8::Value> TNodeJsRecSet::TSortByFieldTask::WrapResult() {
+    PNodeJsBaseWatcher Watcher = GetWatcher();
+    return TNodeJsUtil::NewInstance<TNodeJsRecSet>(new TNodeJsRecSet(RecSet, Watcher));
+}
+
 void TNodeJsRecSet::sort(const v8::FunctionCallbackInfo<v8::Value>& Args) {
     v8::Isolate* Isolate = v8::Isolate::GetCurrent();
     v8::HandleScope HandleScope(Isolate);
@@ -2769,12 +2961,19 @@ void TNodeJsRecSet::filterByField(const v8::FunctionCallbackInfo<v8::Value>& Arg
     v8::HandleScope HandleScope(Isolate);
     TNodeJsRecSet* JsRecSet = TNodeJsUtil::UnwrapCheckWatcher<TNodeJsRecSet>(Args.Holder());
 
+    TFieldFilter Filter(Args, Args.Length(), JsRecSet->RecSet->GetStore());
+    Filter.Apply(JsRecSet->RecSet);
+
+    Args.GetReturnValue().Set(Args.Holder());
+}
+
+TNodeJsRecSet::TFieldFilter::TFieldFilter(const v8::FunctionCallbackInfo<v8::Value>& Args,
+        const int& ArgC, const TWPt<TQm::TStore>& Store) {
+
     // get field
     const TStr FieldNm = TNodeJsUtil::GetArgStr(Args, 0);
-    int FieldId;
     bool IsFieldJoin = false;
     bool IsIndexJoin = false;
-    const TWPt<TQm::TStore>& Store = JsRecSet->RecSet->GetStore();
     if (Store->IsFieldNm(FieldNm)) {
         // normal field
         FieldId = Store->GetFieldId(FieldNm);
@@ -2799,160 +2998,141 @@ void TNodeJsRecSet::filterByField(const v8::FunctionCallbackInfo<v8::Value>& Arg
         QmAssertR(is_ok, "RecordSet.filterByField: invalid field name " + FieldNm);
     }
 
-    const TQm::TFieldDesc& Desc = JsRecSet->RecSet->GetStore()->GetFieldDesc(FieldId);
+    // minimal and maximal value, when given as numbers
+    const bool MnP = ArgC > 1 && !TNodeJsUtil::IsArgNull(Args, 1) && TNodeJsUtil::IsArgFlt(Args, 1);
+    const bool MxP = ArgC > 2 && !TNodeJsUtil::IsArgNull(Args, 2) && TNodeJsUtil::IsArgFlt(Args, 2);
+
+    const TQm::TFieldDesc& Desc = Store->GetFieldDesc(FieldId);
     // parse filter according to field type
-    if (IsIndexJoin) {
-        uint64 MnVal = TUInt64::Mn;
-        uint64 MxVal = TUInt64::Mx;
-        if (!TNodeJsUtil::IsArgNull(Args, 1) && TNodeJsUtil::IsArgFlt(Args, 1)) {
-            MnVal = static_cast<uint64> (TNodeJsUtil::GetArgFlt(Args, 1));
-        }
-        if (Args.Length() >= 3 && !TNodeJsUtil::IsArgNull(Args, 2) && TNodeJsUtil::IsArgFlt(Args, 2)) {
-            MxVal = static_cast<uint64> (TNodeJsUtil::GetArgFlt(Args, 2));
-        }
-        JsRecSet->RecSet->FilterByIndexJoin(Store->GetBase(), FieldId, MnVal, MxVal);
-    } else if (IsFieldJoin) {
-        uint64 MnVal = TUInt64::Mn;
-        uint64 MxVal = TUInt64::Mx;
-        if (!TNodeJsUtil::IsArgNull(Args, 1) && TNodeJsUtil::IsArgFlt(Args, 1)) {
-            MnVal = static_cast<uint64> (TNodeJsUtil::GetArgFlt(Args, 1));
-        }
-        if (Args.Length() >= 3 && !TNodeJsUtil::IsArgNull(Args, 2) && TNodeJsUtil::IsArgFlt(Args, 2)) {
-            MxVal = static_cast<uint64> (TNodeJsUtil::GetArgFlt(Args, 2));
-        }
-        JsRecSet->RecSet->FilterByFieldSafe(FieldId, MnVal, MxVal);
+    if (IsIndexJoin || IsFieldJoin) {
+        Type = IsIndexJoin ? fftIndexJoin : fftFieldJoin;
+        MnUInt = MnP ? static_cast<uint64> (TNodeJsUtil::GetArgFlt(Args, 1)) : TUInt64::Mn;
+        MxUInt = MxP ? static_cast<uint64> (TNodeJsUtil::GetArgFlt(Args, 2)) : TUInt64::Mx;
     } else if (Desc.IsBool()) {
-        const bool Val = TNodeJsUtil::GetArgBool(Args, 1);
-        JsRecSet->RecSet->FilterByFieldBool(FieldId, Val);
+        Type = fftBool;
+        QmAssertR(ArgC > 1, "RecordSet.filterByField: missing value");
+        Bool = TNodeJsUtil::GetArgBool(Args, 1);
     } else if (Desc.IsInt()) {
-        int MnVal = TInt::Mn;
-        int MxVal = TInt::Mx;
-        if (!TNodeJsUtil::IsArgNull(Args, 1) && TNodeJsUtil::IsArgFlt(Args, 1)) {
-            MnVal = TNodeJsUtil::GetArgInt32(Args, 1);
-        }
-        if (Args.Length() >= 3 && !TNodeJsUtil::IsArgNull(Args, 2) && TNodeJsUtil::IsArgFlt(Args, 2)) {
-            MxVal = TNodeJsUtil::GetArgInt32(Args, 2);
-        }
-        JsRecSet->RecSet->FilterByFieldInt(FieldId, MnVal, MxVal);
+        Type = fftInt;
+        MnInt = MnP ? TNodeJsUtil::GetArgInt32(Args, 1) : TInt::Mn;
+        MxInt = MxP ? TNodeJsUtil::GetArgInt32(Args, 2) : TInt::Mx;
     } else if (Desc.IsInt16()) {
-        int16 MnVal = TInt16::Mn;
-        int16 MxVal = TInt16::Mx;
-        if (!TNodeJsUtil::IsArgNull(Args, 1) && TNodeJsUtil::IsArgFlt(Args, 1)) {
-            MnVal = (int16) TNodeJsUtil::GetArgInt32(Args, 1);
-        }
-        if (Args.Length() >= 3 && !TNodeJsUtil::IsArgNull(Args, 2) && TNodeJsUtil::IsArgFlt(Args, 2)) {
-            MxVal = (int16) TNodeJsUtil::GetArgInt32(Args, 2);
-        }
-        JsRecSet->RecSet->FilterByFieldInt16(FieldId, MnVal, MxVal);
+        Type = fftInt16;
+        MnInt = MnP ? (int16)TNodeJsUtil::GetArgInt32(Args, 1) : TInt16::Mn;
+        MxInt = MxP ? (int16)TNodeJsUtil::GetArgInt32(Args, 2) : TInt16::Mx;
     } else if (Desc.IsInt64()) {
-        int64 MnVal = TInt64::Mn;
-        int64 MxVal = TInt64::Mx;
-        if (!TNodeJsUtil::IsArgNull(Args, 1) && TNodeJsUtil::IsArgFlt(Args, 1)) {
-            MnVal = (int64)TNodeJsUtil::GetArgFlt(Args, 1);
-        }
-        if (Args.Length() >= 3 && !TNodeJsUtil::IsArgNull(Args, 2) && TNodeJsUtil::IsArgFlt(Args, 2)) {
-            MxVal = (int64)TNodeJsUtil::GetArgFlt(Args, 2);
-        }
-        JsRecSet->RecSet->FilterByFieldInt64(FieldId, MnVal, MxVal);
+        Type = fftInt64;
+        MnInt = MnP ? (int64)TNodeJsUtil::GetArgFlt(Args, 1) : TInt64::Mn;
+        MxInt = MxP ? (int64)TNodeJsUtil::GetArgFlt(Args, 2) : TInt64::Mx;
     } else if (Desc.IsByte()) {
-        uchar MnVal = TUCh::Mn;
-        uchar MxVal = TUCh::Mx;
-        if (!TNodeJsUtil::IsArgNull(Args, 1) && TNodeJsUtil::IsArgFlt(Args, 1)) {
-            MnVal = (uchar)TNodeJsUtil::GetArgInt32(Args, 1);
-        }
-        if (Args.Length() >= 3 && !TNodeJsUtil::IsArgNull(Args, 2) && TNodeJsUtil::IsArgFlt(Args, 2)) {
-            MxVal = (uchar)TNodeJsUtil::GetArgInt32(Args, 2);
-        }
-        JsRecSet->RecSet->FilterByFieldByte(FieldId, MnVal, MxVal);
+        Type = fftByte;
+        MnInt = MnP ? (uchar)TNodeJsUtil::GetArgInt32(Args, 1) : TUCh::Mn;
+        MxInt = MxP ? (uchar)TNodeJsUtil::GetArgInt32(Args, 2) : TUCh::Mx;
     } else if (Desc.IsStr()) {
-        if (Args.Length() < 3 || !TNodeJsUtil::IsArgStr(Args, 2)) {
-            TStr StrVal = TNodeJsUtil::GetArgStr(Args, 1);
-            JsRecSet->RecSet->FilterByFieldStr(FieldId, StrVal);
+        QmAssertR(ArgC > 1, "RecordSet.filterByField: missing value");
+        if (ArgC < 3 || !TNodeJsUtil::IsArgStr(Args, 2)) {
+            Type = fftStr;
+            MnStr = TNodeJsUtil::GetArgStr(Args, 1);
         } else {
-            TStr StrValMin = TNodeJsUtil::GetArgStr(Args, 1);
-            TStr StrValMax = TNodeJsUtil::GetArgStr(Args, 2);
-            JsRecSet->RecSet->FilterByFieldStr(FieldId, StrValMin, StrValMax);
+            Type = fftStrRange;
+            MnStr = TNodeJsUtil::GetArgStr(Args, 1);
+            MxStr = TNodeJsUtil::GetArgStr(Args, 2);
         }
     } else if (Desc.IsFlt()) {
-        double MnVal = TFlt::Mn;
-        double MxVal = TFlt::Mx;
-        if (!TNodeJsUtil::IsArgNull(Args, 1) && TNodeJsUtil::IsArgFlt(Args, 1)) {
-            MnVal = TNodeJsUtil::GetArgFlt(Args, 1);
-        }
-        if (Args.Length() >= 3 && !TNodeJsUtil::IsArgNull(Args, 2) && TNodeJsUtil::IsArgFlt(Args, 2)) {
-            MxVal = TNodeJsUtil::GetArgFlt(Args, 2);
-        }
-        JsRecSet->RecSet->FilterByFieldFlt(FieldId, MnVal, MxVal);
+        Type = fftFlt;
+        MnFlt = MnP ? TNodeJsUtil::GetArgFlt(Args, 1) : TFlt::Mn;
+        MxFlt = MxP ? TNodeJsUtil::GetArgFlt(Args, 2) : TFlt::Mx;
     } else if (Desc.IsSFlt()) {
-        float MnVal = TSFlt::Mn;
-        float MxVal = TSFlt::Mx;
-        if (!TNodeJsUtil::IsArgNull(Args, 1) && TNodeJsUtil::IsArgFlt(Args, 1)) {
-            MnVal = (float)TNodeJsUtil::GetArgFlt(Args, 1);
-        }
-        if (Args.Length() >= 3 && !TNodeJsUtil::IsArgNull(Args, 2) && TNodeJsUtil::IsArgFlt(Args, 2)) {
-            MxVal = (float)TNodeJsUtil::GetArgFlt(Args, 2);
-        }
-        JsRecSet->RecSet->FilterByFieldSFlt(FieldId, MnVal, MxVal);
+        Type = fftSFlt;
+        MnFlt = MnP ? (float)TNodeJsUtil::GetArgFlt(Args, 1) : TSFlt::Mn;
+        MxFlt = MxP ? (float)TNodeJsUtil::GetArgFlt(Args, 2) : TSFlt::Mx;
     } else if (Desc.IsUInt()) {
-        uint MnVal = TUInt::Mn;
-        uint MxVal = TUInt::Mx;
-        if (!TNodeJsUtil::IsArgNull(Args, 1) && TNodeJsUtil::IsArgFlt(Args, 1)) {
-            MnVal = static_cast<uint> (TNodeJsUtil::GetArgFlt(Args, 1));
-        }
-        if (Args.Length() >= 3 && !TNodeJsUtil::IsArgNull(Args, 2) && TNodeJsUtil::IsArgFlt(Args, 2)) {
-            MxVal = static_cast<uint> (TNodeJsUtil::GetArgFlt(Args, 2));
-        }
-        JsRecSet->RecSet->FilterByFieldUInt(FieldId, MnVal, MxVal);
+        Type = fftUInt;
+        MnUInt = MnP ? static_cast<uint> (TNodeJsUtil::GetArgFlt(Args, 1)) : TUInt::Mn;
+        MxUInt = MxP ? static_cast<uint> (TNodeJsUtil::GetArgFlt(Args, 2)) : TUInt::Mx;
     } else if (Desc.IsUInt16()) {
-        uint16 MnVal = TUInt16::Mn;
-        uint16 MxVal = TUInt16::Mx;
-        if (!TNodeJsUtil::IsArgNull(Args, 1) && TNodeJsUtil::IsArgFlt(Args, 1)) {
-            MnVal = static_cast<uint16> (TNodeJsUtil::GetArgFlt(Args, 1));
-        }
-        if (Args.Length() >= 3 && !TNodeJsUtil::IsArgNull(Args, 2) && TNodeJsUtil::IsArgFlt(Args, 2)) {
-            MxVal = static_cast<uint16> (TNodeJsUtil::GetArgFlt(Args, 2));
-        }
-        JsRecSet->RecSet->FilterByFieldUInt16(FieldId, MnVal, MxVal);
+        Type = fftUInt16;
+        MnUInt = MnP ? static_cast<uint16> (TNodeJsUtil::GetArgFlt(Args, 1)) : TUInt16::Mn;
+        MxUInt = MxP ? static_cast<uint16> (TNodeJsUtil::GetArgFlt(Args, 2)) : TUInt16::Mx;
     } else if (Desc.IsUInt64()) {
-        uint64 MnVal = TUInt64::Mn;
-        uint64 MxVal = TUInt64::Mx;
-        if (!TNodeJsUtil::IsArgNull(Args, 1) && TNodeJsUtil::IsArgFlt(Args, 1)) {
-            MnVal = static_cast<uint64_t> (TNodeJsUtil::GetArgFlt(Args, 1));
-        }
-        if (Args.Length() >= 3 && !TNodeJsUtil::IsArgNull(Args, 2) && TNodeJsUtil::IsArgFlt(Args, 2)) {
-            MxVal = static_cast<uint64_t> (TNodeJsUtil::GetArgFlt(Args, 2));
-        }
-        JsRecSet->RecSet->FilterByFieldTm(FieldId, MnVal, MxVal);
+        Type = fftTm;
+        MnUInt = MnP ? static_cast<uint64_t> (TNodeJsUtil::GetArgFlt(Args, 1)) : TUInt64::Mn;
+        MxUInt = MxP ? static_cast<uint64_t> (TNodeJsUtil::GetArgFlt(Args, 2)) : TUInt64::Mx;
     } else if (Desc.IsTm()) {
-        uint64 MnTmMSecs = TUInt64::Mn;
-        uint64 MxTmMSecs = TUInt64::Mx;
+        Type = fftTm;
+        MnUInt = TUInt64::Mn;
+        MxUInt = TUInt64::Mx;
 
-        if (TNodeJsUtil::IsArgNull(Args, 1)) {
+        if (ArgC < 2 || TNodeJsUtil::IsArgNull(Args, 1)) {
             // nothing, default value is ok
         } else if (TNodeJsUtil::IsArgStr(Args, 1)) {
             const TStr MnTmStr = TNodeJsUtil::GetArgStr(Args, 1);
-            MnTmMSecs = TTm::GetMSecsFromTm(TTm::GetTmFromWebLogDateTimeStr(MnTmStr, '-', ':', '.', 'T'));
+            MnUInt = TTm::GetMSecsFromTm(TTm::GetTmFromWebLogDateTimeStr(MnTmStr, '-', ':', '.', 'T'));
         } else if (TNodeJsUtil::IsArgFlt(Args, 1)) {
-            MnTmMSecs = TTm::GetWinMSecsFromUnixMSecs(static_cast<uint64_t> (TNodeJsUtil::GetArgFlt(Args, 1)));
+            MnUInt = TTm::GetWinMSecsFromUnixMSecs(static_cast<uint64_t> (TNodeJsUtil::GetArgFlt(Args, 1)));
         }
 
-        if (Args.Length() >= 3) {
+        if (ArgC >= 3) {
             // we have upper limit
             if (TNodeJsUtil::IsArgNull(Args, 2)) {
                 // nothing, default value is ok
             } else if (TNodeJsUtil::IsArgStr(Args, 2)) {
                 const TStr MxTmStr = TNodeJsUtil::GetArgStr(Args, 2);
-                MxTmMSecs = TTm::GetMSecsFromTm(TTm::GetTmFromWebLogDateTimeStr(MxTmStr, '-', ':', '.', 'T'));
+                MxUInt = TTm::GetMSecsFromTm(TTm::GetTmFromWebLogDateTimeStr(MxTmStr, '-', ':', '.', 'T'));
             } else if (TNodeJsUtil::IsArgFlt(Args, 2)) {
-                MxTmMSecs = TTm::GetWinMSecsFromUnixMSecs(static_cast<uint64_t> (TNodeJsUtil::GetArgFlt(Args, 2)));
+                MxUInt = TTm::GetWinMSecsFromUnixMSecs(static_cast<uint64_t> (TNodeJsUtil::GetArgFlt(Args, 2)));
             }
         }
-        JsRecSet->RecSet->FilterByFieldTm(FieldId, MnTmMSecs, MxTmMSecs);
     } else {
         throw TQm::TQmExcept::New("Unsupported filed type for record set filtering: " + Desc.GetFieldTypeStr());
     }
+}
 
-    Args.GetReturnValue().Set(Args.Holder());
+void TNodeJsRecSet::TFieldFilter::Apply(const TQm::PRecSet& RecSet) const {
+    switch (Type) {
+    case fftIndexJoin: RecSet->FilterByIndexJoin(RecSet->GetStore()->GetBase(), FieldId, MnUInt, MxUInt); break;
+    case fftFieldJoin: RecSet->FilterByFieldSafe(FieldId, MnUInt, MxUInt); break;
+    case fftBool: RecSet->FilterByFieldBool(FieldId, Bool); break;
+    case fftInt: RecSet->FilterByFieldInt(FieldId, (int)MnInt, (int)MxInt); break;
+    case fftInt16: RecSet->FilterByFieldInt16(FieldId, (int16)MnInt, (int16)MxInt); break;
+    case fftInt64: RecSet->FilterByFieldInt64(FieldId, MnInt, MxInt); break;
+    case fftByte: RecSet->FilterByFieldByte(FieldId, (uchar)MnInt, (uchar)MxInt); break;
+    case fftStr: RecSet->FilterByFieldStr(FieldId, MnStr); break;
+    case fftStrRange: RecSet->FilterByFieldStr(FieldId, MnStr, MxStr); break;
+    case fftFlt: RecSet->FilterByFieldFlt(FieldId, MnFlt, MxFlt); break;
+    case fftSFlt: RecSet->FilterByFieldSFlt(FieldId, (float)MnFlt, (float)MxFlt); break;
+    case fftUInt: RecSet->FilterByFieldUInt(FieldId, (uint)MnUInt, (uint)MxUInt); break;
+    case fftUInt16: RecSet->FilterByFieldUInt16(FieldId, (uint16)MnUInt, (uint16)MxUInt); break;
+    case fftTm: RecSet->FilterByFieldTm(FieldId, MnUInt, MxUInt); break;
+    }
+}
+
+TNodeJsRecSet::TFilterByFieldTask::TFilterByFieldTask(const v8::FunctionCallbackInfo<v8::Value>& Args):
+        TNodeJsBaseTask(Args), Filter(Args, Args.Length() - 1,
+            TNodeJsUtil::UnwrapCheckWatcher<TNodeJsRecSet>(Args.Holder())->RecSet->GetStore()) {
+
+    v8::Isolate* Isolate = v8::Isolate::GetCurrent();
+    v8::HandleScope HandleScope(Isolate);
+
+    TNodeJsRecSet* JsRecSet = TNodeJsUtil::UnwrapCheckWatcher<TNodeJsRecSet>(Args.Holder());
+    // work on a copy, javascript can use the record set in the meantime
+    RecSet = JsRecSet->RecSet->Clone();
+    StartTask(RecSet->GetStore()->GetBase(), JsRecSet->Watcher);
+}
+
+void TNodeJsRecSet::TFilterByFieldTask::Run() {
+    try {
+        // deletions wait until we are done with the records
+        TQm::PReadSnapshot Snapshot = Base->GetSnapshot();
+        Filter.Apply(RecSet);
+    } catch (const PExcept& _Except) {
+        SetExcept(_Except);
+    }
+}
+
+v8::Local<v8::Value> TNodeJsRecSet::TFilterByFieldTask::WrapResult() {
+    PNodeJsBaseWatcher Watcher = GetWatcher();
+    return TNodeJsUtil::NewInstance<TNodeJsRecSet>(new TNodeJsRecSet(RecSet, Watcher));
 }
 
 void TNodeJsRecSet::filter(const v8::FunctionCallbackInfo<v8::Value>& Args) {
@@ -3116,12 +3296,9 @@ void TNodeJsRecSet::setIntersect(const v8::FunctionCallbackInfo<v8::Value>& Args
     QmAssertR(JsRecSet->RecSet->GetStore()->GetStoreId() == RecSet1->GetStoreId(),
         "recset.setIntersect: the record sets do not point to the same store!");
 
-    // coputation: clone RecSet, get RecIdSet of RecSet1 and filter by it's complement
+    // computation: clone RecSet and keep only records from RecSet1
     TQm::PRecSet RecSet2 = JsRecSet->RecSet->Clone();
-    TUInt64Set RecIdSet; RecSet1->GetRecIdSet(RecIdSet);
-    // second parameter in filter is false -> keep only records in RecIdSet
-    const TWPt<TQm::TBase>& Base = RecSet1->GetStore()->GetBase();
-    RecSet2->FilterBy<TQm::TRecFilterByRecId>(TQm::TRecFilterByRecId(Base, RecIdSet, true));
+    RecSet2->FilterByRecSet(RecSet1, true);
 
     // construct and return new record set from what remains
     Args.GetReturnValue().Set(TNodeJsUtil::NewInstance<TNodeJsRecSet>(
@@ -3159,12 +3336,9 @@ void TNodeJsRecSet::setDiff(const v8::FunctionCallbackInfo<v8::Value>& Args) {
 
     QmAssertR(JsRecSet->RecSet->GetStore()->GetStoreId() == RecSet1->GetStoreId(),
         "recset.setDiff: the record sets do not point to the same store!");
-    // Computation: clone RecSet, get RecIdSet of RecSet1 and filter by it's complement
+    // computation: clone RecSet and keep only records NOT in RecSet1
     TQm::PRecSet RecSet2 = JsRecSet->RecSet->Clone();
-    TUInt64Set RecIdSet; RecSet1->GetRecIdSet(RecIdSet);
-    //second parameter in filter is false -> keep only records NOT in RecIdSet
-    const TWPt<TQm::TBase>& Base = RecSet1->GetStore()->GetBase();
-    RecSet2->FilterBy<TQm::TRecFilterByRecId>(TQm::TRecFilterByRecId(Base, RecIdSet, false));
+    RecSet2->FilterByRecSet(RecSet1, false);
     Args.GetReturnValue().Set(TNodeJsUtil::NewInstance<TNodeJsRecSet>(new TNodeJsRecSet(RecSet2, JsRecSet->Watcher)));
 }
 
@@ -4137,7 +4311,7 @@ void TNodeJsFtrSpace::updateRecords(const v8::FunctionCallbackInfo<v8::Value>& A
     v8::Isolate* Isolate = v8::Isolate::GetCurrent();
     v8::HandleScope HandleScope(Isolate);
 
-    QmAssertR(Args.Length() == 1, "Should have 1 argument!");
+    QmAssertR(Args.Length() == 1 || Args.Length() == 2, "Should have 1 or 2 arguments!");
 
     TNodeJsFtrSpace* JsFtrSpace = ObjectWrap::Unwrap<TNodeJsFtrSpace>(Args.Holder());
     if (JsFtrSpace->GetFtrSpace()->GetFtrExts() == 0) {
@@ -4152,7 +4326,9 @@ void TNodeJsFtrSpace::updateRecords(const v8::FunctionCallbackInfo<v8::Value>& A
         EAssertR(JsFtrSpace->FtrSpace->IsStartStore(JsRecSet->RecSet->GetStore()->GetStoreId()),
             "FeatureSpace.updateRecords: record's and feature extractor's store/source must be the same!");
 
-        JsFtrSpace->FtrSpace->Update(JsRecSet->RecSet);
+        const int Threads = TNodeJsUtil::GetArgInt32(Args, 1, 1);
+        EAssertR(Threads > 0, "FeatureSpace.updateRecords: number of threads must be positive!");
+        JsFtrSpace->FtrSpace->Update(JsRecSet->RecSet, Threads);
     } else if (TNodeJsUtil::IsArgJson(Args, 0)) {
         PJsonVal Json = TNodeJsUtil::GetArgJson(Args, 0);
         EAssertR(Json->IsArr(), "FeatureSpace.updateRecords: expected record set or a JSON array");
@@ -4284,7 +4460,9 @@ void TNodeJsFtrSpace::extractSparseMatrix(const v8::FunctionCallbackInfo<v8::Val
         EAssertR(JsFtrSpace->FtrSpace->IsStartStore(RecSet->RecSet->GetStore()->GetStoreId()),
             "FeatureSpace.extractSparseMatrix: record's and feature extractor's store/source must be the same!");
 
-        JsFtrSpace->FtrSpace->GetSpVV(RecSet->RecSet, SpMat, FtrExtN);
+        const int Threads = TNodeJsUtil::GetArgInt32(Args, 2, 1);
+        EAssertR(Threads > 0, "FeatureSpace.extractSparseMatrix: number of threads must be positive!");
+        JsFtrSpace->FtrSpace->GetSpVV(RecSet->RecSet, SpMat, FtrExtN, Threads);
     } else if (TNodeJsUtil::IsArgJson(Args, 0)) {
         PJsonVal Json = TNodeJsUtil::GetArgJson(Args, 0);
         EAssertR(Json->IsArr(), "FeatureSpace.extractSparseMatrix: expected record set or a JSON array");
@@ -4300,14 +4478,17 @@ void TNodeJsFtrSpace::extractSparseMatrix(const v8::FunctionCallbackInfo<v8::Val
         throw TQm::TQmExcept::New("extractSparseMatrix: unsupported type of argument 0");
     }
 
-    Args.GetReturnValue().Set(TNodeJsUtil::NewInstance<TNodeJsSpMat>(new TNodeJsSpMat(SpMat, -1)));
+    // hand over the extracted columns without copying them
+    TNodeJsSpMat* JsSpMat = new TNodeJsSpMat();
+    JsSpMat->Mat.Swap(SpMat);
+    Args.GetReturnValue().Set(TNodeJsUtil::NewInstance<TNodeJsSpMat>(JsSpMat));
 }
 
 void TNodeJsFtrSpace::extractMatrix(const v8::FunctionCallbackInfo<v8::Value>& Args) {
     v8::Isolate* Isolate = v8::Isolate::GetCurrent();
     v8::HandleScope HandleScope(Isolate);
 
-    QmAssertR(Args.Length() == 1 || Args.Length() == 2, "Should have 1  or 2 arguments!");
+    QmAssertR(1 <= Args.Length() && Args.Length() <= 3, "Should have 1, 2 or 3 arguments!");
 
     TFltVV Mat;
 
@@ -4328,7 +4509,9 @@ void TNodeJsFtrSpace::extractMatrix(const v8::FunctionCallbackInfo<v8::Value>& A
         EAssertR(JsFtrSpace->FtrSpace->IsStartStore(RecSet->RecSet->GetStore()->GetStoreId()),
             "FeatureSpace.extractMatrix: record's and feature extractor's store/source must be the same!");
 
-        JsFtrSpace->FtrSpace->GetFullVV(RecSet->RecSet, Mat, FtrExtN);
+        const int Threads = TNodeJsUtil::GetArgInt32(Args, 2, 1);
+        EAssertR(Threads > 0, "FeatureSpace.extractMatrix: number of threads must be positive!");
+        JsFtrSpace->FtrSpace->GetFullVV(RecSet->RecSet, Mat, FtrExtN, Threads);
     }
     else if (TNodeJsUtil::IsArgJson(Args, 0)) {
         PJsonVal Json = TNodeJsUtil::GetArgJson(Args, 0);
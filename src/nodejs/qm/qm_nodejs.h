@@ -141,11 +141,40 @@ private:
 * <br>4. `'openReadOnly'` - Opens the db in read only mode.
 * @property  {number} [indexCache=1024] - The ammount of memory reserved for indexing (in MB).
 * @property  {number} [storeCache=1024] - The ammount of memory reserved for store cache (in MB).
+* @property  {number} [queryCache=0] - The ammount of memory reserved for caching results of `base.search` (in MB).
+* Results are dropped when records of their stores change. Zero disables the cache.
+* @property  {string} [cachePolicy='lru'] - Replacement policy of index and store caches. With `'2q'` records read only once,
+* e.g. by `store.each` or a backup, do not push frequently used records out of the caches.
+* @property  {number} [streamAggrThreads=1] - Number of threads used by stream aggregates of a store when records
+* are added with `store.pushBatch`. Aggregates that do not read from each other then update at the same time.
+* @property  {(boolean|module:qm~BackgroundFlushParam)} [backgroundFlush=false] - Write dirty records and index data back
+* to disk from a background thread, so adding records does not stop for `base.partialFlush` and `base.close` has little left to write.
+* Set to `true` for default parameters. Ignored in `'openReadOnly'` mode.
+* @property  {(boolean|module:qm~WalParam)} [wal=false] - Log changes of records to a write-ahead log, so a base which was not
+* closed (e.g. after a crash) is recovered when it is opened again. Only operations since the last checkpoint are replayed.
+* Set to `true` for default parameters. Not supported for paged stores with the `'mmap'` backend. Ignored in `'openReadOnly'` mode.
 * @property  {string} [schemaPath=''] - The path to schema definition file.
 * @property  {Array<module:qm~SchemaDef>} [schema=[]] - Schema definition object array.
 * @property  {string} [dbPath='./db/'] - The path to db directory.
 */
 
+/**
+* @typedef {Object} BackgroundFlushParam
+* Background flush parameters used in {@link module:qm~BaseConstructorParam}.
+* @property {number} [dirtyTarget=16] - Data is written while more than this much is waiting to be written (in MB).
+* @property {number} [rateLimit=0] - Maximal amount of data written per second (in MB). Zero means no limit.
+* @property {number} [interval=1000] - Time between checks of the amount of data waiting to be written (in milliseconds).
+* @property {number} [slice=50] - Time spent writing in one go (in milliseconds). The base is locked while writing, so calls to the base, including adding records, can wait this long.
+*/
+
+/**
+* @typedef {Object} WalParam
+* Write-ahead log parameters used in {@link module:qm~BaseConstructorParam}.
+* @property {number} [syncInterval=100] - Longest time a logged change waits to be written to disk (in milliseconds). Changes made
+* within the interval are written together. Zero writes each change before the call returns.
+* @property {number} [checkpointSize=64] - Base is saved and the log emptied when the log grows over this size (in MB).
+*/
+
 /**
 * @typedef {Object} SchemaDef
 * Store schema definition used in {@link module:qm~BaseConstructorParam}.
@@ -154,6 +183,7 @@ private:
 * @property {Array<module:qm~SchemaJoinDef>} [joins=[]] - The array of join descriptors, used for linking records from different stores.
 * @property {Array<module:qm~SchemaKeyDef>} [keys=[]] - The array of key descriptors. Keys define how records are indexed, which is needed for search using the query language.
 * @property {module:qm~SchemaTimeWindowDef} [timeWindow] - Time window description. Stores can have a window, which is used by garbage collector to delete records once they fall out of the time window. Window can be defined by number of records or by time.
+* @property {number} [windowSegment] - For windows defined by number of records, groups records into segments of the given size, which garbage collector drops as a whole.
 * @example
 * var qm = require('qminer');
 * // create a simple movies store, where each record contains only the movie title.
@@ -193,6 +223,7 @@ private:
 * @property {Object} [default] - Default value for field when not given for a new record.
 * @property {boolean} [codebook=false] - Useful when many records have only few different values of this field. If set to true, then a separate table of all values is kept, and records only point to this table (replacing variable string field in record serialisation with fixed-length integer). Useful to decrease memory footprint, and faster to update. (STRING FIELD TYPE SPECIFIC).
 * @property {boolean} [shortstring=false] - Useful for string shorter then 127 characters (STRING FIELD TYPE SPECIFIC).
+* @property {boolean} [columnar=false] - Keeps values of the field also in a contiguous column, making scans such as {@link module:qm.Store#getVector}, sorting and filtering by the field faster. Supported for `int`, `float`, `datetime`, `byte` and `bool` fields stored in `'memory'`.
 * @example
 *  var qm = require('qminer');
 *  var base = new qm.Base({
@@ -331,6 +362,8 @@ private:
 * @property {number} duration - The size of the time window (in number of units).
 * @property {string} unit - Defines in which units the window size is specified. Possible options are `'second'`, `'minute'`, `'hour'`, `'day'`, `'week'` or `'month'`.
 * @property {string} [field] - Name of the datetime field, which defines the time of the record. In case it is not given, the insert time is used in its place.
+* @property {Object} [segment] - Groups records into time segments of the given `duration` and `unit` (defaults to the window unit). Garbage collector
+* drops whole segments once all their records fall out of the window, and time range queries on `field` only visit the overlapping segments.
 * @example <caption>Define window by number of records</caption>
 * var qm = require('qminer');
 * // create base
@@ -406,7 +439,9 @@ private:
     friend class TPt<TNodeJsBaseWatcher>;
 public:
     bool OpenP;
-    TNodeJsBaseWatcher() { OpenP = true; }
+    // number of asynchronous calls using the base on worker threads
+    int AsyncTasks;
+    TNodeJsBaseWatcher() { OpenP = true; AsyncTasks = 0; }
     static TPt<TNodeJsBaseWatcher> New() { return new TNodeJsBaseWatcher; }
     void AssertOpen() { EAssertR(OpenP, "Base is closed!"); }
     void Close() { OpenP = false; }
@@ -414,6 +449,29 @@ public:
 };
 typedef TPt<TNodeJsBaseWatcher> PNodeJsBaseWatcher;
 
+///////////////////////////////
+// Task which uses the base on a worker thread. The base stays open until
+// the task is done, and reads are made safe for the main thread to keep
+// writing while the task runs. The callback is the last argument.
+class TNodeJsBaseTask: public TNodeTask {
+private:
+    PNodeJsBaseWatcher Watcher;
+
+protected:
+    TWPt<TQm::TBase> Base;
+
+    TNodeJsBaseTask(const v8::FunctionCallbackInfo<v8::Value>& Args): TNodeTask(Args) { }
+    // called by the subclasses once the arguments are parsed
+    void StartTask(const TWPt<TQm::TBase>& _Base, const PNodeJsBaseWatcher& _Watcher);
+    // watcher of the base, for wrapping the results
+    PNodeJsBaseWatcher GetWatcher() const { return Watcher; }
+
+public:
+    ~TNodeJsBaseTask();
+
+    v8::Handle<v8::Function> GetCallback(const v8::FunctionCallbackInfo<v8::Value>& Args);
+};
+
 /**
 * Base
 * @classdesc Represents the database and holds stores.
@@ -661,6 +719,49 @@ private:
 
     JsDeclareFunction(search);
 
+private:
+    class TSearchTask: public TNodeJsBaseTask {
+    private:
+        PJsonVal QueryVal;
+        TQm::PRecSet RecSet;
+
+    public:
+        TSearchTask(const v8::FunctionCallbackInfo<v8::Value>& Args);
+
+        void Run();
+        v8::Local<v8::Value> WrapResult();
+    };
+
+    /**
+    * Makes a query search on a worker thread. The search sees the records as they were when it
+    * started, records added in the meantime are not included. The main thread can keep adding
+    * records while the search runs, deletions wait for it to finish.
+    * @param {module:qm~QueryObject} query - Query language JSON object.
+    * @param {function} [callback] - Called with `(err, recordSet)` when the search is done. When omitted, a promise is returned.
+    * @returns {Promise<module:qm.RecordSet>} When no callback is given, a promise of the record set that matches the search criterion.
+    * @example
+    * // import qm module
+    * var qm = require('qminer');
+    * // create a base with one store
+    * var base = new qm.Base({
+    *    mode: "createClean",
+    *    schema: [{
+    *        name: "Philosophers",
+    *        fields: [{ name: "Name", type: "string" }, { name: "Era", type: "string" }],
+    *        keys: [{ field: "Era", type: "value" }]
+    *    }]
+    * });
+    * base.store("Philosophers").push({ Name: "Plato", Era: "Ancient philosophy" });
+    * base.store("Philosophers").push({ Name: "Immanuel Kant", Era: "18th-century philosophy" });
+    * // search without blocking the event loop
+    * base.searchAsync({ $from: "Philosophers", Era: "Ancient philosophy" }, function (err, recordSet) {
+    *    // recordSet contains Plato
+    *    base.close();
+    * });
+    */
+    //# exports.Base.prototype.searchAsync = function (query, callback) { return Promise.resolve(Object.create(require('qminer').RecordSet.prototype)); }
+    JsDeclareAsyncFunction(searchAsync, TSearchTask);
+
     /**
     * Calls qminer garbage collector to remove records outside time windows. For application example see {@link module:qm~SchemaTimeWindowDef}.
     */
@@ -702,6 +803,24 @@ private:
 
     JsDeclareFunction(partialFlush);
 
+    /**
+    * Saves the base and empties the write-ahead log. Only available when the base was opened with `wal`.
+    * Checkpoints are also made automatically when the log grows over `checkpointSize`.
+    * @example
+    * var qm = require('qminer');
+    * var base = new qm.Base({
+    *    mode: 'createClean',
+    *    wal: { syncInterval: 50 },
+    *    schema: [{ name: "Events", fields: [{ name: "Name", type: "string" }] }]
+    * });
+    * base.store("Events").push({ Name: "start" });
+    * base.checkpoint();
+    * base.close();
+    */
+    //# exports.Base.prototype.checkpoint = function () { }
+
+    JsDeclareFunction(checkpoint);
+
     /**
     * @typedef {object} PerformanceStat
     * The performance statistics used to describe {@link module:qm~PerformanceStatBase} and {@link module:qm~PerformanceStatStore}.
@@ -739,7 +858,28 @@ private:
     * @property {number} gix_stats.cache_dirty - \\ TODO: Add the description
     * @property {number} gix_stats.cache_dirty_loaded_perc - \\ TODO: Add the description
     * @property {number} gix_stats.mem_sed - \\ TODO: Add the description
+    * @property {number} gix_stats.cache_hits - Number of index reads served from the cache.
+    * @property {number} gix_stats.cache_misses - Number of index reads loaded from disk.
+    * @property {number} gix_stats.cache_hit_rate - Share of index reads served from the cache.
     * @property {module:qm~PerformanceStat} gix_blob - \\ TODO: Add the description
+    * @property {string} cache_policy - Replacement policy of index and store caches.
+    * @property {number} dirty_bytes - Estimate of bytes waiting to be written to disk.
+    * @property {object} [flusher] - Background flusher statistics, present when enabled with `backgroundFlush`.
+    * @property {number} flusher.slices - Number of times the flusher wrote data.
+    * @property {number} flusher.flushed_bytes - Estimate of bytes written by the flusher.
+    * @property {object} [wal] - Write-ahead log statistics, present when enabled with `wal`.
+    * @property {number} wal.lsn - Number of the last logged change.
+    * @property {number} wal.log_bytes - Size of the log since the last checkpoint.
+    * @property {number} wal.ops - Number of logged changes.
+    * @property {number} wal.syncs - Number of times the log was written to disk.
+    * @property {number} wal.checkpoints - Number of checkpoints.
+    * @property {object} [query_cache] - Query result cache statistics, present when enabled with `queryCache`.
+    * @property {number} query_cache.size - Memory budget in bytes.
+    * @property {number} query_cache.used - Memory used by cached results in bytes.
+    * @property {number} query_cache.queries - Number of cached results.
+    * @property {number} query_cache.hits - Number of searches served from the cache.
+    * @property {number} query_cache.misses - Number of searches not served from the cache.
+    * @property {number} query_cache.stales - Number of cached results dropped because their stores changed.
     */
 
     /**
@@ -1101,6 +1241,84 @@ private:
     //# exports.Store.prototype.push = function (rec, triggerEvents) { return 0; }
     JsDeclareFunction(push);
 
+    /**
+    * Adds an array of records to the store. Faster than calling {@link module:qm.Store#push} for each
+    * record, since the indexes are updated once for the whole batch.
+    * @param {Array<object>} recs - The added records. Each record must be a object corresponding to store schema.
+    * @param {boolean} [triggerEvents=true] - If true, stream aggregate callbacks `onAdd` are called for the new records after the whole batch is inserted and indexed.
+    * @returns {Array<number>} The IDs of the added records.
+    * @example
+    * // import qm module
+    * var qm = require('qminer');
+    * // create a new base containing one store
+    * var base = new qm.Base({
+    *    mode: "createClean",
+    *    schema: [{
+    *        name: "Superheroes",
+    *        fields: [
+    *            { name: "Name", type: "string" },
+    *            { name: "Superpowers", type: "string_v" }
+    *        ]
+    *    }]
+    * });
+    * // add two superheroes at once
+    * base.store("Superheroes").pushBatch([
+    *    { Name: "Superman", Superpowers: ["flight", "heat vision", "bulletproof"] },
+    *    { Name: "Batman", Superpowers: ["money"] }
+    * ]); // returns [0, 1]
+    * base.close();
+    */
+    //# exports.Store.prototype.pushBatch = function (recs, triggerEvents) { return [0]; }
+    JsDeclareFunction(pushBatch);
+
+    class TPushTask: public TNodeJsBaseTask {
+    private:
+        TWPt<TQm::TStore> Store;
+        PJsonVal RecVal;
+        TBool TriggerEvents;
+        TUInt64 RecId;
+
+    public:
+        TPushTask(const v8::FunctionCallbackInfo<v8::Value>& Args);
+
+        void Run();
+        void AfterRun();
+        v8::Local<v8::Value> WrapResult();
+    };
+
+    /**
+    * Adds a record to the store on a worker thread, so the event loop is not blocked while the
+    * record is stored and indexed. Stream aggregate callbacks `onAdd` are called on the main thread
+    * once the record is added. Records pushed one after another without waiting for the callback
+    * can be added in any order. Only adds new records: the store can not have a primary field, and the record
+    * can not refer to existing records or contain nested join records. Not available while the write-ahead log is on.
+    * @param {object} rec - The added record. The record must be a JSON object corresponding to the store schema.
+    * @param {boolean} [triggerEvents=true] - If true, calls the stream aggregate callbacks `onAdd` for the new record.
+    * @param {function} [callback] - Called with `(err, recId)` when the record is added. When omitted, a promise is returned.
+    * @returns {Promise<number>} When no callback is given, a promise of the ID of the added record.
+    * @example
+    * // import qm module
+    * var qm = require('qminer');
+    * // create a new base containing one store
+    * var base = new qm.Base({
+    *    mode: "createClean",
+    *    schema: [{
+    *        name: "Superheroes",
+    *        fields: [
+    *            { name: "Name", type: "string" },
+    *            { name: "Superpowers", type: "string_v" }
+    *        ]
+    *    }]
+    * });
+    * // add a superhero without blocking the event loop
+    * base.store("Superheroes").pushAsync({ Name: "Superman", Superpowers: ["flight"] }).then(function (recId) {
+    *    // recId is 0
+    *    base.close();
+    * });
+    */
+    //# exports.Store.prototype.pushAsync = function (rec, triggerEvents, callback) { return Promise.resolve(0); }
+    JsDeclareAsyncFunction(pushAsync, TPushTask);
+
     /**
     * Creates a new record of given store. The record is not added to the store.
     * @param {object} obj - An object describing the record.
@@ -2333,6 +2551,50 @@ private:
     //# exports.RecordSet.prototype.sortByField = function (fieldName, asc) { return Object.create(require('qminer').RecordSet.prototype); };
     JsDeclareFunction(sortByField);
 
+    class TSortByFieldTask: public TNodeJsBaseTask {
+    private:
+        TQm::PRecSet RecSet;
+        TInt SortFieldId;
+        TBool Asc;
+
+    public:
+        TSortByFieldTask(const v8::FunctionCallbackInfo<v8::Value>& Args);
+
+        void Run();
+        v8::Local<v8::Value> WrapResult();
+    };
+
+    /**
+    * Sorts a copy of the record set on a worker thread. The record set itself is not changed.
+    * @param {string} fieldName - The field by which the records will be sorted.
+    * @param {number} [arc=-1] - if `asc` > 0, it sorts in ascending order. Otherwise, it sorts in descending order.
+    * @param {function} [callback] - Called with `(err, recordSet)` when the sorted copy is ready. When omitted, a promise is returned.
+    * @returns {Promise<module:qm.RecordSet>} When no callback is given, a promise of the sorted copy.
+    * @example
+    * // import qm module
+    * var qm = require('qminer');
+    * // create a new base containing one store
+    * var base = new qm.Base({
+    *    mode: "createClean",
+    *    schema: [{
+    *        name: "TVSeries",
+    *        fields: [
+    *            { name: "Title", type: "string", primary: true },
+    *            { name: "NumberOfEpisodes", type: "int" }
+    *        ]
+    *    }]
+    * });
+    * base.store("TVSeries").push({ Title: "Archer", NumberOfEpisodes: 75 });
+    * base.store("TVSeries").push({ Title: "The Simpsons", NumberOfEpisodes: 574 });
+    * // sort the records by their "Title" field in ascending order
+    * base.store("TVSeries").allRecords.sortByFieldAsync("Title", true, function (err, recordSet) {
+    *    // recordSet starts with "Archer"
+    *    base.close();
+    * });
+    */
+    //# exports.RecordSet.prototype.sortByFieldAsync = function (fieldName, asc, callback) { return Promise.resolve(Object.create(require('qminer').RecordSet.prototype)); };
+    JsDeclareAsyncFunction(sortByFieldAsync, TSortByFieldTask);
+
     /**
     * Sorts the records according to the given callback function.
     * @param {function} callback - The function used to sort the records. It takes two parameters:
@@ -2460,6 +2722,77 @@ private:
     //# exports.RecordSet.prototype.filterByField = function (fieldName, minVal, maxVal) { return Object.create(require('qminer').RecordSet.prototype); };
     JsDeclareFunction(filterByField);
 
+    // filter of filterByField, parsed on the main thread so it can be applied on a worker
+    class TFieldFilter {
+    private:
+        typedef enum { fftIndexJoin, fftFieldJoin, fftBool, fftInt, fftInt16, fftInt64, fftByte,
+            fftStr, fftStrRange, fftFlt, fftSFlt, fftUInt, fftUInt16, fftTm } TFieldFilterType;
+
+        TFieldFilterType Type;
+        // field or index join
+        TInt FieldId;
+        // range for signed and unsigned integer fields, time, and joins
+        TInt64 MnInt, MxInt;
+        TUInt64 MnUInt, MxUInt;
+        // range for float fields
+        TFlt MnFlt, MxFlt;
+        // value for string and boolean fields
+        TStr MnStr, MxStr;
+        TBool Bool;
+
+    public:
+        // parse from the first ArgC arguments
+        TFieldFilter(const v8::FunctionCallbackInfo<v8::Value>& Args, const int& ArgC,
+            const TWPt<TQm::TStore>& Store);
+
+        void Apply(const TQm::PRecSet& RecSet) const;
+    };
+
+    class TFilterByFieldTask: public TNodeJsBaseTask {
+    private:
+        TQm::PRecSet RecSet;
+        TFieldFilter Filter;
+
+    public:
+        TFilterByFieldTask(const v8::FunctionCallbackInfo<v8::Value>& Args);
+
+        void Run();
+        v8::Local<v8::Value> WrapResult();
+    };
+
+    /**
+    * Filters a copy of the record set on a worker thread. Takes the same filter as {@link module:qm.RecordSet#filterByField},
+    * the record set itself is not changed.
+    * @param {string} fieldName - The field by which the records will be filtered.
+    * @param {(string | number)} minVal - The exact string, or the minimal value for comparison.
+    * @param {number} [maxVal] - The maximal value for comparison.
+    * @param {function} [callback] - Called with `(err, recordSet)` when the filtered copy is ready. When omitted, a promise is returned.
+    * @returns {Promise<module:qm.RecordSet>} When no callback is given, a promise of the filtered copy.
+    * @example
+    * // import qm module
+    * var qm = require('qminer');
+    * // create a new base containing one store
+    * var base = new qm.Base({
+    *    mode: "createClean",
+    *    schema: [{
+    *        name: "WeatherForcast",
+    *        fields: [
+    *            { name: "Weather", type: "string" },
+    *            { name: "TemperatureDegrees", type: "int" },
+    *        ]
+    *    }]
+    * });
+    * base.store("WeatherForcast").push({ Weather: "Partly Cloudy", TemperatureDegrees: 19 });
+    * base.store("WeatherForcast").push({ Weather: "Mostly Cloudy", TemperatureDegrees: 25 });
+    * // keep the warm days
+    * base.store("WeatherForcast").allRecords.filterByFieldAsync("TemperatureDegrees", 20, 30).then(function (recordSet) {
+    *    // recordSet contains the "Mostly Cloudy" day
+    *    base.close();
+    * });
+    */
+    //# exports.RecordSet.prototype.filterByFieldAsync = function (fieldName, minVal, maxVal, callback) { return Promise.resolve(Object.create(require('qminer').RecordSet.prototype)); };
+    JsDeclareAsyncFunction(filterByFieldAsync, TFilterByFieldTask);
+
     /**
     * Keeps only the records that pass the callback function.
     * @param {function} callback - The filter function. It takes one parameter:
@@ -3091,6 +3424,8 @@ public:
     bool Update(const TQm::TRec& Rec) { return false; }
     void AddSpV(const TQm::TRec& Rec, TIntFltKdV& SpV, int& Offset) const;
     void AddFullV(const TQm::TRec& Rec, TFltV& FullV, int& Offset) const;
+    // callback can only be called from the main thread
+    bool IsThreadSafe() const { return false; }
     void InvFullV(const TFltV& FullV, int& Offset, TFltV& InvV) const {
         throw TExcept::New("Not implemented yet!", "TJsFuncFtrExt::InvFullV"); }
     double GetVal(const double& InVal) const { throw TExcept::New("Not implemented!"); }
@@ -3328,6 +3663,8 @@ public:
 * <br>4. `'tfidf'` - Sets the product of the `tf` and `idf` frequency.
 * @property {number} [hashDimension] - A hashing code to set the fixed dimensionality. All values are hashed and divided modulo hashDimension to get the corresponding dimension.
 * @property {boolean} [hashTable=false] - If true, stores the hash table which is used for for feature naming.
+* @property {boolean} [tokenCache=false] - If true, keeps tokens of each record in memory and tokenizes the text again only after it changes.
+* Speeds up repeated updates and extractions over the same records in `'concatenate'` mode. The cache is not saved with the feature space.
 * @property {string} field - The name of the field from which to take the value.
 * @property {module:qm~FeatureTokenizer} tokenizer - The settings for extraction of text.
 * @property {string} [mode] - How are multi-record cases combined into single vector. Possible options:
@@ -3695,6 +4032,8 @@ public:
     * <br> For jsfunc feature extractors, it can update a parameter used in it's function.
     * <br> For dateWindow feature extractor, it can update the start and the end of the window period to form the normalization.
     * @param {module:qm.RecordSet} rs - The record set, which updates the feature space.
+    * @param {number} [threads=1] - Number of threads. Text, categorical and multinomial feature extractors
+    * collect their vocabularies from parts of `rs` in parallel, others are updated one record at a time.
     * @returns {module:qm.FeatureSpace} Self. The feature space has been updated.
     * @example
     * // import qm module
@@ -3732,7 +4071,7 @@ public:
     * ftr.extractVector(Store[3]); // returns the vector [1, 1, 0, 0, 1 / Math.sqrt(2), 0, 0, 1 / Math.sqrt(2), 0, 0]
     * base.close();
     */
-    //# exports.FeatureSpace.prototype.updateRecords = function (rs) { return Object.create(require('qminer').FeatureSpace.prototype); };
+    //# exports.FeatureSpace.prototype.updateRecords = function (rs, threads) { return Object.create(require('qminer').FeatureSpace.prototype); };
     JsDeclareFunction(updateRecords);
 
     JsDeclareAsyncFunction(updateRecordsAsync, TUpdateRecsTask);
@@ -3832,6 +4171,8 @@ public:
     * Extracts the sparse feature vectors from the record set and returns them as columns of the sparse matrix.
     * @param {module:qm.RecordSet} rs - The given record set.
     * @param {number} [idx] - When given, only use specified feature extractor.
+    * @param {number} [threads=1] - Number of threads extracting the vectors. Feature spaces with jsfunc
+    * or random feature extractors always use one thread.
     * @returns {module:la.SparseMatrix} The sparse matrix, where the i-th column is the sparse feature vector of the i-th record in `rs`.
     * @example
     * // import qm module
@@ -3860,13 +4201,15 @@ public:
     * var sparseMatrix = ftr.extractSparseMatrix(base.store("Class").allRecords);
     * base.close();
     */
-    //# exports.FeatureSpace.prototype.extractSparseMatrix = function (rs, idx) { return Object.create(require('qminer').la.SparseMatrix.prototype); };
+    //# exports.FeatureSpace.prototype.extractSparseMatrix = function (rs, idx, threads) { return Object.create(require('qminer').la.SparseMatrix.prototype); };
     JsDeclareFunction(extractSparseMatrix);
 
     /**
     * Extracts the feature vectors from the recordset and returns them as columns of a dense matrix.
     * @param {module:qm.RecordSet} rs - The given record set.
     * @param {number} [idx] - when given, only use specified feature extractor.
+    * @param {number} [threads=1] - Number of threads extracting the vectors. Feature spaces with jsfunc
+    * or random feature extractors always use one thread.
     * @returns {module:la.Matrix} The dense matrix, where the i-th column is the feature vector of the i-th record in `rs`.
     * @example
     * // import qm module
@@ -3898,7 +4241,7 @@ public:
     * var matrix = ftr.extractMatrix(base.store("Class").allRecords);
     * base.close();
     */
-    //# exports.FeatureSpace.prototype.extractMatrix = function (rs, idx) { return Object.create(require('qminer').la.Matrix.prototype); };
+    //# exports.FeatureSpace.prototype.extractMatrix = function (rs, idx, threads) { return Object.create(require('qminer').la.Matrix.prototype); };
     JsDeclareFunction(extractMatrix);
 
     JsDeclareAsyncFunction(extractMatrixAsync, TExtractMatrixTask);
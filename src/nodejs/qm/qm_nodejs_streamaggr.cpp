@@ -559,8 +559,7 @@ void TNodeJsStreamAggr::getInFloatVector(const v8::FunctionCallbackInfo<v8::Valu
     if (Aggr.Empty()) {
         throw TQm::TQmExcept::New("TNodeJsStreamAggr::getInFloatVector : stream aggregate does not implement IFltTmIO: " + JsSA->SA->GetAggrNm());
     }
-    TFltV Res;
-    Aggr->GetInValV(Res);
+    const TFltV& Res = Aggr->GetInValV();
 
     Args.GetReturnValue().Set(TNodeJsVec<TFlt, TAuxFltV>::New(Res));
 }
@@ -576,8 +575,7 @@ void TNodeJsStreamAggr::getInTimestampVector(const v8::FunctionCallbackInfo<v8::
     if (Aggr.Empty()) {
         throw TQm::TQmExcept::New("TNodeJsStreamAggr::getOutTmV : stream aggregate does not implement ITmIO: " + JsSA->SA->GetAggrNm());
     }
-    TUInt64V Res;
-    Aggr->GetInTmMSecsV(Res);
+    const TUInt64V& Res = Aggr->GetInTmMSecsV();
     int Len = Res.Len();
     TFltV FltRes(Len);
     for (int ElN = 0; ElN < Len; ElN++) {
@@ -599,8 +597,7 @@ void TNodeJsStreamAggr::getOutFloatVector(const v8::FunctionCallbackInfo<v8::Val
     if (Aggr.Empty()) {
         throw TQm::TQmExcept::New("TNodeJsStreamAggr::getOutFloatVector : stream aggregate does not implement IFltTmIO: " + JsSA->SA->GetAggrNm());
     }
-    TFltV Res;
-    Aggr->GetOutValV(Res);
+    const TFltV& Res = Aggr->GetOutValV();
 
     Args.GetReturnValue().Set(TNodeJsVec<TFlt, TAuxFltV>::New(Res));
 }
@@ -616,8 +613,7 @@ void TNodeJsStreamAggr::getOutTimestampVector(const v8::FunctionCallbackInfo<v8:
     if (Aggr.Empty()) {
         throw TQm::TQmExcept::New("TNodeJsStreamAggr::getOutTmV : stream aggregate does not implement ITmIO: " + JsSA->SA->GetAggrNm());
     }
-    TUInt64V Res;
-    Aggr->GetOutTmMSecsV(Res);
+    const TUInt64V& Res = Aggr->GetOutTmMSecsV();
     int Len = Res.Len();
     TFltV FltRes(Len);
     for (int ElN = 0; ElN < Len; ElN++) {
@@ -654,13 +650,11 @@ void TNodeJsStreamAggr::getInValueVector(const v8::FunctionCallbackInfo<v8::Valu
     TWPt<TQm::TStreamAggrOut::IValIO<TIntFltKdV> > AggrSpV = dynamic_cast<TQm::TStreamAggrOut::IValIO<TIntFltKdV> *>(JsSA->SA());
 
     if (!AggrFlt.Empty()) {
-        TFltV Res;
-        AggrFlt->GetInValV(Res);
+        const TFltV& Res = AggrFlt->GetInValV();
         Args.GetReturnValue().Set(TNodeJsVec<TFlt, TAuxFltV>::New(Res));
     }
     else if (!AggrSpV.Empty()){
-        TVec<TIntFltKdV> Res;
-        AggrSpV->GetInValV(Res);
+        const TVec<TIntFltKdV>& Res = AggrSpV->GetInValV();
         Args.GetReturnValue().Set(
             TNodeJsUtil::NewInstance<TNodeJsSpMat>(new TNodeJsSpMat(Res)));
     }
@@ -681,13 +675,11 @@ void TNodeJsStreamAggr::getOutValueVector(const v8::FunctionCallbackInfo<v8::Val
     TWPt<TQm::TStreamAggrOut::IValIO<TIntFltKdV> > AggrSpV = dynamic_cast<TQm::TStreamAggrOut::IValIO<TIntFltKdV> *>(JsSA->SA());
 
     if (!AggrFlt.Empty()) {
-        TFltV Res;
-        AggrFlt->GetOutValV(Res);
+        const TFltV& Res = AggrFlt->GetOutValV();
         Args.GetReturnValue().Set(TNodeJsVec<TFlt, TAuxFltV>::New(Res));
     }
     else if (!AggrSpV.Empty()){
-        TVec<TIntFltKdV> Res;
-        AggrSpV->GetOutValV(Res);
+        const TVec<TIntFltKdV>& Res = AggrSpV->GetOutValV();
         Args.GetReturnValue().Set(
             TNodeJsUtil::NewInstance<TNodeJsSpMat>(new TNodeJsSpMat(Res)));
     } else {
@@ -1377,20 +1369,20 @@ uint64 TNodeJsFuncStreamAggr::GetTmMSecs() const {
 }
 
 // IFltIO
-void TNodeJsFuncStreamAggr::GetInValV(TFltV& ValV) const {
+const TFltV& TNodeJsFuncStreamAggr::GetInValV() const {
     throw  TQm::TQmExcept::New("TNodeJsFuncStreamAggr, name: " + GetAggrNm() + ", GetInValV not implemented");
 }
 
-void TNodeJsFuncStreamAggr::GetOutValV(TFltV& ValV) const {
+const TFltV& TNodeJsFuncStreamAggr::GetOutValV() const {
     throw  TQm::TQmExcept::New("TNodeJsFuncStreamAggr, name: " + GetAggrNm() + ", GetOutValV not implemented");
 }
 
 // ITmIO
-void TNodeJsFuncStreamAggr::GetInTmMSecsV(TUInt64V& MSecsV) const {
+const TUInt64V& TNodeJsFuncStreamAggr::GetInTmMSecsV() const {
     throw  TQm::TQmExcept::New("TNodeJsFuncStreamAggr, name: " + GetAggrNm() + ", GetInTmMSecsV not implemented");
 }
 
-void TNodeJsFuncStreamAggr::GetOutTmMSecsV(TUInt64V& MSecsV) const {
+const TUInt64V& TNodeJsFuncStreamAggr::GetOutTmMSecsV() const {
     throw  TQm::TQmExcept::New("TNodeJsFuncStreamAggr, name: " + GetAggrNm() + ", GetOutTmMSecsV not implemented");
 }
 
@@ -105,6 +105,7 @@
 * @property {module:qm~StreamAggrMin} min - The minimal type. Saves the minimal value in the buffer.
 * @property {module:qm~StreamAggrMax} max - The maximal type. Saves the maximal value in the buffer.
 * @property {module:qm~StreamAggrSparseVecSum} sparse-vec-sum - The sparse-vector-sum type.
+* @property {module:qm~StreamAggrMultiWinStats} multi-win-stats - The sum, mean, variance, min and max of several signals in a window.
 * @property {module:qm~StreamAggrMovingAverage} ma - The moving average type. Calculates the average within the window.
 * @property {module:qm~StreamAggrEMA} ema - The exponental moving average type. Calculates the exponental average of the values.
 * @property {module:qm~StreamAggrEMASpVec} ema-sp-vec - The exponental moving average for sparse vectors type.
@@ -123,6 +124,7 @@
 * @property {module:qm~StreamAggrThreshold} treshold - The threshold indicator type.
 * @property {module:qm~StreamAggrTDigest} tdigest - The quantile estimator type. It estimates the quantiles of the given data using {@link module:analytics.TDigest TDigest}.
 * @property {module:qm~StreamAggrRecordSwitch} record-switch-aggr - The record switch type.
+* @property {module:qm~StreamAggrPipeline} pipeline - The pipeline type. Builds a chain of stream aggregates, fusing known chains into one.
 */
 
 /**
@@ -452,6 +454,94 @@
 * base.close();
 */
 
+/**
+* @typedef {module:qm.StreamAggr} StreamAggrMultiWinStats
+* This stream aggregator computes sum, mean, variance, min and max of several signals over a window. The signals come as
+* dense vectors from a `'denseVectorWindow'` buffer, which keeps the vectors of a connected aggregate (e.g. feature space) in a time window.
+* Statistics of all signals are updated together, which is faster than a separate window and aggregate for each signal.
+* It implements the following methods:
+* <br>1. {@link module:qm.StreamAggr#getValueVector} returns the statistic selected with `output` for each signal.
+* <br>2. {@link module:qm.StreamAggr#getTimestamp} returns the timestamp of the newest record in its buffer window.
+* <br>3. {@link module:qm.StreamAggr#saveJson} returns all the statistics.
+* @property {string} name - The given name of the stream aggregator.
+* @property {string} type - The type of the stream aggregator. <b>Important:</b> It must be equal to `'winBufMultiStats'`.
+* @property {string} store - The name of the store from which it takes the data.
+* @property {string} inAggr - The name of the `'denseVectorWindow'` stream aggregator to which it connects and gets data.
+* @property {string} [output='mean'] - The statistic returned by `getValueVector`: `'sum'`, `'mean'`, `'variance'`, `'min'` or `'max'`.
+* @example
+* var qm = require('qminer');
+* var base = new qm.Base({
+*   mode: 'createClean',
+*   schema: [{
+*       name: 'Sensors',
+*       fields: [
+*           { name: 'Time', type: 'datetime' },
+*           { name: 'Temperature', type: 'float' },
+*           { name: 'Humidity', type: 'float' }
+*       ]
+*   }]
+* });
+* var store = base.store('Sensors');
+* store.addStreamAggr({ name: 'tick', type: 'timeSeriesTick', store: 'Sensors', timestamp: 'Time', value: 'Temperature' });
+* store.addStreamAggr({ name: 'vector', type: 'featureSpace', featureSpace: [
+*   { type: 'numeric', source: 'Sensors', field: 'Temperature' },
+*   { type: 'numeric', source: 'Sensors', field: 'Humidity' }
+* ]});
+* store.addStreamAggr({ name: 'window', type: 'denseVectorWindow', store: 'Sensors', inAggr: 'vector', inAggrTm: 'tick', winsize: 3000 });
+* var stats = store.addStreamAggr({ name: 'stats', type: 'winBufMultiStats', store: 'Sensors', inAggr: 'window', output: 'max' });
+*
+* store.push({ Time: '2015-06-10T14:13:32.0', Temperature: 20, Humidity: 50 });
+* store.push({ Time: '2015-06-10T14:13:33.0', Temperature: 22, Humidity: 40 });
+* store.push({ Time: '2015-06-10T14:13:36.0', Temperature: 21, Humidity: 45 });
+*
+* var max = stats.getValueVector(); // [22, 45]
+* var all = stats.saveJson(); // { sum: [43, 85], mean: [21.5, 42.5], ... }
+* base.close();
+*/
+
+/**
+* @typedef {module:qm.StreamAggr} StreamAggrPipeline
+* This stream aggregator builds a chain of stream aggregators, where each stage reads from the previous one.
+* The chains `'timeSeriesTick'` &rarr; `'timeSeriesWinBufVector'` &rarr; `'ma'`, `'variance'`, `'winBufSum'`, `'winBufMin'` or `'winBufMax'`,
+* and `'timeSeriesTick'` &rarr; `'ema'` are built as one stream aggregator that reads the records directly and gives the same results faster.
+* Other chains are built from separate stream aggregators: stage N is named `'<name>_<N>'` and the last stage gets the name of the pipeline.
+* Stages that set their own `inAggr` or `inAggrTm` are never fused.
+* The pipeline implements the methods of its last stage.
+* @property {string} name - The given name of the stream aggregator.
+* @property {string} type - The type of the stream aggregator. <b>Important:</b> It must be equal to `'pipeline'`.
+* @property {string} store - The name of the store from which it takes the data. It is passed to all the stages.
+* @property {string} timestamp - The name of the datetime field. It is passed to all the stages.
+* @property {Array.<Object>} stages - The parameters of the stream aggregators in the chain, without names and input aggregators.
+* @example
+* var qm = require('qminer');
+* var base = new qm.Base({
+*   mode: 'createClean',
+*   schema: [{
+*       name: 'Heat',
+*       fields: [
+*           { name: 'Celsius', type: 'float' },
+*           { name: 'Time', type: 'datetime' }
+*       ]
+*   }]
+* });
+* var aggr = {
+*   name: 'AverageHeat',
+*   type: 'pipeline',
+*   store: 'Heat',
+*   timestamp: 'Time',
+*   stages: [
+*       { type: 'timeSeriesTick', value: 'Celsius' },
+*       { type: 'timeSeriesWinBufVector', winsize: 2000 },
+*       { type: 'ma' }
+*   ]
+* };
+* var average = base.store('Heat').addStreamAggr(aggr);
+* base.store('Heat').push({ Celsius: 20, Time: '2015-06-10T14:13:32.0' });
+* base.store('Heat').push({ Celsius: 22, Time: '2015-06-10T14:13:33.0' });
+* var value = average.getFloat(); // 21
+* base.close();
+*/
+
 /**
 * @typedef {module:qm.StreamAggr} StreamAggrTimeSeriesTick
 * This stream aggregator represents the time series tick window buffer. It exposes the data to other stream aggregators
@@ -2643,11 +2733,11 @@ public:
     uint64 GetTmMSecs() const;
 
     // IFltIO
-    void GetInValV(TFltV& ValV) const;
-    void GetOutValV(TFltV& ValV) const;
+    const TFltV& GetInValV() const;
+    const TFltV& GetOutValV() const;
     // ITmIO
-    void GetInTmMSecsV(TUInt64V& MSecsV) const;
-    void GetOutTmMSecsV(TUInt64V& MSecsV) const;
+    const TUInt64V& GetInTmMSecsV() const;
+    const TUInt64V& GetOutTmMSecsV() const;
     // in buffer
     int GetN() const;
 
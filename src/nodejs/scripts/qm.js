@@ -526,6 +526,30 @@ module.exports = exports = function (pathQmBinary) {
         nodefs.rmdirSync(dirPath);
     };
 
+    // asynchronous methods take the callback as the last argument,
+    // without it they return a promise
+    function returnPromise(proto, funNm) {
+        var asyncFun = proto[funNm];
+        proto[funNm] = function () {
+            var args = Array.prototype.slice.call(arguments);
+            if (typeof args[args.length - 1] == 'function') {
+                return asyncFun.apply(this, args);
+            }
+            var self = this;
+            return new Promise(function (resolve, reject) {
+                args.push(function (err, res) {
+                    if (err) { reject(err); } else { resolve(res); }
+                });
+                asyncFun.apply(self, args);
+            });
+        }
+    }
+
+    returnPromise(exports.Base.prototype, 'searchAsync');
+    returnPromise(exports.Store.prototype, 'pushAsync');
+    returnPromise(exports.RecSet.prototype, 'sortByFieldAsync');
+    returnPromise(exports.RecSet.prototype, 'filterByFieldAsync');
+
 	function forbidConstructor(obj) {
 		proto = obj.prototype;
 		obj = function () {throw  new Error('constructor is private, ' + obj.prototype.constructor.name +  ' is factory based.');}
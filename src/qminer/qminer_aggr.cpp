@@ -575,6 +575,22 @@ void TTimeSeriesTick::OnAddRec(const TRec& Rec, const TWPt<TStreamAggr>& CallerA
     InitP = true;
 }
 
+void TTimeSeriesTick::OnAddRecBatch(const TRecSet& RecSet, const TWPt<TStreamAggr>& CallerAggr) {
+    TScopeStopWatch StopWatch(ExeTm);
+    BatchTmMSecsV.Clr(false); BatchFltV.Clr(false);
+    for (int RecN = 0; RecN < RecSet.GetRecs(); RecN++) {
+        const TRec Rec = RecSet.GetRec(RecN);
+        BatchFltV.Add(ValReader.GetFlt(Rec));
+        BatchTmMSecsV.Add(Rec.GetFieldTmMSecs(TimeFieldId));
+    }
+    // we end up where the last record leaves us
+    if (!BatchFltV.Empty()) {
+        TickVal = BatchFltV.Last();
+        TmMSecs = BatchTmMSecsV.Last();
+        InitP = true;
+    }
+}
+
 void TTimeSeriesTick::OnTime(const uint64& Time, const TWPt<TStreamAggr>& CallerAggr) {
     TScopeStopWatch StopWatch(ExeTm);
     TmMSecs = Time;
@@ -714,6 +730,7 @@ PJsonVal TTimeSeriesSparseVectorTick::SaveJson(const int& Limit) const {
 // Numberic circular buffer
 TWinBufFltV::TWinBufFltV(const TWPt<TBase>& Base, const PJsonVal& ParamVal): TWinBufMem<TFlt>(Base, ParamVal) {
     InAggrVal = Cast<TStreamAggrOut::IFlt>(GetInAggr());
+    InAggrValBatch = Cast<TStreamAggrOut::IFltBatch>(GetInAggr(), false);
 }
 
 PStreamAggr TWinBufFltV::New(const TWPt<TBase>& Base, const PJsonVal& ParamVal) {
@@ -760,6 +777,34 @@ PJsonVal TWinBufSpV::SaveJson(const int& Limit) const {
     return ResJson;
 }
 
+///////////////////////////////
+// Dense vector circular buffer
+TWinBufDenseV::TWinBufDenseV(const TWPt<TBase>& Base, const PJsonVal& ParamVal):
+        TWinBufMem<TFltV>(Base, ParamVal) {
+    InAggrVal = Cast<TStreamAggrOut::IFltVec>(GetInAggr());
+}
+
+TFltV TWinBufDenseV::GetVal() const {
+    TFltV Res;
+    InAggrVal->GetValV(Res);
+    return Res;
+}
+
+PStreamAggr TWinBufDenseV::New(const TWPt<TBase>& Base, const PJsonVal& ParamVal) {
+    return new TWinBufDenseV(Base, ParamVal);
+}
+
+// serialization to JSon
+PJsonVal TWinBufDenseV::SaveJson(const int& Limit) const {
+    TVec<TFltV> ValV;
+    GetValV(ValV);
+    PJsonVal ResJson = TJsonVal::NewArr();
+    for (int ValN = 0; ValN < ValV.Len(); ValN++) {
+        ResJson->AddToArr(TJsonVal::NewArr(ValV[ValN]));
+    }
+    return ResJson;
+}
+
 ///////////////////////////////
 /// Time series window buffer with dense vector per record.
 TFlt TWinBufFlt::GetRecVal(const uint64& RecId) const {
@@ -818,6 +863,62 @@ void TWinBufFtrSpVec::SaveState(TSOut& SOut) const {
     FtrSpace->Save(SOut);
 }
 
+///////////////////////////////
+// Window statistics of several signals
+void TWinBufMultiStats::UpdateOutValV() {
+    switch (Output) {
+    case wmsoSum: OutValV = Stats.GetSumV(); break;
+    case wmsoMean: OutValV = Stats.GetMaV(); break;
+    case wmsoVar: Stats.GetVarV(OutValV); break;
+    case wmsoMin: Stats.GetMinV(OutValV); break;
+    case wmsoMax: Stats.GetMaxV(OutValV); break;
+    }
+}
+
+void TWinBufMultiStats::OnStep(const TWPt<TStreamAggr>& CallerAggr) {
+    TScopeStopWatch StopWatch(ExeTm);
+    if (InAggr->IsInit()) {
+        Stats.Update(InAggrValIO->GetInValV(), InAggrTmIO->GetInTmMSecsV(),
+            InAggrValIO->GetOutValV(), InAggrTmIO->GetOutTmMSecsV());
+        UpdateOutValV();
+    }
+}
+
+TWinBufMultiStats::TWinBufMultiStats(const TWPt<TBase>& Base, const PJsonVal& ParamVal):
+        TStreamAggr(Base, ParamVal) {
+
+    InAggr = ParseAggr(ParamVal, "inAggr");
+    InAggrTm = Cast<TStreamAggrOut::ITm>(InAggr);
+    InAggrTmIO = Cast<TStreamAggrOut::ITmIO>(InAggr);
+    InAggrValIO = Cast<TStreamAggrOut::IValIO<TFltV>>(InAggr);
+    // which statistic do we expose as output vector
+    const TStr OutputStr = ParamVal->GetObjStr("output", "mean");
+    if (OutputStr == "sum") { Output = wmsoSum; }
+    else if (OutputStr == "mean") { Output = wmsoMean; }
+    else if (OutputStr == "variance") { Output = wmsoVar; }
+    else if (OutputStr == "min") { Output = wmsoMin; }
+    else if (OutputStr == "max") { Output = wmsoMax; }
+    else { throw TQmExcept::New("[TWinBufMultiStats] unknown output: " + OutputStr); }
+}
+
+PStreamAggr TWinBufMultiStats::New(const TWPt<TBase>& Base, const PJsonVal& ParamVal) {
+    return new TWinBufMultiStats(Base, ParamVal);
+}
+
+PJsonVal TWinBufMultiStats::SaveJson(const int& Limit) const {
+    TFltV VarV; GetVarV(VarV);
+    TFltV MinV; GetMinV(MinV);
+    TFltV MaxV; GetMaxV(MaxV);
+    PJsonVal Val = TJsonVal::NewObj();
+    Val->AddToObj("sum", TJsonVal::NewArr(GetSumV()));
+    Val->AddToObj("mean", TJsonVal::NewArr(GetMeanV()));
+    Val->AddToObj("variance", TJsonVal::NewArr(VarV));
+    Val->AddToObj("min", TJsonVal::NewArr(MinV));
+    Val->AddToObj("max", TJsonVal::NewArr(MaxV));
+    Val->AddToObj("Time", TTm::GetTmFromMSecs(GetTmMSecs()).GetWebLogDateTimeStr(true, "T"));
+    return Val;
+}
+
 ///////////////////////////////
 // Exponential Moving Average.
 void TEma::OnStep(const TWPt<TStreamAggr>& CallerAggr) {
@@ -827,12 +928,26 @@ void TEma::OnStep(const TWPt<TStreamAggr>& CallerAggr) {
     }
 }
 
+void TEma::OnAddRecBatch(const TRecSet& RecSet, const TWPt<TStreamAggr>& CallerAggr) {
+    TScopeStopWatch StopWatch(ExeTm);
+    if (InAggr->IsInit()) {
+        const TUInt64V& BatchTmMSecsV = InAggrTmBatch->GetBatchTmMSecsV();
+        const TFltV& BatchFltV = InAggrFltBatch->GetBatchFltV();
+        QmAssertR(BatchFltV.Len() == RecSet.GetRecs(), "[TEma] input aggregate did not process the batch");
+        for (int RecN = 0; RecN < BatchFltV.Len(); RecN++) {
+            Ema.Update(BatchFltV[RecN], BatchTmMSecsV[RecN]);
+        }
+    }
+}
+
 TEma::TEma(const TWPt<TBase>& Base, const PJsonVal& ParamVal):
         TStreamAggr(Base, ParamVal), Ema(ParamVal) {
 
     InAggr = ParseAggr(ParamVal, "inAggr");
     InAggrTm = Cast<TStreamAggrOut::ITm>(InAggr);
     InAggrFlt = Cast<TStreamAggrOut::IFlt>(InAggr);
+    InAggrTmBatch = Cast<TStreamAggrOut::ITmBatch>(InAggr, false);
+    InAggrFltBatch = Cast<TStreamAggrOut::IFltBatch>(InAggr, false);
 }
 
 PStreamAggr TEma::New(const TWPt<TBase>& Base, const PJsonVal& ParamVal) {
@@ -854,6 +969,167 @@ PJsonVal TEma::SaveJson(const int& Limit) const {
     return Val;
 }
 
+///////////////////////////////
+// Fused tick and exponential moving average
+void TFusedEma::UpdateRec(const TRec& Rec) {
+    TickVal = ValReader.GetFlt(Rec);
+    InitP = true;
+    Ema.Update(TickVal, Rec.GetFieldTmMSecs(TimeFieldId));
+}
+
+void TFusedEma::OnAddRec(const TRec& Rec, const TWPt<TStreamAggr>& CallerAggr) {
+    TScopeStopWatch StopWatch(ExeTm);
+    UpdateRec(Rec);
+}
+
+void TFusedEma::OnAddRecBatch(const TRecSet& RecSet, const TWPt<TStreamAggr>& CallerAggr) {
+    TScopeStopWatch StopWatch(ExeTm);
+    for (int RecN = 0; RecN < RecSet.GetRecs(); RecN++) {
+        UpdateRec(RecSet.GetRec(RecN));
+    }
+}
+
+void TFusedEma::OnTime(const uint64& TmMsec, const TWPt<TStreamAggr>& CallerAggr) {
+    TScopeStopWatch StopWatch(ExeTm);
+    // same as ema reading the tick after it moved to the new time
+    if (InitP) { Ema.Update(TickVal, TmMsec); }
+}
+
+TFusedEma::TFusedEma(const TWPt<TBase>& Base, const PJsonVal& ParamVal, const PJsonVal& TickVal,
+        const PJsonVal& EmaVal): TStreamAggr(Base, ParamVal), Ema(EmaVal) {
+
+    // value and time fields, same as timeSeriesTick
+    TWPt<TStore> Store = Base->GetStoreByStoreNm(TickVal->GetObjStr("store"));
+    TStr TimeFieldNm = TickVal->GetObjStr("timestamp");
+    TimeFieldId = Store->GetFieldId(TimeFieldNm);
+    TStr ValFieldNm = TickVal->GetObjStr("value");
+    const int ValFieldId = Store->GetFieldId(ValFieldNm);
+    ValReader = TFieldReader(Store->GetStoreId(), ValFieldId, Store->GetFieldDesc(ValFieldId));
+    QmAssertR(Store->GetFieldDesc(TimeFieldId).IsTm(), "[Window buffer] field " + TimeFieldNm + " not of type 'datetime'");
+    QmAssertR(ValReader.IsFlt(), "[Window buffer] field " + ValFieldNm + " cannot be casted to 'double'");
+}
+
+void TFusedEma::LoadState(TSIn& SIn) {
+    InitP.Load(SIn);
+    TickVal.Load(SIn);
+    Ema.Load(SIn);
+}
+
+void TFusedEma::SaveState(TSOut& SOut) const {
+    InitP.Save(SOut);
+    TickVal.Save(SOut);
+    Ema.Save(SOut);
+}
+
+PJsonVal TFusedEma::SaveJson(const int& Limit) const {
+    PJsonVal Val = TJsonVal::NewObj();
+    Val->AddToObj("Val", Ema.GetValue());
+    Val->AddToObj("Time", TTm::GetTmFromMSecs(Ema.GetTmMSecs()).GetWebLogDateTimeStr(true, "T"));
+    return Val;
+}
+
+///////////////////////////////
+// Pipeline of stream aggregates
+bool TPipeline::IsFusable(const PJsonVal& StageVal) {
+    // stages reading from other aggregates or updating on time need the graph
+    return !StageVal->IsObjKey("inAggr") && !StageVal->IsObjKey("inAggrTm") &&
+        StageVal->GetObjStr("update", "onNewRecord") == "onNewRecord";
+}
+
+PJsonVal TPipeline::GetStageVal(const PJsonVal& ParamVal, const PJsonVal& StageVal,
+        const TStr& AggrNm, const TStr& InAggrNm) {
+
+    QmAssertR(StageVal->IsObj(), "[TPipeline] stage must be an object");
+    PJsonVal ResVal = TJsonVal::NewObj();
+    // parameters shared by all stages
+    if (ParamVal->IsObjKey("store")) { ResVal->AddToObj("store", ParamVal->GetObjKey("store")); }
+    if (ParamVal->IsObjKey("timestamp")) { ResVal->AddToObj("timestamp", ParamVal->GetObjKey("timestamp")); }
+    if (!InAggrNm.Empty()) { ResVal->AddToObj("inAggr", InAggrNm); }
+    // stage parameters can override the shared ones
+    for (int KeyN = 0; KeyN < StageVal->GetObjKeys(); KeyN++) {
+        TStr KeyNm; PJsonVal KeyVal; StageVal->GetObjKeyVal(KeyN, KeyNm, KeyVal);
+        ResVal->AddToObj(KeyNm, KeyVal);
+    }
+    ResVal->AddToObj("name", AggrNm);
+    return ResVal;
+}
+
+PStreamAggr TPipeline::NewFused(const TWPt<TBase>& Base, const PJsonVal& ParamVal, const TJsonValV& StageValV) {
+    const TStr TickType = StageValV[0]->GetObjStr("type", "");
+    if (TickType != TTimeSeriesTick::GetType()) { return NULL; }
+    // tick followed by ema
+    if (StageValV.Len() == 2 && StageValV[1]->GetObjStr("type", "") == TEma::GetType()) {
+        return new TFusedEma(Base, ParamVal, StageValV[0], StageValV[1]);
+    }
+    // tick followed by window buffer and window aggregate
+    if (StageValV.Len() == 3 && StageValV[1]->GetObjStr("type", "") == TWinBufFltV::GetType()) {
+        const TStr AggrType = StageValV[2]->GetObjStr("type", "");
+        if (AggrType == TMa::GetType()) {
+            return new TFusedWinAggr<TSignalProc::TMa>(Base, ParamVal, StageValV[0], StageValV[1]);
+        } else if (AggrType == TVar::GetType()) {
+            return new TFusedWinAggr<TSignalProc::TVar>(Base, ParamVal, StageValV[0], StageValV[1]);
+        } else if (AggrType == TWinBufSum::GetType()) {
+            return new TFusedWinAggr<TSignalProc::TSum>(Base, ParamVal, StageValV[0], StageValV[1]);
+        } else if (AggrType == TWinBufMin::GetType()) {
+            return new TFusedWinAggr<TSignalProc::TMin>(Base, ParamVal, StageValV[0], StageValV[1]);
+        } else if (AggrType == TWinBufMax::GetType()) {
+            return new TFusedWinAggr<TSignalProc::TMax>(Base, ParamVal, StageValV[0], StageValV[1]);
+        }
+    }
+    // unknown chain
+    return NULL;
+}
+
+PStreamAggr TPipeline::New(const TWPt<TBase>& Base, const PJsonVal& ParamVal) {
+    QmAssertR(ParamVal->IsObjKey("stages"), "[TPipeline] missing parameter 'stages'");
+    PJsonVal StagesVal = ParamVal->GetObjKey("stages");
+    QmAssertR(StagesVal->IsArr() && StagesVal->GetArrVals() > 0, "[TPipeline] 'stages' must be a non-empty array");
+    const TStr AggrNm = ParamVal->GetObjStr("name", TGuid::GenSafeGuid());
+    // prepare parameters of each stage, reading from the previous stage
+    TJsonValV StageValV; bool FusableP = true;
+    for (int StageN = 0; StageN < StagesVal->GetArrVals(); StageN++) {
+        PJsonVal StageVal = StagesVal->GetArrVal(StageN);
+        const bool LastP = (StageN + 1 == StagesVal->GetArrVals());
+        const TStr StageNm = LastP ? AggrNm : TStr::Fmt("%s_%d", AggrNm.CStr(), StageN);
+        const TStr InAggrNm = (StageN > 0) ? StageValV.Last()->GetObjStr("name") : TStr();
+        if (StageN > 0) { FusableP = FusableP && IsFusable(StageVal); }
+        StageValV.Add(GetStageVal(ParamVal, StageVal, StageNm, InAggrNm));
+    }
+    // known chains become one aggregate
+    if (FusableP) {
+        PStreamAggr FusedAggr = NewFused(Base, StageValV.Last(), StageValV);
+        if (!FusedAggr.Empty()) { return FusedAggr; }
+    }
+    // otherwise we fall back to separate aggregates, first making sure we can create all of them
+    for (const PJsonVal& StageVal : StageValV) {
+        const TStr StageType = StageVal->GetObjStr("type");
+        QmAssertR(TStreamAggr::IsType(StageType), "[TPipeline] unknown stream aggregate type " + StageType);
+    }
+    // the last one is added by the caller, stages read from previous ones by name so
+    // they are registered as we go and removed again when any of the later ones fails
+    TStrV StageNmV; TIntV StageStoreIdV;
+    try {
+        for (int StageN = 0; StageN + 1 < StageValV.Len(); StageN++) {
+            const PJsonVal& StageVal = StageValV[StageN];
+            const int StoreId = StageVal->IsObjKey("store") ?
+                (int)Base->GetStoreByStoreNm(StageVal->GetObjStr("store"))->GetStoreId() : -1;
+            PStreamAggr StageAggr = TStreamAggr::New(Base, StageVal->GetObjStr("type"), StageVal);
+            Base->AddStreamAggr(StageAggr);
+            StageNmV.Add(StageAggr->GetAggrNm()); StageStoreIdV.Add(StoreId);
+            if (StoreId != -1) { Base->GetStreamAggrSet((uint)StoreId)->AddStreamAggr(StageAggr); }
+        }
+        return TStreamAggr::New(Base, StageValV.Last()->GetObjStr("type"), StageValV.Last());
+    } catch (...) {
+        for (int StageN = StageNmV.Len() - 1; StageN >= 0; StageN--) {
+            if (StageStoreIdV[StageN] != -1) {
+                Base->GetStreamAggrSet((uint)StageStoreIdV[StageN])->DelStreamAggr(StageNmV[StageN]);
+            }
+            Base->DelStreamAggr(StageNmV[StageN]);
+        }
+        throw;
+    }
+}
+
 ///////////////////////////////
 // Exponential Moving Average for sparse vectors
 void TEmaSpVec::OnStep(const TWPt<TStreamAggr>& CallerAggr) {
@@ -898,6 +1174,10 @@ void TThresholdAggr::OnStep(const TWPt<TStreamAggr>& CallerAggr) {
     }
 }
 
+void TThresholdAggr::OnAddRecBatch(const TRecSet& RecSet, const TWPt<TStreamAggr>& CallerAggr) {
+    if (!RecSet.Empty()) { OnStep(CallerAggr); }
+}
+
 TThresholdAggr::TThresholdAggr(const TWPt<TBase>& Base, const PJsonVal& ParamVal): TStreamAggr(Base, ParamVal) {
     // parse input aggregate
     InAggr = ParseAggr(ParamVal, "inAggr");
@@ -944,17 +1224,32 @@ void TCov::OnStep(const TWPt<TStreamAggr>& CallerAggr) {
     TScopeStopWatch StopWatch(ExeTm);
     if (InAggrX->IsInit() && InAggrY->IsInit()) {
         // new series
-        TFltV InValVX; InAggrFltIOX->GetInValV(InValVX);
-        TFltV InValVY; InAggrFltIOY->GetInValV(InValVY);
-        TUInt64V InTmMSecsV; InAggrTmIOX->GetInTmMSecsV(InTmMSecsV);
+        const TFltV& InValVX = InAggrFltIOX->GetInValV();
+        const TFltV& InValVY = InAggrFltIOY->GetInValV();
+        const TUInt64V& InTmMSecsV = InAggrTmIOX->GetInTmMSecsV();
         // delete series
-        TFltV OutValVX; InAggrFltIOX->GetOutValV(OutValVX);
-        TFltV OutValVY; InAggrFltIOY->GetOutValV(OutValVY);
-        TUInt64V OutTmMSecsV; InAggrTmIOX->GetOutTmMSecsV(OutTmMSecsV);
+        const TFltV& OutValVX = InAggrFltIOX->GetOutValV();
+        const TFltV& OutValVY = InAggrFltIOY->GetOutValV();
+        const TUInt64V& OutTmMSecsV = InAggrTmIOX->GetOutTmMSecsV();
         Cov.Update(InValVX, InValVY, InTmMSecsV, OutValVX, OutValVY, OutTmMSecsV);
     }
 }
 
+void TCov::OnAddRecBatch(const TRecSet& RecSet, const TWPt<TStreamAggr>& CallerAggr) {
+    TScopeStopWatch StopWatch(ExeTm);
+    if (InAggrX->IsInit() && InAggrY->IsInit()) {
+        // same as OnStep for each record, the step vectors share memory with the inputs
+        const TStreamAggrOut::TValIOBatch<TFlt>& IOBatchX = InAggrFltIOBatchX->GetValIOBatch();
+        const TStreamAggrOut::TValIOBatch<TFlt>& IOBatchY = InAggrFltIOBatchY->GetValIOBatch();
+        QmAssertR(IOBatchX.GetSteps() == RecSet.GetRecs() && IOBatchY.GetSteps() == RecSet.GetRecs(),
+            "[TCov] input aggregates did not process the batch");
+        for (int RecN = 0; RecN < RecSet.GetRecs(); RecN++) {
+            Cov.Update(IOBatchX.GetInValV(RecN), IOBatchY.GetInValV(RecN), IOBatchX.GetInTmMSecsV(RecN),
+                IOBatchX.GetOutValV(RecN), IOBatchY.GetOutValV(RecN), IOBatchX.GetOutTmMSecsV(RecN));
+        }
+    }
+}
+
 TCov::TCov(const TWPt<TBase>& Base, const PJsonVal& ParamVal): TStreamAggr(Base, ParamVal) {
     InAggrX = ParseAggr(ParamVal, "inAggrX");
     InAggrTmIOX = Cast<TStreamAggrOut::ITmIO>(InAggrX);
@@ -962,6 +1257,8 @@ TCov::TCov(const TWPt<TBase>& Base, const PJsonVal& ParamVal): TStreamAggr(Base,
     InAggrY = ParseAggr(ParamVal, "inAggrY");
     InAggrTmIOY = Cast<TStreamAggrOut::ITmIO>(InAggrY);
     InAggrFltIOY = Cast<TStreamAggrOut::IFltIO>(InAggrY);
+    InAggrFltIOBatchX = Cast<TStreamAggrOut::IFltIOBatch>(InAggrX, false);
+    InAggrFltIOBatchY = Cast<TStreamAggrOut::IFltIOBatch>(InAggrY, false);
 }
 
 void TCov::LoadState(TSIn& SIn) {
@@ -1003,6 +1300,10 @@ void TCorr::OnStep(const TWPt<TStreamAggr>& CallerAggr) {
     TmMSecs = InAggrTmCov->GetTmMSecs();
 }
 
+void TCorr::OnAddRecBatch(const TRecSet& RecSet, const TWPt<TStreamAggr>& CallerAggr) {
+    if (!RecSet.Empty()) { OnStep(CallerAggr); }
+}
+
 TCorr::TCorr(const TWPt<TBase>& Base, const PJsonVal& ParamVal): TStreamAggr(Base, ParamVal) {
     // covariance cast
     InAggrCov = ParseAggr(ParamVal, "inAggrCov");
@@ -2061,11 +2362,11 @@ PJsonVal TNNAnomalyAggr::SaveJson(const int& Limit) const {
 void TOnlineHistogram::OnStep(const TWPt<TStreamAggr>& CallerAggr) {
     TScopeStopWatch StopWatch(ExeTm);
     if (BufferedP) {
-        TFltV UpdateV; InAggrFltIO->GetInValV(UpdateV);
+        const TFltV& UpdateV = InAggrFltIO->GetInValV();
         for (int ElN = 0; ElN < UpdateV.Len(); ElN++) {
             Model.Increment(UpdateV[ElN]);
         }
-        TFltV ForgetV; InAggrFltIO->GetOutValV(ForgetV);
+        const TFltV& ForgetV = InAggrFltIO->GetOutValV();
         for (int ElN = 0; ElN < ForgetV.Len(); ElN++) {
             Model.Decrement(ForgetV[ElN]);
         }
@@ -2209,16 +2510,16 @@ void TOnlineSlottedHistogram::OnStep(const TWPt<TStreamAggr>& CallerAggr) {
     TScopeStopWatch StopWatch(ExeTm);
     if (BufferedP) {
         // add new values
-        TFltV InValV; InAggrFltIO->GetInValV(InValV);
-        TUInt64V InTmMSecsV; InAggrTmIO->GetInTmMSecsV(InTmMSecsV);
+        const TFltV& InValV = InAggrFltIO->GetInValV();
+        const TUInt64V& InTmMSecsV = InAggrTmIO->GetInTmMSecsV();
         for (int ElN = 0; ElN < InValV.Len(); ElN++) {
             Model.Add(InTmMSecsV[ElN], (int)InValV[ElN]);
         }
         // update time stamp
         if (!InTmMSecsV.Empty()) { LastTm = InTmMSecsV.Last(); }
         // remove old values
-        TFltV OutValV; InAggrFltIO->GetOutValV(OutValV);
-        TUInt64V OutTmMSecsV; InAggrTmIO->GetOutTmMSecsV(OutTmMSecsV);
+        const TFltV& OutValV = InAggrFltIO->GetOutValV();
+        const TUInt64V& OutTmMSecsV = InAggrTmIO->GetOutTmMSecsV();
         for (int ElN = 0; ElN < OutValV.Len(); ElN++) {
             Model.Remove(OutTmMSecsV[ElN], (int)OutValV[ElN]);
         }
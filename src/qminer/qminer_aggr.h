@@ -258,7 +258,9 @@ public:
 /// Wrapper for exposing time series to signal processing aggregates
 class TTimeSeriesTick : public TStreamAggr,
                         public TStreamAggrOut::ITm,
-                        public TStreamAggrOut::IFlt {
+                        public TStreamAggrOut::IFlt,
+                        public TStreamAggrOut::ITmBatch,
+                        public TStreamAggrOut::IFltBatch {
 private:
     /// ID of the field from which we collect time points
     TInt TimeFieldId;
@@ -272,9 +274,16 @@ private:
     /// Last extracted value
     TFlt TickVal;
 
+    /// Timestamps extracted from the last batch
+    TUInt64V BatchTmMSecsV;
+    /// Values extracted from the last batch
+    TFltV BatchFltV;
+
 protected:
     /// On new record we update value and timestamp
     void OnAddRec(const TRec& Rec, const TWPt<TStreamAggr>& CallerAggr);
+    /// On new batch we extract value and timestamp of each record
+    void OnAddRecBatch(const TRecSet& RecSet, const TWPt<TStreamAggr>& CallerAggr);
     /// On new timestamp we update timestamp
     void OnTime(const uint64& TmMsec, const TWPt<TStreamAggr>& CallerAggr);
     /// No on step supported
@@ -301,6 +310,13 @@ public:
     /// Last extracted value
     double GetFlt() const { return TickVal; }
 
+    /// Batches only read records
+    bool IsBatch() const { return true; }
+    /// Timestamp of each record from the last batch
+    const TUInt64V& GetBatchTmMSecsV() const { return BatchTmMSecsV; }
+    /// Value of each record from the last batch
+    const TFltV& GetBatchFltV() const { return BatchFltV; }
+
     // serialization to JSon
     PJsonVal SaveJson(const int& Limit) const;
 
@@ -379,6 +395,7 @@ class TWinBufMem : public TStreamAggr,
                    public TStreamAggrOut::ITm,
                    public TStreamAggrOut::ITmIO,
                    public TStreamAggrOut::IValIO<TVal>,
+                   public TStreamAggrOut::IValIOBatch<TVal>,
                    public TStreamAggrOut::ITmVec,
                    public TStreamAggrOut::IValVec<TVal> {
 private:
@@ -389,6 +406,8 @@ private:
     TWPt<TStreamAggr> InAggr;
     /// Input timestamp interface
     TWPt<TStreamAggrOut::ITm> InAggrTm;
+    /// Input timestamps from the last batch, empty when not provided
+    TWPt<TStreamAggrOut::ITmBatch> InAggrTmBatch;
 
     /// When should we read values from incoming aggregate
     TWinBufMemUpdate UpdateType;
@@ -414,16 +433,26 @@ private:
     TVec<TVal> OutValV;
     /// Timestamps for forgoten values
     TUInt64V OutTmMSecsV;
+    /// New and forgoten values for each record of the last batch
+    TStreamAggrOut::TValIOBatch<TVal> IOBatch;
 
 protected:
     /// Value getter, must be overridden
     virtual TVal GetVal() const = 0;
+    /// Does the input aggregate provide a value for each record of a batch
+    virtual bool IsBatchVal() const { return false; }
+    /// Value for record RecN of the last batch, must be overridden when IsBatchVal
+    virtual TVal GetBatchVal(const int& RecN) const { throw TQmExcept::New("[TWinBufMem] batch values not supported"); }
 
 private:
     /// Read new value from the input aggregate and adds it to the delay
-    void UpdateVal();
-     /// Read new timestamp from the input aggregate and move aggregates accordingly
-    void UpdateTime();
+    void UpdateVal() { UpdateVal(InAggrTm->GetTmMSecs(), GetVal()); }
+    /// Adds new value with given timestamp to the delay
+    void UpdateVal(const uint64& ValTmMSecs, const TVal& Val);
+    /// Read new timestamp from the input aggregate and move aggregates accordingly
+    void UpdateTime() { UpdateTime(InAggrTm->GetTmMSecs()); }
+    /// Move aggregates according to the new timestamp
+    void UpdateTime(const uint64& NewTmMSecs);
 
 protected:
     /// Get input aggregate
@@ -431,6 +460,8 @@ protected:
 
     /// Stream aggregate update function called when a record is added
     void OnAddRec(const TRec& Rec, const TWPt<TStreamAggr>& CallerAggr);
+    /// Stream aggregate update function called when a batch of records is added
+    void OnAddRecBatch(const TRecSet& RecSet, const TWPt<TStreamAggr>& CallerAggr);
     /// Stream aggregate that forgets records when time is updated
     void OnTime(const uint64& TmMsec, const TWPt<TStreamAggr>& CallerAggr);
     /// Just a expection-throwing placeholder
@@ -455,15 +486,21 @@ public:
 
     // IValIO
     /// new values that just entered the buffer (needed if delay is nonzero)
-    void GetInValV(TVec<TVal>& ValV) const { ValV = InValV; }
+    const TVec<TVal>& GetInValV() const { return InValV; }
     /// old values that fall out of the buffer
-    void GetOutValV(TVec<TVal>& ValV) const { ValV = OutValV; }
+    const TVec<TVal>& GetOutValV() const { return OutValV; }
 
     // ITmIO
     /// new timestamps that just entered the buffer (needed if delay is nonzero)
-    void GetInTmMSecsV(TUInt64V& MSecsV) const { MSecsV = InTmMSecsV; }
+    const TUInt64V& GetInTmMSecsV() const { return InTmMSecsV; }
     /// old timestamps that fall out of the buffer
-    void GetOutTmMSecsV(TUInt64V& MSecsV) const { MSecsV = OutTmMSecsV; }
+    const TUInt64V& GetOutTmMSecsV() const { return OutTmMSecsV; }
+
+    // IValIOBatch
+    /// batches need timestamps and values of each record from the input aggregate
+    bool IsBatch() const { return !InAggrTmBatch.Empty() && IsBatchVal(); }
+    /// new and old values for each record of the last batch
+    const TStreamAggrOut::TValIOBatch<TVal>& GetValIOBatch() const { return IOBatch; }
 
     // IValV
     /// get buffer length
@@ -481,6 +518,8 @@ public:
     /// get timestamp vector of all timestamps in the buffer (ITmVec interface)
     void GetTmV(TUInt64V& MSecsV) const;
 
+    /// Get list of input aggregates
+    void GetInAggrNmV(TStrV& InAggrNmV) const { InAggrNmV.Add(InAggr->GetAggrNm()); }
     /// serialization to JSon
     PJsonVal SaveJson(const int& Limit) const;
 };
@@ -493,10 +532,16 @@ class TWinBufFltV : public TWinBufMem<TFlt> {
 private:
     /// Input time series aggregate
     TWPt<TStreamAggrOut::IFlt> InAggrVal;
+    /// Input values from the last batch, empty when not provided
+    TWPt<TStreamAggrOut::IFltBatch> InAggrValBatch;
 
 protected:
     /// Value getter, we read float from input aggregate
     TFlt GetVal() const { return InAggrVal->GetFlt(); }
+    /// Batches need input aggregate with values for each record
+    bool IsBatchVal() const { return !InAggrValBatch.Empty(); }
+    /// Value getter for batches, we read float from input aggregate
+    TFlt GetBatchVal(const int& RecN) const { return InAggrValBatch->GetBatchFltV()[RecN]; }
     /// Json constructor
     TWinBufFltV(const TWPt<TBase>& Base, const PJsonVal& ParamVal);
 
@@ -539,6 +584,33 @@ public:
     TStr Type() const { return GetType(); }
 };
 
+///////////////////////////////
+/// Dense vector circular buffer.
+/// Reads dense vectors (e.g. from a feature space aggregate) and stores them
+/// in memory as a circular buffer, one vector per record.
+class TWinBufDenseV : public TWinBufMem<TFltV> {
+private:
+    /// Input vector aggregate
+    TWPt<TStreamAggrOut::IFltVec> InAggrVal;
+
+protected:
+    /// Json constructor
+    TWinBufDenseV(const TWPt<TBase>& Base, const PJsonVal& ParamVal);
+    /// Value getter, we read vector from input aggregate
+    TFltV GetVal() const;
+
+public:
+    /// Json constructor
+    static PStreamAggr New(const TWPt<TBase>& Base, const PJsonVal& ParamVal);
+    /// Serialization to JSon
+    PJsonVal SaveJson(const int& Limit) const;
+
+    /// Stream aggregator type name
+    static TStr GetType() { return "denseVectorWindow"; }
+    /// Stream aggregator type name
+    TStr Type() const { return GetType(); }
+};
+
 ///////////////////////////////
 // Time series window buffer.
 // Wrapper for exposing a window in a time series to signal processing aggregates
@@ -565,6 +637,7 @@ class TWinBuf : public TStreamAggr,
                 public TStreamAggrOut::ITm,
                 public TStreamAggrOut::ITmIO,
                 public TStreamAggrOut::IValIO<TVal>,
+                public TStreamAggrOut::IValIOBatch<TVal>,
                 public TStreamAggrOut::ITmVec,
                 public TStreamAggrOut::IValVec<TVal> {
 protected:
@@ -601,9 +674,35 @@ private:
     TUInt64 D;
     /// last timestamp
     TUInt64 Timestamp;
+    /// New and forgoten values for each record of the last batch
+    TStreamAggrOut::TValIOBatch<TVal> IOBatch;
+
+    /// Values of the update interval, read from the store when first asked for
+    mutable TVec<TVal> InValV;
+    /// Timestamps of the update interval
+    mutable TUInt64V InTmMSecsV;
+    /// Values of the forget interval, read from the store when first asked for
+    mutable TVec<TVal> OutValV;
+    /// Timestamps of the forget interval
+    mutable TUInt64V OutTmMSecsV;
+    /// Were the update interval values read since the intervals last moved
+    mutable TBool InReadP;
+    /// Were the forget interval values read since the intervals last moved
+    mutable TBool OutReadP;
+    /// Consumers of the buffer can ask for in/out values from several threads
+    mutable TCriticalSection ReadLock;
+
+    /// Move the intervals according to the new timestamp
+    void UpdateTime(const uint64& TmMsec);
+    /// Read values and timestamps of the update interval, unless already read
+    void ReadIn() const;
+    /// Read values and timestamps of the forget interval, unless already read
+    void ReadOut() const;
 protected:
     /// Stream aggregate update function called when a record is added
     void OnAddRec(const TRec& Rec, const TWPt<TStreamAggr>& CallerAggr);
+    /// Stream aggregate update function called when a batch of records is added
+    void OnAddRecBatch(const TRecSet& RecSet, const TWPt<TStreamAggr>& CallerAggr);
     /// Stream aggregate that forgets records when time is updated
     void OnTime(const uint64& TmMsec, const TWPt<TStreamAggr>& CallerAggr);
     /// Just a expection-throwing placeholder
@@ -630,15 +729,21 @@ public:
 
     // ITmIO
     /// new timestamps that just entered the buffer (needed if delay is nonzero)
-    void GetInTmMSecsV(TUInt64V& MSecsV) const;
+    const TUInt64V& GetInTmMSecsV() const { ReadIn(); return InTmMSecsV; }
     /// old timestamps that fall out of the buffer
-    void GetOutTmMSecsV(TUInt64V& MSecsV) const;
+    const TUInt64V& GetOutTmMSecsV() const { ReadOut(); return OutTmMSecsV; }
 
     // IValIO
     /// new values that just entered the buffer (needed if delay is nonzero)
-    void GetInValV(TVec<TVal>& ValV) const;
+    const TVec<TVal>& GetInValV() const { ReadIn(); return InValV; }
     /// old values that fall out of the buffer
-    void GetOutValV(TVec<TVal>& ValV) const;
+    const TVec<TVal>& GetOutValV() const { ReadOut(); return OutValV; }
+
+    // IValIOBatch
+    /// batches only read records
+    bool IsBatch() const { return true; }
+    /// new and old values for each record of the last batch
+    const TStreamAggrOut::TValIOBatch<TVal>& GetValIOBatch() const { return IOBatch; }
 
     // IValV
     /// get buffer length
@@ -741,6 +846,9 @@ public:
     /// Stream aggregator type name
     TStr Type(void) const { return GetType(); }
 
+    /// Feature vectors are extracted only when read, not for each record of a batch
+    bool IsBatch() const { return false; }
+
     /// Get feature space used by the aggregate
     PFtrSpace GetFtrSpace() const { return FtrSpace; }
 };
@@ -760,6 +868,8 @@ private:
     TWPt<TStreamAggrOut::ITmIO> InAggrTmIO;
     /// Input time series
     TWPt<TStreamAggrOut::IFltIO> InAggrFltIO;
+    /// Input changes from the last batch, empty when not provided
+    TWPt<TStreamAggrOut::IFltIOBatch> InAggrFltIOBatch;
 
     /// signal we are maintaining on the stream
     TSignalType Signal;
@@ -767,6 +877,8 @@ private:
 protected:
     /// Update signal based on the changes from the input
     void OnStep(const TWPt<TStreamAggr>& CallerAggr);
+    /// Update signal based on the changes from the input at each record of the batch
+    void OnAddRecBatch(const TRecSet& RecSet, const TWPt<TStreamAggr>& CallerAggr);
     /// Json constructor
     TWinAggr(const TWPt<TBase>& Base, const PJsonVal& ParamVal);
 
@@ -788,6 +900,8 @@ public:
     double GetFlt() const { return Signal.GetValue(); }
     /// Get latest time stamp
     uint64 GetTmMSecs() const { return InAggrTm->GetTmMSecs(); }
+    /// Batches need input with changes for each record
+    bool IsBatch() const { return !InAggrFltIOBatch.Empty(); }
 
     /// Get list of input aggregates
     void GetInAggrNmV(TStrV& InAggrNmV) const { InAggrNmV.Add(InAggr->GetAggrNm()); }
@@ -891,6 +1005,90 @@ public:
 typedef TWinAggrSpVec<TSignalProc::TSumSpVec> TWinBufSpVecSum;
 template <> inline TStr TWinAggrSpVec<TSignalProc::TSumSpVec>::GetType() { return "winBufSpVecSum"; }
 
+///////////////////////////////
+/// Window sum, mean, variance, min and max of several signals.
+/// Reads vectors entering and leaving a dense vector window (TWinBufDenseV)
+/// and updates statistics of all channels together. The output vector holds
+/// the statistic selected with `output` parameter, SaveJson returns all of them.
+class TWinBufMultiStats : public TStreamAggr,
+                          public TStreamAggrOut::ITm,
+                          public TStreamAggrOut::IFltVec {
+private:
+    typedef enum { wmsoSum, wmsoMean, wmsoVar, wmsoMin, wmsoMax } TWinMultiStatsOutput;
+
+private:
+    /// Input aggregate
+    TWPt<TStreamAggr> InAggr;
+    /// Input latest timestamp
+    TWPt<TStreamAggrOut::ITm> InAggrTm;
+    /// Input timestamps entering and leaving the window
+    TWPt<TStreamAggrOut::ITmIO> InAggrTmIO;
+    /// Input vectors entering and leaving the window
+    TWPt<TStreamAggrOut::IValIO<TFltV>> InAggrValIO;
+
+    /// Which statistic is the output vector
+    TWinMultiStatsOutput Output;
+    /// Statistics of all channels
+    TSignalProc::TMultiWinStats Stats;
+    /// Current output vector
+    TFltV OutValV;
+
+    /// Copy selected statistic to the output vector
+    void UpdateOutValV();
+
+protected:
+    /// Update stream aggregate
+    void OnStep(const TWPt<TStreamAggr>& CallerAggr);
+    /// Json constructor
+    TWinBufMultiStats(const TWPt<TBase>& Base, const PJsonVal& ParamVal);
+
+public:
+    /// Json constructor
+    static PStreamAggr New(const TWPt<TBase>& Base, const PJsonVal& ParamVal);
+
+    /// Load stream aggregate state from stream
+    void LoadState(TSIn& SIn) { Stats.Load(SIn); UpdateOutValV(); }
+    /// Save state of stream aggregate to stream
+    void SaveState(TSOut& SOut) const { Stats.Save(SOut); }
+
+    /// Did we finished initialization
+    bool IsInit() const { return Stats.IsInit(); }
+    /// Resets the aggregate
+    void Reset() { Stats.Reset(); UpdateOutValV(); }
+
+    // IFltVec
+    /// Number of channels
+    int GetVals() const { return OutValV.Len(); }
+    /// Selected statistic of ElN-th channel
+    void GetVal(const int& ElN, TFlt& Val) const { Val = OutValV[ElN]; }
+    /// Selected statistic of all channels
+    void GetValV(TFltV& ValV) const { ValV = OutValV; }
+    // ITm
+    /// Get latest timestamp
+    uint64 GetTmMSecs() const { return Stats.GetTmMSecs(); }
+
+    /// Sums of all channels
+    const TFltV& GetSumV() const { return Stats.GetSumV(); }
+    /// Means of all channels
+    const TFltV& GetMeanV() const { return Stats.GetMaV(); }
+    /// Variances of all channels
+    void GetVarV(TFltV& VarV) const { Stats.GetVarV(VarV); }
+    /// Minimums of all channels
+    void GetMinV(TFltV& MinV) const { Stats.GetMinV(MinV); }
+    /// Maximums of all channels
+    void GetMaxV(TFltV& MaxV) const { Stats.GetMaxV(MaxV); }
+
+    /// Get list of input aggregates
+    void GetInAggrNmV(TStrV& InAggrNmV) const { InAggrNmV.Add(InAggr->GetAggrNm()); }
+    /// Serialization to JSon
+    PJsonVal SaveJson(const int& Limit) const;
+
+    /// Stream aggregator type name
+    static TStr GetType() { return "winBufMultiStats"; }
+    /// Stream aggregator type name
+    TStr Type() const { return GetType(); }
+};
+
 ///////////////////////////////
 // Exponential Moving Average.
 class TEma : public TStreamAggr,
@@ -903,6 +1101,10 @@ private:
     TWPt<TStreamAggrOut::ITm> InAggrTm;
     /// Input aggregate casted to time series
     TWPt<TStreamAggrOut::IFlt> InAggrFlt;
+    /// Input timestamps from the last batch, empty when not provided
+    TWPt<TStreamAggrOut::ITmBatch> InAggrTmBatch;
+    /// Input values from the last batch, empty when not provided
+    TWPt<TStreamAggrOut::IFltBatch> InAggrFltBatch;
 
     /// EMA indicator
     TSignalProc::TEma Ema;
@@ -910,6 +1112,8 @@ private:
 protected:
     /// Update EMA
     void OnStep(const TWPt<TStreamAggr>& CallerAggr);
+    /// Update EMA with the input at each record of the batch
+    void OnAddRecBatch(const TRecSet& RecSet, const TWPt<TStreamAggr>& CallerAggr);
 
     /// Json constructor
     TEma(const TWPt<TBase>& Base, const PJsonVal& ParamVal);
@@ -926,6 +1130,8 @@ public:
     bool IsInit() const { return Ema.IsInit(); }
     /// Resets the aggregate
     void Reset() { Ema.Reset(); }
+    /// Batches need input with values and timestamps for each record
+    bool IsBatch() const { return !InAggrTmBatch.Empty() && !InAggrFltBatch.Empty(); }
     /// Latest value
     double GetFlt() const { return Ema.GetValue(); }
     /// Timestamp of the latest value
@@ -942,6 +1148,184 @@ public:
     TStr Type() const { return GetType(); }
 };
 
+///////////////////////////////
+/// Fused chain of time series tick, window buffer and window aggregate.
+/// Reads value and timestamp directly from records and keeps its own window,
+/// so the signal is updated in one pass without intermediate aggregates and
+/// virtual calls. Results are the same as from the chain timeSeriesTick ->
+/// timeSeriesWinBufVector -> TWinAggr<TSignalType>. Created by TPipeline.
+template <class TSignalType>
+class TFusedWinAggr : public TStreamAggr,
+                      public TStreamAggrOut::ITm,
+                      public TStreamAggrOut::IFlt {
+private:
+    /// ID of the field from which we collect time points
+    TInt TimeFieldId;
+    /// Reader for extracting numeric values from records
+    TFieldReader ValReader;
+    /// Window size in milliseconds
+    TUInt64 WinSizeMSecs;
+    /// Delay in milliseconds
+    TUInt64 DelayMSecs;
+
+    /// Did we read at least one value
+    TBool InitP;
+    /// Current timestamp
+    TUInt64 TmMSecs;
+    /// Current window buffer
+    TQQueue<TUInt64FltPr> WindowQ;
+    /// Current delay buffer
+    TQQueue<TUInt64FltPr> DelayQ;
+
+    /// New values from last update
+    TFltV InValV;
+    /// Timestamps for new values
+    TUInt64V InTmMSecsV;
+    /// Forgoten values from last update
+    TFltV OutValV;
+    /// Timestamps for forgoten values
+    TUInt64V OutTmMSecsV;
+
+    /// Signal we are maintaining on the stream
+    TSignalType Signal;
+
+    /// Move values through delay and window and update the signal, same as TWinBufMem and TWinAggr
+    void UpdateTime(const uint64& NewTmMSecs);
+    /// Read value and timestamp from the record and update the signal
+    void UpdateRec(const TRec& Rec);
+
+protected:
+    /// Update signal with the new record
+    void OnAddRec(const TRec& Rec, const TWPt<TStreamAggr>& CallerAggr);
+    /// Update signal with each record of the batch
+    void OnAddRecBatch(const TRecSet& RecSet, const TWPt<TStreamAggr>& CallerAggr);
+    /// Forget values that fall out of the window at the new time
+    void OnTime(const uint64& TmMsec, const TWPt<TStreamAggr>& CallerAggr);
+
+public:
+    /// Constructor from pipeline parameters and parameters of the tick and window buffer stages
+    TFusedWinAggr(const TWPt<TBase>& Base, const PJsonVal& ParamVal,
+        const PJsonVal& TickVal, const PJsonVal& WinBufVal);
+
+    /// Load stream aggregate state from stream
+    void LoadState(TSIn& SIn);
+    /// Save state of stream aggregate to stream
+    void SaveState(TSOut& SOut) const;
+
+    /// Did we finished initialization
+    bool IsInit() const { return Signal.IsInit(); }
+    /// Resets the aggregate
+    void Reset();
+    /// Get current signal value
+    double GetFlt() const { return Signal.GetValue(); }
+    /// Get latest time stamp
+    uint64 GetTmMSecs() const { return TmMSecs; }
+    /// Batches only read records
+    bool IsBatch() const { return true; }
+
+    /// Serialization to json
+    PJsonVal SaveJson(const int& Limit) const;
+
+    /// Stream aggregator type name
+    static TStr GetType();
+    /// Stream aggregator type name
+    TStr Type() const { return GetType(); }
+};
+
+template <> inline TStr TFusedWinAggr<TSignalProc::TSum>::GetType() { return "fusedWinBufSum"; }
+template <> inline TStr TFusedWinAggr<TSignalProc::TMin>::GetType() { return "fusedWinBufMin"; }
+template <> inline TStr TFusedWinAggr<TSignalProc::TMax>::GetType() { return "fusedWinBufMax"; }
+template <> inline TStr TFusedWinAggr<TSignalProc::TMa>::GetType() { return "fusedMa"; }
+template <> inline TStr TFusedWinAggr<TSignalProc::TVar>::GetType() { return "fusedVariance"; }
+
+///////////////////////////////
+/// Fused chain of time series tick and exponential moving average.
+/// Same results as timeSeriesTick -> ema. Created by TPipeline.
+class TFusedEma : public TStreamAggr,
+                  public TStreamAggrOut::ITm,
+                  public TStreamAggrOut::IFlt {
+private:
+    /// ID of the field from which we collect time points
+    TInt TimeFieldId;
+    /// Reader for extracting numeric values from records
+    TFieldReader ValReader;
+
+    /// Did we read at least one value
+    TBool InitP;
+    /// Last extracted value
+    TFlt TickVal;
+    /// EMA indicator
+    TSignalProc::TEma Ema;
+
+    /// Read value and timestamp from the record and update EMA
+    void UpdateRec(const TRec& Rec);
+
+protected:
+    /// Update EMA with the new record
+    void OnAddRec(const TRec& Rec, const TWPt<TStreamAggr>& CallerAggr);
+    /// Update EMA with each record of the batch
+    void OnAddRecBatch(const TRecSet& RecSet, const TWPt<TStreamAggr>& CallerAggr);
+    /// Update EMA with the last value at the new time
+    void OnTime(const uint64& TmMsec, const TWPt<TStreamAggr>& CallerAggr);
+
+public:
+    /// Constructor from pipeline parameters and parameters of the tick and ema stages
+    TFusedEma(const TWPt<TBase>& Base, const PJsonVal& ParamVal,
+        const PJsonVal& TickVal, const PJsonVal& EmaVal);
+
+    /// Load stream aggregate state from stream
+    void LoadState(TSIn& SIn);
+    /// Save state of stream aggregate to stream
+    void SaveState(TSOut& SOut) const;
+
+    /// Did we finish initialization?
+    bool IsInit() const { return Ema.IsInit(); }
+    /// Resets the aggregate
+    void Reset() { InitP = false; TickVal = 0.0; Ema.Reset(); }
+    /// Latest value
+    double GetFlt() const { return Ema.GetValue(); }
+    /// Timestamp of the latest value
+    uint64 GetTmMSecs() const { return Ema.GetTmMSecs(); }
+    /// Batches only read records
+    bool IsBatch() const { return true; }
+
+    /// Serialization to JSon
+    PJsonVal SaveJson(const int& Limit) const;
+
+    /// Stream aggregator type name
+    static TStr GetType() { return "fusedEma"; }
+    /// Stream aggregator type name
+    TStr Type() const { return GetType(); }
+};
+
+///////////////////////////////
+/// Pipeline of stream aggregates.
+/// Parameter `stages` is an array of aggregate parameters (with `type`), each stage
+/// reading from the previous one; `store` and `timestamp` are passed to all stages.
+/// Known chains are built as one fused aggregate:
+///  - timeSeriesTick -> timeSeriesWinBufVector -> ma, variance, winBufSum, winBufMin or winBufMax
+///  - timeSeriesTick -> ema
+/// Other chains fall back to separate aggregates. Stage N is named `<name>_<N>` and
+/// is registered with the base and attached to the store, while the last stage
+/// gets the pipeline name and is returned to be added like any other aggregate.
+class TPipeline {
+private:
+    /// Can the stage be fused with the previous one (it does not name its own inputs)
+    static bool IsFusable(const PJsonVal& StageVal);
+    /// Stage parameters with the pipeline parameters and input added
+    static PJsonVal GetStageVal(const PJsonVal& ParamVal, const PJsonVal& StageVal,
+        const TStr& AggrNm, const TStr& InAggrNm);
+    /// Fused aggregate for known chains, null otherwise
+    static PStreamAggr NewFused(const TWPt<TBase>& Base, const PJsonVal& ParamVal, const TJsonValV& StageValV);
+
+public:
+    /// Json constructor
+    static PStreamAggr New(const TWPt<TBase>& Base, const PJsonVal& ParamVal);
+
+    /// Stream aggregator type name
+    static TStr GetType() { return "pipeline"; }
+};
+
 ///////////////////////////////
 // Exponential Moving Average.
 class TEmaSpVec : public TStreamAggr,
@@ -1020,6 +1404,8 @@ private:
 protected:
     /// update aggregate value
     void OnStep(const TWPt<TStreamAggr>& CallerAggr);
+    /// value depends only on the last input, so we update once per batch
+    void OnAddRecBatch(const TRecSet& RecSet, const TWPt<TStreamAggr>& CallerAggr);
 
     /// Json constructor
     TThresholdAggr(const TWPt<TBase>& Base, const PJsonVal& ParamVal);
@@ -1036,6 +1422,8 @@ public:
     bool IsInit() const { return TmMSecs != TUInt64::Mn; }
     /// Resets the aggregate
     void Reset();
+    /// Batches need only the last input
+    bool IsBatch() const { return true; }
     /// Current values
     double GetFlt() const { return IsAboveP; }
     /// Current timestamp
@@ -1071,12 +1459,19 @@ private:
     /// Input Y timeseries
     TWPt<TStreamAggrOut::IFltIO> InAggrFltIOY;
 
+    /// Input X changes from the last batch, empty when not provided
+    TWPt<TStreamAggrOut::IFltIOBatch> InAggrFltIOBatchX;
+    /// Input Y changes from the last batch, empty when not provided
+    TWPt<TStreamAggrOut::IFltIOBatch> InAggrFltIOBatchY;
+
     /// Covariance
     TSignalProc::TCov Cov;
 
 protected:
     /// Update covariance
     void OnStep(const TWPt<TStreamAggr>& CallerAggr);
+    /// Update covariance with the changes at each record of the batch
+    void OnAddRecBatch(const TRecSet& RecSet, const TWPt<TStreamAggr>& CallerAggr);
 
     /// Json constructor
     TCov(const TWPt<TBase>& Base, const PJsonVal& ParamVal);
@@ -1093,6 +1488,8 @@ public:
     bool IsInit() const { return InAggrX->IsInit() && InAggrY->IsInit(); }
     /// Resets the aggregate
     void Reset() { Cov.Reset(); }
+    /// Batches need both inputs with changes for each record
+    bool IsBatch() const { return !InAggrFltIOBatchX.Empty() && !InAggrFltIOBatchY.Empty(); }
     /// Get latest covariance
     double GetFlt() const { return Cov.GetCov(); }
     /// Get time of latest covariance
@@ -1140,6 +1537,8 @@ private:
 protected:
     /// Update current correlation values
     void OnStep(const TWPt<TStreamAggr>& CallerAggr);
+    /// Correlation depends only on the last inputs, so we update once per batch
+    void OnAddRecBatch(const TRecSet& RecSet, const TWPt<TStreamAggr>& CallerAggr);
 
     /// Initialize from json
     TCorr(const TWPt<TBase>& Base, const PJsonVal& ParamVal);
@@ -1156,6 +1555,8 @@ public:
     bool IsInit() const;
     /// Resets the aggregate
     void Reset() { TmMSecs = 0;  Corr = 0; }
+    /// Batches need only the last inputs
+    bool IsBatch() const { return true; }
     /// Return current correlation value
     double GetFlt() const { return Corr; }
     /// Return current timestamp
@@ -1,20 +1,20 @@
 ///////////////////////////////
 // Time series window buffer with memory.
 template <class TVal>
-void TWinBufMem<TVal>::UpdateVal() {
-    // get new value
-    DelayQ.Push(TPair<TUInt64, TVal>(InAggrTm->GetTmMSecs(), GetVal()));
+void TWinBufMem<TVal>::UpdateVal(const uint64& ValTmMSecs, const TVal& Val) {
+    // add new value
+    DelayQ.Push(TPair<TUInt64, TVal>(ValTmMSecs, Val));
     // once we read one input we are initialized
     InitP = true;
 }
 
 template <class TVal>
-void TWinBufMem<TVal>::UpdateTime() {
-    // first we clear existing in/out placeholders
-    InValV.Clr(); InTmMSecsV.Clr();
-    OutValV.Clr(); OutTmMSecsV.Clr();
+void TWinBufMem<TVal>::UpdateTime(const uint64& NewTmMSecs) {
+    // first we clear existing in/out placeholders, keeping their space
+    InValV.Clr(false); InTmMSecsV.Clr(false);
+    OutValV.Clr(false); OutTmMSecsV.Clr(false);
     // update the current timestamps
-    TmMSecs = InAggrTm->GetTmMSecs();
+    TmMSecs = NewTmMSecs;
     // first we move things from delay to window
     const uint64 StartDelayMSecs = TmMSecs - DelayMSecs;
     while (!DelayQ.Empty() && DelayQ.Front().Val1 <= StartDelayMSecs) {
@@ -46,6 +46,23 @@ void TWinBufMem<TVal>::OnAddRec(const TRec& Rec, const TWPt<TStreamAggr>& Caller
     UpdateTime();
 }
 
+template <class TVal>
+void TWinBufMem<TVal>::OnAddRecBatch(const TRecSet& RecSet, const TWPt<TStreamAggr>& CallerAggr) {
+    TScopeStopWatch StopWatch(ExeTm);
+    const TUInt64V& BatchTmMSecsV = InAggrTmBatch->GetBatchTmMSecsV();
+    QmAssertR(BatchTmMSecsV.Len() == RecSet.GetRecs(), "[TWinBufMem] input aggregate did not process the batch");
+    IOBatch.Clr();
+    for (int RecN = 0; RecN < RecSet.GetRecs(); RecN++) {
+        // same as OnAddRec, with value and time of the record
+        UpdateVal(BatchTmMSecsV[RecN], GetBatchVal(RecN));
+        UpdateTime(BatchTmMSecsV[RecN]);
+        // remember in/out values of the record
+        for (int ValN = 0; ValN < InValV.Len(); ValN++) { IOBatch.AddIn(InValV[ValN], InTmMSecsV[ValN]); }
+        for (int ValN = 0; ValN < OutValV.Len(); ValN++) { IOBatch.AddOut(OutValV[ValN], OutTmMSecsV[ValN]); }
+        IOBatch.EndStep();
+    }
+}
+
 template <class TVal>
 void TWinBufMem<TVal>::OnTime(const uint64& TmMsec, const TWPt<TStreamAggr>& CallerAggr) {
     TScopeStopWatch StopWatch(ExeTm);
@@ -70,6 +87,10 @@ TWinBufMem<TVal>::TWinBufMem(const TWPt<TBase>& Base, const PJsonVal& ParamVal):
     InAggr = ParseAggr(ParamVal, "inAggr");
     InAggrTm = Cast<TStreamAggrOut::ITm>(ParamVal->IsObjKey("inAggrTm") ?
             ParseAggr(ParamVal, "inAggrTm") : InAggr);
+    // batches are supported when timestamps come with the values
+    if (!ParamVal->IsObjKey("inAggrTm")) {
+        InAggrTmBatch = Cast<TStreamAggrOut::ITmBatch>(InAggr, false);
+    }
     // when should we pump in new values?
     TStr UpdateTypeStr = ParamVal->GetObjStr("update", "onNewRecord");
     UpdateType = (UpdateTypeStr == "onNewRecord") ? wbmuOnAddRec : wbmuAlways;
@@ -109,6 +130,7 @@ void TWinBufMem<TVal>::Reset() {
     WindowQ.Clr(); DelayQ.Clr();
     InValV.Clr(); InTmMSecsV.Clr();
     OutValV.Clr(); OutTmMSecsV.Clr();
+    IOBatch.Clr();
 }
 
 template <class TVal>
@@ -149,12 +171,39 @@ void TWinBuf<TVal>::OnAddRec(const TRec& Rec, const TWPt<TStreamAggr>& CallerAgg
     OnTime(Timestamp_, CallerAggr);
 }
 
+template <class TVal>
+void TWinBuf<TVal>::OnAddRecBatch(const TRecSet& RecSet, const TWPt<TStreamAggr>& CallerAggr) {
+    TScopeStopWatch StopWatch(ExeTm);
+    IOBatch.Clr();
+    for (int RecN = 0; RecN < RecSet.GetRecs(); RecN++) {
+        // same as OnAddRec
+        InitP = true;
+        UpdateTime(RecSet.GetRec(RecN).GetFieldTmMSecs(TimeFieldId));
+        // remember in/out values of the record, see GetInValV and GetOutValV
+        const uint64 Skip = B > C ? B - C : 0;
+        for (uint64 RecId = C + Skip; RecId < D; RecId++) {
+            IOBatch.AddIn(GetRecVal(RecId), Time(RecId));
+        }
+        for (uint64 RecId = A; RecId + Skip < B; RecId++) {
+            IOBatch.AddOut(GetRecVal(RecId), Time(RecId));
+        }
+        IOBatch.EndStep();
+    }
+}
+
 template <class TVal>
 void TWinBuf<TVal>::OnTime(const uint64& TmMsec, const TWPt<TStreamAggr>& CallerAggr) {
     TScopeStopWatch StopWatch(ExeTm);
+    UpdateTime(TmMsec);
+}
+
+template <class TVal>
+void TWinBuf<TVal>::UpdateTime(const uint64& TmMsec) {
     InitP = true;
 
     Timestamp = TmMsec;
+    // in/out values are read again when asked for
+    InReadP = false; OutReadP = false;
 
     A = B;
     // B = first record ID in the buffer, or first record ID after the buffer (indicates an empty buffer)
@@ -202,6 +251,7 @@ void TWinBuf<TVal>::LoadState(TSIn& SIn) {
     C.Load(SIn);
     D.Load(SIn);
     Timestamp.Load(SIn);
+    InReadP = false; OutReadP = false;
     TestValid(); // checks if the buffer exists in store
 }
 
@@ -223,74 +273,52 @@ void TWinBuf<TVal>::Reset() {
     C = Store->GetRecs() == 0 ? 0 : Store->GetLastRecId() + 1;
     D = Store->GetRecs() == 0 ? 0 : Store->GetLastRecId() + 1;
     Timestamp = 0;
+    IOBatch.Clr();
+    InReadP = false; OutReadP = false;
 }
 
 template <class TVal>
-void TWinBuf<TVal>::GetInValV(TVec<TVal>& ValV) const {
+void TWinBuf<TVal>::ReadIn() const {
+    TLock Lock(ReadLock);
+    if (InReadP) { return; }
     EAssertR(IsInit(), "WinBuf not initialized yet!");
     int Skip = B > C ? int(B - C) : 0;
     int UpdateRecords = int(D - C) - Skip;
-    if (ValV.Len() != UpdateRecords) { ValV.Gen(UpdateRecords); }
     // iterate
     if (UpdateRecords > 0) {
         EAssertR(Store->IsRecId(C + Skip) && Store->IsRecId(C + Skip + UpdateRecords - 1),
             "WinBuf::GetInValV record not in store! Possible reason: store is windowed and window is too "
             "small and it does not fully contain the buffer");
     }
+    // reuse space from the previous update
+    InValV.Clr(false); InTmMSecsV.Clr(false);
     for (int RecN = 0; RecN < UpdateRecords; RecN++) {
-        ValV[RecN] = GetRecVal(C + Skip + RecN);
-    }
-}
-
-template <class TVal>
-void TWinBuf<TVal>::GetInTmMSecsV(TUInt64V& MSecsV) const {
-    EAssertR(IsInit(), "WinBuf not initialized yet!");
-    int Skip = B > C ? int(B - C) : 0;
-    int UpdateRecords = int(D - C) - Skip;
-    if (MSecsV.Len() != UpdateRecords) { MSecsV.Gen(UpdateRecords); }
-    // iterate
-    if (UpdateRecords > 0) {
-        EAssertR(Store->IsRecId(C + Skip) && Store->IsRecId(C + Skip + UpdateRecords - 1),
-            "WinBuf::GetInTmMSecsV record not in store! Possible reason: store is windowed and window is too "
-            "small and it does not fully contain the buffer");
-    }
-    for (int RecN = 0; RecN < UpdateRecords; RecN++) {
-        MSecsV[RecN] = Time(C + Skip + RecN);
+        InValV.Add(GetRecVal(C + Skip + RecN));
+        InTmMSecsV.Add(Time(C + Skip + RecN));
     }
+    InReadP = true;
 }
 
 template <class TVal>
-void TWinBuf<TVal>::GetOutValV(TVec<TVal>& ValV) const {
+void TWinBuf<TVal>::ReadOut() const {
+    TLock Lock(ReadLock);
+    if (OutReadP) { return; }
     EAssertR(IsInit(), "WinBuf not initialized yet!");
     int Skip = B > C ? int(B - C) : 0;
     int DropRecords = int(B - A) - Skip;
-    if (ValV.Len() != DropRecords) { ValV.Gen(DropRecords); }
     // iterate
     if (DropRecords > 0) {
         EAssertR(Store->IsRecId(A) && Store->IsRecId(A + DropRecords - 1),
             "WinBuf::GetOutValV record not in store! Possible reason: store is windowed and window is too "
             "small and it does not fully contain the buffer");
     }
+    // reuse space from the previous update
+    OutValV.Clr(false); OutTmMSecsV.Clr(false);
     for (int RecN = 0; RecN < DropRecords; RecN++) {
-        ValV[RecN] = GetRecVal(A + RecN);
-    }
-}
-
-template <class TVal>
-void TWinBuf<TVal>::GetOutTmMSecsV(TUInt64V& MSecsV) const {
-    EAssertR(IsInit(), "WinBuf not initialized yet!");
-    int Skip = B > C ? int(B - C) : 0;
-    int DropRecords = int(B - A) - Skip;
-    if (MSecsV.Len() != DropRecords) { MSecsV.Gen(DropRecords); }
-    // iterate
-    if (DropRecords > 0) {
-        EAssertR(Store->IsRecId(A) && Store->IsRecId(A + DropRecords - 1),
-            "WinBuf::GetOutTmMSecsV record not in store! Possible reason: store is windowed and window is too "
-            "small and it does not fully contain the buffer");
-    }
-    for (int RecN = 0; RecN < DropRecords; RecN++) {
-        MSecsV[RecN] = Time(A + RecN);
+        OutValV.Add(GetRecVal(A + RecN));
+        OutTmMSecsV.Add(Time(A + RecN));
     }
+    OutReadP = true;
 }
 
 template <class TVal>
@@ -401,11 +429,22 @@ template <class TSignalType>
 void TWinAggr<TSignalType>::OnStep(const TWPt<TStreamAggr>& CallerAggr) {
     TScopeStopWatch StopWatch(ExeTm);
     if (InAggr->IsInit()) {
-        TFltV InValV; InAggrFltIO->GetInValV(InValV);
-        TUInt64V InTmMSecsV; InAggrTmIO->GetInTmMSecsV(InTmMSecsV);
-        TFltV OutValV; InAggrFltIO->GetOutValV(OutValV);
-        TUInt64V OutTmMSecsV; InAggrTmIO->GetOutTmMSecsV(OutTmMSecsV);
-        Signal.Update(InValV, InTmMSecsV, OutValV, OutTmMSecsV);
+        Signal.Update(InAggrFltIO->GetInValV(), InAggrTmIO->GetInTmMSecsV(),
+            InAggrFltIO->GetOutValV(), InAggrTmIO->GetOutTmMSecsV());
+    }
+}
+
+template <class TSignalType>
+void TWinAggr<TSignalType>::OnAddRecBatch(const TRecSet& RecSet, const TWPt<TStreamAggr>& CallerAggr) {
+    TScopeStopWatch StopWatch(ExeTm);
+    if (InAggr->IsInit()) {
+        // same as OnStep for each record, the step vectors share memory with the input
+        const TStreamAggrOut::TValIOBatch<TFlt>& IOBatch = InAggrFltIOBatch->GetValIOBatch();
+        QmAssertR(IOBatch.GetSteps() == RecSet.GetRecs(), "[TWinAggr] input aggregate did not process the batch");
+        for (int RecN = 0; RecN < IOBatch.GetSteps(); RecN++) {
+            Signal.Update(IOBatch.GetInValV(RecN), IOBatch.GetInTmMSecsV(RecN),
+                IOBatch.GetOutValV(RecN), IOBatch.GetOutTmMSecsV(RecN));
+        }
     }
 }
 
@@ -417,6 +456,7 @@ TWinAggr<TSignalType>::TWinAggr(const TWPt<TBase>& Base, const PJsonVal& ParamVa
     InAggrTm = Cast<TStreamAggrOut::ITm>(InAggr);
     InAggrTmIO = Cast<TStreamAggrOut::ITmIO>(InAggr);
     InAggrFltIO = Cast<TStreamAggrOut::IFltIO>(InAggr);
+    InAggrFltIOBatch = Cast<TStreamAggrOut::IFltIOBatch>(InAggr, false);
 }
 
 template <class TSignalType>
@@ -427,17 +467,120 @@ PJsonVal TWinAggr<TSignalType>::SaveJson(const int& Limit) const {
     return Val;
 }
 
+///////////////////////////////
+/// Fused tick, window buffer and window aggregate
+template <class TSignalType>
+void TFusedWinAggr<TSignalType>::UpdateTime(const uint64& NewTmMSecs) {
+    // first we clear existing in/out placeholders, keeping their space
+    InValV.Clr(false); InTmMSecsV.Clr(false);
+    OutValV.Clr(false); OutTmMSecsV.Clr(false);
+    // update the current timestamps
+    TmMSecs = NewTmMSecs;
+    // first we move things from delay to window
+    const uint64 StartDelayMSecs = TmMSecs - DelayMSecs;
+    while (!DelayQ.Empty() && DelayQ.Front().Val1 <= StartDelayMSecs) {
+        const TUInt64FltPr& TmVal = DelayQ.Front();
+        WindowQ.Push(TmVal);
+        InValV.Add(TmVal.Val2); InTmMSecsV.Add(TmVal.Val1);
+        DelayQ.Pop();
+    }
+    // then we remove old stuff from window
+    const uint64 StartWinMSecs = TmMSecs - DelayMSecs - WinSizeMSecs;
+    while (!WindowQ.Empty() && WindowQ.Front().Val1 < StartWinMSecs) {
+        const TUInt64FltPr& TmVal = WindowQ.Front();
+        OutValV.Add(TmVal.Val2); OutTmMSecsV.Add(TmVal.Val1);
+        WindowQ.Pop();
+    }
+    // update signal once we have seen the first value
+    if (InitP) { Signal.Update(InValV, InTmMSecsV, OutValV, OutTmMSecsV); }
+}
+
+template <class TSignalType>
+void TFusedWinAggr<TSignalType>::UpdateRec(const TRec& Rec) {
+    const uint64 RecTmMSecs = Rec.GetFieldTmMSecs(TimeFieldId);
+    DelayQ.Push(TUInt64FltPr(RecTmMSecs, ValReader.GetFlt(Rec)));
+    InitP = true;
+    UpdateTime(RecTmMSecs);
+}
+
+template <class TSignalType>
+void TFusedWinAggr<TSignalType>::OnAddRec(const TRec& Rec, const TWPt<TStreamAggr>& CallerAggr) {
+    TScopeStopWatch StopWatch(ExeTm);
+    UpdateRec(Rec);
+}
+
+template <class TSignalType>
+void TFusedWinAggr<TSignalType>::OnAddRecBatch(const TRecSet& RecSet, const TWPt<TStreamAggr>& CallerAggr) {
+    TScopeStopWatch StopWatch(ExeTm);
+    for (int RecN = 0; RecN < RecSet.GetRecs(); RecN++) {
+        UpdateRec(RecSet.GetRec(RecN));
+    }
+}
+
+template <class TSignalType>
+void TFusedWinAggr<TSignalType>::OnTime(const uint64& TmMsec, const TWPt<TStreamAggr>& CallerAggr) {
+    TScopeStopWatch StopWatch(ExeTm);
+    UpdateTime(TmMsec);
+}
+
+template <class TSignalType>
+TFusedWinAggr<TSignalType>::TFusedWinAggr(const TWPt<TBase>& Base, const PJsonVal& ParamVal,
+        const PJsonVal& TickVal, const PJsonVal& WinBufVal): TStreamAggr(Base, ParamVal) {
+
+    // value and time fields, same as timeSeriesTick
+    TWPt<TStore> Store = Base->GetStoreByStoreNm(TickVal->GetObjStr("store"));
+    TStr TimeFieldNm = TickVal->GetObjStr("timestamp");
+    TimeFieldId = Store->GetFieldId(TimeFieldNm);
+    TStr ValFieldNm = TickVal->GetObjStr("value");
+    const int ValFieldId = Store->GetFieldId(ValFieldNm);
+    ValReader = TFieldReader(Store->GetStoreId(), ValFieldId, Store->GetFieldDesc(ValFieldId));
+    QmAssertR(Store->GetFieldDesc(TimeFieldId).IsTm(), "[Window buffer] field " + TimeFieldNm + " not of type 'datetime'");
+    QmAssertR(ValReader.IsFlt(), "[Window buffer] field " + ValFieldNm + " cannot be casted to 'double'");
+    // window parameters, same as timeSeriesWinBufVector
+    WinBufVal->AssertObjKeyNum("winsize", __FUNCTION__);
+    WinSizeMSecs = WinBufVal->GetObjUInt64("winsize");
+    DelayMSecs = WinBufVal->GetObjUInt64("delay", 0);
+}
+
+template <class TSignalType>
+void TFusedWinAggr<TSignalType>::LoadState(TSIn& SIn) {
+    InitP.Load(SIn); TmMSecs.Load(SIn);
+    WindowQ.Load(SIn); DelayQ.Load(SIn);
+    Signal.Load(SIn);
+}
+
+template <class TSignalType>
+void TFusedWinAggr<TSignalType>::SaveState(TSOut& SOut) const {
+    InitP.Save(SOut); TmMSecs.Save(SOut);
+    WindowQ.Save(SOut); DelayQ.Save(SOut);
+    Signal.Save(SOut);
+}
+
+template <class TSignalType>
+void TFusedWinAggr<TSignalType>::Reset() {
+    InitP = false; TmMSecs = 0;
+    WindowQ.Clr(); DelayQ.Clr();
+    InValV.Clr(); InTmMSecsV.Clr();
+    OutValV.Clr(); OutTmMSecsV.Clr();
+    Signal.Reset();
+}
+
+template <class TSignalType>
+PJsonVal TFusedWinAggr<TSignalType>::SaveJson(const int& Limit) const {
+    PJsonVal Val = TJsonVal::NewObj();
+    Val->AddToObj("Val", Signal.GetValue());
+    Val->AddToObj("Time", TTm::GetTmFromMSecs(GetTmMSecs()).GetWebLogDateTimeStr(true, "T"));
+    return Val;
+}
+
 ///////////////////////////////
 /// Windowed stream aggregates
 template <class TSignalType>
 void TWinAggrSpVec<TSignalType>::OnStep(const TWPt<TStreamAggr>& CallerAggr) {
     TScopeStopWatch StopWatch(ExeTm);
     if (InAggr->IsInit()) {
-        TVec<TIntFltKdV> InValV; InAggrSparseVecIO->GetInValV(InValV);
-        TUInt64V InTmMSecsV; InAggrTmIO->GetInTmMSecsV(InTmMSecsV);
-        TVec<TIntFltKdV> OutValV; InAggrSparseVecIO->GetOutValV(OutValV);
-        TUInt64V OutTmMSecsV; InAggrTmIO->GetOutTmMSecsV(OutTmMSecsV);
-        Signal.Update(InValV, InTmMSecsV, OutValV, OutTmMSecsV);
+        Signal.Update(InAggrSparseVecIO->GetInValV(), InAggrTmIO->GetInTmMSecsV(),
+            InAggrSparseVecIO->GetOutValV(), InAggrTmIO->GetOutTmMSecsV());
     };
 }
 
@@ -381,6 +381,23 @@ bool TStoreIterVec::Next() {
     return true;
 }
 
+///////////////////////////////
+// QMiner-Store-Scan-Iterator
+TStoreIterScan::TStoreIterScan(const TWPt<TStore>& _Store, const PStoreIter& _Iter):
+    Store(_Store), Iter(_Iter) { Store->StartScan(); }
+
+TStoreIterScan::~TStoreIterScan() {
+    Store->EndScan();
+}
+
+///////////////////////////////
+// QMiner-Store-Trigger
+void TStoreTrigger::OnAddBatch(const TRecSet& RecSet) {
+    for (int RecN = 0; RecN < RecSet.GetRecs(); RecN++) {
+        OnAdd(RecSet.GetRec(RecN));
+    }
+}
+
 ///////////////////////////////
 // QMiner-Store
 void TStore::LoadStore(TSIn& SIn) {
@@ -435,6 +452,14 @@ int TStore::AddFieldDesc(const TFieldDesc& FieldDesc) {
     return FieldId;
 }
 
+const PFlushLock& TStore::GetFlushLock() const {
+    return Base->GetFlushLock();
+}
+
+const PSnapshotGate& TStore::GetSnapshotGate() const {
+    return Base->GetSnapshotGate();
+}
+
 PExcept TStore::FieldError(const int& FieldId, const TStr& TypeStr) const {
     return TQmExcept::New(TStr::Fmt("Wrong field-type combination requested: [%d:%s]!", FieldId, TypeStr.CStr()));
 }
@@ -444,16 +469,34 @@ void TStore::OnAdd(const uint64& RecId) {
 }
 
 void TStore::OnAdd(const TRec& Rec) {
+    IncRecVer();
+    TWalTriggers WalTriggers(Base);
     for (int TriggerN = 0; TriggerN < TriggerV.Len(); TriggerN++) {
         TriggerV[TriggerN]->OnAdd(Rec);
     }
 }
 
+void TStore::OnAddBatch(const TUInt64V& RecIdV) {
+    if (RecIdV.Empty()) { return; }
+    // with several triggers each must see a record before the next one is added,
+    // since a trigger can read the state of other triggers
+    if (TriggerV.Len() != 1) {
+        for (int RecN = 0; RecN < RecIdV.Len(); RecN++) { OnAdd(RecIdV[RecN]); }
+        return;
+    }
+    IncRecVer();
+    TWalTriggers WalTriggers(Base);
+    PRecSet RecSet = TRecSet::New(this, RecIdV);
+    TriggerV[0]->OnAddBatch(*RecSet);
+}
+
 void TStore::OnUpdate(const uint64& RecId) {
     OnUpdate(GetRec(RecId));
 }
 
 void TStore::OnUpdate(const TRec& Rec) {
+    IncRecVer();
+    TWalTriggers WalTriggers(Base);
     for (int TriggerN = 0; TriggerN < TriggerV.Len(); TriggerN++) {
         TriggerV[TriggerN]->OnUpdate(Rec);
     }
@@ -464,6 +507,8 @@ void TStore::OnDelete(const uint64& RecId) {
 }
 
 void TStore::OnDelete(const TRec& Rec) {
+    IncRecVer();
+    TWalTriggers WalTriggers(Base);
     for (int TriggerN = 0; TriggerN < TriggerV.Len(); TriggerN++) {
         TriggerV[TriggerN]->OnDelete(Rec);
     }
@@ -626,20 +671,53 @@ TRec TStore::GetRec(const TStr& RecNm) {
 }
 
 PRecSet TStore::GetAllRecs() {
-    TUInt64V RecIdV((int)GetRecs(), 0);
+    TUInt64V RecIdV; GetRecIdV(RecIdV);
+    return TRecSet::New(TWPt<TStore>(this), RecIdV);
+}
+
+PStoreIter TStore::GetScanIter() const {
+    return TStoreIterScan::New(TWPt<TStore>((TStore*)this), GetIter());
+}
+
+void TStore::GetRecIdV(TUInt64V& RecIdV) const {
+    RecIdV.Gen((int)GetRecs(), 0);
     PStoreIter Iter = GetIter();
     while (Iter->Next()) {
         RecIdV.Add(Iter->GetRecId());
     }
-    return TRecSet::New(TWPt<TStore>(this), RecIdV);
 }
 
 PRecSet TStore::GetRndRecs(const uint64& SampleSize) {
     return GetAllRecs()->GetSampleRecSet((int)SampleSize);
 }
 
+void TStore::AddRecBatch(const PJsonVal& RecValV, TUInt64V& RecIdV, const bool& TriggerEvents) {
+    QmAssertR(RecValV->IsArr(), "[TStore::AddRecBatch] Records must be given as an array");
+    RecIdV.Gen(RecValV->GetArrVals(), 0);
+    // remember which records are new, triggers are called for them at the end
+    TUInt64V NewRecIdV;
+    Index->StartBatch();
+    try {
+        for (int RecN = 0; RecN < RecValV->GetArrVals(); RecN++) {
+            const uint64 Recs = GetRecs();
+            const uint64 RecId = AddRec(RecValV->GetArrVal(RecN), false);
+            RecIdV.Add(RecId);
+            if (GetRecs() > Recs) { NewRecIdV.Add(RecId); }
+        }
+    } catch (...) {
+        // keep what was added so far indexed
+        Index->EndBatch();
+        throw;
+    }
+    Index->EndBatch();
+    // triggers see the records already indexed
+    if (TriggerEvents) { OnAddBatch(NewRecIdV); }
+}
+
 void TStore::AddJoin(const int& JoinId, const uint64& RecId, const uint64 JoinRecId, const int& JoinFq) {
     const TJoinDesc& JoinDesc = GetJoinDesc(JoinId);
+    // joins change results of queries on both stores
+    IncRecVer(); JoinDesc.GetJoinStore(Base)->IncRecVer();
     // different handling for field and index joins
     if (JoinDesc.IsIndexJoin()) {
         Index->IndexJoin(this, JoinId, RecId, JoinRecId, JoinFq);
@@ -699,6 +777,8 @@ void TStore::AddJoin(const TStr& JoinNm, const uint64& RecId, const uint64 JoinR
 
 void TStore::DelJoin(const int& JoinId, const uint64& RecId, const uint64 JoinRecId, const int& JoinFq) {
     const TJoinDesc& JoinDesc = GetJoinDesc(JoinId);
+    // joins change results of queries on both stores
+    IncRecVer(); JoinDesc.GetJoinStore(Base)->IncRecVer();
     // different handling for field and index joins
     if (JoinDesc.IsIndexJoin()) {
         Index->DeleteJoin(this, JoinId, RecId, JoinRecId, JoinFq);
@@ -751,6 +831,55 @@ bool TStore::HasJoin(const TStr& JoinNm, const uint64& RecId) const {
     return Index->HasJoin(JoinKeyId, RecId);
 }
 
+void TStore::GetColumnInt(const int& FieldId, const TUInt64V& RecIdV, TIntV& ValV) const {
+    ValV.Gen(RecIdV.Len(), 0);
+    for (int RecN = 0; RecN < RecIdV.Len(); RecN++) {
+        ValV.Add(GetFieldInt(RecIdV[RecN], FieldId));
+    }
+}
+
+void TStore::GetColumnFlt(const int& FieldId, const TUInt64V& RecIdV, TFltV& ValV) const {
+    ValV.Gen(RecIdV.Len(), 0);
+    for (int RecN = 0; RecN < RecIdV.Len(); RecN++) {
+        ValV.Add(GetFieldFlt(RecIdV[RecN], FieldId));
+    }
+}
+
+void TStore::GetColumnTmMSecs(const int& FieldId, const TUInt64V& RecIdV, TUInt64V& ValV) const {
+    ValV.Gen(RecIdV.Len(), 0);
+    for (int RecN = 0; RecN < RecIdV.Len(); RecN++) {
+        ValV.Add(GetFieldTmMSecs(RecIdV[RecN], FieldId));
+    }
+}
+
+void TStore::GetColumnByte(const int& FieldId, const TUInt64V& RecIdV, TUChV& ValV) const {
+    const bool BoolP = GetFieldDesc(FieldId).IsBool();
+    ValV.Gen(RecIdV.Len(), 0);
+    for (int RecN = 0; RecN < RecIdV.Len(); RecN++) {
+        ValV.Add(BoolP ? (uchar)GetFieldBool(RecIdV[RecN], FieldId) : GetFieldByte(RecIdV[RecN], FieldId));
+    }
+}
+
+void TStore::GetColumnInt(const int& FieldId, TIntV& ValV) const {
+    TUInt64V RecIdV; GetRecIdV(RecIdV);
+    GetColumnInt(FieldId, RecIdV, ValV);
+}
+
+void TStore::GetColumnFlt(const int& FieldId, TFltV& ValV) const {
+    TUInt64V RecIdV; GetRecIdV(RecIdV);
+    GetColumnFlt(FieldId, RecIdV, ValV);
+}
+
+void TStore::GetColumnTmMSecs(const int& FieldId, TUInt64V& ValV) const {
+    TUInt64V RecIdV; GetRecIdV(RecIdV);
+    GetColumnTmMSecs(FieldId, RecIdV, ValV);
+}
+
+void TStore::GetColumnByte(const int& FieldId, TUChV& ValV) const {
+    TUInt64V RecIdV; GetRecIdV(RecIdV);
+    GetColumnByte(FieldId, RecIdV, ValV);
+}
+
 /// Get field value using field id safely
 uint64 TStore::GetFieldUInt64Safe(const uint64& RecId, const int& FieldId) const {
     switch (GetFieldDesc(FieldId).GetFieldType()) {
@@ -1414,7 +1543,7 @@ void TStore::PrintRecSetAsJson(const TWPt<TBase>& Base, const PRecSet& RecSet, c
 }
 
 void TStore::PrintAllAsJson(const TWPt<TBase>& Base, TSOut& SOut) {
-    PStoreIter Iter = GetIter();
+    PStoreIter Iter = GetScanIter();
     while (Iter->Next()) {
         const uint64 RecId = Iter->GetRecId();
         PJsonVal Json = GetRec(RecId).GetJson(Base, true, false);
@@ -3538,6 +3667,13 @@ void TRecSet::LimitToSampleRecIdV(const TUInt64IntKdV& SampleRecIdFqV) {
     RecIdFqV = SampleRecIdFqV;
 }
 
+bool TRecSet::IsSortedSet(const TUInt64IntKdV& RecIdFqV) {
+    for (int RecN = 1; RecN < RecIdFqV.Len(); RecN++) {
+        if (RecIdFqV[RecN - 1].Key >= RecIdFqV[RecN].Key) { return false; }
+    }
+    return true;
+}
+
 TRecSet::TRecSet(const TWPt<TStore>& _Store, const uint64& RecId, const int& Fq) :
     Store(_Store), FqP(Fq > 1) {
 
@@ -3656,64 +3792,57 @@ void TRecSet::SortByFq(const bool& Asc) {
 }
 
 void TRecSet::SortByField(const bool& Asc, const int& SortFieldId) {
+    TopByField(Asc, SortFieldId, GetRecs());
+}
+
+void TRecSet::TopByFq(const bool& Asc, const int& Recs) {
+    TopCmp(TRecCmpByFq(Asc), Recs);
+}
+
+void TRecSet::TopByField(const bool& Asc, const int& SortFieldId, const int& Recs) {
     // get store and field type
     const TFieldDesc& Desc = Store->GetFieldDesc(SortFieldId);
+    // columnar stores serve fixed-width values in bulk with a sequential sweep,
+    // others are read directly from the records
+    const bool ColumnP = Store->IsFieldColumnar(SortFieldId);
+    TUInt64V RecIdV; if (ColumnP) { GetRecIdV(RecIdV); }
     // apply appropriate comparator
     if (Desc.IsInt()) {
-        typedef TKeyDat<TInt, TUInt64IntKd> TItem;
-        TVec<TItem> TItemV(RecIdFqV.Len());
-        for (int N = 0; N < RecIdFqV.Len(); N++) {
-            TItemV.SetVal(N, TItem(Store->GetFieldInt(RecIdFqV[N].Key, SortFieldId), RecIdFqV[N]));
-        }
-        TItemV.Sort(Asc);
-        for (int N = 0; N < TItemV.Len(); N++) {
-            RecIdFqV.SetVal(N, TItemV[N].Dat);
-        }
+        TIntV ValV(RecIdFqV.Len(), 0);
+        if (ColumnP) { Store->GetColumnInt(SortFieldId, RecIdV, ValV); }
+        else { for (int N = 0; N < RecIdFqV.Len(); N++) { ValV.Add(Store->GetFieldInt(RecIdFqV[N].Key, SortFieldId)); } }
+        TopByColumn(Asc, ValV, Recs);
     } else if (Desc.IsFlt()) {
-        typedef TKeyDat<TFlt, TUInt64IntKd> TItem;
-        TVec<TItem> TItemV(RecIdFqV.Len());
-        for (int N = 0; N < RecIdFqV.Len(); N++) {
-            TItemV.SetVal(N, TItem(Store->GetFieldFlt(RecIdFqV[N].Key, SortFieldId), RecIdFqV[N]));
-        }
-        TItemV.Sort(Asc);
-        for (int N = 0; N < TItemV.Len(); N++) {
-            RecIdFqV.SetVal(N, TItemV[N].Dat);
-        }
+        TFltV ValV(RecIdFqV.Len(), 0);
+        if (ColumnP) { Store->GetColumnFlt(SortFieldId, RecIdV, ValV); }
+        else { for (int N = 0; N < RecIdFqV.Len(); N++) { ValV.Add(Store->GetFieldFlt(RecIdFqV[N].Key, SortFieldId)); } }
+        TopByColumn(Asc, ValV, Recs);
     } else if (Desc.IsByte()) {
-        typedef TKeyDat<TUCh, TUInt64IntKd> TItem;
-        TVec<TItem> TItemV(RecIdFqV.Len());
-        for (int N = 0; N < RecIdFqV.Len(); N++) {
-            TItemV.SetVal(N, TItem(Store->GetFieldByte(RecIdFqV[N].Key, SortFieldId), RecIdFqV[N]));
-        }
-        TItemV.Sort(Asc);
-        for (int N = 0; N < TItemV.Len(); N++) {
-            RecIdFqV.SetVal(N, TItemV[N].Dat);
-        }
+        TUChV ValV(RecIdFqV.Len(), 0);
+        if (ColumnP) { Store->GetColumnByte(SortFieldId, RecIdV, ValV); }
+        else { for (int N = 0; N < RecIdFqV.Len(); N++) { ValV.Add(Store->GetFieldByte(RecIdFqV[N].Key, SortFieldId)); } }
+        TopByColumn(Asc, ValV, Recs);
     } else if (Desc.IsStr()) {
-        typedef TKeyDat<TStr, TUInt64IntKd> TItem;
-        TVec<TItem> TItemV(RecIdFqV.Len());
+        TStrV ValV(RecIdFqV.Len(), 0);
         for (int N = 0; N < RecIdFqV.Len(); N++) {
-            TItemV.SetVal(N, TItem(Store->GetFieldStr(RecIdFqV[N].Key, SortFieldId), RecIdFqV[N]));
-        }
-        TItemV.Sort(Asc);
-        for (int N = 0; N < TItemV.Len(); N++) {
-            RecIdFqV.SetVal(N, TItemV[N].Dat);
+            ValV.Add(Store->GetFieldStr(RecIdFqV[N].Key, SortFieldId));
         }
+        TopByColumn(Asc, ValV, Recs);
     } else if (Desc.IsTm()) {
-        typedef TKeyDat<TUInt64, TUInt64IntKd> TItem;
-        TVec<TItem> TItemV(RecIdFqV.Len());
-        for (int N = 0; N < RecIdFqV.Len(); N++) {
-            TItemV.SetVal(N, TItem(Store->GetFieldTmMSecs(RecIdFqV[N].Key, SortFieldId), RecIdFqV[N]));
-        }
-        TItemV.Sort(Asc);
-        for (int N = 0; N < TItemV.Len(); N++) {
-            RecIdFqV.SetVal(N, TItemV[N].Dat);
-        }
+        TUInt64V ValV(RecIdFqV.Len(), 0);
+        if (ColumnP) { Store->GetColumnTmMSecs(SortFieldId, RecIdV, ValV); }
+        else { for (int N = 0; N < RecIdFqV.Len(); N++) { ValV.Add(Store->GetFieldTmMSecs(RecIdFqV[N].Key, SortFieldId)); } }
+        TopByColumn(Asc, ValV, Recs);
     } else {
         throw TQmExcept::New("Unsupported sort field type!");
     }
 }
 
+bool TRecSet::IsColumnFilter(const int& FieldId) const {
+    // null values can only be checked on the record
+    return Store->IsFieldColumnar(FieldId) && !Store->GetFieldDesc(FieldId).IsNullable();
+}
+
 void TRecSet::FilterByExists() {
     // apply filter
     FilterBy<TRecFilterByExists>(TRecFilterByExists(Store->GetBase(), Store));
@@ -3729,6 +3858,24 @@ void TRecSet::FilterByRecIdSet(const TUInt64Set& RecIdSet) {
     FilterBy<TRecFilterByRecId>(TRecFilterByRecId(Store->GetBase(), RecIdSet, true));
 }
 
+void TRecSet::FilterByRecSet(const PRecSet& RecSet, const bool& InP) {
+    QmAssert(RecSet->GetStoreId() == GetStoreId());
+    if (IsSortedSet(RecIdFqV) && IsSortedSet(RecSet->GetRecIdFqV())) {
+        // both sorted by id, we can use sorted set operations
+        TUInt64IntKdV ResRecIdFqV;
+        if (InP) {
+            TSortedSet::Intrs(RecIdFqV, RecSet->GetRecIdFqV(), ResRecIdFqV);
+        } else {
+            TSortedSet::Diff(RecIdFqV, RecSet->GetRecIdFqV(), ResRecIdFqV);
+        }
+        RecIdFqV.Swap(ResRecIdFqV);
+    } else {
+        // keep the order by filtering through hash set
+        TUInt64Set RecIdSet; RecSet->GetRecIdSet(RecIdSet);
+        FilterBy<TRecFilterByRecId>(TRecFilterByRecId(Store->GetBase(), RecIdSet, InP));
+    }
+}
+
 void TRecSet::FilterByFq(const int& MinFq, const int& MaxFq) {
     // apply filter
     FilterBy<TRecFilterByRecFq>(TRecFilterByRecFq(Store->GetBase(), MinFq, MaxFq));
@@ -3747,7 +3894,14 @@ void TRecSet::FilterByFieldBool(const int& FieldId, const bool& Val) {
     const TFieldDesc& Desc = Store->GetFieldDesc(FieldId);
     QmAssertR(Desc.IsBool(), "Wrong field type, boolean expected");
     // apply the filter
-    FilterBy<TRecFilterByFieldBool>(TRecFilterByFieldBool(Store->GetBase(), FieldId, Val));
+    if (IsColumnFilter(FieldId)) {
+        TUInt64V RecIdV; GetRecIdV(RecIdV);
+        TUChV ValV; Store->GetColumnByte(FieldId, RecIdV, ValV);
+        const TUCh BoolVal = Val ? 1 : 0;
+        FilterByColumn(ValV, BoolVal, BoolVal);
+    } else {
+        FilterBy<TRecFilterByFieldBool>(TRecFilterByFieldBool(Store->GetBase(), FieldId, Val));
+    }
 }
 
 void TRecSet::FilterByFieldInt(const int& FieldId, const int& MinVal, const int& MaxVal) {
@@ -3755,7 +3909,13 @@ void TRecSet::FilterByFieldInt(const int& FieldId, const int& MinVal, const int&
     const TFieldDesc& Desc = Store->GetFieldDesc(FieldId);
     QmAssertR(Desc.IsInt() || (Desc.IsStr() && Desc.IsCodebook()), "Wrong field type, integer or codebook string expected");
     // apply the filter
-    FilterBy<TRecFilterByFieldInt>(TRecFilterByFieldInt(Store->GetBase(), FieldId, MinVal, MaxVal));
+    if (IsColumnFilter(FieldId)) {
+        TUInt64V RecIdV; GetRecIdV(RecIdV);
+        TIntV ValV; Store->GetColumnInt(FieldId, RecIdV, ValV);
+        FilterByColumn(ValV, TInt(MinVal), TInt(MaxVal));
+    } else {
+        FilterBy<TRecFilterByFieldInt>(TRecFilterByFieldInt(Store->GetBase(), FieldId, MinVal, MaxVal));
+    }
 }
 
 void TRecSet::FilterByFieldInt16(const int& FieldId, const int16& MinVal, const int16& MaxVal) {
@@ -3779,7 +3939,13 @@ void TRecSet::FilterByFieldByte(const int& FieldId, const uchar& MinVal, const u
     const TFieldDesc& Desc = Store->GetFieldDesc(FieldId);
     QmAssertR(Desc.IsByte(), "Wrong field type, integer expected");
     // apply the filter
-    FilterBy<TRecFilterByFieldByte>(TRecFilterByFieldByte(Store->GetBase(), FieldId, MinVal, MaxVal));
+    if (IsColumnFilter(FieldId)) {
+        TUInt64V RecIdV; GetRecIdV(RecIdV);
+        TUChV ValV; Store->GetColumnByte(FieldId, RecIdV, ValV);
+        FilterByColumn(ValV, TUCh(MinVal), TUCh(MaxVal));
+    } else {
+        FilterBy<TRecFilterByFieldByte>(TRecFilterByFieldByte(Store->GetBase(), FieldId, MinVal, MaxVal));
+    }
 }
 
 void TRecSet::FilterByFieldUInt(const int& FieldId, const uint& MinVal, const uint& MaxVal) {
@@ -3803,7 +3969,13 @@ void TRecSet::FilterByFieldFlt(const int& FieldId, const double& MinVal, const d
     const TFieldDesc& Desc = Store->GetFieldDesc(FieldId);
     QmAssertR(Desc.IsFlt(), "Wrong field type, numeric expected");
     // apply the filter
-    FilterBy<TRecFilterByFieldFlt>(TRecFilterByFieldFlt(Store->GetBase(), FieldId, MinVal, MaxVal));
+    if (IsColumnFilter(FieldId)) {
+        TUInt64V RecIdV; GetRecIdV(RecIdV);
+        TFltV ValV; Store->GetColumnFlt(FieldId, RecIdV, ValV);
+        FilterByColumn(ValV, TFlt(MinVal), TFlt(MaxVal));
+    } else {
+        FilterBy<TRecFilterByFieldFlt>(TRecFilterByFieldFlt(Store->GetBase(), FieldId, MinVal, MaxVal));
+    }
 }
 
 void TRecSet::FilterByFieldSFlt(const int& FieldId, const float& MinVal, const float& MaxVal) {
@@ -3855,7 +4027,13 @@ void TRecSet::FilterByFieldTm(const int& FieldId, const uint64& MinVal, const ui
     const TFieldDesc& Desc = Store->GetFieldDesc(FieldId);
     QmAssertR(Desc.IsTm() || Desc.IsUInt64(), "Wrong field type, time expected");
     // apply the filter
-    FilterBy<TRecFilterByFieldTm>(TRecFilterByFieldTm(Store->GetBase(), FieldId, MinVal, MaxVal));
+    if (IsColumnFilter(FieldId)) {
+        TUInt64V RecIdV; GetRecIdV(RecIdV);
+        TUInt64V ValV; Store->GetColumnTmMSecs(FieldId, RecIdV, ValV);
+        FilterByColumn(ValV, TUInt64(MinVal), TUInt64(MaxVal));
+    } else {
+        FilterBy<TRecFilterByFieldTm>(TRecFilterByFieldTm(Store->GetBase(), FieldId, MinVal, MaxVal));
+    }
 }
 
 void TRecSet::FilterByFieldTm(const int& FieldId, const TTm& MinVal, const TTm& MaxVal) {
@@ -3863,7 +4041,12 @@ void TRecSet::FilterByFieldTm(const int& FieldId, const TTm& MinVal, const TTm&
     const TFieldDesc& Desc = Store->GetFieldDesc(FieldId);
     QmAssertR(Desc.IsTm(), "Wrong field type, time expected");
     // apply the filter
-    FilterBy<TRecFilterByFieldTm>(TRecFilterByFieldTm(Store->GetBase(), FieldId, MinVal, MaxVal));
+    if (IsColumnFilter(FieldId)) {
+        FilterByFieldTm(FieldId, MinVal.IsDef() ? TTm::GetMSecsFromTm(MinVal) : (uint64)TUInt64::Mn,
+            MaxVal.IsDef() ? TTm::GetMSecsFromTm(MaxVal) : (uint64)TUInt64::Mx);
+    } else {
+        FilterBy<TRecFilterByFieldTm>(TRecFilterByFieldTm(Store->GetBase(), FieldId, MinVal, MaxVal));
+    }
 }
 
 void TRecSet::FilterByFieldSafe(const int& FieldId, const uint64& MinVal, const uint64& MaxVal) {
@@ -3944,10 +4127,17 @@ PRecSet TRecSet::GetMerge(const PRecSet& RecSet) const {
 
 void TRecSet::Merge(const PRecSet& RecSet) {
     QmAssert(RecSet->GetStoreId() == GetStoreId());
-    TUInt64IntKdV MergeRecIdFqV = RecSet->GetRecIdFqV();
-    if (!MergeRecIdFqV.IsSorted()) { MergeRecIdFqV.Sort(); }
     if (!RecIdFqV.IsSorted()) { RecIdFqV.Sort(); }
-    RecIdFqV.Union(MergeRecIdFqV);
+    if (IsSortedSet(RecIdFqV) && IsSortedSet(RecSet->GetRecIdFqV())) {
+        TUInt64IntKdV ResRecIdFqV;
+        TSortedSet::Union(RecIdFqV, RecSet->GetRecIdFqV(), ResRecIdFqV);
+        RecIdFqV.Swap(ResRecIdFqV);
+    } else {
+        // unsorted or with repeated ids, sorted set operations do not apply
+        TUInt64IntKdV MergeRecIdFqV = RecSet->GetRecIdFqV();
+        if (!MergeRecIdFqV.IsSorted()) { MergeRecIdFqV.Sort(); }
+        RecIdFqV.Union(MergeRecIdFqV);
+    }
 }
 
 void TRecSet::Merge(const TVec<PRecSet>& RecSetV) {
@@ -3963,10 +4153,30 @@ PRecSet TRecSet::GetIntersect(const PRecSet& RecSet) {
     TUInt64IntKdV _RecIdFqV = GetRecIdFqV();
     if (!_RecIdFqV.IsSorted()) { _RecIdFqV.Sort(); }
     TUInt64IntKdV ResultRecIdFqV;
-    TargetRecIdFqV.Intrs(_RecIdFqV, ResultRecIdFqV);
+    if (IsSortedSet(TargetRecIdFqV) && IsSortedSet(_RecIdFqV)) {
+        TSortedSet::Intrs(TargetRecIdFqV, _RecIdFqV, ResultRecIdFqV);
+    } else {
+        TargetRecIdFqV.Intrs(_RecIdFqV, ResultRecIdFqV);
+    }
     return new TRecSet(GetStore(), ResultRecIdFqV, false);
 }
 
+PRecSet TRecSet::GetDiff(const PRecSet& RecSet) const {
+    QmAssert(RecSet->GetStoreId() == GetStoreId());
+    TUInt64IntKdV _RecIdFqV = GetRecIdFqV();
+    if (!_RecIdFqV.IsSorted()) { _RecIdFqV.Sort(); }
+    TUInt64IntKdV ResultRecIdFqV;
+    if (IsSortedSet(_RecIdFqV) && IsSortedSet(RecSet->GetRecIdFqV())) {
+        TSortedSet::Diff(_RecIdFqV, RecSet->GetRecIdFqV(), ResultRecIdFqV);
+    } else {
+        // unsorted or with repeated ids, sorted set operations do not apply
+        TUInt64IntKdV DiffRecIdFqV = RecSet->GetRecIdFqV();
+        if (!DiffRecIdFqV.IsSorted()) { DiffRecIdFqV.Sort(); }
+        _RecIdFqV.Diff(DiffRecIdFqV, ResultRecIdFqV);
+    }
+    return new TRecSet(GetStore(), ResultRecIdFqV, FqP);
+}
+
 PRecSet TRecSet::DoJoin(const TWPt<TBase>& Base, const int& JoinId, const int& SampleSize, const bool& IgnoreFqP) const {
     // get join info
     AssertR(Store->IsJoinId(JoinId), "Wrong Join ID");
@@ -5151,6 +5361,69 @@ TWPt<TStore> TQueryItem::GetStore(const TWPt<TBase>& Base) const {
     return Base->GetStoreByStoreId(GetStoreId(Base));
 }
 
+bool TQueryItem::GetCacheKey(const TWPt<TBase>& Base, TChA& KeyChA, TUIntSet& StoreIdSet) const {
+    // given records can change without us knowing, sampling is random
+    if (IsRec() || IsRecSet() || (IsJoin() && SampleSize != -1)) { return false; }
+    KeyChA += TInt::GetStr((int)Type); KeyChA += '(';
+    if (IsGix() || IsTextPos() || IsGeo() || IsRange()) {
+        // leafs depend on the store of the index key
+        StoreIdSet.AddKey(Base->GetIndexVoc()->GetKeyStoreId(KeyId));
+        KeyChA += TInt::GetStr(KeyId); KeyChA += ':';
+    }
+    if (IsGix()) {
+        // order of values does not matter
+        TUInt64V SortWordIdV = WordIdV; SortWordIdV.Sort();
+        KeyChA += TInt::GetStr((int)CmpType);
+        for (const TUInt64& WordId : SortWordIdV) { KeyChA += ','; KeyChA += TUInt64::GetStr(WordId); }
+    } else if (IsTextPos()) {
+        KeyChA += TInt::GetStr(MaxPosDiff);
+        for (const TUInt64& WordId : WordIdV) { KeyChA += ','; KeyChA += TUInt64::GetStr(WordId); }
+    } else if (IsGeo()) {
+        KeyChA += TStr::Fmt("%.17g,%.17g,%.17g,%d", Loc.Val1.Val, Loc.Val2.Val, LocRadius.Val, LocLimit.Val);
+    } else if (IsRangeByte()) {
+        KeyChA += TStr::Fmt("%d,%d", (int)RangeUChMnMx.Val1.Val, (int)RangeUChMnMx.Val2.Val);
+    } else if (IsRangeInt()) {
+        KeyChA += TStr::Fmt("%d,%d", RangeIntMnMx.Val1.Val, RangeIntMnMx.Val2.Val);
+    } else if (IsRangeInt16()) {
+        KeyChA += TStr::Fmt("%d,%d", (int)RangeInt16MnMx.Val1.Val, (int)RangeInt16MnMx.Val2.Val);
+    } else if (IsRangeInt64()) {
+        KeyChA += TInt64::GetStr(RangeInt64MnMx.Val1) + "," + TInt64::GetStr(RangeInt64MnMx.Val2);
+    } else if (IsRangeUInt()) {
+        KeyChA += TUInt::GetStr(RangeUIntMnMx.Val1) + "," + TUInt::GetStr(RangeUIntMnMx.Val2);
+    } else if (IsRangeUInt16()) {
+        KeyChA += TStr::Fmt("%d,%d", (int)RangeUInt16MnMx.Val1.Val, (int)RangeUInt16MnMx.Val2.Val);
+    } else if (IsRangeUInt64() || IsRangeTm()) {
+        KeyChA += TUInt64::GetStr(RangeUInt64MnMx.Val1) + "," + TUInt64::GetStr(RangeUInt64MnMx.Val2);
+    } else if (IsRangeFlt()) {
+        KeyChA += TStr::Fmt("%.17g,%.17g", RangeFltMnMx.Val1.Val, RangeFltMnMx.Val2.Val);
+    } else if (IsRangeSFlt()) {
+        KeyChA += TStr::Fmt("%.9g,%.9g", (double)RangeSFltMnMx.Val1.Val, (double)RangeSFltMnMx.Val2.Val);
+    } else if (IsStore()) {
+        StoreIdSet.AddKey(StoreId);
+        KeyChA += TUInt::GetStr(StoreId);
+    } else if (IsJoin()) {
+        // joined records come from the target store
+        StoreIdSet.AddKey(GetStoreId(Base));
+        KeyChA += TInt::GetStr(JoinId); KeyChA += ':';
+        if (!ItemV[0].GetCacheKey(Base, KeyChA, StoreIdSet)) { return false; }
+    } else {
+        // and, or, not: order of subordinate items does not matter
+        TStrV ItemKeyV(ItemV.Len(), 0);
+        for (const TQueryItem& Item : ItemV) {
+            TChA ItemKeyChA;
+            if (!Item.GetCacheKey(Base, ItemKeyChA, StoreIdSet)) { return false; }
+            ItemKeyV.Add(ItemKeyChA);
+        }
+        ItemKeyV.Sort();
+        for (int ItemN = 0; ItemN < ItemKeyV.Len(); ItemN++) {
+            if (ItemN > 0) { KeyChA += ','; }
+            KeyChA += ItemKeyV[ItemN];
+        }
+    }
+    KeyChA += ')';
+    return true;
+}
+
 bool TQueryItem::IsFq() const {
     if (IsGix() || IsTextPos() || IsGeo()) {
         // always weighted when only one key
@@ -5296,7 +5569,12 @@ TWPt<TStore> TQuery::GetStore(const TWPt<TBase>& Base) {
 }
 
 void TQuery::Sort(const TWPt<TBase>& Base, const PRecSet& RecSet) {
-    RecSet->SortByField(SortAscP, SortFieldId);
+    if (Limit != -1) {
+        // only the records kept by the limit need to be in order
+        RecSet->TopByField(SortAscP, SortFieldId, Offset + Limit);
+    } else {
+        RecSet->SortByField(SortAscP, SortFieldId);
+    }
 }
 
 PRecSet TQuery::GetLimit(const PRecSet& RecSet) {
@@ -5313,6 +5591,139 @@ bool TQuery::IsOk(const TWPt<TBase>& Base, TStr& MsgStr) const {
     }
 }
 
+bool TQuery::GetCacheKey(const TWPt<TBase>& Base, TChA& KeyChA, TUIntSet& StoreIdSet) const {
+    if (!QueryItem.GetCacheKey(Base, KeyChA, StoreIdSet)) { return false; }
+    KeyChA += TStr::Fmt("|%d:%d|%d:%d", SortFieldId.Val, SortAscP.Val ? 1 : 0, Limit.Val, Offset.Val);
+    return true;
+}
+
+///////////////////////////////
+// QMiner-Query-Cursor
+const int TQueryCursor::MnRangeLen = 1024;
+
+TQueryCursor::TQueryCursor(const TWPt<TBase>& _Base, const TQueryItem& _QueryItem, const int& Recs):
+        Base(_Base), QueryItem(_QueryItem), NextRecId(1), EndRecId(0), RangeLen(MnRangeLen) {
+
+    QmAssertR(IsCursor(Base, QueryItem), "Query can not be executed with a cursor");
+    Store = Base->GetStoreByStoreId(QueryItem.GetStoreId(Base));
+    if (Store->Empty()) { return; }
+    NextRecId = Store->GetFirstRecId();
+    EndRecId = Store->GetLastRecId();
+    // size the first range by the share of records we expect to match
+    if (Recs > 0 && !QueryItem.IsNegated()) {
+        const uint64 EstRecs = TMath::Mx(Base->EstimateRecs(QueryItem), (uint64)1);
+        RangeLen = TMath::Mx(RangeLen, 2 * (uint64)Recs * Store->GetRecs() / EstRecs);
+    }
+}
+
+bool TQueryCursor::IsFilter(const TWPt<TBase>& Base, const TQueryItem& QueryItem) {
+    if (QueryItem.IsGix() || QueryItem.IsStore() || QueryItem.IsRec()) {
+        return true;
+    } else if (QueryItem.IsRange()) {
+        // only ranges over single field can be checked on the records
+        return Base->GetIndexVoc()->GetKey(QueryItem.GetKeyId()).GetFields() == 1;
+    } else if (QueryItem.IsAnd() || QueryItem.IsOr() || QueryItem.IsNot()) {
+        for (int ItemN = 0; ItemN < QueryItem.GetItems(); ItemN++) {
+            if (!IsFilter(Base, QueryItem.GetItem(ItemN))) { return false; }
+        }
+        return true;
+    }
+    // text position, geo and join always read everything, record sets keep their own order
+    return false;
+}
+
+bool TQueryCursor::IsCursor(const TWPt<TBase>& Base, const TQueryItem& QueryItem) {
+    // ranges of record ids must be valid records
+    const TWPt<TStore> Store = Base->GetStoreByStoreId(QueryItem.GetStoreId(Base));
+    return Store->HasRecIdRange() && IsFilter(Base, QueryItem);
+}
+
+bool TQueryCursor::Next(TUInt64IntKdV& RecIdFqV) {
+    // skip records removed since the last step
+    if (!Store->Empty()) { NextRecId = TMath::Mx(NextRecId, Store->GetFirstRecId()); }
+    if (IsEnd()) { return false; }
+    // candidate records for this step
+    const uint64 LastRecId = TMath::Mn(NextRecId + RangeLen - 1, EndRecId);
+    TUInt64IntKdV RangeRecIdFqV((int)(LastRecId - NextRecId + 1), 0);
+    for (uint64 RecId = NextRecId; RecId <= LastRecId; RecId++) {
+        RangeRecIdFqV.Add(TUInt64IntKd(RecId, 1));
+    }
+    NextRecId = LastRecId + 1;
+    // each step covers twice as many records as the previous one
+    RangeLen *= 2;
+    // execute the query, results only need to be correct for the candidates
+    TPair<TBool, PRecSet> NotRecSet = Base->_Search(QueryItem, &RangeRecIdFqV);
+    TUInt64IntKdV ResRecIdFqV = NotRecSet.Val2->GetRecIdFqV();
+    if (!ResRecIdFqV.IsSorted()) { ResRecIdFqV.Sort(); }
+    // keep only the candidates, inverting when the results are negated
+    TUInt64IntKdV StepRecIdFqV;
+    if (NotRecSet.Val1) {
+        TSortedSet::Diff(RangeRecIdFqV, ResRecIdFqV, StepRecIdFqV);
+    } else {
+        TSortedSet::Intrs(ResRecIdFqV, RangeRecIdFqV, StepRecIdFqV);
+    }
+    RecIdFqV.AddV(StepRecIdFqV);
+    return true;
+}
+
+void TQueryCursor::GetRecs(const int& Recs, TUInt64IntKdV& RecIdFqV) {
+    const int StartRecs = RecIdFqV.Len();
+    while (RecIdFqV.Len() - StartRecs < Recs && Next(RecIdFqV)) { }
+}
+
+///////////////////////////////
+// QMiner-Query-Cache
+bool TQueryCache::TItem::IsValid(const TWPt<TBase>& Base) const {
+    for (const TPair<TUInt, TUInt64>& StoreVer : StoreVerV) {
+        if (!Base->IsStoreId(StoreVer.Val1)) { return false; }
+        if (Base->GetStoreByStoreId(StoreVer.Val1)->GetRecVer() != StoreVer.Val2) { return false; }
+    }
+    return true;
+}
+
+uint64 TQueryCache::TItem::GetMemUsed() const {
+    return sizeof(TItem) + RecSet->GetRecIdFqV().GetMemUsed() + StoreVerV.GetMemUsed();
+}
+
+bool TQueryCache::Get(const TWPt<TBase>& Base, const TStr& KeyStr, PRecSet& RecSet) {
+    PItem Item;
+    if (!Cache.Get(KeyStr, Item)) { Misses++; return false; }
+    if (!Item->IsValid(Base)) {
+        // stores changed since, results will be replaced
+        Cache.Del(KeyStr); Stales++; Misses++;
+        return false;
+    }
+    // mark as recently used
+    Cache.Put(KeyStr, Item);
+    RecSet = Item->RecSet; Hits++;
+    return true;
+}
+
+void TQueryCache::Put(const TWPt<TBase>& Base, const TStr& KeyStr,
+        const TUIntSet& StoreIdSet, const PRecSet& RecSet) {
+
+    PItem Item = new TItem(RecSet);
+    int KeyId = StoreIdSet.FFirstKeyId();
+    while (StoreIdSet.FNextKeyId(KeyId)) {
+        const uint StoreId = StoreIdSet.GetKey(KeyId);
+        Item->StoreVerV.Add(TPair<TUInt, TUInt64>(StoreId, Base->GetStoreByStoreId(StoreId)->GetRecVer()));
+    }
+    // results larger than the whole cache would only evict everything else
+    if ((int64)(Item->GetMemUsed() + KeyStr.GetMemUsed()) > Cache.GetMxMemUsed()) { return; }
+    Cache.Put(KeyStr, Item);
+}
+
+PJsonVal TQueryCache::GetStats() const {
+    PJsonVal StatVal = TJsonVal::NewObj();
+    StatVal->AddToObj("size", (double)Cache.GetMxMemUsed());
+    StatVal->AddToObj("used", (double)Cache.GetCurMemUsed());
+    StatVal->AddToObj("queries", Cache.Len());
+    StatVal->AddToObj("hits", (double)Hits.Val);
+    StatVal->AddToObj("misses", (double)Misses.Val);
+    StatVal->AddToObj("stales", (double)Stales.Val);
+    return StatVal;
+}
+
 ///////////////////////////////
 // GeoIndex
 TIntPr TGeoIndex::GetLocId(const TFltPr& Loc) const {
@@ -5389,6 +5800,31 @@ bool TGeoIndex::LocEquals(const TFltPr& Loc1, const TFltPr& Loc2) const {
     return (LocId1 == LocId2);
 }
 
+///////////////////////////////
+// B-Tree Index Parameters
+TBTreeIndexParam::TBTreeIndexParam(const int& _InternalCapacity, const int& _LeafCapacity,
+        const double& _FillFactor): InternalCapacity(_InternalCapacity),
+        LeafCapacity(_LeafCapacity), FillFactor(_FillFactor) {
+
+    QmAssertR(InternalCapacity >= 2, "B-tree internal node capacity must be at least 2");
+    QmAssertR(LeafCapacity >= 2, "B-tree leaf capacity must be at least 2");
+    QmAssertR(0.0 < FillFactor && FillFactor <= 1.0, "B-tree fill factor must be in (0, 1]");
+}
+
+TBTreeIndexParam::TBTreeIndexParam(const PJsonVal& ParamVal) {
+    TBTreeIndexParam DefParam;
+    *this = TBTreeIndexParam(
+        ParamVal->GetObjInt("internalCapacity", DefParam.InternalCapacity),
+        ParamVal->GetObjInt("leafCapacity", DefParam.LeafCapacity),
+        ParamVal->GetObjNum("fillFactor", DefParam.FillFactor));
+}
+
+bool TBTreeIndexParam::IsCustom() const {
+    TBTreeIndexParam DefParam;
+    return InternalCapacity != DefParam.InternalCapacity ||
+        LeafCapacity != DefParam.LeafCapacity || FillFactor != DefParam.FillFactor;
+}
+
 ///////////////////////////////
 // QMiner-Index
 TIndex::TQmGixKeyStr::TQmGixKeyStr(const TWPt<TBase>& _Base,
@@ -5495,21 +5931,36 @@ TIndex::TQmGixItemPos TIndex::TQmGixItemPos::Intersect(const TQmGixItemPos& Item
     return _Item;
 }
 
-bool TIndex::DoQueryFull(const TPt<TQmGixExpItemFull>& ExpItem, TVec<TQmGixItemFull>& RecIdFqV) const {
+bool TIndex::DoQueryFull(const TPt<TQmGixExpItemFull>& ExpItem, TVec<TQmGixItemFull>& RecIdFqV,
+        const TVec<TQmGixItemFull>* FilterRecIdFqV) const {
+
+    TFlushGuard FlushGuard(FlushLock);
     // clean if there is anything on the input
     RecIdFqV.Clr();
     // execute query
-    const bool Not = ExpItem->Eval(GixFull, RecIdFqV, SumMergerFull);
+    const bool Not = ExpItem->Eval(GixFull, RecIdFqV, SumMergerFull, FilterRecIdFqV);
     // make sure we are sorted
     Assert(RecIdFqV.IsSorted());
     // pass forward return result
     return Not;
 }
 
-bool TIndex::DoQuerySmall(const TPt<TQmGixExpItemSmall>& ExpItem, TVec<TQmGixItemFull>& RecIdFqV) const {
+bool TIndex::DoQuerySmall(const TPt<TQmGixExpItemSmall>& ExpItem, TVec<TQmGixItemFull>& RecIdFqV,
+        const TVec<TQmGixItemFull>* FilterRecIdFqV) const {
+
+    TFlushGuard FlushGuard(FlushLock);
+    // downgrade filter to small
+    TVec<TQmGixItemSmall> SmallFilterRecIdFqV;
+    if (FilterRecIdFqV != NULL) {
+        SmallFilterRecIdFqV.Gen(FilterRecIdFqV->Len(), 0);
+        for (const TQmGixItemFull& FilterRecIdFq : *FilterRecIdFqV) {
+            SmallFilterRecIdFqV.Add(TQmGixItemSmall((uint)FilterRecIdFq.Key, 0));
+        }
+    }
     // execute query
     TVec<TQmGixItemSmall> SmallRecIdFqV;
-    const bool Not = ExpItem->Eval(GixSmall, SmallRecIdFqV, SumMergerSmall);
+    const bool Not = ExpItem->Eval(GixSmall, SmallRecIdFqV, SumMergerSmall,
+        (FilterRecIdFqV != NULL) ? &SmallFilterRecIdFqV : NULL);
     // upgrade to full
     RecIdFqV.Gen(SmallRecIdFqV.Len(), 0);
     for (const TQmGixItemSmall& SmallRecIdFq : SmallRecIdFqV) {
@@ -5519,10 +5970,22 @@ bool TIndex::DoQuerySmall(const TPt<TQmGixExpItemSmall>& ExpItem, TVec<TQmGixIte
     return Not;
 }
 
-bool TIndex::DoQueryTiny(const TPt<TQmGixExpItemTiny>& ExpItem, TVec<TQmGixItemFull>& RecIdFqV) const {
+bool TIndex::DoQueryTiny(const TPt<TQmGixExpItemTiny>& ExpItem, TVec<TQmGixItemFull>& RecIdFqV,
+        const TVec<TQmGixItemFull>* FilterRecIdFqV) const {
+
+    TFlushGuard FlushGuard(FlushLock);
+    // downgrade filter to tiny
+    TVec<TQmGixItemTiny> TinyFilterRecIdV;
+    if (FilterRecIdFqV != NULL) {
+        TinyFilterRecIdV.Gen(FilterRecIdFqV->Len(), 0);
+        for (const TQmGixItemFull& FilterRecIdFq : *FilterRecIdFqV) {
+            TinyFilterRecIdV.Add(TQmGixItemTiny((uint)FilterRecIdFq.Key));
+        }
+    }
     // execute query
     TVec<TQmGixItemTiny> TinyRecIdV;
-    const bool Not = ExpItem->Eval(GixTiny, TinyRecIdV, MergerTiny);
+    const bool Not = ExpItem->Eval(GixTiny, TinyRecIdV, MergerTiny,
+        (FilterRecIdFqV != NULL) ? &TinyFilterRecIdV : NULL);
     // upgrade to full
     RecIdFqV.Gen(TinyRecIdV.Len(), 0);
     for (const TQmGixItemTiny& TinyRecId : TinyRecIdV) {
@@ -5643,6 +6106,8 @@ PIndex TIndex::New(const TStr& IndexFPath, const TFAccess& Access, const PIndexV
 
 TIndex::~TIndex() {
     if (!IsReadOnly()) {
+        // apply updates deferred by unfinished batches
+        if (!BatchGixV.Empty() || IsBatch()) { FlushBatch(); }
         {
             TEnv::Logger->OnStatus("Saving and closing inverted index - full");
             GixFull.Clr();
@@ -5657,24 +6122,7 @@ TIndex::~TIndex() {
             GixPos.Clr();
             delete MergerPos;
         }
-        {
-            TEnv::Logger->OnStatus("Saving and closing location index");
-            TFOut SphereFOut(IndexFPath + "Index.Geo");
-            GeoIndexH.Save(SphereFOut);
-        }
-        {
-            TEnv::Logger->OnStatus("Saving and closing btree index");
-            TFOut BTreeFOut(IndexFPath + "Index.BTree");
-            BTreeIndexByteH.Save(BTreeFOut);
-            BTreeIndexIntH.Save(BTreeFOut);
-            BTreeIndexInt16H.Save(BTreeFOut);
-            BTreeIndexInt64H.Save(BTreeFOut);
-            BTreeIndexUIntH.Save(BTreeFOut);
-            BTreeIndexUInt16H.Save(BTreeFOut);
-            BTreeIndexUInt64H.Save(BTreeFOut);
-            BTreeIndexFltH.Save(BTreeFOut);
-            BTreeIndexSFltH.Save(BTreeFOut);
-        }
+        SaveTrees();
         TEnv::Logger->OnStatus("Index closed");
     } else {
         TEnv::Logger->OnStatus("Index opened in read-only mode, no saving needed");
@@ -5728,6 +6176,13 @@ void TIndex::IndexGix(const int& KeyId, const uint64& WordId, const uint64& RecI
     Assert(KeyId != -1);
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    // defer until the end of the batch, merging full runs right away
+    if (IsBatch()) {
+        BatchGixV.Add(TQuad<TInt, TUInt64, TUInt64, TInt>(KeyId, WordId, RecId, RecFq));
+        if (BatchGixV.Len() >= MxBatchGixLen) { FlushBatch(); }
+        return;
+    }
+    TFlushGuard FlushGuard(FlushLock);
     // check which Gix to use
     const TIndexKeyGixType GixType = GetGixType(KeyId);
     // send to appropriate index
@@ -5743,6 +6198,86 @@ void TIndex::IndexGix(const int& KeyId, const uint64& WordId, const uint64& RecI
     }
 }
 
+const int TIndex::MxBatchGixLen = 8 * 1024 * 1024;
+
+void TIndex::NewBTreeIndex(const int& KeyId, const TIndexKeySortType& SortType, const TBTreeIndexParam& Param) {
+    // we shouldn't modify read-only index
+    QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    switch (SortType) {
+    case oikstAsByte: BTreeIndexByteH.AddDat(KeyId, TBTreeIndex<TUCh>::New(Param)); break;
+    case oikstAsInt: BTreeIndexIntH.AddDat(KeyId, TBTreeIndex<TInt>::New(Param)); break;
+    case oikstAsInt16: BTreeIndexInt16H.AddDat(KeyId, TBTreeIndex<TInt16>::New(Param)); break;
+    case oikstAsInt64: BTreeIndexInt64H.AddDat(KeyId, TBTreeIndex<TInt64>::New(Param)); break;
+    case oikstAsUInt: BTreeIndexUIntH.AddDat(KeyId, TBTreeIndex<TUInt>::New(Param)); break;
+    case oikstAsUInt16: BTreeIndexUInt16H.AddDat(KeyId, TBTreeIndex<TUInt16>::New(Param)); break;
+    case oikstAsUInt64: case oikstAsTm:
+        BTreeIndexUInt64H.AddDat(KeyId, TBTreeIndex<TUInt64>::New(Param)); break;
+    case oikstAsFlt: BTreeIndexFltH.AddDat(KeyId, TBTreeIndex<TFlt>::New(Param)); break;
+    case oikstAsSFlt: BTreeIndexSFltH.AddDat(KeyId, TBTreeIndex<TSFlt>::New(Param)); break;
+    default: throw TQmExcept::New("[TIndex::NewBTreeIndex] Unsupported sort type!");
+    }
+}
+
+void TIndex::EndBatch() {
+    QmAssertR(IsBatch(), "[TIndex::EndBatch] No batch in progress");
+    BatchN--;
+    if (!IsBatch()) { FlushBatch(); }
+}
+
+void TIndex::FlushBatch() {
+    TFlushGuard FlushGuard(FlushLock);
+    // sort postings so all items for one (key, word) form one sorted run
+    BatchGixV.Sort();
+    TVec<TQmGixItemFull> ItemFullV; TVec<TQmGixItemSmall> ItemSmallV; TVec<TQmGixItemTiny> ItemTinyV;
+    int PostingN = 0;
+    while (PostingN < BatchGixV.Len()) {
+        const int KeyId = BatchGixV[PostingN].Val1;
+        const uint64 WordId = BatchGixV[PostingN].Val2;
+        const TIndexKeyGixType GixType = GetGixType(KeyId);
+        ItemFullV.Clr(false); ItemSmallV.Clr(false); ItemTinyV.Clr(false);
+        for (; PostingN < BatchGixV.Len(); PostingN++) {
+            const TQuad<TInt, TUInt64, TUInt64, TInt>& Posting = BatchGixV[PostingN];
+            if (Posting.Val1 != KeyId || Posting.Val2 != WordId) { break; }
+            const uint64 RecId = Posting.Val3;
+            const int RecFq = Posting.Val4;
+            // same record can be indexed under the same word more than once
+            switch (GixType) {
+            case oikgtFull:
+                if (!ItemFullV.Empty() && ItemFullV.Last().Key.Val == RecId) { ItemFullV.Last().Dat.Val += RecFq; }
+                else { ItemFullV.Add(TQmGixItemFull(RecId, RecFq)); }
+                break;
+            case oikgtSmall:
+                if (!ItemSmallV.Empty() && ItemSmallV.Last().Key.Val == (uint)RecId) { ItemSmallV.Last().Dat.Val += (int16)RecFq; }
+                else { ItemSmallV.Add(TQmGixItemSmall((uint)RecId, (int16)RecFq)); }
+                break;
+            case oikgtTiny:
+                if (ItemTinyV.Empty() || ItemTinyV.Last().Val != (uint)RecId) { ItemTinyV.Add(TQmGixItemTiny((uint)RecId)); }
+                break;
+            default:
+                throw TQmExcept::New("[TIndex::FlushBatch] Unsupported gix type!");
+            }
+        }
+        // extend the item set once
+        switch (GixType) {
+        case oikgtFull: GixFull->AddItemV(TKeyWord(KeyId, WordId), ItemFullV); break;
+        case oikgtSmall: GixSmall->AddItemV(TKeyWord(KeyId, WordId), ItemSmallV); break;
+        case oikgtTiny: GixTiny->AddItemV(TKeyWord(KeyId, WordId), ItemTinyV); break;
+        default: break;
+        }
+    }
+    BatchGixV.Clr();
+    // b-tree indexes
+    FlushBatchLinear(BatchByteH, BTreeIndexByteH);
+    FlushBatchLinear(BatchIntH, BTreeIndexIntH);
+    FlushBatchLinear(BatchInt16H, BTreeIndexInt16H);
+    FlushBatchLinear(BatchInt64H, BTreeIndexInt64H);
+    FlushBatchLinear(BatchUIntH, BTreeIndexUIntH);
+    FlushBatchLinear(BatchUInt16H, BTreeIndexUInt16H);
+    FlushBatchLinear(BatchUInt64H, BTreeIndexUInt64H);
+    FlushBatchLinear(BatchFltH, BTreeIndexFltH);
+    FlushBatchLinear(BatchSFltH, BTreeIndexSFltH);
+}
+
 void TIndex::DeleteValue(const int& KeyId, const TStr& WordStr, const uint64& RecId) {
     const uint64 WordId = IndexVoc->AddWordStr(KeyId, WordStr);
     DeleteGix(KeyId, WordId, RecId, 1);
@@ -5790,6 +6325,9 @@ void TIndex::DeleteGix(const int& KeyId, const uint64& WordId, const uint64& Rec
     Assert(KeyId != -1);
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    // deferred postings might include the deleted ones
+    if (IsBatch()) { FlushBatch(); }
+    TFlushGuard FlushGuard(FlushLock);
     // check which Gix to use
     const TIndexKeyGixType GixType = GetGixType(KeyId);
     // are we deleting all items or just few occurences?
@@ -5889,6 +6427,28 @@ void TIndex::DeleteGeo(const int& KeyId, const TFltPr& Loc, const uint64& RecId)
     if (GeoIndexH.IsKey(KeyId)) { GeoIndexH.GetDat(KeyId)->DelKey(Loc, RecId); }
 }
 
+void TIndex::DeleteRecsBefore(const uint& StoreId, const uint64& RecId) {
+    // we shouldn't modify read-only index
+    QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    // deferred postings might include the deleted ones
+    if (IsBatch()) { FlushBatch(); }
+    if (!IndexVoc->IsStoreKeys(StoreId)) { return; }
+    TFlushGuard FlushGuard(FlushLock);
+    // internal join keys hold records of other stores, joins are deleted one by one
+    const TIntSet& KeySet = IndexVoc->GetStoreKeys(StoreId);
+    TIntSet FieldKeyIdSet;
+    int KeySetId = KeySet.FFirstKeyId();
+    while (KeySet.FNextKeyId(KeySetId)) {
+        const int KeyId = KeySet.GetKey(KeySetId);
+        if (!IndexVoc->GetKey(KeyId).IsInternal()) { FieldKeyIdSet.AddKey(KeyId); }
+    }
+    // inverted indexes
+    DelGixItemsBefore(GixFull, FieldKeyIdSet, TQmGixItemFull(RecId, 0));
+    DelGixItemsBefore(GixSmall, FieldKeyIdSet, TQmGixItemSmall((uint)RecId, 0));
+    DelGixItemsBefore(GixTiny, FieldKeyIdSet, TQmGixItemTiny((uint)RecId));
+    DelGixItemsBefore(GixPos, FieldKeyIdSet, TQmGixItemPos(RecId));
+}
+
 bool TIndex::LocEquals(const int& KeyId, const TFltPr& Loc1, const TFltPr& Loc2) const {
     return GeoIndexH.IsKey(KeyId) ? GeoIndexH.GetDat(KeyId)->LocEquals(Loc1, Loc2) : false;
 }
@@ -5896,6 +6456,8 @@ bool TIndex::LocEquals(const int& KeyId, const TFltPr& Loc1, const TFltPr& Loc2)
 void TIndex::IndexLinear(const int& KeyId, const uchar& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    // defer until the end of the batch
+    if (IsBatch()) { BatchByteH.AddDat(KeyId).Add(TPair<TUCh, TUInt64>(Val, RecId)); return; }
     // if new key, create sphere first
     if (!BTreeIndexByteH.IsKey(KeyId)) { BTreeIndexByteH.AddDat(KeyId, PBTreeIndexUCh::New()); }
     // index new location
@@ -5905,6 +6467,8 @@ void TIndex::IndexLinear(const int& KeyId, const uchar& Val, const uint64& RecId
 void TIndex::IndexLinear(const int& KeyId, const int& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    // defer until the end of the batch
+    if (IsBatch()) { BatchIntH.AddDat(KeyId).Add(TPair<TInt, TUInt64>(Val, RecId)); return; }
     // if new key, create sphere first
     if (!BTreeIndexIntH.IsKey(KeyId)) { BTreeIndexIntH.AddDat(KeyId, PBTreeIndexInt::New()); }
     // index new location
@@ -5914,6 +6478,8 @@ void TIndex::IndexLinear(const int& KeyId, const int& Val, const uint64& RecId)
 void TIndex::IndexLinear(const int& KeyId, const int16& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    // defer until the end of the batch
+    if (IsBatch()) { BatchInt16H.AddDat(KeyId).Add(TPair<TInt16, TUInt64>(Val, RecId)); return; }
     // if new key, create sphere first
     if (!BTreeIndexInt16H.IsKey(KeyId)) { BTreeIndexInt16H.AddDat(KeyId, PBTreeIndexInt16::New()); }
     // index new location
@@ -5923,6 +6489,8 @@ void TIndex::IndexLinear(const int& KeyId, const int16& Val, const uint64& RecId
 void TIndex::IndexLinear(const int& KeyId, const int64& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    // defer until the end of the batch
+    if (IsBatch()) { BatchInt64H.AddDat(KeyId).Add(TPair<TInt64, TUInt64>(Val, RecId)); return; }
     // if new key, create sphere first
     if (!BTreeIndexInt64H.IsKey(KeyId)) { BTreeIndexInt64H.AddDat(KeyId, PBTreeIndexInt64::New()); }
     // index new location
@@ -5932,6 +6500,8 @@ void TIndex::IndexLinear(const int& KeyId, const int64& Val, const uint64& RecId
 void TIndex::IndexLinear(const int& KeyId, const uint& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    // defer until the end of the batch
+    if (IsBatch()) { BatchUIntH.AddDat(KeyId).Add(TPair<TUInt, TUInt64>(Val, RecId)); return; }
     // if new key, create sphere first
     if (!BTreeIndexUIntH.IsKey(KeyId)) { BTreeIndexUIntH.AddDat(KeyId, PBTreeIndexUInt::New()); }
     // index new location
@@ -5941,6 +6511,8 @@ void TIndex::IndexLinear(const int& KeyId, const uint& Val, const uint64& RecId)
 void TIndex::IndexLinear(const int& KeyId, const uint16& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    // defer until the end of the batch
+    if (IsBatch()) { BatchUInt16H.AddDat(KeyId).Add(TPair<TUInt16, TUInt64>(Val, RecId)); return; }
     // if new key, create sphere first
     if (!BTreeIndexUInt16H.IsKey(KeyId)) { BTreeIndexUInt16H.AddDat(KeyId, PBTreeIndexUInt16::New()); }
     // index new location
@@ -5950,6 +6522,8 @@ void TIndex::IndexLinear(const int& KeyId, const uint16& Val, const uint64& RecI
 void TIndex::IndexLinear(const int& KeyId, const uint64& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    // defer until the end of the batch
+    if (IsBatch()) { BatchUInt64H.AddDat(KeyId).Add(TPair<TUInt64, TUInt64>(Val, RecId)); return; }
     // if new key, create sphere first
     if (!BTreeIndexUInt64H.IsKey(KeyId)) { BTreeIndexUInt64H.AddDat(KeyId, PBTreeIndexUInt64::New()); }
     // index new location
@@ -5960,6 +6534,8 @@ void TIndex::IndexLinear(const int& KeyId, const uint64& Val, const uint64& RecI
 void TIndex::IndexLinear(const int& KeyId, const double& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    // defer until the end of the batch
+    if (IsBatch()) { BatchFltH.AddDat(KeyId).Add(TPair<TFlt, TUInt64>(Val, RecId)); return; }
     // if new key, create sphere first
     if (!BTreeIndexFltH.IsKey(KeyId)) { BTreeIndexFltH.AddDat(KeyId, PBTreeIndexFlt::New()); }
     // index new location
@@ -5969,6 +6545,8 @@ void TIndex::IndexLinear(const int& KeyId, const double& Val, const uint64& RecI
 void TIndex::IndexLinear(const int& KeyId, const float& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    // defer until the end of the batch
+    if (IsBatch()) { BatchSFltH.AddDat(KeyId).Add(TPair<TSFlt, TUInt64>(Val, RecId)); return; }
     // if new key, create sphere first
     if (!BTreeIndexSFltH.IsKey(KeyId)) { BTreeIndexSFltH.AddDat(KeyId, PBTreeIndexSFlt::New()); }
     // index new location
@@ -5978,6 +6556,8 @@ void TIndex::IndexLinear(const int& KeyId, const float& Val, const uint64& RecId
 void TIndex::DeleteLinear(const int& KeyId, const uchar& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    // deferred values might include the deleted one
+    if (IsBatch()) { FlushBatch(); }
     // delete only if index exist
     if (BTreeIndexByteH.IsKey(KeyId)) { BTreeIndexByteH.GetDat(KeyId)->DelKey(Val, RecId); }
 }
@@ -5985,6 +6565,8 @@ void TIndex::DeleteLinear(const int& KeyId, const uchar& Val, const uint64& RecI
 void TIndex::DeleteLinear(const int& KeyId, const int& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    // deferred values might include the deleted one
+    if (IsBatch()) { FlushBatch(); }
     // delete only if index exist
     if (BTreeIndexIntH.IsKey(KeyId)) { BTreeIndexIntH.GetDat(KeyId)->DelKey(Val, RecId); }
 }
@@ -5992,6 +6574,8 @@ void TIndex::DeleteLinear(const int& KeyId, const int& Val, const uint64& RecId)
 void TIndex::DeleteLinear(const int& KeyId, const int16& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    // deferred values might include the deleted one
+    if (IsBatch()) { FlushBatch(); }
     // delete only if index exist
     if (BTreeIndexInt16H.IsKey(KeyId)) { BTreeIndexInt16H.GetDat(KeyId)->DelKey(Val, RecId); }
 }
@@ -5999,6 +6583,8 @@ void TIndex::DeleteLinear(const int& KeyId, const int16& Val, const uint64& RecI
 void TIndex::DeleteLinear(const int& KeyId, const int64& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    // deferred values might include the deleted one
+    if (IsBatch()) { FlushBatch(); }
     // delete only if index exist
     if (BTreeIndexInt64H.IsKey(KeyId)) { BTreeIndexInt64H.GetDat(KeyId)->DelKey(Val, RecId); }
 }
@@ -6006,6 +6592,8 @@ void TIndex::DeleteLinear(const int& KeyId, const int64& Val, const uint64& RecI
 void TIndex::DeleteLinear(const int& KeyId, const uint& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    // deferred values might include the deleted one
+    if (IsBatch()) { FlushBatch(); }
     // delete only if index exist
     if (BTreeIndexUIntH.IsKey(KeyId)) { BTreeIndexUIntH.GetDat(KeyId)->DelKey(Val, RecId); }
 }
@@ -6013,6 +6601,8 @@ void TIndex::DeleteLinear(const int& KeyId, const uint& Val, const uint64& RecId
 void TIndex::DeleteLinear(const int& KeyId, const uint16& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    // deferred values might include the deleted one
+    if (IsBatch()) { FlushBatch(); }
     // delete only if index exist
     if (BTreeIndexUInt16H.IsKey(KeyId)) { BTreeIndexUInt16H.GetDat(KeyId)->DelKey(Val, RecId); }
 }
@@ -6020,6 +6610,8 @@ void TIndex::DeleteLinear(const int& KeyId, const uint16& Val, const uint64& Rec
 void TIndex::DeleteLinear(const int& KeyId, const uint64& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    // deferred values might include the deleted one
+    if (IsBatch()) { FlushBatch(); }
     // delete only if index exist
     if (BTreeIndexUInt64H.IsKey(KeyId)) { BTreeIndexUInt64H.GetDat(KeyId)->DelKey(Val, RecId); }
 }
@@ -6027,6 +6619,8 @@ void TIndex::DeleteLinear(const int& KeyId, const uint64& Val, const uint64& Rec
 void TIndex::DeleteLinear(const int& KeyId, const double& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    // deferred values might include the deleted one
+    if (IsBatch()) { FlushBatch(); }
     // delete only if index exist
     if (BTreeIndexFltH.IsKey(KeyId)) { BTreeIndexFltH.GetDat(KeyId)->DelKey(Val, RecId); }
 }
@@ -6034,6 +6628,8 @@ void TIndex::DeleteLinear(const int& KeyId, const double& Val, const uint64& Rec
 void TIndex::DeleteLinear(const int& KeyId, const float& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    // deferred values might include the deleted one
+    if (IsBatch()) { FlushBatch(); }
     // delete only if index exist
     if (BTreeIndexSFltH.IsKey(KeyId)) { BTreeIndexSFltH.GetDat(KeyId)->DelKey(Val, RecId); }
 }
@@ -6061,7 +6657,9 @@ PRecSet TIndex::SearchGix(const TWPt<TBase>& Base, const int& KeyId, const uint6
     return TRecSet::New(Base->GetStoreByStoreId(StoreId), RecIdFqV);
 }
 
-PRecSet TIndex::SearchGixAnd(const TWPt<TBase>& Base, const int& KeyId, const TUInt64V& WordIdV) const {
+PRecSet TIndex::SearchGixAnd(const TWPt<TBase>& Base, const int& KeyId, const TUInt64V& WordIdV,
+        const TUInt64IntKdV* FilterRecIdFqV) const {
+
     // prepare Gix keys
     TKeyWordV KeyWordV(WordIdV.Len(), 0);
     for (const uint64 WordId : WordIdV) {
@@ -6074,11 +6672,11 @@ PRecSet TIndex::SearchGixAnd(const TWPt<TBase>& Base, const int& KeyId, const TU
     // go to appropriate gix and always first check if we have the key at all
     switch (GixType) {
     case oikgtFull:
-        DoQueryFull(TQmGixExpItemFull::NewAndV(KeyWordV), RecIdFqV); break;
+        DoQueryFull(TQmGixExpItemFull::NewAndV(KeyWordV), RecIdFqV, FilterRecIdFqV); break;
     case oikgtSmall:
-        DoQuerySmall(TQmGixExpItemSmall::NewAndV(KeyWordV), RecIdFqV); break;
+        DoQuerySmall(TQmGixExpItemSmall::NewAndV(KeyWordV), RecIdFqV, FilterRecIdFqV); break;
     case oikgtTiny:
-        DoQueryTiny(TQmGixExpItemTiny::NewAndV(KeyWordV), RecIdFqV); break;
+        DoQueryTiny(TQmGixExpItemTiny::NewAndV(KeyWordV), RecIdFqV, FilterRecIdFqV); break;
     default:
         throw TQmExcept::New("[TIndex::SearchGixAnd] Unsupported gix type!");
     }
@@ -6087,7 +6685,9 @@ PRecSet TIndex::SearchGixAnd(const TWPt<TBase>& Base, const int& KeyId, const TU
     return TRecSet::New(Base->GetStoreByStoreId(StoreId), RecIdFqV);
 }
 
-PRecSet TIndex::SearchGixOr(const TWPt<TBase>& Base, const int& KeyId, const TUInt64V& WordIdV) const {
+PRecSet TIndex::SearchGixOr(const TWPt<TBase>& Base, const int& KeyId, const TUInt64V& WordIdV,
+        const TUInt64IntKdV* FilterRecIdFqV) const {
+
     // prepare Gix keys
     TKeyWordV KeyWordV(WordIdV.Len(), 0);
     for (const uint64 WordId : WordIdV) {
@@ -6100,11 +6700,11 @@ PRecSet TIndex::SearchGixOr(const TWPt<TBase>& Base, const int& KeyId, const TUI
     // go to appropriate gix and always first check if we have the key at all
     switch (GixType) {
     case oikgtFull:
-        DoQueryFull(TQmGixExpItemFull::NewOrV(KeyWordV), RecIdFqV); break;
+        DoQueryFull(TQmGixExpItemFull::NewOrV(KeyWordV), RecIdFqV, FilterRecIdFqV); break;
     case oikgtSmall:
-        DoQuerySmall(TQmGixExpItemSmall::NewOrV(KeyWordV), RecIdFqV); break;
+        DoQuerySmall(TQmGixExpItemSmall::NewOrV(KeyWordV), RecIdFqV, FilterRecIdFqV); break;
     case oikgtTiny:
-        DoQueryTiny(TQmGixExpItemTiny::NewOrV(KeyWordV), RecIdFqV); break;
+        DoQueryTiny(TQmGixExpItemTiny::NewOrV(KeyWordV), RecIdFqV, FilterRecIdFqV); break;
     default:
         throw TQmExcept::New("[TIndex::SearchGixOr] Unsupported gix type!");
     }
@@ -6282,8 +6882,63 @@ PRecSet TIndex::SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TS
     return TRecSet::New(Base->GetStoreByStoreId(StoreId), RecIdV);
 }
 
+uint64 TIndex::GetGixRecs(const int& KeyId, const uint64& WordId) const {
+    TFlushGuard FlushGuard(FlushLock);
+    TKeyWord KeyWord(KeyId, WordId);
+    // check which Gix to use
+    const TIndexKeyGixType GixType = GetGixType(KeyId);
+    // item set counts are kept up to date, so no need to load any items
+    switch (GixType) {
+    case oikgtFull:
+        return GixFull->IsKey(KeyWord) ? (uint64)GixFull->GetItemSet(KeyWord)->GetItems() : 0;
+    case oikgtSmall:
+        return GixSmall->IsKey(KeyWord) ? (uint64)GixSmall->GetItemSet(KeyWord)->GetItems() : 0;
+    case oikgtTiny:
+        return GixTiny->IsKey(KeyWord) ? (uint64)GixTiny->GetItemSet(KeyWord)->GetItems() : 0;
+    default:
+        throw TQmExcept::New("[TIndex::GetGixRecs] Unsupported gix type!");
+    }
+}
+
+uint64 TIndex::GetLinearRecs(const int& KeyId, const TUChPr& RangeMinMax) const {
+    return BTreeIndexByteH.IsKey(KeyId) ? BTreeIndexByteH.GetDat(KeyId)->GetRangeRecs(RangeMinMax) : 0;
+}
+
+uint64 TIndex::GetLinearRecs(const int& KeyId, const TIntPr& RangeMinMax) const {
+    return BTreeIndexIntH.IsKey(KeyId) ? BTreeIndexIntH.GetDat(KeyId)->GetRangeRecs(RangeMinMax) : 0;
+}
+
+uint64 TIndex::GetLinearRecs(const int& KeyId, const TInt16Pr& RangeMinMax) const {
+    return BTreeIndexInt16H.IsKey(KeyId) ? BTreeIndexInt16H.GetDat(KeyId)->GetRangeRecs(RangeMinMax) : 0;
+}
+
+uint64 TIndex::GetLinearRecs(const int& KeyId, const TInt64Pr& RangeMinMax) const {
+    return BTreeIndexInt64H.IsKey(KeyId) ? BTreeIndexInt64H.GetDat(KeyId)->GetRangeRecs(RangeMinMax) : 0;
+}
+
+uint64 TIndex::GetLinearRecs(const int& KeyId, const TUIntUIntPr& RangeMinMax) const {
+    return BTreeIndexUIntH.IsKey(KeyId) ? BTreeIndexUIntH.GetDat(KeyId)->GetRangeRecs(RangeMinMax) : 0;
+}
+
+uint64 TIndex::GetLinearRecs(const int& KeyId, const TUInt16Pr& RangeMinMax) const {
+    return BTreeIndexUInt16H.IsKey(KeyId) ? BTreeIndexUInt16H.GetDat(KeyId)->GetRangeRecs(RangeMinMax) : 0;
+}
+
+uint64 TIndex::GetLinearRecs(const int& KeyId, const TUInt64Pr& RangeMinMax) const {
+    return BTreeIndexUInt64H.IsKey(KeyId) ? BTreeIndexUInt64H.GetDat(KeyId)->GetRangeRecs(RangeMinMax) : 0;
+}
+
+uint64 TIndex::GetLinearRecs(const int& KeyId, const TFltPr& RangeMinMax) const {
+    return BTreeIndexFltH.IsKey(KeyId) ? BTreeIndexFltH.GetDat(KeyId)->GetRangeRecs(RangeMinMax) : 0;
+}
+
+uint64 TIndex::GetLinearRecs(const int& KeyId, const TSFltPr& RangeMinMax) const {
+    return BTreeIndexSFltH.IsKey(KeyId) ? BTreeIndexSFltH.GetDat(KeyId)->GetRangeRecs(RangeMinMax) : 0;
+}
+
 bool TIndex::HasJoin(const int& JoinKeyId, const uint64& RecId) const
 {
+    TFlushGuard FlushGuard(FlushLock);
     TKeyWord KeyWord(JoinKeyId, RecId);
     // check which Gix to use
     const TIndexKeyGixType GixType = GetGixType(JoinKeyId);
@@ -6301,12 +6956,14 @@ bool TIndex::HasJoin(const int& JoinKeyId, const uint64& RecId) const
 }
 
 void TIndex::SaveTxt(const TWPt<TBase>& Base, const TStr& FNm) {
+    TFlushGuard FlushGuard(FlushLock);
     GixFull->SaveTxt(FNm + ".full", TQmGixKeyStr::New(Base, IndexVoc));
     GixSmall->SaveTxt(FNm + ".small", TQmGixKeyStr::New(Base, IndexVoc));
     GixTiny->SaveTxt(FNm + ".tiny", TQmGixKeyStr::New(Base, IndexVoc));
 }
 
 TBlobBsStats TIndex::GetBlobStats() const {
+    TFlushGuard FlushGuard(FlushLock);
     TBlobBsStats Stats = GixFull->GetBlobStats();
     Stats.Add(GixSmall->GetBlobStats());
     Stats.Add(GixTiny->GetBlobStats());
@@ -6314,6 +6971,7 @@ TBlobBsStats TIndex::GetBlobStats() const {
 }
 
 TGixStats TIndex::GetGixStats(const bool& RefreshP) const {
+    TFlushGuard FlushGuard(FlushLock);
     TGixStats Stats = GixFull->GetGixStats(RefreshP);
     Stats.Add(GixSmall->GetGixStats(RefreshP));
     Stats.Add(GixTiny->GetGixStats(RefreshP));
@@ -6328,13 +6986,55 @@ int TIndex::GetSplitLen() const {
     return GixFull->GetSplitLen();
 }
 
+void TIndex::SetCachePolicy(const TCachePolicy& Policy) {
+    TFlushGuard FlushGuard(FlushLock);
+    GixFull->SetCachePolicy(Policy);
+    GixSmall->SetCachePolicy(Policy);
+    GixTiny->SetCachePolicy(Policy);
+}
+
 void TIndex::ResetStats() {
+    TFlushGuard FlushGuard(FlushLock);
     GixFull->ResetStats();
     GixSmall->ResetStats();
     GixTiny->ResetStats();
 }
 
+void TIndex::SaveTrees() const {
+    {
+        TEnv::Logger->OnStatus("Saving location index");
+        TFOut SphereFOut(IndexFPath + "Index.Geo");
+        GeoIndexH.Save(SphereFOut);
+    }
+    {
+        TEnv::Logger->OnStatus("Saving btree index");
+        TFOut BTreeFOut(IndexFPath + "Index.BTree");
+        BTreeIndexByteH.Save(BTreeFOut);
+        BTreeIndexIntH.Save(BTreeFOut);
+        BTreeIndexInt16H.Save(BTreeFOut);
+        BTreeIndexInt64H.Save(BTreeFOut);
+        BTreeIndexUIntH.Save(BTreeFOut);
+        BTreeIndexUInt16H.Save(BTreeFOut);
+        BTreeIndexUInt64H.Save(BTreeFOut);
+        BTreeIndexFltH.Save(BTreeFOut);
+        BTreeIndexSFltH.Save(BTreeFOut);
+    }
+}
+
+void TIndex::Flush() {
+    QmAssertR(!IsReadOnly(), "Cannot flush index opened in read-only mode");
+    TFlushGuard FlushGuard(FlushLock);
+    // apply updates deferred by unfinished batches
+    if (!BatchGixV.Empty() || IsBatch()) { FlushBatch(); }
+    GixFull->Save();
+    GixSmall->Save();
+    GixTiny->Save();
+    GixPos->Save();
+    SaveTrees();
+}
+
 int TIndex::PartialFlush(const int& WndInMsec) {
+    TFlushGuard FlushGuard(FlushLock);
     const int WndInMsecPerGix = WndInMsec / 3;
     int Res = 0;
     Res += GixFull->PartialFlush(WndInMsecPerGix);
@@ -6343,6 +7043,11 @@ int TIndex::PartialFlush(const int& WndInMsec) {
     return Res;
 }
 
+uint64 TIndex::GetDirtyBytes() const {
+    TFlushGuard FlushGuard(FlushLock);
+    return GixFull->GetDirtyBytes() + GixSmall->GetDirtyBytes() + GixTiny->GetDirtyBytes();
+}
+
 ///////////////////////////////
 // QMiner-Aggregator
 TFunRouter<PAggr, TAggr::TNewF> TAggr::NewRouter;
@@ -6377,6 +7082,7 @@ void TStreamAggr::Init() {
     Register<TStreamAggrs::TWinBufFtrSpVec>();
     Register<TStreamAggrs::TWinBufFltV>();
     Register<TStreamAggrs::TWinBufSpV>();
+    Register<TStreamAggrs::TWinBufDenseV>();
     Register<TStreamAggrs::TWinBufSum>();
     Register<TStreamAggrs::TWinBufMin>();
     Register<TStreamAggrs::TWinBufMax>();
@@ -6401,6 +7107,8 @@ void TStreamAggr::Init() {
     Register<TStreamAggrs::TRecFilterAggr>();
     Register<TStreamAggrs::TEmaSpVec>();
     Register<TStreamAggrs::TWinBufSpVecSum>();
+    Register<TStreamAggrs::TWinBufMultiStats>();
+    Register<TStreamAggrs::TPipeline>();
     Register<TStreamAggrs::TRecSwitchAggr>();
     Register<TStreamAggrs::THistogramAD>();
 }
@@ -6443,6 +7151,18 @@ PJsonVal TStreamAggr::SaveStateJson() const {
     throw TQmExcept::New("TStreamAggr::SaveStateJson not implemented:" + GetAggrNm());
 };
 
+void TStreamAggr::OnAddRecBatch(const TRecSet& RecSet, const TWPt<TStreamAggr>& CallerAggr) {
+    for (int RecN = 0; RecN < RecSet.GetRecs(); RecN++) {
+        OnAddRec(RecSet.GetRec(RecN), CallerAggr);
+    }
+}
+
+void TStreamAggr::OnTimeBatch(const TUInt64V& TmMSecsV, const TWPt<TStreamAggr>& CallerAggr) {
+    for (int TmN = 0; TmN < TmMSecsV.Len(); TmN++) {
+        OnTime(TmMSecsV[TmN], CallerAggr);
+    }
+}
+
 uint64 TStreamAggr::GetMemUsed() const {
     // sizeof(TStreamAggr) returns the size of this class including all its members and
     // alignment, but discards the size of any pointers that the members hold which
@@ -6455,15 +7175,59 @@ uint64 TStreamAggr::GetMemUsed() const {
 
 ///////////////////////////////
 // QMiner-Stream-Aggregator-Set
-TStreamAggrSet::TStreamAggrSet(const TWPt<TBase>& _Base, const TStr& _AggrNm):
-    TStreamAggr(_Base, _AggrNm) { }
-
-TStreamAggrSet::TStreamAggrSet(const TWPt<TBase>& _Base, const PJsonVal& ParamVal):
-        TStreamAggr(_Base, ParamVal) {
+void TStreamAggrSet::BuildSchedule() {
+    BatchOrderP = true; LevelV.Clr();
+    THash<TStr, TInt> AggrNmToLevelH;
+    for (int AggrN = 0; AggrN < StreamAggrV.Len() && BatchOrderP; AggrN++) {
+        const TWPt<TStreamAggr>& StreamAggr = StreamAggrV[AggrN];
+        if (!StreamAggr->IsBatch()) { BatchOrderP = false; break; }
+        // inputs must be updated by this set before the aggregate,
+        // which can run one level after the deepest of them
+        TStrV InAggrNmV; StreamAggr->GetInAggrNmV(InAggrNmV);
+        int Level = 0;
+        for (const TStr& InAggrNm : InAggrNmV) {
+            if (!AggrNmToLevelH.IsKey(InAggrNm)) { BatchOrderP = false; break; }
+            Level = TInt::GetMx(Level, AggrNmToLevelH.GetDat(InAggrNm) + 1);
+        }
+        AggrNmToLevelH.AddDat(StreamAggr->GetAggrNm(), Level);
+        if (Level == LevelV.Len()) { LevelV.Add(); }
+        LevelV[Level].Add(AggrN);
+    }
+    if (!BatchOrderP) { LevelV.Clr(); }
+    ScheduleP = true;
+}
 
-    // get list of arrays
-    QmAssertR(ParamVal->IsObjKey("aggregates"), "[TStreamAggrSet] Expecting array of aggregates");
-    PJsonVal AggrVals = ParamVal->GetObjKey("aggregates");
+void TStreamAggrSet::OnAddRecBatch(const TIntV& AggrNV, const TRecSet& RecSet) {
+    const int Aggrs = AggrNV.Len();
+    if (Aggrs == 1) {
+        StreamAggrV[AggrNV[0]]->OnAddRecBatch(RecSet, this);
+        return;
+    }
+    // hand out the slowest aggregates so far first, so they do not end up last
+    TFltIntKdV CostAggrNV(Aggrs, 0);
+    for (const int AggrN : AggrNV) {
+        CostAggrNV.Add(TFltIntKd(StreamAggrV[AggrN]->GetExeTm().GetMSec(), AggrN));
+    }
+    CostAggrNV.Sort(false);
+    TParallelExcept ParallelExcept(Aggrs);
+    #pragma omp parallel for num_threads(TInt::GetMn(Threads, Aggrs)) schedule(dynamic, 1)
+    for (int CostAggrN = 0; CostAggrN < Aggrs; CostAggrN++) {
+        ParallelExcept.Run(CostAggrN, [&]() {
+            StreamAggrV[CostAggrNV[CostAggrN].Dat]->OnAddRecBatch(RecSet, this);
+        });
+    }
+    ParallelExcept.Throw();
+}
+
+TStreamAggrSet::TStreamAggrSet(const TWPt<TBase>& _Base, const TStr& _AggrNm):
+    TStreamAggr(_Base, _AggrNm), Threads(1), ScheduleP(false), BatchOrderP(false) { }
+
+TStreamAggrSet::TStreamAggrSet(const TWPt<TBase>& _Base, const PJsonVal& ParamVal):
+        TStreamAggr(_Base, ParamVal), Threads(1), ScheduleP(false), BatchOrderP(false) {
+
+    // get list of arrays
+    QmAssertR(ParamVal->IsObjKey("aggregates"), "[TStreamAggrSet] Expecting array of aggregates");
+    PJsonVal AggrVals = ParamVal->GetObjKey("aggregates");
     QmAssertR(AggrVals->IsArr(), "[TStreamAggrSet] Key 'aggregates' expected to be array");
     // go over the array
     for (int AggrValN = 0; AggrValN < AggrVals->GetArrVals(); AggrValN++) {
@@ -6503,6 +7267,17 @@ void TStreamAggrSet::AddStreamAggr(const PStreamAggr& StreamAggr) {
     QmAssertR(GetBase()->IsStreamAggr(StreamAggr->GetAggrNm()),
         "[TStreamAggrSet] Unregistered stream aggregate " + StreamAggr->GetAggrNm());
     StreamAggrV.Add(StreamAggr());
+    ScheduleP = false;
+}
+
+void TStreamAggrSet::DelStreamAggr(const TStr& StreamAggrNm) {
+    for (int StreamAggrN = 0; StreamAggrN < StreamAggrV.Len(); StreamAggrN++) {
+        if (StreamAggrV[StreamAggrN]->GetAggrNm() == StreamAggrNm) {
+            StreamAggrV.Del(StreamAggrN);
+            ScheduleP = false;
+            return;
+        }
+    }
 }
 
 const TWPt<TStreamAggr>& TStreamAggrSet::GetStreamAggr(const int& StreamAggrN) const {
@@ -6558,6 +7333,54 @@ void TStreamAggrSet::OnDeleteRec(const TRec& Rec, const TWPt<TStreamAggr>& Calle
     }
 }
 
+void TStreamAggrSet::OnAddRecBatch(const TRecSet& RecSet, const TWPt<TStreamAggr>& CallerAggr) {
+    TScopeStopWatch StopWatch(ExeTm);
+    if (IsBatchOrder() && Threads > 1) {
+        // each level reads only the batch outputs of the levels before it
+        TParallelReadGuard ReadGuard(GetBase());
+        for (const TIntV& AggrNV : LevelV) {
+            OnAddRecBatch(AggrNV, RecSet);
+        }
+    } else if (IsBatchOrder()) {
+        // each aggregate sees the whole batch, later ones read the batch outputs of earlier ones
+        for (TWPt<TStreamAggr>& StreamAggr : StreamAggrV) {
+            StreamAggr->OnAddRecBatch(RecSet, this);
+        }
+    } else {
+        // aggregates read the state of their inputs after each record
+        for (int RecN = 0; RecN < RecSet.GetRecs(); RecN++) {
+            const TRec Rec = RecSet.GetRec(RecN);
+            for (TWPt<TStreamAggr>& StreamAggr : StreamAggrV) {
+                StreamAggr->OnAddRec(Rec, this);
+            }
+        }
+    }
+}
+
+void TStreamAggrSet::OnTimeBatch(const TUInt64V& TmMSecsV, const TWPt<TStreamAggr>& CallerAggr) {
+    TScopeStopWatch StopWatch(ExeTm);
+    for (int TmN = 0; TmN < TmMSecsV.Len(); TmN++) {
+        for (TWPt<TStreamAggr>& StreamAggr : StreamAggrV) {
+            StreamAggr->OnTime(TmMSecsV[TmN], this);
+        }
+    }
+}
+
+bool TStreamAggrSet::IsBatchOrder() {
+    if (!ScheduleP) { BuildSchedule(); }
+    return BatchOrderP;
+}
+
+const TVec<TIntV>& TStreamAggrSet::GetLevelV() {
+    if (!ScheduleP) { BuildSchedule(); }
+    return LevelV;
+}
+
+void TStreamAggrSet::SetThreads(const int& _Threads) {
+    QmAssertR(_Threads > 0, "[TStreamAggrSet] Number of threads must be positive");
+    Threads = _Threads;
+}
+
 void TStreamAggrSet::PrintStat() const {
     for (TWPt<TStreamAggr>& StreamAggr : StreamAggrV) {
         StreamAggr->PrintStat();
@@ -6583,6 +7406,10 @@ void TStreamAggrTrigger::OnAdd(const TRec& Rec) {
     StreamAggr->OnAddRec(Rec, NULL);
 }
 
+void TStreamAggrTrigger::OnAddBatch(const TRecSet& RecSet) {
+    StreamAggr->OnAddRecBatch(RecSet, NULL);
+}
+
 void TStreamAggrTrigger::OnUpdate(const TRec& Rec) {
     StreamAggr->OnUpdateRec(Rec, NULL);
 }
@@ -6591,9 +7418,540 @@ void TStreamAggrTrigger::OnDelete(const TRec& Rec) {
     StreamAggr->OnDeleteRec(Rec, NULL);
 }
 
+///////////////////////////////
+// Background flusher parameters
+TBaseFlusherParam::TBaseFlusherParam(const uint64& _DirtyTarget, const uint64& _MxBytesPerSec,
+        const int& _IntervalMSec, const int& _SliceMSec): DirtyTarget(_DirtyTarget),
+        MxBytesPerSec(_MxBytesPerSec), IntervalMSec(_IntervalMSec), SliceMSec(_SliceMSec) {
+
+    QmAssertR(IntervalMSec > 0, "Background flush interval must be positive");
+    QmAssertR(SliceMSec > 0, "Background flush slice must be positive");
+}
+
+TBaseFlusherParam::TBaseFlusherParam(const PJsonVal& ParamVal) {
+    TBaseFlusherParam DefParam;
+    const double DirtyTargetMB = ParamVal->GetObjNum("dirtyTarget", (double)DefParam.DirtyTarget / TInt::Mega);
+    const double RateLimitMB = ParamVal->GetObjNum("rateLimit", (double)DefParam.MxBytesPerSec / TInt::Mega);
+    QmAssertR(DirtyTargetMB >= 0.0, "Background flush dirty target must not be negative");
+    QmAssertR(RateLimitMB >= 0.0, "Background flush rate limit must not be negative");
+    *this = TBaseFlusherParam(
+        (uint64)(DirtyTargetMB * TInt::Mega),
+        (uint64)(RateLimitMB * TInt::Mega),
+        ParamVal->GetObjInt("interval", DefParam.IntervalMSec),
+        ParamVal->GetObjInt("slice", DefParam.SliceMSec));
+}
+
+///////////////////////////////
+// Background flusher
+TBaseFlusher::TBaseFlusher(const TWPt<TBase>& _Base, const PFlushLock& _FlushLock,
+    const TBaseFlusherParam& _Param): TThread(), Base(_Base), FlushLock(_FlushLock),
+    Param(_Param), StopP(false) { }
+
+void TBaseFlusher::Sleep(const int& MSec) const {
+    // sleep in short steps, so stopping does not wait for the whole interval
+    // and write-ahead log is synced on time
+    TTmStopWatch Sw(true);
+    int LeftMSec = MSec;
+    while (!StopP && LeftMSec > 0) {
+        TSysProc::Sleep((uint)TInt::GetMn(LeftMSec, 10));
+        Base->SyncWal();
+        LeftMSec = MSec - Sw.GetMSecInt();
+    }
+}
+
+int64 TBaseFlusher::FlushSlice() {
+    // pages are written while we hold the lock, so ingestion waits for the
+    // whole slice; keep it short, writing outside the lock would need copies
+    // of dirty pages from all the stores and the index
+    TFlushGuard FlushGuard(FlushLock);
+    const uint64 DirtyBytes = Base->GetDirtyBytes();
+    if (DirtyBytes <= Param.DirtyTarget) { return -1; }
+    Base->PartialFlush(Param.SliceMSec);
+    // estimate how much was written from the drop of dirty bytes
+    const uint64 NewDirtyBytes = Base->GetDirtyBytes();
+    const uint64 WrittenBytes = (DirtyBytes > NewDirtyBytes) ? (DirtyBytes - NewDirtyBytes) : 0;
+    Slices++; FlushedBytes += WrittenBytes;
+    return (int64)WrittenBytes;
+}
+
+void TBaseFlusher::Run() {
+    try {
+        while (!StopP) {
+            Sleep(Param.IntervalMSec);
+            // write slices until we get below the target or nothing more can be written
+            while (!StopP) {
+                TTmStopWatch SliceSw(true);
+                const int64 WrittenBytes = FlushSlice();
+                if (WrittenBytes <= 0) { break; }
+                // stay below the rate limit
+                if (Param.MxBytesPerSec > 0) {
+                    const int64 RateMSec = 1000 * WrittenBytes / (int64)Param.MxBytesPerSec.Val;
+                    const int64 SliceMSec = SliceSw.GetMSecInt();
+                    if (RateMSec > SliceMSec) { Sleep((int)(RateMSec - SliceMSec)); }
+                }
+            }
+        }
+    } catch (const PExcept& Except) {
+        TEnv::Error->OnStatus("Background flusher stopped: " + Except->GetMsgStr());
+    } catch (const std::exception& Except) {
+        TEnv::Error->OnStatus(TStr("Background flusher stopped: ") + Except.what());
+    } catch (...) {
+        // exception must not leave the thread, that would terminate the process
+        TEnv::Error->OnStatus("Background flusher stopped with unknown exception");
+    }
+}
+
+void TBaseFlusher::Stop() {
+    StopP = true;
+    Join();
+}
+
+PJsonVal TBaseFlusher::GetStats() const {
+    PJsonVal StatsVal = TJsonVal::NewObj();
+    StatsVal->AddToObj("dirty_target", Param.DirtyTarget.Val);
+    StatsVal->AddToObj("rate_limit", Param.MxBytesPerSec.Val);
+    StatsVal->AddToObj("interval", Param.IntervalMSec.Val);
+    StatsVal->AddToObj("slices", Slices.Val);
+    StatsVal->AddToObj("flushed_bytes", FlushedBytes.Val);
+    return StatsVal;
+}
+
+///////////////////////////////
+// Write-ahead log parameters
+TWalParam::TWalParam(const int& _SyncMSec, const uint64& _CheckpointBytes):
+        SyncMSec(_SyncMSec), CheckpointBytes(_CheckpointBytes) {
+
+    QmAssertR(SyncMSec >= 0, "Write-ahead log sync interval must not be negative");
+    QmAssertR(CheckpointBytes > 0, "Write-ahead log checkpoint size must be positive");
+}
+
+TWalParam::TWalParam(const PJsonVal& ParamVal) {
+    TWalParam DefParam;
+    const double CheckpointMB = ParamVal->GetObjNum("checkpointSize", (double)DefParam.CheckpointBytes / TInt::Mega);
+    QmAssertR(CheckpointMB > 0.0, "Write-ahead log checkpoint size must be positive");
+    *this = TWalParam(ParamVal->GetObjInt("syncInterval", DefParam.SyncMSec),
+        (uint64)(CheckpointMB * TInt::Mega));
+}
+
+///////////////////////////////
+// Write-ahead log
+const int TWal::MxBfLen = TInt::Mega;
+
+TWal::TWal(const TStr& _WalFPath, const TWalParam& _Param, const PFJournal& _Journal):
+    WalFPath(_WalFPath), Param(_Param), Journal(_Journal), FileId(NULL),
+    Lsn(_Journal->GetTag()), LogDepth(1) { }
+
+PWal TWal::New(const TStr& FPath, const TWalParam& Param) {
+    // base files as they are now are the first checkpoint
+    PFJournal Journal = TFJournal::New(FPath, GetWalFPath(FPath), 0);
+    PWal Wal = new TWal(GetWalFPath(FPath), Param, Journal);
+    Wal->OpenLog(true);
+    return Wal;
+}
+
+PWal TWal::Rollback(const TStr& FPath) {
+    TEnv::Logger->OnStatus("Base was not closed, rolling back to the last checkpoint");
+    PFJournal Journal = TFJournal::Rollback(FPath, GetWalFPath(FPath));
+    return new TWal(GetWalFPath(FPath), TWalParam(), Journal);
+}
+
+TWal::~TWal() {
+    // log which was not recovered stays on the disk for the next try
+    if (Journal.Empty() || FileId == NULL) { return; }
+    try {
+        Close();
+    } catch (const PExcept& Except) {
+        ErrorLog("Error closing write-ahead log: " + Except->GetMsgStr());
+    }
+}
+
+void TWal::OpenLog(const bool& TruncP) {
+    if (FileId != NULL) { fclose(FileId); FileId = NULL; }
+    const TStr LogFNm = WalFPath + "Wal.log";
+    FileId = fopen(LogFNm.CStr(), TruncP ? "wb" : "ab");
+    QmAssertR(FileId != NULL, "Can not open write-ahead log " + LogFNm);
+    LogBytes = TruncP ? 0 : TFile::GetSize(LogFNm);
+    LogBf.Clr();
+}
+
+void TWal::Add(const TMOut& OpSOut) {
+    // entry: length, operation number and operation, checksum
+    TMOut EntrySOut(OpSOut.Len() + (int)sizeof(uint64));
+    TUInt64(++Lsn).Save(EntrySOut);
+    EntrySOut.PutBf(OpSOut.GetBfAddr(), OpSOut.Len());
+    const int EntryLen = EntrySOut.Len();
+    const int Cs = TCs::GetCsFromBf(EntrySOut.GetBfAddr(), EntryLen).Get();
+    if (LogBf.Len() == 0) { BfTmMSecs = TTm::GetCurUniMSecs(); }
+    LogBf.PutBf(&EntryLen, sizeof(int));
+    LogBf.PutBf(EntrySOut.GetBfAddr(), EntryLen);
+    LogBf.PutBf(&Cs, sizeof(int));
+    LogBytes += (uint64)(EntryLen + 2 * sizeof(int)); Ops++;
+    // group commit: operations logged within the sync interval share one sync
+    if (Param.SyncMSec == 0 || LogBf.Len() >= MxBfLen || IsSyncDue()) { Sync(); }
+}
+
+bool TWal::LoadOp(TSIn& SIn, TMem& Op) {
+    // broken entry at the end is from a write which did not finish
+    if (SIn.Len() < (int)sizeof(int)) { return false; }
+    int OpLen = 0; SIn.GetBf(&OpLen, sizeof(int));
+    if (OpLen < (int)sizeof(uint64) || SIn.Len() < OpLen + (int)sizeof(int)) { return false; }
+    Op.Gen(OpLen);
+    SIn.GetBf(Op.GetBf(), OpLen);
+    int Cs = 0; SIn.GetBf(&Cs, sizeof(int));
+    return TCs::GetCsFromBf(Op.GetBf(), OpLen).Get() == Cs;
+}
+
+void TWal::SaveField(const TStore* Store, const uint64& RecId, const int& FieldId, TSOut& SOut) {
+    const TFieldDesc& Desc = Store->GetFieldDesc(FieldId);
+    const bool NullP = Store->IsFieldNull(RecId, FieldId);
+    TBool(NullP).Save(SOut);
+    if (NullP) { return; }
+    if (Desc.IsInt()) {
+        TInt(Store->GetFieldInt(RecId, FieldId)).Save(SOut);
+    } else if (Desc.IsInt16()) {
+        TInt16(Store->GetFieldInt16(RecId, FieldId)).Save(SOut);
+    } else if (Desc.IsInt64()) {
+        TInt64(Store->GetFieldInt64(RecId, FieldId)).Save(SOut);
+    } else if (Desc.IsByte()) {
+        TUCh(Store->GetFieldByte(RecId, FieldId)).Save(SOut);
+    } else if (Desc.IsIntV()) {
+        TIntV IntV; Store->GetFieldIntV(RecId, FieldId, IntV); IntV.Save(SOut);
+    } else if (Desc.IsUInt()) {
+        TUInt(Store->GetFieldUInt(RecId, FieldId)).Save(SOut);
+    } else if (Desc.IsUInt16()) {
+        TUInt16(Store->GetFieldUInt16(RecId, FieldId)).Save(SOut);
+    } else if (Desc.IsUInt64()) {
+        TUInt64(Store->GetFieldUInt64(RecId, FieldId)).Save(SOut);
+    } else if (Desc.IsStr()) {
+        Store->GetFieldStr(RecId, FieldId).Save(SOut);
+    } else if (Desc.IsStrV()) {
+        TStrV StrV; Store->GetFieldStrV(RecId, FieldId, StrV); StrV.Save(SOut);
+    } else if (Desc.IsBool()) {
+        TBool(Store->GetFieldBool(RecId, FieldId)).Save(SOut);
+    } else if (Desc.IsFlt()) {
+        TFlt(Store->GetFieldFlt(RecId, FieldId)).Save(SOut);
+    } else if (Desc.IsSFlt()) {
+        TSFlt(Store->GetFieldSFlt(RecId, FieldId)).Save(SOut);
+    } else if (Desc.IsFltPr()) {
+        Store->GetFieldFltPr(RecId, FieldId).Save(SOut);
+    } else if (Desc.IsFltV()) {
+        TFltV FltV; Store->GetFieldFltV(RecId, FieldId, FltV); FltV.Save(SOut);
+    } else if (Desc.IsTm()) {
+        TUInt64(Store->GetFieldTmMSecs(RecId, FieldId)).Save(SOut);
+    } else if (Desc.IsNumSpV()) {
+        TIntFltKdV SpV; Store->GetFieldNumSpV(RecId, FieldId, SpV); SpV.Save(SOut);
+    } else if (Desc.IsBowSpV()) {
+        PBowSpV SpV; Store->GetFieldBowSpV(RecId, FieldId, SpV); SpV->Save(SOut);
+    } else if (Desc.IsTMem()) {
+        TMem Mem; Store->GetFieldTMem(RecId, FieldId, Mem); Mem.Save(SOut);
+    } else if (Desc.IsJson()) {
+        TJsonVal::GetStrFromVal(Store->GetFieldJsonVal(RecId, FieldId)).Save(SOut);
+    } else {
+        throw TQmExcept::New("Unsupported field type for write-ahead log: " + Desc.GetFieldTypeStr());
+    }
+}
+
+void TWal::LoadField(const TWPt<TStore>& Store, const uint64& RecId, const int& FieldId, TSIn& SIn) {
+    const TFieldDesc& Desc = Store->GetFieldDesc(FieldId);
+    if (TBool(SIn)) { Store->SetFieldNull(RecId, FieldId); return; }
+    if (Desc.IsInt()) {
+        Store->SetFieldInt(RecId, FieldId, TInt(SIn));
+    } else if (Desc.IsInt16()) {
+        Store->SetFieldInt16(RecId, FieldId, TInt16(SIn));
+    } else if (Desc.IsInt64()) {
+        Store->SetFieldInt64(RecId, FieldId, TInt64(SIn));
+    } else if (Desc.IsByte()) {
+        Store->SetFieldByte(RecId, FieldId, TUCh(SIn));
+    } else if (Desc.IsIntV()) {
+        Store->SetFieldIntV(RecId, FieldId, TIntV(SIn));
+    } else if (Desc.IsUInt()) {
+        Store->SetFieldUInt(RecId, FieldId, TUInt(SIn));
+    } else if (Desc.IsUInt16()) {
+        Store->SetFieldUInt16(RecId, FieldId, TUInt16(SIn));
+    } else if (Desc.IsUInt64()) {
+        Store->SetFieldUInt64(RecId, FieldId, TUInt64(SIn));
+    } else if (Desc.IsStr()) {
+        Store->SetFieldStr(RecId, FieldId, TStr(SIn));
+    } else if (Desc.IsStrV()) {
+        Store->SetFieldStrV(RecId, FieldId, TStrV(SIn));
+    } else if (Desc.IsBool()) {
+        Store->SetFieldBool(RecId, FieldId, TBool(SIn));
+    } else if (Desc.IsFlt()) {
+        Store->SetFieldFlt(RecId, FieldId, TFlt(SIn));
+    } else if (Desc.IsSFlt()) {
+        Store->SetFieldSFlt(RecId, FieldId, TSFlt(SIn));
+    } else if (Desc.IsFltPr()) {
+        Store->SetFieldFltPr(RecId, FieldId, TFltPr(SIn));
+    } else if (Desc.IsFltV()) {
+        Store->SetFieldFltV(RecId, FieldId, TFltV(SIn));
+    } else if (Desc.IsTm()) {
+        Store->SetFieldTmMSecs(RecId, FieldId, TUInt64(SIn));
+    } else if (Desc.IsNumSpV()) {
+        Store->SetFieldNumSpV(RecId, FieldId, TIntFltKdV(SIn));
+    } else if (Desc.IsBowSpV()) {
+        Store->SetFieldBowSpV(RecId, FieldId, TBowSpV::Load(SIn));
+    } else if (Desc.IsTMem()) {
+        Store->SetFieldTMem(RecId, FieldId, TMem(SIn));
+    } else if (Desc.IsJson()) {
+        Store->SetFieldJsonVal(RecId, FieldId, TJsonVal::GetValFromStr(TStr(SIn)));
+    } else {
+        throw TQmExcept::New("Unsupported field type for write-ahead log: " + Desc.GetFieldTypeStr());
+    }
+}
+
+void TWal::Sync() {
+    if (LogBf.Len() == 0) { return; }
+    QmAssertR((int)fwrite(LogBf.GetBfAddr(), 1, LogBf.Len(), FileId) == LogBf.Len(),
+        "Error writing write-ahead log " + WalFPath);
+    TFJournal::SyncFile(FileId);
+    LogBf.Clr(); Syncs++;
+}
+
+bool TWal::IsSyncDue() const {
+    return LogBf.Len() > 0 && TTm::GetCurUniMSecs() >= BfTmMSecs + (uint64)Param.SyncMSec;
+}
+
+void TWal::Checkpoint() {
+    // saved base includes all logged operations, they are not needed anymore
+    Journal->Checkpoint(Lsn);
+    OpenLog(true);
+    Checkpoints++;
+}
+
+void TWal::Close() {
+    Journal->Checkpoint(Lsn);
+    if (FileId != NULL) { fclose(FileId); FileId = NULL; }
+    Journal.Clr();
+    // log goes first, journal without the log just rolls back to the saved state
+    TFile::Del(WalFPath + "Wal.log", false);
+    TFJournal::Del(WalFPath);
+    TDir::DelDir(WalFPath);
+}
+
+int TWal::Replay(const TWPt<TBase>& Base) {
+    const TStr LogFNm = WalFPath + "Wal.log";
+    if (!TFile::Exists(LogFNm)) { return 0; }
+    const uint64 CheckpointLsn = Journal->GetTag();
+    int Replayed = 0, Failed = 0;
+    TFIn FIn(LogFNm); TMem Op;
+    while (LoadOp(FIn, Op)) {
+        PSIn SIn = Op.GetSIn();
+        const uint64 OpLsn = TUInt64(*SIn);
+        // operations up to the checkpoint are already in the base
+        if (OpLsn <= CheckpointLsn) { continue; }
+        Lsn = OpLsn;
+        const int LogOp = TInt(*SIn);
+        const uint StoreId = TUInt(*SIn);
+        // operations are repeated as they were called, the ones which failed then fail again
+        try {
+            QmAssertR(Base->IsStoreId(StoreId), "Unknown store id " + TUInt::GetStr(StoreId));
+            const TWPt<TStore> Store = Base->GetStoreByStoreId(StoreId);
+            if (LogOp == wloAddRec) {
+                Store->AddRec(TJsonVal::GetValFromStr(TStr(*SIn)), false);
+            } else if (LogOp == wloUpdateRec) {
+                const uint64 RecId = TUInt64(*SIn);
+                Store->UpdateRec(RecId, TJsonVal::GetValFromStr(TStr(*SIn)));
+            } else if (LogOp == wloSetField) {
+                const uint64 RecId = TUInt64(*SIn); const int FieldId = TInt(*SIn);
+                LoadField(Store, RecId, FieldId, *SIn);
+            } else if (LogOp == wloDeleteRecs) {
+                TUInt64V DelRecIdV(*SIn); TBool AssertOK(*SIn);
+                Store->DeleteRecs(DelRecIdV, AssertOK);
+            } else if (LogOp == wloDeleteFirstRecs) {
+                Store->DeleteFirstRecs(TInt(*SIn));
+            } else if (LogOp == wloDeleteAllRecs) {
+                Store->DeleteAllRecs();
+            } else {
+                throw TQmExcept::New("Unknown write-ahead log operation " + TInt::GetStr(LogOp));
+            }
+        } catch (const PExcept& Except) {
+            Failed++;
+            ErrorLog("Write-ahead log operation " + TUInt64::GetStr(OpLsn) + " failed: " + Except->GetMsgStr());
+        }
+        Replayed++;
+    }
+    TEnv::Logger->OnStatusFmt("Replayed %d operations from write-ahead log (%d failed)", Replayed, Failed);
+    return Replayed;
+}
+
+PJsonVal TWal::GetStats() const {
+    PJsonVal StatsVal = TJsonVal::NewObj();
+    StatsVal->AddToObj("sync_interval", Param.SyncMSec.Val);
+    StatsVal->AddToObj("checkpoint_size", Param.CheckpointBytes.Val);
+    StatsVal->AddToObj("lsn", Lsn.Val);
+    StatsVal->AddToObj("log_bytes", LogBytes.Val);
+    StatsVal->AddToObj("buffered_bytes", LogBf.Len());
+    StatsVal->AddToObj("ops", Ops.Val);
+    StatsVal->AddToObj("syncs", Syncs.Val);
+    StatsVal->AddToObj("checkpoints", Checkpoints.Val);
+    if (!Journal.Empty()) { StatsVal->AddToObj("journal", Journal->GetStats()); }
+    return StatsVal;
+}
+
+///////////////////////////////
+// Write-ahead log operation
+TWalOp::TWalOp(const TStore* Store): Base(Store->GetBase()), StoreId(Store->GetStoreId()) {
+    if (!Base->IsWal()) { return; }
+    // no operation is running, so the base is consistent and can be checkpointed
+    if (!Base->GetWal()->IsInOp() && Base->GetWal()->IsCheckpointDue()) { Base->Checkpoint(); }
+    Wal = Base->GetWal();
+    Wal->OpDepth++;
+}
+
+TWalOp::~TWalOp() {
+    if (!Wal.Empty()) { Wal->OpDepth--; }
+}
+
+bool TWalOp::IsLog() const {
+    return !Wal.Empty() && Wal->OpDepth == Wal->LogDepth;
+}
+
+void TWalOp::Start(TMOut& OpSOut, const int& LogOp) const {
+    TInt(LogOp).Save(OpSOut);
+    StoreId.Save(OpSOut);
+}
+
+void TWalOp::Add(const TMOut& OpSOut) {
+    // log is synced by the background flusher
+    TFlushGuard FlushGuard(Base->GetFlushLock());
+    Wal->Add(OpSOut);
+}
+
+void TWalOp::AddRec(const PJsonVal& RecVal) {
+    if (!IsLog()) { return; }
+    TMOut OpSOut; Start(OpSOut, TWal::wloAddRec);
+    TJsonVal::GetStrFromVal(RecVal).Save(OpSOut);
+    Add(OpSOut);
+}
+
+void TWalOp::UpdateRec(const uint64& RecId, const PJsonVal& RecVal) {
+    if (!IsLog()) { return; }
+    TMOut OpSOut; Start(OpSOut, TWal::wloUpdateRec);
+    TUInt64(RecId).Save(OpSOut);
+    TJsonVal::GetStrFromVal(RecVal).Save(OpSOut);
+    Add(OpSOut);
+}
+
+void TWalOp::SetField(const TStore* Store, const uint64& RecId, const int& FieldId) {
+    if (!IsLog()) { return; }
+    TMOut OpSOut; Start(OpSOut, TWal::wloSetField);
+    TUInt64(RecId).Save(OpSOut); TInt(FieldId).Save(OpSOut);
+    TWal::SaveField(Store, RecId, FieldId, OpSOut);
+    Add(OpSOut);
+}
+
+void TWalOp::DeleteRecs(const TUInt64V& DelRecIdV, const bool& AssertOK) {
+    if (!IsLog()) { return; }
+    TMOut OpSOut; Start(OpSOut, TWal::wloDeleteRecs);
+    DelRecIdV.Save(OpSOut); TBool(AssertOK).Save(OpSOut);
+    Add(OpSOut);
+}
+
+void TWalOp::DeleteFirstRecs(const int& DelRecs) {
+    if (!IsLog()) { return; }
+    TMOut OpSOut; Start(OpSOut, TWal::wloDeleteFirstRecs);
+    TInt(DelRecs).Save(OpSOut);
+    Add(OpSOut);
+}
+
+void TWalOp::DeleteAllRecs() {
+    if (!IsLog()) { return; }
+    TMOut OpSOut; Start(OpSOut, TWal::wloDeleteAllRecs);
+    Add(OpSOut);
+}
+
+///////////////////////////////
+// Write-ahead log trigger scope
+TWalTriggers::TWalTriggers(const TWPt<TBase>& Base): LogDepth(-1) {
+    if (!Base->IsWal()) { return; }
+    // operations called by triggers are the outermost ones we see when replaying
+    Wal = Base->GetWal();
+    LogDepth = Wal->LogDepth;
+    Wal->LogDepth = Wal->OpDepth + 1;
+}
+
+TWalTriggers::~TWalTriggers() {
+    if (!Wal.Empty()) { Wal->LogDepth = LogDepth; }
+}
+
+///////////////////////////////
+// Snapshot gate
+void TSnapshotGate::EnterSnapshot() {
+    CondVarLock.Lock();
+    while (Deletes > 0) { CondVarLock.WaitForSignal(); }
+    Snapshots++;
+    CondVarLock.Release();
+}
+
+void TSnapshotGate::LeaveSnapshot() {
+    CondVarLock.Lock();
+    Snapshots--;
+    if (Snapshots == 0) { CondVarLock.Broadcast(); }
+    CondVarLock.Release();
+}
+
+void TSnapshotGate::EnterDelete() {
+    CondVarLock.Lock();
+    // new snapshots wait from now on, nested deletion finds no snapshots
+    Deletes++;
+    while (Snapshots > 0) { CondVarLock.WaitForSignal(); }
+    CondVarLock.Release();
+}
+
+void TSnapshotGate::LeaveDelete() {
+    CondVarLock.Lock();
+    Deletes--;
+    if (Deletes == 0) { CondVarLock.Broadcast(); }
+    CondVarLock.Release();
+}
+
+///////////////////////////////
+// Read snapshot
+TReadSnapshot::TReadSnapshot(const TWPt<TBase>& Base): SnapshotGate(Base->GetSnapshotGate()) {
+    QmAssertR(Base->IsConcurrentReads(), "Base does not allow concurrent reads");
+    SnapshotGate->EnterSnapshot();
+    // writer adds records under the lock, so we see each store between two additions
+    TFlushGuard FlushGuard(Base->GetFlushLock());
+    uint MxStoreId = 0;
+    for (int StoreN = 0; StoreN < Base->GetStores(); StoreN++) {
+        MxStoreId = TMath::Mx(MxStoreId, Base->GetStoreByStoreN(StoreN)->GetStoreId());
+    }
+    EndRecIdV.Gen((int)MxStoreId + 1);
+    for (int StoreN = 0; StoreN < Base->GetStores(); StoreN++) {
+        const TWPt<TStore> Store = Base->GetStoreByStoreN(StoreN);
+        EndRecIdV[(int)Store->GetStoreId()] = Store->Empty() ? 0 : Store->GetLastRecId() + 1;
+    }
+}
+
+TReadSnapshot::~TReadSnapshot() {
+    SnapshotGate->LeaveSnapshot();
+}
+
+bool TReadSnapshot::IsRecId(const TWPt<TStore>& Store, const uint64& RecId) const {
+    return RecId < GetEndRecId(Store->GetStoreId()) && Store->IsRecId(RecId);
+}
+
+void TReadSnapshot::Filter(const PRecSet& RecSet) const {
+    const uint64 EndRecId = GetEndRecId(RecSet->GetStoreId());
+    // check if there is anything to remove
+    bool NewRecP = false;
+    for (int RecN = 0; RecN < RecSet->GetRecs() && !NewRecP; RecN++) {
+        NewRecP = (RecSet->GetRecId(RecN) >= EndRecId);
+    }
+    if (!NewRecP) { return; }
+    // keep records with IDs from [0, EndRecId)
+    if (EndRecId == 0) {
+        RecSet->FilterByRecId(TUInt64::Mx, 0);
+    } else {
+        RecSet->FilterByRecId(0, EndRecId - 1);
+    }
+}
+
 ///////////////////////////////
 // QMiner-Base
 PRecSet TBase::Invert(const PRecSet& RecSet) {
+    // store can be changed by the writer while we read it
+    TFlushGuard FlushGuard(FlushLock);
     // prepare sorted list of all records from the store
     TUInt64IntKdV AllResIdV;
     const TWPt<TStore>& Store = RecSet->GetStore();
@@ -6604,18 +7962,177 @@ PRecSet TBase::Invert(const PRecSet& RecSet) {
     if (!AllResIdV.IsSorted()) { AllResIdV.Sort(); }
     // remove retrieved items
     TUInt64IntKdV ResIdFqV;
-    AllResIdV.Diff(RecSet->GetRecIdFqV(), ResIdFqV);
+    if (TRecSet::IsSortedSet(RecSet->GetRecIdFqV())) {
+        TSortedSet::Diff(AllResIdV, RecSet->GetRecIdFqV(), ResIdFqV);
+    } else {
+        AllResIdV.Diff(RecSet->GetRecIdFqV(), ResIdFqV);
+    }
     // return new record set
     return TRecSet::New(Store, ResIdFqV, false);
 }
 
-TPair<TBool, PRecSet> TBase::_Search(const TQueryItem& QueryItem) {
+void TBase::GetAndPlan(const TQueryItem& QueryItem, TIntV& ItemNV) {
+    // estimates read the index
+    TFlushGuard FlushGuard(FlushLock);
+    // sort items by negation and estimated number of records
+    TVec<TTriple<TBool, TUInt64, TInt> > NegRecsItemNV;
+    int PosItems = 0;
+    for (int ItemN = 0; ItemN < QueryItem.GetItems(); ItemN++) {
+        const TQueryItem& Item = QueryItem.GetItem(ItemN);
+        NegRecsItemNV.Add(TTriple<TBool, TUInt64, TInt>(Item.IsNegated(), EstimateRecs(Item), ItemN));
+        if (!Item.IsNegated()) { PosItems++; }
+    }
+    NegRecsItemNV.Sort();
+    // whole store does not change the intersection, as long as something else is left
+    ItemNV.Gen(NegRecsItemNV.Len(), 0);
+    for (const TTriple<TBool, TUInt64, TInt>& NegRecsItemN : NegRecsItemNV) {
+        const TQueryItem& Item = QueryItem.GetItem(NegRecsItemN.Val3);
+        if (Item.IsStore() && PosItems > 1) { PosItems--; continue; }
+        ItemNV.Add(NegRecsItemN.Val3);
+    }
+}
+
+PRecSet TBase::FilterRange(const TQueryItem& QueryItem, const TUInt64IntKdV& RecIdFqV) {
+    const TIndexKey& Key = IndexVoc->GetKey(QueryItem.GetKeyId());
+    const int FieldId = Key.GetFieldId(0);
+    // weighted the same as records read from the index, so the AND merge sums the same
+    TUInt64V RecIdV; GetKeyV(RecIdFqV, RecIdV);
+    PRecSet RecSet = TRecSet::New(GetStoreByStoreId(Key.GetStoreId()), RecIdV);
+    if (QueryItem.IsRangeInt()) {
+        const TIntPr RangeMinMax = QueryItem.GetRangeIntMinMax();
+        RecSet->FilterByFieldInt(FieldId, RangeMinMax.Val1, RangeMinMax.Val2);
+    } else if (QueryItem.IsRangeInt16()) {
+        const TInt16Pr RangeMinMax = QueryItem.GetRangeInt16MinMax();
+        RecSet->FilterByFieldInt16(FieldId, RangeMinMax.Val1, RangeMinMax.Val2);
+    } else if (QueryItem.IsRangeInt64()) {
+        const TInt64Pr RangeMinMax = QueryItem.GetRangeInt64MinMax();
+        RecSet->FilterByFieldInt64(FieldId, RangeMinMax.Val1, RangeMinMax.Val2);
+    } else if (QueryItem.IsRangeByte()) {
+        const TUChPr RangeMinMax = QueryItem.GetRangeByteMinMax();
+        RecSet->FilterByFieldByte(FieldId, RangeMinMax.Val1, RangeMinMax.Val2);
+    } else if (QueryItem.IsRangeUInt()) {
+        const TUIntUIntPr RangeMinMax = QueryItem.GetRangeUIntMinMax();
+        RecSet->FilterByFieldUInt(FieldId, RangeMinMax.Val1, RangeMinMax.Val2);
+    } else if (QueryItem.IsRangeUInt16()) {
+        const TUInt16Pr RangeMinMax = QueryItem.GetRangeUInt16MinMax();
+        RecSet->FilterByFieldUInt16(FieldId, RangeMinMax.Val1, RangeMinMax.Val2);
+    } else if (QueryItem.IsRangeUInt64()) {
+        const TUInt64Pr RangeMinMax = QueryItem.GetRangeUInt64MinMax();
+        RecSet->FilterByFieldUInt64(FieldId, RangeMinMax.Val1, RangeMinMax.Val2);
+    } else if (QueryItem.IsRangeTm()) {
+        const TUInt64Pr RangeMinMax = QueryItem.GetRangeUInt64MinMax();
+        RecSet->FilterByFieldTm(FieldId, RangeMinMax.Val1, RangeMinMax.Val2);
+    } else if (QueryItem.IsRangeFlt()) {
+        const TFltPr RangeMinMax = QueryItem.GetRangeFltMinMax();
+        RecSet->FilterByFieldFlt(FieldId, RangeMinMax.Val1, RangeMinMax.Val2);
+    } else if (QueryItem.IsRangeSFlt()) {
+        const TSFltPr RangeMinMax = QueryItem.GetRangeSFltMinMax();
+        RecSet->FilterByFieldSFlt(FieldId, RangeMinMax.Val1, RangeMinMax.Val2);
+    } else {
+        throw TQmExcept::New("Unsupported range query item type");
+    }
+    return RecSet;
+}
+
+void TBase::SetQueryCacheSize(const uint64& MxMemUsed) {
+    QueryCache = (MxMemUsed > 0) ? TQueryCache::New(MxMemUsed) : PQueryCache();
+}
+
+void TBase::SetStreamAggrThreads(const int& Threads) {
+    QmAssertR(Threads > 0, "Number of stream aggregate threads must be positive");
+    StreamAggrThreads = Threads;
+    for (int StoreN = 0; StoreN < GetStores(); StoreN++) {
+        GetStreamAggrSet(GetStoreByStoreN(StoreN)->GetStoreId())->SetThreads(StreamAggrThreads);
+    }
+}
+
+void TBase::SetCachePolicy(const TCachePolicy& _CachePolicy) {
+    TFlushGuard FlushGuard(FlushLock);
+    CachePolicy = _CachePolicy;
+    Index->SetCachePolicy(CachePolicy);
+    for (int StoreN = 0; StoreN < GetStores(); StoreN++) {
+        GetStoreByStoreN(StoreN)->SetCachePolicy(CachePolicy);
+    }
+}
+
+uint64 TBase::EstimateRecs(const TQueryItem& QueryItem) {
+    if (QueryItem.IsGix()) {
+        if (QueryItem.IsEqual() || QueryItem.IsNotEqual()) {
+            // all words must match, cannot get more than the rarest one
+            if (QueryItem.GetWordIdV().Empty()) { return 0; }
+            uint64 Recs = TUInt64::Mx;
+            for (const uint64 WordId : QueryItem.GetWordIdV()) {
+                Recs = TMath::Mn(Recs, Index->GetGixRecs(QueryItem.GetKeyId(), WordId));
+            }
+            return Recs;
+        } else {
+            // any word can match
+            uint64 Recs = 0;
+            for (const uint64 WordId : QueryItem.GetWordIdV()) {
+                Recs += Index->GetGixRecs(QueryItem.GetKeyId(), WordId);
+            }
+            return TMath::Mn(Recs, QueryItem.GetStore(this)->GetRecs());
+        }
+    } else if (QueryItem.IsGeo()) {
+        // limit is always given
+        return TMath::Mn((uint64)QueryItem.GetLocLimit(), QueryItem.GetStore(this)->GetRecs());
+    } else if (QueryItem.IsRangeInt()) {
+        return Index->GetLinearRecs(QueryItem.GetKeyId(), QueryItem.GetRangeIntMinMax());
+    } else if (QueryItem.IsRangeInt16()) {
+        return Index->GetLinearRecs(QueryItem.GetKeyId(), QueryItem.GetRangeInt16MinMax());
+    } else if (QueryItem.IsRangeInt64()) {
+        return Index->GetLinearRecs(QueryItem.GetKeyId(), QueryItem.GetRangeInt64MinMax());
+    } else if (QueryItem.IsRangeByte()) {
+        return Index->GetLinearRecs(QueryItem.GetKeyId(), QueryItem.GetRangeByteMinMax());
+    } else if (QueryItem.IsRangeUInt()) {
+        return Index->GetLinearRecs(QueryItem.GetKeyId(), QueryItem.GetRangeUIntMinMax());
+    } else if (QueryItem.IsRangeUInt16()) {
+        return Index->GetLinearRecs(QueryItem.GetKeyId(), QueryItem.GetRangeUInt16MinMax());
+    } else if (QueryItem.IsRangeUInt64() || QueryItem.IsRangeTm()) {
+        return Index->GetLinearRecs(QueryItem.GetKeyId(), QueryItem.GetRangeUInt64MinMax());
+    } else if (QueryItem.IsRangeFlt()) {
+        return Index->GetLinearRecs(QueryItem.GetKeyId(), QueryItem.GetRangeFltMinMax());
+    } else if (QueryItem.IsRangeSFlt()) {
+        return Index->GetLinearRecs(QueryItem.GetKeyId(), QueryItem.GetRangeSFltMinMax());
+    } else if (QueryItem.IsRec()) {
+        return 1;
+    } else if (QueryItem.IsRecSet()) {
+        return (uint64)QueryItem.GetRecSet()->GetRecs();
+    } else if (QueryItem.IsNot()) {
+        // we retrieve the records to exclude
+        return EstimateRecs(QueryItem.GetItem(0));
+    } else if (QueryItem.IsAnd()) {
+        // cannot get more than the smallest of non-negated items
+        uint64 Recs = TUInt64::Mx;
+        for (int ItemN = 0; ItemN < QueryItem.GetItems(); ItemN++) {
+            const TQueryItem& Item = QueryItem.GetItem(ItemN);
+            if (!Item.IsNegated()) { Recs = TMath::Mn(Recs, EstimateRecs(Item)); }
+        }
+        if (Recs != TUInt64::Mx) { return Recs; }
+    } else if (QueryItem.IsOr()) {
+        // at most all items together
+        uint64 Recs = 0;
+        for (int ItemN = 0; ItemN < QueryItem.GetItems(); ItemN++) {
+            Recs += EstimateRecs(QueryItem.GetItem(ItemN));
+        }
+        return TMath::Mn(Recs, QueryItem.GetStore(this)->GetRecs());
+    }
+    // no better estimate than the whole store (text position, join, store, AND of negations)
+    return QueryItem.GetStore(this)->GetRecs();
+}
+
+TPair<TBool, PRecSet> TBase::_Search(const TQueryItem& QueryItem, const TUInt64IntKdV* FilterRecIdFqV) {
+    // index and stores are read by the leaf items, which hold the lock against the writer,
+    // while the results of the operators are combined without it
+    const bool LeafP = !(QueryItem.IsAnd() || QueryItem.IsOr() || QueryItem.IsNot());
+    TFlushGuard FlushGuard(LeafP ? FlushLock : PFlushLock());
     if (QueryItem.IsGix()) {
         // we have gix query, check what is the comparison operator
         if (QueryItem.IsEqual() || QueryItem.IsNotEqual()) {
             // ==, !=
             // both cases require same search on Gix
-            PRecSet RecSet = Index->SearchGixAnd(this, QueryItem.GetKeyId(), QueryItem.GetWordIdV());
+            PRecSet RecSet = Index->SearchGixAnd(this, QueryItem.GetKeyId(),
+                QueryItem.GetWordIdV(), FilterRecIdFqV);
             // difference is that in NotEqual we negate the result
             const bool NotP = QueryItem.IsNotEqual();
             // return the pair
@@ -6623,7 +8140,8 @@ TPair<TBool, PRecSet> TBase::_Search(const TQueryItem& QueryItem) {
         } else if (QueryItem.IsGreater() || QueryItem.IsLess() || QueryItem.IsWildChar()) {
             // >=, <=, ~
             // we already extended the query to all possible words, just execute
-            PRecSet RecSet = Index->SearchGixOr(this, QueryItem.GetKeyId(), QueryItem.GetWordIdV());
+            PRecSet RecSet = Index->SearchGixOr(this, QueryItem.GetKeyId(),
+                QueryItem.GetWordIdV(), FilterRecIdFqV);
             // return the pair without any negation
             return TPair<TBool, PRecSet>(false, RecSet);
         } else {
@@ -6648,6 +8166,11 @@ TPair<TBool, PRecSet> TBase::_Search(const TQueryItem& QueryItem) {
                 QueryItem.GetLoc(), QueryItem.GetLocLimit());
             return TPair<TBool, PRecSet>(false, RecSet);
         }
+    } else if (QueryItem.IsRange() && FilterRecIdFqV != NULL
+            && IndexVoc->GetKey(QueryItem.GetKeyId()).GetFields() == 1
+            && EstimateRecs(QueryItem) > (uint64)QueryFilterRatio * (uint64)FilterRecIdFqV->Len()) {
+        // cheaper to check the field of the few records we will keep than to read the whole range
+        return TPair<TBool, PRecSet>(false, FilterRange(QueryItem, *FilterRecIdFqV));
     } else if (QueryItem.IsRangeInt()) {
         // must be handled by BTree linear index
         PRecSet RecSet = Index->SearchLinear(this, QueryItem.GetKeyId(), QueryItem.GetRangeIntMinMax());
@@ -6677,6 +8200,14 @@ TPair<TBool, PRecSet> TBase::_Search(const TQueryItem& QueryItem) {
         PRecSet RecSet = Index->SearchLinear(this, QueryItem.GetKeyId(), QueryItem.GetRangeUInt64MinMax());
         return TPair<TBool, PRecSet>(false, RecSet);
     } else if (QueryItem.IsRangeTm()) {
+        // segmented stores only look at the segments overlapping the range
+        const TIndexKey& Key = IndexVoc->GetKey(QueryItem.GetKeyId());
+        TWPt<TStore> Store = GetStoreByStoreId(Key.GetStoreId());
+        if (Key.GetFields() == 1 && Store->IsSegmentField(Key.GetFieldId(0))) {
+            const TUInt64Pr RangeMinMax = QueryItem.GetRangeUInt64MinMax();
+            TUInt64V RecIdV; Store->SearchSegments(Key.GetFieldId(0), RangeMinMax.Val1, RangeMinMax.Val2, RecIdV);
+            return TPair<TBool, PRecSet>(false, TRecSet::New(Store, RecIdV));
+        }
         // must be handled by BTree linear index
         PRecSet RecSet = Index->SearchLinear(this, QueryItem.GetKeyId(), QueryItem.GetRangeUInt64MinMax());
         return TPair<TBool, PRecSet>(false, RecSet);
@@ -6718,53 +8249,68 @@ TPair<TBool, PRecSet> TBase::_Search(const TQueryItem& QueryItem) {
         // return whole store as record set
         const uint StoreId = QueryItem.GetStoreId();
         const TWPt<TStore> Store = GetStoreByStoreId(StoreId);
+        // all the records we would be intersected with are already in the store
+        if (FilterRecIdFqV != NULL) {
+            // weighted the same as the whole store
+            TUInt64V RecIdV; GetKeyV(*FilterRecIdFqV, RecIdV);
+            return TPair<TBool, PRecSet>(false, TRecSet::New(Store, RecIdV));
+        }
         return TPair<TBool, PRecSet>(false, Store->GetAllRecs());
+    } else if (QueryItem.IsAnd()) {
+        // decide on the order of execution
+        TIntV ItemNV; GetAndPlan(QueryItem, ItemNV);
+        // prepare working vectors with the first records set
+        TPair<TBool, PRecSet> FirstNotRecSet = _Search(QueryItem.GetItem(ItemNV[0]), FilterRecIdFqV);
+        TUInt64IntKdV ResRecIdFqV = FirstNotRecSet.Val2->GetRecIdFqV();
+        QmAssert(ResRecIdFqV.IsSorted());
+        // current negation status
+        bool NotP = FirstNotRecSet.Val1;
+        // than handle the rest here
+        for (int PlanN = 1; PlanN < ItemNV.Len(); PlanN++) {
+            // nothing left to intersect with
+            if (!NotP && ResRecIdFqV.Empty()) { break; }
+            // the rest of the items only need to be correct for the records we already have
+            const TUInt64IntKdV* ItemFilterRecIdFqV = NotP ? FilterRecIdFqV : &ResRecIdFqV;
+            TPair<TBool, PRecSet> NotRecSet = _Search(QueryItem.GetItem(ItemNV[PlanN]), ItemFilterRecIdFqV);
+            // get the vector
+            const TUInt64IntKdV& RecIdFqV = NotRecSet.Val2->GetRecIdFqV();
+            const bool ItemNotP = NotRecSet.Val1;
+            // decide for the operation based on not status
+            if (!NotP && !ItemNotP) {
+                // life is easy, just do the intersect
+                Index->GetSumMerger()->Intrs(ResRecIdFqV, RecIdFqV);
+            } else if (NotP && ItemNotP) {
+                // all negation, do the union
+                Index->GetSumMerger()->Union(ResRecIdFqV, RecIdFqV);
+            } else if (NotP && !ItemNotP) {
+                // records from RecIdFqV should not be in the main
+                TUInt64IntKdV _ResRecIdFqV;
+                Index->GetSumMerger()->Minus(RecIdFqV, ResRecIdFqV, _ResRecIdFqV);
+                ResRecIdFqV = _ResRecIdFqV;
+                NotP = false;
+            } else if (!NotP && ItemNotP) {
+                // records from main should not be in the RecIdFqV
+                TUInt64IntKdV _ResRecIdFqV;
+                Index->GetSumMerger()->Minus(ResRecIdFqV, RecIdFqV, _ResRecIdFqV);
+                ResRecIdFqV = _ResRecIdFqV;
+                NotP = false;
+            }
+        }
+        // prepare resulting record set
+        PRecSet RecSet = TRecSet::New(FirstNotRecSet.Val2->GetStore(), ResRecIdFqV, QueryItem.IsFq());
+        return TPair<TBool, PRecSet>(NotP, RecSet);
     } else {
         // we have an operator, make sure it is so!
-        QmAssert(QueryItem.IsAnd() || QueryItem.IsOr() || QueryItem.IsNot());
+        QmAssert(QueryItem.IsOr() || QueryItem.IsNot());
         // exeucte all interal query items
         TBoolV NotV; TRecSetV RecSetV;
         for (int ItemN = 0; ItemN < QueryItem.GetItems(); ItemN++) {
             // do subsequent search
-            TPair<TBool, PRecSet> NotRecSet = _Search(QueryItem.GetItem(ItemN));
+            TPair<TBool, PRecSet> NotRecSet = _Search(QueryItem.GetItem(ItemN), FilterRecIdFqV);
             NotV.Add(NotRecSet.Val1); RecSetV.Add(NotRecSet.Val2);
         }
         // merge the results according to the operator
-        if (QueryItem.IsAnd()) {
-            // prepare working vectors with the first records set
-            TUInt64IntKdV ResRecIdFqV = RecSetV[0]->GetRecIdFqV();
-            QmAssert(ResRecIdFqV.IsSorted());
-            // current negation status
-            bool NotP = NotV[0];
-            // than handle the rest here
-            for (int ItemN = 1; ItemN < RecSetV.Len(); ItemN++) {
-                // get the vector
-                const TUInt64IntKdV& RecIdFqV = RecSetV[ItemN]->GetRecIdFqV();
-                // decide for the operation based on not status
-                if (!NotP && !NotV[ItemN]) {
-                    // life is easy, just do the intersect
-                    Index->GetSumMerger()->Intrs(ResRecIdFqV, RecIdFqV);
-                } else if (NotP && NotV[ItemN]) {
-                    // all negation, do the union
-                    Index->GetSumMerger()->Union(ResRecIdFqV, RecIdFqV);
-                } else if (NotP && !NotV[ItemN]) {
-                    // records from RecIdFqV should not be in the main
-                    TUInt64IntKdV _ResRecIdFqV;
-                    Index->GetSumMerger()->Minus(RecIdFqV, ResRecIdFqV, _ResRecIdFqV);
-                    ResRecIdFqV = _ResRecIdFqV;
-                    NotP = false;
-                } else if (!NotP && NotV[ItemN]) {
-                    // records from main should not be in the RecIdFqV
-                    TUInt64IntKdV _ResRecIdFqV;
-                    Index->GetSumMerger()->Minus(ResRecIdFqV, RecIdFqV, _ResRecIdFqV);
-                    ResRecIdFqV = _ResRecIdFqV;
-                    NotP = false;
-                }
-            }
-            // prepare resulting record set
-            PRecSet RecSet = TRecSet::New(RecSetV[0]->GetStore(), ResRecIdFqV, QueryItem.IsFq());
-            return TPair<TBool, PRecSet>(NotP, RecSet);
-        } else if (QueryItem.IsOr()) {
+        if (QueryItem.IsOr()) {
             // prepare working vectors with the first records set
             TUInt64IntKdV ResRecIdFqV = RecSetV[0]->GetRecIdFqV();
             QmAssert(ResRecIdFqV.IsSorted());
@@ -6833,7 +8379,7 @@ void TBase::SaveBaseConf(const TStr& FPath) const {
 }
 
 TBase::TBase(const TStr& _FPath, const int64& IndexCacheSize, const int& SplitLen,
-        const bool& StrictNmP): InitP(false), NmValidator(StrictNmP) {
+        const bool& StrictNmP): InitP(false), NmValidator(StrictNmP), CachePolicy(cpLru), StreamAggrThreads(1) {
 
     IAssertR(TEnv::IsInit(), "QMiner environment (TQm::TEnv) is not initialized");
     // open as create
@@ -6843,6 +8389,10 @@ TBase::TBase(const TStr& _FPath, const int64& IndexCacheSize, const int& SplitLe
     IndexVoc = TIndexVoc::New();
     Index = TIndex::New(FPath, FAccess, IndexVoc, IndexCacheSize,
         IndexCacheSize, IndexCacheSize, IndexCacheSize, SplitLen);
+    // stores and index share the lock with the background flusher
+    FlushLock = TFlushLock::New();
+    Index->SetFlushLock(FlushLock);
+    SnapshotGate = TSnapshotGate::New();
     // initialize store blob base
     StoreBlobBs = TMBlobBs::New(FPath + "StoreBlob", FAccess);
     // initialize with empty stores
@@ -6852,7 +8402,7 @@ TBase::TBase(const TStr& _FPath, const int64& IndexCacheSize, const int& SplitLe
 }
 
 TBase::TBase(const TStr& _FPath, const TFAccess& _FAccess, const int64& IndexCacheSize,
-        const int& SplitLen): InitP(false), NmValidator(true) {
+        const int& SplitLen): InitP(false), NmValidator(true), CachePolicy(cpLru), StreamAggrThreads(1) {
 
     IAssertR(TEnv::IsInit(), "QMiner environment (TQm::TEnv) is not initialized");
     // assert open type and remember location
@@ -6873,6 +8423,10 @@ TBase::TBase(const TStr& _FPath, const TFAccess& _FAccess, const int64& IndexCac
     IndexVoc = TIndexVoc::Load(IndexVocFIn);
     Index = TIndex::New(FPath, FAccess, IndexVoc, IndexCacheSize,
         IndexCacheSize, IndexCacheSize, IndexCacheSize, SplitLen);
+    // stores and index share the lock with the background flusher
+    FlushLock = TFlushLock::New();
+    Index->SetFlushLock(FlushLock);
+    SnapshotGate = TSnapshotGate::New();
     // load shared store blob base
     StoreBlobBs = TMBlobBs::New(FPath + "StoreBlob", FAccess);
     // initialize with empty stores
@@ -6885,6 +8439,8 @@ TBase::TBase(const TStr& _FPath, const TFAccess& _FAccess, const int64& IndexCac
 }
 
 TBase::~TBase() {
+    // stop writing in the background before stores and index are closed
+    StopFlusher();
     if (FAccess != faRdOnly) {
         TEnv::Logger->OnStatus("Saving index vocabulary ... ");
 
@@ -6915,6 +8471,7 @@ void TBase::AddStore(const PStore& NewStore) {
     const uint StoreId = NewStore->GetStoreId();
     QmAssertR(StoreId < TEnv::GetMxStores(), "Store ID to large: " + TUInt::GetStr(StoreId));
     // remember pointer to store
+    TFlushGuard FlushGuard(FlushLock);
     StoreV[StoreId] = NewStore;
     // fast map from store name to store
     StoreH.AddDat(NewStore->GetStoreNm(), NewStore);
@@ -6926,6 +8483,9 @@ void TBase::AddStore(const PStore& NewStore) {
     NewStore->AddTrigger(TStreamAggrTrigger::New(StreamAggrSet));
     // remember the aggregate base for the store
     StreamAggrSetV[StoreId] = dynamic_cast<TStreamAggrSet*>(StreamAggrSet());
+    // stores start with the default policy
+    if (CachePolicy != cpLru) { NewStore->SetCachePolicy(CachePolicy); }
+    StreamAggrSetV[StoreId]->SetThreads(StreamAggrThreads);
 }
 
 const TWPt<TStore> TBase::GetStoreByStoreN(const int& StoreN) const {
@@ -6957,6 +8517,11 @@ void TBase::AddStreamAggr(const PStreamAggr& StreamAggr) {
     StreamAggrH.AddDat(StreamAggr->GetAggrNm(), StreamAggr);
 }
 
+void TBase::DelStreamAggr(const TStr& StreamAggrNm) {
+    QmAssertR(IsStreamAggr(StreamAggrNm), "Unknown stream aggregate: " + StreamAggrNm);
+    StreamAggrH.DelKey(StreamAggrNm);
+}
+
 TWPt<TStreamAggr> TBase::GetStreamAggr(const TStr& StreamAggrNm) const {
     QmAssertR(IsStreamAggr(StreamAggrNm), "Unknown stream aggregate: " + StreamAggrNm);
     return dynamic_cast<TStreamAggr*>(StreamAggrH.GetDat(StreamAggrNm)());
@@ -7020,6 +8585,30 @@ uint64 TBase::AddRec(const uint& StoreId, const PJsonVal& RecVal) {
 }
 
 PRecSet TBase::Search(const PQuery& Query) {
+    // results of queries without aggregates can be served from the cache
+    TChA KeyChA; TUIntSet StoreIdSet;
+    const bool CacheP = !QueryCache.Empty() && Query->GetAggrItemV().Empty() &&
+        Query->GetCacheKey(this, KeyChA, StoreIdSet);
+    PRecSet RecSet;
+    if (CacheP && QueryCache->Get(this, KeyChA, RecSet)) {
+        // callers are free to change the returned record set
+        return RecSet->Clone();
+    }
+    RecSet = ExecQuery(Query, PReadSnapshot());
+    if (CacheP) { QueryCache->Put(this, KeyChA, StoreIdSet, RecSet->Clone()); }
+    return RecSet;
+}
+
+PRecSet TBase::ExecQuery(const PQuery& Query, const PReadSnapshot& Snapshot) {
+    // when only the first few records are needed, execute the query in steps until we have them
+    const int LimitRecs = Query->GetLimitRecs();
+    if (LimitRecs != -1 && !Query->IsSort() && Query->GetAggrItemV().Empty() && Snapshot.Empty()
+            && TQueryCursor::IsCursor(this, Query->GetQueryItem())) {
+
+        TQueryCursor Cursor(this, Query->GetQueryItem(), LimitRecs);
+        TUInt64IntKdV RecIdFqV; Cursor.GetRecs(LimitRecs, RecIdFqV);
+        return Query->GetLimit(TRecSet::New(Query->GetStore(this), RecIdFqV, Query->IsFq()));
+    }
     // do the search
     TPair<TBool, PRecSet> NotRecSet = _Search(Query->GetQueryItem());
     // take the resulting record set
@@ -7027,8 +8616,13 @@ PRecSet TBase::Search(const PQuery& Query) {
     Assert(!RecSet.Empty());
     // if result should be negated, do the invert
     if (NotRecSet.Val1) { RecSet = Invert(RecSet); }
-    // get the aggregates
-    Aggr(RecSet, Query->GetAggrItemV());
+    // remove records added after the snapshot
+    if (!Snapshot.Empty()) { Snapshot->Filter(RecSet); }
+    // get the aggregates, they are free to read anything from the base
+    if (!Query->GetAggrItemV().Empty()) {
+        TFlushGuard FlushGuard(FlushLock);
+        Aggr(RecSet, Query->GetAggrItemV());
+    }
     // sort if necessary
     if (Query->IsSort()) { Query->Sort(this, RecSet); }
     // trim if necessary
@@ -7049,7 +8643,24 @@ PRecSet TBase::Search(const PJsonVal& QueryVal) {
     return Search(TQuery::New(this, QueryVal));
 }
 
+PRecSet TBase::Search(const PQuery& Query, const PReadSnapshot& Snapshot) {
+    QmAssertR(!Snapshot.Empty(), "Missing read snapshot");
+    return ExecQuery(Query, Snapshot);
+}
+
+PRecSet TBase::Search(const PJsonVal& QueryVal, const PReadSnapshot& Snapshot) {
+    PQuery Query;
+    {
+        // parsing looks up words and keys in the index vocabulary
+        TFlushGuard FlushGuard(FlushLock);
+        Query = TQuery::New(this, QueryVal);
+    }
+    return Search(Query, Snapshot);
+}
+
 void TBase::GarbageCollect() {
+    // open read snapshots must not see records disappear
+    TDeleteGuard DeleteGuard(SnapshotGate);
     int StoreKeyId = StoreH.FFirstKeyId();
     while (StoreH.FNextKeyId(StoreKeyId)) {
         StoreH[StoreKeyId]->GarbageCollect();
@@ -7091,7 +8702,7 @@ bool TBase::SaveJSonDump(const TStr& DumpDir) {
         TQm::TEnv::Logger->OnStatusFmt("Backing up store %s", StoreNm.CStr());
 
         const uint64 Recs = Store->GetRecs();
-        PStoreIter Iter = Store->GetIter();
+        PStoreIter Iter = Store->GetScanIter();
         while (Iter->Next()) {
             const uint64 RecId = Iter->GetRecId();
 
@@ -7132,32 +8743,40 @@ bool TBase::RestoreJSonDump(const TStr& DumpDir) {
     TTm CurrentTime = TTm::GetCurLocTm();
 
     THash<TStr, THash<TUInt64, TUInt64> > StoreOldToNewIdHH;
-    for (int S = 0; S < Stores; S++) {
-        PStore Store = GetStoreByStoreN(S);
-        const TStr StoreNm = Store->GetStoreNm();
-        THash<TUInt64, TUInt64> OldToNewIdH;
-        TQm::TEnv::Logger->OnStatusFmt("Adding recs for store %s", StoreNm.CStr());
-        if (TFile::Exists(DumpDir + StoreNm + ".json")) {
-            PSIn InRecs = TFIn::New(DumpDir + StoreNm + ".json");
-            TStr Line;
-            while (InRecs->GetNextLn(Line)) {
-                const PJsonVal Json = TJsonVal::GetValFromStr(Line);
-                const uint64 ExRecId = Json->IsObjKey("$id") ? (uint64)Json->GetObjNum("$id") : TUInt64::Mx;
-                Json->DelObjKey("$id");
-                const uint64 RecId = Store->AddRec(Json);
-                OldToNewIdH.AddDat(ExRecId, RecId);
-                // validate that the added rec id is the same as the one that was saved in json
-                // if this fails then we have a problem since the joins will point different records than in the original data
-                //AssertR(ExRecId == TUInt64::Mx || ExRecId == RecId, "The added record id does not match the one in the record json");
-                if (RecId % 1000 == 0) {
-                    TQm::TEnv::Logger->OnStatusFmt("Added record %I64u\r", RecId);
+    // indexes are built in one pass after all records are added
+    Index->StartBatch();
+    try {
+        for (int S = 0; S < Stores; S++) {
+            PStore Store = GetStoreByStoreN(S);
+            const TStr StoreNm = Store->GetStoreNm();
+            THash<TUInt64, TUInt64> OldToNewIdH;
+            TQm::TEnv::Logger->OnStatusFmt("Adding recs for store %s", StoreNm.CStr());
+            if (TFile::Exists(DumpDir + StoreNm + ".json")) {
+                PSIn InRecs = TFIn::New(DumpDir + StoreNm + ".json");
+                TStr Line;
+                while (InRecs->GetNextLn(Line)) {
+                    const PJsonVal Json = TJsonVal::GetValFromStr(Line);
+                    const uint64 ExRecId = Json->IsObjKey("$id") ? (uint64)Json->GetObjNum("$id") : TUInt64::Mx;
+                    Json->DelObjKey("$id");
+                    const uint64 RecId = Store->AddRec(Json);
+                    OldToNewIdH.AddDat(ExRecId, RecId);
+                    // validate that the added rec id is the same as the one that was saved in json
+                    // if this fails then we have a problem since the joins will point different records than in the original data
+                    //AssertR(ExRecId == TUInt64::Mx || ExRecId == RecId, "The added record id does not match the one in the record json");
+                    if (RecId % 1000 == 0) {
+                        TQm::TEnv::Logger->OnStatusFmt("Added record %I64u\r", RecId);
+                    }
                 }
+            } else {
+                TQm::TEnv::Logger->OnStatusFmt("WARNING: File for store %s is missing. No data was imported.", StoreNm.CStr());
             }
-        } else {
-            TQm::TEnv::Logger->OnStatusFmt("WARNING: File for store %s is missing. No data was imported.", StoreNm.CStr());
+            StoreOldToNewIdHH.AddDat(StoreNm, OldToNewIdH);
         }
-        StoreOldToNewIdHH.AddDat(StoreNm, OldToNewIdH);
+    } catch (...) {
+        Index->EndBatch();
+        throw;
     }
+    Index->EndBatch();
 
     for (int S = 0; S < Stores; S++) {
         const PStore Store = GetStoreByStoreN(S);
@@ -7288,6 +8907,7 @@ void TBase::PrintIndex(const TStr& FNm, const bool& SortP) {
 
 // perform partial flush of data
 int TBase::PartialFlush(int WndInMsec) {
+    TFlushGuard FlushGuard(FlushLock);
     int dirty_stores = (GetStores() + 1);
     int saved = 100;
     int res = 0;
@@ -7338,8 +8958,113 @@ int TBase::PartialFlush(int WndInMsec) {
     return res;
 }
 
+uint64 TBase::GetDirtyBytes() {
+    TFlushGuard FlushGuard(FlushLock);
+    uint64 DirtyBytes = Index->GetDirtyBytes();
+    for (int StoreN = 0; StoreN < GetStores(); StoreN++) {
+        DirtyBytes += GetStoreByStoreN(StoreN)->GetDirtyBytes();
+    }
+    return DirtyBytes;
+}
+
+void TBase::StartFlusher(const TBaseFlusherParam& Param) {
+    QmAssertR(!IsRdOnly(), "Cannot flush base opened in read-only mode");
+    StopFlusher();
+    TEnv::Logger->OnStatusFmt("Starting background flusher (target %s dirty bytes)",
+        TUInt64::GetStr(Param.DirtyTarget).CStr());
+    FlushLock->SetActive(true);
+    Flusher = TBaseFlusher::New(this, FlushLock, Param);
+    Flusher->Start();
+}
+
+void TBase::StopFlusher() {
+    if (Flusher.Empty()) { return; }
+    Flusher->Stop();
+    Flusher.Clr();
+    FlushLock->SetActive(ConcurrentReadsP);
+    TEnv::Logger->OnStatus("Background flusher stopped");
+}
+
+void TBase::SetConcurrentReads(const bool& _ConcurrentReadsP) {
+    QmAssertR(SnapshotGate->GetSnapshots() == 0, "Cannot change concurrent reads while snapshots are open");
+    ConcurrentReadsP = _ConcurrentReadsP;
+    FlushLock->SetActive(ConcurrentReadsP || !Flusher.Empty());
+}
+
+PReadSnapshot TBase::GetSnapshot() {
+    return TReadSnapshot::New(this);
+}
+
+void TBase::Flush() {
+    QmAssertR(!IsRdOnly(), "Cannot flush base opened in read-only mode");
+    TFlushGuard FlushGuard(FlushLock);
+    for (int StoreN = 0; StoreN < GetStores(); StoreN++) {
+        GetStoreByStoreN(StoreN)->Flush();
+    }
+    Index->Flush();
+    StoreBlobBs->Flush();
+    {
+        TFOut IndexVocFOut(FPath + "IndexVoc.dat");
+        IndexVoc->Save(IndexVocFOut);
+    }
+    SaveBaseConf(FPath);
+}
+
+void TBase::StartWal(const TWalParam& Param) {
+    QmAssertR(!IsRdOnly(), "Cannot log base opened in read-only mode");
+    for (int StoreN = 0; StoreN < GetStores(); StoreN++) {
+        const TWPt<TStore> Store = GetStoreByStoreN(StoreN);
+        QmAssertR(Store->IsWalSupported(), "Store " + Store->GetStoreNm() + " does not support write-ahead log");
+    }
+    StopWal();
+    TEnv::Logger->OnStatusFmt("Starting write-ahead log (sync interval %d ms)", Param.SyncMSec.Val);
+    // current state of the base is the first checkpoint
+    Flush();
+    TFlushGuard FlushGuard(FlushLock);
+    Wal = TWal::New(FPath, Param);
+    // background flusher syncs the log
+    if (Flusher.Empty() && Param.SyncMSec > 0) { StartFlusher(); }
+}
+
+void TBase::StopWal() {
+    if (Wal.Empty()) { return; }
+    QmAssertR(!Wal->IsInOp(), "Cannot stop write-ahead log during store operation");
+    Flush();
+    TFlushGuard FlushGuard(FlushLock);
+    Wal.Clr();
+    TEnv::Logger->OnStatus("Write-ahead log stopped");
+}
+
+void TBase::Checkpoint() {
+    QmAssertR(!Wal.Empty(), "Write-ahead log is not running");
+    QmAssertR(!Wal->IsInOp(), "Cannot checkpoint during store operation");
+    TFlushGuard FlushGuard(FlushLock);
+    Flush();
+    Wal->Checkpoint();
+}
+
+void TBase::SyncWal() {
+    TFlushGuard FlushGuard(FlushLock);
+    if (!Wal.Empty() && Wal->IsSyncDue()) { Wal->Sync(); }
+}
+
+void TBase::Recover(const PWal& RecoverWal) {
+    // base is at the last checkpoint, repeat the operations logged after it
+    WalReplayP = true;
+    try {
+        RecoverWal->Replay(this);
+    } catch (const PExcept& Except) {
+        WalReplayP = false; throw Except;
+    }
+    WalReplayP = false;
+    // replayed operations are saved, the log is not needed anymore
+    Flush();
+    RecoverWal->Close();
+}
+
 /// get performance statistics in JSON form
 PJsonVal TBase::GetStats() {
+    TFlushGuard FlushGuard(FlushLock);
     PJsonVal res = TJsonVal::NewObj();
 
     PJsonVal stores = TJsonVal::NewArr();
@@ -7352,6 +9077,11 @@ PJsonVal TBase::GetStats() {
     res->AddToObj("gix_stats", GixStatsToJson(gix_stats));
     res->AddToObj("gix_blob", BlobBsStatsToJson(gix_blob_stats));
     res->AddToObj("access", GetFAccess());
+    res->AddToObj("cache_policy", TCachePolicyStr::GetStr(CachePolicy));
+    if (!QueryCache.Empty()) { res->AddToObj("query_cache", QueryCache->GetStats()); }
+    res->AddToObj("dirty_bytes", GetDirtyBytes());
+    if (!Flusher.Empty()) { res->AddToObj("flusher", Flusher->GetStats()); }
+    if (!Wal.Empty()) { res->AddToObj("wal", Wal->GetStats()); }
     return res;
 }
 
@@ -7449,6 +9179,12 @@ PJsonVal GixStatsToJson(const TGixStats& stats) {
     res->AddToObj("cache_dirty", stats.CacheDirty);
     res->AddToObj("cache_dirty_loaded_perc", stats.CacheDirtyLoadedPerc);
     res->AddToObj("mem_sed", (uint64)stats.MemUsed);
+    res->AddToObj("child_raw_size", (uint64)stats.ChildRawSize);
+    res->AddToObj("child_encoded_size", (uint64)stats.ChildEncodedSize);
+    res->AddToObj("compression_ratio", stats.GetCompressionRatio());
+    res->AddToObj("cache_hits", (uint64)stats.CacheHits);
+    res->AddToObj("cache_misses", (uint64)stats.CacheMisses);
+    res->AddToObj("cache_hit_rate", stats.GetCacheHitRate());
     return res;
 }
 
@@ -11,6 +11,7 @@
 
 #include <base.h>
 #include <mine.h>
+#include <thread.h>
 
 namespace TQm {
 
@@ -216,6 +217,116 @@ public:
 #define QmAssertR(Cond, MsgStr) \
   ((Cond) ? static_cast<void>(0) : throw TQm::TQmExcept::New(MsgStr, TStr(__FILE__) + " line " + TInt::GetStr(__LINE__) + ": " + TStr(#Cond)))
 
+///////////////////////////////
+/// Flush Lock.
+/// Serializes access to store and index caches between the caller and the background
+/// flusher (TBaseFlusher), and access to store and index structures between the writer
+/// and concurrent readers (see TBase::SetConcurrentReads). Locking is only done while
+/// the lock is active, so bases without a background flusher or concurrent readers
+/// only pay for checking a flag. Lock is recursive.
+class TFlushLock {
+private:
+    // smart-pointer
+    TCRef CRef;
+    friend class TPt<TFlushLock>;
+
+    /// Critical section held while caches are accessed
+    TCriticalSection CriticalSection;
+    /// True while background flusher is running
+    volatile bool ActiveP;
+
+    TFlushLock(): ActiveP(false) { }
+    TFlushLock(const TFlushLock&);
+    TFlushLock& operator=(const TFlushLock&);
+public:
+    static TPt<TFlushLock> New() { return new TFlushLock; }
+
+    /// Is locking required. Must only be changed while no guard is held.
+    bool IsActive() const { return ActiveP; }
+    /// Turn locking on or off
+    void SetActive(const bool& _ActiveP) { ActiveP = _ActiveP; }
+
+    /// Enter critical section
+    void Enter() { CriticalSection.Enter(); }
+    /// Leave critical section
+    void Leave() { CriticalSection.Leave(); }
+};
+typedef TPt<TFlushLock> PFlushLock;
+
+///////////////////////////////
+/// Flush Guard.
+/// Holds flush lock, when active, for the lifetime of the guard.
+class TFlushGuard {
+private:
+    /// Lock we entered, NULL when locking was not required
+    TFlushLock* FlushLock;
+
+    TFlushGuard(const TFlushGuard&);
+    TFlushGuard& operator=(const TFlushGuard&);
+public:
+    TFlushGuard(const PFlushLock& _FlushLock): FlushLock(NULL) {
+        if (!_FlushLock.Empty() && _FlushLock->IsActive()) {
+            FlushLock = _FlushLock(); FlushLock->Enter(); }
+    }
+    ~TFlushGuard() { if (FlushLock != NULL) { FlushLock->Leave(); } }
+};
+
+///////////////////////////////
+/// Snapshot Gate.
+/// Keeps record deletions away from open read snapshots (TReadSnapshot). While snapshots
+/// are open, records are only appended; deletion waits until all of them are released
+/// and new snapshots wait until the deletion is done. Deletions come from the single
+/// writer thread and can be nested. Deletion must not be started while holding a
+/// snapshot or the flush lock, since the readers might need it to finish.
+class TSnapshotGate {
+private:
+    // smart-pointer
+    TCRef CRef;
+    friend class TPt<TSnapshotGate>;
+
+    /// Lock and condition for the counters
+    TCondVarLock CondVarLock;
+    /// Number of open snapshots
+    int Snapshots;
+    /// Depth of deletions running or waiting for the snapshots
+    int Deletes;
+
+    TSnapshotGate(): Snapshots(0), Deletes(0) { }
+    TSnapshotGate(const TSnapshotGate&);
+    TSnapshotGate& operator=(const TSnapshotGate&);
+public:
+    static TPt<TSnapshotGate> New() { return new TSnapshotGate; }
+
+    /// Register new snapshot, waits for running deletion
+    void EnterSnapshot();
+    /// Release snapshot
+    void LeaveSnapshot();
+    /// Start deletion, waits for open snapshots
+    void EnterDelete();
+    /// Deletion is done
+    void LeaveDelete();
+
+    /// Number of open snapshots
+    int GetSnapshots() const { return Snapshots; }
+};
+typedef TPt<TSnapshotGate> PSnapshotGate;
+
+///////////////////////////////
+/// Delete Guard.
+/// Holds snapshot gate for deletion for the lifetime of the guard.
+class TDeleteGuard {
+private:
+    /// Gate we entered
+    PSnapshotGate SnapshotGate;
+
+    TDeleteGuard(const TDeleteGuard&);
+    TDeleteGuard& operator=(const TDeleteGuard&);
+public:
+    TDeleteGuard(const PSnapshotGate& _SnapshotGate): SnapshotGate(_SnapshotGate) {
+        SnapshotGate->EnterDelete(); }
+    ~TDeleteGuard() { SnapshotGate->LeaveDelete(); }
+};
+
 ///////////////////////////////
 /// QMiner Valid Name Enforcer.
 class TNmValidator {
@@ -546,6 +657,30 @@ public:
     uint64 GetRecId() const { return Hash.GetKey(KeyId); }
 };
 
+///////////////////////////////
+/// Store Scan Iterator.
+/// Wraps iterator going over the whole store and keeps a scan open on the store
+/// while it exists, so records read during the scan do not push hot records out
+/// of the store caches. Created by TStore::GetScanIter.
+class TStoreIterScan : public TStoreIter {
+private:
+    /// Store being scanned
+    TWPt<TStore> Store;
+    /// Wrapped iterator
+    PStoreIter Iter;
+
+    TStoreIterScan(const TWPt<TStore>& _Store, const PStoreIter& _Iter);
+public:
+    /// Open scan on the store and wrap given iterator
+    static PStoreIter New(const TWPt<TStore>& Store, const PStoreIter& Iter) {
+        return new TStoreIterScan(Store, Iter); }
+    /// Closes the scan
+    ~TStoreIterScan();
+
+    bool Next() { return Iter->Next(); }
+    uint64 GetRecId() const { return Iter->GetRecId(); }
+};
+
 ///////////////////////////////
 /// Store Trigger.
 /// Interface for defining triggers called when records are added, deleted or updated.
@@ -565,6 +700,8 @@ public:
     virtual void Init(const TWPt<TStore>& Store) { }
     /// Called after record added to the store
     virtual void OnAdd(const TRec& Rec) = 0;
+    /// Called after a batch of records added to the store, default calls OnAdd for each record
+    virtual void OnAddBatch(const TRecSet& RecSet);
     /// Called after record updated in the store
     virtual void OnUpdate(const TRec& Rec) = 0;
     /// Called before record from the store
@@ -610,6 +747,8 @@ private:
     TStrH FieldNmToIdH;
     /// List of active triggers
     TStoreTriggerV TriggerV;
+    /// Version of records and their index, increased on every change
+    TUInt64 RecVer;
 
     /// Load store from stream (to be called only by base class!)
     void LoadStore(TSIn& SIn);
@@ -638,6 +777,10 @@ public:
 protected:
     /// Access to index
     const TWPt<TIndex>& GetIndex() const { return Index; }
+    /// Lock to hold while accessing caches flushed by the background flusher
+    const PFlushLock& GetFlushLock() const;
+    /// Gate to hold while deleting records, see TSnapshotGate
+    const PSnapshotGate& GetSnapshotGate() const;
 
     /// Register new field to the store
     int AddFieldDesc(const TFieldDesc& FieldDesc);
@@ -649,6 +792,9 @@ public:
     void OnAdd(const uint64& RecId);
     /// Should be called after record Rec added; executes OnAdd event in all registered triggers
     void OnAdd(const TRec& Rec);
+    /// Should be called after records RecIdV added; executes OnAddBatch event when there is
+    /// only one trigger and OnAdd event for each record and trigger otherwise
+    void OnAddBatch(const TUInt64V& RecIdV);
     /// Should be called after record RecId updated; executes OnUpdate event in all registered triggers
     void OnUpdate(const uint64& RecId);
     /// Should be called after record Rec updated; executes OnUpdate event in all registered triggers
@@ -658,6 +804,11 @@ public:
     /// Should be called before record Rec deleted; executes OnDelete event in all registered triggers
     void OnDelete(const TRec& Rec);
 
+    /// Version of records and their index, used to check if cached query results are still valid
+    uint64 GetRecVer() const { return RecVer; }
+    /// Should be called when records or their index change outside of the OnAdd, OnUpdate and OnDelete events
+    void IncRecVer() { RecVer++; }
+
 protected:
     /// Helper function for handling string and vector pools
     void StrVToIntV(const TStrV& StrV, TStrHash<TInt, TBigStrPool>& WordH, TIntV& IntV);
@@ -749,8 +900,13 @@ public:
     virtual uint64 GetRecs() const = 0;
     /// Get iterator to go over all records in the store
     virtual PStoreIter GetIter() const = 0;
+    /// Get iterator going over all records, in the same order as GetIter,
+    /// which does not displace hot records from the store caches
+    PStoreIter GetScanIter() const;
     /// Get record set with all the records in the store
     virtual PRecSet GetAllRecs();
+    /// Get ids of all the records in the store, in iterator order
+    void GetRecIdV(TUInt64V& RecIdV) const;
     /// Get record set with random subset of records
     /// @param SampleSize   Number of records to be sampled out
     virtual PRecSet GetRndRecs(const uint64& SampleSize);
@@ -776,9 +932,15 @@ public:
     virtual bool HasFirstRecId() const { return false; }
     /// Is the last record id getter implemented?
     virtual bool HasLastRecId() const { return false; }
+    /// Are all ids between first and last record id valid records, iterated in increasing order?
+    virtual bool HasRecIdRange() const { return false; }
 
     /// Add new record provided as JSon
     virtual uint64 AddRec(const PJsonVal& RecVal, const bool& TriggerEvents = true) = 0;
+    /// Add array of records provided as JSon and return their ids. Index updates are
+    /// deferred and applied in one pass at the end of the batch. When TriggerEvents is
+    /// set, OnAddBatch is called for new records after the batch is indexed.
+    void AddRecBatch(const PJsonVal& RecValV, TUInt64V& RecIdV, const bool& TriggerEvents = true);
     /// Update existing record with updates in provided JSon
     virtual void UpdateRec(const uint64& RecId, const PJsonVal& RecVal) = 0;
 
@@ -803,6 +965,12 @@ public:
     virtual void DeleteFirstRecs(const int& DelRecs) = 0;
     /// Delete specific records
     virtual void DeleteRecs(const TUInt64V& DelRecIdV, const bool& AssertOK = true) = 0;
+    /// True when records are grouped into window segments by time in the given field
+    virtual bool IsSegmentField(const int& FieldId) const { return false; }
+    /// Get sorted ids of records with time in the range, going only over the
+    /// segments overlapping the range. Field must be the segment time field.
+    virtual void SearchSegments(const int& FieldId, const uint64& MinMSecs,
+        const uint64& MaxMSecs, TUInt64V& RecIdV) const { throw TQmExcept::New("Not implemented"); }
 
     /// Check if the value of given field for a given record is NULL
     virtual bool IsFieldNull(const uint64& RecId, const int& FieldId) const { return false; }
@@ -849,6 +1017,25 @@ public:
     /// Get field value using field id
     virtual PJsonVal GetFieldJsonVal(const uint64& RecId, const int& FieldId) const = 0;
 
+    /// Is field stored in columnar layout, making bulk reads a sequential memory sweep
+    virtual bool IsFieldColumnar(const int& FieldId) const { return false; }
+    /// Get values of integer field for given records (default implementation reads records one by one)
+    virtual void GetColumnInt(const int& FieldId, const TUInt64V& RecIdV, TIntV& ValV) const;
+    /// Get values of float field for given records (default implementation reads records one by one)
+    virtual void GetColumnFlt(const int& FieldId, const TUInt64V& RecIdV, TFltV& ValV) const;
+    /// Get values of time field for given records (default implementation reads records one by one)
+    virtual void GetColumnTmMSecs(const int& FieldId, const TUInt64V& RecIdV, TUInt64V& ValV) const;
+    /// Get values of byte or boolean field for given records (default implementation reads records one by one)
+    virtual void GetColumnByte(const int& FieldId, const TUInt64V& RecIdV, TUChV& ValV) const;
+    /// Get values of integer field for all records, ordered by record id
+    virtual void GetColumnInt(const int& FieldId, TIntV& ValV) const;
+    /// Get values of float field for all records, ordered by record id
+    virtual void GetColumnFlt(const int& FieldId, TFltV& ValV) const;
+    /// Get values of time field for all records, ordered by record id
+    virtual void GetColumnTmMSecs(const int& FieldId, TUInt64V& ValV) const;
+    /// Get values of byte or boolean field for all records, ordered by record id
+    virtual void GetColumnByte(const int& FieldId, TUChV& ValV) const;
+
     /// Get field value using field id safely
     uint64 GetFieldUInt64Safe(const uint64& RecId, const int& FieldId) const;
     /// Get field value using field id safely
@@ -1033,8 +1220,20 @@ public:
 
     /// Save part of the data, given time-window
     virtual int PartialFlush(int WndInMsec = 500) { throw TQmExcept::New("Not implemented"); }
+    /// Estimate of bytes that would be written by flushing the store
+    virtual uint64 GetDirtyBytes() { return 0; }
+    /// Save all data to disk, store stays open
+    virtual void Flush() { throw TQmExcept::New("Not implemented"); }
+    /// True when the store writes only through files covered by the write-ahead log journal
+    virtual bool IsWalSupported() const { return false; }
     /// Retrieve performance statistics for this store
     virtual PJsonVal GetStats() { return TJsonVal::NewObj(); }
+    /// Change replacement policy of caches holding records on disk
+    virtual void SetCachePolicy(const TCachePolicy& Policy) { }
+    /// Open scan, records read until EndScan are the first to be dropped from caches
+    virtual void StartScan() const { }
+    /// Close scan opened by StartScan
+    virtual void EndScan() const { }
     /// Run verification for whole store
     virtual void RunVerification() { };
     /// Run verification for single record
@@ -1273,6 +1472,23 @@ public:
     bool operator()(const TUInt64IntKd& RecIdFq1, const TUInt64IntKd& RecIdFq2) const;
 };
 
+///////////////////////////////
+/// Comparator of field values paired with record positions.
+/// Used to select top records by a field, ties are broken by position.
+template <class TVal>
+class TRecCmpByVal {
+private:
+    /// Sort direction
+    TBool Asc;
+public:
+    TRecCmpByVal(const bool& _Asc) : Asc(_Asc) {}
+
+    bool operator()(const TKeyDat<TVal, TInt>& Item1, const TKeyDat<TVal, TInt>& Item2) const {
+        if (Item1.Key == Item2.Key) { return Item1.Dat < Item2.Dat; }
+        return Asc ? (Item1.Key < Item2.Key) : (Item2.Key < Item1.Key);
+    }
+};
+
 ///////////////////////////////
 /// Record Comparator by Integer Field.
 class TRecCmpByFieldInt {
@@ -1969,6 +2185,18 @@ private:
         const bool& FqSampleP, TUInt64IntKdV& SampleRecIdFqV) const;
     /// Removes records from this result set that are not part of the provided
     void LimitToSampleRecIdV(const TUInt64IntKdV& SampleRecIdFqV);
+    /// Keeps records with value in columnar field within given range,
+    /// values are given in the same order as records in the set
+    template <class TVal, class TValV>
+    void FilterByColumn(const TValV& ValV, const TVal& MinVal, const TVal& MaxVal);
+    /// Sorts records by values of columnar field, values are given in the same order as records
+    template <class TVal> void SortByColumn(const bool& Asc, const TVec<TVal>& ValV);
+    /// Keeps first `Recs' records when sorted by given values, values are given in the same order as records
+    template <class TVal> void TopByColumn(const bool& Asc, const TVec<TVal>& ValV, const int& Recs);
+    /// Check if field can be read in bulk and has no null values to check
+    bool IsColumnFilter(const int& FieldId) const;
+    /// Check if records are sorted by strictly increasing ids, as needed by sorted set operations
+    static bool IsSortedSet(const TUInt64IntKdV& RecIdFqV);
 
     TRecSet() { }
     TRecSet(const TWPt<TStore>& Store, const uint64& RecId, const int& Fq);
@@ -2057,6 +2285,16 @@ public:
     void SortByField(const bool& Asc, const int& SortFieldId);
     /// Sort records according to given comparator
     template <class TCmp> void SortCmp(const TCmp& Cmp) { RecIdFqV.SortCmp(Cmp); }
+    /// Keep only first `Recs' records by their weight, sorted. Cheaper than sorting
+    /// all the records when only few of them are needed.
+    /// @param Asc True for sorting in increasing order
+    void TopByFq(const bool& Asc, const int& Recs);
+    /// Keep only first `Recs' records according to field with id `SortFieldId', sorted.
+    /// Cheaper than sorting all the records when only few of them are needed.
+    /// @param Asc True for sorting in increasing order
+    void TopByField(const bool& Asc, const int& SortFieldId, const int& Recs);
+    /// Keep only first `Recs' records according to given comparator, sorted
+    template <class TCmp> void TopCmp(const TCmp& Cmp, const int& Recs);
 
     /// Filter records to keep only the ones which actually exist
     void FilterByExists();
@@ -2064,6 +2302,9 @@ public:
     void FilterByRecId(const uint64& MinRecId, const uint64& MaxRecId);
     /// Filter records to keep only the ones that are present in provided `RecIdSet'
     void FilterByRecIdSet(const TUInt64Set& RecIdSet);
+    /// Filter records to keep only the ones that are present (InP = true) or not present
+    /// (InP = false) in provided record set. Keeps order of records.
+    void FilterByRecSet(const PRecSet& RecSet, const bool& InP);
     /// Filter records to keep only the ones with weight between `MinFq' and `MaxFq'
     void FilterByFq(const int& MinFq, const int& MaxFq);
     /// Filter records to keep only the ones that have a value (RemoveNullValues = true) or don't have a value (RemoveNullValues = false)
@@ -2137,6 +2378,9 @@ public:
     void Merge(const TVec<PRecSet>& RecSetV);
     /// Interest this record set with the provided one. Result is stored in a new record set.
     PRecSet GetIntersect(const PRecSet& RecSet);
+    /// Records from this record set not present in the provided one. Result is stored in
+    /// a new record set and is sorted by ids.
+    PRecSet GetDiff(const PRecSet& RecSet) const;
 
     /// Execute join with the given id
     /// @param SampleSize Sample size used to do the join. When set to -1, all the records are used.
@@ -2679,6 +2923,8 @@ public:
     bool IsRec() const { return (Type == oqitRec); }
     /// Check query type
     bool IsStore() const { return (Type == oqitStore); }
+    /// Check if query returns records to be excluded (not, not equal)
+    bool IsNegated() const { return IsNot() || (IsGix() && IsNotEqual()); }
 
     /// Optimizes query tree by removing unneeded nodes
     void Optimize();
@@ -2687,6 +2933,10 @@ public:
     uint GetStoreId(const TWPt<TBase>& Base) const;
     /// Get result store
     TWPt<TStore> GetStore(const TWPt<TBase>& Base) const;
+    /// Append canonical form of the query item, same for and/or items given in different
+    /// order, and collect ids of stores on which the results depend. Returns false when
+    /// results can not be cached (given records or record sets, sampled joins).
+    bool GetCacheKey(const TWPt<TBase>& Base, TChA& KeyChA, TUIntSet& StoreIdSet) const;
     /// Check if there are no subordinate items or values
     bool Empty() const { return !IsItems() && !IsWordIds(); }
     /// Check if result is weighted (only or-items)
@@ -2854,11 +3104,16 @@ public:
     void Sort(const TWPt<TBase>& Base, const PRecSet& RecSet);
     /// Is there any limit restriction
     bool IsLimit() const { return (Limit != -1) || (Offset != 0); }
+    /// Number of leading records needed to apply the limit (-1 when all are needed)
+    int GetLimitRecs() const { return (Limit == -1) ? -1 : (Offset + Limit); }
     /// Do the range limit, when specified
     PRecSet GetLimit(const PRecSet& RecSet);
 
     /// Check if query is valid
     bool IsOk(const TWPt<TBase>& Base, TStr& MsgStr) const;
+    /// Get canonical form of the query including sort and limit, and ids of stores
+    /// on which the results depend. Returns false when results can not be cached.
+    bool GetCacheKey(const TWPt<TBase>& Base, TChA& KeyChA, TUIntSet& StoreIdSet) const;
 
     /// Access to the query definition
     const TQueryItem& GetQueryItem() const { return QueryItem; }
@@ -2867,6 +3122,112 @@ public:
 };
 typedef TPt<TQuery> PQuery;
 
+///////////////////////////////
+/// Query Cursor.
+/// Executes query lazily over consecutive ranges of record ids, returning results
+/// in increasing order of ids. Each range is passed to the query execution as the
+/// set of candidate records, so index children outside of it are skipped and wide
+/// ranges are checked on the records instead of read from the index. Ranges grow
+/// with each step, so queries matching many records stop after reading only a small
+/// part of the index. Requires store with consecutive record ids, items that can
+/// not be restricted to candidate records (text position, geo, join) are not supported.
+class TQueryCursor {
+private:
+    /// Base on which the query is executed
+    TWPt<TBase> Base;
+    /// Store from which the records are returned
+    TWPt<TStore> Store;
+    /// Query definition
+    TQueryItem QueryItem;
+    /// First record id of the next range
+    uint64 NextRecId;
+    /// Last record id in the store when cursor was created
+    uint64 EndRecId;
+    /// Number of records in the next range
+    uint64 RangeLen;
+
+    /// Check if query item can be restricted to candidate records
+    static bool IsFilter(const TWPt<TBase>& Base, const TQueryItem& QueryItem);
+
+public:
+    /// Smallest range of records evaluated at once
+    static const int MnRangeLen;
+
+    /// Create cursor over results of the query item. First range is sized
+    /// so it is expected to contain at least `Recs' results.
+    TQueryCursor(const TWPt<TBase>& _Base, const TQueryItem& _QueryItem, const int& Recs = 0);
+
+    /// Check if query item can be executed with a cursor
+    static bool IsCursor(const TWPt<TBase>& Base, const TQueryItem& QueryItem);
+
+    /// True when all the records were covered
+    bool IsEnd() const { return NextRecId > EndRecId; }
+    /// Execute query on the next range of records and append its results.
+    /// Returns false when there are no more records.
+    bool Next(TUInt64IntKdV& RecIdFqV);
+    /// Execute query until at least `Recs' results are appended or all records are covered
+    void GetRecs(const int& Recs, TUInt64IntKdV& RecIdFqV);
+};
+
+///////////////////////////////
+/// Query Result Cache.
+/// Keeps results of recent queries within given memory budget, dropping least recently
+/// used results first. Results are keyed by canonical form of the query and remember
+/// record versions of stores they were computed from. Results computed from older
+/// versions are dropped when accessed, so adding, updating or deleting records from
+/// a store invalidates only results which depend on it.
+class TQueryCache {
+private:
+    // smart-pointer
+    TCRef CRef;
+    friend class TPt<TQueryCache>;
+
+    /// Cached query result
+    ClassTP(TItem, PItem)//{
+    public:
+        /// Query results
+        PRecSet RecSet;
+        /// Record versions of stores at the time results were computed
+        TVec<TPair<TUInt, TUInt64> > StoreVerV;
+
+    public:
+        TItem(const PRecSet& _RecSet): RecSet(_RecSet) { }
+
+        /// Check if store versions did not change since the results were computed
+        bool IsValid(const TWPt<TBase>& Base) const;
+        /// Memory footprint, used to keep the cache within budget
+        uint64 GetMemUsed() const;
+        /// Called by the cache on eviction, nothing to do
+        void OnDelFromCache(const TStr& KeyStr, void* RefToBs) { }
+    };
+
+    /// Cached results
+    TCache<TStr, PItem> Cache;
+    /// Number of queries served from the cache
+    TUInt64 Hits;
+    /// Number of queries not in the cache
+    TUInt64 Misses;
+    /// Number of results found out of date
+    TUInt64 Stales;
+
+    TQueryCache(const uint64& MxMemUsed): Cache((int64)MxMemUsed, 1024, NULL) { }
+
+public:
+    /// Create cache using at most MxMemUsed bytes
+    static TPt<TQueryCache> New(const uint64& MxMemUsed) { return new TQueryCache(MxMemUsed); }
+
+    /// Get results when cached and up to date
+    bool Get(const TWPt<TBase>& Base, const TStr& KeyStr, PRecSet& RecSet);
+    /// Add results, computed from current records of given stores
+    void Put(const TWPt<TBase>& Base, const TStr& KeyStr, const TUIntSet& StoreIdSet, const PRecSet& RecSet);
+
+    /// Memory budget
+    uint64 GetMxMemUsed() const { return (uint64)Cache.GetMxMemUsed(); }
+    /// Statistics in JSON form (size, hits, misses)
+    PJsonVal GetStats() const;
+};
+typedef TPt<TQueryCache> PQueryCache;
+
 ///////////////////////////////
 // GeoIndex
 class TGeoIndex; typedef TPt<TGeoIndex> PGeoIndex;
@@ -2916,6 +3277,28 @@ public:
     bool LocEquals(const TFltPr& Loc1, const TFltPr& Loc2) const;
 };
 
+///////////////////////////////
+/// B-Tree Index Parameters.
+/// Nodes hold between capacity and 2 * capacity - 1 entries. Fill factor is the
+/// share of the maximum that bulk built nodes are filled to.
+class TBTreeIndexParam {
+public:
+    /// Minimal number of children of an internal node
+    TInt InternalCapacity;
+    /// Minimal number of values in a leaf
+    TInt LeafCapacity;
+    /// Fill factor of nodes built from sorted values
+    TFlt FillFactor;
+
+    TBTreeIndexParam(): InternalCapacity(8), LeafCapacity(64), FillFactor(1.0) { }
+    TBTreeIndexParam(const int& _InternalCapacity, const int& _LeafCapacity, const double& _FillFactor);
+    /// Parse parameters from JSon, missing ones keep the default value
+    TBTreeIndexParam(const PJsonVal& ParamVal);
+
+    /// Are parameters different from default
+    bool IsCustom() const;
+};
+
 ///////////////////////////////
 // B-Tree Index
 template <class TVal>
@@ -2941,15 +3324,23 @@ private:
     TPt<TLeafStore> LeafStore;
     /// BTree instance
     TBtreeOps BTree;
+    /// Fill factor for bulk builds, not saved with the index
+    TFlt FillFactor;
+
+    /// Minimal ratio between new and existing values for merging them in a rebuild
+    static const int MnRebuildRatio = 8;
 
 public:
     /// Create new empty index
-    TBTreeIndex(): InternalStore(new TInternalStore), LeafStore(new TLeafStore),
-        BTree(InternalStore, LeafStore, 8, 64, false, false) { }
+    TBTreeIndex(const TBTreeIndexParam& Param = TBTreeIndexParam()):
+        InternalStore(new TInternalStore), LeafStore(new TLeafStore),
+        BTree(InternalStore, LeafStore, Param.InternalCapacity, Param.LeafCapacity, false, false),
+        FillFactor(Param.FillFactor) { }
     /// Create new empty index
-    static TPt<TBTreeIndex> New() { return new TBTreeIndex; }
+    static TPt<TBTreeIndex> New(const TBTreeIndexParam& Param = TBTreeIndexParam()) { return new TBTreeIndex(Param); }
     /// Load existing index from stream
-    TBTreeIndex(TSIn& SIn): InternalStore(SIn), LeafStore(SIn), BTree(SIn, InternalStore, LeafStore) {  }
+    TBTreeIndex(TSIn& SIn): InternalStore(SIn), LeafStore(SIn), BTree(SIn, InternalStore, LeafStore),
+        FillFactor(TBTreeIndexParam().FillFactor) {  }
     /// Load existing index from stream
     static TPt<TBTreeIndex> Load(TSIn& SIn) { return new TBTreeIndex(SIn); }
     /// Save index to stream
@@ -2957,10 +3348,17 @@ public:
 
     /// Add new record
     void AddKey(const TVal& Val, const uint64& RecId);
+    /// Add records given as (value, record id) pairs sorted in increasing order. Empty
+    /// index is built bottom-up, and so is a small one, after merging in its values.
+    void AddKeyV(const TVec<TPair<TVal, TUInt64> >& ValRecIdV);
+    /// Number of indexed records
+    int GetKeys() const { return BTree.GetKeys(); }
     /// Delete record
     void DelKey(const TVal& Val, const uint64& RecId);
     /// Range query
     void SearchRange(const TPair<TVal, TVal>& RangeMinMax, TUInt64V& RecIdV) const;
+    /// Number of records in the range, counted without retrieving them
+    uint64 GetRangeRecs(const TPair<TVal, TVal>& RangeMinMax) const;
 };
 
 ///////////////////////////////
@@ -3145,6 +3543,26 @@ private:
     /// BTree index for floats (one for each key)
     THash<TInt, PBTreeIndexSFlt> BTreeIndexSFltH;
 
+    /// Number of open batches, updates of inverted and b-tree indexes are deferred while positive
+    TInt BatchN;
+    /// Inverted index postings (KeyId, WordId, RecId, RecFq) deferred by the batch
+    TVec<TQuad<TInt, TUInt64, TUInt64, TInt> > BatchGixV;
+    /// B-tree index values deferred by the batch, as (value, record id) pairs for each key
+    THash<TInt, TVec<TPair<TUCh, TUInt64> > > BatchByteH;
+    THash<TInt, TVec<TPair<TInt, TUInt64> > > BatchIntH;
+    THash<TInt, TVec<TPair<TInt16, TUInt64> > > BatchInt16H;
+    THash<TInt, TVec<TPair<TInt64, TUInt64> > > BatchInt64H;
+    THash<TInt, TVec<TPair<TUInt, TUInt64> > > BatchUIntH;
+    THash<TInt, TVec<TPair<TUInt16, TUInt64> > > BatchUInt16H;
+    THash<TInt, TVec<TPair<TUInt64, TUInt64> > > BatchUInt64H;
+    THash<TInt, TVec<TPair<TFlt, TUInt64> > > BatchFltH;
+    THash<TInt, TVec<TPair<TSFlt, TUInt64> > > BatchSFltH;
+    /// Number of deferred postings after which they are merged into the index as one run
+    static const int MxBatchGixLen;
+
+    /// Lock shared with the background flusher, held while accessing inverted indexes
+    PFlushLock FlushLock;
+
     /// Index Vocabulary
     PIndexVoc IndexVoc;
     /// Inverted Index Default Merger Full
@@ -3158,15 +3576,30 @@ private:
 
     /// Determines which Gix should be used for given KeyId
     TIndexKeyGixType GetGixType(const int& KeyId) const { return IndexVoc->GetKey(KeyId).GetGixType(); }
-    /// Executes GIX query expression against the full index
-    bool DoQueryFull(const TPt<TQmGixExpItemFull>& ExpItem, TVec<TQmGixItemFull>& RecIdFqV) const;
+    /// Executes GIX query expression against the full index. When FilterRecIdFqV is
+    /// given, the result only needs to be correct for records from the filter.
+    bool DoQueryFull(const TPt<TQmGixExpItemFull>& ExpItem, TVec<TQmGixItemFull>& RecIdFqV,
+        const TVec<TQmGixItemFull>* FilterRecIdFqV = NULL) const;
     /// Executes GIX query expression against the small index
-    bool DoQuerySmall(const TPt<TQmGixExpItemSmall>& ExpItem, TVec<TQmGixItemFull>& RecIdFqV) const;
+    bool DoQuerySmall(const TPt<TQmGixExpItemSmall>& ExpItem, TVec<TQmGixItemFull>& RecIdFqV,
+        const TVec<TQmGixItemFull>* FilterRecIdFqV = NULL) const;
     /// Executes GIX query expression against the tiny index
-    bool DoQueryTiny(const TPt<TQmGixExpItemTiny>& ExpItem, TVec<TQmGixItemFull>& RecIdFqV) const;
+    bool DoQueryTiny(const TPt<TQmGixExpItemTiny>& ExpItem, TVec<TQmGixItemFull>& RecIdFqV,
+        const TVec<TQmGixItemFull>* FilterRecIdFqV = NULL) const;
+
+    /// Sorts deferred b-tree index values and adds them to the b-tree index of their key
+    template <class TVal>
+    void FlushBatchLinear(THash<TInt, TVec<TPair<TVal, TUInt64> > >& BatchH,
+        THash<TInt, TPt<TBTreeIndex<TVal> > >& BTreeIndexH);
+    /// Cuts item sets of given keys to items with record id not below the bound
+    template <class TQmGixItem>
+    void DelGixItemsBefore(const TPt<TGix<TQmGixKey, TQmGixItem> >& Gix,
+        const TIntSet& KeyIdSet, const TQmGixItem& BoundItem);
 
     /// Execute Position query. Result is vector of record ids and frequency of phrase occurences.
     void DoQueryPos(const int& KeyId, const TUInt64V& WordIdV, const int& MaxDiff, TUInt64IntKdV& RecIdFqV) const;
+    /// Save location and b-tree indexes
+    void SaveTrees() const;
 
     /// Constructor
     TIndex(const TStr& _IndexFPath, const TFAccess& _Access, const PIndexVoc& IndexVoc,
@@ -3207,6 +3640,22 @@ public:
     /// Add to inverted index (RecId, RecFq) under key (KeyId, WordId).
     void IndexGix(const int& KeyId, const uint64& WordId, const uint64& RecId, const int& RecFq);
 
+    /// Create b-tree index for the key with given parameters, before any value is indexed.
+    /// Sort type determines the type of values.
+    void NewBTreeIndex(const int& KeyId, const TIndexKeySortType& SortType, const TBTreeIndexParam& Param);
+
+    /// Start deferring inverted and b-tree index updates. Batches can be nested,
+    /// deferred updates are applied when the outermost batch ends. Deletes flush
+    /// deferred updates first, queries do not see them until the batch ends.
+    void StartBatch() { BatchN++; }
+    /// End batch and apply deferred updates when this was the outermost batch
+    void EndBatch();
+    /// Are index updates currently deferred
+    bool IsBatch() const { return BatchN > 0; }
+    /// Apply deferred updates: postings are sorted by (key, word, record) and each
+    /// item set is extended once, b-tree values are sorted and added per key
+    void FlushBatch();
+
     /// Delete index for RecId under (Key, Word). WordStr is sent through index vocabulary.
     void DeleteValue(const int& KeyId, const TStr& WordStr, const uint64& RecId);
     /// Delete index for RecId under (Key, Word). WordStrV is sent through index vocabulary.
@@ -3275,15 +3724,28 @@ public:
     /// Delete RecId from linear index under (Key, Val)
     void DeleteLinear(const int& KeyId, const float& Val, const uint64& RecId);
 
+    /// Delete records of the store with id below RecId from inverted index keys of its fields
+    /// at once. Item sets drop leading child vectors without loading them, so the cost depends
+    /// on the number of words and values of the keys and not on the deleted records.
+    /// Location and b-tree keys are not ordered by record id and are deleted one by one.
+    void DeleteRecsBefore(const uint& StoreId, const uint64& RecId);
+
     /// Check if index opened in read-only mode
     bool IsReadOnly() const { return Access == faRdOnly; }
 
     /// Search inverted index using single key-word pair
     PRecSet SearchGix(const TWPt<TBase>& Base, const int& KeyId, const uint64& WordId) const;
-    /// Search inverted index for records matching all words from same key
-    PRecSet SearchGixAnd(const TWPt<TBase>& Base, const int& KeyId, const TUInt64V& WordIdV) const;
-    /// Search inverted index for records matching at least one word from the same key
-    PRecSet SearchGixOr(const TWPt<TBase>& Base, const int& KeyId, const TUInt64V& WordIdV) const;
+    /// Search inverted index for records matching all words from same key. When sorted
+    /// FilterRecIdFqV is given, only records from it are returned, without reading the
+    /// parts of the inverted index that cannot contain them.
+    PRecSet SearchGixAnd(const TWPt<TBase>& Base, const int& KeyId, const TUInt64V& WordIdV,
+        const TUInt64IntKdV* FilterRecIdFqV = NULL) const;
+    /// Search inverted index for records matching at least one word from the same key.
+    /// When sorted FilterRecIdFqV is given, only records from it are returned.
+    PRecSet SearchGixOr(const TWPt<TBase>& Base, const int& KeyId, const TUInt64V& WordIdV,
+        const TUInt64IntKdV* FilterRecIdFqV = NULL) const;
+    /// Number of records indexed under given key and word
+    uint64 GetGixRecs(const int& KeyId, const uint64& WordId) const;
 
     /// Low-level access to Gix search used for joining
     void SearchGixJoin(const int& KeyId, const uint64& RecId, TUInt64IntKdV& JoinRecIdFqV) const;
@@ -3320,6 +3782,25 @@ public:
     /// Do B-Tree linear search
     PRecSet SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TSFltPr& RangeMinMax);
 
+    /// Number of records in B-Tree range, counted without retrieving them
+    uint64 GetLinearRecs(const int& KeyId, const TUChPr& RangeMinMax) const;
+    /// Number of records in B-Tree range, counted without retrieving them
+    uint64 GetLinearRecs(const int& KeyId, const TIntPr& RangeMinMax) const;
+    /// Number of records in B-Tree range, counted without retrieving them
+    uint64 GetLinearRecs(const int& KeyId, const TInt16Pr& RangeMinMax) const;
+    /// Number of records in B-Tree range, counted without retrieving them
+    uint64 GetLinearRecs(const int& KeyId, const TInt64Pr& RangeMinMax) const;
+    /// Number of records in B-Tree range, counted without retrieving them
+    uint64 GetLinearRecs(const int& KeyId, const TUIntUIntPr& RangeMinMax) const;
+    /// Number of records in B-Tree range, counted without retrieving them
+    uint64 GetLinearRecs(const int& KeyId, const TUInt16Pr& RangeMinMax) const;
+    /// Number of records in B-Tree range, counted without retrieving them
+    uint64 GetLinearRecs(const int& KeyId, const TUInt64Pr& RangeMinMax) const;
+    /// Number of records in B-Tree range, counted without retrieving them
+    uint64 GetLinearRecs(const int& KeyId, const TFltPr& RangeMinMax) const;
+    /// Number of records in B-Tree range, counted without retrieving them
+    uint64 GetLinearRecs(const int& KeyId, const TSFltPr& RangeMinMax) const;
+
     /// Are there any existing joins from RecId using JoinKeyId
     bool HasJoin(const int& JoinKeyId, const uint64& RecId) const;
 
@@ -3334,9 +3815,17 @@ public:
     int GetSplitLen() const;
     /// reset blob stats
     void ResetStats();
+    /// Change replacement policy of itemset caches
+    void SetCachePolicy(const TCachePolicy& Policy);
 
     /// perform partial flush of index contents
     int PartialFlush(const int& WndInMsec = 500);
+    /// Save all index contents to disk, index stays open
+    void Flush();
+    /// Estimate of bytes that would be written by flushing dirty item sets
+    uint64 GetDirtyBytes() const;
+    /// Set lock shared with the background flusher
+    void SetFlushLock(const PFlushLock& _FlushLock) { FlushLock = _FlushLock; }
 };
 
 ///////////////////////////////
@@ -3431,6 +3920,8 @@ protected:
 public:
     /// Create new stream aggregate based on provided JSon parameters
     static PStreamAggr New(const TWPt<TBase>& Base, const TStr& TypeNm, const PJsonVal& ParamVal);
+    /// Check if we know how to create stream aggregates of the given type
+    static bool IsType(const TStr& TypeNm) { return NewRouter.IsFun(TypeNm); }
     /// Virtual destructor!
     virtual ~TStreamAggr() { }
 
@@ -3463,6 +3954,13 @@ public:
     virtual void OnTime(const uint64& TmMsec, const TWPt<TStreamAggr>& CallerAggr) { OnStep(CallerAggr); }
     /// Add new record to the aggregate
     virtual void OnAddRec(const TRec& Rec, const TWPt<TStreamAggr>& CallerAggr) { OnStep(CallerAggr); }
+    /// Can the aggregate process a batch of records in one call to OnAddRecBatch, reading
+    /// only the batch outputs (TStreamAggrOut::I*Batch) of its input aggregates
+    virtual bool IsBatch() const { return false; }
+    /// Add batch of new records to the aggregate, default calls OnAddRec for each record
+    virtual void OnAddRecBatch(const TRecSet& RecSet, const TWPt<TStreamAggr>& CallerAggr);
+    /// Update state of the aggregate at each of the times, default calls OnTime for each time
+    virtual void OnTimeBatch(const TUInt64V& TmMSecsV, const TWPt<TStreamAggr>& CallerAggr);
     /// Recored already added to the aggregate is being updated
     virtual void OnUpdateRec(const TRec& Rec, const TWPt<TStreamAggr>& CallerAggr) { }
     /// Recored already added to the aggregate is being deleted from the store
@@ -3553,22 +4051,98 @@ namespace TStreamAggrOut {
         virtual void GetTmV(TUInt64V& MSecsV) const = 0;
     };
 
+    /// Values that entered and left a window in the last update. Vectors belong
+    /// to the aggregate and are valid until its next update.
     template <class TVal>
     class IValIO {
     public:
         // incomming
-        virtual void GetInValV(TVec<TVal>& ValV) const = 0;
+        virtual const TVec<TVal>& GetInValV() const = 0;
         // outgoing
-        virtual void GetOutValV(TVec<TVal>& ValV) const = 0;
+        virtual const TVec<TVal>& GetOutValV() const = 0;
     };
     typedef IValIO<TFlt> IFltIO;
 
+    /// Values that entered and left a window at each step of a batch. Incoming values
+    /// of step StepN are InValV[InStepV[StepN]] ... InValV[InStepV[StepN + 1] - 1],
+    /// same for outgoing values and timestamps.
+    template <class TVal>
+    class TValIOBatch {
+    public:
+        /// Start of incoming values for each step, followed by the end of the last step
+        TIntV InStepV;
+        /// Incoming values
+        TVec<TVal> InValV;
+        /// Timestamps of incoming values
+        TUInt64V InTmMSecsV;
+        /// Start of outgoing values for each step, followed by the end of the last step
+        TIntV OutStepV;
+        /// Outgoing values
+        TVec<TVal> OutValV;
+        /// Timestamps of outgoing values
+        TUInt64V OutTmMSecsV;
+
+    private:
+        /// Values of one step, the vector does not copy them
+        template <class TStepVal>
+        static TVec<TStepVal> GetStepV(const TVec<TStepVal>& ValV, const TIntV& StepV, const int& StepN) {
+            return TVec<TStepVal>(ValV.BegI() + StepV[StepN].Val, StepV[StepN + 1] - StepV[StepN]); }
+
+    public:
+        TValIOBatch() { Clr(); }
+
+        /// Forget all steps, keeping the memory
+        void Clr() {
+            InStepV.Clr(false); InValV.Clr(false); InTmMSecsV.Clr(false); InStepV.Add(0);
+            OutStepV.Clr(false); OutValV.Clr(false); OutTmMSecsV.Clr(false); OutStepV.Add(0); }
+        /// Add incoming value to the current step
+        void AddIn(const TVal& Val, const uint64& TmMSecs) { InValV.Add(Val); InTmMSecsV.Add(TmMSecs); }
+        /// Add outgoing value to the current step
+        void AddOut(const TVal& Val, const uint64& TmMSecs) { OutValV.Add(Val); OutTmMSecsV.Add(TmMSecs); }
+        /// Finish the current step
+        void EndStep() { InStepV.Add(InValV.Len()); OutStepV.Add(OutValV.Len()); }
+
+        /// Number of steps
+        int GetSteps() const { return InStepV.Len() - 1; }
+        /// Incoming values of the step
+        TVec<TVal> GetInValV(const int& StepN) const { return GetStepV(InValV, InStepV, StepN); }
+        /// Timestamps of incoming values of the step
+        TUInt64V GetInTmMSecsV(const int& StepN) const { return GetStepV(InTmMSecsV, InStepV, StepN); }
+        /// Outgoing values of the step
+        TVec<TVal> GetOutValV(const int& StepN) const { return GetStepV(OutValV, OutStepV, StepN); }
+        /// Timestamps of outgoing values of the step
+        TUInt64V GetOutTmMSecsV(const int& StepN) const { return GetStepV(OutTmMSecsV, OutStepV, StepN); }
+    };
+
+    /// Outputs at each step of the last batch passed to OnAddRecBatch
+    class ITmBatch {
+    public:
+        virtual ~ITmBatch() {}
+        virtual const TUInt64V& GetBatchTmMSecsV() const = 0;
+    };
+
+    class IFltBatch {
+    public:
+        virtual ~IFltBatch() {}
+        virtual const TFltV& GetBatchFltV() const = 0;
+    };
+
+    template <class TVal>
+    class IValIOBatch {
+    public:
+        virtual ~IValIOBatch() {}
+        virtual const TValIOBatch<TVal>& GetValIOBatch() const = 0;
+    };
+    typedef IValIOBatch<TFlt> IFltIOBatch;
+
+    /// Timestamps that entered and left a window in the last update. Vectors belong
+    /// to the aggregate and are valid until its next update.
     class ITmIO {
     public:
         // incomming
-        virtual void GetInTmMSecsV(TUInt64V& MSecsV) const = 0;
+        virtual const TUInt64V& GetInTmMSecsV() const = 0;
         // outgoing
-        virtual void GetOutTmMSecsV(TUInt64V& MSecsV) const = 0;
+        virtual const TUInt64V& GetOutTmMSecsV() const = 0;
     };
 
     class INmInt {
@@ -3599,6 +4173,20 @@ class TStreamAggrSet : public TStreamAggr {
 protected:
     /// List of aggregates triggered in step
     TVec<TWPt<TStreamAggr> > StreamAggrV;
+    /// Number of threads processing a batch, one keeps everything on the calling thread
+    TInt Threads;
+    /// Is the batch schedule built for the current aggregates
+    TBool ScheduleP;
+    /// Can the aggregates process a batch one after another
+    TBool BatchOrderP;
+    /// Aggregates grouped by their depth in the graph of inputs. Aggregates
+    /// of the same level do not read from each other.
+    TVec<TIntV> LevelV;
+
+    /// Build batch schedule from inputs of the aggregates (see GetInAggrNmV)
+    void BuildSchedule();
+    /// Pass the batch to aggregates of one level, spread over the threads
+    void OnAddRecBatch(const TIntV& AggrNV, const TRecSet& RecSet);
 
     /// Create empty aggregate base
     TStreamAggrSet(const TWPt<TBase>& _Base, const TStr& _AggrNm);
@@ -3618,6 +4206,8 @@ public:
     int Len() const;
     /// Add new aggregate to the name
     void AddStreamAggr(const PStreamAggr& StreamAggr);
+    /// Remove aggregate with the given name from the set, if it is there
+    void DelStreamAggr(const TStr& StreamAggrNm);
     /// Get stream aggregate by name
     const TWPt<TStreamAggr>& GetStreamAggr(const int& StreamAggrN) const;
     /// Get list of all aggregates
@@ -3636,6 +4226,24 @@ public:
     void OnUpdateRec(const TRec& Rec, const TWPt<TStreamAggr>& CallerAggr);
     /// Recored already added to the aggregates is being deleted from the store
     void OnDeleteRec(const TRec& Rec, const TWPt<TStreamAggr>& CallerAggr);
+    /// Add batch of new records to the aggregates. When all aggregates support batches
+    /// and read only from aggregates before them in the set, each aggregate processes
+    /// the whole batch in turn, and with more than one thread the aggregates that do
+    /// not depend on each other run concurrently. Otherwise records are passed through
+    /// the set one by one.
+    void OnAddRecBatch(const TRecSet& RecSet, const TWPt<TStreamAggr>& CallerAggr);
+    /// Update state of the aggregates at each of the times
+    void OnTimeBatch(const TUInt64V& TmMSecsV, const TWPt<TStreamAggr>& CallerAggr);
+    /// Can the aggregates process a batch one after another
+    bool IsBatchOrder();
+    /// Aggregate indices grouped by depth in the graph of inputs, in batch order only.
+    /// Level 0 holds aggregates without inputs, each next level reads from earlier ones.
+    const TVec<TIntV>& GetLevelV();
+
+    /// Set number of threads processing batches of records
+    void SetThreads(const int& _Threads);
+    /// Number of threads processing batches of records
+    int GetThreads() const { return Threads; }
 
     /// Print latest statistics to logger
     void PrintStat() const;
@@ -3663,12 +4271,298 @@ public:
 
     /// new record added to the store, call stream aggregate OnAddRec
     void OnAdd(const TRec& Rec);
+    /// batch of new records added to the store, call stream aggregate OnAddRecBatch
+    void OnAddBatch(const TRecSet& RecSet);
     /// record is updated in the store, call stream aggregate OnUpdateRec
     void OnUpdate(const TRec& Rec);
     /// record is deleted from the store, call stream aggregate OnDeleteRec
     void OnDelete(const TRec& Rec);
 };
 
+///////////////////////////////
+/// Background flusher parameters
+class TBaseFlusherParam {
+public:
+    /// Flush while more than this many bytes are dirty
+    TUInt64 DirtyTarget;
+    /// Maximal number of bytes written per second, zero for no limit
+    TUInt64 MxBytesPerSec;
+    /// Time between checks of the amount of dirty data
+    TInt IntervalMSec;
+    /// Time spent flushing in one go. Base is locked while writing, so calls to the base,
+    /// including adding records, wait for up to this long (more when a single item is large)
+    TInt SliceMSec;
+
+    TBaseFlusherParam(): DirtyTarget(16 * (uint64)TInt::Mega), MxBytesPerSec((uint64)0),
+        IntervalMSec(1000), SliceMSec(50) { }
+    TBaseFlusherParam(const uint64& _DirtyTarget, const uint64& _MxBytesPerSec,
+        const int& _IntervalMSec, const int& _SliceMSec);
+    /// Parse parameters from JSon, missing ones keep the default value.
+    /// Dirty target is given in MB, rate limit in MB per second.
+    TBaseFlusherParam(const PJsonVal& ParamVal);
+};
+
+///////////////////////////////
+/// Background Flusher.
+/// Thread writing dirty records, pages and inverted index item sets back to disk,
+/// so ingestion does not stop for PartialFlush and closing the base has little left
+/// to write. Every interval it flushes the base in short slices while the estimated
+/// amount of dirty data is above the target, pausing between slices to keep below
+/// the rate limit. Flusher and caller take turns through the flush lock of the base,
+/// so ingestion stalls while a slice is being written.
+class TBaseFlusher : public TThread {
+private:
+    // smart-pointer
+    friend class TPt<TBaseFlusher>;
+
+    /// Base we are flushing
+    TWPt<TBase> Base;
+    /// Lock shared with the base
+    PFlushLock FlushLock;
+    /// Parameters
+    TBaseFlusherParam Param;
+    /// Set when flusher should stop
+    volatile bool StopP;
+    /// Number of slices flushed so far
+    TUInt64 Slices;
+    /// Estimate of bytes written so far
+    TUInt64 FlushedBytes;
+
+    TBaseFlusher(const TWPt<TBase>& _Base, const PFlushLock& _FlushLock, const TBaseFlusherParam& _Param);
+    /// Sleep for given time or until asked to stop
+    void Sleep(const int& MSec) const;
+    /// Flush one slice, returns estimate of written bytes or -1 when below target
+    int64 FlushSlice();
+
+public:
+    /// Create flusher, needs to be started
+    static TPt<TBaseFlusher> New(const TWPt<TBase>& Base, const PFlushLock& FlushLock,
+        const TBaseFlusherParam& Param) { return new TBaseFlusher(Base, FlushLock, Param); }
+
+    /// Thread loop
+    void Run();
+    /// Ask flusher to stop and wait for the current slice to finish
+    void Stop();
+
+    /// Parameters
+    const TBaseFlusherParam& GetParam() const { return Param; }
+    /// Statistics of the flusher
+    PJsonVal GetStats() const;
+};
+typedef TPt<TBaseFlusher> PBaseFlusher;
+
+///////////////////////////////
+/// Write-ahead log parameters
+class TWalParam {
+public:
+    /// Longest time a logged operation waits to be synced to disk, zero syncs each operation
+    TInt SyncMSec;
+    /// Checkpoint when the log grows over this many bytes
+    TUInt64 CheckpointBytes;
+
+    TWalParam(): SyncMSec(100), CheckpointBytes(64 * (uint64)TInt::Mega) { }
+    TWalParam(const int& _SyncMSec, const uint64& _CheckpointBytes);
+    /// Parse parameters from JSon, missing ones keep the default value.
+    /// Sync interval is given in milliseconds, checkpoint size in MB.
+    TWalParam(const PJsonVal& ParamVal);
+};
+
+///////////////////////////////
+/// Write-ahead log.
+/// Store operations changing records (add, update, set field, delete) are appended to
+/// the log before they are executed. Operations are written and synced to disk in
+/// groups, at most the sync interval after they were logged. Checkpoint saves the base
+/// and truncates the log. Files changed since the last checkpoint are covered by a
+/// rollback journal, so after a crash the base is rolled back to the last checkpoint
+/// and only the tail of the log is replayed. Log and journal are kept in the Wal
+/// folder of the base and removed when the base is closed.
+class TWal;
+typedef TPt<TWal> PWal;
+class TWal {
+private:
+    // smart-pointer
+    TCRef CRef;
+    friend class TPt<TWal>;
+    friend class TWalOp;
+    friend class TWalTriggers;
+
+    /// Log operation types
+    typedef enum { wloAddRec = 0, wloUpdateRec = 1, wloDeleteRecs = 2,
+        wloDeleteFirstRecs = 3, wloDeleteAllRecs = 4, wloSetField = 5 } TWalLogOp;
+    /// Log is written to disk when this many bytes are waiting, regardless of the interval
+    static const int MxBfLen;
+
+    /// Folder with log and journal
+    TStr WalFPath;
+    /// Parameters
+    TWalParam Param;
+    /// Journal of base files changed since the last checkpoint
+    PFJournal Journal;
+    /// Log file, open for appending
+    FILE* FileId;
+    /// Logged operations not written to the log file yet
+    TMOut LogBf;
+    /// Number of the last logged operation
+    TUInt64 Lsn;
+    /// Size of the log file, including buffered operations
+    TUInt64 LogBytes;
+    /// Time when the oldest buffered operation was logged
+    TUInt64 BfTmMSecs;
+    /// Depth of nested store operations
+    TInt OpDepth;
+    /// Depth of the operations which are logged, nested ones are repeated by them
+    TInt LogDepth;
+    /// Statistics
+    TUInt64 Ops, Syncs, Checkpoints;
+
+    TWal(const TStr& _WalFPath, const TWalParam& _Param, const PFJournal& _Journal);
+    /// Open the log file, truncating it when asked
+    void OpenLog(const bool& TruncP);
+    /// Append operation to the log
+    void Add(const TMOut& OpSOut);
+    /// Read next operation from the log, false at the end or at a broken entry
+    static bool LoadOp(TSIn& SIn, TMem& Op);
+    /// Save current value of the record field
+    static void SaveField(const TStore* Store, const uint64& RecId, const int& FieldId, TSOut& SOut);
+    /// Set record field to the value saved by SaveField
+    static void LoadField(const TWPt<TStore>& Store, const uint64& RecId, const int& FieldId, TSIn& SIn);
+
+public:
+    /// Start logging into the base folder, current content of the base is the first checkpoint
+    static PWal New(const TStr& FPath, const TWalParam& Param);
+    /// Roll the base folder back to the last checkpoint, must be called before the base is loaded
+    static PWal Rollback(const TStr& FPath);
+    /// Close and remove the log, expects the base was saved. Log which was
+    /// rolled back and not replayed stays on the disk.
+    ~TWal();
+
+    /// Folder of the log for the base in the given folder
+    static TStr GetWalFPath(const TStr& FPath) { return FPath + "Wal/"; }
+    /// Is there a log of the base which was not closed
+    static bool Exists(const TStr& FPath) { return TFJournal::Exists(GetWalFPath(FPath)); }
+
+    /// Number of the last logged operation
+    uint64 GetLsn() const { return Lsn; }
+    /// Is an operation in progress
+    bool IsInOp() const { return OpDepth > 0; }
+    /// Write and sync logged operations to disk
+    void Sync();
+    /// Is sync interval of the oldest buffered operation over
+    bool IsSyncDue() const;
+    /// Is log large enough for a checkpoint
+    bool IsCheckpointDue() const { return LogBytes >= Param.CheckpointBytes; }
+    /// Base was saved after the last logged operation, set new checkpoint and truncate log
+    void Checkpoint();
+    /// Base was saved after the last logged operation, remove log and journal
+    void Close();
+    /// Replay operations logged after the last checkpoint, returns the number of operations
+    int Replay(const TWPt<TBase>& Base);
+
+    /// Parameters
+    const TWalParam& GetParam() const { return Param; }
+    /// Statistics
+    PJsonVal GetStats() const;
+};
+
+///////////////////////////////
+/// Write-ahead log operation.
+/// Created at the start of each store operation which changes records, logs it
+/// when write-ahead log is on. Operations called from within another operation
+/// (joined records, update of an existing record) are repeated by the outer one
+/// and are not logged, except for the ones called by triggers (see TWalTriggers).
+class TWalOp {
+private:
+    /// Base of the store
+    TWPt<TBase> Base;
+    /// Store executing the operation
+    TUInt StoreId;
+    /// Write-ahead log, empty when off
+    PWal Wal;
+
+    TWalOp(const TWalOp&);
+    TWalOp& operator=(const TWalOp&);
+    /// Append operation to the log
+    void Add(const TMOut& OpSOut);
+    /// Start operation record
+    void Start(TMOut& OpSOut, const int& LogOp) const;
+
+public:
+    TWalOp(const TStore* Store);
+    ~TWalOp();
+
+    /// Is operation logged (log is on and the operation is not nested)
+    bool IsLog() const;
+
+    /// New record is added, the record already includes system fields
+    void AddRec(const PJsonVal& RecVal);
+    /// Record is updated with given values
+    void UpdateRec(const uint64& RecId, const PJsonVal& RecVal);
+    /// Field was set to a new value, called after the value is set
+    void SetField(const TStore* Store, const uint64& RecId, const int& FieldId);
+    /// Records are deleted
+    void DeleteRecs(const TUInt64V& DelRecIdV, const bool& AssertOK);
+    /// First records are deleted
+    void DeleteFirstRecs(const int& DelRecs);
+    /// All records are deleted
+    void DeleteAllRecs();
+};
+
+///////////////////////////////
+/// Write-ahead log trigger scope.
+/// Triggers are not called when the log is replayed, so operations they
+/// execute on the stores are logged on their own.
+class TWalTriggers {
+private:
+    /// Write-ahead log, empty when off
+    PWal Wal;
+    /// Log depth to restore
+    int LogDepth;
+
+    TWalTriggers(const TWalTriggers&);
+    TWalTriggers& operator=(const TWalTriggers&);
+
+public:
+    TWalTriggers(const TWPt<TBase>& Base);
+    ~TWalTriggers();
+};
+
+///////////////////////////////
+/// Read Snapshot.
+/// Records visible to a reader running next to the writer: for each store, the records
+/// present when the snapshot was taken. Records are appended with increasing IDs, so
+/// the ones added later are cut from the results by ID, and deletions wait until the
+/// snapshot is released (see TSnapshotGate). Values changed in place (UpdateRec,
+/// SetField*) are visible as soon as they are written. Snapshot belongs to the thread
+/// which took it, and a thread should hold at most one snapshot at a time.
+class TReadSnapshot {
+private:
+    // smart-pointer
+    TCRef CRef;
+    friend class TPt<TReadSnapshot>;
+
+    /// Gate of the base we registered with
+    TWPt<TSnapshotGate> SnapshotGate;
+    /// First record ID after the visible records, indexed by store ID
+    TUInt64V EndRecIdV;
+
+    TReadSnapshot(const TWPt<TBase>& Base);
+    TReadSnapshot(const TReadSnapshot&);
+    TReadSnapshot& operator=(const TReadSnapshot&);
+public:
+    /// Take snapshot of the current base content, base must allow concurrent reads
+    static TPt<TReadSnapshot> New(const TWPt<TBase>& Base) { return new TReadSnapshot(Base); }
+    /// Release the snapshot
+    ~TReadSnapshot();
+
+    /// First record ID after the records of the store visible in the snapshot
+    uint64 GetEndRecId(const uint& StoreId) const { return EndRecIdV[(int)StoreId]; }
+    /// Is record visible in the snapshot (and not deleted before it was taken)
+    bool IsRecId(const TWPt<TStore>& Store, const uint64& RecId) const;
+    /// Remove records added after the snapshot from the record set
+    void Filter(const PRecSet& RecSet) const;
+};
+typedef TPt<TReadSnapshot> PReadSnapshot;
+
 ///////////////////////////////
 // QMiner-Base
 class TBase {
@@ -3677,6 +4571,8 @@ private:
     TCRef CRef;
     /// We are friends with smart pointer so it can access referenc coutner
     friend class TPt<TBase>;
+    /// Cursor executes queries in steps
+    friend class TQueryCursor;
 
     /// True after the base is initialized
     TBool InitP;
@@ -3685,6 +4581,11 @@ private:
     TStr FPath;
     /// Access type to currently opened base
     TFAccess FAccess;
+    /// Write-ahead log (empty when off). Destroyed after the index and the stores,
+    /// so the files they write when closing are covered by its journal.
+    PWal Wal;
+    /// Set while replaying write-ahead log
+    TBool WalReplayP;
 
     /// Index vocabilary
     PIndexVoc IndexVoc;
@@ -3704,12 +4605,40 @@ private:
 
     /// Name validates used for validating field, join and key names
     TNmValidator NmValidator;
+    /// Cache of query results (empty when disabled)
+    PQueryCache QueryCache;
+    /// Replacement policy of index and store caches
+    TCachePolicy CachePolicy;
+    /// Number of threads processing batches in stream aggregate sets
+    TInt StreamAggrThreads;
+    /// Lock shared by stores and index with the background flusher and concurrent readers
+    PFlushLock FlushLock;
+    /// Background flusher (empty when not running)
+    PBaseFlusher Flusher;
+    /// Are searches and record reads from other threads allowed while writing
+    TBool ConcurrentReadsP;
+    /// Keeps deletions of records away from open read snapshots
+    PSnapshotGate SnapshotGate;
 
 private:
+    /// Range queries estimated to return more than this many times the records they are
+    /// intersected with are executed by checking the field values of these records instead
+    static const int QueryFilterRatio = 4;
+
     /// Invert given record set (replace with all the records from the store that are not in it)
     PRecSet Invert(const PRecSet& RecSet);
+    /// Order in which to execute items of AND query: items with fewest estimated records
+    /// first and negated items last. Items returning whole store are skipped when possible.
+    void GetAndPlan(const TQueryItem& QueryItem, TIntV& ItemNV);
+    /// Execute range query by checking field values of given records
+    PRecSet FilterRange(const TQueryItem& QueryItem, const TUInt64IntKdV& RecIdFqV);
+    /// Execute query, without looking at the query cache. Results are limited to the
+    /// given snapshot, unless it is empty.
+    PRecSet ExecQuery(const PQuery& Query, const PReadSnapshot& Snapshot);
     /// Execute search query. Returns results and a flag indicating if the results should be inverted.
-    TPair<TBool, PRecSet> _Search(const TQueryItem& QueryItem);
+    /// When sorted FilterRecIdFqV is given, the results only need to be correct for records from it,
+    /// since they will be intersected with it. This allows skipping or replacing index lookups.
+    TPair<TBool, PRecSet> _Search(const TQueryItem& QueryItem, const TUInt64IntKdV* FilterRecIdFqV = NULL);
 
     /// Get config name for base located on a given path
     static TStr GetConfFNm(const TStr& FPath) { return FPath + "Base.json"; }
@@ -3780,6 +4709,8 @@ public:
     bool IsStreamAggr(const TStr& StreamAggrNm) const;
     /// Register new stream aggregate to the base
     void AddStreamAggr(const PStreamAggr& StreamAggr);
+    /// Unregister stream aggregate, it must first be removed from aggregate sets
+    void DelStreamAggr(const TStr& StreamAggrNm);
     /// Get stream aggregate with the given name from base
     TWPt<TStreamAggr> GetStreamAggr(const TStr& StreamAggrNm) const;
     /// Get list of all stream aggregates
@@ -3813,11 +4744,75 @@ public:
     PRecSet Search(const TStr& QueryStr);
     /// Searching records (default search interface)
     PRecSet Search(const PJsonVal& QueryVal);
+    /// Search records visible in the snapshot, can be called from any thread while
+    /// the writer adds records. Query result cache is not used.
+    PRecSet Search(const PQuery& Query, const PReadSnapshot& Snapshot);
+    /// Search records visible in the snapshot, can be called from any thread while
+    /// the writer adds records. Query result cache is not used.
+    PRecSet Search(const PJsonVal& QueryVal, const PReadSnapshot& Snapshot);
+    /// Enable query result cache using at most given number of bytes, zero disables it.
+    /// Queries with aggregates are not cached.
+    void SetQueryCacheSize(const uint64& MxMemUsed);
+    /// Memory budget of query result cache, zero when disabled
+    uint64 GetQueryCacheSize() const { return QueryCache.Empty() ? 0 : QueryCache->GetMxMemUsed(); }
+    /// Set replacement policy of index and store caches, also used for stores added later
+    void SetCachePolicy(const TCachePolicy& _CachePolicy);
+    /// Replacement policy of index and store caches
+    TCachePolicy GetCachePolicy() const { return CachePolicy; }
+    /// Set number of threads used by stream aggregate sets of the stores to process
+    /// batches of records, also used for stores added later
+    void SetStreamAggrThreads(const int& Threads);
+    /// Number of threads used by stream aggregate sets to process batches of records
+    int GetStreamAggrThreads() const { return StreamAggrThreads; }
+    /// Estimate number of records retrieved by the query item, without executing it.
+    /// For negated items (not, not equal) this is the number of excluded records.
+    uint64 EstimateRecs(const TQueryItem& QueryItem);
 
     /// Execute garbage collection on all stores
     void GarbageCollect();
     /// Perform partial flush of data
     int PartialFlush(int WndInMsec = 500);
+    /// Estimate of bytes that would be written by flushing all stores and index
+    uint64 GetDirtyBytes();
+    /// Start background thread flushing dirty data, replaces the one already running
+    void StartFlusher(const TBaseFlusherParam& Param = TBaseFlusherParam());
+    /// Stop background flusher, if running
+    void StopFlusher();
+    /// Is background flusher running
+    bool IsFlusher() const { return !Flusher.Empty(); }
+    /// Lock to hold while accessing caches flushed by the background flusher
+    const PFlushLock& GetFlushLock() const { return FlushLock; }
+    /// Allow searches and record reads from other threads (through read snapshots)
+    /// while one thread changes the base. Store and index structures are then locked
+    /// for each access, and each write holds the lock until it is done.
+    void SetConcurrentReads(const bool& _ConcurrentReadsP);
+    /// Are concurrent reads allowed
+    bool IsConcurrentReads() const { return ConcurrentReadsP; }
+    /// Take snapshot of the records for reading from another thread
+    PReadSnapshot GetSnapshot();
+    /// Gate held by record deletions, see TSnapshotGate
+    const PSnapshotGate& GetSnapshotGate() const { return SnapshotGate; }
+    /// Save all data to disk, base stays open
+    void Flush();
+
+    /// Start write-ahead log, replaces the one already running. Bases created from
+    /// a schema must save the list of stores first (TStorage::SaveBase).
+    void StartWal(const TWalParam& Param = TWalParam());
+    /// Save the base and stop write-ahead log, if running
+    void StopWal();
+    /// Is write-ahead log on
+    bool IsWal() const { return !Wal.Empty(); }
+    /// Write-ahead log (empty when off)
+    const PWal& GetWal() const { return Wal; }
+    /// Is write-ahead log being replayed
+    bool IsWalReplay() const { return WalReplayP; }
+    /// Save the base and truncate write-ahead log
+    void Checkpoint();
+    /// Sync write-ahead log when its sync interval is over
+    void SyncWal();
+    /// Replay write-ahead log after rollback, save the base and remove the log.
+    /// Called after the stores are loaded.
+    void Recover(const PWal& RecoverWal);
 
     /// asserts if a field name is valid
     void AssertValidNm(const TStr& FldNm) const { NmValidator.AssertValidNm(FldNm); }
@@ -3848,6 +4843,55 @@ public:
     PJsonVal GetStreamAggrStats() const;
 };
 
+///////////////////////////////
+// Parallel-Read-Guard
+/// Turns on concurrent reads of the base, unless already on, so records
+/// can be read from several threads for the lifetime of the guard.
+class TParallelReadGuard {
+private:
+    TWPt<TBase> Base;
+    bool SetP;
+
+public:
+    TParallelReadGuard(const TWPt<TBase>& _Base): Base(_Base), SetP(!_Base->IsConcurrentReads()) {
+        if (SetP) { Base->SetConcurrentReads(true); }
+    }
+    ~TParallelReadGuard() { if (SetP) { Base->SetConcurrentReads(false); } }
+};
+
+///////////////////////////////
+// Parallel-Exceptions
+/// Exceptions must not leave an OpenMP parallel region, that terminates the process.
+/// Each parallel task runs through Run, which keeps whatever the task throws, and
+/// the first kept exception is thrown by Throw once the region ends.
+class TParallelExcept {
+private:
+    TVec<PExcept> ExceptV;
+
+public:
+    TParallelExcept(const int& Tasks): ExceptV(Tasks) { }
+
+    /// Call Fun() for given task, keeping any exception it throws
+    template <class TFun>
+    void Run(const int& TaskN, const TFun& Fun) {
+        try {
+            Fun();
+        } catch (PExcept& Except) {
+            ExceptV[TaskN] = Except;
+        } catch (const std::exception& Except) {
+            ExceptV[TaskN] = TQmExcept::New(TStr("Parallel task failed: ") + Except.what());
+        } catch (...) {
+            ExceptV[TaskN] = TQmExcept::New("Parallel task failed with unknown exception");
+        }
+    }
+    /// Throw the exception of the first failed task, if any
+    void Throw() const {
+        for (int TaskN = 0; TaskN < ExceptV.Len(); TaskN++) {
+            if (!ExceptV[TaskN].Empty()) { throw ExceptV[TaskN]; }
+        }
+    }
+};
+
 ////////////////////////////////////////////////////////////////////////////
 // Some utility functions
 
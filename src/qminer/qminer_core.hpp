@@ -15,6 +15,79 @@ void TRecSet::FilterBy(const TFilter& Filter) {
     RecIdFqV = NewRecIdFqV;
 }
 
+template <class TVal, class TValV>
+void TRecSet::FilterByColumn(const TValV& ValV, const TVal& MinVal, const TVal& MaxVal) {
+    // prepare an empty key-dat vector for storing records that pass the filter
+    const int Recs = GetRecs();
+    TUInt64IntKdV NewRecIdFqV(Recs, 0);
+    for (int RecN = 0; RecN < Recs; RecN++) {
+        const TVal& Val = ValV[RecN];
+        if ((MinVal <= Val) && (Val <= MaxVal)) { NewRecIdFqV.Add(RecIdFqV[RecN]); }
+    }
+    // overwrite old result vector with filtered list
+    RecIdFqV = NewRecIdFqV;
+}
+
+template <class TVal>
+void TRecSet::SortByColumn(const bool& Asc, const TVec<TVal>& ValV) {
+    typedef TKeyDat<TVal, TUInt64IntKd> TItem;
+    TVec<TItem> TItemV(RecIdFqV.Len());
+    for (int N = 0; N < RecIdFqV.Len(); N++) {
+        TItemV.SetVal(N, TItem(ValV[N], RecIdFqV[N]));
+    }
+    TItemV.Sort(Asc);
+    for (int N = 0; N < TItemV.Len(); N++) {
+        RecIdFqV.SetVal(N, TItemV[N].Dat);
+    }
+}
+
+template <class TVal>
+void TRecSet::TopByColumn(const bool& Asc, const TVec<TVal>& ValV, const int& Recs) {
+    // keeping everything, plain sort is cheaper
+    if (Recs >= RecIdFqV.Len()) { SortByColumn(Asc, ValV); return; }
+    if (Recs <= 0) { RecIdFqV.Clr(); return; }
+    // heap keeps the best records seen so far, with the worst of them on top
+    typedef TKeyDat<TVal, TInt> TItem;
+    typedef TRecCmpByVal<TVal> TCmp;
+    TCmp Cmp(Asc); THeap<TItem, TCmp> Heap(Cmp);
+    for (int N = 0; N < RecIdFqV.Len(); N++) {
+        TItem Item(ValV[N], N);
+        if (Heap.Len() < Recs) {
+            Heap.PushHeap(Item);
+        } else if (Cmp(Item, Heap.TopHeap())) {
+            Heap.PopHeap(); Heap.PushHeap(Item);
+        }
+    }
+    // pop from the worst to the best
+    TUInt64IntKdV TopRecIdFqV(Recs, Recs);
+    for (int N = Recs - 1; N >= 0; N--) {
+        TopRecIdFqV[N] = RecIdFqV[Heap.PopHeap().Dat];
+    }
+    RecIdFqV.Swap(TopRecIdFqV);
+}
+
+template <class TCmp>
+void TRecSet::TopCmp(const TCmp& Cmp, const int& Recs) {
+    // keeping everything, plain sort is cheaper
+    if (Recs >= RecIdFqV.Len()) { SortCmp(Cmp); return; }
+    if (Recs <= 0) { RecIdFqV.Clr(); return; }
+    // heap keeps the best records seen so far, with the worst of them on top
+    THeap<TUInt64IntKd, TCmp> Heap(Cmp);
+    for (int N = 0; N < RecIdFqV.Len(); N++) {
+        if (Heap.Len() < Recs) {
+            Heap.PushHeap(RecIdFqV[N]);
+        } else if (Cmp(RecIdFqV[N], Heap.TopHeap())) {
+            Heap.PopHeap(); Heap.PushHeap(RecIdFqV[N]);
+        }
+    }
+    // pop from the worst to the best
+    TUInt64IntKdV TopRecIdFqV(Recs, Recs);
+    for (int N = Recs - 1; N >= 0; N--) {
+        TopRecIdFqV[N] = Heap.PopHeap();
+    }
+    RecIdFqV.Swap(TopRecIdFqV);
+}
+
 template <class TSplitter>
 TVec<PRecSet> TRecSet::SplitBy(const TSplitter& Splitter) const {
     TRecSetV ResV;
@@ -46,6 +119,38 @@ void TBTreeIndex<TVal>::AddKey(const TVal& Val, const uint64& RecId) {
     BTree.Add(TTreeVal(Val, RecId));
 }
 
+template <class TVal>
+void TBTreeIndex<TVal>::AddKeyV(const TVec<TPair<TVal, TUInt64> >& ValRecIdV) {
+    if (ValRecIdV.Empty()) { return; }
+    if (BTree.Empty()) {
+        BTree.Build(ValRecIdV, FillFactor);
+        return;
+    }
+    // few new values are cheaper to add one by one
+    const int Keys = BTree.GetKeys();
+    if (ValRecIdV.Len() < Keys / MnRebuildRatio) {
+        for (int ValN = 0; ValN < ValRecIdV.Len(); ValN++) {
+            BTree.Add(ValRecIdV[ValN]);
+        }
+        return;
+    }
+    // merge with existing values and rebuild
+    TVec<TTreeVal> OldValRecIdV; BTree.GetKeyV(OldValRecIdV);
+    TVec<TTreeVal> NewValRecIdV(Keys + ValRecIdV.Len(), 0);
+    int OldValN = 0, ValN = 0;
+    while (OldValN < OldValRecIdV.Len() && ValN < ValRecIdV.Len()) {
+        if (ValRecIdV[ValN] < OldValRecIdV[OldValN]) {
+            NewValRecIdV.Add(ValRecIdV[ValN++]);
+        } else {
+            NewValRecIdV.Add(OldValRecIdV[OldValN++]);
+        }
+    }
+    while (OldValN < OldValRecIdV.Len()) { NewValRecIdV.Add(OldValRecIdV[OldValN++]); }
+    while (ValN < ValRecIdV.Len()) { NewValRecIdV.Add(ValRecIdV[ValN++]); }
+    OldValRecIdV.Clr();
+    BTree.Build(NewValRecIdV, FillFactor);
+}
+
 template <class TVal>
 void TBTreeIndex<TVal>::DelKey(const TVal& Val, const uint64& RecId) {
     BTree.Del(TTreeVal(Val, RecId));
@@ -64,6 +169,46 @@ void TBTreeIndex<TVal>::SearchRange(const TPair<TVal, TVal>& RangeMinMax, TUInt6
     }
 }
 
+template <class TVal>
+uint64 TBTreeIndex<TVal>::GetRangeRecs(const TPair<TVal, TVal>& RangeMinMax) const {
+    return (uint64)BTree.RangeCount_(TTreeVal(RangeMinMax.Val1, 0),
+        TTreeVal(RangeMinMax.Val2, TUInt64::Mx), true, true);
+}
+
+///////////////////////////////
+// Index
+template <class TVal>
+void TIndex::FlushBatchLinear(THash<TInt, TVec<TPair<TVal, TUInt64> > >& BatchH,
+        THash<TInt, TPt<TBTreeIndex<TVal> > >& BTreeIndexH) {
+
+    for (auto& KeyValRecIdV : BatchH) {
+        const int KeyId = KeyValRecIdV.Key;
+        TVec<TPair<TVal, TUInt64> >& ValRecIdV = KeyValRecIdV.Dat;
+        // if new key, create index first
+        if (!BTreeIndexH.IsKey(KeyId)) { BTreeIndexH.AddDat(KeyId, TBTreeIndex<TVal>::New()); }
+        // add in sorted order
+        ValRecIdV.Sort();
+        BTreeIndexH.GetDat(KeyId)->AddKeyV(ValRecIdV);
+    }
+    BatchH.Clr();
+}
+
+template <class TQmGixItem>
+void TIndex::DelGixItemsBefore(const TPt<TGix<TQmGixKey, TQmGixItem> >& Gix,
+        const TIntSet& KeyIdSet, const TQmGixItem& BoundItem) {
+
+    // collect item sets first, emptied ones are removed from the key map
+    TVec<TQmGixKey> GixKeyV;
+    int GixKeyId = Gix->FFirstKeyId();
+    while (Gix->FNextKeyId(GixKeyId)) {
+        const TQmGixKey& GixKey = Gix->GetKey(GixKeyId);
+        if (KeyIdSet.IsKey(GixKey.Val1)) { GixKeyV.Add(GixKey); }
+    }
+    for (int GixKeyN = 0; GixKeyN < GixKeyV.Len(); GixKeyN++) {
+        Gix->DelItemsBefore(GixKeyV[GixKeyN], BoundItem);
+    }
+}
+
 ///////////////////////////////
 /// QMiner-Index-Default-Merger
 template <class TQmGixItem>
@@ -85,19 +230,31 @@ void TIndex::TQmGixSumMerger<TQmGixItem>::Union(TVec<TQmGixItem>& MainV, const T
     MainV = ResV;
 }
 
+/// Full items have same layout as record sets, so they use sorted set kernels
+template <>
+inline void TIndex::TQmGixSumMerger<TUInt64IntKd>::Union(TVec<TUInt64IntKd>& MainV, const TVec<TUInt64IntKd>& JoinV) const {
+    TUInt64IntKdV ResV; TSortedSet::Union(MainV, JoinV, ResV, true); MainV.Swap(ResV);
+}
+
 template <class TQmGixItem>
 void TIndex::TQmGixSumMerger<TQmGixItem>::Intrs(TVec<TQmGixItem>& MainV, const TVec<TQmGixItem>& JoinV) const {
-    TVec<TQmGixItem> ResV; int ValN1 = 0; int ValN2 = 0;
+    TVec<TQmGixItem> ResV(0, MIN(MainV.Len(), JoinV.Len())); int ValN1 = 0; int ValN2 = 0;
     while ((ValN1 < MainV.Len()) && (ValN2 < JoinV.Len())) {
         const TQmGixItem& Val1 = MainV.GetVal(ValN1);
         const TQmGixItem& Val2 = JoinV.GetVal(ValN2);
-        if (Val1 < Val2) { ValN1++; }
-        else if (Val1 > Val2) { ValN2++; }
+        // gallop over the longer list when the other one is far ahead
+        if (Val1 < Val2) { ValN1 = TSortedSet::Gallop(MainV, ValN1 + 1, Val2); }
+        else if (Val1 > Val2) { ValN2 = TSortedSet::Gallop(JoinV, ValN2 + 1, Val1); }
         else { ResV.Add(TQmGixItem(Val1.Key, Val1.Dat + Val2.Dat)); ValN1++; ValN2++; }
     }
     MainV = ResV;
 }
 
+template <>
+inline void TIndex::TQmGixSumMerger<TUInt64IntKd>::Intrs(TVec<TUInt64IntKd>& MainV, const TVec<TUInt64IntKd>& JoinV) const {
+    TUInt64IntKdV ResV; TSortedSet::Intrs(MainV, JoinV, ResV, true); MainV.Swap(ResV);
+}
+
 template <class TQmGixItem>
 void TIndex::TQmGixSumMerger<TQmGixItem>::Minus(const TVec<TQmGixItem>& MainV,
         const TVec<TQmGixItem>& JoinV, TVec<TQmGixItem>& ResV) const {
@@ -105,6 +262,13 @@ void TIndex::TQmGixSumMerger<TQmGixItem>::Minus(const TVec<TQmGixItem>& MainV,
     MainV.Diff(JoinV, ResV);
 }
 
+template <>
+inline void TIndex::TQmGixSumMerger<TUInt64IntKd>::Minus(const TVec<TUInt64IntKd>& MainV,
+        const TVec<TUInt64IntKd>& JoinV, TVec<TUInt64IntKd>& ResV) const {
+
+    TSortedSet::Diff(MainV, JoinV, ResV);
+}
+
 template <class TQmGixItem>
 void TIndex::TQmGixSumMerger<TQmGixItem>::Merge(TVec<TQmGixItem>& ItemV, const bool& IsLocal) const {
     if (ItemV.Empty()) { return; } // nothing to do in this case
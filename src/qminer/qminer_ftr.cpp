@@ -115,6 +115,14 @@ void TFtrExt::AddFullV(const TRec& Rec, TFltV& FullV, int& Offset) const {
     }
 }
 
+void TFtrExt::UpdatePart(const TRec& Rec, const PFtrExtUpdatePart& Part) const {
+    throw TQmExcept::New("TFtrExt::UpdatePart: not implemented for " + GetNm());
+}
+
+bool TFtrExt::MergeUpdatePart(const PFtrExtUpdatePart& Part) {
+    throw TQmExcept::New("TFtrExt::MergeUpdatePart: not implemented for " + GetNm());
+}
+
 void TFtrExt::ExtractStrV(const TRec& FtrRec, TStrV& StrV) const { 
     throw TQmExcept::New("ExtractStrV not implemented!"); 
 }
@@ -139,6 +147,35 @@ PJsonVal TFtrExt::GetFtrRange() const {
     throw TExcept::New("TFtrExt::GetFtrRange: not implemented for " + GetNm());
 }
 
+///////////////////////////////////////////////
+// Parallel-For-Records
+/// Calls Fun(PartN, RecN) for all records, split into consecutive parts
+/// which are processed in parallel. First error is thrown after all parts end.
+template <class TFun>
+void ParallelForRecs(const int& Recs, const int& Parts, const TFun& Fun) {
+    TParallelExcept ParallelExcept(Parts);
+    #pragma omp parallel for num_threads(Parts) schedule(static, 1)
+    for (int PartN = 0; PartN < Parts; PartN++) {
+        ParallelExcept.Run(PartN, [&]() {
+            const int StartRecN = (int)((int64)Recs * PartN / Parts);
+            const int EndRecN = (int)((int64)Recs * (PartN + 1) / Parts);
+            for (int RecN = StartRecN; RecN < EndRecN; RecN++) { Fun(PartN, RecN); }
+        });
+    }
+    ParallelExcept.Throw();
+}
+
+/// Calls Fun(PartN, RecN) for all records, in parallel only when there is more than one part
+template <class TFun>
+void ForRecs(const TWPt<TBase>& Base, const int& Recs, const int& Parts, const TFun& Fun) {
+    if (Parts > 1) {
+        TParallelReadGuard ReadGuard(Base);
+        ParallelForRecs(Recs, Parts, Fun);
+    } else {
+        for (int RecN = 0; RecN < Recs; RecN++) { Fun(0, RecN); }
+    }
+}
+
 ///////////////////////////////////////////////
 // QMiner-Feature-Space
 void TFtrSpace::Init() {
@@ -234,18 +271,22 @@ void TFtrSpace::Clr() {
     Init();
 }
 
+void TFtrSpace::UpdateFtrExtDim(const int& FtrExtN) {
+    // get new dimensionality
+    const int NewDim = FtrExtV[FtrExtN]->GetDim();
+    // update the dimensionality sum (existing - old + new)
+    Dim = Dim - DimV[FtrExtN] + NewDim;
+    // update the feature space dimensionality
+    DimV[FtrExtN] = NewDim;
+}
+
 bool TFtrSpace::Update(const TRec& Rec) {
     bool UpdateDimP = false;
     for (int FtrExtN = 0; FtrExtN < FtrExtV.Len(); FtrExtN++) {
         const PFtrExt& FtrExt = FtrExtV[FtrExtN];       
         const bool FtrExtUpdateDimP = FtrExt->Update(Rec);
         if (FtrExtUpdateDimP) {
-            // get new dimensionality
-            const int NewDim = FtrExt->GetDim();
-            // update the dimensionality sum (existing - old + new)
-            Dim = Dim - DimV[FtrExtN] + NewDim;
-            // update the feature space dimensionality
-            DimV[FtrExtN] = NewDim;
+            UpdateFtrExtDim(FtrExtN);
             // remember we did this
             UpdateDimP = true;
         }
@@ -253,22 +294,70 @@ bool TFtrSpace::Update(const TRec& Rec) {
     return UpdateDimP;
 }
 
-bool TFtrSpace::Update(const PRecSet& RecSet) {
+bool TFtrSpace::Update(const PRecSet& RecSet, const int& Threads) {
     TEnv::Logger->OnStatusFmt("Updating feature space with %d records", RecSet->GetRecs());
+    const int Recs = RecSet->GetRecs();
+    // start update parts for extractors which support them
+    const int Parts = TInt::GetMn(Threads, Recs);
+    TVec<TVec<PFtrExtUpdatePart> > PartVV(FtrExtV.Len());
+    TIntV PartFtrExtNV, SeqFtrExtNV;
+    for (int FtrExtN = 0; FtrExtN < FtrExtV.Len(); FtrExtN++) {
+        PFtrExtUpdatePart Part = (Parts > 1) ? FtrExtV[FtrExtN]->NewUpdatePart() : PFtrExtUpdatePart();
+        if (Part.Empty()) { SeqFtrExtNV.Add(FtrExtN); continue; }
+        PartFtrExtNV.Add(FtrExtN); PartVV[FtrExtN].Add(Part);
+        for (int PartN = 1; PartN < Parts; PartN++) {
+            PartVV[FtrExtN].Add(FtrExtV[FtrExtN]->NewUpdatePart());
+        }
+    }
+    // nothing to do in parallel, update one record at a time
+    if (PartFtrExtNV.Empty()) {
+        bool UpdateDimP = false;
+        for (int RecN = 0; RecN < Recs; RecN++) {
+            if (RecN % 10000 == 0) { TEnv::Logger->OnStatusFmt("%d\r", RecN); }
+            // update according to the record
+            const bool RecUpdateDimP = Update(RecSet->GetRec(RecN));
+            // check if we did a dimensionality update
+            UpdateDimP = UpdateDimP || RecUpdateDimP;
+        }
+        return UpdateDimP;
+    }
+    // first phase: collect parts from consecutive records in parallel
+    {
+        TParallelReadGuard ReadGuard(Base);
+        ParallelForRecs(Recs, Parts, [&](const int& PartN, const int& RecN) {
+            const TRec Rec = RecSet->GetRec(RecN);
+            for (int PartFtrExtN = 0; PartFtrExtN < PartFtrExtNV.Len(); PartFtrExtN++) {
+                const int FtrExtN = PartFtrExtNV[PartFtrExtN];
+                FtrExtV[FtrExtN]->UpdatePart(Rec, PartVV[FtrExtN][PartN]);
+            }
+        });
+    }
+    // second phase: merge parts in the order of records
     bool UpdateDimP = false;
-    for (int RecN = 0; RecN < RecSet->GetRecs(); RecN++) {
-        if (RecN % 10000 == 0) { TEnv::Logger->OnStatusFmt("%d\r", RecN); }
-        // update according to the record
-        const bool RecUpdateDimP = Update(RecSet->GetRec(RecN));
-        // check if we did a dimensionality update
-        UpdateDimP = UpdateDimP || RecUpdateDimP;
+    for (int PartFtrExtN = 0; PartFtrExtN < PartFtrExtNV.Len(); PartFtrExtN++) {
+        const int FtrExtN = PartFtrExtNV[PartFtrExtN];
+        bool FtrExtUpdateDimP = false;
+        for (int PartN = 0; PartN < Parts; PartN++) {
+            const bool PartUpdateDimP = FtrExtV[FtrExtN]->MergeUpdatePart(PartVV[FtrExtN][PartN]);
+            FtrExtUpdateDimP = FtrExtUpdateDimP || PartUpdateDimP;
+        }
+        if (FtrExtUpdateDimP) { UpdateFtrExtDim(FtrExtN); UpdateDimP = true; }
+    }
+    // remaining extractors are updated one record at a time
+    if (!SeqFtrExtNV.Empty()) {
+        for (int RecN = 0; RecN < Recs; RecN++) {
+            const TRec Rec = RecSet->GetRec(RecN);
+            for (int SeqFtrExtN = 0; SeqFtrExtN < SeqFtrExtNV.Len(); SeqFtrExtN++) {
+                const int FtrExtN = SeqFtrExtNV[SeqFtrExtN];
+                if (FtrExtV[FtrExtN]->Update(Rec)) { UpdateFtrExtDim(FtrExtN); UpdateDimP = true; }
+            }
+        }
     }
     return UpdateDimP;
 }
 
-void TFtrSpace::GetSpV(const TRec& Rec, TIntFltKdV& SpV, const int& FtrExtN) const {
+void TFtrSpace::AddSpV(const TRec& Rec, TIntFltKdV& SpV, const int& FtrExtN) const {
     int Offset = 0;
-    SpV.Clr();
     if (FtrExtN < 0) {
         for (int FtrExtN = 0; FtrExtN < FtrExtV.Len(); FtrExtN++) {
             FtrExtV[FtrExtN]->AddSpV(Rec, SpV, Offset);
@@ -279,6 +368,10 @@ void TFtrSpace::GetSpV(const TRec& Rec, TIntFltKdV& SpV, const int& FtrExtN) con
     }
 }
 
+void TFtrSpace::GetSpV(const TRec& Rec, TIntFltKdV& SpV, const int& FtrExtN) const {
+    SpV.Clr(); AddSpV(Rec, SpV, FtrExtN);
+}
+
 void TFtrSpace::GetFullV(const TRec& Rec, TFltV& FullV, const int& FtrExtN) const {
     // create empty full vector
     int Offset = 0;
@@ -294,24 +387,99 @@ void TFtrSpace::GetFullV(const TRec& Rec, TFltV& FullV, const int& FtrExtN) cons
     }
 }
 
-void TFtrSpace::GetSpVV(const PRecSet& RecSet, TVec<TIntFltKdV>& SpVV, const int& FtrExtN) const {
+void TFtrSpace::GetSpVV(const PRecSet& RecSet, TVec<TIntFltKdV>& SpVV, const int& FtrExtN, const int& Threads) const {
     TEnv::Logger->OnStatusFmt("Creating sparse feature vectors from %d records", RecSet->GetRecs());
+    const int Recs = RecSet->GetRecs();
+    const int Parts = TInt::GetMn(Threads, Recs);
+    if (Parts > 1 && IsThreadSafe(FtrExtN)) {
+        // each record has its own place in the output
+        const int FirstRecN = SpVV.Len();
+        SpVV.Reserve(FirstRecN + Recs);
+        for (int RecN = 0; RecN < Recs; RecN++) { SpVV.Add(TIntFltKdV()); }
+        TParallelReadGuard ReadGuard(Base);
+        ParallelForRecs(Recs, Parts, [&](const int& PartN, const int& RecN) {
+            GetSpV(RecSet->GetRec(RecN), SpVV[FirstRecN + RecN], FtrExtN);
+        });
+        return;
+    }
     for (int RecN = 0; RecN < RecSet->GetRecs(); RecN++) {
         if (RecN % 10000 == 0) { TEnv::Logger->OnStatusFmt("%d\r", RecN); }
         SpVV.Add(TIntFltKdV()); GetSpV(RecSet->GetRec(RecN), SpVV.Last(), FtrExtN);
     }
 }
 
-void TFtrSpace::GetFullVV(const PRecSet& RecSet, TVec<TFltV>& FullVV, const int& FtrExtN) const {
+void TFtrSpace::GetSpMat(const PRecSet& RecSet, TCscMatrix& SpMat, const int& FtrExtN, const int& Threads) const {
+    TEnv::Logger->OnStatusFmt("Creating sparse feature matrix from %d records", RecSet->GetRecs());
+    EAssert(FtrExtN < FtrExtV.Len());
+    const int Dim = (FtrExtN < 0) ? GetDim() : FtrExtV[FtrExtN]->GetDim();
+    const int Recs = RecSet->GetRecs();
+    const int Parts = IsThreadSafe(FtrExtN) ? TInt::GetMx(TInt::GetMn(Threads, Recs), 1) : 1;
+    // with a single thread columns are appended to the result as they are extracted
+    if (Parts == 1) {
+        SpMat = TCscMatrix(); TIntFltKdV SpV;
+        for (int RecN = 0; RecN < Recs; RecN++) {
+            SpV.Clr(false); AddSpV(RecSet->GetRec(RecN), SpV, FtrExtN);
+            SpMat.AddCol(SpV);
+        }
+        SpMat.RowN = Dim;
+        return;
+    }
+    // threads first count non-zero elements of their records and then extract them
+    // again straight into the result, so no second copy of the matrix is ever held
+    TVec<TIntFltKdV> PartSpVV(Parts); TIntV NnzV(Recs);
+    ForRecs(Base, Recs, Parts, [&](const int& PartN, const int& RecN) {
+        TIntFltKdV& SpV = PartSpVV[PartN]; SpV.Clr(false);
+        AddSpV(RecSet->GetRec(RecN), SpV, FtrExtN);
+        NnzV[RecN] = SpV.Len();
+    });
+    SpMat.Gen(Dim, NnzV);
+    ForRecs(Base, Recs, Parts, [&](const int& PartN, const int& RecN) {
+        TIntFltKdV& SpV = PartSpVV[PartN]; SpV.Clr(false);
+        AddSpV(RecSet->GetRec(RecN), SpV, FtrExtN);
+        EAssertR(SpV.Len() == NnzV[RecN], "Feature vector changed during extraction");
+        const int64 Start = SpMat.ColPtrV[RecN];
+        for (int ElN = 0; ElN < SpV.Len(); ElN++) {
+            SpMat.RowIdxV[Start + ElN] = SpV[ElN].Key;
+            SpMat.ValV[Start + ElN] = SpV[ElN].Dat;
+        }
+    });
+}
+
+void TFtrSpace::GetFullVV(const PRecSet& RecSet, TVec<TFltV>& FullVV, const int& FtrExtN, const int& Threads) const {
     TEnv::Logger->OnStatusFmt("Creating full feature vectors from %d records", RecSet->GetRecs());
+    const int Recs = RecSet->GetRecs();
+    const int Parts = TInt::GetMn(Threads, Recs);
+    if (Parts > 1 && IsThreadSafe(FtrExtN)) {
+        // each record has its own place in the output
+        const int FirstRecN = FullVV.Len();
+        FullVV.Reserve(FirstRecN + Recs);
+        for (int RecN = 0; RecN < Recs; RecN++) { FullVV.Add(TFltV()); }
+        TParallelReadGuard ReadGuard(Base);
+        ParallelForRecs(Recs, Parts, [&](const int& PartN, const int& RecN) {
+            GetFullV(RecSet->GetRec(RecN), FullVV[FirstRecN + RecN], FtrExtN);
+        });
+        return;
+    }
     for (int RecN = 0; RecN < RecSet->GetRecs(); RecN++) {
         if (RecN % 10000 == 0) { TEnv::Logger->OnStatusFmt("%d\r", RecN); }
         FullVV.Add(TFltV()); GetFullV(RecSet->GetRec(RecN), FullVV.Last(), FtrExtN);
     }
 }
 
-void TFtrSpace::GetFullVV(const PRecSet& RecSet, TFltVV& FullVV, const int& FtrExtN) const {
+void TFtrSpace::GetFullVV(const PRecSet& RecSet, TFltVV& FullVV, const int& FtrExtN, const int& Threads) const {
     TEnv::Logger->OnStatusFmt("Creating full feature vectors from %d records", RecSet->GetRecs());
+    const int Recs = RecSet->GetRecs();
+    const int Parts = TInt::GetMn(Threads, Recs);
+    if (Parts > 1 && IsThreadSafe(FtrExtN)) {
+        EAssert(FtrExtN < FtrExtV.Len());
+        FullVV.Gen((FtrExtN < 0) ? GetDim() : FtrExtV[FtrExtN]->GetDim(), Recs);
+        TParallelReadGuard ReadGuard(Base);
+        ParallelForRecs(Recs, Parts, [&](const int& PartN, const int& RecN) {
+            TFltV Temp; GetFullV(RecSet->GetRec(RecN), Temp, FtrExtN);
+            FullVV.SetCol(RecN, Temp);
+        });
+        return;
+    }
     if (FtrExtN < 0) {
         FullVV.Gen(GetDim(), RecSet->GetRecs());
         TFltV Temp(GetDim());
@@ -448,6 +616,14 @@ int TFtrSpace::GetMxFtrN(const int& FtrExtN) const {
     return MxFtrN;
 }
 
+bool TFtrSpace::IsThreadSafe(const int& FtrExtN) const {
+    if (FtrExtN >= 0) { EAssert(FtrExtN < FtrExtV.Len()); return FtrExtV[FtrExtN]->IsThreadSafe(); }
+    for (int FtrExtN = 0; FtrExtN < FtrExtV.Len(); FtrExtN++) {
+        if (!FtrExtV[FtrExtN]->IsThreadSafe()) { return false; }
+    }
+    return true;
+}
+
 bool TFtrSpace::IsStartStore(const uint& StoreId) const {
     for (int FtrExtN = 0; FtrExtN < FtrExtV.Len(); FtrExtN++) {
         const PFtrExt& FtrExt = FtrExtV[FtrExtN];
@@ -897,6 +1073,18 @@ void TCategorical::AddSpV(const TRec& Rec, TIntFltKdV& SpV, int& Offset) const {
     FtrGen.AddFtr(GetVal(Rec), SpV, Offset);
 }
 
+PFtrExtUpdatePart TCategorical::NewUpdatePart() const {
+    return new TFtrGenUpdatePart<TFtrGen::TCategorical>(FtrGen.GetEmptyCopy());
+}
+
+void TCategorical::UpdatePart(const TRec& Rec, const PFtrExtUpdatePart& Part) const {
+    dynamic_cast<TFtrGenUpdatePart<TFtrGen::TCategorical>*>(Part())->FtrGen.Update(GetVal(Rec));
+}
+
+bool TCategorical::MergeUpdatePart(const PFtrExtUpdatePart& Part) {
+    return FtrGen.Merge(dynamic_cast<TFtrGenUpdatePart<TFtrGen::TCategorical>*>(Part())->FtrGen);
+}
+
 void TCategorical::AddFullV(const TRec& Rec, TFltV& FtrV, int& Offset) const {
     FtrGen.AddFtr(GetVal(Rec), FtrV, Offset);
 }
@@ -1096,6 +1284,19 @@ void TMultinomial::AddSpV(const TRec& Rec, TIntFltKdV& SpV, int& Offset) const {
     FtrGen.AddFtr(StrV, FltV, SpV, Offset);
 }
 
+PFtrExtUpdatePart TMultinomial::NewUpdatePart() const {
+    return new TFtrGenUpdatePart<TFtrGen::TMultinomial>(FtrGen.GetEmptyCopy());
+}
+
+void TMultinomial::UpdatePart(const TRec& Rec, const PFtrExtUpdatePart& Part) const {
+    TStrV StrV; TFltV FltV; GetVal(Rec, StrV, FltV);
+    dynamic_cast<TFtrGenUpdatePart<TFtrGen::TMultinomial>*>(Part())->FtrGen.Update(StrV);
+}
+
+bool TMultinomial::MergeUpdatePart(const PFtrExtUpdatePart& Part) {
+    return FtrGen.Merge(dynamic_cast<TFtrGenUpdatePart<TFtrGen::TMultinomial>*>(Part())->FtrGen);
+}
+
 void TMultinomial::AddFullV(const TRec& Rec, TFltV& FullV, int& Offset) const {
     TIntFltKdV SpV; AddSpV(Rec, SpV, Offset);
     for(int SpN = 0; SpN < SpV.Len(); SpN++ ){
@@ -1138,6 +1339,48 @@ void TMultinomial::ExtractTmV(const TRec& Rec, TTmV& TmV) const {
     }
 }
 
+///////////////////////////////////////////////
+// Token-Cache
+uint64 TTokenCache::GetTextHash(const TStr& Text) {
+    // FNV-1a
+    uint64 Hash = 14695981039346656037ULL;
+    const char* Bf = Text.CStr();
+    for (int ChN = 0; Bf[ChN] != 0; ChN++) {
+        Hash ^= (uchar)Bf[ChN]; Hash *= 1099511628211ULL;
+    }
+    return Hash;
+}
+
+bool TTokenCache::Get(const uint64& RecId, const uint64& TextHash, const int& VocSize,
+        const bool& AllKnownP, TIntV& TokenIdV) {
+
+    TLock Lock(CacheLock);
+    const int KeyId = RecH.GetKeyId(RecId);
+    if (KeyId != -1) {
+        const TCacheRec& CacheRec = RecH[KeyId];
+        const bool ValidP = (CacheRec.VocSize == -1) || (!AllKnownP && CacheRec.VocSize == VocSize);
+        if (CacheRec.TextHash == TextHash && ValidP) {
+            TokenIdV = CacheRec.TokenIdV; Hits++;
+            return true;
+        }
+    }
+    Misses++;
+    return false;
+}
+
+void TTokenCache::Put(const uint64& RecId, const uint64& TextHash, const int& VocSize, const TIntV& TokenIdV) {
+    TLock Lock(CacheLock);
+    TCacheRec& CacheRec = RecH.AddDat(RecId);
+    CacheRec.TextHash = TextHash;
+    CacheRec.VocSize = VocSize;
+    CacheRec.TokenIdV = TokenIdV;
+}
+
+void TTokenCache::Clr() {
+    TLock Lock(CacheLock);
+    RecH.Clr(); Hits = 0; Misses = 0;
+}
+
 ///////////////////////////////////////////////
 // Bag-of-words Feature Extractor
 void TBagOfWords::GetVal(const TRec& Rec, TStrV& StrV) const {
@@ -1150,6 +1393,39 @@ void TBagOfWords::GetVal(const TRec& Rec, TStrV& StrV) const {
     }
 }
 
+bool TBagOfWords::IsTokenCache(const TRec& Rec) const {
+    return !TokenCache.Empty() && Mode == bowmConcat && Rec.IsByRef();
+}
+
+void TBagOfWords::GetTokenCacheVal(const TRec& Rec, TStr& RecStr, uint64& TextHash) const {
+    TStrV RecStrV; GetVal(Rec, RecStrV);
+    RecStr = TStr::GetStr(RecStrV, "\n");
+    TextHash = TTokenCache::GetTextHash(RecStr);
+}
+
+void TBagOfWords::GetTokenIdV(const TRec& Rec, TIntV& TokenIdV) const {
+    TStr RecStr; uint64 TextHash; GetTokenCacheVal(Rec, RecStr, TextHash);
+    if (TokenCache->Get(Rec.GetRecId(), TextHash, FtrGen.GetDim(), false, TokenIdV)) { return; }
+    // tokenize and remember for next time
+    const bool AllKnownP = FtrGen.GetTokenIdV(RecStr, TokenIdV);
+    TokenCache->Put(Rec.GetRecId(), TextHash, AllKnownP ? -1 : FtrGen.GetDim(), TokenIdV);
+}
+
+bool TBagOfWords::UpdateTokenCache(const TRec& Rec) {
+    TStr RecStr; uint64 TextHash; GetTokenCacheVal(Rec, RecStr, TextHash);
+    // words stored with hashes can only be taken from the text
+    TIntV TokenIdV;
+    if (!FtrGen.IsStoreHashWords() && TokenCache->Get(Rec.GetRecId(), TextHash, FtrGen.GetDim(), true, TokenIdV)) {
+        // all tokens already in the vocabulary, so dimensionality does not change
+        FtrGen.UpdateTokenIdV(TokenIdV);
+        return false;
+    }
+    // tokenize and remember for next time, all tokens are known after update
+    const bool UpdateP = FtrGen.Update(RecStr, TokenIdV);
+    TokenCache->Put(Rec.GetRecId(), TextHash, -1, TokenIdV);
+    return UpdateP;
+}
+
 void TBagOfWords::AddField(const int& FieldId) {
     FieldIdV.Add(FieldId);
     FieldDescV.Add(GetFtrStore()->GetFieldDesc(FieldId));
@@ -1295,6 +1571,9 @@ TBagOfWords::TBagOfWords(const TWPt<TBase>& Base, const PJsonVal& ParamVal): TFt
         TmWnd.SetCallback(this);
     }
 
+    // token cache
+    SetTokenCache(ParamVal->GetObjBool("tokenCache", false));
+
     Reader = TFieldReader(GetFtrStore()->GetStoreId(), FieldIdV, FieldDescV);
 }
 
@@ -1363,6 +1642,12 @@ TStr TBagOfWords::GetFtr(const int& FtrN) const {
     }
 }
 
+void TBagOfWords::Clr() {
+    FtrGen.Clr();
+    // vocabulary ids are no longer valid
+    if (!TokenCache.Empty() && !FtrGen.IsHashing()) { TokenCache->Clr(); }
+}
+
 bool TBagOfWords::Update(const TRec& Rec) {
     // check if we should forget
     if (TmWnd.IsInit()) {
@@ -1376,27 +1661,51 @@ bool TBagOfWords::Update(const TRec& Rec) {
         // update the tick
         TmWnd.Tick(TimeMSecs);
     }
+    if (IsTokenCache(Rec)) { return UpdateTokenCache(Rec); }
+    return UpdateFtrGen(Rec, FtrGen);
+}
+
+bool TBagOfWords::UpdateFtrGen(const TRec& Rec, TFtrGen::TBagOfWords& _FtrGen) const {
     // get all instances
     TStrV RecStrV; GetVal(Rec, RecStrV);
     if (Mode == bowmConcat) {
         // merge into one document
-        return FtrGen.Update(TStr::GetStr(RecStrV, "\n"));
+        return _FtrGen.Update(TStr::GetStr(RecStrV, "\n"));
     } else if (Mode == bowmCentroid) {
         bool UpdateP = false;
         // threat each as a separate document
         for (int RecStrN = 0; RecStrN < RecStrV.Len(); RecStrN++) { 
-            const bool RecUpdateP = FtrGen.Update(RecStrV[RecStrN]); 
+            const bool RecUpdateP = _FtrGen.Update(RecStrV[RecStrN]); 
             UpdateP = UpdateP || RecUpdateP;
         }
         return UpdateP;
     } else if (Mode == bowmTokenized) {
-        return FtrGen.Update(RecStrV);
+        return _FtrGen.Update(RecStrV);
     } else {
         throw TQmExcept::New("Unknown tokenizer mode for handling multiple instances");
     }
 }
 
+PFtrExtUpdatePart TBagOfWords::NewUpdatePart() const {
+    // forgetting depends on the order of the records
+    if (TmWnd.IsInit()) { return NULL; }
+    return new TFtrGenUpdatePart<TFtrGen::TBagOfWords>(FtrGen.GetEmptyCopy());
+}
+
+void TBagOfWords::UpdatePart(const TRec& Rec, const PFtrExtUpdatePart& Part) const {
+    UpdateFtrGen(Rec, dynamic_cast<TFtrGenUpdatePart<TFtrGen::TBagOfWords>*>(Part())->FtrGen);
+}
+
+bool TBagOfWords::MergeUpdatePart(const PFtrExtUpdatePart& Part) {
+    return FtrGen.Merge(dynamic_cast<TFtrGenUpdatePart<TFtrGen::TBagOfWords>*>(Part())->FtrGen);
+}
+
 void TBagOfWords::AddSpV(const TRec& Rec, TIntFltKdV& SpV, int& Offset) const {
+    if (IsTokenCache(Rec)) {
+        TIntV TokenIdV; GetTokenIdV(Rec, TokenIdV);
+        FtrGen.AddTokenIdFtr(TokenIdV, SpV, Offset);
+        return;
+    }
     // get all instances
     TStrV RecStrV; GetVal(Rec, RecStrV);
     if (Mode == bowmConcat) {
@@ -1432,6 +1741,11 @@ void TBagOfWords::AddSpV(const TRec& Rec, TIntFltKdV& SpV, int& Offset) const {
 }
 
 void TBagOfWords::AddFullV(const TRec& Rec, TFltV& FullV, int& Offset) const {
+    if (IsTokenCache(Rec)) {
+        TIntV TokenIdV; GetTokenIdV(Rec, TokenIdV);
+        FtrGen.AddTokenIdFtr(TokenIdV, FullV, Offset);
+        return;
+    }
     // get all instances
     TStrV RecStrV; GetVal(Rec, RecStrV);
     if (Mode == bowmConcat) {
@@ -1463,6 +1777,14 @@ void TBagOfWords::AddFullV(const TRec& Rec, TFltV& FullV, int& Offset) const {
     }
 }
 
+void TBagOfWords::SetTokenCache(const bool& TokenCacheP) {
+    if (TokenCacheP && TokenCache.Empty()) {
+        TokenCache = TTokenCache::New();
+    } else if (!TokenCacheP) {
+        TokenCache.Clr();
+    }
+}
+
 void TBagOfWords::ExtractStrV(const TRec& Rec, TStrV& StrV) const {
     TStrV RecStrV; GetVal(Rec, RecStrV);
     for (int RecStrN = 0; RecStrN < RecStrV.Len(); RecStrN++) { 
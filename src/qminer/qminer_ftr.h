@@ -13,6 +13,32 @@
 
 namespace TQm {
 
+///////////////////////////////
+/// Feature extractor update part.
+/// State collected by one thread during a parallel update of a feature extractor,
+/// before it is merged back into the extractor (see TFtrExt::NewUpdatePart).
+class TFtrExtUpdatePart {
+private:
+    // smart-pointer
+    TCRef CRef;
+    friend class TPt<TFtrExtUpdatePart>;
+public:
+    virtual ~TFtrExtUpdatePart() { }
+};
+typedef TPt<TFtrExtUpdatePart> PFtrExtUpdatePart;
+
+///////////////////////////////
+/// Feature generator update part.
+/// Update part for feature extractors which keep their state in a feature generator.
+template <class TGen>
+class TFtrGenUpdatePart : public TFtrExtUpdatePart {
+public:
+    /// Empty feature generator with the same settings as the extractor's
+    TGen FtrGen;
+
+    TFtrGenUpdatePart(const TGen& _FtrGen): FtrGen(_FtrGen) { }
+};
+
 ///////////////////////////////
 /// Feature extractor.
 class TFtrExt;
@@ -94,6 +120,18 @@ public:
     /// Attaches features to a given full feature vectors with a given offset
     virtual void AddFullV(const TRec& Rec, TFltV& FullV, int& Offset) const;
 
+    /// Can features be extracted from several threads at the same time
+    virtual bool IsThreadSafe() const { return true; }
+    /// Start a part of a parallel update. Returns NULL when the extractor
+    /// can only be updated sequentially, one record at a time.
+    virtual PFtrExtUpdatePart NewUpdatePart() const { return NULL; }
+    /// Update the part with the given record. Called from worker threads,
+    /// so it must not change the feature extractor.
+    virtual void UpdatePart(const TRec& Rec, const PFtrExtUpdatePart& Part) const;
+    /// Merge the part into the feature extractor. Parts are merged in the order
+    /// of their records. Returns true if the update changes the dimensionality.
+    virtual bool MergeUpdatePart(const PFtrExtUpdatePart& Part);
+
     // deprecated, to be removed
     virtual double __GetVal(const double& InVal) const { printf("__GetVal is DEPRECATED\n"); throw TQmExcept::New("TFtrExt::GetVal not implemented"); };
 
@@ -145,6 +183,10 @@ private:
     TFtrExtV FtrExtV;
     
     void Init();
+    /// Refresh dimensionality after FtrExtN-th feature extractor changed it
+    void UpdateFtrExtDim(const int& FtrExtN);
+    /// Append sparse feature vector of a record, without clearing SpV first
+    void AddSpV(const TRec& Rec, TIntFltKdV& SpV, const int& FtrExtN) const;
 
     TFtrSpace(const TWPt<TBase>& _Base, const PFtrExt& FtrExt);
     TFtrSpace(const TWPt<TBase>& _Base, const TFtrExtV& _FtrExtV);
@@ -171,18 +213,24 @@ public:
     void Clr();
     /// Update feature extractors given a record
     bool Update(const TRec& Rec);
-    /// Update feature extractors given a set of records
-    bool Update(const PRecSet& RecSet);
+    /// Update feature extractors given a set of records. With more than one thread,
+    /// extractors supporting update parts are updated in two phases: each thread
+    /// collects a part from a consecutive range of records, then the parts are merged.
+    bool Update(const PRecSet& RecSet, const int& Threads = 1);
     /// Extract sparse feature vector from a record
     void GetSpV(const TRec& Rec, TIntFltKdV& SpV, const int& FtrExtN = -1) const;
     /// Extract full feature vector from a record
     void GetFullV(const TRec& Rec, TFltV& FullV, const int& FtrExtN = -1) const;
-    /// Extracting sparse feature vectors from a record set
-    void GetSpVV(const PRecSet& RecSet, TVec<TIntFltKdV>& SpVV, const int& FtrExtN = -1) const;
-    /// Extracting full feature vectors from a record set
-    void GetFullVV(const PRecSet& RecSet, TVec<TFltV>& FullVV, const int& FtrExtN = -1) const;
-    /// Extracting full feature vectors (columns) from a record set
-    void GetFullVV(const PRecSet& RecSet, TFltVV& FullVV, const int& FtrExtN = -1) const;
+    /// Extracting sparse feature vectors from a record set, using the given number of threads
+    void GetSpVV(const PRecSet& RecSet, TVec<TIntFltKdV>& SpVV, const int& FtrExtN = -1, const int& Threads = 1) const;
+    /// Extracting sparse feature vectors (columns) from a record set directly into a
+    /// compressed-sparse-column matrix, using the given number of threads. With more than
+    /// one thread records are extracted twice, first to size the matrix and then to fill it.
+    void GetSpMat(const PRecSet& RecSet, TCscMatrix& SpMat, const int& FtrExtN = -1, const int& Threads = 1) const;
+    /// Extracting full feature vectors from a record set, using the given number of threads
+    void GetFullVV(const PRecSet& RecSet, TVec<TFltV>& FullVV, const int& FtrExtN = -1, const int& Threads = 1) const;
+    /// Extracting full feature vectors (columns) from a record set, using the given number of threads
+    void GetFullVV(const PRecSet& RecSet, TFltVV& FullVV, const int& FtrExtN = -1, const int& Threads = 1) const;
     /// Compute sparse centroid of a given record set
     void GetCentroidSpV(const PRecSet& RecSet, TIntFltKdV& CentroidSpV, const bool& NormalizeP = true) const;
     /// Compute full centroid of a given record set
@@ -217,6 +265,8 @@ public:
     int GetMxFtrN(const int& FtrExtN) const;
     /// Check if the given store is one of the allowed start stores
     bool IsStartStore(const uint& StoreId) const;
+    /// Can the feature extractors used for FtrExtN (all when -1) run from several threads
+    bool IsThreadSafe(const int& FtrExtN = -1) const;
 
     /// Prepares an empty bow and registers all the features
     PBowDocBs MakeBowDocBs(const PRecSet& FtrRecSet);
@@ -289,6 +339,8 @@ public:
     bool Update(const TRec& Rec) { return false; }
     void AddSpV(const TRec& Rec, TIntFltKdV& SpV, int& Offset) const;
     void AddFullV(const TRec& Rec, TFltV& FullV, int& Offset) const;
+    // random generator is shared
+    bool IsThreadSafe() const { return false; }
 
     // flat feature extraction
     void ExtractFltV(const TRec& FtrRec, TFltV& FltV) const;
@@ -445,6 +497,11 @@ public:
     void AddSpV(const TRec& Rec, TIntFltKdV& SpV, int& Offset) const;
     void AddFullV(const TRec& Rec, TFltV& FullV, int& Offset) const;
 
+    // parallel update
+    PFtrExtUpdatePart NewUpdatePart() const;
+    void UpdatePart(const TRec& Rec, const PFtrExtUpdatePart& Part) const;
+    bool MergeUpdatePart(const PFtrExtUpdatePart& Part);
+
     PJsonVal InvertFullV(const TFltV& FtrV, const int& Offset) const;
     PJsonVal InvertFtr(const PJsonVal& FtrVal) const;
     PJsonVal GetFtrRange() const;
@@ -518,6 +575,11 @@ public:
     void AddSpV(const TRec& Rec, TIntFltKdV& SpV, int& Offset) const;
     void AddFullV(const TRec& Rec, TFltV& FullV, int& Offset) const;
 
+    // parallel update
+    PFtrExtUpdatePart NewUpdatePart() const;
+    void UpdatePart(const TRec& Rec, const PFtrExtUpdatePart& Part) const;
+    bool MergeUpdatePart(const PFtrExtUpdatePart& Part);
+
     // flat feature extraction
     void ExtractStrV(const TRec& Rec, TStrV& StrV) const;
     void ExtractFltV(const TRec& Rec, TFltV& FltV) const;
@@ -527,6 +589,62 @@ public:
     static TStr GetType() { return "multinomial"; }   
 };
 
+///////////////////////////////////////////////
+/// Token cache of a bag-of-words feature extractor. For each record keeps feature ids
+/// of its tokens and a checksum of the text they were computed from, so the text is
+/// tokenized again only after it changes. Ids of records with tokens missing from the
+/// vocabulary are only valid until the vocabulary grows. Kept in memory, not saved.
+class TTokenCache {
+private:
+    // smart-pointer
+    TCRef CRef;
+    friend class TPt<TTokenCache>;
+
+    /// Cached tokens of one record
+    class TCacheRec {
+    public:
+        /// Checksum of the text
+        TUInt64 TextHash;
+        /// Vocabulary size when some tokens were missing from it, -1 otherwise
+        TInt VocSize;
+        /// Feature ids of the tokens
+        TIntV TokenIdV;
+    };
+
+    /// Cached records by record ID
+    THash<TUInt64, TCacheRec> RecH;
+    /// Lookups and inserts can come from several threads
+    TCriticalSection CacheLock;
+    /// Statistics
+    TUInt64 Hits, Misses;
+
+    TTokenCache() { }
+    TTokenCache(const TTokenCache&);
+    TTokenCache& operator=(const TTokenCache&);
+public:
+    static TPt<TTokenCache> New() { return new TTokenCache; }
+
+    /// Checksum of a text
+    static uint64 GetTextHash(const TStr& Text);
+
+    /// Get token ids of a record, if cached for the same text and still valid for the
+    /// given vocabulary size. With AllKnownP only records with all tokens known are used.
+    bool Get(const uint64& RecId, const uint64& TextHash, const int& VocSize,
+        const bool& AllKnownP, TIntV& TokenIdV);
+    /// Remember token ids of a record. VocSize is -1 when all tokens are known.
+    void Put(const uint64& RecId, const uint64& TextHash, const int& VocSize, const TIntV& TokenIdV);
+    /// Forget all records
+    void Clr();
+
+    /// Number of cached records
+    int GetRecs() const { return RecH.Len(); }
+    /// Number of lookups served from the cache
+    uint64 GetHits() const { return Hits; }
+    /// Number of lookups that required tokenization
+    uint64 GetMisses() const { return Misses; }
+};
+typedef TPt<TTokenCache> PTokenCache;
+
 ///////////////////////////////////////////////
 // Bag-of-words Feature Extractor.
 typedef enum { bowmConcat, bowmCentroid, bowmTokenized } TBagOfWordsMode;
@@ -552,8 +670,20 @@ private:
     TTmWnd TmWnd;
     /// Forgetting factor
     TFlt ForgetFactor;            
+    /// Token cache, when enabled
+    PTokenCache TokenCache;
 
     void GetVal(const TRec& Rec, TStrV& StrV) const;
+    /// Is token cache used for the record
+    bool IsTokenCache(const TRec& Rec) const;
+    /// Get the concatenated text of the record and its checksum
+    void GetTokenCacheVal(const TRec& Rec, TStr& RecStr, uint64& TextHash) const;
+    /// Get token ids of the record from the cache, tokenizing the text on miss
+    void GetTokenIdV(const TRec& Rec, TIntV& TokenIdV) const;
+    /// Update feature generator from the cache, tokenizing the text on miss
+    bool UpdateTokenCache(const TRec& Rec);
+    /// Update given feature generator with the values of the record
+    bool UpdateFtrGen(const TRec& Rec, TFtrGen::TBagOfWords& _FtrGen) const;
 
     /// Add field to the list of ID providers
     void AddField(const int& FieldId);
@@ -595,13 +725,24 @@ public:
     int GetDim() const { return FtrGen.GetDim(); }
     TStr GetFtr(const int& FtrN) const;
 
-    void Clr() { FtrGen.Clr(); }
+    void Clr();
 
     // sparse vector extraction
     bool Update(const TRec& Rec);
     void AddSpV(const TRec& Rec, TIntFltKdV& SpV, int& Offset) const;
     void AddFullV(const TRec& Rec, TFltV& FullV, int& Offset) const;
 
+    /// Turn token cache on or off. Cache is used in concatenate mode for records
+    /// given by reference, and is not saved with the feature extractor.
+    void SetTokenCache(const bool& TokenCacheP);
+    /// Token cache, NULL when off
+    PTokenCache GetTokenCache() const { return TokenCache; }
+
+    // parallel update, not available with time window
+    PFtrExtUpdatePart NewUpdatePart() const;
+    void UpdatePart(const TRec& Rec, const PFtrExtUpdatePart& Part) const;
+    bool MergeUpdatePart(const PFtrExtUpdatePart& Part);
+
     // flat feature extraction
     void ExtractStrV(const TRec& Rec, TStrV& StrV) const;
 
@@ -695,6 +836,7 @@ public:
     bool Update(const TRec& FtrRec);
     void AddSpV(const TRec& FtrRec, TIntFltKdV& SpV, int& Offset) const;
     //void AddFullV(const TRec& Rec, TFltV& FullV, int& Offset) const;
+    bool IsThreadSafe() const { return FtrExt1->IsThreadSafe() && FtrExt2->IsThreadSafe(); }
 
     // flat feature extraction
     void ExtractStrV(const TRec& FtrRec, TStrV& StrV) const;
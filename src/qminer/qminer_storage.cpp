@@ -84,6 +84,7 @@ TFieldDescEx TStoreSchema::ParseFieldDescEx(const PJsonVal& FieldVal) {
     // parse flags
     FieldDescEx.SmallStringP = FieldVal->GetObjBool("shortstring", false);
     FieldDescEx.CodebookP = FieldVal->GetObjBool("codebook", false);
+    FieldDescEx.ColumnarP = FieldVal->GetObjBool("columnar", false);
     // load default value (if available)
     if (FieldVal->IsObjKey("default")) {
         FieldDescEx.DefaultVal = FieldVal->GetObjKey("default");
@@ -293,6 +294,10 @@ TIndexKeyEx TStoreSchema::ParseIndexKeyEx(const PJsonVal& IndexKeyVal) {
     } else {
         IndexKeyEx.SortType = oikstUndef;
     }
+    // parse out b-tree node capacities and fill factor
+    if (IndexKeyEx.IsLinear()) {
+        IndexKeyEx.BTreeParam = TBTreeIndexParam(IndexKeyVal);
+    }
     // parse out word vocabulary
     IndexKeyEx.WordVocName = IndexKeyVal->GetObjStr("vocabulary", "");
     // parse out tokenizer
@@ -310,7 +315,7 @@ TIndexKeyEx TStoreSchema::ParseIndexKeyEx(const PJsonVal& IndexKeyVal) {
     return IndexKeyEx;
 }
 
-TStoreSchema::TStoreSchema(const TWPt<TBase>& Base, const PJsonVal& StoreVal) : StoreId(0), HasStoreIdP(false), DefaultFieldStoreLoc(slMemory) {
+TStoreSchema::TStoreSchema(const TWPt<TBase>& Base, const PJsonVal& StoreVal) : StoreId(0), HasStoreIdP(false), DefaultFieldStoreLoc(slMemory), PgBlobBackend(pbbCache) {
     QmAssertR(StoreVal->IsObj(), "Invalid JSON for store definition.");
     // get store name
     QmAssertR(StoreVal->IsObjKey("name"), "Missing store name.");
@@ -334,6 +339,13 @@ TStoreSchema::TStoreSchema(const TWPt<TBase>& Base, const PJsonVal& StoreVal) :
         }
         // parse block size
         BlockSizeMem = MAX(1, options->GetObjInt("block_size_mem", BlockSizeMem));
+        // parse page backend
+        if (options->IsObjKey("backend")) {
+            TStr BackendStr = options->GetObjStr("backend");
+            QmAssertR(BackendStr == "cache" || BackendStr == "mmap",
+                TStr::Fmt("Unsupported 'backend' flag for store %s: %s", StoreName.CStr(), BackendStr.CStr()));
+            PgBlobBackend = TPgBlob::GetBackend(BackendStr);
+        }
     }
     // get id (optional)
     if (StoreVal->IsObjKey("id")) {
@@ -356,6 +368,13 @@ TStoreSchema::TStoreSchema(const TWPt<TBase>& Base, const PJsonVal& StoreVal) :
         FieldH.AddDat(FieldDesc.GetFieldNm(), FieldDesc);
         // prase extended field description required for serialization
         TFieldDescEx FieldDescEx = ParseFieldDescEx(FieldDef);
+        // columnar layout is only supported for fixed-width in-memory fields
+        if (FieldDescEx.ColumnarP) {
+            QmAssertR(TFieldColumns::IsFieldType(FieldDesc.GetFieldType()), "Columnar layout not supported for field "
+                + FieldDesc.GetFieldNm() + " of type " + FieldDesc.GetFieldTypeStr());
+            QmAssertR(FieldDescEx.FieldStoreLoc == slMemory, "Columnar field "
+                + FieldDesc.GetFieldNm() + " must be stored in memory");
+        }
         FieldExH.AddDat(FieldDesc.GetFieldNm(), FieldDescEx);
     }
 
@@ -405,6 +424,11 @@ TStoreSchema::TStoreSchema(const TWPt<TBase>& Base, const PJsonVal& StoreVal) :
         PJsonVal WindowSize = StoreVal->GetObjKey("window");
         QmAssertR(WindowSize->IsNum(), "Bad window size parameter.");
         WndDesc.WindowSize = WindowSize->GetUInt64();
+        // optional segments, given in number of records
+        if (StoreVal->IsObjKey("windowSegment")) {
+            SegmentSize = StoreVal->GetObjUInt64("windowSegment");
+            QmAssertR(SegmentSize > 0, "Window segment must not be empty.");
+        }
     } else if (StoreVal->IsObjKey("timeWindow")) {
         // time-defined window, parse out details
         WndDesc.WindowType = swtTime;
@@ -422,6 +446,16 @@ TStoreSchema::TStoreSchema(const TWPt<TBase>& Base, const PJsonVal& StoreVal) :
         // set time duration in milliseconds
         const uint64 FactorMSecs = Maps.TimeWindowUnitMap.GetDat(UnitStr);
         WndDesc.WindowSize = WindowSize * FactorMSecs;
+        // optional segments, given in time units
+        if (TimeWindow->IsObjKey("segment")) {
+            PJsonVal Segment = TimeWindow->GetObjKey("segment");
+            QmAssertR(Segment->IsObj() && Segment->IsObjKey("duration"), "Bad timeWindow segment parameter.");
+            TStr SegmentUnitStr = Segment->GetObjStr("unit", UnitStr);
+            QmAssertR(Maps.TimeWindowUnitMap.IsKey(SegmentUnitStr),
+                "Unsupported timeWindow segment unit type: " + SegmentUnitStr);
+            SegmentSize = Segment->GetObjUInt64("duration") * Maps.TimeWindowUnitMap.GetDat(SegmentUnitStr);
+            QmAssertR(SegmentSize > 0, "Window segment must not be empty.");
+        }
         // get field giving the tact for time
         if (TimeWindow->IsObjKey("field")) {
             WndDesc.TimeFieldNm = TimeWindow->GetObjStr("field");
@@ -570,6 +604,10 @@ TInMemStorage::TInMemStorage(const TStr& _FNm, const PBlobBs& _BlobStorage, cons
 }
 
 TInMemStorage::~TInMemStorage() {
+    Flush();
+}
+
+void TInMemStorage::Flush() {
     if (Access != faRdOnly) {
         // store dirty vectors
         for (int i = 0; i < ValV.Len(); i++) {
@@ -616,6 +654,7 @@ int TInMemStorage::SaveRec(int RecN) {
             TMOut mem;
             for (int j = ii*BlockSize; j < DirtyV.Len() && j < (ii + 1)*BlockSize; j++) {
                 ValV[j].Save(mem);
+                if (DirtyV[j] == isdfNew || DirtyV[j] == isdfDirty) { DirtyBytes -= ValV[j].Len(); }
                 DirtyV[j] = isdfClean;
             }
             while (BlobPtV.Len() <= ii) {
@@ -651,9 +690,16 @@ void TInMemStorage::GetVal(const uint64& ValId, TMem& Val) const {
     Val = ValV[i];
 }
 
+const TMem& TInMemStorage::GetValRef(const uint64& ValId) const {
+    uint64 i = ValId - FirstValOffsetMem;
+    LoadRec(i);
+    return ValV[i];
+}
+
 uint64 TInMemStorage::AddVal(const TMem& Val) {
     uint64 res = ValV.Add(Val);
     DirtyV.Add(isdfNew);
+    DirtyBytes += Val.Len();
     if (ValV.Len() % BlockSize == 1) {
         BlobPtV.Add();
     }
@@ -662,8 +708,11 @@ uint64 TInMemStorage::AddVal(const TMem& Val) {
 
 void TInMemStorage::SetVal(const uint64& ValId, const TMem& Val) {
     AssertReadOnly();
-    ValV[ValId - FirstValOffsetMem] = Val;
+    TMem& OldVal = ValV[ValId - FirstValOffsetMem];
     uchar& flag = DirtyV[ValId - FirstValOffsetMem];
+    if (flag == isdfNew || flag == isdfDirty) { DirtyBytes -= OldVal.Len(); }
+    DirtyBytes += Val.Len();
+    OldVal = Val;
     if (flag == isdfNew) { } // new remains new
     else { flag = isdfDirty; } // set as dirty
 }
@@ -672,6 +721,8 @@ void TInMemStorage::DelVals(int Vals) {
     if (Vals > 0) {
         int ValsTrue = 0;
         for (ValsTrue = 0; ValsTrue < Vals && ValsTrue + (int64)FirstValOffset.Val<ValV.Len(); ValsTrue++) {
+            const uchar flag = DirtyV[ValsTrue + FirstValOffset];
+            if (flag == isdfNew || flag == isdfDirty) { DirtyBytes -= ValV[ValsTrue + FirstValOffset].Len(); }
             ValV[ValsTrue + FirstValOffset].Clr();
         }
         int blocks_to_delete = ((int)FirstValOffset + ValsTrue) / BlockSize;
@@ -721,6 +772,237 @@ void TInMemStorage::LoadAll() {
     }
 }
 
+///////////////////////////////
+// Columnar layout of fixed-width fields
+TFieldColumns::TFieldColumns(TSIn& SIn): FirstRecId(SIn), Vals(SIn), DelVals(SIn),
+    FieldIdV(SIn), FieldTypeV(SIn), FieldColumnNV(SIn), IntColV(SIn), FltColV(SIn), TmColV(SIn), ByteColV(SIn) { }
+
+void TFieldColumns::Save(TSOut& SOut) const {
+    FirstRecId.Save(SOut); Vals.Save(SOut); DelVals.Save(SOut);
+    FieldIdV.Save(SOut); FieldTypeV.Save(SOut); FieldColumnNV.Save(SOut);
+    IntColV.Save(SOut); FltColV.Save(SOut); TmColV.Save(SOut); ByteColV.Save(SOut);
+}
+
+bool TFieldColumns::IsFieldType(const TFieldType& FieldType) {
+    return (FieldType == oftInt) || (FieldType == oftFlt) || (FieldType == oftTm) ||
+        (FieldType == oftByte) || (FieldType == oftBool);
+}
+
+void TFieldColumns::AddField(const int& FieldId, const TFieldType& FieldType) {
+    QmAssertR(IsFieldType(FieldType), "Unsupported field type for columnar layout");
+    QmAssertR(Vals == 0, "Columns can only be added to empty store");
+    while (FieldColumnNV.Len() <= FieldId) { FieldColumnNV.Add(-1); }
+    int ColumnN = -1;
+    switch (FieldType) {
+        case oftInt: ColumnN = IntColV.Add(); break;
+        case oftFlt: ColumnN = FltColV.Add(); break;
+        case oftTm: ColumnN = TmColV.Add(); break;
+        default: ColumnN = ByteColV.Add(); break;
+    }
+    FieldColumnNV[FieldId] = ColumnN;
+    FieldIdV.Add(FieldId);
+    FieldTypeV.Add((int)FieldType);
+}
+
+void TFieldColumns::SetVals(const int64& ValN, const TMemBase& RecMem, const TRecSerializator& Serializator) {
+    for (int FieldN = 0; FieldN < FieldIdV.Len(); FieldN++) {
+        const int FieldId = FieldIdV[FieldN];
+        const int ColumnN = GetColumnN(FieldId);
+        const bool NullP = Serializator.IsFieldNull(RecMem, FieldId);
+        switch ((TFieldType)FieldTypeV[FieldN].Val) {
+            case oftInt:
+                IntColV[ColumnN][ValN] = NullP ? 0 : Serializator.GetFieldInt(RecMem, FieldId); break;
+            case oftFlt:
+                FltColV[ColumnN][ValN] = NullP ? 0.0 : Serializator.GetFieldFlt(RecMem, FieldId); break;
+            case oftTm:
+                TmColV[ColumnN][ValN] = NullP ? 0 : Serializator.GetFieldTmMSecs(RecMem, FieldId); break;
+            case oftByte:
+                ByteColV[ColumnN][ValN] = NullP ? 0 : Serializator.GetFieldByte(RecMem, FieldId); break;
+            case oftBool:
+                ByteColV[ColumnN][ValN] = NullP ? 0 : (uchar)Serializator.GetFieldBool(RecMem, FieldId); break;
+            default:
+                throw TQmExcept::New("Unsupported field type for columnar layout");
+        }
+    }
+}
+
+void TFieldColumns::AddRec(const uint64& RecId, const TMemBase& RecMem, const TRecSerializator& Serializator) {
+    if (Empty()) { return; }
+    // first record defines where columns start
+    if (Vals == 0) { FirstRecId = RecId; }
+    QmAssertR(RecId == FirstRecId + (uint64)Vals, "Columns out of sync with records");
+    // make space for the new values
+    for (int ColumnN = 0; ColumnN < IntColV.Len(); ColumnN++) { IntColV[ColumnN].Add(); }
+    for (int ColumnN = 0; ColumnN < FltColV.Len(); ColumnN++) { FltColV[ColumnN].Add(); }
+    for (int ColumnN = 0; ColumnN < TmColV.Len(); ColumnN++) { TmColV[ColumnN].Add(); }
+    for (int ColumnN = 0; ColumnN < ByteColV.Len(); ColumnN++) { ByteColV[ColumnN].Add(); }
+    // fill them in
+    SetVals(Vals, RecMem, Serializator);
+    Vals++;
+}
+
+void TFieldColumns::SetRec(const uint64& RecId, const TMemBase& RecMem, const TRecSerializator& Serializator) {
+    if (Empty()) { return; }
+    SetVals(GetValN(RecId), RecMem, Serializator);
+}
+
+void TFieldColumns::DelRecs(const int64& Recs) {
+    if (Empty()) { return; }
+    // just mark deleted values and compact when they take half of the columns,
+    // so deleting few records from a long column does not move the whole column
+    DelVals += MIN(Recs, Vals - DelVals);
+    if (DelVals > 0 && 2 * DelVals >= Vals) {
+        for (int ColumnN = 0; ColumnN < IntColV.Len(); ColumnN++) { IntColV[ColumnN].Del(0, DelVals - 1); }
+        for (int ColumnN = 0; ColumnN < FltColV.Len(); ColumnN++) { FltColV[ColumnN].Del(0, DelVals - 1); }
+        for (int ColumnN = 0; ColumnN < TmColV.Len(); ColumnN++) { TmColV[ColumnN].Del(0, DelVals - 1); }
+        for (int ColumnN = 0; ColumnN < ByteColV.Len(); ColumnN++) { ByteColV[ColumnN].Del(0, DelVals - 1); }
+        FirstRecId += (uint64)DelVals.Val;
+        Vals -= DelVals;
+        DelVals = 0;
+    }
+}
+
+void TFieldColumns::Clr() {
+    for (int ColumnN = 0; ColumnN < IntColV.Len(); ColumnN++) { IntColV[ColumnN].Clr(); }
+    for (int ColumnN = 0; ColumnN < FltColV.Len(); ColumnN++) { FltColV[ColumnN].Clr(); }
+    for (int ColumnN = 0; ColumnN < TmColV.Len(); ColumnN++) { TmColV[ColumnN].Clr(); }
+    for (int ColumnN = 0; ColumnN < ByteColV.Len(); ColumnN++) { ByteColV[ColumnN].Clr(); }
+    FirstRecId = 0; Vals = 0; DelVals = 0;
+}
+
+void TFieldColumns::GetIntV(const int& FieldId, const TUInt64V& RecIdV, TIntV& ValV) const {
+    const TVec<TInt, int64>& ColV = IntColV[GetColumnN(FieldId)];
+    ValV.Gen(RecIdV.Len());
+    for (int RecN = 0; RecN < RecIdV.Len(); RecN++) { ValV[RecN] = ColV[GetValN(RecIdV[RecN])]; }
+}
+
+void TFieldColumns::GetFltV(const int& FieldId, const TUInt64V& RecIdV, TFltV& ValV) const {
+    const TVec<TFlt, int64>& ColV = FltColV[GetColumnN(FieldId)];
+    ValV.Gen(RecIdV.Len());
+    for (int RecN = 0; RecN < RecIdV.Len(); RecN++) { ValV[RecN] = ColV[GetValN(RecIdV[RecN])]; }
+}
+
+void TFieldColumns::GetTmMSecsV(const int& FieldId, const TUInt64V& RecIdV, TUInt64V& ValV) const {
+    const TVec<TUInt64, int64>& ColV = TmColV[GetColumnN(FieldId)];
+    ValV.Gen(RecIdV.Len());
+    for (int RecN = 0; RecN < RecIdV.Len(); RecN++) { ValV[RecN] = ColV[GetValN(RecIdV[RecN])]; }
+}
+
+void TFieldColumns::GetByteV(const int& FieldId, const TUInt64V& RecIdV, TUChV& ValV) const {
+    const TVec<TUCh, int64>& ColV = ByteColV[GetColumnN(FieldId)];
+    ValV.Gen(RecIdV.Len());
+    for (int RecN = 0; RecN < RecIdV.Len(); RecN++) { ValV[RecN] = ColV[GetValN(RecIdV[RecN])]; }
+}
+
+int TFieldColumns::GetVals() const {
+    const int64 LiveVals = Vals - DelVals;
+    QmAssertR(LiveVals <= (int64)TInt::Mx, "Too many values in column for a single vector");
+    return (int)LiveVals;
+}
+
+void TFieldColumns::GetIntV(const int& FieldId, TIntV& ValV) const {
+    const TVec<TInt, int64>& ColV = IntColV[GetColumnN(FieldId)];
+    ValV.Gen(GetVals());
+    for (int ValN = 0; ValN < ValV.Len(); ValN++) { ValV[ValN] = ColV[DelVals + ValN]; }
+}
+
+void TFieldColumns::GetFltV(const int& FieldId, TFltV& ValV) const {
+    const TVec<TFlt, int64>& ColV = FltColV[GetColumnN(FieldId)];
+    ValV.Gen(GetVals());
+    for (int ValN = 0; ValN < ValV.Len(); ValN++) { ValV[ValN] = ColV[DelVals + ValN]; }
+}
+
+void TFieldColumns::GetTmMSecsV(const int& FieldId, TUInt64V& ValV) const {
+    const TVec<TUInt64, int64>& ColV = TmColV[GetColumnN(FieldId)];
+    ValV.Gen(GetVals());
+    for (int ValN = 0; ValN < ValV.Len(); ValN++) { ValV[ValN] = ColV[DelVals + ValN]; }
+}
+
+void TFieldColumns::GetByteV(const int& FieldId, TUChV& ValV) const {
+    const TVec<TUCh, int64>& ColV = ByteColV[GetColumnN(FieldId)];
+    ValV.Gen(GetVals());
+    for (int ValN = 0; ValN < ValV.Len(); ValN++) { ValV[ValN] = ColV[DelVals + ValN]; }
+}
+
+uint64 TFieldColumns::GetMemUsed() const {
+    return TMemUtils::GetMemUsed(FieldIdV) + TMemUtils::GetMemUsed(FieldTypeV) +
+        TMemUtils::GetMemUsed(FieldColumnNV) +
+        TMemUtils::GetMemUsed(IntColV) + TMemUtils::GetMemUsed(FltColV) +
+        TMemUtils::GetMemUsed(TmColV) + TMemUtils::GetMemUsed(ByteColV);
+}
+
+///////////////////////////////
+// Window segments
+void TStoreSegments::AddRec(const uint64& RecId, const uint64& TmMSecs, const bool& NullP) {
+    // start new segment when the last one is full or its time slot has passed,
+    // records without time go to the last segment
+    const bool NewP = SegmentV.Empty() || (TimeP ? (!NullP && TmMSecs >= SegmentV.Last().EndMSecs) :
+        (SegmentV.Last().Recs >= (int64)SegmentSize.Val));
+    if (NewP) {
+        const uint64 EndMSecs = (TimeP && !NullP) ? (TmMSecs / SegmentSize + 1) * SegmentSize : 0;
+        SegmentV.Add(TSegment(RecId, EndMSecs));
+    }
+    TSegment& Segment = SegmentV.Last();
+    QmAssertR(RecId == Segment.FirstRecId + (uint64)Segment.Recs, "Segments out of sync with records");
+    Segment.Recs++;
+    if (!TimeP) { return; }
+    if (NullP) { Segment.NullP = true; return; }
+    // records older than the slot can still come, they widen the span
+    if (TmMSecs < Segment.MinMSecs) { Segment.MinMSecs = TmMSecs; }
+    if (TmMSecs > Segment.MaxMSecs) { Segment.MaxMSecs = TmMSecs; }
+}
+
+void TStoreSegments::DelRecs(const int64& Recs) {
+    int64 DelRecs = Recs; int DelSegments = 0;
+    while (DelRecs > 0 && DelSegments < SegmentV.Len()) {
+        TSegment& Segment = SegmentV[DelSegments];
+        if (Segment.Recs <= DelRecs) {
+            DelRecs -= Segment.Recs; DelSegments++;
+        } else {
+            // time span of the rest stays within the old one
+            Segment.FirstRecId += (uint64)DelRecs; Segment.Recs -= DelRecs; DelRecs = 0;
+        }
+    }
+    if (DelSegments > 0) { SegmentV.Del(0, DelSegments - 1); }
+}
+
+uint64 TStoreSegments::GetExpiredRecs(const uint64& WindowStartMSecs) const {
+    uint64 Recs = 0;
+    for (int SegmentN = 0; SegmentN < SegmentV.Len(); SegmentN++) {
+        // records without time count as the oldest
+        if (SegmentV[SegmentN].MinMSecs != TUInt64::Mx &&
+            SegmentV[SegmentN].MaxMSecs >= WindowStartMSecs) { break; }
+        Recs += (uint64)SegmentV[SegmentN].Recs.Val;
+    }
+    return Recs;
+}
+
+uint64 TStoreSegments::GetOverflowRecs(const uint64& KeepRecs) const {
+    uint64 AllRecs = 0;
+    for (int SegmentN = 0; SegmentN < SegmentV.Len(); SegmentN++) {
+        AllRecs += (uint64)SegmentV[SegmentN].Recs.Val;
+    }
+    uint64 Recs = 0;
+    for (int SegmentN = 0; SegmentN < SegmentV.Len(); SegmentN++) {
+        const uint64 SegmentRecs = (uint64)SegmentV[SegmentN].Recs.Val;
+        if (AllRecs - Recs - SegmentRecs < KeepRecs) { break; }
+        Recs += SegmentRecs;
+    }
+    return Recs;
+}
+
+void TStoreSegments::GetRangeSegments(const uint64& MinMSecs, const uint64& MaxMSecs,
+        TVec<TUInt64Pr>& RecIdPrV, TBoolV& FullV) const {
+
+    for (int SegmentN = 0; SegmentN < SegmentV.Len(); SegmentN++) {
+        const TSegment& Segment = SegmentV[SegmentN];
+        // skip segments outside of the range, including those with no timed records
+        if (Segment.Recs == 0 || Segment.MaxMSecs < MinMSecs || Segment.MinMSecs > MaxMSecs) { continue; }
+        RecIdPrV.Add(TUInt64Pr(Segment.FirstRecId, Segment.FirstRecId + (uint64)Segment.Recs - 1));
+        FullV.Add(!Segment.NullP && MinMSecs <= Segment.MinMSecs && Segment.MaxMSecs <= MaxMSecs);
+    }
+}
+
 ///////////////////////////////
 // Field serialization parameters
 void TRecSerializator::TFieldSerialDesc::Save(TSOut& SOut) const {
@@ -2428,6 +2710,9 @@ TStr TRecIndexer::TFieldIndexKey::GetKeyType() const {
 void TRecIndexer::IndexKey(const TFieldIndexKey& Key, const TMemBase& RecMem,
         const uint64& RecId, TRecSerializator& Serializator) {
 
+    // index changes invalidate cached query results
+    Store->IncRecVer();
+
     // check the type of field and value to select indexing procedure
     if (Key.FieldType == oftStr && Key.IsValue()){
         // inverted index over non-tokenized strings
@@ -2502,6 +2787,9 @@ void TRecIndexer::IndexKey(const TFieldIndexKey& Key, const TMemBase& RecMem,
 void TRecIndexer::DeindexKey(const TFieldIndexKey& Key, const TMemBase& RecMem,
         const uint64& RecId, TRecSerializator& Serializator) {
 
+    // index changes invalidate cached query results
+    Store->IncRecVer();
+
     // check the type of field and value to select deindexing procedure
     if (Key.FieldType == oftStr && Key.IsValue()) {
         // inverted index over non-tokenized strings
@@ -2576,6 +2864,9 @@ void TRecIndexer::DeindexKey(const TFieldIndexKey& Key, const TMemBase& RecMem,
 void TRecIndexer::UpdateKey(const TFieldIndexKey& Key, const TMemBase& OldRecMem,
     const TMemBase& NewRecMem, const uint64& RecId, TRecSerializator& Serializator) {
 
+    // index changes invalidate cached query results
+    Store->IncRecVer();
+
     // check the type of field and value to select update procedure
     if (Key.FieldType == oftStr && Key.IsValue()) {
         // inverted index over non-tokenized strings
@@ -2717,8 +3008,8 @@ void TRecIndexer::ProcessKey(const TFieldIndexKey& Key, const TMemBase& OldRecMe
     }
 }
 
-TRecIndexer::TRecIndexer(const TWPt<TIndex>& _Index, const TWPt<TStore>& Store):
-        Index(_Index), IndexVoc(_Index->GetIndexVoc()) {
+TRecIndexer::TRecIndexer(const TWPt<TIndex>& _Index, const TWPt<TStore>& _Store):
+        Store(_Store), Index(_Index), IndexVoc(_Index->GetIndexVoc()) {
 
     // go over all the fields
     for (int FieldId = 0; FieldId < Store->GetFields(); FieldId++) {
@@ -2764,6 +3055,20 @@ void TRecIndexer::DeindexRec(const TMemBase& RecMem, const uint64& RecId, TRecSe
     }
 }
 
+void TRecIndexer::DeindexRecTrees(const TMemBase& RecMem, const uint64& RecId, TRecSerializator& Serializator) {
+    // go over location and b-tree keys associated with the store and its fields
+    for (int FieldIndexKeyN = 0; FieldIndexKeyN < FieldIndexKeyV.Len(); FieldIndexKeyN++) {
+        const TFieldIndexKey& Key = FieldIndexKeyV[FieldIndexKeyN];
+        if (!Key.IsLocation() && !Key.IsLinear()) { continue; }
+        // check if field is handled by the serializator
+        if (!Serializator.IsFieldId(Key.FieldId)) { continue; }
+        // check if field is not NULL (e.g. there is something to deindex)
+        if (Serializator.IsFieldNull(RecMem, Key.FieldId)) { continue; }
+        // deindex the key
+        DeindexKey(Key, RecMem, RecId, Serializator);
+    }
+}
+
 void TRecIndexer::UpdateRec(const TMemBase& OldRecMem, const TMemBase& NewRecMem,
         const uint64& RecId, const int& ChangedFieldId, TRecSerializator& Serializator) {
 
@@ -2868,6 +3173,7 @@ void TStoreImpl::InitFieldLocV() {
 }
 
 void TStoreImpl::GetRecMem(const TStoreLoc& RecLoc, const uint64& RecId, TMem& Rec) const {
+    TFlushGuard FlushGuard(GetFlushLock());
     if (RecLoc == slDisk) {
         DataCache.GetVal(RecId, Rec);
     } else if (RecLoc == slMemory)  {
@@ -2881,18 +3187,37 @@ void TStoreImpl::GetRecMem(const uint64& RecId, const int& FieldId, TMem& Rec) c
     GetRecMem(FieldLocV[FieldId], RecId, Rec);
 }
 
+void TStoreImpl::GetRecMemView(const uint64& RecId, const int& FieldId, TRecMemView& RecView) const {
+    RecView.Lock(GetFlushLock());
+    const TStoreLoc& RecLoc = FieldLocV[FieldId];
+    if (RecLoc == slDisk) {
+        RecView.Set(DataCache.GetValRef(RecId, RecView.GetBlockPin()));
+    } else if (RecLoc == slMemory)  {
+        RecView.Set(DataMem.GetValRef(RecId));
+    } else {
+        throw TQmExcept::New("Unknown storage location");
+    }
+}
+
 void TStoreImpl::PutRecMem(const TStoreLoc& RecLoc, const uint64& RecId, const TMem& Rec) {
+    TFlushGuard FlushGuard(GetFlushLock());
     if (RecLoc == slDisk) {
         DataCache.SetVal(RecId, Rec);
     } else if (RecLoc == slMemory)  {
         DataMem.SetVal(RecId, Rec);
+        // keep columns in sync with the record
+        Columns.SetRec(RecId, Rec, *SerializatorMem);
     } else {
         throw TQmExcept::New("Unknown storage location");
     }
 }
 
 void TStoreImpl::PutRecMem(const uint64& RecId, const int& FieldId, const TMem& Rec) {
+    TWalOp WalOp(this);
     PutRecMem(FieldLocV[FieldId], RecId, Rec);
+    // also non-indexed fields, cached query results can hold their values
+    IncRecVer();
+    WalOp.SetField(this, RecId, FieldId);
 }
 
 bool TStoreImpl::IsFieldDisk(const int &FieldId) const {
@@ -3027,6 +3352,10 @@ void TStoreImpl::InitFromSchema(const TStoreSchema& StoreSchema) {
             FieldId, WordVocId, IndexKeyEx.KeyType, IndexKeyEx.GixType, IndexKeyEx.SortType);
         // assign tokenizer to it if we have one
         if (IndexKeyEx.IsTokenizer()) { IndexVoc->PutTokenizer(KeyId, IndexKeyEx.Tokenizer); }
+        // create b-tree with non-default parameters right away, they are saved with it
+        if (IndexKeyEx.IsLinear() && IndexKeyEx.BTreeParam.IsCustom()) {
+            GetIndex()->NewBTreeIndex(KeyId, IndexKeyEx.SortType, IndexKeyEx.BTreeParam);
+        }
     }
     // prepare serializators for disk and in-memory store
     SerializatorCache = new TRecSerializator(this, this, StoreSchema, slDisk);
@@ -3037,6 +3366,21 @@ void TStoreImpl::InitFromSchema(const TStoreSchema& StoreSchema) {
     RecIndexer = TRecIndexer(GetIndex(), this);
     // remember window parameters
     WndDesc = StoreSchema.WndDesc;
+    if (StoreSchema.SegmentSize > 0) {
+        Segments = TStoreSegments(StoreSchema.SegmentSize, WndDesc.WindowType == swtTime);
+    }
+    // prepare columns for columnar fields
+    InitColumns(StoreSchema);
+}
+
+void TStoreImpl::InitColumns(const TStoreSchema& StoreSchema) {
+    for (int FieldId = 0; FieldId < GetFields(); FieldId++) {
+        const TFieldDesc& FieldDesc = GetFieldDesc(FieldId);
+        if (!StoreSchema.FieldExH.IsKey(FieldDesc.GetFieldNm())) { continue; }
+        if (StoreSchema.FieldExH.GetDat(FieldDesc.GetFieldNm()).ColumnarP) {
+            Columns.AddField(FieldId, FieldDesc.GetFieldType());
+        }
+    }
 }
 
 void TStoreImpl::InitDataFlags() {
@@ -3107,6 +3451,16 @@ TStoreImpl::TStoreImpl(const TWPt<TBase>& Base, const TStr& _StoreFNm,
     InitFieldLocV();
     // initialize record indexer
     RecIndexer = TRecIndexer(GetIndex(), this);
+    // load columns, stores created before columnar layout do not have them
+    if (TFile::Exists(StoreFNm + ".Columns")) {
+        TFIn ColumnsFIn(StoreFNm + ".Columns");
+        Columns = TFieldColumns(ColumnsFIn);
+    }
+    // load window segments, only segmented stores have them
+    if (TFile::Exists(StoreFNm + ".Segments")) {
+        TFIn SegmentsFIn(StoreFNm + ".Segments");
+        Segments = TStoreSegments(SegmentsFIn);
+    }
 
     // initialize data storage flags
     InitDataFlags();
@@ -3116,30 +3470,7 @@ TStoreImpl::~TStoreImpl() {
     // save if necessary
     if (FAccess != faRdOnly) {
         TEnv::Logger->OnStatus(TStr::Fmt("Saving store '%s'...", GetStoreNm().CStr()));
-        // save base store
-        TFOut BaseFOut(StoreFNm + ".BaseStore");
-        SaveStore(BaseFOut);
-        // save store parameters
-        TFOut FOut(StoreFNm + ".GenericStore");
-        // save parameters about primary field
-        RecNmFieldP.Save(FOut);
-        PrimaryFieldId.Save(FOut);
-        if (PrimaryFieldType == oftInt) {
-            PrimaryIntIdH.Save(FOut);
-        } else if (PrimaryFieldType == oftUInt64) {
-            PrimaryUInt64IdH.Save(FOut);
-        } else if (PrimaryFieldType == oftFlt) {
-            PrimaryFltIdH.Save(FOut);
-        } else if (PrimaryFieldType == oftTm) {
-            PrimaryTmMSecsIdH.Save(FOut);
-        } else {
-            PrimaryStrIdH.Save(FOut);
-        }
-        // save time window
-        WndDesc.Save(FOut);
-        // save data
-        SerializatorCache->Save(FOut);
-        SerializatorMem->Save(FOut);
+        SaveParams();
     } else {
         TEnv::Logger->OnStatus("No saving of generic store " + GetStoreNm() + " neccessary!");
     }
@@ -3147,6 +3478,51 @@ TStoreImpl::~TStoreImpl() {
     delete SerializatorMem;
 }
 
+void TStoreImpl::SaveParams() {
+    // save base store
+    TFOut BaseFOut(StoreFNm + ".BaseStore");
+    SaveStore(BaseFOut);
+    // save store parameters
+    TFOut FOut(StoreFNm + ".GenericStore");
+    // save parameters about primary field
+    RecNmFieldP.Save(FOut);
+    PrimaryFieldId.Save(FOut);
+    if (PrimaryFieldType == oftInt) {
+        PrimaryIntIdH.Save(FOut);
+    } else if (PrimaryFieldType == oftUInt64) {
+        PrimaryUInt64IdH.Save(FOut);
+    } else if (PrimaryFieldType == oftFlt) {
+        PrimaryFltIdH.Save(FOut);
+    } else if (PrimaryFieldType == oftTm) {
+        PrimaryTmMSecsIdH.Save(FOut);
+    } else {
+        PrimaryStrIdH.Save(FOut);
+    }
+    // save time window
+    WndDesc.Save(FOut);
+    // save data
+    SerializatorCache->Save(FOut);
+    SerializatorMem->Save(FOut);
+    // save columns
+    if (!Columns.Empty()) {
+        TFOut ColumnsFOut(StoreFNm + ".Columns");
+        Columns.Save(ColumnsFOut);
+    }
+    // save segments
+    if (!Segments.Empty()) {
+        TFOut SegmentsFOut(StoreFNm + ".Segments");
+        Segments.Save(SegmentsFOut);
+    }
+}
+
+void TStoreImpl::Flush() {
+    QmAssertR(FAccess != faRdOnly, "Cannot flush store opened in read-only mode");
+    TFlushGuard FlushGuard(GetFlushLock());
+    SaveParams();
+    DataCache.Flush();
+    DataMem.Flush();
+}
+
 bool TStoreImpl::IsRecId(const uint64& RecId) const {
     return DataMemP ? DataMem.IsValId(RecId) : DataCache.IsValId(RecId);
 }
@@ -3156,6 +3532,7 @@ uint64 TStoreImpl::GetRecs() const {
 }
 
 bool TStoreImpl::IsRecNm(const TStr& RecNm) const {
+    TFlushGuard FlushGuard(GetFlushLock());
     return RecNmFieldP && PrimaryStrIdH.IsKey(RecNm);
 }
 
@@ -3167,6 +3544,7 @@ TStr TStoreImpl::GetRecNm(const uint64& RecId) const {
 }
 
 uint64 TStoreImpl::GetRecId(const TStr& RecNm) const {
+    TFlushGuard FlushGuard(GetFlushLock());
     return (PrimaryStrIdH.IsKey(RecNm) ? PrimaryStrIdH.GetDat(RecNm).Val : TUInt64::Mx);
 }
 
@@ -3257,44 +3635,67 @@ uint64 TStoreImpl::AddRec(const PJsonVal& RecVal, const bool& TriggerEvents) {
         return TUInt64::Mx;
     }
 
-    // always add system field that means "inserted_at"
-    RecVal->AddToObj(TStoreWndDesc::SysInsertedAtFieldName, TTm::GetCurUniTm().GetStr());
+    // always add system field that means "inserted_at", replayed records keep the logged one
+    if (!GetBase()->IsWalReplay() || !RecVal->IsObjKey(TStoreWndDesc::SysInsertedAtFieldName)) {
+        RecVal->AddToObj(TStoreWndDesc::SysInsertedAtFieldName, TTm::GetCurUniTm().GetStr());
+    }
+    // log the record before it is added
+    TWalOp WalOp(this);
+    WalOp.AddRec(RecVal);
 
     // for storing record id
     uint64 RecId = TUInt64::Mx;
     uint64 CacheRecId = TUInt64::Mx;
     uint64 MemRecId = TUInt64::Mx;
-    // store to disk storage
-    if (DataCacheP) {
-        TMem CacheRecMem;
-        SerializatorCache->Serialize(RecVal, CacheRecMem, this);
-        CacheRecId = DataCache.AddVal(CacheRecMem);
-        RecId = CacheRecId;
-        // index new record
-        RecIndexer.IndexRec(CacheRecMem, RecId, *SerializatorCache);
-    }
-    // store to in-memory storage
-    if (DataMemP) {
-        TMem MemRecMem;
-        SerializatorMem->Serialize(RecVal, MemRecMem, this);
-        MemRecId = DataMem.AddVal(MemRecMem);
-        RecId = MemRecId;
-        // index new record
-        RecIndexer.IndexRec(MemRecMem, RecId, *SerializatorMem);
-    }
-    // make sure we are consistent with respect to Ids!
-    if (DataCacheP && DataMemP) {
-        EAssert(CacheRecId == MemRecId);
+    {
+        // caches are written by the background flusher, readers only
+        // see the record once it is stored and indexed
+        TFlushGuard FlushGuard(GetFlushLock());
+        // store to disk storage
+        if (DataCacheP) {
+            TMem CacheRecMem;
+            SerializatorCache->Serialize(RecVal, CacheRecMem, this);
+            CacheRecId = DataCache.AddVal(CacheRecMem);
+            RecId = CacheRecId;
+            // index new record
+            RecIndexer.IndexRec(CacheRecMem, RecId, *SerializatorCache);
+        }
+        // store to in-memory storage
+        if (DataMemP) {
+            TMem MemRecMem;
+            SerializatorMem->Serialize(RecVal, MemRecMem, this);
+            MemRecId = DataMem.AddVal(MemRecMem);
+            RecId = MemRecId;
+            // append values to columns
+            Columns.AddRec(RecId, MemRecMem, *SerializatorMem);
+            // index new record
+            RecIndexer.IndexRec(MemRecMem, RecId, *SerializatorMem);
+        }
+        // make sure we are consistent with respect to Ids!
+        if (DataCacheP && DataMemP) {
+            EAssert(CacheRecId == MemRecId);
+        }
+        // assign record to window segment
+        if (!Segments.Empty()) {
+            if (Segments.IsTime()) {
+                const int TimeFieldId = GetFieldId(WndDesc.TimeFieldNm);
+                const bool NullP = IsFieldNull(RecId, TimeFieldId);
+                Segments.AddRec(RecId, NullP ? 0 : GetFieldTmMSecs(RecId, TimeFieldId), NullP);
+            } else {
+                Segments.AddRec(RecId, 0);
+            }
+        }
+        // remember value-recordId map when primary field available
+        if (IsPrimaryField()) { SetPrimaryField(RecId); }
     }
 
-    // remember value-recordId map when primary field available
-    if (IsPrimaryField()) { SetPrimaryField(RecId); }
-
     // insert nested join records
     AddJoinRec(RecId, RecVal);
     // call add triggers
     if (TriggerEvents) {
         OnAdd(RecId);
+    } else {
+        IncRecVer();
     }
 
     // return record Id of the new record
@@ -3302,6 +3703,8 @@ uint64 TStoreImpl::AddRec(const PJsonVal& RecVal, const bool& TriggerEvents) {
 }
 
 void TStoreImpl::UpdateRec(const uint64& RecId, const PJsonVal& RecVal) {
+    TWalOp WalOp(this);
+    WalOp.UpdateRec(RecId, RecVal);
     // figure out which storage fields are affected
     bool CacheP = false, MemP = false, PrimaryP = false;
     for (int FieldId = 0; FieldId < GetFields(); FieldId++) {
@@ -3313,34 +3716,39 @@ void TStoreImpl::UpdateRec(const uint64& RecId, const PJsonVal& RecVal) {
             PrimaryP = PrimaryP || (FieldId == PrimaryFieldId);
         }
     }
-    // remove old primary field
-    if (PrimaryP) { DelPrimaryField(RecId); }
-    // update disk serialization when necessary
-    if (CacheP) {
-        // update serialization
-        TMem CacheOldRecMem; DataCache.GetVal(RecId, CacheOldRecMem);
-        TMem CacheNewRecMem; TIntSet CacheChangedFieldIdSet;
-        SerializatorCache->SerializeUpdate(RecVal, CacheOldRecMem,
-            CacheNewRecMem, this, CacheChangedFieldIdSet);
-        // update the stored serializations with new values
-        DataCache.SetVal(RecId, CacheNewRecMem);
-        // update indexes pointing to the record
-        RecIndexer.UpdateRec(CacheOldRecMem, CacheNewRecMem, RecId, CacheChangedFieldIdSet, *SerializatorCache);
-    }
-    // update in-memory serialization when necessary
-    if (MemP) {
-        // update serialization
-        TMem MemOldRecMem; DataMem.GetVal(RecId, MemOldRecMem);
-        TMem MemNewRecMem; TIntSet MemChangedFieldIdSet;
-        SerializatorMem->SerializeUpdate(RecVal, MemOldRecMem,
-            MemNewRecMem, this, MemChangedFieldIdSet);
-        // update the stored serializations with new values
-        DataMem.SetVal(RecId, MemNewRecMem);
-        // update indexes pointing to the record
-        RecIndexer.UpdateRec(MemOldRecMem, MemNewRecMem, RecId, MemChangedFieldIdSet, *SerializatorMem);
+    {
+        // readers see the record either before or after the update
+        TFlushGuard FlushGuard(GetFlushLock());
+        // remove old primary field
+        if (PrimaryP) { DelPrimaryField(RecId); }
+        // update disk serialization when necessary
+        if (CacheP) {
+            // update serialization
+            TMem CacheOldRecMem; DataCache.GetVal(RecId, CacheOldRecMem);
+            TMem CacheNewRecMem; TIntSet CacheChangedFieldIdSet;
+            SerializatorCache->SerializeUpdate(RecVal, CacheOldRecMem,
+                CacheNewRecMem, this, CacheChangedFieldIdSet);
+            // update the stored serializations with new values
+            DataCache.SetVal(RecId, CacheNewRecMem);
+            // update indexes pointing to the record
+            RecIndexer.UpdateRec(CacheOldRecMem, CacheNewRecMem, RecId, CacheChangedFieldIdSet, *SerializatorCache);
+        }
+        // update in-memory serialization when necessary
+        if (MemP) {
+            // update serialization
+            TMem MemOldRecMem; DataMem.GetVal(RecId, MemOldRecMem);
+            TMem MemNewRecMem; TIntSet MemChangedFieldIdSet;
+            SerializatorMem->SerializeUpdate(RecVal, MemOldRecMem,
+                MemNewRecMem, this, MemChangedFieldIdSet);
+            // update the stored serializations with new values
+            DataMem.SetVal(RecId, MemNewRecMem);
+            Columns.SetRec(RecId, MemNewRecMem, *SerializatorMem);
+            // update indexes pointing to the record
+            RecIndexer.UpdateRec(MemOldRecMem, MemNewRecMem, RecId, MemChangedFieldIdSet, *SerializatorMem);
+        }
+        // check if primary key changed and update the mapping
+        if (PrimaryP) { SetPrimaryField(RecId); }
     }
-    // check if primary key changed and update the mapping
-    if (PrimaryP) { SetPrimaryField(RecId); }
     // call update triggers
     OnUpdate(RecId);
 }
@@ -3350,6 +3758,9 @@ void TStoreImpl::GarbageCollect() {
     if (WndDesc.WindowType == swtNone) { return; }
     // if no records, nothing to do here
     if (Empty()) { return; }
+    // writers on other threads must not append while we pick records to delete
+    TDeleteGuard DeleteGuard(GetSnapshotGate());
+    TFlushGuard FlushGuard(GetFlushLock());
     // report on activity
     TEnv::Logger->OnStatusFmt("Garbage Collection in %s", GetStoreNm().CStr());
     TEnv::Logger->OnStatusFmt("  %s records at start", TUInt64::GetStr(GetRecs()).CStr());
@@ -3370,6 +3781,11 @@ void TStoreImpl::GarbageCollect() {
         TEnv::Logger->OnStatusFmt("  window: %s - %s",
             TTm::GetTmFromMSecs(WindowStartMSecs).GetWebLogDateTimeStr(true, "T", false).CStr(),
             TTm::GetTmFromMSecs(CurMSecs).GetWebLogDateTimeStr(true, "T", false).CStr());
+        // segmented store drops segments with all records out of the window
+        if (!Segments.Empty()) {
+            DeleteSegmentRecs((int)Segments.GetExpiredRecs(WindowStartMSecs));
+            return;
+        }
         // iterate from the start until we hit the time window
         PStoreIter Iter = GetIter();
         while (Iter->Next()) {
@@ -3385,6 +3801,11 @@ void TStoreImpl::GarbageCollect() {
     } else if (GetRecs() > WndDesc.WindowSize) {
         // we are windowing based on number of records
         TEnv::Logger->OnStatusFmt("  window: last %d records", (int)WndDesc.WindowSize);
+        // segmented store drops segments while enough records remain
+        if (!Segments.Empty()) {
+            DeleteSegmentRecs((int)Segments.GetOverflowRecs(WndDesc.WindowSize));
+            return;
+        }
         // get number of records which need to be deleted so we are back in the window
         int DelRecs = (int)(GetRecs() - WndDesc.WindowSize);
         // iterate from the start until we hit the time window
@@ -3400,13 +3821,102 @@ void TStoreImpl::GarbageCollect() {
     TStoreImpl::DeleteRecs(DelRecIdV, false);
 }
 
+void TStoreImpl::DeleteSegmentRecs(const int& DelRecs) {
+    TEnv::Logger->OnStatusFmt("  purging %d records from segments", DelRecs);
+    if (DelRecs == 0) { return; }
+    // open read snapshots must not see records disappear
+    TDeleteGuard DeleteGuard(GetSnapshotGate());
+    TWalOp WalOp(this);
+    WalOp.DeleteFirstRecs(DelRecs);
+    TFlushGuard FlushGuard(GetFlushLock());
+    // segments hold consecutive records from the start of the store
+    const uint64 FirstRecId = GetFirstRecId();
+    TUInt64V DelRecIdV(DelRecs, 0);
+    for (int DelRecN = 0; DelRecN < DelRecs; DelRecN++) {
+        DelRecIdV.Add(FirstRecId + (uint64)DelRecN);
+    }
+    DeleteFirstRecIds(DelRecIdV, true);
+    TEnv::Logger->OnStatusFmt("  %s records at end", TUInt64::GetStr(GetRecs()).CStr());
+}
+
+void TStoreImpl::DeleteFirstRecIds(const TUInt64V& DelRecIdV, const bool& SegmentP) {
+    // NOTE: if you change the logic bellow, be sure to also change the DeleteAllRecs() method
+
+    // delete records from index
+    for (int DelRecN = 0; DelRecN < DelRecIdV.Len(); DelRecN++) {
+        // report progress
+        if (DelRecN > 0 && DelRecN % 1000 == 0) {
+            TEnv::Logger->OnStatusFmt("    %d\r", DelRecN);
+        }
+        // what are we deleting now
+        const uint64 DelRecId = DelRecIdV[DelRecN];
+        // executed triggers before deletion
+        OnDelete(DelRecId);
+        // delete record from name-id map
+        if (IsPrimaryField()) {
+            DelPrimaryField(DelRecId);
+        }
+        // delete record from indexes, inverted index of segments is cut in bulk below
+        if (DataCacheP) {
+            TMem CacheRecMem;
+            DataCache.GetVal(DelRecId, CacheRecMem);
+            if (SegmentP) {
+                RecIndexer.DeindexRecTrees(CacheRecMem, DelRecId, *SerializatorCache);
+            } else {
+                RecIndexer.DeindexRec(CacheRecMem, DelRecId, *SerializatorCache);
+            }
+        }
+        if (DataMemP) {
+            TMem MemRecMem;
+            DataMem.GetVal(DelRecId, MemRecMem);
+            if (SegmentP) {
+                RecIndexer.DeindexRecTrees(MemRecMem, DelRecId, *SerializatorMem);
+            } else {
+                RecIndexer.DeindexRec(MemRecMem, DelRecId, *SerializatorMem);
+            }
+        }
+        // delete record from joins
+        if (GetJoins() == 0) { continue; }
+        TRec Rec(this, DelRecId);
+        for (int JoinN = 0; JoinN < GetJoins(); JoinN++) {
+            TJoinDesc JoinDesc = GetJoinDesc(JoinN);
+            // execute the join
+            PRecSet JoinRecSet = Rec.DoJoin(GetBase(), JoinDesc.GetJoinId());
+            for (int JoinRecN = 0; JoinRecN < JoinRecSet->GetRecs(); JoinRecN++) {
+                // remove joins with all matched records, one by one
+                const uint64 JoinRecId = JoinRecSet->GetRecId(JoinRecN);
+                DelJoin(JoinDesc.GetJoinId(), DelRecId, JoinRecId);
+            }
+        }
+    }
+    // delete inverted index entries of all segment records at once
+    if (SegmentP && !DelRecIdV.Empty()) {
+        GetIndex()->DeleteRecsBefore(GetStoreId(), DelRecIdV.Last() + 1);
+    }
+    // delete records from disk
+    if (DataCacheP) {
+        DataCache.DelVals(DelRecIdV.Len());
+    }
+    // delete records from in-memory store
+    if (DataMemP) {
+        DataMem.DelVals(DelRecIdV.Len());
+        Columns.DelRecs(DelRecIdV.Len());
+    }
+    Segments.DelRecs(DelRecIdV.Len());
+}
+
 /// Deletes all records
 void TStoreImpl::DeleteAllRecs() {
     // if no records, nothing to do here
     if (Empty()) { return; }
+    // open read snapshots must not see records disappear
+    TDeleteGuard DeleteGuard(GetSnapshotGate());
+    TWalOp WalOp(this);
+    WalOp.DeleteAllRecs();
     TEnv::Logger->OnStatusFmt("Deleting all (%d) records in %s", GetRecs(), GetStoreNm().CStr());
+    TFlushGuard FlushGuard(GetFlushLock());
 
-    // NOTE: if you change the logic bellow, be sure to also change the DeleteRecs() method
+    // NOTE: if you change the logic bellow, be sure to also change the DeleteFirstRecIds() method
 
     // delete records from index
     for (uint64 DelRecId = GetFirstRecId(); DelRecId <= GetLastRecId(); DelRecId++) {
@@ -3447,12 +3957,19 @@ void TStoreImpl::DeleteAllRecs() {
     PrimaryTmMSecsIdH.Clr();
     DataCache.DelVals(TInt::Mx);
     DataMem.DelVals(TInt::Mx);
+    Columns.Clr();
+    Segments.Clr();
     PartialFlush(TInt::Mx);
 }
 
 void TStoreImpl::DeleteFirstRecs(const int& DelRecs)  {
     // if no records, nothing to do here
     if (Empty()) { return; }
+    // open read snapshots must not see records disappear
+    TDeleteGuard DeleteGuard(GetSnapshotGate());
+    TWalOp WalOp(this);
+    WalOp.DeleteFirstRecs(DelRecs);
+    TFlushGuard FlushGuard(GetFlushLock());
     // report on activity
     TEnv::Logger->OnStatusFmt("Deleting %d records in %s", DelRecs, GetStoreNm().CStr());
     TEnv::Logger->OnStatusFmt("  %s records at start", TUInt64::GetStr(GetRecs()).CStr());
@@ -3472,6 +3989,11 @@ void TStoreImpl::DeleteFirstRecs(const int& DelRecs)  {
 }
 
 void TStoreImpl::DeleteRecs(const TUInt64V& DelRecIdV, const bool& AssertOK) {
+    // open read snapshots must not see records disappear
+    TDeleteGuard DeleteGuard(GetSnapshotGate());
+    TWalOp WalOp(this);
+    WalOp.DeleteRecs(DelRecIdV, AssertOK);
+    TFlushGuard FlushGuard(GetFlushLock());
     if (AssertOK) {
         // assert that DelRecIdV is valid, without gaps and that deleting will not create gaps
         PStoreIter Iter = GetIter();
@@ -3485,173 +4007,199 @@ void TStoreImpl::DeleteRecs(const TUInt64V& DelRecIdV, const bool& AssertOK) {
             Counter++;
         }
     }
+    // delete records from indexes, joins and storage
+    DeleteFirstRecIds(DelRecIdV, false);
+    // report success :-)
+    if (DelRecIdV.Len() > 1000) {
+        TEnv::Logger->OnStatusFmt("  %s records at end", TUInt64::GetStr(GetRecs()).CStr());
+    }
+}
 
-    // NOTE: if you change the logic bellow, be sure to also change the DeleteAllRecs() method
+bool TStoreImpl::IsSegmentField(const int& FieldId) const {
+    return !Segments.Empty() && Segments.IsTime() && GetFieldNm(FieldId) == WndDesc.TimeFieldNm;
+}
 
-    // delete records from index
-    for (int DelRecN = 0; DelRecN < DelRecIdV.Len(); DelRecN++) {
-        // report progress
-        if (DelRecN > 0 && DelRecN % 1000 == 0) {
-            TEnv::Logger->OnStatusFmt("    %d\r", DelRecN);
-        }
-        // what are we deleting now
-        const uint64 DelRecId = DelRecIdV[DelRecN];
-        // executed triggers before deletion
-        OnDelete(DelRecId);
-        // delete record from name-id map
-        if (IsPrimaryField()) {
-            DelPrimaryField(DelRecId);
-        }
-        // delete record from indexes
-        if (DataCacheP) {
-            TMem CacheRecMem;
-            DataCache.GetVal(DelRecId, CacheRecMem);
-            RecIndexer.DeindexRec(CacheRecMem, DelRecId, *SerializatorCache);
-        }
-        if (DataMemP) {
-            TMem MemRecMem;
-            DataMem.GetVal(DelRecId, MemRecMem);
-            RecIndexer.DeindexRec(MemRecMem, DelRecId, *SerializatorMem);
-        }
-        // delete record from joins
-        TRec Rec(this, DelRecId);
-        for (int JoinN = 0; JoinN < GetJoins(); JoinN++) {
-            TJoinDesc JoinDesc = GetJoinDesc(JoinN);
-            // execute the join
-            PRecSet JoinRecSet = Rec.DoJoin(GetBase(), JoinDesc.GetJoinId());
-            for (int JoinRecN = 0; JoinRecN < JoinRecSet->GetRecs(); JoinRecN++) {
-                // remove joins with all matched records, one by one
-                const uint64 JoinRecId = JoinRecSet->GetRecId(JoinRecN);
-                DelJoin(JoinDesc.GetJoinId(), DelRecId, JoinRecId);
+void TStoreImpl::SearchSegments(const int& FieldId, const uint64& MinMSecs,
+        const uint64& MaxMSecs, TUInt64V& RecIdV) const {
+
+    QmAssertR(IsSegmentField(FieldId), "Field " + GetFieldNm(FieldId) + " is not the segment time field");
+    TVec<TUInt64Pr> RecIdPrV; TBoolV FullV;
+    Segments.GetRangeSegments(MinMSecs, MaxMSecs, RecIdPrV, FullV);
+    RecIdV.Clr();
+    for (int SegmentN = 0; SegmentN < RecIdPrV.Len(); SegmentN++) {
+        const uint64 FirstRecId = RecIdPrV[SegmentN].Val1, LastRecId = RecIdPrV[SegmentN].Val2;
+        if (FullV[SegmentN]) {
+            // all records of the segment are in the range
+            for (uint64 RecId = FirstRecId; RecId <= LastRecId; RecId++) { RecIdV.Add(RecId); }
+        } else {
+            // segment at the edge of the range
+            for (uint64 RecId = FirstRecId; RecId <= LastRecId; RecId++) {
+                if (IsFieldNull(RecId, FieldId)) { continue; }
+                const uint64 TmMSecs = GetFieldTmMSecs(RecId, FieldId);
+                if (MinMSecs <= TmMSecs && TmMSecs <= MaxMSecs) { RecIdV.Add(RecId); }
             }
         }
     }
-    // delete records from disk
-    if (DataCacheP) {
-        DataCache.DelVals(DelRecIdV.Len());
-    }
-    // delete records from in-memory store
-    if (DataMemP) {
-        DataMem.DelVals(DelRecIdV.Len());
-    }
-
-    // report success :-)
-    if (DelRecIdV.Len() > 1000) {
-        TEnv::Logger->OnStatusFmt("  %s records at end", TUInt64::GetStr(GetRecs()).CStr());
-    }
 }
 
 bool TStoreImpl::IsFieldNull(const uint64& RecId, const int& FieldId) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TRecMemView RecMem; GetRecMemView(RecId, FieldId, RecMem);
     return GetFieldSerializator(FieldId)->IsFieldNull(RecMem, FieldId);
 }
 
 uchar TStoreImpl::GetFieldByte(const uint64& RecId, const int& FieldId) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    if (Columns.IsField(FieldId)) { TFlushGuard FlushGuard(GetFlushLock()); return Columns.GetByte(FieldId, RecId); }
+    TRecMemView RecMem; GetRecMemView(RecId, FieldId, RecMem);
     return GetFieldSerializator(FieldId)->GetFieldByte(RecMem, FieldId);
 }
 
 int TStoreImpl::GetFieldInt(const uint64& RecId, const int& FieldId) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    if (Columns.IsField(FieldId)) { TFlushGuard FlushGuard(GetFlushLock()); return Columns.GetInt(FieldId, RecId); }
+    TRecMemView RecMem; GetRecMemView(RecId, FieldId, RecMem);
     return GetFieldSerializator(FieldId)->GetFieldInt(RecMem, FieldId);
 }
 
 int16 TStoreImpl::GetFieldInt16(const uint64& RecId, const int& FieldId) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TRecMemView RecMem; GetRecMemView(RecId, FieldId, RecMem);
     return GetFieldSerializator(FieldId)->GetFieldInt16(RecMem, FieldId);
 }
 
 int64 TStoreImpl::GetFieldInt64(const uint64& RecId, const int& FieldId) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TRecMemView RecMem; GetRecMemView(RecId, FieldId, RecMem);
     return GetFieldSerializator(FieldId)->GetFieldInt64(RecMem, FieldId);
 }
 
 TStr TStoreImpl::GetFieldStr(const uint64& RecId, const int& FieldId) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TRecMemView RecMem; GetRecMemView(RecId, FieldId, RecMem);
     return GetFieldSerializator(FieldId)->GetFieldStr(RecMem, FieldId);
 }
 
 bool TStoreImpl::GetFieldBool(const uint64& RecId, const int& FieldId) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    if (Columns.IsField(FieldId)) { TFlushGuard FlushGuard(GetFlushLock()); return Columns.GetByte(FieldId, RecId) != 0; }
+    TRecMemView RecMem; GetRecMemView(RecId, FieldId, RecMem);
     return GetFieldSerializator(FieldId)->GetFieldBool(RecMem, FieldId);
 }
 
 double TStoreImpl::GetFieldFlt(const uint64& RecId, const int& FieldId) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    if (Columns.IsField(FieldId)) { TFlushGuard FlushGuard(GetFlushLock()); return Columns.GetFlt(FieldId, RecId); }
+    TRecMemView RecMem; GetRecMemView(RecId, FieldId, RecMem);
     return GetFieldSerializator(FieldId)->GetFieldFlt(RecMem, FieldId);
 }
 
 float TStoreImpl::GetFieldSFlt(const uint64& RecId, const int& FieldId) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TRecMemView RecMem; GetRecMemView(RecId, FieldId, RecMem);
     return GetFieldSerializator(FieldId)->GetFieldSFlt(RecMem, FieldId);
 }
 
 TFltPr TStoreImpl::GetFieldFltPr(const uint64& RecId, const int& FieldId) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TRecMemView RecMem; GetRecMemView(RecId, FieldId, RecMem);
     return GetFieldSerializator(FieldId)->GetFieldFltPr(RecMem, FieldId);
 }
 
 uint TStoreImpl::GetFieldUInt(const uint64& RecId, const int& FieldId) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TRecMemView RecMem; GetRecMemView(RecId, FieldId, RecMem);
     return GetFieldSerializator(FieldId)->GetFieldUInt(RecMem, FieldId);
 }
 
 uint16 TStoreImpl::GetFieldUInt16(const uint64& RecId, const int& FieldId) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TRecMemView RecMem; GetRecMemView(RecId, FieldId, RecMem);
     return GetFieldSerializator(FieldId)->GetFieldUInt16(RecMem, FieldId);
 }
 
 uint64 TStoreImpl::GetFieldUInt64(const uint64& RecId, const int& FieldId) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TRecMemView RecMem; GetRecMemView(RecId, FieldId, RecMem);
     return GetFieldSerializator(FieldId)->GetFieldUInt64(RecMem, FieldId);
 }
 
 void TStoreImpl::GetFieldStrV(const uint64& RecId, const int& FieldId, TStrV& StrV) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TRecMemView RecMem; GetRecMemView(RecId, FieldId, RecMem);
     GetFieldSerializator(FieldId)->GetFieldStrV(RecMem, FieldId, StrV);
 }
 
 void TStoreImpl::GetFieldIntV(const uint64& RecId, const int& FieldId, TIntV& IntV) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TRecMemView RecMem; GetRecMemView(RecId, FieldId, RecMem);
     GetFieldSerializator(FieldId)->GetFieldIntV(RecMem, FieldId, IntV);
 }
 
 void TStoreImpl::GetFieldFltV(const uint64& RecId, const int& FieldId, TFltV& FltV) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TRecMemView RecMem; GetRecMemView(RecId, FieldId, RecMem);
     GetFieldSerializator(FieldId)->GetFieldFltV(RecMem, FieldId, FltV);
 }
 
 void TStoreImpl::GetFieldTm(const uint64& RecId, const int& FieldId, TTm& Tm) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    if (Columns.IsField(FieldId)) { TFlushGuard FlushGuard(GetFlushLock()); Tm = TTm::GetTmFromMSecs(Columns.GetTmMSecs(FieldId, RecId)); return; }
+    TRecMemView RecMem; GetRecMemView(RecId, FieldId, RecMem);
     GetFieldSerializator(FieldId)->GetFieldTm(RecMem, FieldId, Tm);
 }
 
 uint64 TStoreImpl::GetFieldTmMSecs(const uint64& RecId, const int& FieldId) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    if (Columns.IsField(FieldId)) { TFlushGuard FlushGuard(GetFlushLock()); return Columns.GetTmMSecs(FieldId, RecId); }
+    TRecMemView RecMem; GetRecMemView(RecId, FieldId, RecMem);
     return GetFieldSerializator(FieldId)->GetFieldTmMSecs(RecMem, FieldId);
 }
 
 void TStoreImpl::GetFieldNumSpV(const uint64& RecId, const int& FieldId, TIntFltKdV& SpV) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TRecMemView RecMem; GetRecMemView(RecId, FieldId, RecMem);
     GetFieldSerializator(FieldId)->GetFieldNumSpV(RecMem, FieldId, SpV);
 }
 
 void TStoreImpl::GetFieldBowSpV(const uint64& RecId, const int& FieldId, PBowSpV& SpV) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TRecMemView RecMem; GetRecMemView(RecId, FieldId, RecMem);
     GetFieldSerializator(FieldId)->GetFieldBowSpV(RecMem, FieldId, SpV);
 }
 
 void TStoreImpl::GetFieldTMem(const uint64& RecId, const int& FieldId, TMem& Mem) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TRecMemView RecMem; GetRecMemView(RecId, FieldId, RecMem);
     GetFieldSerializator(FieldId)->GetFieldTMem(RecMem, FieldId, Mem);
 }
 
 PJsonVal TStoreImpl::GetFieldJsonVal(const uint64& RecId, const int& FieldId) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TRecMemView RecMem; GetRecMemView(RecId, FieldId, RecMem);
     return GetFieldSerializator(FieldId)->GetFieldJsonVal(RecMem, FieldId);
 }
 
+void TStoreImpl::GetColumnInt(const int& FieldId, const TUInt64V& RecIdV, TIntV& ValV) const {
+    if (Columns.IsField(FieldId)) { TFlushGuard FlushGuard(GetFlushLock()); Columns.GetIntV(FieldId, RecIdV, ValV); }
+    else { TStore::GetColumnInt(FieldId, RecIdV, ValV); }
+}
+
+void TStoreImpl::GetColumnFlt(const int& FieldId, const TUInt64V& RecIdV, TFltV& ValV) const {
+    if (Columns.IsField(FieldId)) { TFlushGuard FlushGuard(GetFlushLock()); Columns.GetFltV(FieldId, RecIdV, ValV); }
+    else { TStore::GetColumnFlt(FieldId, RecIdV, ValV); }
+}
+
+void TStoreImpl::GetColumnTmMSecs(const int& FieldId, const TUInt64V& RecIdV, TUInt64V& ValV) const {
+    if (Columns.IsField(FieldId)) { TFlushGuard FlushGuard(GetFlushLock()); Columns.GetTmMSecsV(FieldId, RecIdV, ValV); }
+    else { TStore::GetColumnTmMSecs(FieldId, RecIdV, ValV); }
+}
+
+void TStoreImpl::GetColumnByte(const int& FieldId, const TUInt64V& RecIdV, TUChV& ValV) const {
+    if (Columns.IsField(FieldId)) { TFlushGuard FlushGuard(GetFlushLock()); Columns.GetByteV(FieldId, RecIdV, ValV); }
+    else { TStore::GetColumnByte(FieldId, RecIdV, ValV); }
+}
+
+void TStoreImpl::GetColumnInt(const int& FieldId, TIntV& ValV) const {
+    if (Columns.IsField(FieldId)) { TFlushGuard FlushGuard(GetFlushLock()); Columns.GetIntV(FieldId, ValV); }
+    else { TStore::GetColumnInt(FieldId, ValV); }
+}
+
+void TStoreImpl::GetColumnFlt(const int& FieldId, TFltV& ValV) const {
+    if (Columns.IsField(FieldId)) { TFlushGuard FlushGuard(GetFlushLock()); Columns.GetFltV(FieldId, ValV); }
+    else { TStore::GetColumnFlt(FieldId, ValV); }
+}
+
+void TStoreImpl::GetColumnTmMSecs(const int& FieldId, TUInt64V& ValV) const {
+    if (Columns.IsField(FieldId)) { TFlushGuard FlushGuard(GetFlushLock()); Columns.GetTmMSecsV(FieldId, ValV); }
+    else { TStore::GetColumnTmMSecs(FieldId, ValV); }
+}
+
+void TStoreImpl::GetColumnByte(const int& FieldId, TUChV& ValV) const {
+    if (Columns.IsField(FieldId)) { TFlushGuard FlushGuard(GetFlushLock()); Columns.GetByteV(FieldId, ValV); }
+    else { TStore::GetColumnByte(FieldId, ValV); }
+}
+
 void TStoreImpl::SetFieldNull(const uint64& RecId, const int& FieldId) {
+    TFlushGuard FlushGuard(GetFlushLock());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem; FieldSerializator->SetFieldNull(InRecMem, OutRecMem, FieldId);
@@ -3660,6 +4208,7 @@ void TStoreImpl::SetFieldNull(const uint64& RecId, const int& FieldId) {
 }
 
 void TStoreImpl::SetFieldByte(const uint64& RecId, const int& FieldId, const uchar& Byte) {
+    TFlushGuard FlushGuard(GetFlushLock());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem;
@@ -3669,6 +4218,7 @@ void TStoreImpl::SetFieldByte(const uint64& RecId, const int& FieldId, const uch
 }
 
 void TStoreImpl::SetFieldInt(const uint64& RecId, const int& FieldId, const int& Int) {
+    TFlushGuard FlushGuard(GetFlushLock());
     // special case if field is primary field
     if (FieldId == PrimaryFieldId) {
         // it is, make sure new value does not exist yet
@@ -3691,6 +4241,7 @@ void TStoreImpl::SetFieldInt(const uint64& RecId, const int& FieldId, const int&
 }
 
 void TStoreImpl::SetFieldInt16(const uint64& RecId, const int& FieldId, const int16& Int16) {
+    TFlushGuard FlushGuard(GetFlushLock());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem;
@@ -3700,6 +4251,7 @@ void TStoreImpl::SetFieldInt16(const uint64& RecId, const int& FieldId, const in
 }
 
 void TStoreImpl::SetFieldInt64(const uint64& RecId, const int& FieldId, const int64& Int64) {
+    TFlushGuard FlushGuard(GetFlushLock());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem;
@@ -3709,6 +4261,7 @@ void TStoreImpl::SetFieldInt64(const uint64& RecId, const int& FieldId, const in
 }
 
 void TStoreImpl::SetFieldIntV(const uint64& RecId, const int& FieldId, const TIntV& IntV) {
+    TFlushGuard FlushGuard(GetFlushLock());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem;
@@ -3718,6 +4271,7 @@ void TStoreImpl::SetFieldIntV(const uint64& RecId, const int& FieldId, const TIn
 }
 
 void TStoreImpl::SetFieldUInt(const uint64& RecId, const int& FieldId, const uint& UInt) {
+    TFlushGuard FlushGuard(GetFlushLock());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem;
@@ -3727,6 +4281,7 @@ void TStoreImpl::SetFieldUInt(const uint64& RecId, const int& FieldId, const uin
 }
 
 void TStoreImpl::SetFieldUInt16(const uint64& RecId, const int& FieldId, const uint16& UInt16) {
+    TFlushGuard FlushGuard(GetFlushLock());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem;
@@ -3736,6 +4291,7 @@ void TStoreImpl::SetFieldUInt16(const uint64& RecId, const int& FieldId, const u
 }
 
 void TStoreImpl::SetFieldUInt64(const uint64& RecId, const int& FieldId, const uint64& UInt64) {
+    TFlushGuard FlushGuard(GetFlushLock());
     // special case if field is primary field
     if (FieldId == PrimaryFieldId) {
         // it is, make sure new value does not exist yet
@@ -3758,6 +4314,7 @@ void TStoreImpl::SetFieldUInt64(const uint64& RecId, const int& FieldId, const u
 }
 
 void TStoreImpl::SetFieldStr(const uint64& RecId, const int& FieldId, const TStr& Str) {
+    TFlushGuard FlushGuard(GetFlushLock());
     // special case if field is primary field
     if (FieldId == PrimaryFieldId) {
         // it is, make sure new value does not exist yet
@@ -3780,6 +4337,7 @@ void TStoreImpl::SetFieldStr(const uint64& RecId, const int& FieldId, const TStr
 }
 
 void TStoreImpl::SetFieldStrV(const uint64& RecId, const int& FieldId, const TStrV& StrV) {
+    TFlushGuard FlushGuard(GetFlushLock());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem;
@@ -3789,6 +4347,7 @@ void TStoreImpl::SetFieldStrV(const uint64& RecId, const int& FieldId, const TSt
 }
 
 void TStoreImpl::SetFieldBool(const uint64& RecId, const int& FieldId, const bool& Bool) {
+    TFlushGuard FlushGuard(GetFlushLock());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem;
@@ -3798,6 +4357,7 @@ void TStoreImpl::SetFieldBool(const uint64& RecId, const int& FieldId, const boo
 }
 
 void TStoreImpl::SetFieldFlt(const uint64& RecId, const int& FieldId, const double& Flt) {
+    TFlushGuard FlushGuard(GetFlushLock());
     // special case if field is primary field
     if (FieldId == PrimaryFieldId) {
         // it is, make sure new value does not exist yet
@@ -3819,6 +4379,7 @@ void TStoreImpl::SetFieldFlt(const uint64& RecId, const int& FieldId, const doub
     if (FieldId == PrimaryFieldId) { SetPrimaryFieldFlt(RecId, Flt); }
 }
 void TStoreImpl::SetFieldSFlt(const uint64& RecId, const int& FieldId, const float& SFlt) {
+    TFlushGuard FlushGuard(GetFlushLock());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem;
@@ -3828,6 +4389,7 @@ void TStoreImpl::SetFieldSFlt(const uint64& RecId, const int& FieldId, const flo
 }
 
 void TStoreImpl::SetFieldFltPr(const uint64& RecId, const int& FieldId, const TFltPr& FltPr) {
+    TFlushGuard FlushGuard(GetFlushLock());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem;
@@ -3837,6 +4399,7 @@ void TStoreImpl::SetFieldFltPr(const uint64& RecId, const int& FieldId, const TF
 }
 
 void TStoreImpl::SetFieldFltV(const uint64& RecId, const int& FieldId, const TFltV& FltV) {
+    TFlushGuard FlushGuard(GetFlushLock());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem;
@@ -3846,6 +4409,7 @@ void TStoreImpl::SetFieldFltV(const uint64& RecId, const int& FieldId, const TFl
 }
 
 void TStoreImpl::SetFieldTm(const uint64& RecId, const int& FieldId, const TTm& Tm) {
+    TFlushGuard FlushGuard(GetFlushLock());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem;
@@ -3855,6 +4419,7 @@ void TStoreImpl::SetFieldTm(const uint64& RecId, const int& FieldId, const TTm&
 }
 
 void TStoreImpl::SetFieldTmMSecs(const uint64& RecId, const int& FieldId, const uint64& TmMSecs) {
+    TFlushGuard FlushGuard(GetFlushLock());
     // special case if field is primary field
     if (FieldId == PrimaryFieldId) {
         // it is, make sure new value does not exist yet
@@ -3877,6 +4442,7 @@ void TStoreImpl::SetFieldTmMSecs(const uint64& RecId, const int& FieldId, const
 }
 
 void TStoreImpl::SetFieldNumSpV(const uint64& RecId, const int& FieldId, const TIntFltKdV& SpV) {
+    TFlushGuard FlushGuard(GetFlushLock());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem;
@@ -3886,6 +4452,7 @@ void TStoreImpl::SetFieldNumSpV(const uint64& RecId, const int& FieldId, const T
 }
 
 void TStoreImpl::SetFieldBowSpV(const uint64& RecId, const int& FieldId, const PBowSpV& SpV) {
+    TFlushGuard FlushGuard(GetFlushLock());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem;
@@ -3895,6 +4462,7 @@ void TStoreImpl::SetFieldBowSpV(const uint64& RecId, const int& FieldId, const P
 }
 
 void TStoreImpl::SetFieldTMem(const uint64& RecId, const int& FieldId, const TMem& Mem) {
+    TFlushGuard FlushGuard(GetFlushLock());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem;
@@ -3904,6 +4472,7 @@ void TStoreImpl::SetFieldTMem(const uint64& RecId, const int& FieldId, const TMe
 }
 
 void TStoreImpl::SetFieldJsonVal(const uint64& RecId, const int& FieldId, const PJsonVal& Json) {
+    TFlushGuard FlushGuard(GetFlushLock());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem;
@@ -3937,6 +4506,7 @@ int TStoreImpl::GetCodebookId(const int& FieldId, const TStr& Str) const {
 }
 
 int TStoreImpl::PartialFlush(int WndInMsec) {
+    TFlushGuard FlushGuard(GetFlushLock());
     int slice = WndInMsec / 2;
     TTmStopWatch sw(true);
     int res = DataMem.PartialFlush(slice);
@@ -3944,11 +4514,26 @@ int TStoreImpl::PartialFlush(int WndInMsec) {
     return res + res2;
 }
 
+uint64 TStoreImpl::GetDirtyBytes() {
+    TFlushGuard FlushGuard(GetFlushLock());
+    return DataMem.GetDirtyBytes() + DataCache.GetDirtyBytes();
+}
+
 PJsonVal TStoreImpl::GetStats() {
+    TFlushGuard FlushGuard(GetFlushLock());
     PJsonVal res = TJsonVal::NewObj();
     res->AddToObj("name", GetStoreNm());
     res->AddToObj("blob_storage_memory", BlobBsStatsToJson(DataMem.GetBlobBsStats()));
     res->AddToObj("blob_storage_cache", BlobBsStatsToJson(DataCache.GetBlobBsStats()));
+    if (!Columns.Empty()) { res->AddToObj("columns_memory", (double)Columns.GetMemUsed()); }
+    if (!Segments.Empty()) { res->AddToObj("segments", Segments.GetSegments()); }
+    PJsonVal CacheVal = TJsonVal::NewObj();
+    const uint64 Hits = DataCache.GetCacheHits(), Misses = DataCache.GetCacheMisses();
+    CacheVal->AddToObj("policy", TCachePolicyStr::GetStr(DataCache.GetCachePolicy()));
+    CacheVal->AddToObj("hits", Hits);
+    CacheVal->AddToObj("misses", Misses);
+    CacheVal->AddToObj("hit_rate", (Hits + Misses > 0) ? (double)Hits / (double)(Hits + Misses) : 0.0);
+    res->AddToObj("cache", CacheVal);
     return res;
 }
 
@@ -4029,45 +4614,56 @@ uint64 TStorePbBlob::AddRec(const PJsonVal& RecVal, const bool& TriggerEvents) {
         return TUInt64::Mx;
     }
 
-    // always add system field that means "inserted_at"
-    RecVal->AddToObj(TStoreWndDesc::SysInsertedAtFieldName, TTm::GetCurUniTm().GetStr());
+    // always add system field that means "inserted_at", replayed records keep the logged one
+    if (!GetBase()->IsWalReplay() || !RecVal->IsObjKey(TStoreWndDesc::SysInsertedAtFieldName)) {
+        RecVal->AddToObj(TStoreWndDesc::SysInsertedAtFieldName, TTm::GetCurUniTm().GetStr());
+    }
+    // log the record before it is added
+    TWalOp WalOp(this);
+    WalOp.AddRec(RecVal);
 
     // for storing record id
     TPgBlobPt CacheRecId;
     TPgBlobPt MemRecId;
     uint64 RecId = RecIdCounter++;
-    // store to disk storage
-    if (DataBlobP) {
-        TMem CacheRecMem;
-        SerializatorCache->Serialize(RecVal, CacheRecMem, this);
-        TPgBlobPt Pt = DataBlob->Put(CacheRecMem.GetBf(), CacheRecMem.Len());
-        CacheRecId = Pt;
-        RecIdBlobPtH.AddDat(RecId) = Pt;
-        // index new record
-        RecIndexer.IndexRec(CacheRecMem, RecId, *SerializatorCache);
-    }
-    // store to in-memory storage
-    if (DataMemP) {
-        TMem MemRecMem;
-        SerializatorMem->Serialize(RecVal, MemRecMem, this);
-        TPgBlobPt Pt = DataMem->Put(MemRecMem.GetBf(), MemRecMem.Len());
-        MemRecId = Pt;
-        RecIdBlobPtHMem.AddDat(RecId) = Pt;
-        RecIndexer.IndexRec(MemRecMem, RecId, *SerializatorMem);
-    }
-    // make sure we are consistent with respect to Ids!
-    if (DataBlobP && DataMemP) {
-        EAssert(RecId == RecIdCounter - 1);
+    {
+        // caches are written by the background flusher, readers only
+        // see the record once it is stored and indexed
+        TFlushGuard FlushGuard(GetFlushLock());
+        // store to disk storage
+        if (DataBlobP) {
+            TMem CacheRecMem;
+            SerializatorCache->Serialize(RecVal, CacheRecMem, this);
+            TPgBlobPt Pt = DataBlob->Put(CacheRecMem.GetBf(), CacheRecMem.Len());
+            CacheRecId = Pt;
+            RecIdBlobPtH.AddDat(RecId) = Pt;
+            // index new record
+            RecIndexer.IndexRec(CacheRecMem, RecId, *SerializatorCache);
+        }
+        // store to in-memory storage
+        if (DataMemP) {
+            TMem MemRecMem;
+            SerializatorMem->Serialize(RecVal, MemRecMem, this);
+            TPgBlobPt Pt = DataMem->Put(MemRecMem.GetBf(), MemRecMem.Len());
+            MemRecId = Pt;
+            RecIdBlobPtHMem.AddDat(RecId) = Pt;
+            RecIndexer.IndexRec(MemRecMem, RecId, *SerializatorMem);
+        }
+        // make sure we are consistent with respect to Ids!
+        if (DataBlobP && DataMemP) {
+            EAssert(RecId == RecIdCounter - 1);
+        }
+        // remember value-recordId map when primary field available
+        if (IsPrimaryField()) { SetPrimaryField(RecId); }
     }
 
-    // remember value-recordId map when primary field available
-    if (IsPrimaryField()) { SetPrimaryField(RecId); }
-
     // insert nested join records
     AddJoinRec(RecId, RecVal);
     // call add triggers
     if (TriggerEvents) {
         OnAdd(RecId);
+    } else {
+        IncRecVer();
     }
 
     // return record Id of the new record
@@ -4076,6 +4672,8 @@ uint64 TStorePbBlob::AddRec(const PJsonVal& RecVal, const bool& TriggerEvents) {
 
 /// Update existing record
 void TStorePbBlob::UpdateRec(const uint64& RecId, const PJsonVal& RecVal) {
+    TWalOp WalOp(this);
+    WalOp.UpdateRec(RecId, RecVal);
     // figure out which storage fields are affected
     bool CacheP = false, MemP = false, PrimaryP = false;
     bool CacheVarP = false, MemVarP = false, KeyP = false;
@@ -4116,6 +4714,7 @@ void TStorePbBlob::UpdateRec(const uint64& RecId, const PJsonVal& RecVal) {
     if (PrimaryP) { DelPrimaryField(RecId); }
     // update disk serialization when necessary
     if (CacheP) {
+        TFlushGuard FlushGuard(GetFlushLock());
         // update serialization
         TPgBlobPt Pt = RecIdBlobPtH.GetDat(RecId);
         TThinMIn MIn = DataBlob->Get(Pt);
@@ -4147,6 +4746,7 @@ void TStorePbBlob::UpdateRec(const uint64& RecId, const PJsonVal& RecVal) {
     }
     // update in-memory serialization when necessary
     if (MemP) {
+        TFlushGuard FlushGuard(GetFlushLock());
         // update serialization
         TPgBlobPt Pt = RecIdBlobPtHMem.GetDat(RecId);
         TThinMIn MIn = DataMem->Get(Pt);
@@ -4186,6 +4786,7 @@ void TStorePbBlob::UpdateRec(const uint64& RecId, const PJsonVal& RecVal) {
 
 /// Load page with with given record and return pointer to it
 TThinMIn TStorePbBlob::GetPgBf(const uint64& RecId, const bool& UseMem) const {
+    TFlushGuard FlushGuard(GetFlushLock());
     if (UseMem) {
         const TPgBlobPt& PgPt = RecIdBlobPtHMem.GetDat(RecId);
         TThinMIn min = DataMem->Get(PgPt);
@@ -4373,6 +4974,8 @@ PJsonVal TStorePbBlob::GetFieldJsonVal(const uint64& RecId, const int& FieldId)
 //////////////////////
 
 TThinMIn TStorePbBlob::GetEditableField(const uint64& RecId, const int& FieldId) {
+    // also non-indexed fields, cached query results can hold their values
+    IncRecVer();
     if (FieldLocV[FieldId] == TStoreLoc::slDisk) {
         TPgBlobPt& PgPt = RecIdBlobPtH.GetDat(RecId);
         DataBlob->SetDirty(PgPt);
@@ -4387,6 +4990,7 @@ TThinMIn TStorePbBlob::GetEditableField(const uint64& RecId, const int& FieldId)
 
 void TStorePbBlob::GetRecData(const uint64& RecId, const int& FieldId, TMemBase& Mem, THash<TUInt64, TPgBlobPt>* &RecIdBlobPtr, PPgBlob& Blob, TPgBlobPt* &PgPt)
 {
+    TFlushGuard FlushGuard(GetFlushLock());
     TMemBase MemInternal;
     if (FieldLocV[FieldId] == TStoreLoc::slDisk) {
         Blob = DataBlob;
@@ -4411,6 +5015,8 @@ void TStorePbBlob::GetRecData(const uint64& RecId, const int& FieldId, TMemBase&
 
 /// Set the value of given field to NULL
 void TStorePbBlob::SetFieldNull(const uint64& RecId, const int& FieldId) {
+    TFlushGuard FlushGuard(GetFlushLock());
+    TWalOp WalOp(this);
     // get the memory containig the field for the record
     TThinMIn min = GetEditableField(RecId, FieldId);
 
@@ -4421,9 +5027,12 @@ void TStorePbBlob::SetFieldNull(const uint64& RecId, const int& FieldId) {
     }
 
     FieldSerializator->SetFieldNull(min.GetBfAddrChar(), min.Len(), FieldId, true);
+    WalOp.SetField(this, RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldByte(const uint64& RecId, const int& FieldId, const uchar& Byte) {
+    TFlushGuard FlushGuard(GetFlushLock());
+    TWalOp WalOp(this);
     // get the memory containig the field for the record
     TThinMIn min = GetEditableField(RecId, FieldId);
 
@@ -4438,10 +5047,12 @@ void TStorePbBlob::SetFieldByte(const uint64& RecId, const int& FieldId, const u
 
     // index the new value in the updated memory buffer
     RecIndexer.IndexRecField(min.GetMemBase(), RecId, FieldId, *FieldSerializator);
-
+    WalOp.SetField(this, RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldInt(const uint64& RecId, const int& FieldId, const int& Int) {
+    TFlushGuard FlushGuard(GetFlushLock());
+    TWalOp WalOp(this);
     // special case if field is primary field
     if (FieldId == PrimaryFieldId) {
         // it is, make sure new value does not exist yet
@@ -4465,9 +5076,12 @@ void TStorePbBlob::SetFieldInt(const uint64& RecId, const int& FieldId, const in
     // index the new value in the updated memory buffer
     RecIndexer.IndexRecField(min.GetMemBase(), RecId, FieldId, *FieldSerializator);
     if (FieldId == PrimaryFieldId) { SetPrimaryFieldInt(RecId, Int); }
+    WalOp.SetField(this, RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldInt16(const uint64& RecId, const int& FieldId, const int16& Int16) {
+    TFlushGuard FlushGuard(GetFlushLock());
+    TWalOp WalOp(this);
     // get the memory containig the field for the record
     TThinMIn min = GetEditableField(RecId, FieldId);
 
@@ -4482,9 +5096,12 @@ void TStorePbBlob::SetFieldInt16(const uint64& RecId, const int& FieldId, const
 
     // index the new value in the updated memory buffer
     RecIndexer.IndexRecField(min.GetMemBase(), RecId, FieldId, *FieldSerializator);
+    WalOp.SetField(this, RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldInt64(const uint64& RecId, const int& FieldId, const int64& Int64) {
+    TFlushGuard FlushGuard(GetFlushLock());
+    TWalOp WalOp(this);
     // get the memory containig the field for the record
     TThinMIn min = GetEditableField(RecId, FieldId);
 
@@ -4499,9 +5116,12 @@ void TStorePbBlob::SetFieldInt64(const uint64& RecId, const int& FieldId, const
 
     // index the new value in the updated memory buffer
     RecIndexer.IndexRecField(min.GetMemBase(), RecId, FieldId, *FieldSerializator);
+    WalOp.SetField(this, RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldIntV(const uint64& RecId, const int& FieldId, const TIntV& IntV) {
+    TFlushGuard FlushGuard(GetFlushLock());
+    TWalOp WalOp(this);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     THash<TUInt64, TPgBlobPt>* RecIdBlobPtr = NULL;
     PPgBlob Blob; TPgBlobPt* PgPt = NULL;
@@ -4518,9 +5138,12 @@ void TStorePbBlob::SetFieldIntV(const uint64& RecId, const int& FieldId, const T
     // index new data
     RecIndexer.IndexRecField(mem_out, RecId, FieldId, *FieldSerializator);
     RecIdBlobPtr->GetDat(RecId) = Blob->Put(mem_out.GetBf(), mem_out.Len(), *PgPt);
+    WalOp.SetField(this, RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldUInt(const uint64& RecId, const int& FieldId, const uint& UInt) {
+    TFlushGuard FlushGuard(GetFlushLock());
+    TWalOp WalOp(this);
     // get the memory containig the field for the record
     TThinMIn min = GetEditableField(RecId, FieldId);
 
@@ -4535,9 +5158,12 @@ void TStorePbBlob::SetFieldUInt(const uint64& RecId, const int& FieldId, const u
 
     // index the new value in the updated memory buffer
     RecIndexer.IndexRecField(min.GetMemBase(), RecId, FieldId, *FieldSerializator);
+    WalOp.SetField(this, RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldUInt16(const uint64& RecId, const int& FieldId, const uint16& UInt16) {
+    TFlushGuard FlushGuard(GetFlushLock());
+    TWalOp WalOp(this);
     // get the memory containig the field for the record
     TThinMIn min = GetEditableField(RecId, FieldId);
 
@@ -4552,9 +5178,12 @@ void TStorePbBlob::SetFieldUInt16(const uint64& RecId, const int& FieldId, const
 
     // index the new value in the updated memory buffer
     RecIndexer.IndexRecField(min.GetMemBase(), RecId, FieldId, *FieldSerializator);
+    WalOp.SetField(this, RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldUInt64(const uint64& RecId, const int& FieldId, const uint64& UInt64) {
+    TFlushGuard FlushGuard(GetFlushLock());
+    TWalOp WalOp(this);
     // special case if field is primary field
     if (FieldId == PrimaryFieldId) {
         // it is, make sure new value does not exist yet
@@ -4579,10 +5208,13 @@ void TStorePbBlob::SetFieldUInt64(const uint64& RecId, const int& FieldId, const
     // index the new value in the updated memory buffer
     RecIndexer.IndexRecField(min.GetMemBase(), RecId, FieldId, *FieldSerializator);
     if (FieldId == PrimaryFieldId) { SetPrimaryFieldUInt64(RecId, UInt64); }
+    WalOp.SetField(this, RecId, FieldId);
 }
 
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldStr(const uint64& RecId, const int& FieldId, const TStr& Str) {
+    TFlushGuard FlushGuard(GetFlushLock());
+    TWalOp WalOp(this);
     // special case if field is primary field
     if (FieldId == PrimaryFieldId) {
         // it is, make sure new value does not exist yet
@@ -4611,9 +5243,12 @@ void TStorePbBlob::SetFieldStr(const uint64& RecId, const int& FieldId, const TS
         SetPrimaryFieldStr(RecId, Str);
     }
     RecIdBlobPtr->GetDat(RecId) = Blob->Put(mem_out.GetBf(), mem_out.Len(), *PgPt);
+    WalOp.SetField(this, RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldStrV(const uint64& RecId, const int& FieldId, const TStrV& StrV) {
+    TFlushGuard FlushGuard(GetFlushLock());
+    TWalOp WalOp(this);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     THash<TUInt64, TPgBlobPt>* RecIdBlobPtr = NULL;
     PPgBlob Blob; TPgBlobPt* PgPt = NULL;
@@ -4630,9 +5265,12 @@ void TStorePbBlob::SetFieldStrV(const uint64& RecId, const int& FieldId, const T
     // index new data
     RecIndexer.IndexRecField(mem_out, RecId, FieldId, *FieldSerializator);
     RecIdBlobPtr->GetDat(RecId) = Blob->Put(mem_out.GetBf(), mem_out.Len(), *PgPt);
+    WalOp.SetField(this, RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldBool(const uint64& RecId, const int& FieldId, const bool& Bool) {
+    TFlushGuard FlushGuard(GetFlushLock());
+    TWalOp WalOp(this);
     // get the memory containig the field for the record
     TThinMIn min = GetEditableField(RecId, FieldId);
 
@@ -4647,9 +5285,12 @@ void TStorePbBlob::SetFieldBool(const uint64& RecId, const int& FieldId, const b
 
     // index the new value in the updated memory buffer
     RecIndexer.IndexRecField(min.GetMemBase(), RecId, FieldId, *FieldSerializator);
+    WalOp.SetField(this, RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldFlt(const uint64& RecId, const int& FieldId, const double& Flt) {
+    TFlushGuard FlushGuard(GetFlushLock());
+    TWalOp WalOp(this);
     // special case if field is primary field
     if (FieldId == PrimaryFieldId) {
         // it is, make sure new value does not exist yet
@@ -4674,9 +5315,12 @@ void TStorePbBlob::SetFieldFlt(const uint64& RecId, const int& FieldId, const do
     // index the new value in the updated memory buffer
     RecIndexer.IndexRecField(min.GetMemBase(), RecId, FieldId, *FieldSerializator);
     if (FieldId == PrimaryFieldId) { SetPrimaryFieldFlt(RecId, Flt); }
+    WalOp.SetField(this, RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldSFlt(const uint64& RecId, const int& FieldId, const float& SFlt) {
+    TFlushGuard FlushGuard(GetFlushLock());
+    TWalOp WalOp(this);
     // get the memory containig the field for the record
     TThinMIn min = GetEditableField(RecId, FieldId);
 
@@ -4691,9 +5335,12 @@ void TStorePbBlob::SetFieldSFlt(const uint64& RecId, const int& FieldId, const f
 
     // index the new value in the updated memory buffer
     RecIndexer.IndexRecField(min.GetMemBase(), RecId, FieldId, *FieldSerializator);
+    WalOp.SetField(this, RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldFltPr(const uint64& RecId, const int& FieldId, const TFltPr& FltPr) {
+    TFlushGuard FlushGuard(GetFlushLock());
+    TWalOp WalOp(this);
     // get the memory containig the field for the record
     TThinMIn min = GetEditableField(RecId, FieldId);
 
@@ -4708,9 +5355,12 @@ void TStorePbBlob::SetFieldFltPr(const uint64& RecId, const int& FieldId, const
 
     // index the new value in the updated memory buffer
     RecIndexer.IndexRecField(min.GetMemBase(), RecId, FieldId, *FieldSerializator);
+    WalOp.SetField(this, RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldFltV(const uint64& RecId, const int& FieldId, const TFltV& FltV) {
+    TFlushGuard FlushGuard(GetFlushLock());
+    TWalOp WalOp(this);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     THash<TUInt64, TPgBlobPt>* RecIdBlobPtr = NULL;
     PPgBlob Blob; TPgBlobPt* PgPt = NULL;
@@ -4727,9 +5377,12 @@ void TStorePbBlob::SetFieldFltV(const uint64& RecId, const int& FieldId, const T
     // index new data
     RecIndexer.IndexRecField(mem_out, RecId, FieldId, *FieldSerializator);
     RecIdBlobPtr->GetDat(RecId) = Blob->Put(mem_out.GetBf(), mem_out.Len(), *PgPt);
+    WalOp.SetField(this, RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldTm(const uint64& RecId, const int& FieldId, const TTm& Tm) {
+    TFlushGuard FlushGuard(GetFlushLock());
+    TWalOp WalOp(this);
     // get the memory containig the field for the record
     TThinMIn min = GetEditableField(RecId, FieldId);
 
@@ -4744,9 +5397,12 @@ void TStorePbBlob::SetFieldTm(const uint64& RecId, const int& FieldId, const TTm
 
     // index the new value in the updated memory buffer
     RecIndexer.IndexRecField(min.GetMemBase(), RecId, FieldId, *FieldSerializator);
+    WalOp.SetField(this, RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldTmMSecs(const uint64& RecId, const int& FieldId, const uint64& TmMSecs) {
+    TFlushGuard FlushGuard(GetFlushLock());
+    TWalOp WalOp(this);
     // special case if field is primary field
     if (FieldId == PrimaryFieldId) {
         // it is, make sure new value does not exist yet
@@ -4771,9 +5427,12 @@ void TStorePbBlob::SetFieldTmMSecs(const uint64& RecId, const int& FieldId, cons
     // index the new value in the updated memory buffer
     RecIndexer.IndexRecField(min.GetMemBase(), RecId, FieldId, *FieldSerializator);
     if (FieldId == PrimaryFieldId) { SetPrimaryFieldMSecs(RecId, TmMSecs); }
+    WalOp.SetField(this, RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldNumSpV(const uint64& RecId, const int& FieldId, const TIntFltKdV& SpV) {
+    TFlushGuard FlushGuard(GetFlushLock());
+    TWalOp WalOp(this);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     THash<TUInt64, TPgBlobPt>* RecIdBlobPtr = NULL;
     PPgBlob Blob; TPgBlobPt* PgPt = NULL;
@@ -4790,9 +5449,12 @@ void TStorePbBlob::SetFieldNumSpV(const uint64& RecId, const int& FieldId, const
     // index new data
     RecIndexer.IndexRecField(mem_out, RecId, FieldId, *FieldSerializator);
     RecIdBlobPtr->GetDat(RecId) = Blob->Put(mem_out.GetBf(), mem_out.Len(), *PgPt);
+    WalOp.SetField(this, RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldBowSpV(const uint64& RecId, const int& FieldId, const PBowSpV& SpV) {
+    TFlushGuard FlushGuard(GetFlushLock());
+    TWalOp WalOp(this);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     THash<TUInt64, TPgBlobPt>* RecIdBlobPtr = NULL;
     PPgBlob Blob; TPgBlobPt* PgPt = NULL;
@@ -4809,9 +5471,12 @@ void TStorePbBlob::SetFieldBowSpV(const uint64& RecId, const int& FieldId, const
     // index new data
     RecIndexer.IndexRecField(mem_out, RecId, FieldId, *FieldSerializator);
     RecIdBlobPtr->GetDat(RecId) = Blob->Put(mem_out.GetBf(), mem_out.Len(), *PgPt);
+    WalOp.SetField(this, RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldTMem(const uint64& RecId, const int& FieldId, const TMem& Mem) {
+    TFlushGuard FlushGuard(GetFlushLock());
+    TWalOp WalOp(this);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     THash<TUInt64, TPgBlobPt>* RecIdBlobPtr = NULL;
     PPgBlob Blob; TPgBlobPt* PgPt = NULL;
@@ -4828,9 +5493,12 @@ void TStorePbBlob::SetFieldTMem(const uint64& RecId, const int& FieldId, const T
     // index new data
     RecIndexer.IndexRecField(mem_out, RecId, FieldId, *FieldSerializator);
     RecIdBlobPtr->GetDat(RecId) = Blob->Put(mem_out.GetBf(), mem_out.Len(), *PgPt);
+    WalOp.SetField(this, RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldJsonVal(const uint64& RecId, const int& FieldId, const PJsonVal& Json) {
+    TFlushGuard FlushGuard(GetFlushLock());
+    TWalOp WalOp(this);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     THash<TUInt64, TPgBlobPt>* RecIdBlobPtr = NULL;
     PPgBlob Blob; TPgBlobPt* PgPt = NULL;
@@ -4847,6 +5515,7 @@ void TStorePbBlob::SetFieldJsonVal(const uint64& RecId, const int& FieldId, cons
     // index new data
     RecIndexer.IndexRecField(mem_out, RecId, FieldId, *FieldSerializator);
     RecIdBlobPtr->GetDat(RecId) = Blob->Put(mem_out.GetBf(), mem_out.Len(), *PgPt);
+    WalOp.SetField(this, RecId, FieldId);
 }
 
 /// Check if given ID is valid
@@ -4890,6 +5559,7 @@ void TStorePbBlob::DelPrimaryField(const uint64& RecId) {
 
 /// Check if record with given name exists
 bool TStorePbBlob::IsRecNm(const TStr& RecNm) const {
+    TFlushGuard FlushGuard(GetFlushLock());
     return RecNmFieldP && PrimaryStrIdH.IsKey(RecNm);
 }
 
@@ -4903,6 +5573,7 @@ TStr TStorePbBlob::GetRecNm(const uint64& RecId) const {
 
 /// Return ID of record with given name
 uint64 TStorePbBlob::GetRecId(const TStr& RecNm) const {
+    TFlushGuard FlushGuard(GetFlushLock());
     return (PrimaryStrIdH.IsKey(RecNm) ? PrimaryStrIdH.GetDat(RecNm).Val : TUInt64::Mx);
 }
 
@@ -4971,12 +5642,20 @@ int TStorePbBlob::GetCodebookId(const int& FieldId, const TStr& Str) const {
 
 /// Save part of the data, given time-window
 int TStorePbBlob::PartialFlush(int WndInMsec) {
-    DataBlob->PartialFlush(WndInMsec);
-    return 0;
+    TFlushGuard FlushGuard(GetFlushLock());
+    const int slice = WndInMsec / 2;
+    return DataBlob->PartialFlush(slice) + DataMem->PartialFlush(slice);
+}
+
+/// Estimate of bytes written by flushing the store
+uint64 TStorePbBlob::GetDirtyBytes() {
+    TFlushGuard FlushGuard(GetFlushLock());
+    return DataBlob->GetDirtyBytes() + DataMem->GetDirtyBytes();
 }
 
 /// Retrieve performance statistics for this store
 PJsonVal TStorePbBlob::GetStats() {
+    TFlushGuard FlushGuard(GetFlushLock());
     PJsonVal res = TJsonVal::NewObj();
     res->AddToObj("name", GetStoreNm());
     res->AddToObj("blob_storage", DataBlob->GetStats());
@@ -4984,8 +5663,27 @@ PJsonVal TStorePbBlob::GetStats() {
     return res;
 }
 
+/// Change replacement policy of the page caches
+void TStorePbBlob::SetCachePolicy(const TCachePolicy& Policy) {
+    DataBlob->SetCachePolicy(Policy);
+    DataMem->SetCachePolicy(Policy);
+}
+
+/// Pages read until EndScan are evicted first
+void TStorePbBlob::StartScan() const {
+    DataBlob->StartScan();
+    DataMem->StartScan();
+}
+
+/// Close scan opened by StartScan
+void TStorePbBlob::EndScan() const {
+    DataBlob->EndScan();
+    DataMem->EndScan();
+}
+
 /// Run verification for whole store
 void TStorePbBlob::RunVerification() {
+    TFlushGuard FlushGuard(GetFlushLock());
     // loop over all pages
     this->DataMem->RunVerification();
     this->DataBlob->RunVerification();
@@ -4993,6 +5691,7 @@ void TStorePbBlob::RunVerification() {
 
 /// Run verification for single record
 void TStorePbBlob::RunVerificationForRecord(const uint64& RecId) {
+    TFlushGuard FlushGuard(GetFlushLock());
     // do nothing for now
     {
         const TPgBlobPt PgPt = RecIdBlobPtH.GetDat(RecId);
@@ -5012,6 +5711,9 @@ void TStorePbBlob::GarbageCollect() {
     if (WndDesc.WindowType == swtNone) { return; }
     // if no records, nothing to do here
     if (Empty()) { return; }
+    // writers on other threads must not append while we pick records to delete
+    TDeleteGuard DeleteGuard(GetSnapshotGate());
+    TFlushGuard FlushGuard(GetFlushLock());
     // TODO find records to delete
     // prepare list of records that need to be deleted
     TUInt64V DelRecIdV;
@@ -5070,7 +5772,12 @@ void TStorePbBlob::Defrag() {
 void TStorePbBlob::DeleteAllRecs() {
     // if no records, nothing to do here
     if (Empty()) { return; }
+    // open read snapshots must not see records disappear
+    TDeleteGuard DeleteGuard(GetSnapshotGate());
+    TWalOp WalOp(this);
+    WalOp.DeleteAllRecs();
     TEnv::Logger->OnStatusFmt("Deleting all (%d) records in %s", GetRecs(), GetStoreNm().CStr());
+    TFlushGuard FlushGuard(GetFlushLock());
 
     // delete records from index
     //for (uint64 DelRecId = GetFirstRecId(); DelRecId <= GetLastRecId(); DelRecId++) {
@@ -5133,6 +5840,8 @@ void TStorePbBlob::DeleteFirstRecs(const int& Recs) {
     if (RecCnt <= 0) {
         return;
     }
+    TWalOp WalOp(this);
+    WalOp.DeleteFirstRecs(Recs);
     TUInt64V RecIds(RecCnt, 0);
     for (int i = 0; i < RecCnt; i++) {
         RecIds.Add(RecSet->GetRecId(i));
@@ -5145,6 +5854,11 @@ void TStorePbBlob::DeleteFirstRecs(const int& Recs) {
 }
 
 void TStorePbBlob::DeleteRecs(const TUInt64V& DelRecIdV, const bool& AssertOK) {
+    // open read snapshots must not see records disappear
+    TDeleteGuard DeleteGuard(GetSnapshotGate());
+    TWalOp WalOp(this);
+    WalOp.DeleteRecs(DelRecIdV, AssertOK);
+    TFlushGuard FlushGuard(GetFlushLock());
     if (AssertOK) {
         // assert that DelRecIdV is valid
         THash<TUInt64, TPgBlobPt>* Ht = (DataMemP ? &RecIdBlobPtHMem : &RecIdBlobPtH);
@@ -5242,6 +5956,10 @@ void TStorePbBlob::InitFromSchema(const TStoreSchema& StoreSchema) {
             FieldId, WordVocId, IndexKeyEx.KeyType, IndexKeyEx.GixType, IndexKeyEx.SortType);
         // assign tokenizer to it if we have one
         if (IndexKeyEx.IsTokenizer()) { IndexVoc->PutTokenizer(KeyId, IndexKeyEx.Tokenizer); }
+        // create b-tree with non-default parameters right away, they are saved with it
+        if (IndexKeyEx.IsLinear() && IndexKeyEx.BTreeParam.IsCustom()) {
+            GetIndex()->NewBTreeIndex(KeyId, IndexKeyEx.SortType, IndexKeyEx.BTreeParam);
+        }
     }
     // prepare serializators for disk and in-memory store
     SerializatorCache = new TRecSerializator(this, this, StoreSchema, slDisk);
@@ -5276,7 +5994,8 @@ TStorePbBlob::TStorePbBlob(const TWPt<TBase>& Base, const uint& StoreId,
     TStore(Base, StoreId, StoreName), StoreFNm(_StoreFNm), FAccess(faCreate) {
 
     SetStoreType("TStorePbBlob");
-    DataBlob = new TPgBlob(_StoreFNm + "PgBlob", TFAccess::faCreate, _MxCacheSize);
+    QmAssertR(StoreSchema.SegmentSize == 0, "Window segments are not supported by paged stores");
+    DataBlob = new TPgBlob(_StoreFNm + "PgBlob", TFAccess::faCreate, _MxCacheSize, StoreSchema.PgBlobBackend);
     DataMem = new TPgBlob(_StoreFNm + "PgBlobMem", TFAccess::faCreate, TUInt64::Mx);
     InitFromSchema(StoreSchema);
     InitDataFlags();
@@ -5284,12 +6003,12 @@ TStorePbBlob::TStorePbBlob(const TWPt<TBase>& Base, const uint& StoreId,
 
 TStorePbBlob::TStorePbBlob(const TWPt<TBase>& Base, const TStr& _StoreFNm,
     const TFAccess& _FAccess, const int64& _MxCacheSize,
-    const bool& _Lazy) :
+    const bool& _Lazy, const TPgBlobBackend& Backend) :
     TStore(Base, _StoreFNm + ".BaseStore"),
     StoreFNm(_StoreFNm), FAccess(_FAccess), PrimaryFieldType(oftUndef) {
 
     SetStoreType("TStorePbBlob");
-    DataBlob = new TPgBlob(_StoreFNm + "PgBlob", _FAccess, _MxCacheSize);
+    DataBlob = new TPgBlob(_StoreFNm + "PgBlob", _FAccess, _MxCacheSize, Backend);
     DataMem = new TPgBlob(_StoreFNm + "PgBlobMem", _FAccess, TUInt64::Mx);
     if (!_Lazy) {
         DataMem->LoadAll();
@@ -5343,41 +6062,54 @@ TStorePbBlob::~TStorePbBlob() {
     // save if necessary
     if (FAccess != faRdOnly) {
         TEnv::Logger->OnStatus(TStr::Fmt("Saving store '%s'...", GetStoreNm().CStr()));
-        // save base store
-        TFOut BaseFOut(StoreFNm + ".BaseStore");
-        SaveStore(BaseFOut);
-        // save store parameters
-        TFOut FOut(StoreFNm + "PgBlobStore");
-        // save parameters about primary field
-        RecNmFieldP.Save(FOut);
-        PrimaryFieldId.Save(FOut);
-        if (PrimaryFieldType == oftInt) {
-            PrimaryIntIdH.Save(FOut);
-        } else if (PrimaryFieldType == oftUInt64) {
-            PrimaryUInt64IdH.Save(FOut);
-        } else if (PrimaryFieldType == oftFlt) {
-            PrimaryFltIdH.Save(FOut);
-        } else if (PrimaryFieldType == oftTm) {
-            PrimaryTmMSecsIdH.Save(FOut);
-        } else {
-            PrimaryStrIdH.Save(FOut);
-        }
-        // save time window
-        WndDesc.Save(FOut);
-        // save data
-        SerializatorCache->Save(FOut);
-        SerializatorMem->Save(FOut);
-
-        RecIdBlobPtH.Save(FOut);
-        RecIdBlobPtHMem.Save(FOut);
-        RecIdCounter.Save(FOut);
+        SaveParams();
     } else {
         TEnv::Logger->OnStatus("No saving of generic store " + GetStoreNm() + " neccessary!");
     }
 }
 
+void TStorePbBlob::SaveParams() {
+    // save base store
+    TFOut BaseFOut(StoreFNm + ".BaseStore");
+    SaveStore(BaseFOut);
+    // save store parameters
+    TFOut FOut(StoreFNm + "PgBlobStore");
+    // save parameters about primary field
+    RecNmFieldP.Save(FOut);
+    PrimaryFieldId.Save(FOut);
+    if (PrimaryFieldType == oftInt) {
+        PrimaryIntIdH.Save(FOut);
+    } else if (PrimaryFieldType == oftUInt64) {
+        PrimaryUInt64IdH.Save(FOut);
+    } else if (PrimaryFieldType == oftFlt) {
+        PrimaryFltIdH.Save(FOut);
+    } else if (PrimaryFieldType == oftTm) {
+        PrimaryTmMSecsIdH.Save(FOut);
+    } else {
+        PrimaryStrIdH.Save(FOut);
+    }
+    // save time window
+    WndDesc.Save(FOut);
+    // save data
+    SerializatorCache->Save(FOut);
+    SerializatorMem->Save(FOut);
+
+    RecIdBlobPtH.Save(FOut);
+    RecIdBlobPtHMem.Save(FOut);
+    RecIdCounter.Save(FOut);
+}
+
+void TStorePbBlob::Flush() {
+    QmAssertR(FAccess != faRdOnly, "Cannot flush store opened in read-only mode");
+    TFlushGuard FlushGuard(GetFlushLock());
+    SaveParams();
+    DataBlob->Flush();
+    DataMem->Flush();
+}
+
 /// Store value into internal storage using TOAST method
 TPgBlobPt TStorePbBlob::ToastVal(const TMemBase& Mem) {
+    TFlushGuard FlushGuard(GetFlushLock());
     TVec<TPgBlobPt> Pts;
     int BlockLen = DataBlob->GetMxBlobLen();
     int curr_index = 0;
@@ -5394,6 +6126,7 @@ TPgBlobPt TStorePbBlob::ToastVal(const TMemBase& Mem) {
 
 /// Retrieve value that is saved using TOAST method from storage
 void TStorePbBlob::UnToastVal(const TPgBlobPt& Pt, TMem& Mem) {
+    TFlushGuard FlushGuard(GetFlushLock());
     TVec<TPgBlobPt> Pts;
     TThinMIn MIn = DataBlob->Get(Pt);
     Pts.Load(MIn);
@@ -5406,6 +6139,7 @@ void TStorePbBlob::UnToastVal(const TPgBlobPt& Pt, TMem& Mem) {
 
 /// Delete TOAST-ed value from storage
 void TStorePbBlob::DelToastVal(const TPgBlobPt& Pt) {
+    TFlushGuard FlushGuard(GetFlushLock());
     TVec<TPgBlobPt> Pts;
     TThinMIn MIn = DataBlob->Get(Pt);
     Pts.Load(MIn);
@@ -5701,6 +6435,16 @@ TVec<TWPt<TStore> > CreateStoresFromSchema(const TWPt<TBase>& Base, const PJsonV
         }
     }
 
+    // new stores are not in the write-ahead log, checkpoint so they are part of the saved base
+    if (Base->IsWal()) {
+        for (int StoreN = 0; StoreN < NewStoreV.Len(); StoreN++) {
+            QmAssertR(NewStoreV[StoreN]->IsWalSupported(), "Store " +
+                NewStoreV[StoreN]->GetStoreNm() + " does not support write-ahead log");
+        }
+        SaveBase(Base);
+        Base->Checkpoint();
+    }
+
     // done
     return NewStoreV;
 }
@@ -5730,6 +6474,12 @@ TWPt<TBase> LoadBase(const TStr& FPath, const TFAccess& FAccess, const uint64& I
     const int& SplitLen) {
 
     InfoLog("Loading base created from schema definition");
+    // base was not closed, get it back to the last checkpoint before loading it
+    PWal RecoverWal;
+    if (TWal::Exists(FPath)) {
+        QmAssertR(FAccess != faRdOnly, "Base was not closed, open it in update mode to recover it");
+        RecoverWal = TWal::Rollback(FPath);
+    }
     TWPt<TBase> Base = TBase::Load(FPath, FAccess, IndexCacheSize, SplitLen);
     // load stores
     InfoLog("Loading stores");
@@ -5747,13 +6497,16 @@ TWPt<TBase> LoadBase(const TStr& FPath, const TFAccess& FAccess, const uint64& I
             StoreNmCacheSizeH.GetDat(StoreNm).Val : DefStoreCacheSize;
         PStore Store;
         if (StoreType == "TStorePbBlob") {
-            Store = new TStorePbBlob(Base, FPath + StoreNm, FAccess, StoreCacheSize);
+            const TPgBlobBackend Backend = TPgBlob::GetBackend(StoreVal->GetObjStr("backend", "cache"));
+            Store = new TStorePbBlob(Base, FPath + StoreNm, FAccess, StoreCacheSize, false, Backend);
         } else {
             Store = new TStoreImpl(Base, FPath + StoreNm, StoreCacheSize);
         }
         Base->AddStore(Store);
     }
     InfoLog("Stores loaded");
+    // repeat operations logged after the checkpoint
+    if (!RecoverWal.Empty()) { Base->Recover(RecoverWal); }
     // finish base initialization if so required (default is true)
     if (InitP) { Base->Init(); }
     // done
@@ -5775,6 +6528,10 @@ void SaveBase(const TWPt<TBase>& Base) {
             PJsonVal StoreVal = TJsonVal::NewObj();
             StoreVal->AddToObj("name", Store->GetStoreNm());
             StoreVal->AddToObj("type", Store->GetStoreType());
+            if (Store->GetStoreType() == "TStorePbBlob") {
+                const TStorePbBlob* PbBlobStore = dynamic_cast<const TStorePbBlob*>(Store());
+                StoreVal->AddToObj("backend", TPgBlob::GetBackendStr(PbBlobStore->GetBackend()));
+            }
             StoresVal->AddToArr(StoreVal);
         }
         PJsonVal RootVal = TJsonVal::NewObj("stores", StoresVal);
@@ -33,6 +33,8 @@ public:
     TBool CodebookP;
     /// Is small string?
     TBool SmallStringP;
+    /// Should be also kept in a columnar layout?
+    TBool ColumnarP;
     /// Default value if value not specified
     PJsonVal DefaultVal;
 public:
@@ -40,7 +42,7 @@ public:
     TFieldDescEx(const TStoreLoc& _FieldStoreLoc, const bool& _CodebookP,
         const bool& _SmallStringP, const PJsonVal& _DefaultVal = NULL):
             FieldStoreLoc(_FieldStoreLoc), CodebookP(_CodebookP),
-            SmallStringP(_SmallStringP), DefaultVal(_DefaultVal) { }
+            SmallStringP(_SmallStringP), ColumnarP(false), DefaultVal(_DefaultVal) { }
 };
 
 ///////////////////////////////
@@ -61,6 +63,8 @@ public:
     TStr WordVocName;
     /// Tokenizer (used by inverted index)
     PTokenizer Tokenizer;
+    /// B-tree parameters (used by linear index)
+    TBTreeIndexParam BTreeParam;
 
 public:
     TIndexKeyEx() {}
@@ -142,6 +146,9 @@ public:
     TBool HasStoreIdP;
     /// Window settings
     TStoreWndDesc WndDesc;
+    /// Size of window segments, in milliseconds for time windows and in records
+    /// for length windows (0 when records are not segmented)
+    TUInt64 SegmentSize;
     /// Field descriptions
     THash<TStr, TFieldDesc> FieldH;
     /// Extended field descriptions
@@ -154,6 +161,8 @@ public:
     TInt BlockSizeMem;
     /// What is the default storage location for fields and field-joins
     TStoreLoc DefaultFieldStoreLoc;
+    /// Page backend for disk storage of paged stores
+    TPgBlobBackend PgBlobBackend;
 private:
     /// Parse field description from JSon
     TFieldDesc ParseFieldDesc(const TWPt<TBase>& Base, const PJsonVal& FieldVal);
@@ -165,7 +174,7 @@ private:
     TIndexKeyEx ParseIndexKeyEx(const PJsonVal& IndexKeyVal);
 
 public:
-    TStoreSchema(): DefaultFieldStoreLoc(slMemory) { }
+    TStoreSchema(): DefaultFieldStoreLoc(slMemory), PgBlobBackend(pbbCache) { }
     TStoreSchema(const TWPt<TBase>& Base, const PJsonVal& StoreVal);
 
     /// Parse JSon definition file and return vector of store schemas
@@ -214,6 +223,8 @@ private:
     PBlobBs BlobStorage;
     /// How many records are packed together into block;
     TInt BlockSize;
+    /// Size of new and dirty values
+    TUInt64 DirtyBytes;
 
     /// Utility method for loading specific record
     inline void LoadRec(int64 RecN) const;
@@ -234,6 +245,9 @@ public:
 
     bool IsValId(const uint64& ValId) const;
     void GetVal(const uint64& ValId, TMem& Val) const;
+    /// Get reference to stored value without copying it. Reference is valid
+    /// until the storage is modified.
+    const TMem& GetValRef(const uint64& ValId) const;
     uint64 AddVal(const TMem& Val);
     void SetVal(const uint64& ValId, const TMem& Val);
     void DelVals(int Vals);
@@ -243,6 +257,10 @@ public:
     uint64 GetLastValId() const;
 
     int PartialFlush(int WndInMsec = 500);
+    /// Save all values and the value index, storage stays open
+    void Flush();
+    /// Size of values not saved yet
+    uint64 GetDirtyBytes() const { return DirtyBytes; }
     void LoadAll();
 
     TBlobBsStats GetBlobBsStats() { return BlobStorage->GetStats(); }
@@ -740,6 +758,8 @@ private:
     };
 
 private:
+    /// Indexed store
+    TWPt<TStore> Store;
     /// Index shortcut
     TWPt<TIndex> Index;
     /// Index vocabulary shortcut
@@ -772,6 +792,8 @@ public:
     void IndexRec(const TMemBase& RecMem, const uint64& RecId, TRecSerializator& Serializator);
     /// Deindex existing record
     void DeindexRec(const TMemBase& RecMem, const uint64& RecId, TRecSerializator& Serializator);
+    /// Deindex existing record from location and b-tree keys only
+    void DeindexRecTrees(const TMemBase& RecMem, const uint64& RecId, TRecSerializator& Serializator);
     /// Update index for existing record
     void UpdateRec(const TMemBase& OldRecMem, const TMemBase& NewRecMem,
         const uint64& RecId, const int& ChangedFieldId, TRecSerializator& Serializator);
@@ -867,6 +889,206 @@ public:
     void SetFieldJsonVal(const uint64& RecId, const int& FieldId, const PJsonVal& Json) { throw TQmExcept::New("TStoreEmpty does not store records"); };
 };
 
+///////////////////////////////
+/// Columnar layout of fixed-width fields.
+/// Keeps values of columnar fields for all records in contiguous typed vectors,
+/// indexed by record offset, so scans over one field are sequential memory sweeps
+/// instead of per-record deserialization. Serialized in-memory records remain the
+/// primary copy (used by indexing and for null flags); columns are refreshed from
+/// them on every write and hold 0 for null values.
+class TFieldColumns {
+private:
+    /// Record id of the value at position 0 in the columns
+    TUInt64 FirstRecId;
+    /// Number of values in each column
+    TInt64 Vals;
+    /// Number of values at the start of columns belonging to deleted records
+    TInt64 DelVals;
+    /// Columnar field ids
+    TIntV FieldIdV;
+    /// Types of columnar fields
+    TIntV FieldTypeV;
+    /// Map from field id to column position in vector of matching type (-1 when not columnar)
+    TIntV FieldColumnNV;
+    /// Columns for integer fields
+    TVec<TVec<TInt, int64> > IntColV;
+    /// Columns for float fields
+    TVec<TVec<TFlt, int64> > FltColV;
+    /// Columns for time fields, in milliseconds
+    TVec<TVec<TUInt64, int64> > TmColV;
+    /// Columns for byte and boolean fields
+    TVec<TVec<TUCh, int64> > ByteColV;
+
+    /// Position of record in the columns
+    int64 GetValN(const uint64& RecId) const { return (int64)(RecId - FirstRecId); }
+    /// Column position of field in the vector of matching type
+    int GetColumnN(const int& FieldId) const { return FieldColumnNV[FieldId]; }
+    /// Number of live values, checked to fit the int-indexed output vectors
+    int GetVals() const;
+    /// Set values of all columns at given position from serialized record
+    void SetVals(const int64& ValN, const TMemBase& RecMem, const TRecSerializator& Serializator);
+
+public:
+    TFieldColumns(): Vals(0), DelVals(0) { }
+    TFieldColumns(TSIn& SIn);
+    void Save(TSOut& SOut) const;
+
+    /// Check if field type can be stored in columnar layout
+    static bool IsFieldType(const TFieldType& FieldType);
+
+    /// Add column for given field
+    void AddField(const int& FieldId, const TFieldType& FieldType);
+    /// True when there are no columnar fields
+    bool Empty() const { return FieldIdV.Empty(); }
+    /// Check if given field has a column
+    bool IsField(const int& FieldId) const {
+        return (FieldId < FieldColumnNV.Len()) && (FieldColumnNV[FieldId] != -1); }
+
+    /// Append values of newly added record
+    void AddRec(const uint64& RecId, const TMemBase& RecMem, const TRecSerializator& Serializator);
+    /// Update values of existing record
+    void SetRec(const uint64& RecId, const TMemBase& RecMem, const TRecSerializator& Serializator);
+    /// Delete values for first Recs records
+    void DelRecs(const int64& Recs);
+    /// Delete all values
+    void Clr();
+
+    /// Get value of integer field
+    int GetInt(const int& FieldId, const uint64& RecId) const { return IntColV[GetColumnN(FieldId)][GetValN(RecId)]; }
+    /// Get value of float field
+    double GetFlt(const int& FieldId, const uint64& RecId) const { return FltColV[GetColumnN(FieldId)][GetValN(RecId)]; }
+    /// Get value of time field
+    uint64 GetTmMSecs(const int& FieldId, const uint64& RecId) const { return TmColV[GetColumnN(FieldId)][GetValN(RecId)]; }
+    /// Get value of byte or boolean field
+    uchar GetByte(const int& FieldId, const uint64& RecId) const { return ByteColV[GetColumnN(FieldId)][GetValN(RecId)]; }
+
+    /// Get values of integer field for given records
+    void GetIntV(const int& FieldId, const TUInt64V& RecIdV, TIntV& ValV) const;
+    /// Get values of float field for given records
+    void GetFltV(const int& FieldId, const TUInt64V& RecIdV, TFltV& ValV) const;
+    /// Get values of time field for given records
+    void GetTmMSecsV(const int& FieldId, const TUInt64V& RecIdV, TUInt64V& ValV) const;
+    /// Get values of byte or boolean field for given records
+    void GetByteV(const int& FieldId, const TUInt64V& RecIdV, TUChV& ValV) const;
+
+    /// Get values of integer field for all records
+    void GetIntV(const int& FieldId, TIntV& ValV) const;
+    /// Get values of float field for all records
+    void GetFltV(const int& FieldId, TFltV& ValV) const;
+    /// Get values of time field for all records
+    void GetTmMSecsV(const int& FieldId, TUInt64V& ValV) const;
+    /// Get values of byte or boolean field for all records
+    void GetByteV(const int& FieldId, TUChV& ValV) const;
+
+    /// Memory used by the columns
+    uint64 GetMemUsed() const;
+};
+
+///////////////////////////////
+/// Window segments of a store.
+/// Groups consecutive records into segments, either by time slots of the window
+/// time field or by number of records. Records of a segment share the expiry, so
+/// garbage collection drops whole segments, and the time span of each segment
+/// tells which segments a time range query has to look at.
+class TStoreSegments {
+private:
+    /// Consecutive records in one segment
+    class TSegment {
+    public:
+        /// Id of the first record in the segment
+        TUInt64 FirstRecId;
+        /// Number of records in the segment
+        TInt64 Recs;
+        /// Smallest and largest time of records in the segment
+        TUInt64 MinMSecs, MaxMSecs;
+        /// End of the time slot of the segment, records after it start a new one
+        TUInt64 EndMSecs;
+        /// True when some records in the segment have no time
+        TBool NullP;
+
+    public:
+        TSegment(): Recs(0) { }
+        TSegment(const uint64& _FirstRecId, const uint64& _EndMSecs): FirstRecId(_FirstRecId),
+            Recs(0), MinMSecs(TUInt64::Mx), EndMSecs(_EndMSecs), NullP(false) { }
+        TSegment(TSIn& SIn): FirstRecId(SIn), Recs(SIn), MinMSecs(SIn), MaxMSecs(SIn), EndMSecs(SIn), NullP(SIn) { }
+        void Save(TSOut& SOut) const { FirstRecId.Save(SOut); Recs.Save(SOut);
+            MinMSecs.Save(SOut); MaxMSecs.Save(SOut); EndMSecs.Save(SOut); NullP.Save(SOut); }
+    };
+
+    /// Segment size, in milliseconds for time windows and in records for length windows
+    TUInt64 SegmentSize;
+    /// True when segments are time slots
+    TBool TimeP;
+    /// Segments, oldest first
+    TVec<TSegment> SegmentV;
+
+public:
+    TStoreSegments(): TimeP(false) { }
+    TStoreSegments(const uint64& _SegmentSize, const bool& _TimeP):
+        SegmentSize(_SegmentSize), TimeP(_TimeP) { }
+    TStoreSegments(TSIn& SIn): SegmentSize(SIn), TimeP(SIn), SegmentV(SIn) { }
+    void Save(TSOut& SOut) const { SegmentSize.Save(SOut); TimeP.Save(SOut); SegmentV.Save(SOut); }
+
+    /// True when store is not segmented
+    bool Empty() const { return SegmentSize == 0; }
+    /// True when segments are time slots
+    bool IsTime() const { return TimeP; }
+    /// Number of segments
+    int GetSegments() const { return SegmentV.Len(); }
+    /// Number of records in the segment
+    uint64 GetSegmentRecs(const int& SegmentN) const { return (uint64)SegmentV[SegmentN].Recs.Val; }
+
+    /// Append newly added record, time is ignored for length windows
+    void AddRec(const uint64& RecId, const uint64& TmMSecs, const bool& NullP = false);
+    /// Delete first Recs records
+    void DelRecs(const int64& Recs);
+    /// Delete all segments
+    void Clr() { SegmentV.Clr(); }
+
+    /// Number of records in leading segments with all records older than given time
+    uint64 GetExpiredRecs(const uint64& WindowStartMSecs) const;
+    /// Number of records in leading segments which can be dropped so at least KeepRecs records remain
+    uint64 GetOverflowRecs(const uint64& KeepRecs) const;
+    /// Find segments which can have records inside the time range, as pairs of first and
+    /// last record id. Records of segments marked in FullV are all inside the range, others
+    /// must be checked one by one.
+    void GetRangeSegments(const uint64& MinMSecs, const uint64& MaxMSecs,
+        TVec<TUInt64Pr>& RecIdPrV, TBoolV& FullV) const;
+};
+
+///////////////////////////////
+/// Read-only view of serialized record.
+/// Points directly to the buffer inside in-memory storage or disk cache, so
+/// field values can be decoded without copying the record. When the record comes
+/// from the disk cache, the cache block is pinned for the lifetime of the view.
+/// View is invalidated by any update of the store.
+class TRecMemView : public TMemBase {
+private:
+    /// Pinned disk cache block holding the record (empty for in-memory records)
+    TWndBlockCache<TMem>::PBlockPin BlockPin;
+    /// Flush lock held while the view is used, the writer or the flusher can move
+    /// the record once it is released (NULL when locking is not required)
+    TFlushLock* FlushLock;
+
+    TRecMemView(const TRecMemView&);
+    TRecMemView& operator=(const TRecMemView&);
+
+public:
+    TRecMemView(): TMemBase(), FlushLock(NULL) { }
+    ~TRecMemView() { BlockPin.Clr(); if (FlushLock != NULL) { FlushLock->Leave(); } }
+
+    /// Hold flush lock, when active, until the view is destroyed
+    void Lock(const PFlushLock& _FlushLock) {
+        if (FlushLock == NULL && !_FlushLock.Empty() && _FlushLock->IsActive()) {
+            FlushLock = _FlushLock(); FlushLock->Enter(); }
+    }
+
+    /// Point view to the given buffer
+    void Set(const TMem& Mem) { Bf = Mem.GetBf(); BfL = MxBfL = Mem.Len(); Owner = false; }
+    /// Pin for disk cache block
+    TWndBlockCache<TMem>::PBlockPin& GetBlockPin() { return BlockPin; }
+};
+
 ///////////////////////////////
 /// Implementation of store which can be initialized from a schema.
 class TStoreImpl : public TStore, public TToaster {
@@ -916,6 +1138,10 @@ private:
     TRecSerializator *SerializatorMem;
     /// Map from fields to storage location
     TVec<TStoreLoc> FieldLocV;
+    /// Columnar layout of in-memory fields marked as columnar
+    TFieldColumns Columns;
+    /// Window segments (empty when store is not segmented)
+    TStoreSegments Segments;
 
     // record indexer
     TRecIndexer RecIndexer;
@@ -926,6 +1152,8 @@ private:
     void GetRecMem(const TStoreLoc& RecLoc, const uint64& RecId, TMem& Rec) const;
     /// Get TMem serialization of record from specified where field is stored
     void GetRecMem(const uint64& RecId, const int& FieldId, TMem& Rec) const;
+    /// Get read-only view of record serialization from storage where field is stored
+    void GetRecMemView(const uint64& RecId, const int& FieldId, TRecMemView& RecView) const;
     /// Set TMem serialization of record to a specified storage
     void PutRecMem(const TStoreLoc& RecLoc, const uint64& RecId, const TMem& Rec);
     /// Set TMem serialization of record to storage where field is stored
@@ -975,8 +1203,17 @@ private:
 
     /// Initialize from given store schema
     void InitFromSchema(const TStoreSchema& StoreSchema);
+    /// Initialize columns for fields with columnar layout
+    void InitColumns(const TStoreSchema& StoreSchema);
     /// Initialize field location flags
     void InitDataFlags();
+    /// Save store parameters, primary field maps, columns and segments
+    void SaveParams();
+    /// Delete first records, which fill whole segments, dropping their index entries in bulk
+    void DeleteSegmentRecs(const int& DelRecs);
+    /// Delete given first records of the store. When SegmentP is set, inverted index
+    /// entries are deleted in bulk and only location and b-tree keys record by record.
+    void DeleteFirstRecIds(const TUInt64V& DelRecIdV, const bool& SegmentP);
 
 public:
     TStoreImpl(const TWPt<TBase>& _Base, const uint& StoreId,
@@ -1015,6 +1252,8 @@ public:
     bool HasFirstRecId() const { return true; }
     /// Is the last record id getter implemented?
     bool HasLastRecId() const { return true; }
+    /// Records are kept in a vector, so their ids are consecutive
+    bool HasRecIdRange() const { return true; }
 
     /// Add new record
     uint64 AddRec(const PJsonVal& RecVal, const bool& TriggerEvents = true);
@@ -1029,6 +1268,11 @@ public:
     void DeleteFirstRecs(const int& Recs);
     /// Delete specific record
     void DeleteRecs(const TUInt64V& DelRecIdV, const bool& AssertOK = true);
+    /// True when records are grouped into time segments of the given field
+    bool IsSegmentField(const int& FieldId) const;
+    /// Get sorted ids of records with time in the range from the overlapping segments
+    void SearchSegments(const int& FieldId, const uint64& MinMSecs,
+        const uint64& MaxMSecs, TUInt64V& RecIdV) const;
 
     /// Check if the value of given field for a given record is NULL
     bool IsFieldNull(const uint64& RecId, const int& FieldId) const;
@@ -1075,6 +1319,25 @@ public:
     /// Get field value using field id (default implementation throws exception)
     PJsonVal GetFieldJsonVal(const uint64& RecId, const int& FieldId) const;
 
+    /// Is field stored also in columnar layout
+    bool IsFieldColumnar(const int& FieldId) const { return Columns.IsField(FieldId); }
+    /// Get values of integer field for given records
+    void GetColumnInt(const int& FieldId, const TUInt64V& RecIdV, TIntV& ValV) const;
+    /// Get values of float field for given records
+    void GetColumnFlt(const int& FieldId, const TUInt64V& RecIdV, TFltV& ValV) const;
+    /// Get values of time field for given records
+    void GetColumnTmMSecs(const int& FieldId, const TUInt64V& RecIdV, TUInt64V& ValV) const;
+    /// Get values of byte or boolean field for given records
+    void GetColumnByte(const int& FieldId, const TUInt64V& RecIdV, TUChV& ValV) const;
+    /// Get values of integer field for all records
+    void GetColumnInt(const int& FieldId, TIntV& ValV) const;
+    /// Get values of float field for all records
+    void GetColumnFlt(const int& FieldId, TFltV& ValV) const;
+    /// Get values of time field for all records
+    void GetColumnTmMSecs(const int& FieldId, TUInt64V& ValV) const;
+    /// Get values of byte or boolean field for all records
+    void GetColumnByte(const int& FieldId, TUChV& ValV) const;
+
     /// Get field value using field id safely (default implementation throws exception)
     uint64 GetFieldUInt64Safe(const uint64& RecId, const int& FieldId) const;
     /// Get field value using field id safely (default implementation throws exception)
@@ -1137,12 +1400,29 @@ public:
 
     /// Save part of the data, given time-window
     int PartialFlush(int WndInMsec = 500);
+    /// Save all data, store stays open
+    void Flush();
+    /// Records are stored in blob files, changes to them are covered by the log journal
+    bool IsWalSupported() const { return true; }
+    /// Estimate of bytes written by flushing the store
+    uint64 GetDirtyBytes();
     /// Retrieve performance statistics for this store
     PJsonVal GetStats();
+    /// Change replacement policy of the record block cache
+    void SetCachePolicy(const TCachePolicy& Policy) { DataCache.SetCachePolicy(Policy); }
+    /// Blocks read until EndScan are dropped from the cache first
+    void StartScan() const { DataCache.StartScan(); }
+    /// Close scan opened by StartScan
+    void EndScan() const { DataCache.EndScan(); }
     /// Run verification for whole store
     void RunVerification();
     /// Run verification for single record
     void RunVerificationForRecord(const uint64& RecId);
+
+#ifdef XTEST
+private:
+    friend class XTest;
+#endif
 };
 
 ///////////////////////////////
@@ -1233,6 +1513,8 @@ private:
     void InitFromSchema(const TStoreSchema& StoreSchema);
     /// Initialize field location flags
     void InitDataFlags();
+    /// Save store parameters and record maps
+    void SaveParams();
 
     /// Do we have a primary field
     bool IsPrimaryField() const { return PrimaryFieldId != -1; }
@@ -1273,10 +1555,13 @@ public:
         const TStr& _StoreFNm, const int64& _MxCacheSize, const int& BlockSize);
     TStorePbBlob(const TWPt<TBase>& _Base, const TStr& _StoreFNm,
         const TFAccess& _FAccess, const int64& _MxCacheSize,
-        const bool& _Lazy = false);
+        const bool& _Lazy = false, const TPgBlobBackend& Backend = pbbCache);
     // need to override destructor, to clear cache
     ~TStorePbBlob();
 
+    /// Page backend used for disk storage
+    TPgBlobBackend GetBackend() const { return DataBlob->GetBackend(); }
+
     /// True when records have names (default is false)
     bool HasRecNm() const { return RecNmFieldP; }
     /// Check if given ID is valid
@@ -1420,8 +1705,20 @@ public:
 
     /// Save part of the data, given time-window
     int PartialFlush(int WndInMsec = 500);
+    /// Save all data, store stays open
+    void Flush();
+    /// Log journal does not see changes to memory mapped pages
+    bool IsWalSupported() const { return GetBackend() != pbbMmap; }
+    /// Estimate of bytes written by flushing the store
+    uint64 GetDirtyBytes();
     /// Retrieve performance statistics for this store
     PJsonVal GetStats();
+    /// Change replacement policy of the page caches
+    void SetCachePolicy(const TCachePolicy& Policy);
+    /// Pages read until EndScan are evicted first
+    void StartScan() const;
+    /// Close scan opened by StartScan
+    void EndScan() const;
     /// Run verification for whole store
     void RunVerification();
     /// Run verification for single record
@@ -239,3 +239,40 @@ TEST(TQQueueTest, Shuffle) {
         throw Except;
     }
 }
+
+TEST(TQQueueTest, PopBack) {
+    TQQueue<TInt> Q;
+    // move the front so the back wraps around the end of the buffer
+    for (int i = 0; i < 15; i++) { Q.Push(i); }
+    for (int i = 0; i < 10; i++) { Q.Pop(); }
+    for (int i = 15; i < 21; i++) { Q.Push(i); }
+    ASSERT_EQ(Q.Len(), 11);
+    ASSERT_EQ(Q.Front(), 10);
+    ASSERT_EQ(Q.Back(), 20);
+    // use as a double-ended queue
+    while (Q.Back() > 12) { Q.PopBack(); }
+    ASSERT_EQ(Q.Len(), 3);
+    ASSERT_EQ(Q.Front(), 10);
+    ASSERT_EQ(Q.Back(), 12);
+    Q.Push(30);
+    ASSERT_EQ(Q.Back(), 30);
+    ASSERT_EQ(Q[3], 30);
+    Q.PopBack(); Q.PopBack(); Q.PopBack(); Q.PopBack();
+    ASSERT_TRUE(Q.Empty());
+}
+
+TEST(TQQueueTest, ClrKeepSpace) {
+    TQQueue<TInt> Q;
+    for (int i = 0; i < 100; i++) { Q.Push(i); }
+    for (int i = 0; i < 50; i++) { Q.Pop(); }
+    // queue is reused from the start of the kept space
+    Q.Clr(false);
+    ASSERT_TRUE(Q.Empty());
+    ASSERT_EQ(Q.Len(), 0);
+    for (int i = 0; i < 100; i++) { Q.Push(i); }
+    ASSERT_EQ(Q.Len(), 100);
+    ASSERT_EQ(Q.Front(), 0);
+    ASSERT_EQ(Q.Back(), 99);
+    Q.Clr();
+    ASSERT_TRUE(Q.Empty());
+}
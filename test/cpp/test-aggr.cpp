@@ -13,6 +13,8 @@
 // Google Test
 #include "gtest/gtest.h"
 
+#include "test-qminer.h"
+
 #ifdef WIN32
 #ifdef _DEBUG
 #define DEBUG_NEW new(_NORMAL_BLOCK, __FILE__, __LINE__)
@@ -24,24 +26,24 @@
 
 TEST(TSlottedHistogramTest, Simple1) {
 	try {
-		TQm::TStreamAggrs::PSlottedHistogram obj = TQm::TStreamAggrs::TSlottedHistogram::New(20, 2, 3);
+		TSignalProc::TSlottedHistogram obj(20, 2, 3);
 
-		obj->Add(1, 0); // slot 0
-		obj->Add(7, 0); // slot 3
-		obj->Add(12, 1); // slot 6
-		obj->Add(18, 0); // slot 9
-		obj->Add(22, 1); // slot 1
-		obj->Add(38, 0); // slot 9
+		obj.Add(1, 0); // slot 0
+		obj.Add(7, 0); // slot 3
+		obj.Add(12, 1); // slot 6
+		obj.Add(18, 0); // slot 9
+		obj.Add(22, 1); // slot 1
+		obj.Add(38, 0); // slot 9
 
 		TFltV Stats;
-		obj->GetStats(41, 45, Stats); // slots from 0 to 2 inclusive
+		obj.GetStats(41, 45, Stats); // slots from 0 to 2 inclusive
 		
 		ASSERT_EQ(Stats.Len(), 3);
 		ASSERT_EQ(Stats[0], 1.0);
 		ASSERT_EQ(Stats[1], 1.0);
 		ASSERT_EQ(Stats[2], 0.0);
 
-		obj->GetStats(45, 47, Stats);
+		obj.GetStats(45, 47, Stats);
 
 		ASSERT_EQ(Stats.Len(), 3);
 		ASSERT_EQ(Stats[0], 1.0);
@@ -56,24 +58,24 @@ TEST(TSlottedHistogramTest, Simple1) {
 
 TEST(TSlottedHistogramTest, Simple2) {
 	try {
-		TQm::TStreamAggrs::PSlottedHistogram obj = TQm::TStreamAggrs::TSlottedHistogram::New(20, 5, 3);
+		TSignalProc::TSlottedHistogram obj(20, 5, 3);
 
-		obj->Add(1, 0); // slot 0
-		obj->Add(7, 0); // slot 1
-		obj->Add(12, 1); // slot 2
-		obj->Add(18, 0); // slot 3
-		obj->Add(22, 1); // slot 0
-		obj->Add(38, 0); // slot 3
+		obj.Add(1, 0); // slot 0
+		obj.Add(7, 0); // slot 1
+		obj.Add(12, 1); // slot 2
+		obj.Add(18, 0); // slot 3
+		obj.Add(22, 1); // slot 0
+		obj.Add(38, 0); // slot 3
 
 		TFltV Stats;
-		obj->GetStats(41, 45, Stats); // slots from 0 to 1 inclusive
+		obj.GetStats(41, 45, Stats); // slots from 0 to 1 inclusive
 
 		ASSERT_EQ(Stats.Len(), 3);
 		ASSERT_EQ(Stats[0], 2.0);
 		ASSERT_EQ(Stats[1], 1.0);
 		ASSERT_EQ(Stats[2], 0.0);
 
-		obj->GetStats(45, 47, Stats); // slots from 1 to 1 inclusive
+		obj.GetStats(45, 47, Stats); // slots from 1 to 1 inclusive
 
 		ASSERT_EQ(Stats.Len(), 3);
 		ASSERT_EQ(Stats[0], 1.0);
@@ -96,18 +98,616 @@ TEST(TSlottedHistogramTest, Simple2) {
 
 		TQm::TStreamAggrs::TTDigest* obj = new TQm::TStreamAggrs::TTDigest::New(Quantiles);
 
-		obj->Add(1);
-		obj->Add(2);
-		obj->Add(3);
-		obj->Add(4);
-		obj->Add(5);
-		obj->Add(6);
-		obj->Add(7);
-		obj->Add(8);
-		obj->Add(9);
+		obj.Add(1);
+		obj.Add(2);
+		obj.Add(3);
+		obj.Add(4);
+		obj.Add(5);
+		obj.Add(6);
+		obj.Add(7);
+		obj.Add(8);
+		obj.Add(9);
 
 	} catch (PExcept& Except) {
 		printf("Error: %s", Except->GetStr());
 		throw Except;
 	}
 }*/
+
+///////////////////////////////////////////////////////////////////////////////
+// Stream aggregate set
+
+namespace {
+
+const TStr AggrTestFPath = "./data/aggr/";
+
+/// Base with two stores of the same time series, one fed by records and one by batches
+TWPt<TQm::TBase> NewAggrBase() {
+	TStr FieldStr = "\"fields\": ["
+		"  { \"name\": \"Time\", \"type\": \"datetime\" },"
+		"  { \"name\": \"X\", \"type\": \"float\" },"
+		"  { \"name\": \"Y\", \"type\": \"float\" }]";
+	return TQmTest::NewBase(AggrTestFPath, TJsonVal::GetValFromStr(
+		"[{ \"name\": \"Rec\", " + FieldStr + " }, { \"name\": \"Batch\", " + FieldStr + " }]"),
+		16 * 1024 * 1024, 16 * 1024 * 1024);
+}
+
+/// Create aggregate with name StoreNm + AggrNm and attach it to the store
+void AddAggr(const TWPt<TQm::TBase>& Base, const TStr& StoreNm, const TStr& TypeNm, const TStr& AggrNm, const TStr& ParamStr) {
+	// $ in parameters stands for the store name
+	TStr InParamStr = ParamStr; InParamStr.ChangeStrAll("$", StoreNm);
+	TStr JsonStr = "{ \"name\": \"" + StoreNm + AggrNm + "\", \"store\": \"" + StoreNm + "\", "
+		"\"timestamp\": \"Time\", " + InParamStr + " }";
+	TQm::PStreamAggr StreamAggr = TQm::TStreamAggr::New(Base, TypeNm, TJsonVal::GetValFromStr(JsonStr));
+	Base->AddStreamAggr(StreamAggr);
+	Base->GetStreamAggrSet(Base->GetStoreByStoreNm(StoreNm)->GetStoreId())->AddStreamAggr(StreamAggr);
+}
+
+/// Names of the aggregates with numeric output created by AddAggrChain
+const char* AggrChainNmV[] = { "TickX", "MaX", "VarX", "VarY", "MinX", "MaxX", "Cov", "Corr", "EmaX", "SumX", "AboveX" };
+
+/// Typical chain of aggregates over two time series
+void AddAggrChain(const TWPt<TQm::TBase>& Base, const TStr& StoreNm) {
+	AddAggr(Base, StoreNm, "timeSeriesTick", "TickX", "\"value\": \"X\"");
+	AddAggr(Base, StoreNm, "timeSeriesTick", "TickY", "\"value\": \"Y\"");
+	AddAggr(Base, StoreNm, "timeSeriesWinBufVector", "BufX", "\"inAggr\": \"$TickX\", \"winsize\": 5000");
+	AddAggr(Base, StoreNm, "timeSeriesWinBufVector", "BufY", "\"inAggr\": \"$TickY\", \"winsize\": 5000");
+	AddAggr(Base, StoreNm, "ma", "MaX", "\"inAggr\": \"$BufX\"");
+	AddAggr(Base, StoreNm, "variance", "VarX", "\"inAggr\": \"$BufX\"");
+	AddAggr(Base, StoreNm, "variance", "VarY", "\"inAggr\": \"$BufY\"");
+	AddAggr(Base, StoreNm, "winBufMin", "MinX", "\"inAggr\": \"$BufX\"");
+	AddAggr(Base, StoreNm, "winBufMax", "MaxX", "\"inAggr\": \"$BufX\"");
+	AddAggr(Base, StoreNm, "covariance", "Cov", "\"inAggrX\": \"$BufX\", \"inAggrY\": \"$BufY\"");
+	AddAggr(Base, StoreNm, "correlation", "Corr", "\"inAggrCov\": \"$Cov\", \"inAggrVarX\": \"$VarX\", \"inAggrVarY\": \"$VarY\"");
+	AddAggr(Base, StoreNm, "ema", "EmaX", "\"inAggr\": \"$TickX\", \"emaType\": \"previous\", \"interval\": 3000");
+	AddAggr(Base, StoreNm, "timeSeriesWinBuf", "WinX", "\"value\": \"X\", \"winsize\": 3000, \"delay\": 1000");
+	AddAggr(Base, StoreNm, "winBufSum", "SumX", "\"inAggr\": \"$WinX\"");
+	AddAggr(Base, StoreNm, "threshold", "AboveX", "\"inAggr\": \"$MaX\", \"threshold\": 0.5");
+}
+
+/// Records with random gaps between timestamps
+PJsonVal GetAggrRecs(const int& Recs, TRnd& Rnd, uint64& TmMSecs) {
+	PJsonVal RecValV = TJsonVal::NewArr();
+	for (int RecN = 0; RecN < Recs; RecN++) {
+		TmMSecs += Rnd.GetUniDevInt(1000);
+		PJsonVal RecVal = TJsonVal::NewObj();
+		RecVal->AddToObj("Time", TTm::GetTmFromMSecs(TmMSecs).GetWebLogDateTimeStr(true, "T"));
+		RecVal->AddToObj("X", Rnd.GetUniDev());
+		RecVal->AddToObj("Y", Rnd.GetUniDev());
+		RecValV->AddToArr(RecVal);
+	}
+	return RecValV;
+}
+
+void CheckSameAggrChain(const TWPt<TQm::TBase>& Base) {
+	for (const char* AggrNm : AggrChainNmV) {
+		TWPt<TQm::TStreamAggrOut::IFlt> RecAggr =
+			dynamic_cast<TQm::TStreamAggrOut::IFlt*>(Base->GetStreamAggr(TStr("Rec") + AggrNm)());
+		TWPt<TQm::TStreamAggrOut::IFlt> BatchAggr =
+			dynamic_cast<TQm::TStreamAggrOut::IFlt*>(Base->GetStreamAggr(TStr("Batch") + AggrNm)());
+		EXPECT_EQ(RecAggr->GetFlt(), BatchAggr->GetFlt()) << AggrNm;
+	}
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Batches of records
+
+TEST(TStreamAggrSet, AddRecBatch) {
+	TWPt<TQm::TBase> Base = NewAggrBase();
+	TWPt<TQm::TStore> RecStore = Base->GetStoreByStoreNm("Rec");
+	TWPt<TQm::TStore> BatchStore = Base->GetStoreByStoreNm("Batch");
+	AddAggrChain(Base, "Rec");
+	AddAggrChain(Base, "Batch");
+	TWPt<TQm::TStreamAggrSet> BatchAggrSet = Base->GetStreamAggrSet(BatchStore->GetStoreId());
+	// chain is processed one aggregate after another
+	EXPECT_TRUE(BatchAggrSet->IsBatchOrder());
+	TRnd Rnd(1); uint64 TmMSecs = TTm::GetMSecsFromTm(TTm(2015, 6, 10, -1, 14));
+	const int BatchLenV[] = { 1, 2, 7, 50, 1, 300, 13 };
+	for (int Pass = 0; Pass < 2; Pass++) {
+		for (const int BatchLen : BatchLenV) {
+			PJsonVal RecValV = GetAggrRecs(BatchLen, Rnd, TmMSecs);
+			for (int RecN = 0; RecN < RecValV->GetArrVals(); RecN++) {
+				RecStore->AddRec(RecValV->GetArrVal(RecN));
+			}
+			TUInt64V RecIdV; BatchStore->AddRecBatch(RecValV, RecIdV);
+			// same results as record by record
+			CheckSameAggrChain(Base);
+		}
+		// aggregate without batch support falls back to passing records one by one
+		if (Pass == 0) {
+			AddAggr(Base, "Rec", "recordBuffer", "RecBuf", "\"size\": 3");
+			AddAggr(Base, "Batch", "recordBuffer", "RecBuf", "\"size\": 3");
+			EXPECT_FALSE(BatchAggrSet->IsBatchOrder());
+		}
+	}
+	EXPECT_EQ(RecStore->GetRecs(), BatchStore->GetRecs());
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TStreamAggrSet, AddRecBatchThreads) {
+	TWPt<TQm::TBase> Base = NewAggrBase();
+	TWPt<TQm::TStore> RecStore = Base->GetStoreByStoreNm("Rec");
+	TWPt<TQm::TStore> BatchStore = Base->GetStoreByStoreNm("Batch");
+	AddAggrChain(Base, "Rec");
+	AddAggrChain(Base, "Batch");
+	Base->SetStreamAggrThreads(4);
+	TWPt<TQm::TStreamAggrSet> BatchAggrSet = Base->GetStreamAggrSet(BatchStore->GetStoreId());
+	EXPECT_EQ(4, BatchAggrSet->GetThreads());
+	// ticks and window without inputs, then buffers, then their statistics, then correlation and threshold
+	const TVec<TIntV>& LevelV = BatchAggrSet->GetLevelV();
+	ASSERT_EQ(4, LevelV.Len());
+	EXPECT_EQ(3, LevelV[0].Len());
+	EXPECT_EQ(4, LevelV[1].Len());
+	EXPECT_EQ(6, LevelV[2].Len());
+	EXPECT_EQ(2, LevelV[3].Len());
+	TRnd Rnd(1); uint64 TmMSecs = TTm::GetMSecsFromTm(TTm(2015, 6, 10, -1, 14));
+	const int BatchLenV[] = { 1, 2, 7, 50, 1, 300, 13 };
+	for (const int BatchLen : BatchLenV) {
+		PJsonVal RecValV = GetAggrRecs(BatchLen, Rnd, TmMSecs);
+		for (int RecN = 0; RecN < RecValV->GetArrVals(); RecN++) {
+			RecStore->AddRec(RecValV->GetArrVal(RecN));
+		}
+		TUInt64V RecIdV; BatchStore->AddRecBatch(RecValV, RecIdV);
+		// same results as record by record
+		CheckSameAggrChain(Base);
+	}
+	// concurrent reads are only on while the batch is processed
+	EXPECT_FALSE(Base->IsConcurrentReads());
+	// new stores use the same number of threads
+	TQm::TStorage::CreateStoresFromSchema(Base, TJsonVal::GetValFromStr("[{ \"name\": \"Later\", "
+		"\"fields\": [{ \"name\": \"X\", \"type\": \"float\" }] }]"), 16 * 1024 * 1024);
+	EXPECT_EQ(4, Base->GetStreamAggrSet(Base->GetStoreByStoreNm("Later")->GetStoreId())->GetThreads());
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TStreamAggrSet, ParallelExcept) {
+	// any exception from a parallel task is kept and thrown after the region
+	for (int FailN = 0; FailN < 3; FailN++) {
+		TQm::TParallelExcept ParallelExcept(8);
+		#pragma omp parallel for num_threads(4)
+		for (int TaskN = 0; TaskN < 8; TaskN++) {
+			ParallelExcept.Run(TaskN, [&]() {
+				if (TaskN != 5) { return; }
+				if (FailN == 0) { throw TExcept::New("failed"); }
+				if (FailN == 1) { throw std::bad_alloc(); }
+				throw 1;
+			});
+		}
+		EXPECT_THROW(ParallelExcept.Throw(), PExcept);
+	}
+	TQm::TParallelExcept ParallelExcept(2);
+	ParallelExcept.Run(0, []() { });
+	EXPECT_NO_THROW(ParallelExcept.Throw());
+}
+
+TEST(TStreamAggrSet, DISABLED_AddRecBatchPerf) {
+	TWPt<TQm::TBase> Base = NewAggrBase();
+	TWPt<TQm::TStore> RecStore = Base->GetStoreByStoreNm("Rec");
+	TWPt<TQm::TStore> BatchStore = Base->GetStoreByStoreNm("Batch");
+	AddAggrChain(Base, "Rec");
+	AddAggrChain(Base, "Batch");
+	// same records in both stores, without triggers
+	const int Recs = 100000, BatchLen = 1000;
+	TRnd Rnd(1); uint64 TmMSecs = TTm::GetMSecsFromTm(TTm(2015, 6, 10, -1, 14));
+	PJsonVal RecValV = GetAggrRecs(Recs, Rnd, TmMSecs);
+	for (int RecN = 0; RecN < Recs; RecN++) {
+		RecStore->AddRec(RecValV->GetArrVal(RecN), false);
+		BatchStore->AddRec(RecValV->GetArrVal(RecN), false);
+	}
+	// push them through the aggregates
+	TTmStopWatch RecSw(true);
+	for (uint64 RecId = 0; RecId < (uint64)Recs; RecId++) {
+		RecStore->OnAdd(RecId);
+	}
+	RecSw.Stop();
+	TTmStopWatch BatchSw(true);
+	for (uint64 RecId = 0; RecId < (uint64)Recs; RecId += BatchLen) {
+		TUInt64V RecIdV(BatchLen, 0);
+		for (int RecN = 0; RecN < BatchLen; RecN++) { RecIdV.Add(RecId + RecN); }
+		BatchStore->OnAddBatch(RecIdV);
+	}
+	BatchSw.Stop();
+	printf("%d records through %d aggregates: one by one %d ms, batches of %d %d ms\n", Recs,
+		Base->GetStreamAggrSet(RecStore->GetStoreId())->Len(), RecSw.GetMSecInt(), BatchLen, BatchSw.GetMSecInt());
+	CheckSameAggrChain(Base);
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TStreamAggrSet, DISABLED_AddRecBatchThreadsPerf) {
+	TWPt<TQm::TBase> Base = NewAggrBase();
+	TWPt<TQm::TStore> RecStore = Base->GetStoreByStoreNm("Rec");
+	TWPt<TQm::TStore> BatchStore = Base->GetStoreByStoreNm("Batch");
+	AddAggrChain(Base, "Rec");
+	AddAggrChain(Base, "Batch");
+	// same batches through aggregates on one and on four threads
+	const int Threads = 4;
+	Base->GetStreamAggrSet(BatchStore->GetStoreId())->SetThreads(Threads);
+	const int Recs = 100000, BatchLen = 1000;
+	TRnd Rnd(1); uint64 TmMSecs = TTm::GetMSecsFromTm(TTm(2015, 6, 10, -1, 14));
+	PJsonVal RecValV = GetAggrRecs(Recs, Rnd, TmMSecs);
+	for (int RecN = 0; RecN < Recs; RecN++) {
+		RecStore->AddRec(RecValV->GetArrVal(RecN), false);
+		BatchStore->AddRec(RecValV->GetArrVal(RecN), false);
+	}
+	TTmStopWatch OneSw, ThreadSw;
+	for (uint64 RecId = 0; RecId < (uint64)Recs; RecId += BatchLen) {
+		TUInt64V RecIdV(BatchLen, 0);
+		for (int RecN = 0; RecN < BatchLen; RecN++) { RecIdV.Add(RecId + RecN); }
+		OneSw.Start(); RecStore->OnAddBatch(RecIdV); OneSw.Stop();
+		ThreadSw.Start(); BatchStore->OnAddBatch(RecIdV); ThreadSw.Stop();
+	}
+	printf("%d records in batches of %d: one thread %d ms, %d threads %d ms\n", Recs, BatchLen,
+		OneSw.GetMSecInt(), Threads, ThreadSw.GetMSecInt());
+	CheckSameAggrChain(Base);
+	TQmTest::CloseBase(Base);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Sliding window min and max
+
+TEST(TSignalProcMinMax, Window) {
+	const int Vals = 5000;
+	TRnd Rnd(1); TFltV ValV(Vals, 0);
+	for (int ValN = 0; ValN < Vals; ValN++) { ValV.Add(Rnd.GetUniDevInt(100)); }
+	const int WinLenV[] = { 1, 2, 10, 333 };
+	for (const int WinLen : WinLenV) {
+		TSignalProc::TMin Min; TSignalProc::TMax Max;
+		for (int ValN = 0; ValN < Vals; ValN++) {
+			// value that falls out of the window of last WinLen values
+			TFltV OutValV; TUInt64V OutTmMSecsV;
+			if (ValN >= WinLen) { OutValV.Add(ValV[ValN - WinLen]); OutTmMSecsV.Add(ValN - WinLen + 1); }
+			Min.Update(ValV[ValN], ValN + 1, OutValV, OutTmMSecsV);
+			Max.Update(ValV[ValN], ValN + 1, OutValV, OutTmMSecsV);
+			double WinMin = TFlt::Mx, WinMax = TFlt::Mn;
+			for (int WinValN = TInt::GetMx(0, ValN - WinLen + 1); WinValN <= ValN; WinValN++) {
+				WinMin = TFlt::GetMn(WinMin, ValV[WinValN]);
+				WinMax = TFlt::GetMx(WinMax, ValV[WinValN]);
+			}
+			ASSERT_EQ(WinMin, Min.GetValue()) << WinLen << " " << ValN;
+			ASSERT_EQ(WinMax, Max.GetValue()) << WinLen << " " << ValN;
+		}
+		// state survives save and load
+		TMOut SOut; Min.Save(SOut); Max.Save(SOut);
+		TSignalProc::TMin LoadMin; TSignalProc::TMax LoadMax;
+		PSIn SIn = SOut.GetSIn(); LoadMin.Load(*SIn); LoadMax.Load(*SIn);
+		TFltV OutValV; TUInt64V OutTmMSecsV;
+		OutValV.Add(ValV[Vals - WinLen]); OutTmMSecsV.Add(Vals - WinLen + 1);
+		Min.Update(50.5, Vals + 1, OutValV, OutTmMSecsV); LoadMin.Update(50.5, Vals + 1, OutValV, OutTmMSecsV);
+		Max.Update(50.5, Vals + 1, OutValV, OutTmMSecsV); LoadMax.Update(50.5, Vals + 1, OutValV, OutTmMSecsV);
+		EXPECT_EQ(Min.GetValue(), LoadMin.GetValue());
+		EXPECT_EQ(Max.GetValue(), LoadMax.GetValue());
+		// reset forgets the candidates
+		Min.Reset(); Max.Reset();
+		Min.Update(1000.0, Vals + 2, TFltV(), TUInt64V());
+		Max.Update(-1000.0, Vals + 2, TFltV(), TUInt64V());
+		EXPECT_EQ(1000.0, Min.GetValue());
+		EXPECT_EQ(-1000.0, Max.GetValue());
+	}
+	// decreasing values keep the whole window as max candidates
+	TSignalProc::TMin Min; TSignalProc::TMax Max;
+	const int WinLen = 1000;
+	for (int ValN = 0; ValN < Vals; ValN++) {
+		TFltV OutValV; TUInt64V OutTmMSecsV;
+		if (ValN >= WinLen) { OutValV.Add(Vals - (ValN - WinLen)); OutTmMSecsV.Add(ValN - WinLen + 1); }
+		Min.Update(Vals - ValN, ValN + 1, OutValV, OutTmMSecsV);
+		Max.Update(Vals - ValN, ValN + 1, OutValV, OutTmMSecsV);
+		ASSERT_EQ((double)(Vals - ValN), Min.GetValue()) << ValN;
+		ASSERT_EQ((double)(Vals - TInt::GetMx(0, ValN - WinLen + 1)), Max.GetValue()) << ValN;
+	}
+}
+
+TEST(TSignalProcMinMax, DISABLED_WindowPerf) {
+	// slowly decreasing values keep the whole window as max candidates
+	const int Vals = 2000000;
+	TRnd Rnd(1); TFltV ValV(Vals, 0);
+	for (int ValN = 0; ValN < Vals; ValN++) { ValV.Add(Vals - ValN + Rnd.GetUniDev()); }
+	for (int WinLen = 1000; WinLen <= 1000000; WinLen *= 10) {
+		TSignalProc::TMin Min; TSignalProc::TMax Max;
+		TFltV OutValV(1); TUInt64V OutTmMSecsV(1);
+		TTmStopWatch Sw(true);
+		for (int ValN = 0; ValN < Vals; ValN++) {
+			if (ValN >= WinLen) {
+				OutValV[0] = ValV[ValN - WinLen]; OutTmMSecsV[0] = ValN - WinLen + 1;
+				Min.Update(ValV[ValN], ValN + 1, OutValV, OutTmMSecsV);
+				Max.Update(ValV[ValN], ValN + 1, OutValV, OutTmMSecsV);
+			} else {
+				Min.Update(ValV[ValN], ValN + 1, TFltV(), TUInt64V());
+				Max.Update(ValV[ValN], ValN + 1, TFltV(), TUInt64V());
+			}
+		}
+		Sw.Stop();
+		printf("min and max of %d values over window of %d: %d ms\n", Vals, WinLen, Sw.GetMSecInt());
+		EXPECT_EQ(ValV.Last(), Min.GetValue());
+		EXPECT_EQ(ValV[Vals - WinLen], Max.GetValue());
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Sliding window statistics of several signals
+
+TEST(TSignalProcMultiWinStats, SameAsSingle) {
+	// odd number of channels also covers the scalar tail of SIMD kernels
+	const int Channels = 7, Vals = 3000, WinMSecs = 20;
+	TRnd Rnd(1); TVec<TFltV> ValVV(Vals, 0); TUInt64V TmMSecsV(Vals, 0);
+	for (int ValN = 0; ValN < Vals; ValN++) {
+		TFltV& ValV = ValVV[ValVV.Add()];
+		for (int ChN = 0; ChN < Channels; ChN++) { ValV.Add(Rnd.GetUniDevInt(100) + Rnd.GetUniDev()); }
+		TmMSecsV.Add(ValN * 3 + Rnd.GetUniDevInt(3) + 1);
+	}
+	TSignalProc::TMultiWinStats Stats;
+	TVec<TSignalProc::TSum> SumV(Channels); TVec<TSignalProc::TMa> MaV(Channels);
+	TVec<TSignalProc::TVar> VarV(Channels); TVec<TSignalProc::TMin> MinV(Channels);
+	TVec<TSignalProc::TMax> MaxV(Channels);
+	int OutN = 0;
+	for (int ValN = 0; ValN < Vals; ValN += 1 + ValN % 3) {
+		// one or more values enter the window, older than WinMSecs leave it
+		const int InVals = TInt::GetMn(1 + ValN % 3, Vals - ValN);
+		TVec<TFltV> InValVV, OutValVV; TUInt64V InTmMSecsV, OutTmMSecsV;
+		for (int InN = ValN; InN < ValN + InVals; InN++) { InValVV.Add(ValVV[InN]); InTmMSecsV.Add(TmMSecsV[InN]); }
+		while (TmMSecsV[OutN] + WinMSecs < InTmMSecsV.Last()) {
+			OutValVV.Add(ValVV[OutN]); OutTmMSecsV.Add(TmMSecsV[OutN]); OutN++;
+		}
+		Stats.Update(InValVV, InTmMSecsV, OutValVV, OutTmMSecsV);
+		for (int ChN = 0; ChN < Channels; ChN++) {
+			TFltV InValV, OutValV;
+			for (const TFltV& InValV2 : InValVV) { InValV.Add(InValV2[ChN]); }
+			for (const TFltV& OutValV2 : OutValVV) { OutValV.Add(OutValV2[ChN]); }
+			SumV[ChN].Update(InValV, InTmMSecsV, OutValV, OutTmMSecsV);
+			MaV[ChN].Update(InValV, InTmMSecsV, OutValV, OutTmMSecsV);
+			VarV[ChN].Update(InValV, InTmMSecsV, OutValV, OutTmMSecsV);
+			MinV[ChN].Update(InValV, InTmMSecsV, OutValV, OutTmMSecsV);
+			MaxV[ChN].Update(InValV, InTmMSecsV, OutValV, OutTmMSecsV);
+		}
+		// same results as single signal aggregates on each channel
+		TFltV StatsVarV, StatsMinV, StatsMaxV;
+		Stats.GetVarV(StatsVarV); Stats.GetMinV(StatsMinV); Stats.GetMaxV(StatsMaxV);
+		ASSERT_EQ(Channels, Stats.GetChannels());
+		for (int ChN = 0; ChN < Channels; ChN++) {
+			ASSERT_EQ(SumV[ChN].GetValue(), Stats.GetSumV()[ChN]) << ValN << " " << ChN;
+			ASSERT_EQ(MaV[ChN].GetValue(), Stats.GetMaV()[ChN]) << ValN << " " << ChN;
+			ASSERT_EQ(VarV[ChN].GetValue(), StatsVarV[ChN]) << ValN << " " << ChN;
+			ASSERT_EQ(MinV[ChN].GetValue(), StatsMinV[ChN]) << ValN << " " << ChN;
+			ASSERT_EQ(MaxV[ChN].GetValue(), StatsMaxV[ChN]) << ValN << " " << ChN;
+		}
+		EXPECT_EQ(VarV[0].GetTmMSecs(), Stats.GetTmMSecs());
+	}
+	// state survives save and load
+	TMOut SOut; Stats.Save(SOut);
+	TSignalProc::TMultiWinStats LoadStats; PSIn SIn = SOut.GetSIn(); LoadStats.Load(*SIn);
+	TVec<TFltV> OutValVV; OutValVV.Add(ValVV[OutN]);
+	TUInt64V OutTmMSecsV; OutTmMSecsV.Add(TmMSecsV[OutN]);
+	TVec<TFltV> InValVV; InValVV.Add(TFltV(Channels)); TUInt64V InTmMSecsV; InTmMSecsV.Add(TmMSecsV.Last() + 1);
+	Stats.Update(InValVV, InTmMSecsV, OutValVV, OutTmMSecsV);
+	LoadStats.Update(InValVV, InTmMSecsV, OutValVV, OutTmMSecsV);
+	TFltV VarV1, VarV2; Stats.GetVarV(VarV1); LoadStats.GetVarV(VarV2);
+	TFltV MinV1, MinV2; Stats.GetMinV(MinV1); LoadStats.GetMinV(MinV2);
+	EXPECT_EQ(Stats.GetCount(), LoadStats.GetCount());
+	EXPECT_EQ(VarV1, VarV2);
+	EXPECT_EQ(MinV1, MinV2);
+	EXPECT_EQ(0.0, MinV1[0]);
+	// vectors must keep the number of channels
+	InValVV[0].Add(1.0); InTmMSecsV[0]++;
+	EXPECT_ANY_THROW(Stats.Update(InValVV, InTmMSecsV, TVec<TFltV>(), TUInt64V()));
+	// reset forgets the window
+	Stats.Reset();
+	EXPECT_EQ(0, Stats.GetCount());
+	EXPECT_FALSE(Stats.IsInit());
+	Stats.GetMaxV(MinV1);
+	EXPECT_EQ(TFlt::Mn, MinV1[Channels - 1]);
+}
+
+TEST(TSignalProcMultiWinStats, Aggr) {
+	TWPt<TQm::TBase> Base = NewAggrBase();
+	TWPt<TQm::TStore> RecStore = Base->GetStoreByStoreNm("Rec");
+	AddAggrChain(Base, "Rec");
+	AddAggr(Base, "Rec", "featureSpace", "FtrXY", "\"featureSpace\": ["
+		"{ \"type\": \"numeric\", \"source\": \"$\", \"field\": \"X\" },"
+		"{ \"type\": \"numeric\", \"source\": \"$\", \"field\": \"Y\" }]");
+	AddAggr(Base, "Rec", "denseVectorWindow", "BufXY",
+		"\"inAggr\": \"$FtrXY\", \"inAggrTm\": \"$TickX\", \"winsize\": 5000");
+	AddAggr(Base, "Rec", "winBufMultiStats", "VarXY", "\"inAggr\": \"$BufXY\", \"output\": \"variance\"");
+	TWPt<TQm::TStreamAggrs::TWinBufMultiStats> VarXY =
+		dynamic_cast<TQm::TStreamAggrs::TWinBufMultiStats*>(Base->GetStreamAggr("RecVarXY")());
+	auto GetFlt = [&](const TStr& AggrNm) {
+		return dynamic_cast<TQm::TStreamAggrOut::IFlt*>(Base->GetStreamAggr(AggrNm)())->GetFlt(); };
+	TRnd Rnd(1); uint64 TmMSecs = TTm::GetMSecsFromTm(TTm(2015, 6, 10, -1, 14));
+	PJsonVal RecValV = GetAggrRecs(500, Rnd, TmMSecs);
+	for (int RecN = 0; RecN < RecValV->GetArrVals(); RecN++) {
+		RecStore->AddRec(RecValV->GetArrVal(RecN));
+		// same results as aggregates on separate windows of each signal
+		TFltV VarV; VarXY->GetValV(VarV);
+		ASSERT_EQ(2, VarV.Len());
+		EXPECT_EQ(GetFlt("RecVarX"), VarV[0]);
+		EXPECT_EQ(GetFlt("RecVarY"), VarV[1]);
+		EXPECT_EQ(GetFlt("RecMaX"), VarXY->GetMeanV()[0]);
+		TFltV MinV; VarXY->GetMinV(MinV);
+		TFltV MaxV; VarXY->GetMaxV(MaxV);
+		EXPECT_EQ(GetFlt("RecMinX"), MinV[0]);
+		EXPECT_EQ(GetFlt("RecMaxX"), MaxV[0]);
+		EXPECT_EQ(dynamic_cast<TQm::TStreamAggrOut::ITm*>(Base->GetStreamAggr("RecVarX")())->GetTmMSecs(), VarXY->GetTmMSecs());
+	}
+	// unknown output is reported
+	EXPECT_ANY_THROW(AddAggr(Base, "Rec", "winBufMultiStats", "Bad", "\"inAggr\": \"$BufXY\", \"output\": \"median\""));
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TSignalProcMultiWinStats, DISABLED_Perf) {
+	const int Channels = 64, Vals = 100000, WinLen = 1000;
+	TRnd Rnd(1); TVec<TFltV> ValVV(Vals, 0);
+	for (int ValN = 0; ValN < Vals; ValN++) {
+		TFltV& ValV = ValVV[ValVV.Add()];
+		for (int ChN = 0; ChN < Channels; ChN++) { ValV.Add(Rnd.GetUniDev()); }
+	}
+	// statistics of all channels together
+	TSignalProc::TMultiWinStats Stats;
+	TVec<TFltV> InValVV(1), OutValVV(1); TUInt64V InTmMSecsV(1), OutTmMSecsV(1);
+	TTmStopWatch MultiSw(true);
+	for (int ValN = 0; ValN < Vals; ValN++) {
+		InValVV[0] = ValVV[ValN]; InTmMSecsV[0] = ValN + 1;
+		if (ValN >= WinLen) {
+			OutValVV[0] = ValVV[ValN - WinLen]; OutTmMSecsV[0] = ValN - WinLen + 1;
+			Stats.Update(InValVV, InTmMSecsV, OutValVV, OutTmMSecsV);
+		} else {
+			Stats.Update(InValVV, InTmMSecsV, TVec<TFltV>(), TUInt64V());
+		}
+	}
+	MultiSw.Stop();
+	// separate aggregates for each channel
+	TVec<TSignalProc::TSum> SumV(Channels); TVec<TSignalProc::TVar> VarV(Channels);
+	TVec<TSignalProc::TMin> MinV(Channels); TVec<TSignalProc::TMax> MaxV(Channels);
+	TFltV OutValV(1); TUInt64V OutTmV(1);
+	const TFltV EmptyValV; const TUInt64V EmptyTmV;
+	TTmStopWatch SingleSw(true);
+	for (int ValN = 0; ValN < Vals; ValN++) {
+		for (int ChN = 0; ChN < Channels; ChN++) {
+			const double InVal = ValVV[ValN][ChN];
+			if (ValN >= WinLen) { OutValV[0] = ValVV[ValN - WinLen][ChN]; OutTmV[0] = ValN - WinLen + 1; }
+			const TFltV& ChOutValV = (ValN >= WinLen) ? OutValV : EmptyValV;
+			const TUInt64V& ChOutTmV = (ValN >= WinLen) ? OutTmV : EmptyTmV;
+			SumV[ChN].Update(InVal, ValN + 1, ChOutValV, ChOutTmV);
+			VarV[ChN].Update(InVal, ValN + 1, ChOutValV, ChOutTmV);
+			MinV[ChN].Update(InVal, ValN + 1, ChOutValV, ChOutTmV);
+			MaxV[ChN].Update(InVal, ValN + 1, ChOutValV, ChOutTmV);
+		}
+	}
+	SingleSw.Stop();
+	printf("window statistics of %d values on %d channels: %d ms together, %d ms per channel\n",
+		Vals, Channels, MultiSw.GetMSecInt(), SingleSw.GetMSecInt());
+	TFltV StatsVarV; Stats.GetVarV(StatsVarV);
+	EXPECT_EQ(VarV[Channels - 1].GetValue(), StatsVarV[Channels - 1]);
+	EXPECT_EQ(SumV[0].GetValue(), Stats.GetSumV()[0]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Pipelines of stream aggregates
+
+namespace {
+
+/// Tick on X followed by the given stages
+TStr GetPipelineStr(const TStr& StagesStr) {
+	return "\"stages\": [{ \"type\": \"timeSeriesTick\", \"value\": \"X\" }, " + StagesStr + "]";
+}
+
+double GetAggrFlt(const TWPt<TQm::TBase>& Base, const TStr& AggrNm) {
+	return dynamic_cast<TQm::TStreamAggrOut::IFlt*>(Base->GetStreamAggr(AggrNm)())->GetFlt();
+}
+
+}
+
+TEST(TPipeline, Fused) {
+	TWPt<TQm::TBase> Base = NewAggrBase();
+	TWPt<TQm::TStore> RecStore = Base->GetStoreByStoreNm("Rec");
+	TWPt<TQm::TStore> BatchStore = Base->GetStoreByStoreNm("Batch");
+	AddAggrChain(Base, "Rec");
+	AddAggr(Base, "Rec", "timeSeriesWinBufVector", "DelayBufX", "\"inAggr\": \"$TickX\", \"winsize\": 3000, \"delay\": 1000");
+	AddAggr(Base, "Rec", "winBufSum", "DelaySumX", "\"inAggr\": \"$DelayBufX\"");
+	// same chains as pipelines, on records and on batches
+	const TStr WinBufStr = "{ \"type\": \"timeSeriesWinBufVector\", \"winsize\": 5000 }, ";
+	const char* PipeTypeV[][3] = { { "MaX", "ma", "fusedMa" }, { "VarX", "variance", "fusedVariance" },
+		{ "MinX", "winBufMin", "fusedWinBufMin" }, { "MaxX", "winBufMax", "fusedWinBufMax" } };
+	for (const TStr& StoreNm : TStrV::GetV("Rec", "Batch")) {
+		for (const auto& PipeType : PipeTypeV) {
+			AddAggr(Base, StoreNm, "pipeline", TStr("Pipe") + PipeType[0],
+				GetPipelineStr(WinBufStr + "{ \"type\": \"" + PipeType[1] + "\" }"));
+			EXPECT_EQ(TStr(PipeType[2]), Base->GetStreamAggr(StoreNm + "Pipe" + PipeType[0])->Type());
+		}
+		AddAggr(Base, StoreNm, "pipeline", "PipeEmaX", GetPipelineStr(
+			"{ \"type\": \"ema\", \"emaType\": \"previous\", \"interval\": 3000 }"));
+		EXPECT_EQ(TStr("fusedEma"), Base->GetStreamAggr(StoreNm + "PipeEmaX")->Type());
+		AddAggr(Base, StoreNm, "pipeline", "PipeDelaySumX", GetPipelineStr(
+			"{ \"type\": \"timeSeriesWinBufVector\", \"winsize\": 3000, \"delay\": 1000 }, { \"type\": \"winBufSum\" }"));
+		// fused aggregates are the only stages
+		EXPECT_FALSE(Base->IsStreamAggr(StoreNm + "PipeMaX_0"));
+	}
+	EXPECT_TRUE(Base->GetStreamAggrSet(BatchStore->GetStoreId())->IsBatchOrder());
+	TRnd Rnd(1); uint64 TmMSecs = TTm::GetMSecsFromTm(TTm(2015, 6, 10, -1, 14));
+	const int BatchLenV[] = { 1, 2, 7, 50, 1, 300, 13 };
+	for (const int BatchLen : BatchLenV) {
+		PJsonVal RecValV = GetAggrRecs(BatchLen, Rnd, TmMSecs);
+		for (int RecN = 0; RecN < RecValV->GetArrVals(); RecN++) {
+			RecStore->AddRec(RecValV->GetArrVal(RecN));
+		}
+		TUInt64V RecIdV; BatchStore->AddRecBatch(RecValV, RecIdV);
+		// same results as the chains of separate aggregates
+		for (const TStr& AggrNm : TStrV::GetV("MaX", "VarX", "MinX", "MaxX", "EmaX", "DelaySumX")) {
+			EXPECT_EQ(GetAggrFlt(Base, "Rec" + AggrNm), GetAggrFlt(Base, "RecPipe" + AggrNm)) << AggrNm.CStr();
+			EXPECT_EQ(GetAggrFlt(Base, "Rec" + AggrNm), GetAggrFlt(Base, "BatchPipe" + AggrNm)) << AggrNm.CStr();
+		}
+	}
+	// state survives save and load
+	AddAggr(Base, "Rec", "pipeline", "LoadDelaySumX", GetPipelineStr(
+		"{ \"type\": \"timeSeriesWinBufVector\", \"winsize\": 3000, \"delay\": 1000 }, { \"type\": \"winBufSum\" }"));
+	TMOut SOut; Base->GetStreamAggr("RecPipeDelaySumX")->SaveState(SOut);
+	PSIn SIn = SOut.GetSIn(); Base->GetStreamAggr("RecLoadDelaySumX")->LoadState(*SIn);
+	RecStore->AddRec(GetAggrRecs(1, Rnd, TmMSecs)->GetArrVal(0));
+	EXPECT_EQ(GetAggrFlt(Base, "RecDelaySumX"), GetAggrFlt(Base, "RecLoadDelaySumX"));
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TPipeline, Fallback) {
+	TWPt<TQm::TBase> Base = NewAggrBase();
+	TWPt<TQm::TStore> RecStore = Base->GetStoreByStoreNm("Rec");
+	AddAggrChain(Base, "Rec");
+	// unknown chain
+	AddAggr(Base, "Rec", "pipeline", "PipeAboveX", GetPipelineStr(
+		"{ \"type\": \"timeSeriesWinBufVector\", \"winsize\": 5000 }, { \"type\": \"ma\" },"
+		"{ \"type\": \"threshold\", \"threshold\": 0.5 }"));
+	EXPECT_EQ(TStr("threshold"), Base->GetStreamAggr("RecPipeAboveX")->Type());
+	EXPECT_EQ(TStr("timeSeriesTick"), Base->GetStreamAggr("RecPipeAboveX_0")->Type());
+	EXPECT_EQ(TStr("ma"), Base->GetStreamAggr("RecPipeAboveX_2")->Type());
+	// known chain with a stage reading from another aggregate
+	AddAggr(Base, "Rec", "pipeline", "PipeMaX", GetPipelineStr(
+		"{ \"type\": \"timeSeriesWinBufVector\", \"winsize\": 5000, \"inAggrTm\": \"RecTickX\" }, { \"type\": \"ma\" }"));
+	EXPECT_EQ(TStr("ma"), Base->GetStreamAggr("RecPipeMaX")->Type());
+	// unknown stage type is reported
+	EXPECT_ANY_THROW(AddAggr(Base, "Rec", "pipeline", "Bad", GetPipelineStr("{ \"type\": \"noSuchAggr\" }")));
+	EXPECT_FALSE(Base->IsStreamAggr("RecBad_0"));
+	// bad parameter of the last stage removes the stages before it
+	const int RecAggrs = Base->GetStreamAggrSet(RecStore->GetStoreId())->Len();
+	EXPECT_ANY_THROW(AddAggr(Base, "Rec", "pipeline", "BadLast", GetPipelineStr(
+		"{ \"type\": \"timeSeriesWinBufVector\", \"winsize\": 5000 }, { \"type\": \"ma\" }, { \"type\": \"threshold\" }")));
+	EXPECT_FALSE(Base->IsStreamAggr("RecBadLast_0"));
+	EXPECT_FALSE(Base->IsStreamAggr("RecBadLast_2"));
+	EXPECT_EQ(RecAggrs, Base->GetStreamAggrSet(RecStore->GetStoreId())->Len());
+	// and the name can be used again
+	AddAggr(Base, "Rec", "pipeline", "BadLast", GetPipelineStr(
+		"{ \"type\": \"timeSeriesWinBufVector\", \"winsize\": 5000 }, { \"type\": \"ma\" }, { \"type\": \"threshold\", \"threshold\": 0.5 }"));
+	EXPECT_TRUE(Base->IsStreamAggr("RecBadLast_0"));
+	TRnd Rnd(1); uint64 TmMSecs = TTm::GetMSecsFromTm(TTm(2015, 6, 10, -1, 14));
+	PJsonVal RecValV = GetAggrRecs(500, Rnd, TmMSecs);
+	for (int RecN = 0; RecN < RecValV->GetArrVals(); RecN++) {
+		RecStore->AddRec(RecValV->GetArrVal(RecN));
+		EXPECT_EQ(GetAggrFlt(Base, "RecAboveX"), GetAggrFlt(Base, "RecPipeAboveX"));
+		EXPECT_EQ(GetAggrFlt(Base, "RecMaX"), GetAggrFlt(Base, "RecPipeMaX"));
+	}
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TPipeline, DISABLED_FusedPerf) {
+	TWPt<TQm::TBase> Base = NewAggrBase();
+	TWPt<TQm::TStore> RecStore = Base->GetStoreByStoreNm("Rec");
+	TWPt<TQm::TStore> BatchStore = Base->GetStoreByStoreNm("Batch");
+	// separate aggregates on one store, pipelines on the other
+	AddAggr(Base, "Rec", "timeSeriesTick", "TickX", "\"value\": \"X\"");
+	AddAggr(Base, "Rec", "timeSeriesWinBufVector", "BufX", "\"inAggr\": \"$TickX\", \"winsize\": 5000");
+	AddAggr(Base, "Rec", "ma", "MaX", "\"inAggr\": \"$BufX\"");
+	AddAggr(Base, "Batch", "pipeline", "MaX", GetPipelineStr(
+		"{ \"type\": \"timeSeriesWinBufVector\", \"winsize\": 5000 }, { \"type\": \"ma\" }"));
+	TRnd Rnd(1); uint64 TmMSecs = TTm::GetMSecsFromTm(TTm(2015, 6, 10, -1, 14));
+	PJsonVal RecValV = GetAggrRecs(100000, Rnd, TmMSecs);
+	for (int RecN = 0; RecN < RecValV->GetArrVals(); RecN++) {
+		RecStore->AddRec(RecValV->GetArrVal(RecN));
+		BatchStore->AddRec(RecValV->GetArrVal(RecN));
+	}
+	double ChainMSecs = 0.0;
+	for (const TStr& AggrNm : TStrV::GetV("RecTickX", "RecBufX", "RecMaX")) {
+		ChainMSecs += Base->GetStreamAggr(AggrNm)->GetExeTm().GetMSec();
+	}
+	const double FusedMSecs = Base->GetStreamAggr("BatchMaX")->GetExeTm().GetMSec();
+	printf("moving average of %d records: %.0f ms separate aggregates, %.0f ms fused\n",
+		RecValV->GetArrVals(), ChainMSecs, FusedMSecs);
+	EXPECT_EQ(GetAggrFlt(Base, "RecMaX"), GetAggrFlt(Base, "BatchMaX"));
+	TQmTest::CloseBase(Base);
+}
@@ -0,0 +1,160 @@
+/**
+* Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+* All rights reserved.
+*
+* This source code is licensed under the FreeBSD license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+#include <base.h>
+#include <mine.h>
+#include <qminer.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Google Test
+#include "gtest/gtest.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Helpers
+
+namespace {
+
+typedef TBtree::TBtreeNodeMemStore<TInt, TInt, TInt> TIntNodeStore;
+typedef TBtree::TBtreeOps<TInt, TInt, TCmp<TInt>, TInt, TIntNodeStore, TIntNodeStore> TIntBtree;
+
+// sorted keys with duplicates, data is position of the key
+void GenKdV(TRnd& Rnd, const int& Keys, TIntBtree::TKdV& KdV) {
+	TIntV KeyV; KeyV.Gen(Keys, 0);
+	for (int KeyN = 0; KeyN < Keys; KeyN++) { KeyV.Add(Rnd.GetUniDevInt(Keys)); }
+	KeyV.Sort();
+	KdV.Gen(Keys, 0);
+	for (int KeyN = 0; KeyN < Keys; KeyN++) { KdV.Add(TIntBtree::TKd(KeyV[KeyN], KeyN)); }
+}
+
+// check tree has exactly the given keys
+void CheckKeys(TIntBtree& BTree, const TIntBtree::TKdV& KdV) {
+	BTree.Validate();
+	ASSERT_EQ(BTree.GetKeys(), KdV.Len());
+	TIntBtree::TKeyV KeyV; BTree.GetKeyV(KeyV);
+	ASSERT_EQ(KeyV.Len(), KdV.Len());
+	for (int KeyN = 0; KeyN < KeyV.Len(); KeyN++) {
+		ASSERT_EQ(KeyV[KeyN].Val, KdV[KeyN].Key.Val);
+	}
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Bottom-up build
+
+TEST(TBtreeOps, Build) {
+	TRnd Rnd(1);
+	const int CapacityV[][2] = { { 2, 2 }, { 3, 5 }, { 8, 64 } };
+	const int KeysV[] = { 0, 1, 2, 3, 4, 5, 9, 63, 64, 127, 128, 129, 1000, 12345 };
+	const double FillFactorV[] = { 0.1, 0.5, 1.0 };
+	for (int CapN = 0; CapN < 3; CapN++) {
+		for (int KeysN = 0; KeysN < 14; KeysN++) {
+			for (int FillN = 0; FillN < 3; FillN++) {
+				TIntBtree BTree(new TIntNodeStore, new TIntNodeStore,
+					CapacityV[CapN][0], CapacityV[CapN][1], false, false);
+				TIntBtree::TKdV KdV; GenKdV(Rnd, KeysV[KeysN], KdV);
+				BTree.Build(KdV, FillFactorV[FillN]);
+				CheckKeys(BTree, KdV);
+				EXPECT_EQ(BTree.Empty(), KdV.Empty());
+			}
+		}
+	}
+}
+
+TEST(TBtreeOps, BuildThenUpdate) {
+	TRnd Rnd(1);
+	for (int FillN = 1; FillN <= 10; FillN++) {
+		TIntBtree BTree(new TIntNodeStore, new TIntNodeStore, 3, 4, false, false);
+		TIntBtree::TKdV KdV; GenKdV(Rnd, 1000, KdV);
+		BTree.Build(KdV, FillN / 10.0);
+		// tree built bottom-up supports regular inserts and deletes
+		TIntV KeyV; for (int KeyN = 0; KeyN < KdV.Len(); KeyN++) { KeyV.Add(KdV[KeyN].Key); }
+		for (int KeyN = 0; KeyN < 500; KeyN++) {
+			const int Key = Rnd.GetUniDevInt(1000);
+			BTree.Add(Key, -1); KeyV.Add(Key);
+		}
+		for (int KeyN = 0; KeyN < 700; KeyN++) {
+			const int Key = KeyV[Rnd.GetUniDevInt(KeyV.Len())];
+			EXPECT_TRUE(BTree.Del(Key));
+			KeyV.DelIfIn(Key);
+		}
+		KeyV.Sort();
+		BTree.Validate();
+		TIntBtree::TKeyV ResKeyV; BTree.GetKeyV(ResKeyV);
+		ASSERT_EQ(ResKeyV.Len(), KeyV.Len());
+		for (int KeyN = 0; KeyN < KeyV.Len(); KeyN++) {
+			EXPECT_EQ(ResKeyV[KeyN].Val, KeyV[KeyN].Val);
+		}
+	}
+}
+
+TEST(TBtreeOps, DISABLED_BuildPerf) {
+	const int Keys = 1000000;
+	TRnd Rnd(1);
+	TIntBtree::TKdV KdV; GenKdV(Rnd, Keys, KdV);
+	TTmStopWatch AddSw(true);
+	TIntBtree AddBTree(new TIntNodeStore, new TIntNodeStore, 8, 64, false, false);
+	for (int KeyN = 0; KeyN < Keys; KeyN++) { AddBTree.Add(KdV[KeyN].Key, KdV[KeyN].Dat); }
+	AddSw.Stop();
+	TTmStopWatch BuildSw(true);
+	TIntBtree BuildBTree(new TIntNodeStore, new TIntNodeStore, 8, 64, false, false);
+	BuildBTree.Build(KdV);
+	BuildSw.Stop();
+	EXPECT_EQ(AddBTree.GetKeys(), BuildBTree.GetKeys());
+	printf("add: %d ms, build: %d ms\n", AddSw.GetMSecInt(), BuildSw.GetMSecInt());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// B-tree index
+
+TEST(TBTreeIndex, AddKeyV) {
+	TRnd Rnd(1);
+	TPt<TQm::TBTreeIndex<TInt> > Index = TQm::TBTreeIndex<TInt>::New(TQm::TBTreeIndexParam(4, 16, 0.8));
+	TVec<TPair<TInt, TUInt64> > AllValRecIdV;
+	// empty index is built, small batches are inserted, large batches are merged in
+	const int BatchLenV[] = { 10000, 100, 20000, 1, 500 };
+	uint64 RecId = 0;
+	for (int BatchN = 0; BatchN < 5; BatchN++) {
+		TVec<TPair<TInt, TUInt64> > ValRecIdV;
+		for (int ValN = 0; ValN < BatchLenV[BatchN]; ValN++) {
+			ValRecIdV.Add(TPair<TInt, TUInt64>(Rnd.GetUniDevInt(1000), RecId++));
+		}
+		ValRecIdV.Sort();
+		Index->AddKeyV(ValRecIdV);
+		AllValRecIdV.AddV(ValRecIdV);
+		EXPECT_EQ(Index->GetKeys(), AllValRecIdV.Len());
+	}
+	// range queries return all records with values in the range
+	for (int QueryN = 0; QueryN < 20; QueryN++) {
+		const int MnVal = Rnd.GetUniDevInt(1000);
+		const int MxVal = MnVal + Rnd.GetUniDevInt(100);
+		TUInt64V RecIdV; Index->SearchRange(TPair<TInt, TInt>(MnVal, MxVal), RecIdV);
+		RecIdV.Sort();
+		TUInt64V ExpRecIdV;
+		for (int ValN = 0; ValN < AllValRecIdV.Len(); ValN++) {
+			const int Val = AllValRecIdV[ValN].Val1;
+			if (MnVal <= Val && Val <= MxVal) { ExpRecIdV.Add(AllValRecIdV[ValN].Val2); }
+		}
+		ExpRecIdV.Sort();
+		ASSERT_EQ(RecIdV.Len(), ExpRecIdV.Len());
+		for (int RecN = 0; RecN < RecIdV.Len(); RecN++) {
+			EXPECT_EQ(RecIdV[RecN].Val, ExpRecIdV[RecN].Val);
+		}
+	}
+}
+
+TEST(TBTreeIndex, Param) {
+	EXPECT_FALSE(TQm::TBTreeIndexParam().IsCustom());
+	TQm::TBTreeIndexParam Param(TJsonVal::GetValFromStr("{ \"leafCapacity\": 128, \"fillFactor\": 0.7 }"));
+	EXPECT_TRUE(Param.IsCustom());
+	EXPECT_EQ(Param.InternalCapacity.Val, 8);
+	EXPECT_EQ(Param.LeafCapacity.Val, 128);
+	EXPECT_EQ(Param.FillFactor.Val, 0.7);
+	EXPECT_ANY_THROW(TQm::TBTreeIndexParam(1, 64, 1.0));
+	EXPECT_ANY_THROW(TQm::TBTreeIndexParam(8, 64, 1.5));
+}
@@ -0,0 +1,325 @@
+/**
+* Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+* All rights reserved.
+*
+* This source code is licensed under the FreeBSD license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+#include <base.h>
+#include <mine.h>
+#include <qminer.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Google Test
+#include "gtest/gtest.h"
+
+#include "test-qminer.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Helpers
+
+namespace {
+
+const TStr FtrSpaceTestFPath = "./data/ftrspace/";
+
+TWPt<TQm::TBase> NewFtrSpaceBase(const int& Recs) {
+	TWPt<TQm::TBase> Base = TQmTest::NewBase(FtrSpaceTestFPath, TJsonVal::GetValFromStr(
+		"[{ \"name\": \"Docs\", \"fields\": ["
+		"  { \"name\": \"Text\", \"type\": \"string\", \"store\": \"cache\" },"
+		"  { \"name\": \"Category\", \"type\": \"string\" },"
+		"  { \"name\": \"Value\", \"type\": \"float\" }"
+		"]}]"), 16 * 1024 * 1024, 16 * 1024 * 1024);
+	// documents with overlapping vocabularies of growing size
+	TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Docs");
+	TRnd Rnd(1);
+	for (int RecN = 0; RecN < Recs; RecN++) {
+		TChA TextChA;
+		for (int WordN = 0; WordN < 30; WordN++) {
+			if (WordN > 0) { TextChA += ' '; }
+			TextChA += "word"; TextChA += TInt::GetStr(Rnd.GetUniDevInt(10 + RecN / 2));
+		}
+		PJsonVal RecVal = TJsonVal::NewObj();
+		RecVal->AddToObj("Text", TStr(TextChA));
+		RecVal->AddToObj("Category", "cat" + TInt::GetStr(Rnd.GetUniDevInt(RecN % 50 + 1)));
+		RecVal->AddToObj("Value", Rnd.GetUniDev());
+		Store->AddRec(RecVal);
+	}
+	return Base;
+}
+
+TQm::PFtrSpace NewFtrSpace(const TWPt<TQm::TBase>& Base, const TStr& TextParamStr = "") {
+	return TQm::TFtrSpace::New(Base, TJsonVal::GetValFromStr(
+		"[{ \"type\": \"text\", \"source\": \"Docs\", \"field\": \"Text\","
+		"   \"tokenizer\": { \"type\": \"simple\" }" + TextParamStr + " },"
+		" { \"type\": \"categorical\", \"source\": \"Docs\", \"field\": \"Category\" },"
+		" { \"type\": \"multinomial\", \"source\": \"Docs\", \"field\": \"Category\" },"
+		" { \"type\": \"numeric\", \"source\": \"Docs\", \"field\": \"Value\", \"normalize\": true }]"));
+}
+
+void CheckSameSpV(const TIntFltKdV& SpV1, const TIntFltKdV& SpV2) {
+	ASSERT_EQ(SpV1.Len(), SpV2.Len());
+	for (int SpN = 0; SpN < SpV1.Len(); SpN++) {
+		ASSERT_EQ(SpV1[SpN].Key, SpV2[SpN].Key);
+		ASSERT_EQ(SpV1[SpN].Dat, SpV2[SpN].Dat);
+	}
+}
+
+void CheckSameFtrSpace(const TQm::PFtrSpace& FtrSpace1, const TQm::PFtrSpace& FtrSpace2, const TQm::PRecSet& RecSet) {
+	ASSERT_EQ(FtrSpace1->GetDim(), FtrSpace2->GetDim());
+	for (int FtrN = 0; FtrN < FtrSpace1->GetDim(); FtrN++) {
+		ASSERT_EQ(FtrSpace1->GetFtr(FtrN), FtrSpace2->GetFtr(FtrN));
+	}
+	for (int RecN = 0; RecN < RecSet->GetRecs(); RecN += 7) {
+		TIntFltKdV SpV1, SpV2;
+		FtrSpace1->GetSpV(RecSet->GetRec(RecN), SpV1);
+		FtrSpace2->GetSpV(RecSet->GetRec(RecN), SpV2);
+		CheckSameSpV(SpV1, SpV2);
+	}
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Parallel feature space
+
+TEST(TFtrSpace, ParallelUpdate) {
+	TWPt<TQm::TBase> Base = NewFtrSpaceBase(2000);
+	TQm::PRecSet RecSet = Base->GetStoreByStoreNm("Docs")->GetAllRecs();
+	// update in parts gives the same vocabulary, in the same order, and the same weights
+	TQm::PFtrSpace SeqFtrSpace = NewFtrSpace(Base);
+	SeqFtrSpace->Update(RecSet);
+	for (int Threads = 2; Threads <= 8; Threads *= 2) {
+		TQm::PFtrSpace ParFtrSpace = NewFtrSpace(Base);
+		EXPECT_TRUE(ParFtrSpace->Update(RecSet, Threads));
+		CheckSameFtrSpace(SeqFtrSpace, ParFtrSpace, RecSet);
+		// second update only adds counts
+		SeqFtrSpace->Update(RecSet);
+		EXPECT_FALSE(ParFtrSpace->Update(RecSet, Threads));
+		CheckSameFtrSpace(SeqFtrSpace, ParFtrSpace, RecSet);
+		SeqFtrSpace->Clr(); SeqFtrSpace->Update(RecSet);
+	}
+	// hashing
+	TQm::PFtrSpace SeqHashFtrSpace = NewFtrSpace(Base, ", \"hashDimension\": 64, \"hashTable\": true");
+	TQm::PFtrSpace ParHashFtrSpace = NewFtrSpace(Base, ", \"hashDimension\": 64, \"hashTable\": true");
+	SeqHashFtrSpace->Update(RecSet);
+	ParHashFtrSpace->Update(RecSet, 4);
+	CheckSameFtrSpace(SeqHashFtrSpace, ParHashFtrSpace, RecSet);
+	// more threads than records
+	TQm::PRecSet SmallRecSet = RecSet->GetLimit(3, 0);
+	TQm::PFtrSpace SmallSeqFtrSpace = NewFtrSpace(Base); SmallSeqFtrSpace->Update(SmallRecSet);
+	TQm::PFtrSpace SmallParFtrSpace = NewFtrSpace(Base); SmallParFtrSpace->Update(SmallRecSet, 8);
+	CheckSameFtrSpace(SmallSeqFtrSpace, SmallParFtrSpace, SmallRecSet);
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TFtrSpace, ParallelExtract) {
+	TWPt<TQm::TBase> Base = NewFtrSpaceBase(1000);
+	TQm::PRecSet RecSet = Base->GetStoreByStoreNm("Docs")->GetAllRecs();
+	TQm::PFtrSpace FtrSpace = NewFtrSpace(Base);
+	FtrSpace->Update(RecSet);
+	TVec<TIntFltKdV> SeqSpVV, ParSpVV;
+	FtrSpace->GetSpVV(RecSet, SeqSpVV);
+	// appends after existing vectors
+	ParSpVV.Add(TIntFltKdV());
+	FtrSpace->GetSpVV(RecSet, ParSpVV, -1, 4);
+	ASSERT_EQ(ParSpVV.Len(), SeqSpVV.Len() + 1);
+	for (int RecN = 0; RecN < SeqSpVV.Len(); RecN++) {
+		CheckSameSpV(SeqSpVV[RecN], ParSpVV[RecN + 1]);
+	}
+	TVec<TFltV> SeqFullVV, ParFullVV;
+	FtrSpace->GetFullVV(RecSet, SeqFullVV, 1);
+	FtrSpace->GetFullVV(RecSet, ParFullVV, 1, 4);
+	EXPECT_EQ(SeqFullVV, ParFullVV);
+	TFltVV SeqFullMat, ParFullMat;
+	FtrSpace->GetFullVV(RecSet, SeqFullMat);
+	FtrSpace->GetFullVV(RecSet, ParFullMat, -1, 4);
+	ASSERT_EQ(SeqFullMat.GetRows(), ParFullMat.GetRows());
+	ASSERT_EQ(SeqFullMat.GetCols(), ParFullMat.GetCols());
+	for (int RowN = 0; RowN < SeqFullMat.GetRows(); RowN++) {
+		for (int ColN = 0; ColN < SeqFullMat.GetCols(); ColN++) {
+			ASSERT_EQ(SeqFullMat(RowN, ColN), ParFullMat(RowN, ColN));
+		}
+	}
+	// concurrent reads are turned back off
+	EXPECT_FALSE(Base->IsConcurrentReads());
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TFtrSpace, SparseMatrix) {
+	TWPt<TQm::TBase> Base = NewFtrSpaceBase(1000);
+	TQm::PRecSet RecSet = Base->GetStoreByStoreNm("Docs")->GetAllRecs();
+	TQm::PFtrSpace FtrSpace = NewFtrSpace(Base);
+	FtrSpace->Update(RecSet);
+	for (int FtrExtN = -1; FtrExtN < FtrSpace->GetFtrExts(); FtrExtN++) {
+		TVec<TIntFltKdV> SpVV; FtrSpace->GetSpVV(RecSet, SpVV, FtrExtN);
+		for (int Threads = 1; Threads <= 4; Threads *= 4) {
+			TCscMatrix SpMat; FtrSpace->GetSpMat(RecSet, SpMat, FtrExtN, Threads);
+			ASSERT_EQ(SpMat.GetCols(), RecSet->GetRecs());
+			ASSERT_EQ(SpMat.GetRows(), (FtrExtN < 0) ? FtrSpace->GetDim() : FtrSpace->GetFtrExtDim(FtrExtN));
+			for (int RecN = 0; RecN < SpVV.Len(); RecN++) {
+				TIntFltKdV SpV; SpMat.GetColSpV(RecN, SpV);
+				CheckSameSpV(SpVV[RecN], SpV);
+			}
+		}
+	}
+	// sparse kernels give the same results as with a vector of sparse columns
+	TVec<TIntFltKdV> SpVV; FtrSpace->GetSpVV(RecSet, SpVV);
+	TCscMatrix SpMat; FtrSpace->GetSpMat(RecSet, SpMat);
+	TSparseColMatrix ColMat(SpVV, FtrSpace->GetDim(), SpVV.Len());
+	TFltV RecWgtV(SpVV.Len()); TFltV FtrWgtV(FtrSpace->GetDim());
+	for (int RecN = 0; RecN < RecWgtV.Len(); RecN++) { RecWgtV[RecN] = RecN % 3 - 1.0; }
+	for (int FtrN = 0; FtrN < FtrWgtV.Len(); FtrN++) { FtrWgtV[FtrN] = 1.0 / (FtrN + 1); }
+	TFltV ColResV(FtrSpace->GetDim()), CscResV(FtrSpace->GetDim());
+	ColMat.Multiply(RecWgtV, ColResV); SpMat.Multiply(RecWgtV, CscResV);
+	for (int FtrN = 0; FtrN < ColResV.Len(); FtrN++) { EXPECT_NEAR(ColResV[FtrN], CscResV[FtrN], 1e-10); }
+	TFltV ColResTV(SpVV.Len()), CscResTV(SpVV.Len());
+	ColMat.MultiplyT(FtrWgtV, ColResTV); SpMat.MultiplyT(FtrWgtV, CscResTV);
+	for (int RecN = 0; RecN < ColResTV.Len(); RecN++) { EXPECT_NEAR(ColResTV[RecN], CscResTV[RecN], 1e-10); }
+	TCscMatrix ConvMat(SpVV, FtrSpace->GetDim());
+	EXPECT_EQ(ConvMat.ColPtrV, SpMat.ColPtrV);
+	EXPECT_EQ(ConvMat.RowIdxV, SpMat.RowIdxV);
+	EXPECT_EQ(ConvMat.ValV, SpMat.ValV);
+	// linear SVM trains directly on the matrix
+	TFltV ClsV(SpVV.Len());
+	for (int RecN = 0; RecN < ClsV.Len(); RecN++) { ClsV[RecN] = (SpVV[RecN].Len() % 2 == 0) ? 1.0 : -1.0; }
+	TSvm::TLinModel SpVVModel = TSvm::SolveClassify<TVec<TIntFltKdV>>(SpVV, FtrSpace->GetDim(),
+		SpVV.Len(), ClsV, 1.0, 1.0, 10000, 100, 1e-6, 100, TNotify::NullNotify);
+	TSvm::TLinModel SpMatModel = TSvm::SolveClassify<TCscMatrix>(SpMat, FtrSpace->GetDim(),
+		SpMat.GetCols(), ClsV, 1.0, 1.0, 10000, 100, 1e-6, 100, TNotify::NullNotify);
+	EXPECT_EQ(SpVVModel.GetWgtV(), SpMatModel.GetWgtV());
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TFtrSpace, TokenCache) {
+	TWPt<TQm::TBase> Base = NewFtrSpaceBase(500);
+	TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Docs");
+	TQm::PRecSet RecSet = Store->GetAllRecs();
+	const TStr CacheParamStr = ", \"tokenCache\": true";
+	const TStr HashParamStr = ", \"hashDimension\": 64";
+	for (int HashN = 0; HashN < 2; HashN++) {
+		const TStr ParamStr = (HashN == 0) ? TStr() : HashParamStr;
+		TQm::PFtrSpace FtrSpace = NewFtrSpace(Base, ParamStr);
+		TQm::PFtrSpace CacheFtrSpace = NewFtrSpace(Base, ParamStr + CacheParamStr);
+		TQm::TFtrExts::PTokenCache TokenCache = dynamic_cast<TQm::TFtrExts::TBagOfWords*>(
+			CacheFtrSpace->GetFtrExt(0)())->GetTokenCache();
+		ASSERT_FALSE(TokenCache.Empty());
+		// extraction before update: vocabulary is empty, so cached ids get stale with it
+		TVec<TIntFltKdV> SpVV; CacheFtrSpace->GetSpVV(RecSet, SpVV);
+		EXPECT_EQ(TokenCache->GetRecs(), RecSet->GetRecs());
+		// update with tokens from cache (hashing) or from text (vocabulary)
+		FtrSpace->Update(RecSet); CacheFtrSpace->Update(RecSet);
+		CheckSameFtrSpace(FtrSpace, CacheFtrSpace, RecSet);
+		// second update and extraction come from cache
+		const uint64 Hits = TokenCache->GetHits();
+		FtrSpace->Update(RecSet); CacheFtrSpace->Update(RecSet);
+		CheckSameFtrSpace(FtrSpace, CacheFtrSpace, RecSet);
+		EXPECT_GE(TokenCache->GetHits(), Hits + 2 * (RecSet->GetRecs() / 7));
+		// changed text is tokenized again
+		const int TextFieldId = Store->GetFieldId("Text");
+		for (int RecN = 0; RecN < RecSet->GetRecs(); RecN += 7) {
+			Store->SetFieldStr(RecSet->GetRecId(RecN), TextFieldId, "brand new words in word1 record");
+		}
+		FtrSpace->Update(RecSet); CacheFtrSpace->Update(RecSet);
+		CheckSameFtrSpace(FtrSpace, CacheFtrSpace, RecSet);
+		TVec<TFltV> FullVV, CacheFullVV;
+		FtrSpace->GetFullVV(RecSet, FullVV, 0); CacheFtrSpace->GetFullVV(RecSet, CacheFullVV, 0);
+		EXPECT_EQ(FullVV, CacheFullVV);
+		// clearing the vocabulary invalidates vocabulary ids
+		CacheFtrSpace->Clr();
+		EXPECT_EQ(TokenCache->GetRecs(), (HashN == 0) ? 0 : RecSet->GetRecs());
+	}
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TFtrSpace, SimpleTokenizer) {
+	// scanning the text in place gives the same tokens as reading it as a stream
+	TStrV TextV;
+	TextV.Add("");
+	TextV.Add("  ,. ");
+	TextV.Add("Hello, World! The (quick) brown-fox jumps\nover\r\nthe lazy dog's tail...");
+	TextV.Add("a=b+c {x}[y] 50% $10 #tag @user back\\slash/slash\ttab Über");
+	TVec<PTokenizer> TokenizerV;
+	TokenizerV.Add(TTokenizers::TSimple::New());
+	TokenizerV.Add(TTokenizers::TSimple::New(NULL, NULL, false));
+	TokenizerV.Add(TTokenizers::TSimple::New(TSwSet::New(swstEn523), TStemmer::New(stmtPorter, false)));
+	TokenizerV.Add(TTokenizers::TSimple::New(TSwSet::New(swstEn523), TStemmer::New(stmtNone, false), false));
+	for (int TokenizerN = 0; TokenizerN < TokenizerV.Len(); TokenizerN++) {
+		for (int TextN = 0; TextN < TextV.Len(); TextN++) {
+			TStrV StrTokenV, SInTokenV;
+			TokenizerV[TokenizerN]->GetTokens(TextV[TextN], StrTokenV);
+			TokenizerV[TokenizerN]->GetTokens(TStrIn::New(TextV[TextN], false), SInTokenV);
+			EXPECT_EQ(StrTokenV, SInTokenV);
+		}
+	}
+}
+
+TEST(TFtrSpace, StemmerRealWord) {
+	// real word of a stem is the first word seen with it and does not change later
+	PStemmer Stemmer = TStemmer::New(stmtPorter, true);
+	EXPECT_EQ(Stemmer->GetStem("running"), "RUNNING");
+	EXPECT_EQ(Stemmer->GetStem("run"), "RUNNING");
+	EXPECT_EQ(Stemmer->GetStem("running"), "RUNNING");
+	EXPECT_EQ(Stemmer->GetStem("connected"), "CONNECTED");
+	EXPECT_EQ(Stemmer->GetStem("connecting"), "CONNECTED");
+}
+
+TEST(TFtrSpace, DISABLED_TokenCachePerf) {
+	const int Recs = 20000;
+	TWPt<TQm::TBase> Base = NewFtrSpaceBase(Recs);
+	TQm::PRecSet RecSet = Base->GetStoreByStoreNm("Docs")->GetAllRecs();
+	// tokenizer
+	TStrV TextV;
+	for (int RecN = 0; RecN < Recs; RecN++) { TextV.Add(RecSet->GetRec(RecN).GetFieldStr(0)); }
+	PTokenizer Tokenizer = TTokenizers::TSimple::New();
+	TTmStopWatch SInSw(true);
+	for (int TextN = 0; TextN < TextV.Len(); TextN++) {
+		TStrV TokenV; Tokenizer->GetTokens(TStrIn::New(TextV[TextN], false), TokenV);
+	}
+	SInSw.Stop();
+	TTmStopWatch StrSw(true);
+	for (int TextN = 0; TextN < TextV.Len(); TextN++) {
+		TStrV TokenV; Tokenizer->GetTokens(TextV[TextN], TokenV);
+	}
+	StrSw.Stop();
+	printf("tokenizer: stream %d ms, in place %d ms\n", SInSw.GetMSecInt(), StrSw.GetMSecInt());
+	// update once and extract three times, as when training several models
+	for (int CacheN = 0; CacheN < 2; CacheN++) {
+		TQm::PFtrSpace FtrSpace = NewFtrSpace(Base, (CacheN == 0) ? "" : ", \"tokenCache\": true");
+		TTmStopWatch UpdateSw(true);
+		FtrSpace->Update(RecSet);
+		UpdateSw.Stop();
+		TTmStopWatch ExtractSw(true);
+		for (int ExtractN = 0; ExtractN < 3; ExtractN++) {
+			TVec<TIntFltKdV> SpVV; FtrSpace->GetSpVV(RecSet, SpVV, 0);
+			EXPECT_EQ(SpVV.Len(), Recs);
+		}
+		ExtractSw.Stop();
+		printf("%s: update %d ms, 3x extract %d ms\n", (CacheN == 0) ? "no cache" : "token cache",
+			UpdateSw.GetMSecInt(), ExtractSw.GetMSecInt());
+	}
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TFtrSpace, DISABLED_ParallelPerf) {
+	const int Recs = 20000;
+	TWPt<TQm::TBase> Base = NewFtrSpaceBase(Recs);
+	TQm::PRecSet RecSet = Base->GetStoreByStoreNm("Docs")->GetAllRecs();
+	for (int Threads = 1; Threads <= 8; Threads *= 2) {
+		TQm::PFtrSpace FtrSpace = NewFtrSpace(Base);
+		TTmStopWatch UpdateSw(true);
+		FtrSpace->Update(RecSet, Threads);
+		UpdateSw.Stop();
+		TTmStopWatch ExtractSw(true);
+		TVec<TIntFltKdV> SpVV; FtrSpace->GetSpVV(RecSet, SpVV, -1, Threads);
+		ExtractSw.Stop();
+		EXPECT_EQ(SpVV.Len(), Recs);
+		TTmStopWatch SpMatSw(true);
+		TCscMatrix SpMat; FtrSpace->GetSpMat(RecSet, SpMat, -1, Threads);
+		SpMatSw.Stop();
+		EXPECT_EQ(SpMat.GetCols(), Recs);
+		printf("%d threads: update %d ms, extract %d ms, extract matrix %d ms, dim %d\n", Threads,
+			UpdateSw.GetMSecInt(), ExtractSw.GetMSecInt(), SpMatSw.GetMSecInt(), FtrSpace->GetDim());
+	}
+	TQmTest::CloseBase(Base);
+}
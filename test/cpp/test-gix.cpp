@@ -0,0 +1,320 @@
+/**
+* Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+* All rights reserved.
+*
+* This source code is licensed under the FreeBSD license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+#include <base.h>
+#include <mine.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Google Test
+#include "gtest/gtest.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Helpers
+
+namespace {
+
+const TStr GixTestFPath = "./data/gix/";
+
+typedef TKeyDat<TUInt64, TInt> TFullItem;
+typedef TGix<TInt, TFullItem> TFullGix;
+typedef TGixDefMerger<TInt, TFullItem> TFullMerger;
+
+typedef TGix<TInt, TUInt> TTinyGix;
+typedef TGixDefMerger<TInt, TUInt> TTinyMerger;
+
+// item without codec specialization, stored as plain vector
+typedef TKeyDat<TInt, TFlt> TPlainItem;
+typedef TGix<TInt, TPlainItem> TPlainGix;
+typedef TGixDefMerger<TInt, TPlainItem> TPlainMerger;
+
+void PrepareGixDir() {
+	if (TDir::Exists(GixTestFPath)) { TDir::DelNonEmptyDir(GixTestFPath); }
+	TDir::GenDirs(GixTestFPath);
+}
+
+// record ids with small random gaps, like postings of a frequent word
+void GenFullItemV(const int& Items, TVec<TFullItem>& ItemV) {
+	TRnd Rnd(1);
+	uint64 RecId = 1000000;
+	for (int ItemN = 0; ItemN < Items; ItemN++) {
+		RecId += 1 + Rnd.GetUniDevInt(20);
+		ItemV.Add(TFullItem(RecId, 1 + Rnd.GetUniDevInt(5)));
+	}
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Child vector encoding
+
+TEST(TGixCodec, FullItems) {
+	PrepareGixDir();
+	TFullMerger Merger;
+	TVec<TFullItem> ItemV; GenFullItemV(50000, ItemV);
+	{
+		TPt<TFullGix> Gix = TFullGix::New("Full", GixTestFPath, faCreate, &Merger, 100000000, 1024);
+		for (int ItemN = 0; ItemN < ItemV.Len(); ItemN++) { Gix->AddItem(1, ItemV[ItemN]); }
+		Gix->AddItem(2, TFullItem(7, -3));
+		Gix->Flush();
+		// read back from disk
+		TVec<TFullItem> ResV; Gix->GetItemV(1, ResV);
+		EXPECT_EQ(ResV, ItemV);
+		// postings take far less than plain vectors
+		const TGixStats& Stats = Gix->GetGixStats();
+		EXPECT_GT(Stats.ChildEncodedSize, (uint64)0);
+		EXPECT_GT(Stats.GetCompressionRatio(), 4.0);
+	}
+	{
+		// reopen and keep changing
+		TPt<TFullGix> Gix = TFullGix::New("Full", GixTestFPath, faUpdate, &Merger, 100000000, 1024);
+		// sizes of child vectors written before are kept with the index
+		EXPECT_GT(Gix->GetGixStats().GetCompressionRatio(), 4.0);
+		TVec<TFullItem> ResV; Gix->GetItemV(1, ResV);
+		EXPECT_EQ(ResV, ItemV);
+		ResV.Clr(); Gix->GetItemV(2, ResV);
+		ASSERT_EQ(ResV.Len(), 1);
+		EXPECT_EQ(ResV[0], TFullItem(7, -3));
+		// delete from encoded children and add new items
+		for (int ItemN = 0; ItemN < 3000; ItemN++) { Gix->DelItem(1, ItemV[ItemN]); }
+		Gix->AddItem(1, TFullItem(TUInt64::Mx - 1, 2));
+		Gix->Flush();
+		ResV.Clr(); Gix->GetItemV(1, ResV);
+		ASSERT_EQ(ResV.Len(), ItemV.Len() - 3000 + 1);
+		EXPECT_EQ(ResV[0], ItemV[3000]);
+		EXPECT_EQ(ResV.Last(), TFullItem(TUInt64::Mx - 1, 2));
+	}
+}
+
+TEST(TGixCodec, TinyItems) {
+	PrepareGixDir();
+	TTinyMerger Merger;
+	TVec<TUInt> ItemV;
+	for (uint RecId = 0; RecId < 20000; RecId++) { ItemV.Add(RecId * 3); }
+	{
+		TPt<TTinyGix> Gix = TTinyGix::New("Tiny", GixTestFPath, faCreate, &Merger, 100000000, 1024);
+		for (int ItemN = 0; ItemN < ItemV.Len(); ItemN++) { Gix->AddItem(1, ItemV[ItemN]); }
+	}
+	{
+		TPt<TTinyGix> Gix = TTinyGix::New("Tiny", GixTestFPath, faRdOnly, &Merger, 100000000, 1024);
+		TVec<TUInt> ResV; Gix->GetItemV(1, ResV);
+		EXPECT_EQ(ResV, ItemV);
+	}
+}
+
+TEST(TGixCodec, PlainItems) {
+	PrepareGixDir();
+	TPlainMerger Merger;
+	TVec<TPlainItem> ItemV;
+	for (int ItemN = 0; ItemN < 5000; ItemN++) { ItemV.Add(TPlainItem(ItemN, ItemN / 10.0)); }
+	{
+		TPt<TPlainGix> Gix = TPlainGix::New("Plain", GixTestFPath, faCreate, &Merger, 100000000, 1024);
+		for (int ItemN = 0; ItemN < ItemV.Len(); ItemN++) { Gix->AddItem(1, ItemV[ItemN]); }
+		Gix->Flush();
+		TVec<TPlainItem> ResV; Gix->GetItemV(1, ResV);
+		EXPECT_EQ(ResV, ItemV);
+		EXPECT_LE(Gix->GetGixStats().GetCompressionRatio(), 1.0);
+	}
+}
+
+TEST(TGixCodec, CacheMemory) {
+	PrepareGixDir();
+	TFullMerger Merger;
+	TVec<TFullItem> ItemV; GenFullItemV(200000, ItemV);
+	TPt<TFullGix> Gix = TFullGix::New("Full", GixTestFPath, faCreate, &Merger, 1000000000, 1024);
+	for (int ItemN = 0; ItemN < ItemV.Len(); ItemN++) { Gix->AddItem(1, ItemV[ItemN]); }
+	Gix->Flush();
+	// load the postings into cache and measure their footprint
+	TVec<TFullItem> ResV; Gix->GetItemV(1, ResV);
+	Gix->RefreshMemUsed();
+	const uint64 CacheSize = Gix->GetCacheSize();
+	const uint64 RawSize = ItemV.Len() * sizeof(TFullItem);
+	EXPECT_EQ(ResV, ItemV);
+	EXPECT_LT(CacheSize, RawSize / 2);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// AND queries over skewed posting lists
+
+namespace {
+
+typedef TGixExpItem<TInt, TFullItem> TFullExpItem;
+typedef TPt<TFullExpItem> PFullExpItem;
+
+// key 1 holds long posting list of all even record ids,
+// keys 2.. hold short lists with ids spread over the whole range
+void FillSkewedGix(const TPt<TFullGix>& Gix, const int& LongItems, const TIntV& ShortItemsV) {
+	for (int ItemN = 0; ItemN < LongItems; ItemN++) {
+		Gix->AddItem(1, TFullItem((uint64)ItemN * 2, 1));
+	}
+	TRnd Rnd(1);
+	for (int KeyN = 0; KeyN < ShortItemsV.Len(); KeyN++) {
+		for (int ItemN = 0; ItemN < ShortItemsV[KeyN]; ItemN++) {
+			Gix->AddItem(KeyN + 2, TFullItem((uint64)Rnd.GetUniDevInt(2 * LongItems), 1));
+		}
+	}
+	Gix->Flush();
+}
+
+// reference AND, computed from complete posting lists
+void GetAndItemV(const TPt<TFullGix>& Gix, const int& Key1, const int& Key2, TVec<TFullItem>& ResV) {
+	TVec<TFullItem> ItemV2; ResV.Clr();
+	Gix->GetItemV(Key1, ResV); Gix->GetItemV(Key2, ItemV2);
+	ResV.Intrs(ItemV2);
+}
+
+}
+
+TEST(TGixAnd, SkipChildren) {
+	PrepareGixDir();
+	TFullMerger Merger;
+	const int LongItems = 1000000;
+	{
+		TPt<TFullGix> Gix = TFullGix::New("And", GixTestFPath, faCreate, &Merger, 100000000, 1024);
+		FillSkewedGix(Gix, LongItems, TIntV::GetV(100));
+	}
+	TPt<TFullGix> Gix = TFullGix::New("And", GixTestFPath, faRdOnly, &Merger, 100000000, 1024);
+	// short list first and second
+	TVec<TFullItem> ResV;
+	TFullExpItem::NewAnd(TFullExpItem::NewItem(2), TFullExpItem::NewItem(1))->Eval(Gix, ResV, &Merger);
+	// only children overlapping with short list were touched
+	EXPECT_LT(Gix->GetItemSet(TInt(1))->GetLoadedPerc(), 0.2);
+	TVec<TFullItem> ResV2;
+	TFullExpItem::NewAnd(TFullExpItem::NewItem(1), TFullExpItem::NewItem(2))->Eval(Gix, ResV2, &Merger);
+	TVec<TFullItem> ExpectedV; GetAndItemV(Gix, 1, 2, ExpectedV);
+	EXPECT_GT(ExpectedV.Len(), 0);
+	EXPECT_EQ(ResV, ExpectedV);
+	EXPECT_EQ(ResV2, ExpectedV);
+	// negation on either side
+	TVec<TFullItem> ShortV, LongV, MinusV;
+	Gix->GetItemV(2, ShortV); Gix->GetItemV(1, LongV);
+	ShortV.Diff(LongV, MinusV);
+	ResV.Clr();
+	TFullExpItem::NewAnd(TFullExpItem::NewNot(TFullExpItem::NewItem(1)), TFullExpItem::NewItem(2))->Eval(Gix, ResV, &Merger);
+	EXPECT_EQ(ResV, MinusV);
+	ResV.Clr();
+	TFullExpItem::NewAnd(TFullExpItem::NewItem(2), TFullExpItem::NewNot(TFullExpItem::NewItem(1)))->Eval(Gix, ResV, &Merger);
+	EXPECT_EQ(ResV, MinusV);
+	// missing key
+	ResV.Clr();
+	TFullExpItem::NewAnd(TFullExpItem::NewItem(1), TFullExpItem::NewItem(100))->Eval(Gix, ResV, &Merger);
+	EXPECT_TRUE(ResV.Empty());
+}
+
+TEST(TGixAnd, NestedQuery) {
+	PrepareGixDir();
+	TFullMerger Merger;
+	TPt<TFullGix> Gix = TFullGix::New("And", GixTestFPath, faCreate, &Merger, 100000000, 1024);
+	FillSkewedGix(Gix, 200000, TIntV::GetV(20000, 5000, 300));
+	// ((1 AND 2) AND (3 OR 4))
+	PFullExpItem ExpItem = TFullExpItem::NewAnd(
+		TFullExpItem::NewAnd(TFullExpItem::NewItem(1), TFullExpItem::NewItem(2)),
+		TFullExpItem::NewOr(TFullExpItem::NewItem(3), TFullExpItem::NewItem(4)));
+	TVec<TFullItem> ResV; ExpItem->Eval(Gix, ResV, &Merger);
+	TVec<TFullItem> ExpectedV, ItemV3, ItemV4;
+	GetAndItemV(Gix, 1, 2, ExpectedV);
+	Gix->GetItemV(3, ItemV3); Gix->GetItemV(4, ItemV4);
+	ItemV3.Union(ItemV4); ExpectedV.Intrs(ItemV3);
+	EXPECT_EQ(ResV, ExpectedV);
+	// AND over many keys
+	TVec<TInt> KeyV = TIntV::GetV(1, 2, 3);
+	ResV.Clr(); TFullExpItem::NewAndV(KeyV)->Eval(Gix, ResV, &Merger);
+	GetAndItemV(Gix, 1, 2, ExpectedV);
+	ItemV3.Clr(); Gix->GetItemV(3, ItemV3); ExpectedV.Intrs(ItemV3);
+	EXPECT_EQ(ResV, ExpectedV);
+}
+
+TEST(TGixAnd, DISABLED_SkewedPerf) {
+	PrepareGixDir();
+	TFullMerger Merger;
+	const int LongItems = 2000000;
+	const TIntV ShortItemsV = TIntV::GetV(10, 100, 1000, 10000, 100000);
+	{
+		TPt<TFullGix> Gix = TFullGix::New("And", GixTestFPath, faCreate, &Merger, 200000000, 1024);
+		FillSkewedGix(Gix, LongItems, ShortItemsV);
+	}
+	for (int KeyN = 0; KeyN < ShortItemsV.Len(); KeyN++) {
+		const int Key = KeyN + 2;
+		// cold cache for each measurement
+		TTmStopWatch FullSw, SkipSw;
+		TVec<TFullItem> ExpectedV, ResV;
+		{
+			TPt<TFullGix> Gix = TFullGix::New("And", GixTestFPath, faRdOnly, &Merger, 200000000, 1024);
+			FullSw.Start(); GetAndItemV(Gix, 1, Key, ExpectedV); FullSw.Stop();
+		}
+		{
+			TPt<TFullGix> Gix = TFullGix::New("And", GixTestFPath, faRdOnly, &Merger, 200000000, 1024);
+			PFullExpItem ExpItem = TFullExpItem::NewAnd(TFullExpItem::NewItem(1), TFullExpItem::NewItem(Key));
+			SkipSw.Start(); ExpItem->Eval(Gix, ResV, &Merger); SkipSw.Stop();
+		}
+		EXPECT_EQ(ResV, ExpectedV);
+		printf("AND %d x %d: %.1f ms full scan, %.1f ms with skipping\n", LongItems,
+			ShortItemsV[KeyN].Val, FullSw.GetMSec(), SkipSw.GetMSec());
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Deleting oldest items
+
+TEST(TGixDelete, ItemsBefore) {
+	PrepareGixDir();
+	TFullMerger Merger;
+	TVec<TFullItem> ItemV; GenFullItemV(50000, ItemV);
+	{
+		TPt<TFullGix> Gix = TFullGix::New("Front", GixTestFPath, faCreate, &Merger, 100000000, 1024);
+		for (int ItemN = 0; ItemN < ItemV.Len(); ItemN++) { Gix->AddItem(1, ItemV[ItemN]); }
+		Gix->AddItem(2, TFullItem(ItemV[10].Key, 1));
+		Gix->Flush();
+		// pending delete in the work buffer is applied before the cut
+		Gix->DelItem(1, ItemV[30000]);
+		// bound inside a child vector
+		const TFullItem Bound(ItemV[20000].Key + 1, 0);
+		Gix->DelItemsBefore(1, Bound);
+		TVec<TFullItem> ResV; Gix->GetItemV(1, ResV);
+		ASSERT_EQ(ResV.Len(), ItemV.Len() - 20001 - 1);
+		EXPECT_EQ(ResV[0], ItemV[20001]);
+		EXPECT_EQ(ResV.Last(), ItemV.Last());
+		EXPECT_FALSE(ResV.IsIn(ItemV[30000]));
+		// item set with only older items is removed
+		Gix->DelItemsBefore(2, Bound);
+		EXPECT_FALSE(Gix->IsKey(2));
+		// new items still go to the end
+		Gix->AddItem(1, TFullItem(TUInt64::Mx - 1, 1));
+	}
+	{
+		TPt<TFullGix> Gix = TFullGix::New("Front", GixTestFPath, faUpdate, &Merger, 100000000, 1024);
+		TVec<TFullItem> ResV; Gix->GetItemV(1, ResV);
+		ASSERT_EQ(ResV.Len(), ItemV.Len() - 20001);
+		EXPECT_EQ(ResV[0], ItemV[20001]);
+		EXPECT_EQ(ResV.Last(), TFullItem(TUInt64::Mx - 1, 1));
+		// cut everything
+		Gix->DelItemsBefore(1, TFullItem(TUInt64::Mx, 0));
+		EXPECT_FALSE(Gix->IsKey(1));
+	}
+}
+
+TEST(TGixDelete, DirtyBytes) {
+	// dirty byte count follows item set changes and flushes
+	PrepareGixDir();
+	TFullMerger Merger;
+	TVec<TFullItem> ItemV; GenFullItemV(10000, ItemV);
+	TPt<TFullGix> Gix = TFullGix::New("Dirty", GixTestFPath, faCreate, &Merger, 100000000, 1024);
+	EXPECT_EQ(Gix->GetDirtyBytes(), 0);
+	for (int ItemN = 0; ItemN < ItemV.Len(); ItemN++) { Gix->AddItem(1 + ItemN % 3, ItemV[ItemN]); }
+	EXPECT_GT(Gix->GetDirtyBytes(), 0);
+	Gix->Flush();
+	EXPECT_EQ(Gix->GetDirtyBytes(), 0);
+	Gix->DelItem(1, ItemV[0]);
+	EXPECT_GT(Gix->GetDirtyBytes(), 0);
+	Gix->Flush();
+	EXPECT_EQ(Gix->GetDirtyBytes(), 0);
+	// removed item set is no longer counted
+	Gix->AddItem(2, TFullItem(ItemV.Last().Key + 1, 1));
+	Gix->DelItemsBefore(2, TFullItem(TUInt64::Mx, 0));
+	EXPECT_FALSE(Gix->IsKey(2));
+	EXPECT_EQ(Gix->GetDirtyBytes(), 0);
+}
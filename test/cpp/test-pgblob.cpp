@@ -0,0 +1,444 @@
+/**
+* Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+* All rights reserved.
+*
+* This source code is licensed under the FreeBSD license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+#include <base.h>
+#include <mine.h>
+#include <qminer.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Google Test
+#include "gtest/gtest.h"
+
+#include "test-qminer.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Helpers
+
+namespace {
+
+const TStr PgBlobTestFPath = "./data/pgblob/";
+
+// blob content is derived from its number, so it can be checked without a copy
+void GenBlob(const int& BlobN, const int& BlobLen, TMem& Mem) {
+	Mem.Clr();
+	for (int ChN = 0; ChN < BlobLen; ChN++) { Mem += (char)((BlobN + ChN) % 251); }
+}
+
+bool IsBlob(const PPgBlob& Blob, const TPgBlobPt& Pt, const int& BlobN, const int& BlobLen) {
+	TMemBase MemBase = Blob->GetMemBase(Pt);
+	if (MemBase.Len() != BlobLen) { return false; }
+	const char* Bf = MemBase.GetBf();
+	for (int ChN = 0; ChN < BlobLen; ChN++) {
+		if (Bf[ChN] != (char)((BlobN + ChN) % 251)) { return false; }
+	}
+	return true;
+}
+
+// fills the storage with blobs of random length, some of them rewritten or deleted
+void FillBlob(const PPgBlob& Blob, const int& Blobs, TVec<TPgBlobPt>& PtV, TIntV& LenV) {
+	TRnd Rnd(1); TMem Mem;
+	for (int BlobN = 0; BlobN < Blobs; BlobN++) {
+		const int BlobLen = 1 + Rnd.GetUniDevInt(500);
+		GenBlob(BlobN, BlobLen, Mem);
+		PtV.Add(Blob->Put(Mem.GetBf(), Mem.Len()));
+		LenV.Add(BlobLen);
+	}
+	for (int BlobN = 0; BlobN < Blobs; BlobN += 3) {
+		const int BlobLen = 1 + Rnd.GetUniDevInt(2000);
+		GenBlob(BlobN, BlobLen, Mem);
+		PtV[BlobN] = Blob->Put(Mem.GetBf(), Mem.Len(), PtV[BlobN]);
+		LenV[BlobN] = BlobLen;
+	}
+	for (int BlobN = 1; BlobN < Blobs; BlobN += 5) {
+		Blob->Del(PtV[BlobN]);
+		LenV[BlobN] = -1;
+	}
+}
+
+void CheckBlob(const PPgBlob& Blob, const TVec<TPgBlobPt>& PtV, const TIntV& LenV) {
+	for (int BlobN = 0; BlobN < PtV.Len(); BlobN++) {
+		if (LenV[BlobN] < 0) { continue; }
+		ASSERT_TRUE(IsBlob(Blob, PtV[BlobN], BlobN, LenV[BlobN]));
+	}
+}
+
+// cache entry of fixed size
+ClassTP(TCacheDat, PCacheDat)//{
+public:
+	static PCacheDat New() { return new TCacheDat; }
+	uint64 GetMemUsed() const { return 100; }
+	void OnDelFromCache(const TInt& Key, void* RefToBs) { }
+};
+typedef TCache<TInt, PCacheDat> TIntCache;
+
+// cache entry that grows after it is added to the cache
+ClassTP(TGrowCacheDat, PGrowCacheDat)//{
+private:
+	TInt MemUsed;
+public:
+	TGrowCacheDat(): MemUsed(100) { }
+	static PGrowCacheDat New() { return new TGrowCacheDat; }
+	uint64 GetMemUsed() const { return MemUsed; }
+	void Grow(const int& Mem) { MemUsed += Mem; }
+	void OnDelFromCache(const TInt& Key, void* RefToBs) { }
+};
+typedef TCache<TInt, PGrowCacheDat> TIntGrowCache;
+
+// read through the cache, entries loaded for the first time grow afterwards
+void ReadGrowKey(TIntGrowCache& Cache, const int& Key) {
+	PGrowCacheDat Dat;
+	if (!Cache.Lookup(Key, Dat)) {
+		Cache.Put(Key, TGrowCacheDat::New());
+		Cache.Get(Key, Dat); Dat->Grow(50);
+	}
+}
+
+// cache holding 100 entries
+const int64 CacheMxMem = 100 * (sizeof(TInt) + 100);
+
+// read through the cache, loading missing entries
+void ReadKey(TIntCache& Cache, const int& Key) {
+	PCacheDat Dat;
+	if (!Cache.Lookup(Key, Dat)) { Cache.Put(Key, TCacheDat::New()); }
+}
+
+template <class TCacheT>
+int GetKeys(TCacheT& Cache, const int& MnKey, const int& MxKey) {
+	int Keys = 0;
+	for (int Key = MnKey; Key <= MxKey; Key++) { Keys += Cache.IsKey(Key) ? 1 : 0; }
+	return Keys;
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Page backends
+
+TEST(TPgBlob, Backend) {
+	EXPECT_EQ(TPgBlob::GetBackendStr(pbbMmap), "mmap");
+	EXPECT_EQ(TPgBlob::GetBackend("cache"), pbbCache);
+	EXPECT_ANY_THROW(TPgBlob::GetBackend("disk"));
+}
+
+TEST(TPgBlob, MmapReopen) {
+	const TPgBlobBackend BackendV[] = { pbbCache, pbbMmap };
+	for (int CreateN = 0; CreateN < 2; CreateN++) {
+		for (int OpenN = 0; OpenN < 2; OpenN++) {
+			TQmTest::NewDir(PgBlobTestFPath);
+			const TStr FNm = PgBlobTestFPath + "blob";
+			TVec<TPgBlobPt> PtV; TIntV LenV; TPgBlobPt NewPt;
+			{
+				// small cache, so pages get evicted in cache mode
+				PPgBlob Blob = TPgBlob::Create(FNm, 8 * PG_PAGE_SIZE, BackendV[CreateN]);
+				FillBlob(Blob, 10000, PtV, LenV);
+				CheckBlob(Blob, PtV, LenV);
+			}
+			{
+				PPgBlob Blob = TPgBlob::Open(FNm, 8 * PG_PAGE_SIZE, BackendV[OpenN]);
+				CheckBlob(Blob, PtV, LenV);
+				// keep writing after reopen
+				TMem Mem; GenBlob(0, 100, Mem);
+				NewPt = Blob->Put(Mem.GetBf(), Mem.Len());
+			}
+			{
+				PPgBlob Blob = new TPgBlob(FNm, faRdOnly, 8 * PG_PAGE_SIZE, pbbMmap, pbaRandom);
+				EXPECT_EQ(Blob->GetBackend(), pbbMmap);
+				CheckBlob(Blob, PtV, LenV);
+				EXPECT_TRUE(IsBlob(Blob, NewPt, 0, 100));
+				EXPECT_EQ(Blob->GetStats()->GetObjStr("backend"), "mmap");
+			}
+		}
+	}
+}
+
+TEST(TPgBlob, DISABLED_MmapPerf) {
+	const int Blobs = 200000, BlobLen = 100, Reads = 1000000;
+	TQmTest::NewDir(PgBlobTestFPath);
+	const TStr FNm = PgBlobTestFPath + "perf";
+	TVec<TPgBlobPt> PtV;
+	{
+		PPgBlob Blob = TPgBlob::Create(FNm);
+		TMem Mem;
+		for (int BlobN = 0; BlobN < Blobs; BlobN++) {
+			GenBlob(BlobN, BlobLen, Mem);
+			PtV.Add(Blob->Put(Mem.GetBf(), Mem.Len()));
+		}
+	}
+	// read-only with cache smaller than the data, as with large stores
+	const TPgBlobBackend BackendV[] = { pbbCache, pbbMmap };
+	for (int BackendN = 0; BackendN < 2; BackendN++) {
+		PPgBlob Blob = new TPgBlob(FNm, faRdOnly, TNum<int>::Mega, BackendV[BackendN]);
+		TTmStopWatch SeqSw(true);
+		Blob->SetAccessHint(pbaSequential);
+		uint64 Sum = 0;
+		for (int BlobN = 0; BlobN < Blobs; BlobN++) {
+			Sum += (uchar)Blob->Get(PtV[BlobN]).GetBfAddr()[0];
+		}
+		SeqSw.Stop();
+		TTmStopWatch RndSw(true);
+		Blob->SetAccessHint(pbaRandom);
+		TRnd Rnd(1);
+		for (int ReadN = 0; ReadN < Reads; ReadN++) {
+			Sum += (uchar)Blob->Get(PtV[Rnd.GetUniDevInt(Blobs)]).GetBfAddr()[0];
+		}
+		RndSw.Stop();
+		EXPECT_TRUE(Sum > 0);
+		printf("%s: sequential %d ms, random %d ms\n",
+			TPgBlob::GetBackendStr(BackendV[BackendN]).CStr(),
+			SeqSw.GetMSecInt(), RndSw.GetMSecInt());
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Cache policies
+
+TEST(TCache, Policy) {
+	EXPECT_EQ(TCachePolicyStr::GetStr(cp2Q), "2q");
+	EXPECT_EQ(TCachePolicyStr::GetPolicy("lru"), cpLru);
+	EXPECT_ANY_THROW(TCachePolicyStr::GetPolicy("arc"));
+}
+
+TEST(TCache, Scan) {
+	const TCachePolicy PolicyV[] = { cpLru, cp2Q };
+	for (int PolicyN = 0; PolicyN < 2; PolicyN++) {
+		TIntCache Cache(CacheMxMem, 1024, NULL, PolicyV[PolicyN]);
+		for (int RoundN = 0; RoundN < 3; RoundN++) {
+			for (int Key = 0; Key < 50; Key++) { ReadKey(Cache, Key); }
+		}
+		EXPECT_EQ(Cache.GetMisses(), 50);
+		EXPECT_EQ(Cache.GetHits(), 100);
+		// entries read by a scan are dropped first
+		Cache.StartScan();
+		for (int Key = 1000; Key < 2000; Key++) { ReadKey(Cache, Key); }
+		Cache.EndScan();
+		EXPECT_EQ(GetKeys(Cache, 0, 49), 50);
+		EXPECT_EQ(Cache.Len(), 100);
+	}
+}
+
+TEST(TCache, ScanResistant2Q) {
+	const TCachePolicy PolicyV[] = { cpLru, cp2Q };
+	for (int PolicyN = 0; PolicyN < 2; PolicyN++) {
+		TIntCache Cache(CacheMxMem, 1024, NULL, PolicyV[PolicyN]);
+		// hot entries mixed with entries read only once
+		int ColdKey = 1000;
+		for (int RoundN = 0; RoundN < 10; RoundN++) {
+			for (int Key = 0; Key < 50; Key++) { ReadKey(Cache, Key); }
+			for (int KeyN = 0; KeyN < 50; KeyN++) { ReadKey(Cache, ColdKey++); }
+		}
+		// burst of entries read once, without a scan hint
+		for (int KeyN = 0; KeyN < 500; KeyN++) { ReadKey(Cache, ColdKey++); }
+		EXPECT_EQ(GetKeys(Cache, 0, 49), (PolicyV[PolicyN] == cp2Q) ? 50 : 0);
+		EXPECT_TRUE(Cache.GetCurMemUsed() <= Cache.GetMxMemUsed());
+		// entries are kept when switching policy
+		const int Len = Cache.Len();
+		Cache.SetPolicy(cpLru);
+		EXPECT_EQ(Cache.Len(), Len);
+		for (int Key = 0; Key < 50; Key++) { ReadKey(Cache, Key); }
+	}
+}
+
+TEST(TCache, ScanResistant2QGrow) {
+	TIntGrowCache Cache(CacheMxMem, 1024, NULL, cp2Q);
+	// hot entries mixed with entries read only once, all growing after they are added
+	int ColdKey = 1000;
+	for (int RoundN = 0; RoundN < 10; RoundN++) {
+		for (int Key = 0; Key < 50; Key++) { ReadGrowKey(Cache, Key); }
+		for (int KeyN = 0; KeyN < 50; KeyN++) { ReadGrowKey(Cache, ColdKey++); }
+	}
+	const int HotKeys = GetKeys(Cache, 0, 49);
+	EXPECT_TRUE(HotKeys > 40);
+	// burst of entries read once keeps the hot set
+	for (int KeyN = 0; KeyN < 2000; KeyN++) { ReadGrowKey(Cache, ColdKey++); }
+	EXPECT_EQ(GetKeys(Cache, 0, 49), HotKeys);
+	// memory is released as counted, so the cache does not grow past its size
+	EXPECT_TRUE(Cache.Len() <= 100);
+}
+
+TEST(TPgBlob, CachePolicy) {
+	TQmTest::NewDir(PgBlobTestFPath);
+	const TStr FNm = PgBlobTestFPath + "policy";
+	TVec<TPgBlobPt> PtV;
+	{
+		PPgBlob Blob = TPgBlob::Create(FNm);
+		TMem Mem;
+		for (int BlobN = 0; BlobN < 4000; BlobN++) {
+			GenBlob(BlobN, 1000, Mem);
+			PtV.Add(Blob->Put(Mem.GetBf(), Mem.Len()));
+		}
+	}
+	const TCachePolicy PolicyV[] = { cpLru, cp2Q };
+	for (int PolicyN = 0; PolicyN < 2; PolicyN++) {
+		PPgBlob Blob = new TPgBlob(FNm, faRdOnly, 32 * PG_PAGE_SIZE);
+		Blob->SetCachePolicy(PolicyV[PolicyN]);
+		// hot records fit in a few pages
+		for (int RoundN = 0; RoundN < 3; RoundN++) {
+			for (int BlobN = 0; BlobN < 50; BlobN++) { ASSERT_TRUE(IsBlob(Blob, PtV[BlobN], BlobN, 1000)); }
+		}
+		const uint64 Misses = Blob->GetCacheMisses();
+		Blob->StartScan();
+		for (int BlobN = 0; BlobN < PtV.Len(); BlobN++) { ASSERT_TRUE(IsBlob(Blob, PtV[BlobN], BlobN, 1000)); }
+		Blob->EndScan();
+		const uint64 ScanMisses = Blob->GetCacheMisses();
+		EXPECT_TRUE(ScanMisses > Misses);
+		// hot pages survived the scan
+		for (int BlobN = 0; BlobN < 50; BlobN++) { ASSERT_TRUE(IsBlob(Blob, PtV[BlobN], BlobN, 1000)); }
+		EXPECT_EQ(Blob->GetCacheMisses(), ScanMisses);
+		PJsonVal StatsVal = Blob->GetStats();
+		EXPECT_EQ(StatsVal->GetObjStr("policy"), TCachePolicyStr::GetStr(PolicyV[PolicyN]));
+		EXPECT_EQ(StatsVal->GetObjNum("loaded_pages"), 32);
+		EXPECT_TRUE(StatsVal->GetObjNum("hit_rate") > 0.5);
+	}
+}
+
+TEST(TPgBlob, CachePolicyWrite) {
+	// pages are written back correctly when evicted from either list
+	TQmTest::NewDir(PgBlobTestFPath);
+	const TStr FNm = PgBlobTestFPath + "blob";
+	TVec<TPgBlobPt> PtV; TIntV LenV;
+	{
+		PPgBlob Blob = TPgBlob::Create(FNm, 8 * PG_PAGE_SIZE);
+		Blob->SetCachePolicy(cp2Q);
+		FillBlob(Blob, 10000, PtV, LenV);
+		CheckBlob(Blob, PtV, LenV);
+	}
+	{
+		PPgBlob Blob = TPgBlob::Open(FNm, 8 * PG_PAGE_SIZE);
+		Blob->SetCachePolicy(cp2Q);
+		CheckBlob(Blob, PtV, LenV);
+	}
+}
+
+TEST(TPgBlob, DirtyBytes) {
+	// counted dirty pages match the pages flagged as dirty
+	TQmTest::NewDir(PgBlobTestFPath);
+	PPgBlob Blob = TPgBlob::Create(PgBlobTestFPath + "blob", 8 * PG_PAGE_SIZE);
+	TVec<TPgBlobPt> PtV; TIntV LenV;
+	FillBlob(Blob, 5000, PtV, LenV);
+	EXPECT_GT(Blob->GetDirtyBytes(), 0);
+	EXPECT_EQ(Blob->GetDirtyBytes(), (uint64)Blob->GetStats()->GetObjInt("dirty_pages") * PG_PAGE_SIZE);
+	Blob->PartialFlush(TInt::Mx);
+	EXPECT_EQ(Blob->GetDirtyBytes(), 0);
+	// changing records in place
+	for (int BlobN = 0; BlobN < 100; BlobN++) { Blob->SetDirty(PtV[BlobN]); }
+	EXPECT_EQ(Blob->GetDirtyBytes(), (uint64)Blob->GetStats()->GetObjInt("dirty_pages") * PG_PAGE_SIZE);
+	Blob->Flush();
+	EXPECT_EQ(Blob->GetDirtyBytes(), 0);
+	EXPECT_EQ(Blob->GetStats()->GetObjInt("dirty_pages"), 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Paged store
+
+TEST(TStorePbBlob, MmapBackend) {
+	PJsonVal SchemaVal = TJsonVal::GetValFromStr(
+		"[{ \"name\": \"Docs\", \"options\": { \"type\": \"paged\", \"backend\": \"mmap\" }, \"fields\": ["
+		"  { \"name\": \"Name\", \"type\": \"string\", \"primary\": true },"
+		"  { \"name\": \"Text\", \"type\": \"string\", \"store\": \"cache\" }"
+		"]}]");
+	{
+		TWPt<TQm::TBase> Base = TQmTest::NewBase(PgBlobTestFPath, SchemaVal);
+		TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Docs");
+		for (int RecN = 0; RecN < 1000; RecN++) {
+			PJsonVal RecVal = TJsonVal::NewObj();
+			RecVal->AddToObj("Name", "doc" + TInt::GetStr(RecN));
+			RecVal->AddToObj("Text", "text of document " + TInt::GetStr(RecN));
+			Store->AddRec(RecVal);
+		}
+		EXPECT_EQ(Store->GetStats()->GetObjKey("blob_storage")->GetObjStr("backend"), "mmap");
+		TQmTest::CloseBase(Base);
+	}
+	{
+		// backend is remembered when the base is loaded
+		TWPt<TQm::TBase> Base = TQm::TStorage::LoadBase(PgBlobTestFPath, faRdOnly, 1024 * 1024, 1024 * 1024);
+		TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Docs");
+		EXPECT_EQ(Store->GetStats()->GetObjKey("blob_storage")->GetObjStr("backend"), "mmap");
+		const int TextId = Store->GetFieldId("Text");
+		for (uint64 RecId = 0; RecId < 1000; RecId++) {
+			EXPECT_EQ(Store->GetFieldStr(RecId, TextId), "text of document " + TUInt64::GetStr(RecId));
+		}
+		Base.Del();
+	}
+}
+
+TEST(TStorePbBlob, ScanIter) {
+	PJsonVal SchemaVal = TJsonVal::GetValFromStr(
+		"[{ \"name\": \"Docs\", \"options\": { \"type\": \"paged\" }, \"fields\": ["
+		"  { \"name\": \"Text\", \"type\": \"string\", \"store\": \"cache\" }"
+		"]}]");
+	TWPt<TQm::TBase> Base = TQmTest::NewBase(PgBlobTestFPath, SchemaVal, 1024 * 1024, 64 * PG_PAGE_SIZE);
+	Base->SetCachePolicy(cp2Q);
+	TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Docs");
+	const int TextId = Store->GetFieldId("Text");
+	for (int RecN = 0; RecN < 5000; RecN++) {
+		PJsonVal RecVal = TJsonVal::NewObj();
+		RecVal->AddToObj("Text", TStr::GetSpaceStr(500) + TInt::GetStr(RecN));
+		Store->AddRec(RecVal);
+	}
+	// scan iterator goes over the same records as regular one
+	TUInt64V RecIdV; Store->GetRecIdV(RecIdV);
+	TQm::PStoreIter Iter = Store->GetScanIter();
+	int RecN = 0;
+	while (Iter->Next()) {
+		ASSERT_EQ(Iter->GetRecId(), RecIdV[RecN].Val);
+		EXPECT_EQ(Store->GetFieldStr(Iter->GetRecId(), TextId), TStr::GetSpaceStr(500) + TInt::GetStr(RecN));
+		RecN++;
+	}
+	EXPECT_EQ(RecN, RecIdV.Len());
+	Iter.Clr();
+	PJsonVal StatsVal = Base->GetStats();
+	EXPECT_EQ(StatsVal->GetObjStr("cache_policy"), "2q");
+	EXPECT_EQ(StatsVal->GetObjKey("stores")->GetArrVal(0)->GetObjKey("blob_storage")->GetObjStr("policy"), "2q");
+	EXPECT_TRUE(StatsVal->GetObjKey("gix_stats")->IsObjKey("cache_hit_rate"));
+	Base.Del();
+}
+
+TEST(TStorePbBlob, BackgroundFlush) {
+	PJsonVal SchemaVal = TJsonVal::GetValFromStr(
+		"[{ \"name\": \"Docs\", \"options\": { \"type\": \"paged\" }, \"fields\": ["
+		"  { \"name\": \"Tag\", \"type\": \"string\" },"
+		"  { \"name\": \"Text\", \"type\": \"string\", \"store\": \"cache\" }"
+		"], \"keys\": [{ \"field\": \"Tag\", \"type\": \"value\" }] }]");
+	{
+		TWPt<TQm::TBase> Base = TQmTest::NewBase(PgBlobTestFPath, SchemaVal);
+		// flush everything, check often
+		Base->StartFlusher(TQm::TBaseFlusherParam(0, 0, 10, 20));
+		EXPECT_TRUE(Base->IsFlusher());
+		TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Docs");
+		for (int RecN = 0; RecN < 2000; RecN++) {
+			PJsonVal RecVal = TJsonVal::NewObj();
+			RecVal->AddToObj("Tag", "tag" + TInt::GetStr(RecN % 10));
+			RecVal->AddToObj("Text", "text of document " + TInt::GetStr(RecN));
+			Store->AddRec(RecVal);
+		}
+		// flusher catches up once writes stop
+		for (int WaitN = 0; WaitN < 500 && Base->GetDirtyBytes() > 0; WaitN++) {
+			TSysProc::Sleep(10);
+		}
+		EXPECT_EQ(Base->GetDirtyBytes(), 0);
+		PJsonVal FlusherVal = Base->GetStats()->GetObjKey("flusher");
+		EXPECT_GT(FlusherVal->GetObjUInt64("slices"), 0);
+		EXPECT_GT(FlusherVal->GetObjUInt64("flushed_bytes"), 0);
+		// records can still be changed after they were flushed
+		Store->SetFieldStr(0, Store->GetFieldId("Text"), "changed");
+		TQmTest::CloseBase(Base);
+	}
+	{
+		TWPt<TQm::TBase> Base = TQm::TStorage::LoadBase(PgBlobTestFPath, faRdOnly, 1024 * 1024, 1024 * 1024);
+		TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Docs");
+		const int TextId = Store->GetFieldId("Text");
+		EXPECT_EQ(Store->GetRecs(), 2000);
+		EXPECT_EQ(Store->GetFieldStr(0, TextId), "changed");
+		for (uint64 RecId = 1; RecId < 2000; RecId++) {
+			EXPECT_EQ(Store->GetFieldStr(RecId, TextId), "text of document " + TUInt64::GetStr(RecId));
+		}
+		TQm::PRecSet RecSet = Base->Search("{ \"$from\": \"Docs\", \"Tag\": \"tag3\" }");
+		EXPECT_EQ(RecSet->GetRecs(), 200);
+		Base.Del();
+	}
+}
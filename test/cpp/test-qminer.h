@@ -0,0 +1,47 @@
+/**
+* Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+* All rights reserved.
+*
+* This source code is licensed under the FreeBSD license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+#ifndef TEST_QMINER_H
+#define TEST_QMINER_H
+
+#include <base.h>
+#include <qminer.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Shared fixtures for tests working on a QMiner base
+
+namespace TQmTest {
+
+/// Initialize QMiner environment once, with logging turned off
+inline void InitEnv() {
+	if (!TQm::TEnv::IsInit()) { TQm::TEnv::Init(); TQm::TEnv::InitLogger(0, "null"); }
+}
+
+/// Create empty directory, removing what was left there by previous runs
+inline void NewDir(const TStr& FPath) {
+	if (TDir::Exists(FPath)) { TDir::DelNonEmptyDir(FPath); }
+	TDir::GenDirs(FPath);
+}
+
+/// Create new base with given schema in an empty directory
+inline TWPt<TQm::TBase> NewBase(const TStr& FPath, const PJsonVal& SchemaVal,
+		const uint64& IndexCacheSize = 1024 * 1024, const uint64& StoreCacheSize = 1024 * 1024) {
+
+	InitEnv(); NewDir(FPath);
+	return TQm::TStorage::NewBase(FPath, SchemaVal, IndexCacheSize, StoreCacheSize, true);
+}
+
+/// Save base to disk and close it
+inline void CloseBase(TWPt<TQm::TBase>& Base) {
+	TQm::TStorage::SaveBase(Base);
+	Base.Del();
+}
+
+}
+
+#endif
@@ -0,0 +1,566 @@
+/**
+* Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+* All rights reserved.
+*
+* This source code is licensed under the FreeBSD license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+#include <base.h>
+#include <mine.h>
+#include <qminer.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Google Test
+#include "gtest/gtest.h"
+
+#include "test-qminer.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Helpers
+
+namespace {
+
+const TStr QueryTestFPath = "./data/query/";
+
+// store with inverted and b-tree indexed fields
+PJsonVal GetQuerySchema() {
+	return TJsonVal::GetValFromStr(
+		"[{ \"name\": \"Items\", \"fields\": ["
+		"  { \"name\": \"Name\", \"type\": \"string\", \"primary\": true },"
+		"  { \"name\": \"Category\", \"type\": \"string\" },"
+		"  { \"name\": \"Tag\", \"type\": \"string\" },"
+		"  { \"name\": \"Count\", \"type\": \"int\" },"
+		"  { \"name\": \"Value\", \"type\": \"float\" }"
+		"], \"keys\": ["
+		"  { \"field\": \"Category\", \"type\": \"value\" },"
+		"  { \"field\": \"Tag\", \"type\": \"value\" },"
+		"  { \"field\": \"Count\", \"type\": \"linear\" },"
+		"  { \"field\": \"Value\", \"type\": \"linear\", \"leafCapacity\": 16, \"fillFactor\": 0.9 }"
+		"]}, { \"name\": \"Logs\", \"fields\": ["
+		"  { \"name\": \"Msg\", \"type\": \"string\" },"
+		"  { \"name\": \"Level\", \"type\": \"int\", \"null\": true }"
+		"], \"keys\": ["
+		"  { \"field\": \"Msg\", \"type\": \"value\" }"
+		"]}]");
+}
+
+// record fields are derived from record number
+TStr GetCategory(const int& RecN) { return "cat" + TInt::GetStr(RecN % 10); }
+TStr GetTag(const int& RecN) { return (RecN % 1000 == 7) ? "rare" : "common"; }
+int GetCount(const int& RecN) { return RecN; }
+double GetValue(const int& RecN) { return (double)((RecN * 7) % 1000) / 10.0; }
+
+PJsonVal GetQueryRec(const int& RecN) {
+	PJsonVal RecVal = TJsonVal::NewObj();
+	RecVal->AddToObj("Name", "rec" + TInt::GetStr(RecN));
+	RecVal->AddToObj("Category", GetCategory(RecN));
+	RecVal->AddToObj("Tag", GetTag(RecN));
+	RecVal->AddToObj("Count", GetCount(RecN));
+	RecVal->AddToObj("Value", GetValue(RecN));
+	return RecVal;
+}
+
+// records are added one by one or in batches of BatchLen
+TWPt<TQm::TBase> NewQueryBase(const int& Recs, const int& BatchLen = 0) {
+	TWPt<TQm::TBase> Base = TQmTest::NewBase(QueryTestFPath, GetQuerySchema(), 16 * 1024 * 1024, 16 * 1024 * 1024);
+	TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Items");
+	PJsonVal RecValV = TJsonVal::NewArr(); TUInt64V RecIdV;
+	for (int RecN = 0; RecN < Recs; RecN++) {
+		if (BatchLen == 0) { Store->AddRec(GetQueryRec(RecN)); continue; }
+		RecValV->AddToArr(GetQueryRec(RecN));
+		if (RecValV->GetArrVals() == BatchLen || RecN + 1 == Recs) {
+			Store->AddRecBatch(RecValV, RecIdV);
+			RecValV = TJsonVal::NewArr();
+		}
+	}
+	return Base;
+}
+
+TQm::PRecSet Search(const TWPt<TQm::TBase>& Base, const TStr& QueryStr) {
+	return Base->Search(TJsonVal::GetValFromStr(QueryStr));
+}
+
+TQm::TQueryItem GetQueryItem(const TWPt<TQm::TBase>& Base, const TStr& QueryStr) {
+	return TQm::TQuery::New(Base, TJsonVal::GetValFromStr(QueryStr))->GetQueryItem();
+}
+
+// check query results match records selected by the predicate
+template <class TPred>
+void CheckQuery(const TWPt<TQm::TBase>& Base, const int& Recs, const TStr& QueryStr, const TPred& Pred) {
+	TQm::PRecSet RecSet = Search(Base, QueryStr);
+	TUInt64V RecIdV; RecSet->GetRecIdV(RecIdV); RecIdV.Sort();
+	TUInt64V ExpRecIdV;
+	for (int RecN = 0; RecN < Recs; RecN++) {
+		if (Pred(RecN)) { ExpRecIdV.Add((uint64)RecN); }
+	}
+	ASSERT_EQ(ExpRecIdV.Len(), RecIdV.Len()) << QueryStr.CStr();
+	for (int RecN = 0; RecN < RecIdV.Len(); RecN++) {
+		ASSERT_EQ(ExpRecIdV[RecN].Val, RecIdV[RecN].Val) << QueryStr.CStr();
+	}
+}
+
+// check limited query results match first records selected by the predicate
+template <class TPred>
+void CheckLimit(const TWPt<TQm::TBase>& Base, const int& Recs, const TStr& QueryStr,
+		const int& Limit, const int& Offset, const TPred& Pred) {
+
+	PJsonVal QueryVal = TJsonVal::GetValFromStr(QueryStr);
+	QueryVal->AddToObj("$limit", Limit);
+	QueryVal->AddToObj("$offset", Offset);
+	TQm::PRecSet RecSet = Base->Search(QueryVal);
+	TUInt64V ExpRecIdV; int Skip = Offset;
+	for (int RecN = 0; RecN < Recs && ExpRecIdV.Len() < Limit; RecN++) {
+		if (!Pred(RecN)) { continue; }
+		if (Skip > 0) { Skip--; continue; }
+		ExpRecIdV.Add((uint64)RecN);
+	}
+	ASSERT_EQ(ExpRecIdV.Len(), RecSet->GetRecs()) << QueryStr.CStr();
+	for (int RecN = 0; RecN < ExpRecIdV.Len(); RecN++) {
+		ASSERT_EQ(ExpRecIdV[RecN].Val, RecSet->GetRecId(RecN)) << QueryStr.CStr();
+	}
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Query planning
+
+TEST(TQueryPlan, EstimateRecs) {
+	const int Recs = 20000;
+	TWPt<TQm::TBase> Base = NewQueryBase(Recs);
+	// inverted index counts are exact
+	EXPECT_EQ(Base->EstimateRecs(GetQueryItem(Base, "{ \"$from\": \"Items\", \"Category\": \"cat3\" }")), 2000);
+	EXPECT_EQ(Base->EstimateRecs(GetQueryItem(Base, "{ \"$from\": \"Items\", \"Tag\": \"rare\" }")), 20);
+	// b-tree range counts are exact
+	EXPECT_EQ(Base->EstimateRecs(GetQueryItem(Base,
+		"{ \"$from\": \"Items\", \"Count\": { \"$gt\": 100, \"$lt\": 15099 } }")), 15000);
+	EXPECT_EQ(Base->EstimateRecs(GetQueryItem(Base,
+		"{ \"$from\": \"Items\", \"Count\": { \"$gt\": 20000 } }")), 0);
+	EXPECT_EQ(Base->EstimateRecs(GetQueryItem(Base,
+		"{ \"$from\": \"Items\", \"Count\": { \"$gt\": 5, \"$lt\": 5 } }")), 1);
+	// and is bounded by the smallest item, or by the smallest sum
+	EXPECT_EQ(Base->EstimateRecs(GetQueryItem(Base,
+		"{ \"$from\": \"Items\", \"Tag\": \"rare\", \"Count\": { \"$gt\": 100 } }")), 20);
+	EXPECT_EQ(Base->EstimateRecs(GetQueryItem(Base,
+		"{ \"$from\": \"Items\", \"$or\": [{ \"Category\": \"cat1\" }, { \"Tag\": \"rare\" }] }")), 2020);
+	EXPECT_EQ(Base->EstimateRecs(GetQueryItem(Base, "{ \"$from\": \"Items\" }")), Recs);
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TQueryPlan, Results) {
+	const int Recs = 20000;
+	TWPt<TQm::TBase> Base = NewQueryBase(Recs);
+	// rare term and wide range, range is checked on the records of the term
+	CheckQuery(Base, Recs, "{ \"$from\": \"Items\", \"Tag\": \"rare\", \"Count\": { \"$gt\": 5000 } }",
+		[](const int& RecN) { return GetTag(RecN) == "rare" && GetCount(RecN) >= 5000; });
+	// same with declaration order reversed
+	CheckQuery(Base, Recs, "{ \"$from\": \"Items\", \"Count\": { \"$gt\": 5000 }, \"Tag\": \"rare\" }",
+		[](const int& RecN) { return GetTag(RecN) == "rare" && GetCount(RecN) >= 5000; });
+	// narrow range and common term, term is probed with records from the range
+	CheckQuery(Base, Recs, "{ \"$from\": \"Items\", \"Category\": \"cat4\", \"Count\": { \"$gt\": 100, \"$lt\": 200 } }",
+		[](const int& RecN) { return GetCategory(RecN) == "cat4" && GetCount(RecN) >= 100 && GetCount(RecN) <= 200; });
+	// two ranges and a term
+	CheckQuery(Base, Recs, "{ \"$from\": \"Items\", \"Category\": \"cat2\", \"Count\": { \"$lt\": 15000 }, \"Value\": { \"$gt\": 10.0, \"$lt\": 50.0 } }",
+		[](const int& RecN) { return GetCategory(RecN) == "cat2" && GetCount(RecN) <= 15000 && GetValue(RecN) >= 10.0 && GetValue(RecN) <= 50.0; });
+	// negations
+	CheckQuery(Base, Recs, "{ \"$from\": \"Items\", \"Tag\": { \"$ne\": \"common\" }, \"Count\": { \"$gt\": 100 } }",
+		[](const int& RecN) { return GetTag(RecN) != "common" && GetCount(RecN) >= 100; });
+	CheckQuery(Base, Recs, "{ \"$from\": \"Items\", \"Category\": \"cat7\", \"$not\": { \"Count\": { \"$gt\": 1000 } } }",
+		[](const int& RecN) { return GetCategory(RecN) == "cat7" && GetCount(RecN) < 1000; });
+	CheckQuery(Base, Recs, "{ \"$from\": \"Items\", \"$not\": { \"Tag\": \"rare\" }, \"Count\": { \"$lt\": 3000 } }",
+		[](const int& RecN) { return GetTag(RecN) != "rare" && GetCount(RecN) <= 3000; });
+	// nested or
+	CheckQuery(Base, Recs, "{ \"$from\": \"Items\", \"Tag\": \"rare\", \"$or\": [{ \"Category\": \"cat7\" }, { \"Count\": { \"$lt\": 5000 } }] }",
+		[](const int& RecN) { return GetTag(RecN) == "rare" && (GetCategory(RecN) == "cat7" || GetCount(RecN) <= 5000); });
+	// no results
+	CheckQuery(Base, Recs, "{ \"$from\": \"Items\", \"Tag\": \"rare\", \"Category\": \"cat1\", \"Count\": { \"$gt\": 10 } }",
+		[](const int& RecN) { return false; });
+	CheckQuery(Base, Recs, "{ \"$from\": \"Items\", \"Count\": { \"$gt\": 30000 }, \"Category\": \"cat1\" }",
+		[](const int& RecN) { return false; });
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TQueryPlan, FilterFq) {
+	const int Recs = 20000;
+	TWPt<TQm::TBase> Base = NewQueryBase(Recs);
+	const TGixMerger<TQm::TKeyWord, TUInt64IntKd>* Merger = Base->GetIndex()->GetSumMerger();
+	// items executed on their own and merged give the unfiltered plan
+	TUInt64IntKdV RareRecIdFqV = Search(Base, "{ \"$from\": \"Items\", \"Tag\": \"rare\" }")->GetRecIdFqV();
+	TUInt64IntKdV RangeRecIdFqV = Search(Base, "{ \"$from\": \"Items\", \"Count\": { \"$gt\": 5000 } }")->GetRecIdFqV();
+	TUInt64IntKdV CatRecIdFqV = Search(Base, "{ \"$from\": \"Items\", \"Category\": \"cat7\" }")->GetRecIdFqV();
+	TUInt64IntKdV AndRecIdFqV = RareRecIdFqV; Merger->Intrs(AndRecIdFqV, RangeRecIdFqV);
+	TUInt64IntKdV OrRecIdFqV = CatRecIdFqV; Merger->Union(OrRecIdFqV, RangeRecIdFqV);
+	Merger->Intrs(OrRecIdFqV, RareRecIdFqV);
+	// planned execution checks the range on the records of the rare term
+	const TUInt64IntKdV PlanAndRecIdFqV = Search(Base,
+		"{ \"$from\": \"Items\", \"Tag\": \"rare\", \"Count\": { \"$gt\": 5000 } }")->GetRecIdFqV();
+	const TUInt64IntKdV PlanOrRecIdFqV = Search(Base,
+		"{ \"$from\": \"Items\", \"Tag\": \"rare\", \"$or\": [{ \"Category\": \"cat7\" }, { \"Count\": { \"$gt\": 5000 } }] }")->GetRecIdFqV();
+	EXPECT_TRUE(AndRecIdFqV.Len() > 0);
+	ASSERT_EQ(AndRecIdFqV.Len(), PlanAndRecIdFqV.Len());
+	for (int RecN = 0; RecN < AndRecIdFqV.Len(); RecN++) {
+		EXPECT_EQ(AndRecIdFqV[RecN].Key.Val, PlanAndRecIdFqV[RecN].Key.Val);
+		EXPECT_EQ(AndRecIdFqV[RecN].Dat.Val, PlanAndRecIdFqV[RecN].Dat.Val);
+	}
+	ASSERT_EQ(OrRecIdFqV.Len(), PlanOrRecIdFqV.Len());
+	for (int RecN = 0; RecN < OrRecIdFqV.Len(); RecN++) {
+		EXPECT_EQ(OrRecIdFqV[RecN].Key.Val, PlanOrRecIdFqV[RecN].Key.Val);
+		EXPECT_EQ(OrRecIdFqV[RecN].Dat.Val, PlanOrRecIdFqV[RecN].Dat.Val);
+	}
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TQueryPlan, DISABLED_RareAndWideRangePerf) {
+	const int Recs = 200000;
+	TWPt<TQm::TBase> Base = NewQueryBase(Recs);
+	const TStr TagQueryStr = "{ \"$from\": \"Items\", \"Tag\": \"rare\" }";
+	const TStr RangeQueryStr = "{ \"$from\": \"Items\", \"Count\": { \"$gt\": 1000 } }";
+	const TStr QueryStr = "{ \"$from\": \"Items\", \"Count\": { \"$gt\": 1000 }, \"Tag\": \"rare\" }";
+	// executing both items fully and intersecting them
+	TTmStopWatch FullSw(true);
+	TQm::PRecSet FullRecSet = Search(Base, RangeQueryStr)->GetIntersect(Search(Base, TagQueryStr));
+	FullSw.Stop();
+	// planned execution
+	TTmStopWatch PlanSw(true);
+	TQm::PRecSet PlanRecSet = Search(Base, QueryStr);
+	PlanSw.Stop();
+	EXPECT_EQ(FullRecSet->GetRecs(), PlanRecSet->GetRecs());
+	printf("full: %d ms, planned: %d ms\n", FullSw.GetMSecInt(), PlanSw.GetMSecInt());
+	TQmTest::CloseBase(Base);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Limited and sorted queries
+
+TEST(TQueryCursor, IsCursor) {
+	TWPt<TQm::TBase> Base = NewQueryBase(100);
+	EXPECT_TRUE(TQm::TQueryCursor::IsCursor(Base, GetQueryItem(Base, "{ \"$from\": \"Items\" }")));
+	EXPECT_TRUE(TQm::TQueryCursor::IsCursor(Base, GetQueryItem(Base,
+		"{ \"$from\": \"Items\", \"Tag\": \"rare\", \"$not\": { \"Count\": { \"$gt\": 10 } } }")));
+	// record sets keep their own order
+	TQm::PRecSet RecSet = Search(Base, "{ \"$from\": \"Items\", \"Tag\": \"rare\" }");
+	EXPECT_FALSE(TQm::TQueryCursor::IsCursor(Base, TQm::TQueryItem(RecSet)));
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TQueryCursor, Steps) {
+	const int Recs = 20000;
+	TWPt<TQm::TBase> Base = NewQueryBase(Recs);
+	const TStr QueryStr = "{ \"$from\": \"Items\", \"Category\": \"cat3\", \"Count\": { \"$gt\": 5000 } }";
+	TQm::TQueryCursor Cursor(Base, GetQueryItem(Base, QueryStr));
+	// first step covers the smallest range
+	TUInt64IntKdV RecIdFqV;
+	ASSERT_TRUE(Cursor.Next(RecIdFqV));
+	EXPECT_EQ(RecIdFqV.Len(), 0);
+	// the rest of the steps return the remaining records in order
+	Cursor.GetRecs(Recs, RecIdFqV);
+	EXPECT_TRUE(Cursor.IsEnd());
+	EXPECT_FALSE(Cursor.Next(RecIdFqV));
+	TUInt64V RecIdV; Search(Base, QueryStr)->GetRecIdV(RecIdV);
+	ASSERT_EQ(RecIdV.Len(), RecIdFqV.Len());
+	for (int RecN = 0; RecN < RecIdV.Len(); RecN++) {
+		ASSERT_EQ(RecIdV[RecN], RecIdFqV[RecN].Key);
+	}
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TQueryCursor, Results) {
+	const int Recs = 20000;
+	TWPt<TQm::TBase> Base = NewQueryBase(Recs);
+	// whole store
+	CheckLimit(Base, Recs, "{ \"$from\": \"Items\" }", 10, 0,
+		[](const int& RecN) { return true; });
+	CheckLimit(Base, Recs, "{ \"$from\": \"Items\" }", 10, 19995,
+		[](const int& RecN) { return true; });
+	// common term, found in the first step
+	CheckLimit(Base, Recs, "{ \"$from\": \"Items\", \"Category\": \"cat3\" }", 10, 5,
+		[](const int& RecN) { return GetCategory(RecN) == "cat3"; });
+	// rare term, sized by the estimate
+	CheckLimit(Base, Recs, "{ \"$from\": \"Items\", \"Tag\": \"rare\" }", 15, 0,
+		[](const int& RecN) { return GetTag(RecN) == "rare"; });
+	// results only at the end, takes several steps
+	CheckLimit(Base, Recs, "{ \"$from\": \"Items\", \"Category\": \"cat3\", \"Count\": { \"$gt\": 15000 } }", 100, 0,
+		[](const int& RecN) { return GetCategory(RecN) == "cat3" && GetCount(RecN) >= 15000; });
+	// negations
+	CheckLimit(Base, Recs, "{ \"$from\": \"Items\", \"Tag\": { \"$ne\": \"common\" } }", 5, 2,
+		[](const int& RecN) { return GetTag(RecN) != "common"; });
+	CheckLimit(Base, Recs, "{ \"$from\": \"Items\", \"$not\": { \"Count\": { \"$lt\": 12000 } } }", 50, 0,
+		[](const int& RecN) { return GetCount(RecN) > 12000; });
+	// nested or
+	CheckLimit(Base, Recs, "{ \"$from\": \"Items\", \"$or\": [{ \"Tag\": \"rare\" }, { \"Value\": { \"$gt\": 99.0 } }] }", 30, 0,
+		[](const int& RecN) { return GetTag(RecN) == "rare" || GetValue(RecN) >= 99.0; });
+	// not enough results
+	CheckLimit(Base, Recs, "{ \"$from\": \"Items\", \"Tag\": \"rare\", \"Category\": \"cat7\" }", 1000, 0,
+		[](const int& RecN) { return GetTag(RecN) == "rare" && GetCategory(RecN) == "cat7"; });
+	CheckLimit(Base, Recs, "{ \"$from\": \"Items\", \"Count\": { \"$gt\": 30000 } }", 10, 0,
+		[](const int& RecN) { return false; });
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TQueryTop, SortLimit) {
+	const int Recs = 20000;
+	TWPt<TQm::TBase> Base = NewQueryBase(Recs);
+	TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Items");
+	const int CountId = Store->GetFieldId("Count");
+	const int ValueId = Store->GetFieldId("Value");
+	const int NameId = Store->GetFieldId("Name");
+	// compare against sorting all the records
+	TQm::PRecSet AllRecSet = Search(Base, "{ \"$from\": \"Items\", \"Category\": \"cat3\" }");
+	for (int FieldId : { CountId, ValueId, NameId }) {
+		for (bool Asc : { true, false }) {
+			TQm::PRecSet SortRecSet = AllRecSet->Clone(); SortRecSet->SortByField(Asc, FieldId);
+			TQm::PRecSet TopRecSet = AllRecSet->Clone(); TopRecSet->TopByField(Asc, FieldId, 25);
+			ASSERT_EQ(TopRecSet->GetRecs(), 25);
+			for (int RecN = 0; RecN < 25; RecN++) {
+				const uint64 SortRecId = SortRecSet->GetRecId(RecN);
+				const uint64 TopRecId = TopRecSet->GetRecId(RecN);
+				// ties can be in different order, values must match
+				ASSERT_EQ(Store->GetFieldText(SortRecId, FieldId), Store->GetFieldText(TopRecId, FieldId));
+			}
+		}
+	}
+	// query with sort and limit
+	TQm::PRecSet RecSet = Search(Base, "{ \"$from\": \"Items\", \"Category\": \"cat3\", "
+		"\"$sort\": { \"Count\": -1 }, \"$limit\": 5, \"$offset\": 2 }");
+	ASSERT_EQ(RecSet->GetRecs(), 5);
+	for (int RecN = 0; RecN < 5; RecN++) {
+		EXPECT_EQ(Store->GetFieldInt(RecSet->GetRecId(RecN), CountId), 19993 - 10 * (2 + RecN));
+	}
+	// more than there is
+	AllRecSet->TopByField(true, CountId, 10000);
+	EXPECT_EQ(AllRecSet->GetRecs(), 2000);
+	EXPECT_EQ(Store->GetFieldInt(AllRecSet->GetRecId(0), CountId), 3);
+	AllRecSet->TopByField(true, CountId, 0);
+	EXPECT_EQ(AllRecSet->GetRecs(), 0);
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TQueryTop, Fq) {
+	TWPt<TQm::TBase> Base = NewQueryBase(100);
+	TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Items");
+	TUInt64IntKdV RecIdFqV;
+	for (int RecN = 0; RecN < 100; RecN++) {
+		RecIdFqV.Add(TUInt64IntKd((uint64)RecN, (RecN * 37) % 23));
+	}
+	for (bool Asc : { true, false }) {
+		TQm::PRecSet SortRecSet = TQm::TRecSet::New(Store, RecIdFqV); SortRecSet->SortByFq(Asc);
+		TQm::PRecSet TopRecSet = TQm::TRecSet::New(Store, RecIdFqV); TopRecSet->TopByFq(Asc, 10);
+		ASSERT_EQ(TopRecSet->GetRecs(), 10);
+		for (int RecN = 0; RecN < 10; RecN++) {
+			EXPECT_EQ(SortRecSet->GetRecId(RecN), TopRecSet->GetRecId(RecN));
+			EXPECT_EQ(SortRecSet->GetRecFq(RecN), TopRecSet->GetRecFq(RecN));
+		}
+	}
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TQueryTop, RepeatedIds) {
+	TWPt<TQm::TBase> Base = NewQueryBase(100);
+	TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Items");
+	// sorted record sets with repeated ids take the same path as unsorted ones
+	TUInt64IntKdV RecIdFqV1, RecIdFqV2;
+	for (int RecN = 0; RecN < 40; RecN++) {
+		RecIdFqV1.Add(TUInt64IntKd((uint64)(RecN / 2), 1));
+		if (RecN % 3 == 0) { RecIdFqV2.Add(TUInt64IntKd((uint64)RecN, 1)); }
+	}
+	TQm::PRecSet RecSet1 = TQm::TRecSet::New(Store, RecIdFqV1);
+	TQm::PRecSet RecSet2 = TQm::TRecSet::New(Store, RecIdFqV2);
+	TUInt64IntKdV UnionRecIdFqV = RecIdFqV1; UnionRecIdFqV.Union(RecIdFqV2);
+	TUInt64IntKdV DiffRecIdFqV; RecIdFqV1.Diff(RecIdFqV2, DiffRecIdFqV);
+	const TSortedSetKernel BestKernel = TSortedSet::GetBestKernel();
+	for (int KernelN = sskScalar; KernelN <= BestKernel; KernelN++) {
+		TSortedSet::SetKernel((TSortedSetKernel)KernelN);
+		EXPECT_EQ(RecSet1->GetMerge(RecSet2)->GetRecIdFqV(), UnionRecIdFqV);
+		EXPECT_EQ(RecSet1->GetDiff(RecSet2)->GetRecIdFqV(), DiffRecIdFqV);
+	}
+	TSortedSet::SetKernel(BestKernel);
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TQueryCursor, DISABLED_CommonLimitPerf) {
+	const int Recs = 200000;
+	TWPt<TQm::TBase> Base = NewQueryBase(Recs);
+	const TStr QueryStr = "{ \"$from\": \"Items\", \"Category\": \"cat3\", \"Value\": { \"$gt\": 10.0 } }";
+	// executing the whole query and limiting afterwards
+	TTmStopWatch FullSw(true);
+	TQm::PRecSet FullRecSet = Search(Base, QueryStr)->GetLimit(10, 0);
+	FullSw.Stop();
+	// executing until we have enough records
+	PJsonVal QueryVal = TJsonVal::GetValFromStr(QueryStr);
+	QueryVal->AddToObj("$limit", 10);
+	TTmStopWatch CursorSw(true);
+	TQm::PRecSet CursorRecSet = Base->Search(QueryVal);
+	CursorSw.Stop();
+	ASSERT_EQ(FullRecSet->GetRecs(), CursorRecSet->GetRecs());
+	for (int RecN = 0; RecN < FullRecSet->GetRecs(); RecN++) {
+		EXPECT_EQ(FullRecSet->GetRecId(RecN), CursorRecSet->GetRecId(RecN));
+	}
+	// sorting all the records against keeping the top ones
+	TTmStopWatch SortSw(true);
+	TQm::PRecSet SortRecSet = Search(Base, QueryStr); SortRecSet->SortByField(false, SortRecSet->GetStore()->GetFieldId("Value"));
+	SortSw.Stop();
+	TTmStopWatch TopSw(true);
+	TQm::PRecSet TopRecSet = Search(Base, QueryStr); TopRecSet->TopByField(false, TopRecSet->GetStore()->GetFieldId("Value"), 10);
+	TopSw.Stop();
+	printf("full: %d ms, cursor: %d ms, sort: %d ms, top: %d ms\n", FullSw.GetMSecInt(),
+		CursorSw.GetMSecInt(), SortSw.GetMSecInt(), TopSw.GetMSecInt());
+	TQmTest::CloseBase(Base);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Query result cache
+
+TEST(TQueryCache, Hits) {
+	TWPt<TQm::TBase> Base = NewQueryBase(2000);
+	EXPECT_FALSE(Base->GetStats()->IsObjKey("query_cache"));
+	Base->SetQueryCacheSize(1024 * 1024);
+	EXPECT_EQ(Base->GetQueryCacheSize(), 1024 * 1024);
+	TQm::PRecSet RecSet1 = Search(Base, "{ \"$from\": \"Items\", \"Category\": \"cat3\", \"Count\": { \"$lt\": 1000 } }");
+	// same query with items in different order
+	TQm::PRecSet RecSet2 = Search(Base, "{ \"$from\": \"Items\", \"Count\": { \"$lt\": 1000 }, \"Category\": \"cat3\" }");
+	ASSERT_EQ(RecSet1->GetRecs(), 100);
+	ASSERT_EQ(RecSet1->GetRecs(), RecSet2->GetRecs());
+	for (int RecN = 0; RecN < RecSet1->GetRecs(); RecN++) {
+		EXPECT_EQ(RecSet1->GetRecId(RecN), RecSet2->GetRecId(RecN));
+	}
+	// returned results can be changed without affecting the cache
+	RecSet2->Trunc(10);
+	EXPECT_EQ(Search(Base, "{ \"$from\": \"Items\", \"Category\": \"cat3\", \"Count\": { \"$lt\": 1000 } }")->GetRecs(), 100);
+	// limit is part of the key
+	EXPECT_EQ(Search(Base, "{ \"$from\": \"Items\", \"Category\": \"cat3\", \"Count\": { \"$lt\": 1000 }, \"$limit\": 5 }")->GetRecs(), 5);
+	PJsonVal StatVal = Base->GetStats()->GetObjKey("query_cache");
+	EXPECT_EQ(StatVal->GetObjInt("hits"), 2);
+	EXPECT_EQ(StatVal->GetObjInt("misses"), 2);
+	EXPECT_EQ(StatVal->GetObjInt("queries"), 2);
+	EXPECT_GT(StatVal->GetObjInt("used"), 0);
+	// disable
+	Base->SetQueryCacheSize(0);
+	EXPECT_FALSE(Base->GetStats()->IsObjKey("query_cache"));
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TQueryCache, Invalidate) {
+	TWPt<TQm::TBase> Base = NewQueryBase(2000);
+	Base->SetQueryCacheSize(1024 * 1024);
+	TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Items");
+	TWPt<TQm::TStore> LogStore = Base->GetStoreByStoreNm("Logs");
+	const TStr QueryStr = "{ \"$from\": \"Items\", \"Tag\": \"rare\" }";
+	EXPECT_EQ(Search(Base, QueryStr)->GetRecs(), 2);
+	// changes in other stores keep the results
+	LogStore->AddRec(TJsonVal::GetValFromStr("{ \"Msg\": \"hello\" }"));
+	EXPECT_EQ(Search(Base, QueryStr)->GetRecs(), 2);
+	EXPECT_EQ(Base->GetStats()->GetObjKey("query_cache")->GetObjInt("hits"), 1);
+	// adding a record
+	Store->AddRec(TJsonVal::GetValFromStr("{ \"Name\": \"new\", \"Category\": \"cat1\", "
+		"\"Tag\": \"rare\", \"Count\": 1, \"Value\": 1.0 }"));
+	EXPECT_EQ(Search(Base, QueryStr)->GetRecs(), 3);
+	// updating indexed field
+	Store->UpdateRec(7, TJsonVal::GetValFromStr("{ \"Tag\": \"common\" }"));
+	EXPECT_EQ(Search(Base, QueryStr)->GetRecs(), 2);
+	// setting indexed field directly
+	const int TagId = Store->GetFieldId("Tag");
+	Store->SetFieldStr(8, TagId, "rare");
+	EXPECT_EQ(Search(Base, QueryStr)->GetRecs(), 3);
+	// deleting records
+	Store->DeleteFirstRecs(1000);
+	EXPECT_EQ(Search(Base, QueryStr)->GetRecs(), 2);
+	PJsonVal StatVal = Base->GetStats()->GetObjKey("query_cache");
+	EXPECT_EQ(StatVal->GetObjInt("hits"), 1);
+	EXPECT_EQ(StatVal->GetObjInt("stales"), 4);
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TQueryCache, SetField) {
+	TWPt<TQm::TBase> Base = NewQueryBase(10);
+	Base->SetQueryCacheSize(1024 * 1024);
+	TWPt<TQm::TStore> LogStore = Base->GetStoreByStoreNm("Logs");
+	const int LevelId = LogStore->GetFieldId("Level");
+	for (int RecN = 0; RecN < 3; RecN++) {
+		LogStore->AddRec(TJsonVal::GetValFromStr("{ \"Msg\": \"hello\", \"Level\": " + TInt::GetStr(RecN) + " }"));
+	}
+	// results sorted by a field that is not indexed
+	const TStr QueryStr = "{ \"$from\": \"Logs\", \"Msg\": \"hello\", \"$sort\": { \"Level\": 1 } }";
+	EXPECT_EQ(Search(Base, QueryStr)->GetRecId(0), 0);
+	LogStore->SetFieldInt(0, LevelId, 10);
+	EXPECT_EQ(Search(Base, QueryStr)->GetRecId(0), 1);
+	LogStore->SetFieldNull(0, LevelId);
+	LogStore->SetFieldInt(1, LevelId, 10);
+	EXPECT_EQ(Search(Base, QueryStr)->GetRecId(2), 1);
+	EXPECT_EQ(Base->GetStats()->GetObjKey("query_cache")->GetObjInt("hits"), 0);
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TQueryCache, Budget) {
+	TWPt<TQm::TBase> Base = NewQueryBase(20000);
+	// room for roughly one result of 2000 records
+	Base->SetQueryCacheSize(40000);
+	for (int CatN = 0; CatN < 10; CatN++) {
+		Search(Base, "{ \"$from\": \"Items\", \"Category\": \"cat" + TInt::GetStr(CatN) + "\" }");
+	}
+	PJsonVal StatVal = Base->GetStats()->GetObjKey("query_cache");
+	EXPECT_LE(StatVal->GetObjInt("used"), 40000);
+	EXPECT_EQ(StatVal->GetObjInt("queries"), 1);
+	// most recent one is kept
+	Search(Base, "{ \"$from\": \"Items\", \"Category\": \"cat9\" }");
+	EXPECT_EQ(Base->GetStats()->GetObjKey("query_cache")->GetObjInt("hits"), 1);
+	// results larger than the cache are not kept
+	Search(Base, "{ \"$from\": \"Items\" }");
+	EXPECT_EQ(Base->GetStats()->GetObjKey("query_cache")->GetObjInt("queries"), 1);
+	TQmTest::CloseBase(Base);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Batch ingestion
+
+TEST(TStoreBatch, Results) {
+	const int Recs = 20000;
+	TWPt<TQm::TBase> Base = NewQueryBase(Recs, 3000);
+	EXPECT_EQ(Base->GetStoreByStoreNm("Items")->GetRecs(), (uint64)Recs);
+	CheckQuery(Base, Recs, "{ \"$from\": \"Items\", \"Category\": \"cat3\" }",
+		[](const int& RecN) { return GetCategory(RecN) == "cat3"; });
+	CheckQuery(Base, Recs, "{ \"$from\": \"Items\", \"Tag\": \"rare\" }",
+		[](const int& RecN) { return GetTag(RecN) == "rare"; });
+	CheckQuery(Base, Recs, "{ \"$from\": \"Items\", \"Count\": { \"$gt\": 100, \"$lt\": 12000 } }",
+		[](const int& RecN) { return GetCount(RecN) >= 100 && GetCount(RecN) <= 12000; });
+	CheckQuery(Base, Recs, "{ \"$from\": \"Items\", \"Category\": \"cat2\", \"Value\": { \"$gt\": 10.0, \"$lt\": 50.0 } }",
+		[](const int& RecN) { return GetCategory(RecN) == "cat2" && GetValue(RecN) >= 10.0 && GetValue(RecN) <= 50.0; });
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TStoreBatch, Update) {
+	const int Recs = 2000;
+	TWPt<TQm::TBase> Base = NewQueryBase(Recs, 500);
+	TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Items");
+	// batch with new records and updates of existing ones by primary field
+	PJsonVal RecValV = TJsonVal::NewArr();
+	RecValV->AddToArr(GetQueryRec(Recs));
+	RecValV->AddToArr(TJsonVal::GetValFromStr("{ \"Name\": \"rec8\", \"Tag\": \"rare\" }"));
+	RecValV->AddToArr(TJsonVal::GetValFromStr("{ \"Name\": \"rec7\", \"Tag\": \"common\" }"));
+	RecValV->AddToArr(GetQueryRec(Recs + 7));
+	TUInt64V RecIdV; Store->AddRecBatch(RecValV, RecIdV, false);
+	ASSERT_EQ(RecIdV.Len(), 4);
+	EXPECT_EQ(RecIdV[0].Val, (uint64)Recs);
+	EXPECT_EQ(RecIdV[1].Val, 8);
+	EXPECT_EQ(RecIdV[2].Val, 7);
+	EXPECT_EQ(RecIdV[3].Val, (uint64)Recs + 1);
+	EXPECT_EQ(Store->GetRecs(), (uint64)Recs + 2);
+	// rec8, rec1007 and rec2007
+	EXPECT_EQ(Search(Base, "{ \"$from\": \"Items\", \"Tag\": \"rare\" }")->GetRecs(), 3);
+	EXPECT_EQ(Search(Base, "{ \"$from\": \"Items\", \"Count\": { \"$gt\": 2000 } }")->GetRecs(), 2);
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TStoreBatch, DISABLED_Perf) {
+	const int Recs = 100000;
+	TTmStopWatch RecSw(true);
+	TWPt<TQm::TBase> RecBase = NewQueryBase(Recs);
+	RecSw.Stop();
+	TQmTest::CloseBase(RecBase);
+	TTmStopWatch BatchSw(true);
+	TWPt<TQm::TBase> BatchBase = NewQueryBase(Recs, 10000);
+	BatchSw.Stop();
+	EXPECT_EQ(Search(BatchBase, "{ \"$from\": \"Items\", \"Tag\": \"rare\" }")->GetRecs(), Recs / 1000);
+	printf("one by one: %d ms, batch: %d ms\n", RecSw.GetMSecInt(), BatchSw.GetMSecInt());
+	TQmTest::CloseBase(BatchBase);
+}
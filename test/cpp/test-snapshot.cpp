@@ -0,0 +1,227 @@
+/**
+* Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+* All rights reserved.
+*
+* This source code is licensed under the FreeBSD license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+#include <base.h>
+#include <mine.h>
+#include <qminer.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Google Test
+#include "gtest/gtest.h"
+
+#include "test-qminer.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Helpers
+
+namespace {
+
+const TStr SnapshotTestFPath = "./data/snapshot/";
+
+// store with fields in memory and on disk, optionally with a window
+PJsonVal GetSnapshotSchema(const int& WindowSize) {
+	return TJsonVal::GetValFromStr(
+		"[{ \"name\": \"Values\", \"fields\": ["
+		"  { \"name\": \"Name\", \"type\": \"string\", \"primary\": true },"
+		"  { \"name\": \"Value\", \"type\": \"float\" },"
+		"  { \"name\": \"Count\", \"type\": \"int\" },"
+		"  { \"name\": \"Text\", \"type\": \"string\", \"store\": \"cache\" }"
+		"], \"keys\": ["
+		"  { \"field\": \"Text\", \"type\": \"value\" },"
+		"  { \"field\": \"Count\", \"type\": \"linear\" }"
+		"]" + (WindowSize > 0 ? ", \"window\": " + TInt::GetStr(WindowSize) : TStr()) + " }]");
+}
+
+TWPt<TQm::TBase> NewSnapshotBase(const int& WindowSize) {
+	TWPt<TQm::TBase> Base = TQmTest::NewBase(SnapshotTestFPath, GetSnapshotSchema(WindowSize));
+	Base->SetConcurrentReads(true);
+	return Base;
+}
+
+void AddSnapshotRecs(const TWPt<TQm::TStore>& Store, const int& FirstRecN, const int& Recs) {
+	for (int RecN = FirstRecN; RecN < FirstRecN + Recs; RecN++) {
+		PJsonVal RecVal = TJsonVal::NewObj();
+		RecVal->AddToObj("Name", "rec" + TInt::GetStr(RecN));
+		RecVal->AddToObj("Value", (double)RecN / 2.0);
+		RecVal->AddToObj("Count", RecN % 1000);
+		RecVal->AddToObj("Text", "text " + TInt::GetStr(RecN % 100));
+		Store->AddRec(RecVal);
+	}
+}
+
+PJsonVal GetTextQuery(const int& TextN) {
+	return TJsonVal::GetValFromStr("{ \"$from\": \"Values\", \"Text\": \"text " + TInt::GetStr(TextN) + "\" }");
+}
+
+// searches with snapshots and checks the results against the store content
+class TReader : public TThread {
+public:
+	TWPt<TQm::TBase> Base;
+	volatile bool StopP;
+	int Searches, Errors;
+	TStr ErrorStr;
+
+	TReader(const TWPt<TQm::TBase>& _Base): Base(_Base), StopP(false), Searches(0), Errors(0) { }
+
+	void Search(const int& SearchN) {
+		TQm::PReadSnapshot Snapshot = Base->GetSnapshot();
+		TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Values");
+		// records can not be deleted while we hold the snapshot
+		const uint64 FirstRecId = Store->GetFirstRecId();
+		const uint64 EndRecId = Snapshot->GetEndRecId(Store->GetStoreId());
+		const int TextN = SearchN % 100;
+		TQm::PRecSet RecSet = Base->Search(GetTextQuery(TextN), Snapshot);
+		// all records of the snapshot with the text, in order of ids
+		uint64 ExpectRecId = FirstRecId + (TextN - (int)(FirstRecId % 100) + 100) % 100;
+		for (int RecN = 0; RecN < RecSet->GetRecs(); RecN++, ExpectRecId += 100) {
+			const uint64 RecId = RecSet->GetRecId(RecN);
+			if (RecId != ExpectRecId || Store->GetFieldFlt(RecId, Store->GetFieldId("Value")) != (double)RecId / 2.0) {
+				Errors++; ErrorStr = TStr::Fmt("record %s at %d", TUInt64::GetStr(RecId).CStr(), RecN); return;
+			}
+		}
+		if (ExpectRecId < EndRecId) { Errors++; ErrorStr = "missing records"; }
+		// range query on another key agrees with the snapshot
+		TQm::PRecSet RangeRecSet = Base->Search(TJsonVal::GetValFromStr(
+			"{ \"$from\": \"Values\", \"Count\": { \"$gt\": 0, \"$lt\": 9 }, \"Text\": \"text 5\" }"), Snapshot);
+		for (int RecN = 0; RecN < RangeRecSet->GetRecs(); RecN++) {
+			const uint64 RecId = RangeRecSet->GetRecId(RecN);
+			if (RecId >= EndRecId || RecId % 1000 != 5) { Errors++; ErrorStr = "range record " + TUInt64::GetStr(RecId); }
+		}
+		Searches++;
+	}
+
+	void Run() {
+		try {
+			while (!StopP) { Search(Searches); }
+		} catch (PExcept& Except) {
+			Errors++; ErrorStr = Except->GetMsgStr();
+		}
+	}
+};
+
+// deletes first records of the store
+class TDeleter : public TThread {
+public:
+	TWPt<TQm::TStore> Store;
+	volatile bool DoneP;
+
+	TDeleter(const TWPt<TQm::TStore>& _Store): Store(_Store), DoneP(false) { }
+	void Run() { Store->DeleteFirstRecs(10); DoneP = true; }
+};
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Read snapshots
+
+TEST(TReadSnapshot, Visibility) {
+	TWPt<TQm::TBase> Base = NewSnapshotBase(0);
+	{
+		TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Values");
+		AddSnapshotRecs(Store, 0, 1000);
+		TQm::PReadSnapshot Snapshot = Base->GetSnapshot();
+		EXPECT_EQ(Snapshot->GetEndRecId(Store->GetStoreId()), 1000);
+		AddSnapshotRecs(Store, 1000, 1000);
+		// new records are only seen outside the snapshot
+		EXPECT_EQ(Base->Search(GetTextQuery(7), Snapshot)->GetRecs(), 10);
+		EXPECT_EQ(Base->Search(GetTextQuery(7))->GetRecs(), 20);
+		EXPECT_EQ(Base->Search(TJsonVal::GetValFromStr("{ \"$from\": \"Values\" }"), Snapshot)->GetRecs(), 1000);
+		EXPECT_EQ(Base->Search(TJsonVal::GetValFromStr(
+			"{ \"$from\": \"Values\", \"$not\": { \"Text\": \"text 7\" } }"), Snapshot)->GetRecs(), 990);
+		EXPECT_TRUE(Snapshot->IsRecId(Store, 999));
+		EXPECT_FALSE(Snapshot->IsRecId(Store, 1000));
+		// sort and limit only see the snapshot
+		TQm::PRecSet RecSet = Base->Search(TJsonVal::GetValFromStr(
+			"{ \"$from\": \"Values\", \"Text\": \"text 7\", \"$sort\": { \"Value\": -1 }, \"$limit\": 3 }"), Snapshot);
+		ASSERT_EQ(RecSet->GetRecs(), 3);
+		EXPECT_EQ(RecSet->GetRecId(0), 907);
+		// in-place changes are visible
+		Store->SetFieldFlt(5, Store->GetFieldId("Value"), -1.0);
+		EXPECT_EQ(Store->GetFieldFlt(5, Store->GetFieldId("Value")), -1.0);
+	}
+	// snapshots need concurrent reads
+	Base->SetConcurrentReads(false);
+	EXPECT_ANY_THROW(Base->GetSnapshot());
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TReadSnapshot, DeleteWaits) {
+	TWPt<TQm::TBase> Base = NewSnapshotBase(0);
+	TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Values");
+	AddSnapshotRecs(Store, 0, 100);
+	TQm::PReadSnapshot Snapshot = Base->GetSnapshot();
+	TDeleter Deleter(Store);
+	Deleter.Start();
+	// deletion waits for the snapshot
+	TSysProc::Sleep(100);
+	EXPECT_FALSE(Deleter.DoneP);
+	EXPECT_EQ(Store->GetRecs(), 100);
+	EXPECT_EQ(Base->Search(GetTextQuery(3), Snapshot)->GetRecs(), 1);
+	Snapshot.Clr();
+	Deleter.Join();
+	EXPECT_TRUE(Deleter.DoneP);
+	EXPECT_EQ(Store->GetRecs(), 90);
+	EXPECT_EQ(Base->Search(GetTextQuery(3))->GetRecs(), 0);
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TReadSnapshot, ConcurrentReaders) {
+	TWPt<TQm::TBase> Base = NewSnapshotBase(20000);
+	TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Values");
+	AddSnapshotRecs(Store, 0, 10000);
+	TVec<TReader*> ReaderV;
+	for (int ReaderN = 0; ReaderN < 4; ReaderN++) {
+		ReaderV.Add(new TReader(Base)); ReaderV.Last()->Start();
+	}
+	// write, update and delete while they read
+	for (int BatchN = 0; BatchN < 20; BatchN++) {
+		AddSnapshotRecs(Store, 10000 + BatchN * 1000, 1000);
+		Store->SetFieldFlt(Store->GetLastRecId(), Store->GetFieldId("Value"), (double)Store->GetLastRecId() / 2.0);
+		Base->GarbageCollect();
+	}
+	int Searches = 0;
+	for (int ReaderN = 0; ReaderN < ReaderV.Len(); ReaderN++) {
+		ReaderV[ReaderN]->StopP = true;
+		ReaderV[ReaderN]->Join();
+		EXPECT_EQ(ReaderV[ReaderN]->Errors, 0) << ReaderV[ReaderN]->ErrorStr.CStr();
+		Searches += ReaderV[ReaderN]->Searches;
+		delete ReaderV[ReaderN];
+	}
+	EXPECT_GT(Searches, 0);
+	EXPECT_EQ(Store->GetRecs(), 20000);
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TReadSnapshot, DISABLED_ConcurrentSearchPerf) {
+	const int Recs = 50000, AddRecs = 10000;
+	for (int Readers = 0; Readers <= 4; Readers = (Readers == 0) ? 1 : 2 * Readers) {
+		TWPt<TQm::TBase> Base = NewSnapshotBase(0);
+		TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Values");
+		AddSnapshotRecs(Store, 0, Recs);
+		TVec<TReader*> ReaderV;
+		for (int ReaderN = 0; ReaderN < Readers; ReaderN++) {
+			ReaderV.Add(new TReader(Base)); ReaderV.Last()->Start();
+		}
+		// one writer ingests while the readers search
+		TTmStopWatch AddSw(true);
+		AddSnapshotRecs(Store, Recs, AddRecs);
+		AddSw.Stop();
+		int Searches = 0;
+		for (int ReaderN = 0; ReaderN < ReaderV.Len(); ReaderN++) {
+			ReaderV[ReaderN]->StopP = true;
+			ReaderV[ReaderN]->Join();
+			EXPECT_EQ(ReaderV[ReaderN]->Errors, 0) << ReaderV[ReaderN]->ErrorStr.CStr();
+			Searches += ReaderV[ReaderN]->Searches;
+			delete ReaderV[ReaderN];
+		}
+		TQmTest::CloseBase(Base);
+		printf("%d readers: add %d recs/s, %d searches/s\n", Readers,
+			(int)(1000.0 * AddRecs / TInt::GetMx(AddSw.GetMSecInt(), 1)),
+			(int)(1000.0 * Searches / TInt::GetMx(AddSw.GetMSecInt(), 1)));
+	}
+}
@@ -0,0 +1,256 @@
+/**
+* Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+* All rights reserved.
+*
+* This source code is licensed under the FreeBSD license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+#include <base.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Google Test
+#include "gtest/gtest.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Helpers
+
+namespace {
+
+// sorted vector of unique ids, roughly one in Density of ids from [0, Len * Density)
+void GenIdV(TRnd& Rnd, const int& Len, const int& Density, TUInt64V& IdV) {
+	IdV.Clr(); IdV.Reserve(Len);
+	uint64 Id = Rnd.GetUniDevInt(Density);
+	for (int IdN = 0; IdN < Len; IdN++) {
+		IdV.Add(Id);
+		Id += 1 + Rnd.GetUniDevInt(2 * Density);
+	}
+}
+
+void GenIdV(TRnd& Rnd, const int& Len, const int& Density, TUIntV& IdV) {
+	TUInt64V IdV64; GenIdV(Rnd, Len, Density, IdV64);
+	IdV.Clr(); IdV.Reserve(Len);
+	for (int IdN = 0; IdN < IdV64.Len(); IdN++) { IdV.Add((uint)IdV64[IdN].Val); }
+}
+
+void GenIdV(TRnd& Rnd, const int& Len, const int& Density, TUInt64IntKdV& KdV) {
+	TUInt64V IdV; GenIdV(Rnd, Len, Density, IdV);
+	KdV.Clr(); KdV.Reserve(Len);
+	for (int IdN = 0; IdN < IdV.Len(); IdN++) {
+		KdV.Add(TUInt64IntKd(IdV[IdN], Rnd.GetUniDevInt(100)));
+	}
+}
+
+// same ids as the sorted set, each with given weight
+void SetDat(const TUInt64IntKdV& KdV, const int& Dat, TUInt64IntKdV& ResKdV) {
+	ResKdV = KdV;
+	for (int KdN = 0; KdN < ResKdV.Len(); KdN++) { ResKdV[KdN].Dat = Dat; }
+}
+
+// compare keys and weights, TKeyDat::operator== compares only keys
+void CheckEq(const TUInt64IntKdV& KdV1, const TUInt64IntKdV& KdV2) {
+	ASSERT_EQ(KdV1.Len(), KdV2.Len());
+	for (int KdN = 0; KdN < KdV1.Len(); KdN++) {
+		ASSERT_EQ(KdV1[KdN].Key.Val, KdV2[KdN].Key.Val);
+		ASSERT_EQ(KdV1[KdN].Dat.Val, KdV2[KdN].Dat.Val);
+	}
+}
+
+template <class TVal>
+void CheckEq(const TVec<TVal>& ValV1, const TVec<TVal>& ValV2) {
+	ASSERT_EQ(ValV1.Len(), ValV2.Len());
+	for (int ValN = 0; ValN < ValV1.Len(); ValN++) {
+		ASSERT_EQ(ValV1[ValN].Val, ValV2[ValN].Val);
+	}
+}
+
+// compare all operations against TVec on given vectors
+template <class TVal>
+void CheckOps(const TVec<TVal>& ValV1, const TVec<TVal>& ValV2) {
+	TVec<TVal> ExpV, ResV;
+	ValV1.Intrs(ValV2, ExpV); TSortedSet::Intrs(ValV1, ValV2, ResV); CheckEq(ExpV, ResV);
+	ValV1.Union(ValV2, ExpV); TSortedSet::Union(ValV1, ValV2, ResV); CheckEq(ExpV, ResV);
+	ValV1.Diff(ValV2, ExpV); TSortedSet::Diff(ValV1, ValV2, ResV); CheckEq(ExpV, ResV);
+	// and the other way around
+	ValV2.Intrs(ValV1, ExpV); TSortedSet::Intrs(ValV2, ValV1, ResV); CheckEq(ExpV, ResV);
+	ValV2.Union(ValV1, ExpV); TSortedSet::Union(ValV2, ValV1, ResV); CheckEq(ExpV, ResV);
+	ValV2.Diff(ValV1, ExpV); TSortedSet::Diff(ValV2, ValV1, ResV); CheckEq(ExpV, ResV);
+}
+
+// run operations on random vectors of various lengths and densities
+template <class TVal>
+void CheckRnd() {
+	TRnd Rnd(1);
+	const int LenV[] = { 0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 100, 1000, 10000 };
+	const int LenN = sizeof(LenV) / sizeof(int);
+	for (int LenN1 = 0; LenN1 < LenN; LenN1++) {
+		for (int LenN2 = 0; LenN2 < LenN; LenN2++) {
+			for (int Density = 1; Density <= 8; Density *= 2) {
+				TVec<TVal> ValV1, ValV2;
+				GenIdV(Rnd, LenV[LenN1], Density, ValV1);
+				GenIdV(Rnd, LenV[LenN2], Density, ValV2);
+				CheckOps(ValV1, ValV2);
+			}
+		}
+	}
+}
+
+// run check with all kernels supported by the machine
+template <class TVal>
+void CheckKernels() {
+	const TSortedSetKernel BestKernel = TSortedSet::GetBestKernel();
+	for (int KernelN = sskScalar; KernelN <= sskAvx2; KernelN++) {
+		const TSortedSetKernel Kernel = (TSortedSetKernel)KernelN;
+		if (!TSortedSet::IsKernel(Kernel)) { continue; }
+		TSortedSet::SetKernel(Kernel);
+		CheckRnd<TVal>();
+	}
+	TSortedSet::SetKernel(BestKernel);
+}
+
+// time given operation on given vectors, in milliseconds
+template <class TVal>
+double GetOpMSecs(const int& OpN, const TVec<TVal>& ValV1, const TVec<TVal>& ValV2, const int& Reps) {
+	TVec<TVal> ResV; TTmStopWatch Sw(true);
+	for (int RepN = 0; RepN < Reps; RepN++) {
+		if (OpN == 0) { TSortedSet::Intrs(ValV1, ValV2, ResV); }
+		else if (OpN == 1) { TSortedSet::Union(ValV1, ValV2, ResV); }
+		else { TSortedSet::Diff(ValV1, ValV2, ResV); }
+	}
+	return (double)Sw.GetMSecInt() / Reps;
+}
+
+// time all operations and kernels on vectors of given lengths
+template <class TVal>
+void Bench(const TStr& TypeNm, const int& Len1, const int& Len2, const int& Density) {
+	TRnd Rnd(1); TVec<TVal> ValV1, ValV2;
+	GenIdV(Rnd, Len1, Density, ValV1);
+	GenIdV(Rnd, Len2, Density * Len1 / Len2, ValV2);
+	const char* OpNmV[] = { "intrs", "union", "diff" };
+	const TSortedSetKernel BestKernel = TSortedSet::GetBestKernel();
+	for (int KernelN = sskScalar; KernelN <= sskAvx2; KernelN++) {
+		const TSortedSetKernel Kernel = (TSortedSetKernel)KernelN;
+		if (!TSortedSet::IsKernel(Kernel)) { continue; }
+		TSortedSet::SetKernel(Kernel);
+		for (int OpN = 0; OpN < 3; OpN++) {
+			printf("%s %s %d x %d %s: %.3f ms\n", TypeNm.CStr(), OpNmV[OpN], Len1, Len2,
+				TSortedSet::GetKernelStr(Kernel).CStr(), GetOpMSecs(OpN, ValV1, ValV2, 5));
+		}
+	}
+	TSortedSet::SetKernel(BestKernel);
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Sorted set kernels
+
+TEST(TSortedSet, Kernel) {
+	const TSortedSetKernel BestKernel = TSortedSet::GetBestKernel();
+	EXPECT_EQ(TSortedSet::GetKernel(), BestKernel);
+	EXPECT_TRUE(TSortedSet::IsKernel(sskScalar));
+	TSortedSet::SetKernel(sskScalar);
+	EXPECT_EQ(TSortedSet::GetKernel(), sskScalar);
+	TSortedSet::SetKernel(BestKernel);
+	if (!TSortedSet::IsKernel(sskAvx2)) {
+		EXPECT_ANY_THROW(TSortedSet::SetKernel(sskAvx2));
+	}
+}
+
+TEST(TSortedSet, UInt64IntKd) {
+	CheckKernels<TUInt64IntKd>();
+}
+
+TEST(TSortedSet, UInt64) {
+	CheckKernels<TUInt64>();
+}
+
+TEST(TSortedSet, UInt) {
+	CheckKernels<TUInt>();
+}
+
+TEST(TSortedSet, SumDat) {
+	TRnd Rnd(1);
+	TUInt64IntKdV KdV1, KdV2;
+	GenIdV(Rnd, 1000, 2, KdV1); SetDat(KdV1, 1, KdV1);
+	GenIdV(Rnd, 800, 2, KdV2); SetDat(KdV2, 2, KdV2);
+	const TSortedSetKernel BestKernel = TSortedSet::GetBestKernel();
+	for (int KernelN = sskScalar; KernelN <= sskAvx2; KernelN++) {
+		const TSortedSetKernel Kernel = (TSortedSetKernel)KernelN;
+		if (!TSortedSet::IsKernel(Kernel)) { continue; }
+		TSortedSet::SetKernel(Kernel);
+		// intersection has weights of both
+		TUInt64IntKdV ExpV, ResV;
+		KdV1.Intrs(KdV2, ExpV); SetDat(ExpV, 3, ExpV);
+		TSortedSet::Intrs(KdV1, KdV2, ResV, true);
+		CheckEq(ExpV, ResV);
+		// union has weights of both only for common ids
+		TSortedSet::Union(KdV1, KdV2, ResV, true);
+		KdV1.Union(KdV2, ExpV);
+		for (int KdN = 0; KdN < ExpV.Len(); KdN++) {
+			const bool InV1 = KdV1.IsInBin(ExpV[KdN]), InV2 = KdV2.IsInBin(ExpV[KdN]);
+			ExpV[KdN].Dat = (InV1 ? 1 : 0) + (InV2 ? 2 : 0);
+		}
+		CheckEq(ExpV, ResV);
+	}
+	TSortedSet::SetKernel(BestKernel);
+}
+
+TEST(TSortedSet, Skewed) {
+	TRnd Rnd(1);
+	TUInt64IntKdV KdV1, KdV2;
+	GenIdV(Rnd, 200000, 4, KdV1);
+	GenIdV(Rnd, 100, 8000, KdV2);
+	CheckOps(KdV1, KdV2);
+	// short vector entirely before, after and inside the long one
+	TUInt64IntKdV KdV3;
+	KdV3.Add(TUInt64IntKd(KdV1[0].Key, 1));
+	KdV3.Add(TUInt64IntKd(KdV1[1000].Key, 1));
+	KdV3.Add(TUInt64IntKd(KdV1.Last().Key + 1, 1));
+	CheckOps(KdV1, KdV3);
+}
+
+TEST(TSortedSet, Gallop) {
+	TUInt64V IdV;
+	for (uint64 Id = 0; Id < 1000; Id++) { IdV.Add(Id * 2); }
+	// same position as a linear scan, from any start
+	const int StartNV[] = { 0, 1, 100, 999 };
+	for (int StartN : StartNV) {
+		for (uint64 Id = 0; Id < 2002; Id += 3) {
+			int ScanN = StartN;
+			while (ScanN < IdV.Len() && IdV[ScanN] < Id) { ScanN++; }
+			EXPECT_EQ(TSortedSet::Gallop(IdV, StartN, TUInt64(Id)), ScanN);
+		}
+	}
+	EXPECT_EQ(TSortedSet::Gallop(TUInt64V(), 0, TUInt64(1)), 0);
+}
+
+#ifdef NDEBUG
+// repeated ids break the contract and trip AssertR in debug builds,
+// release builds must still stay within the result buffers
+TEST(TSortedSet, RepeatedIds) {
+	TUInt64V IdV1, IdV2;
+	for (int IdN = 0; IdN < 16; IdN++) { IdV1.Add(1); }
+	IdV2.Add(1); IdV2.Add(5); IdV2.Add(6); IdV2.Add(7);
+	const TSortedSetKernel BestKernel = TSortedSet::GetBestKernel();
+	for (int KernelN = sskScalar; KernelN <= sskAvx2; KernelN++) {
+		const TSortedSetKernel Kernel = (TSortedSetKernel)KernelN;
+		if (!TSortedSet::IsKernel(Kernel)) { continue; }
+		TSortedSet::SetKernel(Kernel);
+		TUInt64V ResV;
+		TSortedSet::Intrs(IdV1, IdV2, ResV); EXPECT_LE(ResV.Len(), IdV2.Len());
+		TSortedSet::Intrs(IdV2, IdV1, ResV); EXPECT_LE(ResV.Len(), IdV2.Len());
+		TSortedSet::Diff(IdV1, IdV2, ResV); EXPECT_LE(ResV.Len(), IdV1.Len());
+		TSortedSet::Union(IdV1, IdV2, ResV); EXPECT_LE(ResV.Len(), IdV1.Len() + IdV2.Len());
+	}
+	TSortedSet::SetKernel(BestKernel);
+}
+#endif
+
+TEST(TSortedSet, DISABLED_Benchmark) {
+	Bench<TUInt64IntKd>("kd", 1000000, 1000000, 2);
+	Bench<TUInt64IntKd>("kd", 1000000, 1000, 2);
+	Bench<TUInt64>("uint64", 1000000, 1000000, 2);
+	Bench<TUInt>("uint", 1000000, 1000000, 2);
+	Bench<TUInt>("uint", 1000000, 1000, 2);
+}
@@ -0,0 +1,518 @@
+/**
+* Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+* All rights reserved.
+*
+* This source code is licensed under the FreeBSD license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+#define XTEST
+
+#include <base.h>
+#include <mine.h>
+#include <qminer.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Google Test
+#include "gtest/gtest.h"
+
+#include "test-qminer.h"
+
+namespace TQm {
+namespace TStorage {
+
+///////////////////////////////////////////////////////////////////////////////
+// Access to store internals
+class XTest {
+public:
+	// reads field the old way, by copying the record out of the storage
+	static double GetFieldFltCopy(const TStoreImpl& Store, const uint64& RecId, const int& FieldId) {
+		TMem RecMem; Store.GetRecMem(RecId, FieldId, RecMem);
+		return Store.GetFieldSerializator(FieldId)->GetFieldFlt(RecMem, FieldId);
+	}
+	static TStr GetFieldStrCopy(const TStoreImpl& Store, const uint64& RecId, const int& FieldId) {
+		TMem RecMem; Store.GetRecMem(RecId, FieldId, RecMem);
+		return Store.GetFieldSerializator(FieldId)->GetFieldStr(RecMem, FieldId);
+	}
+};
+
+}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Helpers
+
+namespace {
+
+const TStr StoreTestFPath = "./data/store/";
+
+// store with fields in memory and on disk
+PJsonVal GetTestSchema() {
+	return TJsonVal::GetValFromStr(
+		"[{ \"name\": \"Values\", \"fields\": ["
+		"  { \"name\": \"Name\", \"type\": \"string\", \"primary\": true },"
+		"  { \"name\": \"Value\", \"type\": \"float\" },"
+		"  { \"name\": \"Count\", \"type\": \"int\" },"
+		"  { \"name\": \"Time\", \"type\": \"datetime\" },"
+		"  { \"name\": \"Text\", \"type\": \"string\", \"store\": \"cache\" },"
+		"  { \"name\": \"Weight\", \"type\": \"float\", \"store\": \"cache\" }"
+		"]}]");
+}
+
+TWPt<TQm::TBase> NewTestBase(const uint64& StoreCacheSize) {
+	return TQmTest::NewBase(StoreTestFPath, GetTestSchema(), 1024 * 1024, StoreCacheSize);
+}
+
+void AddTestRecs(const TWPt<TQm::TStore>& Store, const int& Recs) {
+	for (int RecN = 0; RecN < Recs; RecN++) {
+		PJsonVal RecVal = TJsonVal::NewObj();
+		RecVal->AddToObj("Name", "rec" + TInt::GetStr(RecN));
+		RecVal->AddToObj("Value", (double)RecN / 2.0);
+		RecVal->AddToObj("Count", RecN);
+		RecVal->AddToObj("Time", "2015-01-01T00:00:00");
+		RecVal->AddToObj("Text", "text of record " + TInt::GetStr(RecN));
+		RecVal->AddToObj("Weight", (double)RecN * 3.0);
+		Store->AddRec(RecVal);
+	}
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Field access
+
+TEST(TStoreImpl, FieldRead) {
+	TWPt<TQm::TBase> Base = NewTestBase(1024 * 1024);
+	{
+		TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Values");
+		const TQm::TStorage::TStoreImpl& StoreImpl = dynamic_cast<const TQm::TStorage::TStoreImpl&>(*Store);
+		AddTestRecs(Store, 1000);
+		const int NameId = Store->GetFieldId("Name");
+		const int ValueId = Store->GetFieldId("Value");
+		const int CountId = Store->GetFieldId("Count");
+		const int TextId = Store->GetFieldId("Text");
+		const int WeightId = Store->GetFieldId("Weight");
+		for (uint64 RecId = 0; RecId < 1000; RecId++) {
+			EXPECT_EQ(Store->GetFieldStr(RecId, NameId), "rec" + TUInt64::GetStr(RecId));
+			EXPECT_EQ(Store->GetFieldFlt(RecId, ValueId), (double)RecId / 2.0);
+			EXPECT_EQ(Store->GetFieldInt(RecId, CountId), (int)RecId);
+			EXPECT_EQ(Store->GetFieldStr(RecId, TextId), "text of record " + TUInt64::GetStr(RecId));
+			EXPECT_EQ(Store->GetFieldFlt(RecId, WeightId), (double)RecId * 3.0);
+			EXPECT_FALSE(Store->IsFieldNull(RecId, WeightId));
+			// views read the same values as copies
+			EXPECT_EQ(TQm::TStorage::XTest::GetFieldFltCopy(StoreImpl, RecId, ValueId), Store->GetFieldFlt(RecId, ValueId));
+			EXPECT_EQ(TQm::TStorage::XTest::GetFieldStrCopy(StoreImpl, RecId, TextId), Store->GetFieldStr(RecId, TextId));
+		}
+	}
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TStoreImpl, FieldReadSmallCache) {
+	// tiny cache so disk blocks get evicted while we read
+	TWPt<TQm::TBase> Base = NewTestBase(1024);
+	{
+		TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Values");
+		AddTestRecs(Store, 5000);
+		const int TextId = Store->GetFieldId("Text");
+		const int WeightId = Store->GetFieldId("Weight");
+		for (uint64 RecId = 0; RecId < 5000; RecId += 7) {
+			EXPECT_EQ(Store->GetFieldStr(RecId, TextId), "text of record " + TUInt64::GetStr(RecId));
+			EXPECT_EQ(Store->GetFieldFlt(RecId, WeightId), (double)RecId * 3.0);
+		}
+	}
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TStoreImpl, DISABLED_FieldReadPerf) {
+	const int Recs = 100000, Reps = 10;
+	TWPt<TQm::TBase> Base = NewTestBase(128 * 1024 * 1024);
+	{
+		TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Values");
+		const TQm::TStorage::TStoreImpl& StoreImpl = dynamic_cast<const TQm::TStorage::TStoreImpl&>(*Store);
+		AddTestRecs(Store, Recs);
+		const int ValueId = Store->GetFieldId("Value");
+		const int TextId = Store->GetFieldId("Text");
+		// memory field
+		double SumCopy = 0.0, SumView = 0.0;
+		TTmStopWatch CopySw(true);
+		for (int RepN = 0; RepN < Reps; RepN++) {
+			for (uint64 RecId = 0; RecId < (uint64)Recs; RecId++) {
+				SumCopy += TQm::TStorage::XTest::GetFieldFltCopy(StoreImpl, RecId, ValueId);
+			}
+		}
+		CopySw.Stop();
+		TTmStopWatch ViewSw(true);
+		for (int RepN = 0; RepN < Reps; RepN++) {
+			for (uint64 RecId = 0; RecId < (uint64)Recs; RecId++) {
+				SumView += Store->GetFieldFlt(RecId, ValueId);
+			}
+		}
+		ViewSw.Stop();
+		EXPECT_EQ(SumCopy, SumView);
+		printf("In-memory float field read: copy %.1f ns, view %.1f ns\n",
+			1e6 * CopySw.GetMSec() / (Recs * Reps), 1e6 * ViewSw.GetMSec() / (Recs * Reps));
+		// disk cache field
+		int LenCopy = 0, LenView = 0;
+		CopySw.Reset(true);
+		for (int RepN = 0; RepN < Reps; RepN++) {
+			for (uint64 RecId = 0; RecId < (uint64)Recs; RecId++) {
+				LenCopy += TQm::TStorage::XTest::GetFieldStrCopy(StoreImpl, RecId, TextId).Len();
+			}
+		}
+		CopySw.Stop();
+		ViewSw.Reset(true);
+		for (int RepN = 0; RepN < Reps; RepN++) {
+			for (uint64 RecId = 0; RecId < (uint64)Recs; RecId++) {
+				LenView += Store->GetFieldStr(RecId, TextId).Len();
+			}
+		}
+		ViewSw.Stop();
+		EXPECT_EQ(LenCopy, LenView);
+		printf("Disk-cache string field read: copy %.1f ns, view %.1f ns\n",
+			1e6 * CopySw.GetMSec() / (Recs * Reps), 1e6 * ViewSw.GetMSec() / (Recs * Reps));
+	}
+	TQmTest::CloseBase(Base);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Columnar layout
+
+namespace {
+
+// store with fixed-width fields also kept in columns
+PJsonVal GetColumnarSchema(const int& WindowSize) {
+	return TJsonVal::GetValFromStr(
+		"[{ \"name\": \"Columns\", \"fields\": ["
+		"  { \"name\": \"Name\", \"type\": \"string\", \"primary\": true },"
+		"  { \"name\": \"Value\", \"type\": \"float\", \"columnar\": true },"
+		"  { \"name\": \"Count\", \"type\": \"int\", \"columnar\": true },"
+		"  { \"name\": \"Time\", \"type\": \"datetime\", \"columnar\": true },"
+		"  { \"name\": \"Flag\", \"type\": \"bool\", \"columnar\": true },"
+		"  { \"name\": \"Plain\", \"type\": \"float\" }"
+		"], \"window\": " + TInt::GetStr(WindowSize) + " }]");
+}
+
+TWPt<TQm::TBase> NewColumnarBase(const int& WindowSize) {
+	return TQmTest::NewBase(StoreTestFPath, GetColumnarSchema(WindowSize));
+}
+
+void AddColumnarRecs(const TWPt<TQm::TStore>& Store, const int& FirstRecN, const int& Recs) {
+	for (int RecN = FirstRecN; RecN < FirstRecN + Recs; RecN++) {
+		PJsonVal RecVal = TJsonVal::NewObj();
+		RecVal->AddToObj("Name", "rec" + TInt::GetStr(RecN));
+		RecVal->AddToObj("Value", (double)RecN / 2.0);
+		RecVal->AddToObj("Count", RecN % 100);
+		RecVal->AddToObj("Time", TTm::GetTmFromMSecs(TTm::GetMSecsFromTm(TTm(2015, 1, 1)) + RecN * 1000).GetWebLogDateTimeStr(true, "T", false));
+		RecVal->AddToObj("Flag", RecN % 2 == 0);
+		RecVal->AddToObj("Plain", (double)RecN);
+		Store->AddRec(RecVal);
+	}
+}
+
+}
+
+TEST(TStoreImpl, ColumnarSchema) {
+	// strings have no fixed width
+	EXPECT_ANY_THROW(TQmTest::NewBase(StoreTestFPath, TJsonVal::GetValFromStr(
+		"[{ \"name\": \"Bad\", \"fields\": ["
+		"  { \"name\": \"Name\", \"type\": \"string\", \"columnar\": true }"
+		"]}]")));
+	// columns are kept only in memory
+	EXPECT_ANY_THROW(TQmTest::NewBase(StoreTestFPath, TJsonVal::GetValFromStr(
+		"[{ \"name\": \"Bad\", \"fields\": ["
+		"  { \"name\": \"Value\", \"type\": \"float\", \"store\": \"cache\", \"columnar\": true }"
+		"]}]")));
+}
+
+TEST(TStoreImpl, ColumnarFields) {
+	TWPt<TQm::TBase> Base = NewColumnarBase(1000000);
+	{
+		TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Columns");
+		AddColumnarRecs(Store, 0, 1000);
+		const int ValueId = Store->GetFieldId("Value");
+		const int CountId = Store->GetFieldId("Count");
+		const int TimeId = Store->GetFieldId("Time");
+		const int FlagId = Store->GetFieldId("Flag");
+		const int PlainId = Store->GetFieldId("Plain");
+		EXPECT_TRUE(Store->IsFieldColumnar(ValueId));
+		EXPECT_TRUE(Store->IsFieldColumnar(FlagId));
+		EXPECT_FALSE(Store->IsFieldColumnar(PlainId));
+		const uint64 StartMSecs = TTm::GetMSecsFromTm(TTm(2015, 1, 1));
+		for (uint64 RecId = 0; RecId < 1000; RecId++) {
+			EXPECT_EQ(Store->GetFieldFlt(RecId, ValueId), (double)RecId / 2.0);
+			EXPECT_EQ(Store->GetFieldInt(RecId, CountId), (int)(RecId % 100));
+			EXPECT_EQ(Store->GetFieldTmMSecs(RecId, TimeId), StartMSecs + RecId * 1000);
+			EXPECT_EQ(Store->GetFieldBool(RecId, FlagId), RecId % 2 == 0);
+		}
+		// bulk reads match columnar and row reads
+		TFltV ValueV; Store->GetColumnFlt(ValueId, ValueV);
+		TFltV PlainV; Store->GetColumnFlt(PlainId, PlainV);
+		ASSERT_EQ(ValueV.Len(), 1000);
+		ASSERT_EQ(PlainV.Len(), 1000);
+		for (int RecN = 0; RecN < 1000; RecN++) {
+			EXPECT_EQ(ValueV[RecN], (double)RecN / 2.0);
+			EXPECT_EQ(PlainV[RecN], (double)RecN);
+		}
+		// updates reach the columns
+		Store->SetFieldFlt(10, ValueId, -1.0);
+		EXPECT_EQ(Store->GetFieldFlt(10, ValueId), -1.0);
+		PJsonVal RecVal = TJsonVal::NewObj();
+		RecVal->AddToObj("Name", "rec20");
+		RecVal->AddToObj("Count", 1234);
+		Store->AddRec(RecVal);
+		EXPECT_EQ(Store->GetFieldInt(20, CountId), 1234);
+		// record set operations
+		TQm::PRecSet RecSet = Store->GetAllRecs();
+		RecSet->FilterByFieldInt(CountId, 10, 19);
+		EXPECT_EQ(RecSet->GetRecs(), 100);
+		RecSet->SortByField(false, ValueId);
+		EXPECT_EQ(RecSet->GetRecId(0), 919);
+		RecSet->FilterByFieldBool(FlagId, true);
+		EXPECT_EQ(RecSet->GetRecs(), 50);
+		RecSet->FilterByFieldTm(TimeId, StartMSecs, StartMSecs + 500 * 1000);
+		EXPECT_EQ(RecSet->GetRecs(), 25);
+	}
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TStoreImpl, ColumnarWindow) {
+	TWPt<TQm::TBase> Base = NewColumnarBase(1000);
+	{
+		TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Columns");
+		const int ValueId = Store->GetFieldId("Value");
+		// add in several batches so columns get compacted along the way
+		for (int BatchN = 0; BatchN < 10; BatchN++) {
+			AddColumnarRecs(Store, BatchN * 500, 500);
+			Base->GarbageCollect();
+			EXPECT_EQ(Store->GetRecs(), (uint64)MIN(1000, (BatchN + 1) * 500));
+			for (TQm::PStoreIter Iter = Store->ForwardIter(); Iter->Next(); ) {
+				const uint64 RecId = Iter->GetRecId();
+				EXPECT_EQ(Store->GetFieldFlt(RecId, ValueId), (double)RecId / 2.0);
+			}
+		}
+		TFltV ValueV; Store->GetColumnFlt(ValueId, ValueV);
+		ASSERT_EQ(ValueV.Len(), 1000);
+		EXPECT_EQ(ValueV[0], (double)Store->GetFirstRecId() / 2.0);
+		EXPECT_EQ(ValueV.Last(), (double)Store->GetLastRecId() / 2.0);
+	}
+	TQmTest::CloseBase(Base);
+	// columns survive reopening the base
+	Base = TQm::TStorage::LoadBase(StoreTestFPath, faUpdate, 1024 * 1024, 1024 * 1024);
+	{
+		TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Columns");
+		const int ValueId = Store->GetFieldId("Value");
+		EXPECT_TRUE(Store->IsFieldColumnar(ValueId));
+		for (TQm::PStoreIter Iter = Store->ForwardIter(); Iter->Next(); ) {
+			const uint64 RecId = Iter->GetRecId();
+			EXPECT_EQ(Store->GetFieldFlt(RecId, ValueId), (double)RecId / 2.0);
+		}
+		// and keep working after it
+		AddColumnarRecs(Store, 5000, 10);
+		EXPECT_EQ(Store->GetFieldFlt(5009, ValueId), 5009.0 / 2.0);
+	}
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TStoreImpl, DISABLED_ColumnarScanPerf) {
+	const int Recs = 200000, Reps = 10;
+	TWPt<TQm::TBase> Base = NewColumnarBase(Recs);
+	{
+		TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Columns");
+		AddColumnarRecs(Store, 0, Recs);
+		const int ValueId = Store->GetFieldId("Value");
+		const int PlainId = Store->GetFieldId("Plain");
+		double SumRow = 0.0, SumCol = 0.0;
+		TTmStopWatch RowSw(true);
+		for (int RepN = 0; RepN < Reps; RepN++) {
+			TFltV ValV; Store->GetColumnFlt(PlainId, ValV);
+			for (int ValN = 0; ValN < ValV.Len(); ValN++) { SumRow += ValV[ValN]; }
+		}
+		RowSw.Stop();
+		TTmStopWatch ColSw(true);
+		for (int RepN = 0; RepN < Reps; RepN++) {
+			TFltV ValV; Store->GetColumnFlt(ValueId, ValV);
+			for (int ValN = 0; ValN < ValV.Len(); ValN++) { SumCol += ValV[ValN]; }
+		}
+		ColSw.Stop();
+		EXPECT_EQ(SumRow, 2.0 * SumCol);
+		printf("Float field scan: rows %.1f ns, columns %.1f ns\n",
+			1e6 * RowSw.GetMSec() / (Recs * Reps), 1e6 * ColSw.GetMSec() / (Recs * Reps));
+	}
+	TQmTest::CloseBase(Base);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Window segments
+
+namespace {
+
+// store with one record per second, time window of an hour, optionally in ten minute segments
+PJsonVal GetSegmentSchema(const bool& SegmentP) {
+	return TJsonVal::GetValFromStr(
+		"[{ \"name\": \"Events\", \"fields\": ["
+		"  { \"name\": \"Name\", \"type\": \"string\", \"primary\": true },"
+		"  { \"name\": \"Time\", \"type\": \"datetime\" },"
+		"  { \"name\": \"Text\", \"type\": \"string\", \"store\": \"cache\" }"
+		"], \"keys\": ["
+		"  { \"field\": \"Time\", \"type\": \"linear\" },"
+		"  { \"field\": \"Text\", \"type\": \"value\" }"
+		"], \"timeWindow\": { \"duration\": 1, \"unit\": \"hour\", \"field\": \"Time\"" +
+		TStr(SegmentP ? ", \"segment\": { \"duration\": 10, \"unit\": \"minute\" }" : "") + " } }]");
+}
+
+TWPt<TQm::TBase> NewSegmentBase(const PJsonVal& SchemaVal) {
+	return TQmTest::NewBase(StoreTestFPath, SchemaVal);
+}
+
+TStr GetSegmentTmStr(const int& Secs) {
+	return TTm::GetTmFromMSecs(TTm::GetMSecsFromTm(TTm(2015, 1, 1)) + (uint64)Secs * 1000).GetWebLogDateTimeStr(true, "T", false);
+}
+
+void AddSegmentRecs(const TWPt<TQm::TStore>& Store, const int& FirstRecN, const int& Recs) {
+	for (int RecN = FirstRecN; RecN < FirstRecN + Recs; RecN++) {
+		PJsonVal RecVal = TJsonVal::NewObj();
+		RecVal->AddToObj("Name", "rec" + TInt::GetStr(RecN));
+		RecVal->AddToObj("Time", GetSegmentTmStr(RecN));
+		RecVal->AddToObj("Text", "text " + TInt::GetStr(RecN % 100));
+		if (Store->IsFieldNm("Loc")) {
+			PJsonVal LocVal = TJsonVal::NewArr();
+			LocVal->AddToArr(TJsonVal::NewNum(0.0));
+			LocVal->AddToArr(TJsonVal::NewNum((double)(RecN % 10)));
+			RecVal->AddToObj("Loc", LocVal);
+		}
+		Store->AddRec(RecVal);
+	}
+}
+
+TQm::PRecSet SearchSegmentRange(const TWPt<TQm::TBase>& Base, const int& MinSecs, const int& MaxSecs) {
+	return Base->Search("{ \"$from\": \"Events\", \"Time\": { \"$gt\": \"" + GetSegmentTmStr(MinSecs) +
+		"\", \"$lt\": \"" + GetSegmentTmStr(MaxSecs) + "\" } }");
+}
+
+}
+
+TEST(TStoreImpl, SegmentSchema) {
+	// segments need a positive size
+	EXPECT_ANY_THROW(NewSegmentBase(TJsonVal::GetValFromStr(
+		"[{ \"name\": \"Bad\", \"fields\": ["
+		"  { \"name\": \"Value\", \"type\": \"float\" }"
+		"], \"window\": 100, \"windowSegment\": 0 }]")));
+	// paged stores keep no segments
+	EXPECT_ANY_THROW(NewSegmentBase(TJsonVal::GetValFromStr(
+		"[{ \"name\": \"Bad\", \"options\": { \"type\": \"paged\" }, \"fields\": ["
+		"  { \"name\": \"Value\", \"type\": \"float\" }"
+		"], \"window\": 100, \"windowSegment\": 10 }]")));
+}
+
+TEST(TStoreImpl, SegmentTimeWindow) {
+	TWPt<TQm::TBase> Base = NewSegmentBase(GetSegmentSchema(true));
+	{
+		TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Events");
+		const int TimeId = Store->GetFieldId("Time");
+		EXPECT_TRUE(Store->IsSegmentField(TimeId));
+		AddSegmentRecs(Store, 0, 3 * 3600);
+		EXPECT_EQ(Store->GetStats()->GetObjInt("segments"), 18);
+		// window starts within the segment of [6600s, 7200s), which is kept whole
+		Base->GarbageCollect();
+		EXPECT_EQ(Store->GetFirstRecId(), 6600);
+		EXPECT_EQ(Store->GetRecs(), (uint64)(3 * 3600 - 6600));
+		EXPECT_EQ(Store->GetStats()->GetObjInt("segments"), 7);
+		EXPECT_EQ(Store->GetRecId("rec6599"), TUInt64::Mx);
+		EXPECT_EQ(Store->GetRecId("rec6600"), 6600);
+		// value index only has the remaining records
+		TQm::PRecSet RecSet = Base->Search("{ \"$from\": \"Events\", \"Text\": \"text 5\" }");
+		EXPECT_EQ(RecSet->GetRecs(), 42);
+		for (int RecN = 0; RecN < RecSet->GetRecs(); RecN++) {
+			EXPECT_GE(RecSet->GetRecId(RecN), 6600);
+		}
+		// range queries visit overlapping segments and match the linear index
+		const int KeyId = Base->GetIndexVoc()->GetKeyId(Store->GetStoreId(), "Time");
+		const int RangeV[][2] = { { 0, 20000 }, { 7000, 7500 }, { 8400, 8999 }, { 0, 6000 }, { 9000, 9000 } };
+		for (int RangeN = 0; RangeN < 5; RangeN++) {
+			const int MinSecs = RangeV[RangeN][0], MaxSecs = RangeV[RangeN][1];
+			TQm::PRecSet SegmentRecSet = SearchSegmentRange(Base, MinSecs, MaxSecs);
+			const uint64 StartMSecs = TTm::GetMSecsFromTm(TTm(2015, 1, 1));
+			TQm::PRecSet LinearRecSet = Base->GetIndex()->SearchLinear(Base, KeyId,
+				TUInt64Pr(StartMSecs + (uint64)MinSecs * 1000, StartMSecs + (uint64)MaxSecs * 1000));
+			LinearRecSet->SortById(true);
+			ASSERT_EQ(SegmentRecSet->GetRecs(), LinearRecSet->GetRecs());
+			for (int RecN = 0; RecN < SegmentRecSet->GetRecs(); RecN++) {
+				EXPECT_EQ(SegmentRecSet->GetRecId(RecN), LinearRecSet->GetRecId(RecN));
+			}
+		}
+		EXPECT_EQ(SearchSegmentRange(Base, 7000, 7500)->GetRecs(), 501);
+		EXPECT_EQ(SearchSegmentRange(Base, 0, 6000)->GetRecs(), 0);
+	}
+	TQmTest::CloseBase(Base);
+	// segments survive reopening the base
+	Base = TQm::TStorage::LoadBase(StoreTestFPath, faUpdate, 1024 * 1024, 1024 * 1024);
+	{
+		TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Events");
+		EXPECT_EQ(Store->GetStats()->GetObjInt("segments"), 7);
+		AddSegmentRecs(Store, 3 * 3600, 600);
+		Base->GarbageCollect();
+		EXPECT_EQ(Store->GetFirstRecId(), 7200);
+		EXPECT_EQ(SearchSegmentRange(Base, 11000, 11100)->GetRecs(), 101);
+	}
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TStoreImpl, SegmentLengthWindow) {
+	TWPt<TQm::TBase> Base = NewSegmentBase(TJsonVal::GetValFromStr(
+		"[{ \"name\": \"Events\", \"fields\": ["
+		"  { \"name\": \"Name\", \"type\": \"string\", \"primary\": true },"
+		"  { \"name\": \"Time\", \"type\": \"datetime\" },"
+		"  { \"name\": \"Text\", \"type\": \"string\", \"store\": \"cache\" },"
+		"  { \"name\": \"Loc\", \"type\": \"float_pair\" }"
+		"], \"keys\": ["
+		"  { \"field\": \"Text\", \"type\": \"value\" },"
+		"  { \"field\": \"Loc\", \"type\": \"location\" }"
+		"], \"window\": 1000, \"windowSegment\": 300 }]"));
+	{
+		TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Events");
+		EXPECT_FALSE(Store->IsSegmentField(Store->GetFieldId("Time")));
+		AddSegmentRecs(Store, 0, 2000);
+		// only whole segments are dropped, at least the window is kept
+		Base->GarbageCollect();
+		EXPECT_EQ(Store->GetFirstRecId(), 900);
+		EXPECT_EQ(Store->GetRecs(), 1100);
+		EXPECT_EQ(Base->Search("{ \"$from\": \"Events\", \"Text\": \"text 42\" }")->GetRecs(), 11);
+		// location index only has the remaining records
+		const int LocKeyId = Base->GetIndexVoc()->GetKeyId(Store->GetStoreId(), "Loc");
+		TQm::PRecSet LocRecSet = Base->GetIndex()->SearchGeoRange(Base, LocKeyId, TFltPr(0.0, 3.0), 1000.0, 10000);
+		EXPECT_EQ(LocRecSet->GetRecs(), 110);
+		for (int RecN = 0; RecN < LocRecSet->GetRecs(); RecN++) {
+			EXPECT_GE(LocRecSet->GetRecId(RecN), 900);
+		}
+		// deleting records cuts the first segment
+		Store->DeleteFirstRecs(50);
+		AddSegmentRecs(Store, 2000, 200);
+		Base->GarbageCollect();
+		EXPECT_EQ(Store->GetFirstRecId(), 1200);
+		EXPECT_EQ(Base->Search("{ \"$from\": \"Events\", \"Text\": \"text 42\" }")->GetRecs(), 10);
+	}
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TStoreImpl, DISABLED_SegmentWindowPerf) {
+	const int Recs = 4 * 3600, Reps = 4;
+	for (int ModeN = 0; ModeN < 2; ModeN++) {
+		const bool SegmentP = (ModeN == 1);
+		TWPt<TQm::TBase> Base = NewSegmentBase(GetSegmentSchema(SegmentP));
+		TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Events");
+		// each round expires about an hour of records
+		TTmStopWatch GcSw;
+		for (int RepN = 0; RepN < Reps; RepN++) {
+			AddSegmentRecs(Store, RepN * Recs, Recs);
+			GcSw.Start(); Base->GarbageCollect(); GcSw.Stop();
+		}
+		EXPECT_LE(Store->GetRecs(), (uint64)(3600 + 600));
+		TTmStopWatch SearchSw(true);
+		const int MaxSecs = Reps * Recs;
+		EXPECT_EQ(SearchSegmentRange(Base, MaxSecs - 600, MaxSecs)->GetRecs(), 600);
+		SearchSw.Stop();
+		printf("%s: garbage collection %d ms, range search %d ms\n", SegmentP ? "segments" : "records",
+			GcSw.GetMSecInt(), SearchSw.GetMSecInt());
+		TQmTest::CloseBase(Base);
+	}
+}
@@ -0,0 +1,250 @@
+/**
+* Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+* All rights reserved.
+*
+* This source code is licensed under the FreeBSD license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+#include <base.h>
+#include <mine.h>
+#include <qminer.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Google Test
+#include "gtest/gtest.h"
+
+#include "test-qminer.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Helpers
+
+namespace {
+
+const TStr WalTestFPath = "./data/wal/";
+const TStr WalCrashFPath = "./data/wal-crash/";
+
+// store with fields in memory and on disk, either generic or paged
+PJsonVal GetWalSchema(const TStr& StoreType) {
+	return TJsonVal::GetValFromStr(
+		"[{ \"name\": \"Values\", \"options\": { \"type\": \"" + StoreType + "\" }, \"fields\": ["
+		"  { \"name\": \"Name\", \"type\": \"string\", \"primary\": true },"
+		"  { \"name\": \"Value\", \"type\": \"float\" },"
+		"  { \"name\": \"Count\", \"type\": \"int\" },"
+		"  { \"name\": \"Text\", \"type\": \"string\", \"store\": \"cache\" }"
+		"], \"keys\": ["
+		"  { \"field\": \"Text\", \"type\": \"value\" }"
+		"]}]");
+}
+
+TWPt<TQm::TBase> NewWalBase(const TStr& StoreType) {
+	return TQmTest::NewBase(WalTestFPath, GetWalSchema(StoreType));
+}
+
+void AddWalRecs(const TWPt<TQm::TStore>& Store, const int& FirstRecN, const int& Recs) {
+	for (int RecN = FirstRecN; RecN < FirstRecN + Recs; RecN++) {
+		PJsonVal RecVal = TJsonVal::NewObj();
+		RecVal->AddToObj("Name", "rec" + TInt::GetStr(RecN));
+		RecVal->AddToObj("Value", (double)RecN / 2.0);
+		RecVal->AddToObj("Count", RecN);
+		RecVal->AddToObj("Text", "text of record " + TInt::GetStr(RecN));
+		Store->AddRec(RecVal);
+	}
+}
+
+// copy files of the open base, as they would be found after a crash
+void CrashCopy() {
+	TQmTest::NewDir(WalCrashFPath);
+	TDir::GenDirs(TQm::TWal::GetWalFPath(WalCrashFPath));
+	TStrV FNmV; TFFile::GetFNmV(WalTestFPath, TStrV(), true, FNmV);
+	for (int FNmN = 0; FNmN < FNmV.Len(); FNmN++) {
+		const TStr& FNm = FNmV[FNmN];
+		if (TDir::Exists(FNm + "/")) { continue; }
+		TFile::Copy(FNm, WalCrashFPath + FNm.GetSubStr(WalTestFPath.Len()), false, false);
+	}
+}
+
+TWPt<TQm::TBase> LoadCrashBase() {
+	return TQm::TStorage::LoadBase(WalCrashFPath, faUpdate, 1024 * 1024, 1024 * 1024, TStrUInt64H(), true);
+}
+
+void StartWal(const TWPt<TQm::TBase>& Base, const TQm::TWalParam& Param) {
+	TQm::TStorage::SaveBase(Base);
+	Base->StartWal(Param);
+}
+
+void CheckRecs(const TWPt<TQm::TBase>& Base, const int& Recs) {
+	TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Values");
+	ASSERT_EQ(Store->GetRecs(), (uint64)Recs);
+	const int ValueId = Store->GetFieldId("Value");
+	const int TextId = Store->GetFieldId("Text");
+	for (int RecN = 0; RecN < Recs; RecN++) {
+		const uint64 RecId = Store->GetRecId("rec" + TInt::GetStr(RecN));
+		ASSERT_NE(RecId, TUInt64::Mx);
+		EXPECT_EQ(Store->GetFieldFlt(RecId, ValueId), (double)RecN / 2.0);
+		EXPECT_EQ(Store->GetFieldStr(RecId, TextId), "text of record " + TInt::GetStr(RecN));
+	}
+}
+
+void CheckRecover(const TStr& StoreType) {
+	{
+		TWPt<TQm::TBase> Base = NewWalBase(StoreType);
+		TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Values");
+		AddWalRecs(Store, 0, 100);
+		// sync each operation
+		StartWal(Base, TQm::TWalParam(0, 64 * TInt::Mega));
+		EXPECT_TRUE(TQm::TWal::Exists(WalTestFPath));
+		AddWalRecs(Store, 100, 400);
+		// written to disk by the flush, journal keeps what is needed to undo it
+		Base->PartialFlush(TInt::Mx);
+		AddWalRecs(Store, 500, 500);
+		CrashCopy();
+		// operations after the crash are lost
+		AddWalRecs(Store, 1000, 10);
+		TQmTest::CloseBase(Base);
+		// closing removes the log
+		EXPECT_FALSE(TQm::TWal::Exists(WalTestFPath));
+	}
+	{
+		TWPt<TQm::TBase> Base = LoadCrashBase();
+		EXPECT_FALSE(TQm::TWal::Exists(WalCrashFPath));
+		CheckRecs(Base, 1000);
+		// index is rebuilt by the replay
+		TQm::PRecSet RecSet = Base->Search("{ \"$from\": \"Values\", \"Text\": \"text of record 700\" }");
+		ASSERT_EQ(RecSet->GetRecs(), 1);
+		EXPECT_EQ(RecSet->GetRecId(0), 700);
+		TQmTest::CloseBase(Base);
+	}
+	{
+		// recovered base opens cleanly
+		TWPt<TQm::TBase> Base = LoadCrashBase();
+		CheckRecs(Base, 1000);
+		TQmTest::CloseBase(Base);
+	}
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Write-ahead log
+
+TEST(TWal, Param) {
+	TQm::TWalParam Param(TJsonVal::GetValFromStr("{ \"syncInterval\": 10, \"checkpointSize\": 2 }"));
+	EXPECT_EQ(Param.SyncMSec, 10);
+	EXPECT_EQ(Param.CheckpointBytes, 2 * (uint64)TInt::Mega);
+	TQm::TWalParam DefParam(TJsonVal::NewObj());
+	EXPECT_EQ(DefParam.SyncMSec, TQm::TWalParam().SyncMSec);
+	EXPECT_ANY_THROW(TQm::TWalParam(-1, 1));
+}
+
+TEST(TWal, RecoverGeneric) {
+	CheckRecover("generic");
+}
+
+TEST(TWal, RecoverPaged) {
+	CheckRecover("paged");
+}
+
+TEST(TWal, RecoverChanges) {
+	{
+		TWPt<TQm::TBase> Base = NewWalBase("generic");
+		TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Values");
+		StartWal(Base, TQm::TWalParam(0, 64 * TInt::Mega));
+		AddWalRecs(Store, 0, 100);
+		const int ValueId = Store->GetFieldId("Value");
+		const int CountId = Store->GetFieldId("Count");
+		// set fields, update records and delete the first ones
+		for (uint64 RecId = 0; RecId < 100; RecId++) {
+			Store->SetFieldFlt(RecId, ValueId, 0.5 * RecId);
+		}
+		Store->SetFieldNull(7, CountId);
+		PJsonVal UpdateVal = TJsonVal::NewObj();
+		UpdateVal->AddToObj("Text", "updated text");
+		Store->UpdateRec(50, UpdateVal);
+		Store->DeleteFirstRecs(10);
+		CrashCopy();
+		TQmTest::CloseBase(Base);
+	}
+	{
+		TWPt<TQm::TBase> Base = LoadCrashBase();
+		TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Values");
+		EXPECT_EQ(Store->GetRecs(), 90);
+		EXPECT_EQ(Store->GetFirstRecId(), 10);
+		EXPECT_EQ(Store->GetFieldStr(50, Store->GetFieldId("Text")), "updated text");
+		EXPECT_EQ(Store->GetFieldFlt(99, Store->GetFieldId("Value")), 49.5);
+		EXPECT_EQ(Store->GetFieldInt(11, Store->GetFieldId("Count")), 11);
+		TQmTest::CloseBase(Base);
+	}
+}
+
+TEST(TWal, Checkpoint) {
+	{
+		TWPt<TQm::TBase> Base = NewWalBase("generic");
+		TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Values");
+		// small log, checkpoint every few records
+		StartWal(Base, TQm::TWalParam(0, 4 * 1024));
+		AddWalRecs(Store, 0, 200);
+		PJsonVal WalVal = Base->GetStats()->GetObjKey("wal");
+		EXPECT_GT(WalVal->GetObjInt("checkpoints"), 0);
+		// log only has operations after the last checkpoint
+		EXPECT_LT(WalVal->GetObjNum("log_bytes"), 8 * 1024);
+		Base->Checkpoint();
+		AddWalRecs(Store, 200, 10);
+		CrashCopy();
+		TQmTest::CloseBase(Base);
+	}
+	{
+		TWPt<TQm::TBase> Base = LoadCrashBase();
+		CheckRecs(Base, 210);
+		TQmTest::CloseBase(Base);
+	}
+}
+
+TEST(TWal, GroupCommit) {
+	TWPt<TQm::TBase> Base = NewWalBase("generic");
+	TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Values");
+	// operations logged within a second share one sync
+	StartWal(Base, TQm::TWalParam(1000, 64 * TInt::Mega));
+	AddWalRecs(Store, 0, 100);
+	PJsonVal WalVal = Base->GetStats()->GetObjKey("wal");
+	EXPECT_EQ(WalVal->GetObjInt("ops"), 100);
+	EXPECT_LT(WalVal->GetObjInt("syncs"), 10);
+	Base->StopWal();
+	EXPECT_FALSE(Base->IsWal());
+	EXPECT_FALSE(TQm::TWal::Exists(WalTestFPath));
+	TQmTest::CloseBase(Base);
+}
+
+TEST(TWal, DISABLED_Perf) {
+	const int Recs = 20000;
+	// ingest without log, with grouped syncs and with sync after each record
+	const int SyncMSecV[] = { -1, 100, 0 };
+	for (int ModeN = 0; ModeN < 3; ModeN++) {
+		const int SyncMSec = SyncMSecV[ModeN];
+		TWPt<TQm::TBase> Base = NewWalBase("generic");
+		TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Values");
+		if (SyncMSec >= 0) { StartWal(Base, TQm::TWalParam(SyncMSec, 1024 * TInt::Mega)); }
+		TTmStopWatch AddSw(true);
+		AddWalRecs(Store, 0, Recs);
+		AddSw.Stop();
+		if (SyncMSec >= 0) {
+			// records still waiting for the grouped sync would be lost
+			Base->GetWal()->Sync();
+			CrashCopy();
+		}
+		TTmStopWatch CloseSw(true);
+		TQmTest::CloseBase(Base);
+		CloseSw.Stop();
+		// clean open, or recovery replaying the whole log
+		TTmStopWatch OpenSw(true);
+		Base = TQm::TStorage::LoadBase(SyncMSec >= 0 ? WalCrashFPath : WalTestFPath,
+			faUpdate, 1024 * 1024, 1024 * 1024, TStrUInt64H(), true);
+		OpenSw.Stop();
+		EXPECT_EQ(Base->GetStoreByStoreNm("Values")->GetRecs(), (uint64)Recs);
+		TQmTest::CloseBase(Base);
+		printf("%s: add %d recs/s, close %d ms, open %d ms\n",
+			(SyncMSec < 0) ? "no log" : TStr::Fmt("log, sync %d ms", SyncMSec).CStr(),
+			(int)(1000.0 * Recs / TInt::GetMx(AddSw.GetMSecInt(), 1)),
+			CloseSw.GetMSecInt(), OpenSw.GetMSecInt());
+	}
+}
@@ -0,0 +1,108 @@
+/**
+ * Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+ * All rights reserved.
+ *
+ * This source code is licensed under the FreeBSD license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+// console.log(__filename)
+var assert = require('../../src/nodejs/scripts/assert.js'); //adds assert.run function
+var qm = require('qminer');
+
+describe('Async Query Tests', function () {
+    var base = undefined;
+    var store = undefined;
+
+    beforeEach(function () {
+        qm.delLock();
+        base = new qm.Base({ mode: 'createClean' });
+        base.createStore({
+            'name': 'AsyncTest',
+            'fields': [
+              { 'name': 'Value', 'type': 'int' },
+              { 'name': 'ForSort', 'type': 'float' }
+            ],
+            'joins': [],
+            'keys': [
+                { field: 'Value', type: 'linear' }
+            ]
+        });
+        store = base.store('AsyncTest');
+        for (var i = 0; i < 100; i++) {
+            store.push({ Value: i % 10, ForSort: 100 - i });
+        }
+    });
+    afterEach(function () {
+        base.close();
+    });
+
+    describe('base.searchAsync', function () {
+        it('returns the same records as base.search', function (done) {
+            base.searchAsync({ $from: 'AsyncTest', Value: { $gt: 5 } }, function (err, result) {
+                assert.equal(err, null);
+                assert.equal(result.length, 40);
+                result.each(function (rec) { assert.equal(rec.Value > 5, true); });
+                done();
+            });
+        })
+        it('returns a promise without a callback', function (done) {
+            base.searchAsync({ $from: 'AsyncTest', Value: 3 }).then(function (result) {
+                assert.equal(result.length, 10);
+                done();
+            }).catch(done);
+        })
+        it('reports an error for an invalid query', function (done) {
+            base.searchAsync({ $from: 'NoSuchStore' }, function (err, result) {
+                assert.notEqual(err, null);
+                done();
+            });
+        })
+    });
+
+    describe('store.pushAsync', function () {
+        it('adds records and fires triggers', function (done) {
+            var added = 0;
+            store.addTrigger({ onAdd: function (rec) { added++; } });
+            store.pushAsync({ Value: 11, ForSort: 0 }, function (err, recId) {
+                assert.equal(err, null);
+                assert.equal(recId, 100);
+                assert.equal(store.length, 101);
+                assert.equal(store[recId].Value, 11);
+                assert.equal(added, 1);
+                done();
+            });
+        })
+        it('does not fire triggers when asked not to', function (done) {
+            var added = 0;
+            store.addTrigger({ onAdd: function (rec) { added++; } });
+            store.pushAsync({ Value: 11, ForSort: 0 }, false).then(function (recId) {
+                assert.equal(added, 0);
+                done();
+            }).catch(done);
+        })
+    });
+
+    describe('recordSet.sortByFieldAsync and filterByFieldAsync', function () {
+        it('sorts a copy of the record set', function (done) {
+            var recSet = store.allRecords;
+            recSet.sortByFieldAsync('ForSort', true, function (err, sorted) {
+                assert.equal(err, null);
+                assert.equal(sorted.length, 100);
+                assert.equal(sorted[0].ForSort, 1);
+                assert.equal(sorted[99].ForSort, 100);
+                // original is not changed
+                assert.equal(recSet[0].ForSort, 100);
+                done();
+            });
+        })
+        it('filters a copy of the record set', function (done) {
+            var recSet = store.allRecords;
+            recSet.filterByFieldAsync('Value', 2, 4).then(function (filtered) {
+                assert.equal(filtered.length, 30);
+                assert.equal(recSet.length, 100);
+                done();
+            }).catch(done);
+        })
+    });
+});